@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Microbenchmarks for the library's hot kernels. Each case runs for a fixed
+// wall-clock budget and reports iterations, ns/op, and bytes/sec, one line
+// per case, so releases can be compared with a diff:
+//
+//   name ...................... <iters> iters  <ns>/op  <rate>
+//
+// Build via -DBUILD_BENCHMARKS=ON (CMake) or the benchmark SConscript.
+
+#include <websocketpp/config/core.hpp>
+
+#include <websocketpp/frame.hpp>
+#include <websocketpp/sha1/sha1.hpp>
+#include <websocketpp/base64/base64.hpp>
+#include <websocketpp/utf8_validator.hpp>
+#include <websocketpp/http/request.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#include <websocketpp/processors/hybi13.hpp>
+
+#include <websocketpp/common/chrono.hpp>
+
+#include <chrono>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+typedef std::chrono::steady_clock clock_type;
+
+/// Minimum wall-clock time to run each case for
+static double const budget_seconds = 0.5;
+
+/// Report one case: iterations, ns/op, and throughput when bytes_per_op > 0
+void report(char const * name, size_t iters, double seconds,
+    size_t bytes_per_op)
+{
+    double ns_op = seconds*1e9/iters;
+    std::printf("%-32s %12zu iters %10.1f ns/op",name,iters,ns_op);
+    if (bytes_per_op > 0) {
+        double rate = bytes_per_op*iters/seconds;
+        if (rate >= 1e9) {
+            std::printf(" %8.2f GB/s",rate/1e9);
+        } else {
+            std::printf(" %8.2f MB/s",rate/1e6);
+        }
+    }
+    std::printf("\n");
+}
+
+/// Run fn repeatedly until the time budget is consumed
+template <typename F>
+void run(char const * name, size_t bytes_per_op, F fn) {
+    // warm up and estimate batch size
+    fn();
+    size_t batch = 1;
+    for (;;) {
+        clock_type::time_point t0 = clock_type::now();
+        for (size_t i = 0; i < batch; i++) {
+            fn();
+        }
+        double s = std::chrono::duration_cast<
+            std::chrono::duration<double> >(clock_type::now()-t0).count();
+        if (s >= budget_seconds) {
+            report(name,batch,s,bytes_per_op);
+            return;
+        }
+        batch = (s <= 0 ? batch*10
+                        : static_cast<size_t>(batch*budget_seconds/s)+1);
+    }
+}
+
+// ---------------------------------------------------------------- masking
+
+void bench_masking() {
+    std::vector<uint8_t> buf(65536+8);
+    websocketpp::frame::masking_key_type key;
+    key.i = 0x12345678;
+    size_t pkey = websocketpp::frame::prepare_masking_key(key);
+
+    struct word_mask {
+        uint8_t * data; size_t pkey;
+        void operator()() {
+            websocketpp::frame::word_mask_circ(data,65536,pkey);
+        }
+    } wm = {&buf[0],pkey};
+    run("frame::word_mask_circ 64KB",65536,wm);
+
+    struct simd_mask {
+        uint8_t * data; size_t pkey;
+        void operator()() {
+            websocketpp::frame::simd_mask_circ(data,65536,pkey);
+        }
+    } sm = {&buf[0],pkey};
+    run("frame::simd_mask_circ 64KB",65536,sm);
+}
+
+// ------------------------------------------------------------------ sha1
+
+void bench_sha1() {
+    struct one_shot {
+        void operator()() {
+            unsigned char digest[20];
+            websocketpp::sha1_one_shot("abcdefghijklmnopqrstuvwx",24,digest);
+        }
+    } os;
+    run("sha1_one_shot 24B (accept key)",24,os);
+
+    struct big {
+        std::string data;
+        void operator()() {
+            unsigned char digest[20];
+            websocketpp::sha1_one_shot(data.data(),data.size(),digest);
+        }
+    } b;
+    b.data.assign(65536,'s');
+    run("sha1_one_shot 64KB",65536,b);
+}
+
+// ---------------------------------------------------------------- base64
+
+void bench_base64() {
+    struct enc {
+        std::string data;
+        void operator()() {
+            volatile size_t sink = base64_encode(data).size();
+            (void)sink;
+        }
+    } e;
+    e.data.assign(4096,'b');
+    run("base64_encode 4KB",4096,e);
+}
+
+// ------------------------------------------------------------------ utf8
+
+void bench_utf8() {
+    struct validate {
+        std::string data;
+        void operator()() {
+            volatile bool sink = websocketpp::utf8_validator::validate(data);
+            (void)sink;
+        }
+    } v;
+    for (int i = 0; i < 8192; i++) {
+        v.data += (i%7 ? "a" : "\xc3\xa9");
+    }
+    run("utf8 validate ~8KB mixed",v.data.size(),v);
+}
+
+// ------------------------------------------------------------ http parse
+
+void bench_http() {
+    struct parse {
+        std::string raw;
+        void operator()() {
+            websocketpp::http::parser::request r;
+            r.set_arena_parse(true);
+            r.consume(raw.data(),raw.size());
+        }
+    } p;
+    p.raw =
+        "GET /chat HTTP/1.1\r\nHost: server.example.com\r\n"
+        "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Origin: http://example.com\r\nSec-WebSocket-Version: 13\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n\r\n";
+    run("http request parse (arena)",p.raw.size(),p);
+}
+
+// -------------------------------------------------------- hybi13 consume
+
+/// Minimal config for driving the processor directly, mirroring the stub
+/// configs the unit tests use
+struct bench_config {
+    typedef websocketpp::http::parser::request request_type;
+    typedef websocketpp::http::parser::response response_type;
+    typedef websocketpp::message_buffer::message<
+        websocketpp::message_buffer::alloc::con_msg_manager> message_type;
+    typedef websocketpp::message_buffer::alloc::con_msg_manager<message_type>
+        con_msg_manager_type;
+    typedef websocketpp::random::none::int_generator<uint32_t> rng_type;
+    struct permessage_deflate_config {
+        typedef websocketpp::http::parser::request request_type;
+    };
+    typedef websocketpp::extensions::permessage_deflate::disabled<
+        permessage_deflate_config> permessage_deflate_type;
+    static const size_t max_message_size = 32000000;
+    static const bool enable_extensions = false;
+};
+
+void bench_consume() {
+    // recorded corpus: a mix of masked frame sizes typical of a data feed
+    std::string corpus;
+    size_t sizes[] = {32,64,180,1024,32,48,4096,90,32,700};
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+        size_t n = sizes[i];
+        corpus += char(0x82);
+        if (n <= 125) {
+            corpus += char(0x80|n);
+        } else {
+            corpus += char(0x80|126);
+            corpus += char((n>>8)&0xFF);
+            corpus += char(n&0xFF);
+        }
+        uint8_t k[4] = {1,2,3,4};
+        corpus.append(reinterpret_cast<char *>(k),4);
+        for (size_t j = 0; j < n; j++) {
+            corpus += char(('a'+j%26)^k[j%4]);
+        }
+    }
+
+    struct consume {
+        std::string corpus;
+        std::vector<uint8_t> scratch;
+        websocketpp::lib::shared_ptr<
+            bench_config::con_msg_manager_type> manager;
+        bench_config::rng_type rng;
+
+        void operator()() {
+            websocketpp::processor::hybi13<bench_config> p(false,true,
+                manager,rng);
+            scratch.assign(corpus.begin(),corpus.end());
+            websocketpp::lib::error_code ec;
+            size_t off = 0;
+            while (off < scratch.size()) {
+                off += p.consume(&scratch[off],scratch.size()-off,ec);
+                if (ec) { std::abort(); }
+                if (p.ready()) { p.get_message(); }
+            }
+        }
+    } c;
+    c.corpus = corpus;
+    c.manager.reset(new bench_config::con_msg_manager_type());
+    run("hybi13 consume 10-frame corpus",corpus.size(),c);
+}
+
+// ------------------------------------------------------ deflate compress
+
+struct deflate_cfg {
+    typedef websocketpp::http::parser::request request_type;
+    static const bool allow_disabling_context_takeover = true;
+};
+
+void bench_deflate() {
+    struct compress {
+        websocketpp::extensions::permessage_deflate::enabled<deflate_cfg> *
+            ext;
+        std::string data;
+        std::string out;
+        void operator()() {
+            out.clear();
+            ext->compress(data,out);
+        }
+    } c;
+    static websocketpp::extensions::permessage_deflate::enabled<deflate_cfg>
+        ext;
+    websocketpp::http::attribute_list attrs;
+    ext.negotiate(attrs);
+    c.ext = &ext;
+    for (int i = 0; i < 256; i++) {
+        c.data += "sample payload with moderate redundancy ";
+    }
+    run("permessage_deflate compress 10KB",c.data.size(),c);
+}
+
+} // namespace bench
+
+int main() {
+    std::printf("websocketpp microbenchmarks (budget %.1fs/case)\n\n",
+        bench::budget_seconds);
+    bench::bench_masking();
+    bench::bench_sha1();
+    bench::bench_base64();
+    bench::bench_utf8();
+    bench::bench_http();
+    bench::bench_consume();
+    bench::bench_deflate();
+    return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Performance conformance profile
+//
+// Autobahn answers "is it correct"; this harness answers "how fast, per
+// configuration". A standard scenario set -- small-message echo, 64KB
+// bulk transfer, multi-connection fanout, handshake storm -- runs over
+// loopback against servers built from a matrix of config permutations
+// (baseline asio, tuned asio with raw continuations / speculative
+// writes / read draining, permessage-deflate), and the results print as
+// one comparison table. Run it per upgrade and pick configs per service
+// from numbers instead of folklore.
+//
+//   perf_profile [--full]
+//
+// The default scenario sizes finish in seconds for CI; --full scales the
+// fanout and storm scenarios up for load-shaped answers.
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+
+#include <websocketpp/common/thread.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef websocketpp::server<websocketpp::config::asio> server_plain;
+typedef websocketpp::client<websocketpp::config::asio_client> client_plain;
+
+struct deflate_server_config : public websocketpp::config::asio {
+    struct permessage_deflate_config {};
+    typedef websocketpp::extensions::permessage_deflate::enabled<
+        permessage_deflate_config> permessage_deflate_type;
+};
+typedef websocketpp::server<deflate_server_config> server_deflate;
+
+struct deflate_client_config : public websocketpp::config::asio_client {
+    struct permessage_deflate_config {};
+    typedef websocketpp::extensions::permessage_deflate::enabled<
+        permessage_deflate_config> permessage_deflate_type;
+};
+typedef websocketpp::client<deflate_client_config> client_deflate;
+
+struct scenario_sizes {
+    int echo_msgs;
+    int bulk_msgs;
+    int fanout_conns;
+    int fanout_rounds;
+    int storm_conns;
+};
+
+struct result_row {
+    std::string config;
+    double echo_msgs_s;
+    double bulk_mb_s;
+    double fanout_msgs_s;
+    double storm_conns_s;
+};
+
+static uint64_t now_us() {
+    return websocketpp::lib::steady_us();
+}
+
+/// One config permutation: a server factory plus client-side scenarios
+/**
+ * The server runs on its own thread for the duration of the
+ * permutation; scenarios drive it over loopback with a matching client
+ * and report throughput. Templated so each permutation's handlers
+ * compile against its own config (static dispatch intact).
+ */
+template <typename server_type, typename client_type>
+struct permutation {
+    typedef typename server_type::message_ptr smessage_ptr;
+    typedef typename client_type::message_ptr cmessage_ptr;
+    typedef typename client_type::connection_ptr connection_ptr;
+
+    static void run(char const * name, uint16_t port, bool tuned,
+        scenario_sizes const & sz, std::vector<result_row> & out)
+    {
+        server_type s;
+        s.set_access_channels(websocketpp::log::alevel::none);
+        s.set_error_channels(websocketpp::log::elevel::none);
+        s.init_asio();
+        if (tuned) {
+            s.set_raw_continuations(true);
+            s.set_speculative_writes(true);
+            s.set_drain_reads(true);
+        }
+        s.set_message_handler(
+            websocketpp::lib::bind(&permutation::echo,&s,
+                websocketpp::lib::placeholders::_1,
+                websocketpp::lib::placeholders::_2));
+        s.listen(boost::asio::ip::tcp::endpoint(
+            boost::asio::ip::address_v4::loopback(),port));
+        s.start_accept();
+        websocketpp::lib::thread th(
+            websocketpp::lib::bind(&server_type::run,&s));
+
+        result_row row;
+        row.config = name;
+        row.echo_msgs_s = scenario_echo(port,sz.echo_msgs,64);
+        row.bulk_mb_s = scenario_echo(port,sz.bulk_msgs,65536)
+            * 65536.0/(1024.0*1024.0);
+        row.fanout_msgs_s = scenario_fanout(port,sz.fanout_conns,
+            sz.fanout_rounds);
+        row.storm_conns_s = scenario_storm(port,sz.storm_conns);
+        out.push_back(row);
+
+        s.stop();
+        th.join();
+    }
+
+    static void echo(server_type * s, websocketpp::connection_hdl hdl,
+        smessage_ptr msg)
+    {
+        s->send(hdl,msg->get_payload(),msg->get_opcode());
+    }
+
+    struct echo_state {
+        int remaining;
+        std::string payload;
+        uint64_t t0;
+        uint64_t t1;
+    };
+
+    struct fan_state {
+        int open_left;
+        long delivered;
+        long target;
+        uint64_t t0;
+        uint64_t t1;
+    };
+
+    /// Ping-pong echo of `count` messages of `bytes` each; returns msgs/s
+    static double scenario_echo(uint16_t port, int count, int bytes) {
+        client_type c;
+        c.set_access_channels(websocketpp::log::alevel::none);
+        c.set_error_channels(websocketpp::log::elevel::none);
+        c.init_asio();
+
+        echo_state st;
+        st.remaining = count;
+        st.payload.assign(static_cast<size_t>(bytes),'p');
+        st.t0 = 0;
+        st.t1 = 0;
+
+        c.set_open_handler(
+            websocketpp::lib::bind(&permutation::echo_open,&c,&st,
+                websocketpp::lib::placeholders::_1));
+        c.set_message_handler(
+            websocketpp::lib::bind(&permutation::echo_message,&c,&st,
+                websocketpp::lib::placeholders::_1,
+                websocketpp::lib::placeholders::_2));
+
+        websocketpp::lib::error_code ec;
+        connection_ptr con = c.get_connection(uri(port),ec);
+        if (ec) { return 0; }
+        c.connect(con);
+        c.run();
+        if (st.t1 <= st.t0) { return 0; }
+        return count*1e6/static_cast<double>(st.t1-st.t0);
+    }
+
+    static void echo_open(client_type * c, echo_state * st,
+        websocketpp::connection_hdl hdl)
+    {
+        st->t0 = now_us();
+        websocketpp::lib::error_code ec;
+        c->send(hdl,st->payload,websocketpp::frame::opcode::binary,ec);
+    }
+
+    static void echo_message(client_type * c, echo_state * st,
+        websocketpp::connection_hdl hdl, cmessage_ptr)
+    {
+        if (--st->remaining == 0) {
+            st->t1 = now_us();
+            websocketpp::lib::error_code ec;
+            c->close(hdl,websocketpp::close::status::normal,"",ec);
+            return;
+        }
+        websocketpp::lib::error_code ec;
+        c->send(hdl,st->payload,websocketpp::frame::opcode::binary,ec);
+    }
+
+    /// `conns` clients each echoing one message per round; returns the
+    /// aggregate delivered msgs/s
+    static double scenario_fanout(uint16_t port, int conns, int rounds) {
+        client_type c;
+        c.set_access_channels(websocketpp::log::alevel::none);
+        c.set_error_channels(websocketpp::log::elevel::none);
+        c.init_asio();
+
+        fan_state st;
+        st.open_left = conns;
+        st.delivered = 0;
+        st.target = static_cast<long>(conns)*rounds;
+        st.t0 = 0;
+        st.t1 = 0;
+
+        c.set_open_handler(
+            websocketpp::lib::bind(&permutation::fan_open,&c,&st,
+                websocketpp::lib::placeholders::_1));
+        c.set_message_handler(
+            websocketpp::lib::bind(&permutation::fan_message,&c,&st,
+                websocketpp::lib::placeholders::_1,
+                websocketpp::lib::placeholders::_2));
+
+        for (int i = 0; i < conns; i++) {
+            websocketpp::lib::error_code ec;
+            connection_ptr con = c.get_connection(uri(port),ec);
+            if (ec) { return 0; }
+            c.connect(con);
+        }
+        c.run();
+        if (st.t1 <= st.t0) { return 0; }
+        return static_cast<double>(conns)*rounds*1e6
+            /static_cast<double>(st.t1-st.t0);
+    }
+
+    static void fan_open(client_type * c, fan_state * st,
+        websocketpp::connection_hdl hdl)
+    {
+        if (--st->open_left == 0) {
+            st->t0 = now_us();
+        }
+        websocketpp::lib::error_code ec;
+        // piggyback the per-connection round count in the payload size:
+        // every connection runs st->rounds echoes
+        c->send(hdl,std::string("fan"),
+            websocketpp::frame::opcode::binary,ec);
+    }
+
+    static void fan_message(client_type * c, fan_state * st,
+        websocketpp::connection_hdl hdl, cmessage_ptr)
+    {
+        // single io thread: the counter needs no synchronization. Rounds
+        // are a global budget rather than strictly per connection; the
+        // aggregate delivery rate is what the scenario measures.
+        if (++st->delivered >= st->target) {
+            st->t1 = now_us();
+            c->stop();
+            return;
+        }
+        websocketpp::lib::error_code ec;
+        c->send(hdl,std::string("fan"),
+            websocketpp::frame::opcode::binary,ec);
+    }
+
+    /// Sequential connect/upgrade/close cycles; returns connects/s
+    static double scenario_storm(uint16_t port, int conns) {
+        uint64_t t0 = now_us();
+        for (int i = 0; i < conns; i++) {
+            client_type c;
+            c.set_access_channels(websocketpp::log::alevel::none);
+            c.set_error_channels(websocketpp::log::elevel::none);
+            c.init_asio();
+            c.set_open_handler(
+                websocketpp::lib::bind(&permutation::storm_open,&c,
+                    websocketpp::lib::placeholders::_1));
+            websocketpp::lib::error_code ec;
+            connection_ptr con = c.get_connection(uri(port),ec);
+            if (ec) { return 0; }
+            c.connect(con);
+            c.run();
+        }
+        return conns*1e6/static_cast<double>(now_us()-t0);
+    }
+
+    static void storm_open(client_type * c, websocketpp::connection_hdl hdl) {
+        websocketpp::lib::error_code ec;
+        c->close(hdl,websocketpp::close::status::normal,"",ec);
+    }
+
+    static std::string uri(uint16_t port) {
+        char buf[48];
+        std::snprintf(buf,sizeof(buf),"ws://127.0.0.1:%u/",
+            static_cast<unsigned>(port));
+        return std::string(buf);
+    }
+};
+
+int main(int argc, char ** argv) {
+    bool full = (argc > 1 && std::strcmp(argv[1],"--full") == 0);
+
+    scenario_sizes sz;
+    sz.echo_msgs = 1000;
+    sz.bulk_msgs = 64;
+    sz.fanout_conns = full ? 1000 : 50;
+    sz.fanout_rounds = 20;
+    sz.storm_conns = full ? 2000 : 200;
+
+    std::vector<result_row> rows;
+
+    permutation<server_plain,client_plain>::run(
+        "asio/plain",9301,false,sz,rows);
+    permutation<server_plain,client_plain>::run(
+        "asio/tuned",9302,true,sz,rows);
+    permutation<server_deflate,client_deflate>::run(
+        "asio/deflate",9303,false,sz,rows);
+
+    std::printf("\n%-14s %14s %12s %14s %12s\n","config",
+        "echo64 msg/s","bulk MB/s","fanout msg/s","storm con/s");
+    for (size_t i = 0; i < rows.size(); i++) {
+        std::printf("%-14s %14.0f %12.1f %14.0f %12.0f\n",
+            rows[i].config.c_str(),rows[i].echo_msgs_s,
+            rows[i].bulk_mb_s,rows[i].fanout_msgs_s,
+            rows[i].storm_conns_s);
+    }
+    return 0;
+}
@@ -34,7 +34,8 @@ enum action_type {
 
 struct action {
     action(action_type t, connection_hdl h) : type(t), hdl(h) {}
-    action(action_type t, server::message_ptr m) : type(t), msg(m) {}
+    action(action_type t, connection_hdl h, server::message_ptr m)
+      : type(t), hdl(h), msg(m) {}
     
     action_type type;
     websocketpp::connection_hdl hdl;
@@ -46,6 +47,7 @@ public:
     broadcast_server() {
         // Initialize Asio Transport
         m_server.init_asio();
+        m_server.set_registry_shards(8);
         
         // Register handler callbacks
         m_server.set_open_handler(bind(&broadcast_server::on_open,this,::_1));
@@ -92,11 +94,18 @@ public:
         // queue message up for sending by processing thread
         unique_lock<mutex> lock(m_action_lock);
         //std::cout << "on_message" << std::endl;
-        m_actions.push(action(MESSAGE,msg));
+        m_actions.push(action(MESSAGE,hdl,msg));
         lock.unlock();
         m_action_cond.notify_one();
     }
     
+    void send_to(server::message_ptr msg, connection_hdl hdl) {
+        // connections still handshaking or closing simply report
+        // invalid_state; ignore them
+        websocketpp::lib::error_code ec;
+        m_server.send(hdl,msg,ec);
+    }
+
     void process_messages() {
         while(1) {
             unique_lock<mutex> lock(m_action_lock);
@@ -111,32 +120,31 @@ public:
             lock.unlock();
             
             if (a.type == SUBSCRIBE) {
-                unique_lock<mutex> lock(m_connection_lock);
-                m_connections.insert(a.hdl);
+                // connection tracking is handled by the endpoint's sharded
+                // registry; nothing to do here
             } else if (a.type == UNSUBSCRIBE) {
-                unique_lock<mutex> lock(m_connection_lock);
-                m_connections.erase(a.hdl);
+                // ditto
             } else if (a.type == MESSAGE) {
-                unique_lock<mutex> lock(m_connection_lock);
-                
-                con_list::iterator it;
-                for (it = m_connections.begin(); it != m_connections.end(); ++it) {
-                    m_server.send(*it,a.msg);
-                }
+                // frame the payload once; every subscriber then enqueues the
+                // same prepared message by pointer
+                websocketpp::lib::error_code ec;
+                server::message_ptr prepared = m_server.prepare_message(
+                    a.hdl,a.msg->get_payload(),a.msg->get_opcode(),ec);
+
+                server::message_ptr msg = (prepared ? prepared : a.msg);
+                m_server.for_each_connection(bind(
+                    &broadcast_server::send_to,this,msg,::_1));
             } else {
                 // undefined.
             }
         }
     }
 private:
-    typedef std::set<connection_hdl,std::owner_less<connection_hdl>> con_list;
     
     server m_server;
-    con_list m_connections;
     std::queue<action> m_actions;
     
     mutex m_action_lock;
-    mutex m_connection_lock;
     condition_variable m_action_cond;
 };
 
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Echo load harness companion to testee_server: opens N connections to an
+// echo endpoint, pumps fixed size messages, measures per message round trip
+// latency into a log-bucketed (HDR style) histogram, and emits a single
+// JSON report line plus a human readable summary.
+//
+// Usage: wsperf_client [uri] [connections] [message_bytes] [msgs_per_conn]
+// Defaults: ws://localhost:9002 10 64 1000
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef websocketpp::client<websocketpp::config::asio_client> client;
+typedef websocketpp::config::asio_client::message_type::ptr message_ptr;
+typedef std::chrono::steady_clock clock_type;
+
+using websocketpp::lib::bind;
+namespace ph = websocketpp::lib::placeholders;
+
+/// Log-bucketed latency histogram (microseconds)
+/**
+ * Buckets are ~4% wide (64 sub-buckets per power of two), bounded memory
+ * regardless of sample count, like HDR histograms. Percentiles are read by
+ * walking the cumulative counts.
+ */
+class latency_histogram {
+public:
+    latency_histogram() : m_count(0), m_max(0) {}
+
+    void record(double us) {
+        m_count++;
+        if (us > m_max) {
+            m_max = us;
+        }
+        m_buckets[bucket(us)]++;
+    }
+
+    double percentile(double p) const {
+        size_t target = static_cast<size_t>(m_count*p);
+        size_t seen = 0;
+        for (std::map<int,size_t>::const_iterator it = m_buckets.begin();
+             it != m_buckets.end(); ++it)
+        {
+            seen += it->second;
+            if (seen >= target) {
+                return value(it->first);
+            }
+        }
+        return m_max;
+    }
+
+    size_t count() const { return m_count; }
+    double max() const { return m_max; }
+
+private:
+    static int bucket(double us) {
+        if (us < 1) { us = 1; }
+        // 64 sub-buckets per factor of two
+        return static_cast<int>(64.0*std::log(us)/std::log(2.0));
+    }
+
+    static double value(int b) {
+        return std::pow(2.0,b/64.0);
+    }
+
+    std::map<int,size_t> m_buckets;
+    size_t m_count;
+    double m_max;
+};
+
+struct conn_state {
+    clock_type::time_point sent_at;
+    int remaining;
+};
+
+class load_harness {
+public:
+    load_harness(std::string uri, int connections, int msg_bytes,
+        int msgs_per_conn)
+      : m_uri(uri)
+      , m_connections(connections)
+      , m_msgs_per_conn(msgs_per_conn)
+      , m_payload(msg_bytes,'w')
+      , m_open(0)
+      , m_done(0)
+      , m_errors(0)
+    {
+        m_client.clear_access_channels(websocketpp::log::alevel::all);
+        m_client.clear_error_channels(websocketpp::log::elevel::all);
+        m_client.init_asio();
+        m_client.set_open_handler(bind(&load_harness::on_open,this,ph::_1));
+        m_client.set_message_handler(bind(&load_harness::on_message,this,
+            ph::_1,ph::_2));
+        m_client.set_fail_handler(bind(&load_harness::on_fail,this,ph::_1));
+        m_client.set_close_handler(bind(&load_harness::on_close,this,
+            ph::_1));
+    }
+
+    int run() {
+        for (int i = 0; i < m_connections; i++) {
+            websocketpp::lib::error_code ec;
+            client::connection_ptr con = m_client.get_connection(m_uri,ec);
+            if (ec) {
+                std::fprintf(stderr,"connect error: %s\n",
+                    ec.message().c_str());
+                return 1;
+            }
+            m_client.connect(con);
+        }
+
+        m_start = clock_type::now();
+        m_client.run();
+        double seconds = std::chrono::duration_cast<
+            std::chrono::duration<double> >(
+            clock_type::now()-m_start).count();
+
+        report(seconds);
+        return m_errors > 0 ? 1 : 0;
+    }
+
+private:
+    void on_open(websocketpp::connection_hdl hdl) {
+        conn_state & st = m_states[hdl.lock().get()];
+        st.remaining = m_msgs_per_conn;
+        m_open++;
+        send_next(hdl,st);
+    }
+
+    /// A connection closed. Normal completions already counted themselves;
+    /// a close with messages still outstanding is an abnormal drop.
+    void on_close(websocketpp::connection_hdl hdl) {
+        conn_state & st = m_states[hdl.lock().get()];
+        if (st.remaining > 0) {
+            st.remaining = 0;
+            m_errors++;
+            finished_one();
+        }
+    }
+
+    void on_fail(websocketpp::connection_hdl hdl) {
+        client::connection_ptr con = m_client.get_con_from_hdl(hdl);
+        if (m_errors == 0) {
+            std::fprintf(stderr,"connection failed: %s\n",
+                con->get_ec().message().c_str());
+        }
+        m_errors++;
+        finished_one();
+    }
+
+    void send_next(websocketpp::connection_hdl hdl, conn_state & st) {
+        st.sent_at = clock_type::now();
+        websocketpp::lib::error_code ec;
+        m_client.send(hdl,m_payload,websocketpp::frame::opcode::BINARY,ec);
+        if (ec) {
+            st.remaining = 0;
+            m_errors++;
+            finished_one();
+        }
+    }
+
+    void on_message(websocketpp::connection_hdl hdl, message_ptr) {
+        conn_state & st = m_states[hdl.lock().get()];
+        double us = std::chrono::duration_cast<
+            std::chrono::duration<double,std::micro> >(
+            clock_type::now()-st.sent_at).count();
+        m_hist.record(us);
+
+        if (--st.remaining > 0) {
+            send_next(hdl,st);
+        } else {
+            // count completion here; on_close sees remaining == 0 and does
+            // not double count
+            websocketpp::lib::error_code ec;
+            m_client.close(hdl,websocketpp::close::status::normal,"",ec);
+            finished_one();
+        }
+    }
+
+    void finished_one() {
+        if (++m_done == m_connections) {
+            m_client.stop();
+        }
+    }
+
+    void report(double seconds) {
+        size_t total = m_hist.count();
+        double mbps = total*m_payload.size()*2/seconds/1e6; // echo: both ways
+        double p50 = m_hist.percentile(0.50);
+        double p90 = m_hist.percentile(0.90);
+        double p99 = m_hist.percentile(0.99);
+        double p999 = m_hist.percentile(0.999);
+
+        std::printf("connections: %d  message bytes: %zu  echoes: %zu"
+            "  errors: %d\n",m_connections,m_payload.size(),total,m_errors);
+        std::printf("duration: %.2fs  rate: %.0f msg/s  %.2f MB/s\n",
+            seconds,total/seconds,mbps);
+        std::printf("rtt us: p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f"
+            " max=%.0f\n",p50,p90,p99,p999,m_hist.max());
+
+        // machine readable report, one JSON line on its own
+        std::printf("{\"connections\":%d,\"msg_bytes\":%zu,"
+            "\"echoes\":%zu,\"errors\":%d,\"duration_s\":%.3f,"
+            "\"rate_msg_s\":%.1f,\"throughput_mb_s\":%.3f,"
+            "\"rtt_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,"
+            "\"p999\":%.1f,\"max\":%.1f}}\n",
+            m_connections,m_payload.size(),total,m_errors,seconds,
+            total/seconds,mbps,p50,p90,p99,p999,m_hist.max());
+    }
+
+    client m_client;
+    std::string m_uri;
+    int m_connections;
+    int m_msgs_per_conn;
+    std::string m_payload;
+
+    std::map<void *,conn_state> m_states;
+    latency_histogram m_hist;
+    clock_type::time_point m_start;
+    int m_open;
+    int m_done;
+    int m_errors;
+};
+
+int main(int argc, char * argv[]) {
+    std::string uri = "ws://localhost:9002";
+    int connections = 10;
+    int msg_bytes = 64;
+    int msgs_per_conn = 1000;
+
+    if (argc > 1) { uri = argv[1]; }
+    if (argc > 2) { connections = std::atoi(argv[2]); }
+    if (argc > 3) { msg_bytes = std::atoi(argv[3]); }
+    if (argc > 4) { msgs_per_conn = std::atoi(argv[4]); }
+
+    load_harness harness(uri,connections,msg_bytes,msgs_per_conn);
+    return harness.run();
+}
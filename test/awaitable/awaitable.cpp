@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE awaitable
+#include <boost/test/unit_test.hpp>
+
+// Smoke coverage for the C++20 awaitable layer: one coroutine accepts
+// a connection, echoes its messages, and closes, driven end to end over
+// loopback. The suite is built only by toolchains with coroutine
+// support (see the SConscript gate); on older standards the file
+// reduces to a single always-passing placeholder so the harness shape
+// stays uniform.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+#include <websocketpp/awaitable.hpp>
+
+#include <boost/asio.hpp>
+
+#include <string>
+#include <thread>
+
+typedef websocketpp::server<websocketpp::config::asio> server;
+
+using boost::asio::ip::tcp;
+
+static uint16_t const test_port = 9341;
+
+/// The coroutine under test: accept, read, echo, until close
+static websocketpp::awaitable::detached_task echo_session(
+    server & ep, websocketpp::awaitable::acceptor<server> & acc,
+    int * served)
+{
+    auto raw = co_await acc.accept();
+    websocketpp::awaitable::connection<server> con(ep,raw);
+    while (auto msg = co_await con.read_message()) {
+        ++*served;
+        auto ec = co_await con.send(msg->get_payload(),msg->get_opcode());
+        if (ec) {
+            break;
+        }
+        if (msg->get_payload() == "bye") {
+            co_await con.close(websocketpp::close::status::normal,"done");
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( coroutine_echo_session ) {
+    server ep;
+    ep.set_access_channels(websocketpp::log::alevel::none);
+    ep.set_error_channels(websocketpp::log::elevel::none);
+    ep.init_asio();
+    websocketpp::awaitable::acceptor<server> acc(ep);
+    int served = 0;
+    echo_session(ep,acc,&served);
+    ep.listen(boost::asio::ip::tcp::endpoint(
+        boost::asio::ip::address_v4::loopback(),test_port));
+    ep.start_accept();
+    std::thread th([&ep]{ ep.run(); });
+
+    // raw loopback client: upgrade, three echoes, "bye", server close
+    boost::asio::io_service ios;
+    tcp::socket sock(ios);
+    boost::system::error_code ec;
+    sock.connect(tcp::endpoint(
+        boost::asio::ip::address_v4::loopback(),test_port),ec);
+    BOOST_REQUIRE( !ec );
+    std::string req =
+        "GET / HTTP/1.1\r\nHost: t\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n";
+    boost::asio::write(sock,boost::asio::buffer(req),ec);
+    std::string resp;
+    char ch;
+    while (resp.find("\r\n\r\n") == std::string::npos) {
+        BOOST_REQUIRE_EQUAL( boost::asio::read(sock,
+            boost::asio::buffer(&ch,1),ec), 1u );
+        resp += ch;
+    }
+    BOOST_REQUIRE_EQUAL( resp.compare(9,3,"101"), 0 );
+
+    struct frame_io {
+        static void send(tcp::socket & s, std::string const & payload) {
+            std::string out;
+            out += static_cast<char>(0x81);
+            out += static_cast<char>(0x80 | payload.size());
+            out.append("\x01\x02\x03\x04",4);
+            for (size_t i = 0; i < payload.size(); i++) {
+                out += static_cast<char>(payload[i]
+                    ^ "\x01\x02\x03\x04"[i % 4]);
+            }
+            boost::system::error_code fec;
+            boost::asio::write(s,boost::asio::buffer(out),fec);
+        }
+        static bool recv(tcp::socket & s, uint8_t & opcode,
+            std::string & payload)
+        {
+            boost::system::error_code fec;
+            uint8_t hdr[2];
+            if (boost::asio::read(s,boost::asio::buffer(hdr,2),fec)
+                != 2)
+            {
+                return false;
+            }
+            opcode = hdr[0] & 0x0f;
+            size_t len = hdr[1] & 0x7f;
+            payload.resize(len);
+            if (len > 0 && boost::asio::read(s,
+                boost::asio::buffer(&payload[0],len),fec) != len)
+            {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    std::string reply;
+    uint8_t op;
+    for (int i = 0; i < 3; i++) {
+        std::string msg = "echo-" + std::to_string(i);
+        frame_io::send(sock,msg);
+        BOOST_REQUIRE( frame_io::recv(sock,op,reply) );
+        BOOST_CHECK_EQUAL( reply, msg );
+    }
+
+    // "bye": the coroutine echoes it, then initiates the close
+    frame_io::send(sock,"bye");
+    BOOST_REQUIRE( frame_io::recv(sock,op,reply) );
+    BOOST_CHECK_EQUAL( reply, "bye" );
+    BOOST_REQUIRE( frame_io::recv(sock,op,reply) );
+    BOOST_CHECK_EQUAL( static_cast<int>(op), 0x8 );
+
+    BOOST_CHECK_EQUAL( served, 4 );
+
+    ep.stop();
+    th.join();
+}
+
+#else // no coroutine support
+
+BOOST_AUTO_TEST_CASE( coroutines_unavailable ) {
+    // the awaitable layer requires C++20 coroutines; nothing to smoke
+    // test on this toolchain
+    BOOST_CHECK( true );
+}
+
+#endif
@@ -212,3 +212,59 @@ BOOST_AUTO_TEST_CASE( basic_text_message ) {
     BOOST_CHECK( run_server_test(input) == output);
 }
 */
+
+struct fixed_processor_config : public websocketpp::config::core {
+    typedef websocketpp::processor::hybi13<fixed_processor_config>
+        fixed_processor_type;
+};
+
+typedef websocketpp::server<fixed_processor_config> fixed_server;
+
+void fixed_echo_func(fixed_server* s, websocketpp::connection_hdl hdl,
+    fixed_server::message_ptr msg)
+{
+    s->send(hdl, msg->get_payload(), msg->get_opcode());
+}
+
+std::string run_fixed_server_test(fixed_server & s, std::string input) {
+    fixed_server::connection_ptr con;
+    std::stringstream output;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    s.register_ostream(&output);
+
+    con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+
+    return output.str();
+}
+
+BOOST_AUTO_TEST_CASE( fixed_processor_websocket_request ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    fixed_server s;
+    s.set_message_handler(bind(&fixed_echo_func,&s,::_1,::_2));
+
+    BOOST_CHECK_EQUAL(run_fixed_server_test(s,input), output);
+}
+
+BOOST_AUTO_TEST_CASE( fixed_processor_rejects_other_versions ) {
+    // hybi08 (Sec-WebSocket-Version: 8) must be refused when the processor
+    // is fixed to hybi13
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 8\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    fixed_server s;
+    std::string output = run_fixed_server_test(s,input);
+
+    BOOST_CHECK(output.find("101 Switching Protocols") == std::string::npos);
+    BOOST_CHECK(output.find("Sec-WebSocket-Version: 13") != std::string::npos);
+}
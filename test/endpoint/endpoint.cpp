@@ -99,3 +99,89 @@ BOOST_AUTO_TEST_CASE( endpoint_extensions ) {
     
     BOOST_CHECK( s.is_server() == true );
 }
+
+// generation-counted fast handle lifecycle: live resolution, stale
+// rejection, and slot reuse safety
+
+BOOST_AUTO_TEST_CASE( fast_handle_lifecycle ) {
+    typedef websocketpp::server<websocketpp::config::core> server;
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    std::stringstream out;
+    s.register_ostream(&out);
+
+    server::connection_ptr con = s.get_connection();
+    websocketpp::lib::error_code ec;
+    websocketpp::fast_connection_hdl h =
+        s.get_fast_handle(con->get_handle(),ec);
+    BOOST_CHECK( !ec );
+
+    // resolves to the live connection: the send reaches it and fails
+    // with invalid_state (not yet open), not bad_connection
+    s.send(h,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::invalid_state) );
+
+    // a wrong generation is stale
+    websocketpp::fast_connection_hdl stale(h.slot,h.generation+1);
+    s.send(stale,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::bad_connection) );
+
+    // an out-of-range slot is stale
+    websocketpp::fast_connection_hdl oob(1000000,1);
+    s.send(oob,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::bad_connection) );
+
+    // a default-constructed handle never resolves
+    websocketpp::fast_connection_hdl invalid;
+    s.send(invalid,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::bad_connection) );
+}
+
+BOOST_AUTO_TEST_CASE( fast_handle_slot_reuse ) {
+    typedef websocketpp::server<websocketpp::config::core> server;
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    std::stringstream out;
+    s.register_ostream(&out);
+
+    server::connection_ptr con = s.get_connection();
+    websocketpp::lib::error_code ec;
+    websocketpp::fast_connection_hdl h =
+        s.get_fast_handle(con->get_handle(),ec);
+    BOOST_REQUIRE( !ec );
+
+    // termination deregisters the connection and frees the slot
+    con->terminate(websocketpp::lib::error_code());
+    s.send(h,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::bad_connection) );
+
+    // the next connection reuses the slot under a bumped generation;
+    // the old handle still cannot touch the new occupant
+    server::connection_ptr con2 = s.get_connection();
+    websocketpp::fast_connection_hdl h2 =
+        s.get_fast_handle(con2->get_handle(),ec);
+    BOOST_REQUIRE( !ec );
+    BOOST_CHECK_EQUAL( h2.slot, h.slot );
+    BOOST_CHECK( h2.generation != h.generation );
+
+    s.send(h,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::bad_connection) );
+    s.send(h2,"x",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL( ec,
+        websocketpp::error::make_error_code(
+            websocketpp::error::invalid_state) );
+}
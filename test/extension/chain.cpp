@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE extension_chain
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/extensions/chain.hpp>
+#include <websocketpp/extensions/permessage_deflate/disabled.hpp>
+
+// A minimal stage that reverses the payload, negotiated under a
+// caller-supplied token, modeling the chain stage interface.
+template <char const * token>
+struct reverse_ext {
+    reverse_ext() : enabled(false) {}
+    bool is_implemented() const { return true; }
+    bool is_enabled() const { return enabled; }
+    websocketpp::err_str_pair negotiate_token(std::string const & name,
+        websocketpp::http::attribute_list const &)
+    {
+        namespace xerr = websocketpp::extensions::error;
+        if (name != token) {
+            return websocketpp::err_str_pair(
+                xerr::make_error_code(xerr::unknown_token),std::string());
+        }
+        enabled = true;
+        return websocketpp::err_str_pair(websocketpp::lib::error_code(),
+            std::string(token));
+    }
+    bool should_compress(std::string const &) const { return true; }
+    websocketpp::lib::error_code compress(std::string const & in,
+        std::string & out)
+    {
+        out.append(in.rbegin(),in.rend());
+        return websocketpp::lib::error_code();
+    }
+    websocketpp::lib::error_code decompress(uint8_t const * buf, size_t len,
+        std::string & out)
+    {
+        for (size_t i = len; i > 0; i--) {
+            out += static_cast<char>(buf[i-1]);
+        }
+        return websocketpp::lib::error_code();
+    }
+    websocketpp::lib::error_code decompress_validated(uint8_t const * buf,
+        size_t len, std::string & out,
+        websocketpp::utf8_validator::validator &)
+    {
+        return decompress(buf,len,out);
+    }
+    void set_dictionary(std::string const & d) { dictionary = d; }
+    void set_write_reset_interval(size_t, size_t) {}
+    void set_level_controller(
+        websocketpp::extensions::permessage_deflate::level_controller::ptr) {}
+    websocketpp::lib::error_code finish_decompress(std::string &) {
+        return websocketpp::lib::error_code();
+    }
+    bool enabled;
+    std::string dictionary;
+};
+
+extern char const token_a[] = "x-rev-a";
+extern char const token_b[] = "x-rev-b";
+
+typedef websocketpp::extensions::chain<
+    reverse_ext<token_a>,
+    reverse_ext<token_b>
+> chain_type;
+
+BOOST_AUTO_TEST_CASE( chain_negotiates_by_token ) {
+    chain_type chain;
+    websocketpp::http::attribute_list attrs;
+
+    BOOST_CHECK( chain.is_implemented() );
+    BOOST_CHECK( !chain.is_enabled() );
+
+    websocketpp::err_str_pair ret = chain.negotiate_token("x-rev-b",attrs);
+    BOOST_CHECK( !ret.first );
+    BOOST_CHECK_EQUAL( ret.second, "x-rev-b" );
+    BOOST_CHECK( chain.is_enabled() );
+    BOOST_CHECK( !chain.first().is_enabled() );
+    BOOST_CHECK( chain.rest().is_enabled() );
+}
+
+BOOST_AUTO_TEST_CASE( chain_reports_unknown_token ) {
+    chain_type chain;
+    websocketpp::http::attribute_list attrs;
+
+    websocketpp::err_str_pair ret = chain.negotiate_token("x-nope",attrs);
+    BOOST_CHECK_EQUAL( ret.first,
+        websocketpp::extensions::error::make_error_code(
+            websocketpp::extensions::error::unknown_token) );
+    BOOST_CHECK( !chain.is_enabled() );
+}
+
+BOOST_AUTO_TEST_CASE( chain_folds_and_reverses ) {
+    chain_type chain;
+    websocketpp::http::attribute_list attrs;
+
+    chain.negotiate_token("x-rev-a",attrs);
+    chain.negotiate_token("x-rev-b",attrs);
+
+    // both stages reverse, so the composition is the identity transform
+    std::string wire;
+    BOOST_CHECK( !chain.compress("asymmetric",wire) );
+    BOOST_CHECK_EQUAL( wire, "asymmetric" );
+
+    // single enabled stage transforms without an intermediate copy
+    chain_type half;
+    half.negotiate_token("x-rev-a",attrs);
+    wire.clear();
+    BOOST_CHECK( !half.compress("abc",wire) );
+    BOOST_CHECK_EQUAL( wire, "cba" );
+
+    std::string plain;
+    BOOST_CHECK( !half.decompress(
+        reinterpret_cast<uint8_t const *>(wire.data()),wire.size(),plain) );
+    BOOST_CHECK_EQUAL( plain, "abc" );
+}
+
+BOOST_AUTO_TEST_CASE( chain_forwards_dictionary ) {
+    chain_type chain;
+    chain.set_dictionary("common-prefix");
+    BOOST_CHECK_EQUAL( chain.first().dictionary, "common-prefix" );
+    BOOST_CHECK_EQUAL( chain.rest().dictionary, "common-prefix" );
+}
+
+BOOST_AUTO_TEST_CASE( chain_of_disabled_is_unimplemented ) {
+    typedef websocketpp::extensions::chain<
+        websocketpp::extensions::permessage_deflate::disabled<int>,
+        websocketpp::extensions::permessage_deflate::disabled<int>
+    > disabled_chain;
+
+    disabled_chain chain;
+    websocketpp::http::attribute_list attrs;
+
+    BOOST_CHECK( !chain.is_implemented() );
+    BOOST_CHECK_EQUAL( chain.negotiate_token("permessage-deflate",attrs).first,
+        websocketpp::extensions::error::make_error_code(
+            websocketpp::extensions::error::unknown_token) );
+}
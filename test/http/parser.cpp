@@ -919,3 +919,52 @@ BOOST_AUTO_TEST_CASE( write_request_with_body ) {
     
     BOOST_CHECK( r.raw() == raw );
 }
+
+BOOST_AUTO_TEST_CASE( arena_parse_mode ) {
+    websocketpp::http::parser::request r;
+    r.set_arena_parse(true);
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\nUser-Agent: foo\r\nX-Dup: a\r\nx-dup: b\r\n\r\n";
+    BOOST_CHECK_EQUAL( r.consume(raw.c_str(),raw.size()), raw.size() );
+    BOOST_CHECK( r.ready() );
+
+    // zero copy access
+    websocketpp::utility::string_ref ref = r.get_header_ref(
+        websocketpp::utility::string_ref("Host",4));
+    BOOST_CHECK_EQUAL( ref.str(), "www.example.com" );
+
+    // case insensitive
+    ref = r.get_header_ref(websocketpp::utility::string_ref("hOsT",4));
+    BOOST_CHECK_EQUAL( ref.str(), "www.example.com" );
+
+    // classic accessor still works (lazy materialization)
+    BOOST_CHECK_EQUAL( r.get_header("User-Agent"), "foo" );
+
+    // duplicate headers joined with append semantics
+    BOOST_CHECK_EQUAL( r.get_header("X-Dup"), "a, b" );
+
+    // missing header
+    BOOST_CHECK( r.get_header_ref(
+        websocketpp::utility::string_ref("Missing",7)).empty() );
+
+    // mutation after arena parse materializes and behaves as before
+    r.replace_header("Host","other");
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "other" );
+    BOOST_CHECK_EQUAL( r.get_header("User-Agent"), "foo" );
+}
+
+BOOST_AUTO_TEST_CASE( arena_parse_split_consume ) {
+    // headers arriving in fragments must parse identically in arena mode
+    websocketpp::http::parser::request r;
+    r.set_arena_parse(true);
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\nA-Header: a value with spaces\r\n\r\n";
+    for (size_t i = 0; i < raw.size(); i += 7) {
+        size_t n = (raw.size()-i < 7 ? raw.size()-i : 7);
+        r.consume(raw.c_str()+i,n);
+    }
+    BOOST_CHECK( r.ready() );
+    BOOST_CHECK_EQUAL( r.get_header_ref(
+        websocketpp::utility::string_ref("A-Header",8)).str(),
+        "a value with spaces" );
+}
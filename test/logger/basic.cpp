@@ -78,4 +78,67 @@ BOOST_AUTO_TEST_CASE( basic_concurrency ) {
     logger.write(websocketpp::log::alevel::devel,"devel");
     //std::cout << "|" << out.str() << "|" << std::endl;
     BOOST_CHECK( out.str().size() > 0 );
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE( static_filter_template ) {
+    typedef websocketpp::log::basic<websocketpp::concurrency::basic,
+        websocketpp::log::elevel,
+        websocketpp::log::elevel::all ^ websocketpp::log::elevel::devel>
+        filtered_logger;
+
+    std::stringstream out;
+    filtered_logger logger(0xffffffff,&out);
+    logger.set_channels(0xffffffff);
+
+    // filtered channel: compile time constant false, nothing written
+    BOOST_CHECK( !logger.static_test(websocketpp::log::elevel::devel) );
+    logger.write(websocketpp::log::elevel::devel,"filtered out");
+    BOOST_CHECK_EQUAL( out.str(), "" );
+
+    // unfiltered channel still writes
+    BOOST_CHECK( logger.static_test(websocketpp::log::elevel::rerror) );
+    logger.write(websocketpp::log::elevel::rerror,"visible");
+    BOOST_CHECK( out.str().find("visible") != std::string::npos );
+}
+
+#include <websocketpp/logger/async.hpp>
+
+BOOST_AUTO_TEST_CASE( async_logger_basic ) {
+    typedef websocketpp::log::async<websocketpp::concurrency::basic,
+        websocketpp::log::elevel> async_logger;
+
+    std::stringstream out;
+    async_logger logger(0xffffffff,&out);
+    logger.set_channels(0xffffffff);
+
+    logger.write(websocketpp::log::elevel::rerror,"first message");
+    logger.write(websocketpp::log::elevel::rerror,std::string("second"));
+    logger.flush();
+
+    BOOST_CHECK( out.str().find("first message") != std::string::npos );
+    BOOST_CHECK( out.str().find("second") != std::string::npos );
+    BOOST_CHECK( out.str().find("error") != std::string::npos );
+    BOOST_CHECK_EQUAL( logger.get_dropped_count(), 0u );
+
+    // dynamic filtering matches basic
+    logger.clear_channels(websocketpp::log::elevel::devel);
+    logger.write(websocketpp::log::elevel::devel,"hidden");
+    logger.flush();
+    BOOST_CHECK( out.str().find("hidden") == std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( async_logger_static_filter ) {
+    typedef websocketpp::log::async<websocketpp::concurrency::basic,
+        websocketpp::log::elevel,
+        websocketpp::log::elevel::all ^ websocketpp::log::elevel::devel>
+        filtered_async;
+
+    std::stringstream out;
+    filtered_async logger(0xffffffff,&out);
+    logger.set_channels(0xffffffff);
+    BOOST_CHECK( !logger.static_test(websocketpp::log::elevel::devel) );
+    logger.write(websocketpp::log::elevel::devel,"filtered");
+    logger.write(websocketpp::log::elevel::rerror,"kept");
+    logger.flush();
+    BOOST_CHECK( out.str().find("filtered") == std::string::npos );
+    BOOST_CHECK( out.str().find("kept") != std::string::npos );
+}
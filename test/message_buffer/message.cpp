@@ -70,3 +70,95 @@ BOOST_AUTO_TEST_CASE( recycle ) {
 	BOOST_CHECK(s->recycled == true);
 }
 
+
+BOOST_AUTO_TEST_CASE( shared_payload ) {
+	typedef websocketpp::message_buffer::message<stub> message_type;
+	typedef stub<message_type> stub_type;
+
+	stub_type::ptr s(new stub_type());
+	message_type::ptr in(new message_type(s,websocketpp::frame::opcode::TEXT,500));
+	message_type::ptr out(new message_type(s));
+
+	in->set_payload("shared payload bytes");
+	out->set_shared_payload(in);
+
+	// out's payload is in's payload, not a copy
+	BOOST_CHECK(&out->get_payload() == &in->get_payload());
+	BOOST_CHECK_EQUAL(out->get_payload(), "shared payload bytes");
+
+	// the reference is dropped when a payload is set directly
+	out->set_payload("own payload");
+	BOOST_CHECK(&out->get_payload() != &in->get_payload());
+	BOOST_CHECK_EQUAL(out->get_payload(), "own payload");
+}
+
+BOOST_AUTO_TEST_CASE( steal_payload ) {
+	typedef websocketpp::message_buffer::message<stub> message_type;
+	typedef stub<message_type> stub_type;
+
+	stub_type::ptr s(new stub_type());
+	message_type::ptr msg(new message_type(s,websocketpp::frame::opcode::TEXT,500));
+
+	msg->set_payload("movable bytes");
+	std::string stolen = msg->steal_payload();
+
+	BOOST_CHECK_EQUAL(stolen, "movable bytes");
+	BOOST_CHECK_EQUAL(msg->get_payload(), "");
+
+	// a shared payload has another owner; stealing copies instead
+	message_type::ptr out(new message_type(s));
+	msg->set_payload("shared again");
+	out->set_shared_payload(msg);
+	BOOST_CHECK_EQUAL(out->steal_payload(), "shared again");
+	BOOST_CHECK_EQUAL(msg->get_payload(), "shared again");
+}
+
+#ifdef _WEBSOCKETPP_RVALUE_REFERENCES_
+BOOST_AUTO_TEST_CASE( move_set_payload ) {
+	typedef websocketpp::message_buffer::message<stub> message_type;
+	typedef stub<message_type> stub_type;
+
+	stub_type::ptr s(new stub_type());
+	message_type::ptr msg(new message_type(s,websocketpp::frame::opcode::TEXT,500));
+
+	std::string big(1000,'x');
+	char const * data = big.data();
+	msg->set_payload(std::move(big));
+
+	// the buffer was moved, not copied
+	BOOST_CHECK(msg->get_payload().data() == data);
+	BOOST_CHECK_EQUAL(msg->get_payload().size(), 1000u);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( borrowed_payload_view ) {
+	typedef websocketpp::message_buffer::message<stub> message_type;
+	typedef stub<message_type> stub_type;
+
+	stub_type::ptr s(new stub_type());
+	message_type::ptr msg(new message_type(s,websocketpp::frame::opcode::TEXT,500));
+
+	char buf[] = "borrowed bytes";
+	msg->set_payload_view(buf,14);
+
+	BOOST_CHECK(msg->is_borrowed());
+	BOOST_CHECK(msg->payload_data() == buf);
+	BOOST_CHECK_EQUAL(msg->payload_size(), 14u);
+
+	// an unretained view reads as empty once released
+	msg->release_view();
+	BOOST_CHECK(!msg->is_borrowed());
+	BOOST_CHECK_EQUAL(msg->payload_size(), 0u);
+
+	// retain converts the view into an owned copy
+	msg->set_payload_view(buf,14);
+	msg->retain();
+	buf[0] = 'X';
+	BOOST_CHECK(!msg->is_borrowed());
+	BOOST_CHECK_EQUAL(msg->get_payload(), "borrowed bytes");
+
+	// get_payload materializes implicitly
+	msg->set_payload_view(buf,14);
+	BOOST_CHECK_EQUAL(msg->get_payload(), "Xorrowed bytes");
+	BOOST_CHECK(!msg->is_borrowed());
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions are met:
@@ -11,10 +11,10 @@
  *     * Neither the name of the WebSocket++ Project nor the
  *       names of its contributors may be used to endorse or promote products
  *       derived from this software without specific prior written permission.
- * 
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
- * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
- * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
  * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
  * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
  * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
@@ -22,135 +22,74 @@
  * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- * 
  */
 //#define BOOST_TEST_DYN_LINK
-#define BOOST_TEST_MODULE hybi_00_processor
+#define BOOST_TEST_MODULE message_pool
 #include <boost/test/unit_test.hpp>
 
 #include <iostream>
 #include <string>
 
-#include <websocketpp/processors/hybi00.hpp>
-#include <websocketpp/http/request.hpp>
-#include <websocketpp/http/response.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+#include <websocketpp/message_buffer/pool.hpp>
 
+typedef websocketpp::message_buffer::message<
+    websocketpp::message_buffer::pool::con_msg_manager> message_type;
+typedef websocketpp::message_buffer::pool::con_msg_manager<message_type>
+    pool_manager;
 
-BOOST_AUTO_TEST_CASE( exact_match ) {
-    websocketpp::http::parser::request r;
-    websocketpp::http::parser::response response;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nOrigin: http://example.com\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
-    
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","WjN}|M(6");
-    
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(p.validate_handshake(r));
-    
-    websocketpp::uri_ptr u;
-    bool exception;
-    
-    try {
-    	u = p.get_uri(r);
-    } catch (const websocketpp::uri_exception& e) {
-    	exception = true;
-    }
-    
-    BOOST_CHECK(exception == false);
-    BOOST_CHECK(u->get_secure() == false);
-    BOOST_CHECK(u->get_host() == "www.example.com");
-    BOOST_CHECK(u->get_resource() == "/");
-    BOOST_CHECK(u->get_port() == websocketpp::URI_DEFAULT_PORT);
-    
-    p.process_handshake(r,response);
-    
-    BOOST_CHECK(response.get_header("Connection") == "Upgrade");
-    BOOST_CHECK(response.get_header("Upgrade") == "websocket");
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Origin") == "http://example.com");
-        
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Location") == "ws://www.example.com/");
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Key3") == "n`9eBk9z$R8pOtVb");
-}
+BOOST_AUTO_TEST_CASE( recycle_and_reuse ) {
+    pool_manager::ptr manager(new pool_manager());
 
-BOOST_AUTO_TEST_CASE( non_get_method ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    
-    std::string handshake = "POST / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
-    
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
-    
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
-}
+    message_type::ptr msg = manager->get_message(
+        websocketpp::frame::opcode::TEXT,128);
+    message_type * raw = msg.get();
+    msg->append_payload("some payload data");
+
+    BOOST_CHECK_EQUAL( manager->pool_size(), 0u );
+    msg.reset();
+    BOOST_CHECK_EQUAL( manager->pool_size(), 1u );
 
-BOOST_AUTO_TEST_CASE( old_http_version ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    
-    std::string handshake = "GET / HTTP/1.0\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
-    
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
-    
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+    // the same object comes back, reset, with capacity retained
+    message_type::ptr reused = manager->get_message(
+        websocketpp::frame::opcode::BINARY,0);
+    BOOST_CHECK( reused.get() == raw );
+    BOOST_CHECK_EQUAL( manager->pool_size(), 0u );
+    BOOST_CHECK( reused->get_payload().empty() );
+    BOOST_CHECK( reused->get_opcode() == websocketpp::frame::opcode::BINARY );
+    BOOST_CHECK( reused->get_payload().capacity() >= 17 );
 }
 
-BOOST_AUTO_TEST_CASE( missing_handshake_key1 ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\n\r\n";
-    
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
-    
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+BOOST_AUTO_TEST_CASE( capacity_cap ) {
+    // messages whose payload grew beyond the cap are not pooled
+    pool_manager::ptr manager(new pool_manager(32,1024));
+
+    message_type::ptr msg = manager->get_message(
+        websocketpp::frame::opcode::TEXT,0);
+    msg->get_raw_payload().assign(4096,'x');
+    msg.reset();
+    BOOST_CHECK_EQUAL( manager->pool_size(), 0u );
 }
 
-BOOST_AUTO_TEST_CASE( missing_handshake_key2 ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
-    
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
-    
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+BOOST_AUTO_TEST_CASE( pool_size_cap ) {
+    pool_manager::ptr manager(new pool_manager(2,65536));
+
+    message_type::ptr a = manager->get_message();
+    message_type::ptr b = manager->get_message();
+    message_type::ptr c = manager->get_message();
+    a.reset();
+    b.reset();
+    c.reset();
+    BOOST_CHECK_EQUAL( manager->pool_size(), 2u );
 }
 
-BOOST_AUTO_TEST_CASE( bad_host ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    websocketpp::uri_ptr u;
-    bool exception = false;
-    
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com:70000\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
-    
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
-    
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
-    
-    try {
-    	u = p.get_uri(r);
-    } catch (const websocketpp::uri_exception& e) {
-    	exception = true;
-    }
-    
-    BOOST_CHECK(exception == true);
-}
\ No newline at end of file
+BOOST_AUTO_TEST_CASE( manager_destroyed_first ) {
+    // outstanding messages survive their manager and free cleanly
+    pool_manager::ptr manager(new pool_manager());
+    message_type::ptr msg = manager->get_message(
+        websocketpp::frame::opcode::TEXT,64);
+    manager.reset();
+    msg->append_payload("still alive");
+    BOOST_CHECK_EQUAL( msg->get_payload(), "still alive" );
+    msg.reset(); // recycle refused (manager gone), freed normally
+}
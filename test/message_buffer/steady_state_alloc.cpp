@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE steady_state_alloc
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <websocketpp/base64/base64.hpp>
+#include <websocketpp/sha1/sha1.hpp>
+
+#include <websocketpp/config/core.hpp>
+#include <websocketpp/config/core_client.hpp>
+#include <websocketpp/client.hpp>
+#include <websocketpp/server.hpp>
+
+// Global operator new hook: every heap allocation in the process is
+// counted, so nothing the library does per message can hide. The guard
+// below asserts the count stays flat across the steady-state window;
+// it fails the build when a change reintroduces per-message allocation
+// on the message paths that pooling, the message cache, and small
+// buffer reuse currently keep allocation free.
+
+static long g_allocs = 0;
+
+void * operator new(std::size_t size) {
+    g_allocs++;
+    void * p = std::malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void * p) throw() {
+    std::free(p);
+}
+void operator delete(void * p, std::size_t) throw() {
+    std::free(p);
+}
+
+using websocketpp::lib::bind;
+using websocketpp::lib::placeholders::_1;
+using websocketpp::lib::placeholders::_2;
+
+typedef websocketpp::server<websocketpp::config::core> server;
+typedef websocketpp::client<websocketpp::config::core_client> client;
+typedef server::message_ptr message_ptr;
+
+/// Output sink that discards every byte without ever allocating
+struct null_streambuf : public std::streambuf {
+    int overflow(int c) {
+        return c;
+    }
+    std::streamsize xsputn(char const *, std::streamsize n) {
+        return n;
+    }
+};
+
+static std::string const handshake =
+    "GET / HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: upgrade\r\n"
+    "Upgrade: websocket\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "\r\n";
+
+void echo_func(server * s, websocketpp::connection_hdl hdl, message_ptr msg) {
+    s->send(hdl,msg->get_payload(),msg->get_opcode());
+}
+
+void drop_func(server *, websocketpp::connection_hdl, message_ptr) {}
+
+/// One masked text frame carrying "ping!" (mask 0x00000000 keeps the
+/// payload bytes readable; a zero mask is legal)
+static std::string masked_frame() {
+    std::string f;
+    f += static_cast<char>(0x81);
+    f += static_cast<char>(0x85);
+    f.append(4,static_cast<char>(0x00));
+    f += "ping!";
+    return f;
+}
+
+/// Upgrade a fresh iostream-transport connection and return it
+static server::connection_ptr upgraded_connection(server & s,
+    std::ostream * out)
+{
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    // the zero-alloc steady state this guard protects is the raw
+    // continuation configuration; without it every read re-arm and write
+    // dispatch rebinds a closure
+    s.set_raw_continuations(true);
+    s.register_ostream(out);
+
+    server::connection_ptr con = s.get_connection();
+    con->start();
+    con->readsome(handshake.data(),handshake.size());
+    return con;
+}
+
+/// Allocations per iteration of `work` after a warmup window
+/**
+ * The warmup lets caches fill (message cache slots, send queue deque
+ * chunks, adaptive buffers); the measured window then reflects the
+ * steady state the guard is about.
+ */
+template <typename F>
+double steady_allocs_per_iter(F work) {
+    int const warmup = 64;
+    int const window = 256;
+
+    for (int i = 0; i < warmup; i++) {
+        work();
+    }
+    long base = g_allocs;
+    for (int i = 0; i < window; i++) {
+        work();
+    }
+    return static_cast<double>(g_allocs-base)/window;
+}
+
+struct masked_feed {
+    server::connection_ptr con;
+    std::string frame;
+    void operator()() const {
+        con->readsome(frame.data(),frame.size());
+    }
+};
+
+BOOST_AUTO_TEST_CASE( masked_receive_and_echo_steady_state ) {
+    server s;
+    null_streambuf sink;
+    std::ostream out(&sink);
+    s.set_message_handler(bind(&echo_func,&s,_1,_2));
+
+    server::connection_ptr con = upgraded_connection(s,&out);
+
+    masked_feed feed = { con, masked_frame() };
+    double per_msg = steady_allocs_per_iter(feed);
+
+    // the echo crosses the send queue, whose std::deque turns over one
+    // storage block every N messages (N = block size / pointer size);
+    // that amortized turnover is tolerated, anything per-message is not
+    BOOST_CHECK( per_msg < 0.05 );
+}
+
+BOOST_AUTO_TEST_CASE( masked_receive_only_steady_state ) {
+    server s;
+    null_streambuf sink;
+    std::ostream out(&sink);
+    s.set_message_handler(bind(&drop_func,&s,_1,_2));
+
+    server::connection_ptr con = upgraded_connection(s,&out);
+
+    masked_feed feed = { con, masked_frame() };
+    double per_msg = steady_allocs_per_iter(feed);
+
+    BOOST_CHECK_EQUAL( per_msg, 0.0 );
+}
+
+struct small_send {
+    server * s;
+    websocketpp::connection_hdl hdl;
+    void operator()() const {
+        websocketpp::lib::error_code ec;
+        s->send(hdl,"pong!",websocketpp::frame::opcode::text,ec);
+        BOOST_CHECK( !ec );
+    }
+};
+
+BOOST_AUTO_TEST_CASE( small_send_steady_state ) {
+    server s;
+    null_streambuf sink;
+    std::ostream out(&sink);
+    s.set_message_handler(bind(&drop_func,&s,_1,_2));
+
+    server::connection_ptr con = upgraded_connection(s,&out);
+
+    small_send sender = { &s, con->get_handle() };
+    double per_msg = steady_allocs_per_iter(sender);
+
+    // tolerance for amortized send queue block turnover, as above
+    BOOST_CHECK( per_msg < 0.05 );
+}
+
+struct message_recycle {
+    server::connection_type::con_msg_manager_ptr manager;
+    void operator()() const {
+        message_ptr msg = manager->get_message(
+            websocketpp::frame::opcode::text,16);
+        // payload below the small-string threshold; the append itself
+        // must not allocate either
+        msg->append_payload("0123456789");
+        // release back to the manager's cache by dropping the reference
+    }
+};
+
+BOOST_AUTO_TEST_CASE( pooled_message_recycle_steady_state ) {
+    server::connection_type::con_msg_manager_ptr manager(
+        new server::connection_type::con_msg_manager_type());
+
+    message_recycle cycle = { manager };
+    double per_msg = steady_allocs_per_iter(cycle);
+
+    BOOST_CHECK_EQUAL( per_msg, 0.0 );
+}
+
+void client_drop_func(client *, websocketpp::connection_hdl,
+    client::message_ptr) {}
+
+/// One unmasked text frame carrying "ping!", as a server would send
+static std::string unmasked_frame() {
+    std::string f;
+    f += static_cast<char>(0x81);
+    f += static_cast<char>(0x05);
+    f += "ping!";
+    return f;
+}
+
+struct unmasked_feed {
+    client::connection_ptr con;
+    std::string frame;
+    void operator()() const {
+        con->readsome(frame.data(),frame.size());
+    }
+};
+
+BOOST_AUTO_TEST_CASE( unmasked_receive_steady_state ) {
+    client c;
+    null_streambuf sink;
+    std::ostream out(&sink);
+    std::stringstream handshake_out;
+
+    c.clear_access_channels(websocketpp::log::alevel::all);
+    c.clear_error_channels(websocketpp::log::elevel::all);
+    c.set_raw_continuations(true);
+    c.set_message_handler(bind(&client_drop_func,&c,_1,_2));
+    c.register_ostream(&handshake_out);
+
+    websocketpp::lib::error_code ec;
+    client::connection_ptr con = c.get_connection("ws://localhost/",ec);
+    BOOST_REQUIRE( !ec );
+    c.connect(con);
+
+    // answer the generated handshake key with its matching accept hash
+    std::string req = handshake_out.str();
+    size_t kp = req.find("Sec-WebSocket-Key: ")+19;
+    std::string key = req.substr(kp,req.find("\r\n",kp)-kp);
+    std::string input = key+"258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    unsigned char hash[20];
+    websocketpp::sha1_one_shot(input.c_str(),input.size(),hash);
+    std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Connection: upgrade\r\n"
+        "Sec-WebSocket-Accept: "+::base64_encode(hash,20)+"\r\n"
+        "Upgrade: websocket\r\n"
+        "\r\n";
+    con->readsome(response.data(),response.size());
+    // handshake inspection done; discard further output without allocating
+    con->register_ostream(&out);
+    BOOST_REQUIRE( con->get_state() == websocketpp::session::state::open );
+
+    unmasked_feed feed = { con, unmasked_frame() };
+    double per_msg = steady_allocs_per_iter(feed);
+
+    BOOST_CHECK_EQUAL( per_msg, 0.0 );
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Wire format corpus replay benchmark for hybi13::consume.
+ *
+ * Replays the frame stream corpora in test/processors/corpus/ through the
+ * RFC 6455 processor and reports ingest throughput per corpus, guarding
+ * against quiet regressions in the consume state machine. Corpus files
+ * whose names start with "s_" contain client-to-server (masked) traffic
+ * and run through a server mode processor; "c_" files run through a
+ * client mode processor. The same files double as a seed corpus for
+ * fuzzing the frame parser.
+ *
+ * Usage: consume_replay [corpus_dir] [seconds_per_corpus]
+ * Defaults: test/processors/corpus, 0.5 seconds per corpus.
+ */
+
+#include <websocketpp/config/core.hpp>
+#include <websocketpp/processors/hybi13.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+typedef websocketpp::config::core config;
+typedef websocketpp::processor::hybi13<config> processor_type;
+
+namespace {
+
+bool load_file(std::string const & path, std::vector<unsigned char> & out) {
+    std::ifstream f(path.c_str(),std::ios::binary);
+    if (!f) {
+        return false;
+    }
+    f.seekg(0,std::ios::end);
+    out.resize(static_cast<size_t>(f.tellg()));
+    f.seekg(0,std::ios::beg);
+    if (!out.empty()) {
+        f.read(reinterpret_cast<char *>(&out[0]),out.size());
+    }
+    return f.good() || f.eof();
+}
+
+/// One full pass of a corpus through a fresh processor
+/**
+ * Returns the number of messages delivered, or a negative value if the
+ * processor reported an error (a corpus/parser mismatch the run should
+ * fail loudly on rather than time).
+ */
+long replay_once(std::vector<unsigned char> const & corpus, bool server,
+    std::vector<unsigned char> & scratch)
+{
+    config::rng_type rng;
+    config::con_msg_manager_type::ptr manager(
+        new config::con_msg_manager_type());
+    processor_type proc(false,server,manager,rng);
+
+    // consume unmasks in place; replay from a scratch copy
+    scratch = corpus;
+
+    long messages = 0;
+    websocketpp::lib::error_code ec;
+    size_t pos = 0;
+    while (pos < scratch.size()) {
+        pos += proc.consume(&scratch[pos],scratch.size()-pos,ec);
+        if (ec) {
+            std::fprintf(stderr,"consume error: %s at byte %zu\n",
+                ec.message().c_str(),pos);
+            return -1;
+        }
+        while (proc.ready()) {
+            proc.get_message();
+            messages++;
+        }
+    }
+    return messages;
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+    std::string dir = (argc > 1 ? argv[1] : "test/processors/corpus");
+    double budget = (argc > 2 ? std::atof(argv[2]) : 0.5);
+
+    char const * corpora[] = {
+        "s_small_text.bin",
+        "s_medium_mixed.bin",
+        "s_fragmented.bin",
+        "s_large_binary.bin",
+        "c_unmasked_mixed.bin"
+    };
+
+    bool failed = false;
+
+    for (size_t c = 0; c < sizeof(corpora)/sizeof(corpora[0]); c++) {
+        std::string path = dir + "/" + corpora[c];
+        std::vector<unsigned char> corpus;
+        if (!load_file(path,corpus)) {
+            std::fprintf(stderr,"missing corpus %s\n",path.c_str());
+            failed = true;
+            continue;
+        }
+        bool server = (corpora[c][0] == 's');
+
+        std::vector<unsigned char> scratch;
+        // warm up and sanity check one pass
+        long messages = replay_once(corpus,server,scratch);
+        if (messages < 0) {
+            failed = true;
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        size_t reps = 0;
+        double elapsed = 0;
+        do {
+            if (replay_once(corpus,server,scratch) < 0) {
+                failed = true;
+                break;
+            }
+            reps++;
+            elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now()-start).count();
+        } while (elapsed < budget);
+
+        std::printf("%-22s %8.1f MB/s  (%zu reps, %ld msgs/pass, %zu bytes)\n",
+            corpora[c],
+            reps*corpus.size()/1e6/elapsed,
+            reps,messages,corpus.size());
+    }
+
+    return failed ? 1 : 0;
+}
@@ -40,6 +40,7 @@
 #include <websocketpp/random/none.hpp>
 
 struct stub_config {
+    static const size_t max_message_size = 0;
 	typedef websocketpp::http::parser::request request_type;
 	typedef websocketpp::http::parser::response response_type;
 
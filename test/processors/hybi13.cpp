@@ -43,6 +43,7 @@
 #include <websocketpp/extensions/permessage_deflate/enabled.hpp>
 
 struct stub_config {
+    static const size_t max_message_size = 0;
 	typedef websocketpp::http::parser::request request_type;
 	typedef websocketpp::http::parser::response response_type;
 
@@ -64,6 +65,7 @@ struct stub_config {
 };
 
 struct stub_config_ext {
+    static const size_t max_message_size = 0;
 	typedef websocketpp::http::parser::request request_type;
 	typedef websocketpp::http::parser::response response_type;
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE hybi_13_h2_processor
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <string>
+
+#include <websocketpp/processors/hybi13_h2.hpp>
+
+#include <websocketpp/http/request.hpp>
+#include <websocketpp/http/response.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+#include <websocketpp/message_buffer/alloc.hpp>
+#include <websocketpp/random/none.hpp>
+
+#include <websocketpp/extensions/permessage_deflate/disabled.hpp>
+
+struct stub_config {
+	typedef websocketpp::http::parser::request request_type;
+	typedef websocketpp::http::parser::response response_type;
+
+	typedef websocketpp::message_buffer::message
+		<websocketpp::message_buffer::alloc::con_msg_manager> message_type;
+	typedef websocketpp::message_buffer::alloc::con_msg_manager<message_type>
+		con_msg_manager_type;
+
+    typedef websocketpp::random::none::int_generator<uint32_t> rng_type;
+
+    struct permessage_deflate_config {
+        typedef stub_config::request_type request_type;
+    };
+
+    typedef websocketpp::extensions::permessage_deflate::disabled
+        <permessage_deflate_config> permessage_deflate_type;
+
+    static const bool enable_extensions = false;
+    static const size_t max_message_size = 16000000;
+};
+
+typedef stub_config::con_msg_manager_type con_msg_manager_type;
+typedef websocketpp::processor::hybi13_h2<stub_config> processor_type;
+
+struct processor_setup {
+    processor_setup(bool server)
+      : msg_manager(new con_msg_manager_type())
+      , p(false,server,msg_manager,rng) {}
+
+    websocketpp::lib::error_code ec;
+    con_msg_manager_type::ptr msg_manager;
+    stub_config::rng_type rng;
+    stub_config::request_type req;
+    stub_config::response_type res;
+    processor_type p;
+};
+
+BOOST_AUTO_TEST_CASE( validate_extended_connect ) {
+    processor_setup env(true);
+
+    env.req.replace_header(":method","CONNECT");
+    env.req.replace_header(":protocol","websocket");
+    env.req.replace_header(":authority","example.com");
+    env.req.replace_header("Sec-WebSocket-Version","13");
+
+    BOOST_CHECK( !env.p.validate_handshake(env.req) );
+}
+
+BOOST_AUTO_TEST_CASE( reject_missing_protocol_pseudo_header ) {
+    processor_setup env(true);
+
+    env.req.replace_header(":method","CONNECT");
+    env.req.replace_header(":authority","example.com");
+
+    BOOST_CHECK_EQUAL( env.p.validate_handshake(env.req),
+        websocketpp::processor::error::missing_required_header );
+}
+
+BOOST_AUTO_TEST_CASE( reject_non_connect_method ) {
+    processor_setup env(true);
+
+    env.req.replace_header(":method","GET");
+    env.req.replace_header(":protocol","websocket");
+    env.req.replace_header(":authority","example.com");
+
+    BOOST_CHECK_EQUAL( env.p.validate_handshake(env.req),
+        websocketpp::processor::error::invalid_http_method );
+}
+
+BOOST_AUTO_TEST_CASE( handshake_response_is_plain_200 ) {
+    processor_setup env(true);
+
+    env.p.process_handshake(env.req,"",env.res);
+
+    BOOST_CHECK_EQUAL( env.res.get_status_code(),
+        websocketpp::http::status_code::ok );
+    // connection specific headers are forbidden in HTTP/2 messages and the
+    // Key/Accept exchange does not exist
+    BOOST_CHECK_EQUAL( env.res.get_header("Upgrade"), "" );
+    BOOST_CHECK_EQUAL( env.res.get_header("Connection"), "" );
+    BOOST_CHECK_EQUAL( env.res.get_header("Sec-WebSocket-Accept"), "" );
+}
+
+BOOST_AUTO_TEST_CASE( client_request_uses_pseudo_headers ) {
+    processor_setup env(false);
+
+    websocketpp::uri_ptr u(new websocketpp::uri("wss://example.com/chat"));
+    std::vector<std::string> subs;
+    subs.push_back("feed.v1");
+
+    BOOST_CHECK( !env.p.client_handshake_request(env.req,u,subs) );
+
+    BOOST_CHECK_EQUAL( env.req.get_header(":method"), "CONNECT" );
+    BOOST_CHECK_EQUAL( env.req.get_header(":protocol"), "websocket" );
+    BOOST_CHECK_EQUAL( env.req.get_header(":path"), "/chat" );
+    BOOST_CHECK_EQUAL( env.req.get_header(":authority"), "example.com" );
+    BOOST_CHECK_EQUAL( env.req.get_header("Sec-WebSocket-Protocol"),
+        "feed.v1" );
+    BOOST_CHECK_EQUAL( env.req.get_header("Sec-WebSocket-Key"), "" );
+}
+
+BOOST_AUTO_TEST_CASE( client_accepts_2xx_rejects_others ) {
+    processor_setup env(false);
+
+    env.res.set_status(websocketpp::http::status_code::ok);
+    BOOST_CHECK( !env.p.validate_server_handshake_response(env.req,env.res) );
+
+    env.res.set_status(websocketpp::http::status_code::bad_request);
+    BOOST_CHECK_EQUAL( env.p.validate_server_handshake_response(env.req,
+        env.res), websocketpp::processor::error::invalid_http_status );
+}
+
+BOOST_AUTO_TEST_CASE( framing_is_plain_hybi13 ) {
+    processor_setup env(true);
+
+    // a masked text frame consumes identically to hybi13: RFC 8441 leaves
+    // RFC 6455 framing untouched after the handshake
+    uint8_t frame[8] = {0x81,0x82,0x01,0x02,0x03,0x04,
+        (uint8_t)('h'^0x01),(uint8_t)('i'^0x02)};
+
+    websocketpp::lib::error_code ec;
+    size_t consumed = env.p.consume(frame,sizeof(frame),ec);
+
+    BOOST_CHECK( !ec );
+    BOOST_CHECK_EQUAL( consumed, 8u );
+    BOOST_CHECK( env.p.ready() );
+    BOOST_CHECK_EQUAL( env.p.get_message()->get_payload(), "hi" );
+}
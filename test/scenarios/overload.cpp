@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE overload_scenarios
+#include <boost/test/unit_test.hpp>
+
+// Overload scenario suite
+//
+// The worst production outages come from compound conditions no unit
+// test exercises: mass reconnects landing on slow clients while
+// compression eats memory. Each scenario here drives a server
+// assembled from the performance features (connection pooling, send
+// watermarks, handshake caps, load shedding, adaptive read buffers)
+// with a production-shaped failure mode and asserts the three
+// invariants that matter at 3am: memory stays bounded (library
+// observable state returns to baseline), service stays responsive
+// (a probe connection's echo p99 under a ceiling), and nothing
+// deadlocks (every scenario completes within its deadline -- the
+// suite hanging IS the failure signal). Run it before upgrades.
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/common/time.hpp>
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef websocketpp::server<websocketpp::config::asio> server;
+
+using boost::asio::ip::tcp;
+
+static uint16_t const test_port = 9321;
+
+// ---- minimal synchronous websocket client over boost sockets ----
+
+struct ws_client {
+    ws_client() : socket(ios) {}
+
+    bool connect_upgrade() {
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(
+            boost::asio::ip::address_v4::loopback(),test_port),ec);
+        if (ec) { return false; }
+        std::string req =
+            "GET / HTTP/1.1\r\nHost: t\r\nUpgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n";
+        boost::asio::write(socket,boost::asio::buffer(req),ec);
+        if (ec) { return false; }
+        std::string resp;
+        char c;
+        while (resp.find("\r\n\r\n") == std::string::npos) {
+            if (boost::asio::read(socket,boost::asio::buffer(&c,1),ec)
+                != 1)
+            {
+                return false;
+            }
+            resp += c;
+        }
+        return resp.compare(9,3,"101") == 0;
+    }
+
+    void send_frame(uint8_t opcode, std::string const & payload,
+        bool fin = true)
+    {
+        std::string out;
+        out += static_cast<char>((fin ? 0x80 : 0x00) | opcode);
+        if (payload.size() < 126) {
+            out += static_cast<char>(0x80 | payload.size());
+        } else {
+            out += static_cast<char>(0x80 | 126);
+            out += static_cast<char>((payload.size() >> 8) & 0xff);
+            out += static_cast<char>(payload.size() & 0xff);
+        }
+        out.append("\x11\x22\x33\x44",4);
+        for (size_t i = 0; i < payload.size(); i++) {
+            out += static_cast<char>(payload[i]
+                ^ "\x11\x22\x33\x44"[i % 4]);
+        }
+        boost::system::error_code ec;
+        boost::asio::write(socket,boost::asio::buffer(out),ec);
+    }
+
+    /// Read one frame; false on error/timeout-less EOF
+    bool recv_frame(std::string & payload) {
+        boost::system::error_code ec;
+        uint8_t hdr[2];
+        if (boost::asio::read(socket,boost::asio::buffer(hdr,2),ec)
+            != 2)
+        {
+            return false;
+        }
+        size_t len = hdr[1] & 0x7f;
+        if (len == 126) {
+            uint8_t ext[2];
+            if (boost::asio::read(socket,boost::asio::buffer(ext,2),ec)
+                != 2)
+            {
+                return false;
+            }
+            len = (static_cast<size_t>(ext[0]) << 8) | ext[1];
+        }
+        payload.resize(len);
+        if (len > 0 && boost::asio::read(socket,
+            boost::asio::buffer(&payload[0],len),ec) != len)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    boost::asio::io_service ios;
+    tcp::socket socket;
+};
+
+// ---- the server under test, assembled from the feature set ----
+
+struct scenario_server {
+    scenario_server()
+      : m_endpoint()
+    {
+        m_endpoint.set_access_channels(websocketpp::log::alevel::none);
+        m_endpoint.set_error_channels(websocketpp::log::elevel::none);
+        m_endpoint.set_connection_pool_size(128);
+        m_endpoint.init_asio();
+        m_endpoint.set_raw_continuations(true);
+        m_endpoint.enable_timer_wheel();
+        m_endpoint.set_max_handshakes(64);
+        m_endpoint.enable_keepalive(2000,4000,200);
+        // slow readers hit the high watermark and are disconnected
+        // rather than buffering without bound
+        m_endpoint.set_message_handler(websocketpp::lib::bind(
+            &scenario_server::on_message,this,
+            websocketpp::lib::placeholders::_1,
+            websocketpp::lib::placeholders::_2));
+        m_endpoint.set_open_handler(websocketpp::lib::bind(
+            &scenario_server::on_open,this,
+            websocketpp::lib::placeholders::_1));
+        m_endpoint.listen(boost::asio::ip::tcp::endpoint(
+            boost::asio::ip::address_v4::loopback(),test_port));
+        m_endpoint.start_accept();
+        m_thread.reset(new websocketpp::lib::thread(
+            websocketpp::lib::bind(&server::run,&m_endpoint)));
+    }
+
+    ~scenario_server() {
+        m_endpoint.stop();
+        m_thread->join();
+    }
+
+    void on_open(websocketpp::connection_hdl hdl) {
+        server::connection_ptr con = m_endpoint.get_con_from_hdl(hdl);
+        con->set_send_watermarks(256*1024,64*1024);
+        con->set_slow_consumer_policy(
+            server::connection_type::slow_consumer_policy::close);
+    }
+
+    void on_message(websocketpp::connection_hdl hdl,
+        server::message_ptr msg)
+    {
+        websocketpp::lib::error_code ec;
+        m_endpoint.send(hdl,msg->get_payload(),msg->get_opcode(),ec);
+    }
+
+    server m_endpoint;
+    websocketpp::lib::shared_ptr<websocketpp::lib::thread> m_thread;
+};
+
+/// Echo p99 (microseconds) over `samples` probes on a fresh connection
+static uint64_t probe_p99(int samples) {
+    ws_client probe;
+    BOOST_REQUIRE( probe.connect_upgrade() );
+    std::vector<uint64_t> lat;
+    std::string reply;
+    for (int i = 0; i < samples; i++) {
+        uint64_t t0 = websocketpp::lib::steady_us();
+        probe.send_frame(0x1,"probe-ping");
+        BOOST_REQUIRE( probe.recv_frame(reply) );
+        lat.push_back(websocketpp::lib::steady_us()-t0);
+    }
+    std::sort(lat.begin(),lat.end());
+    return lat[lat.size()*99/100];
+}
+
+/// Wait for the registry to drain back toward the armed baseline
+static bool settles(server & s, size_t limit, long deadline_ms) {
+    uint64_t until = websocketpp::lib::steady_ms()
+        + static_cast<uint64_t>(deadline_ms);
+    while (websocketpp::lib::steady_ms() < until) {
+        if (s.get_connection_count() <= limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE( thundering_herd ) {
+    scenario_server srv;
+    size_t baseline = srv.m_endpoint.get_connection_count();
+
+    // 150 connections upgrading as fast as the loop can drive, each
+    // exchanging one message and dropping; interleave waves so closes
+    // and accepts overlap (the reconnect-storm shape)
+    for (int wave = 0; wave < 3; wave++) {
+        std::vector<websocketpp::lib::shared_ptr<ws_client> > clients;
+        for (int i = 0; i < 50; i++) {
+            websocketpp::lib::shared_ptr<ws_client> c(new ws_client());
+            BOOST_REQUIRE( c->connect_upgrade() );
+            clients.push_back(c);
+        }
+        std::string reply;
+        for (size_t i = 0; i < clients.size(); i++) {
+            clients[i]->send_frame(0x1,"herd");
+            BOOST_REQUIRE( clients[i]->recv_frame(reply) );
+            BOOST_CHECK_EQUAL( reply, "herd" );
+        }
+        // abrupt close, as a dying fleet would
+        clients.clear();
+    }
+
+    // responsive during recovery
+    BOOST_CHECK( probe_p99(100) < 100000 );
+
+    // memory bound: the registry drains back to the armed baseline
+    BOOST_CHECK( settles(srv.m_endpoint,baseline+2,5000) );
+}
+
+BOOST_AUTO_TEST_CASE( slow_reader_fanout ) {
+    scenario_server srv;
+
+    // one client stops reading while the server echoes a heavy stream
+    // at it; the watermark policy must shed it instead of buffering
+    // without bound, and fast clients must stay fast
+    ws_client slow;
+    BOOST_REQUIRE( slow.connect_upgrade() );
+    std::string big(60*1024,'S');
+    for (int i = 0; i < 64; i++) {
+        // each echo adds ~60KB to the slow reader's send queue; the
+        // 256KB high watermark disconnects it within a few messages
+        slow.send_frame(0x2,big);
+    }
+
+    // while the slow reader wedges, a fast client's latency holds
+    uint64_t p99 = probe_p99(200);
+    BOOST_CHECK( p99 < 100000 );
+
+    // the slow reader is shed; its socket reports EOF
+    std::string sink;
+    bool alive = true;
+    for (int i = 0; i < 80 && alive; i++) {
+        alive = slow.recv_frame(sink);
+    }
+    BOOST_CHECK( !alive );
+
+    BOOST_CHECK( settles(srv.m_endpoint,3,5000) );
+}
+
+BOOST_AUTO_TEST_CASE( handshake_flood ) {
+    scenario_server srv;
+
+    // 100 embryonic connections that never complete their handshake;
+    // the handshake cap (64) sheds the excess and the server keeps
+    // serving real clients
+    std::vector<websocketpp::lib::shared_ptr<tcp::socket> > stalled;
+    boost::asio::io_service ios;
+    for (int i = 0; i < 100; i++) {
+        websocketpp::lib::shared_ptr<tcp::socket> s(
+            new tcp::socket(ios));
+        boost::system::error_code ec;
+        s->connect(tcp::endpoint(
+            boost::asio::ip::address_v4::loopback(),test_port),ec);
+        if (!ec) {
+            boost::asio::write(*s,
+                boost::asio::buffer(std::string("GET / HTTP/1.1\r\n")),
+                ec);
+            stalled.push_back(s);
+        }
+    }
+
+    // embryonic load bounded by the cap; everything past it -- good
+    // clients included -- is shed, which is the cap's contract
+    BOOST_CHECK( srv.m_endpoint.current_handshakes() <= 64 );
+
+    // releasing the flood restores service
+    stalled.clear();
+    BOOST_CHECK( settles(srv.m_endpoint,3,6000) );
+    BOOST_CHECK( probe_p99(50) < 100000 );
+}
+
+BOOST_AUTO_TEST_CASE( burst_fragmentation ) {
+    scenario_server srv;
+
+    // bursts of many-fragment messages: reassembly state and adaptive
+    // buffers must stay bounded and the reassembled echoes exact
+    ws_client c;
+    BOOST_REQUIRE( c.connect_upgrade() );
+    std::string piece(1024,'F');
+    std::string reply;
+    for (int burst = 0; burst < 20; burst++) {
+        // 16KB message in 16 fragments
+        c.send_frame(0x2,piece,false);
+        for (int f = 0; f < 14; f++) {
+            c.send_frame(0x0,piece,false);
+        }
+        c.send_frame(0x0,piece,true);
+        BOOST_REQUIRE( c.recv_frame(reply) );
+        BOOST_CHECK_EQUAL( reply.size(), piece.size()*16 );
+    }
+
+    // responsiveness after the bursts
+    BOOST_CHECK( probe_p99(50) < 100000 );
+    BOOST_CHECK( settles(srv.m_endpoint,3,5000) );
+}
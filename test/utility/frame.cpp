@@ -410,6 +410,39 @@ BOOST_AUTO_TEST_CASE( continuous_word_mask ) {
 	BOOST_CHECK_EQUAL( pkey_temp, frame::circshift_prepared_key(pkey,3) );
 }
 
+BOOST_AUTO_TEST_CASE( continuous_simd_mask ) {
+	uint8_t input[40];
+	uint8_t output[40];
+	uint8_t reference[40];
+
+	frame::masking_key_type key;
+	key.c[0] = 0x00;
+	key.c[1] = 0x01;
+	key.c[2] = 0x02;
+	key.c[3] = 0x03;
+
+	size_t pkey,pkey_temp,pkey_ref;
+
+	// One call covering vector blocks plus a sub-word tail; must match the
+	// scalar kernel exactly, including the returned key state.
+	pkey = frame::prepare_masking_key(key);
+	std::fill_n(input,40,0xAB);
+	std::fill_n(output,40,0x00);
+	std::fill_n(reference,40,0xAB);
+	pkey_ref = frame::word_mask_circ(reference,37,pkey);
+	pkey_temp = frame::simd_mask_circ(input,output,37,pkey);
+	BOOST_CHECK( std::equal(output,output+37,reference) );
+	BOOST_CHECK_EQUAL( pkey_temp, pkey_ref );
+
+	// calls split mid-key; state must carry between calls
+	pkey = frame::prepare_masking_key(key);
+	std::fill_n(output,40,0xAB);
+	pkey_temp = frame::simd_mask_circ(output,19,pkey);
+	pkey_temp = frame::simd_mask_circ(output+19,18,pkey_temp);
+	BOOST_CHECK( std::equal(output,output+37,reference) );
+	BOOST_CHECK_EQUAL( pkey_temp, pkey_ref );
+}
+
 BOOST_AUTO_TEST_CASE( continuous_byte_mask ) {
 	uint8_t input[16];
 	uint8_t output[16];
@@ -536,3 +569,37 @@ BOOST_AUTO_TEST_CASE( continuous_word_mask2 ) {
 	frame::word_mask_circ(buffer,12,pkey);
 	BOOST_CHECK( std::equal(buffer,buffer+12,unmasked) );
 }
+
+BOOST_AUTO_TEST_CASE( combined_header_decode ) {
+	frame::header_info info;
+
+	// basic unmasked text frame, 5 byte payload
+	uint8_t small[2] = {0x81,0x05};
+	BOOST_CHECK( frame::decode_header(small,2,info) );
+	BOOST_CHECK_EQUAL( info.payload_size, 5u );
+	BOOST_CHECK_EQUAL( info.header_len, 2u );
+	BOOST_CHECK( info.op == frame::opcode::TEXT );
+	BOOST_CHECK( info.fin );
+	BOOST_CHECK( !info.masked );
+
+	// masked 16 bit binary frame
+	uint8_t med[8] = {0x02,0xFE,0x01,0x00,9,8,7,6};
+	BOOST_CHECK( frame::decode_header(med,8,info) );
+	BOOST_CHECK_EQUAL( info.payload_size, 256u );
+	BOOST_CHECK_EQUAL( info.header_len, 8u );
+	BOOST_CHECK( !info.fin );
+	BOOST_CHECK( info.masked );
+	BOOST_CHECK_EQUAL( info.key.c[0], 9 );
+	BOOST_CHECK_EQUAL( info.key.c[3], 6 );
+
+	// jumbo frame
+	uint8_t jumbo[10] = {0x82,0x7F,0,0,0,0,0x01,0x00,0x00,0x00};
+	BOOST_CHECK( frame::decode_header(jumbo,10,info) );
+	BOOST_CHECK_EQUAL( info.payload_size, 16777216u );
+	BOOST_CHECK_EQUAL( info.header_len, 10u );
+
+	// incomplete headers report false
+	BOOST_CHECK( !frame::decode_header(small,1,info) );
+	BOOST_CHECK( !frame::decode_header(med,5,info) );
+	BOOST_CHECK( !frame::decode_header(jumbo,9,info) );
+}
@@ -235,3 +235,59 @@ BOOST_AUTO_TEST_CASE( uri_valid_v6_mixed_case ) {
 }*/
 
 // TODO: tests for the other two constructors
+
+// uri_view: lazy view based parsing over one backing string
+
+BOOST_AUTO_TEST_CASE( uri_view_valid ) {
+    websocketpp::uri_view uri("wss://thor:9001/chat/bob");
+
+    BOOST_CHECK( uri.get_valid() );
+    BOOST_CHECK( uri.get_secure() );
+    BOOST_CHECK( uri.get_scheme() == "wss" );
+    BOOST_CHECK( uri.get_host() == "thor" );
+    BOOST_CHECK_EQUAL( uri.get_port(), 9001 );
+    BOOST_CHECK( uri.get_resource() == "/chat/bob" );
+    BOOST_CHECK_EQUAL( uri.str(), "wss://thor:9001/chat/bob" );
+}
+
+BOOST_AUTO_TEST_CASE( uri_view_default_ports_and_resource ) {
+    websocketpp::uri_view uri("ws://localhost");
+
+    BOOST_CHECK( uri.get_valid() );
+    BOOST_CHECK_EQUAL( uri.get_port(), 80 );
+    BOOST_CHECK( uri.get_resource() == "/" );
+
+    websocketpp::uri_view uri2("wss://localhost");
+    BOOST_CHECK_EQUAL( uri2.get_port(), 443 );
+}
+
+BOOST_AUTO_TEST_CASE( uri_view_v6_literal ) {
+    websocketpp::uri_view uri("ws://[::1]:9000/chat");
+
+    BOOST_CHECK( uri.get_valid() );
+    BOOST_CHECK( uri.get_host() == "::1" );
+    BOOST_CHECK_EQUAL( uri.get_port(), 9000 );
+    BOOST_CHECK( uri.get_resource() == "/chat" );
+}
+
+BOOST_AUTO_TEST_CASE( uri_view_invalid ) {
+    websocketpp::uri_view bad_scheme("foo://localhost/");
+    BOOST_CHECK( !bad_scheme.get_valid() );
+
+    websocketpp::uri_view bad_port("ws://localhost:70000/");
+    BOOST_CHECK( !bad_port.get_valid() );
+
+    websocketpp::uri_view bad_port2("ws://localhost:0/");
+    BOOST_CHECK( !bad_port2.get_valid() );
+
+    websocketpp::uri_view bad_v6("ws://[::1/");
+    BOOST_CHECK( !bad_v6.get_valid() );
+}
+
+BOOST_AUTO_TEST_CASE( uri_view_component_str ) {
+    websocketpp::uri_view uri("ws://example.com:8080/a/b?q=1");
+
+    BOOST_CHECK_EQUAL( uri.get_scheme().str(), "ws" );
+    BOOST_CHECK_EQUAL( uri.get_host().str(), "example.com" );
+    BOOST_CHECK_EQUAL( uri.get_resource().str(), "/a/b?q=1" );
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE utf8_validator
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <websocketpp/utf8_validator.hpp>
+
+using websocketpp::utf8_validator::validator;
+using websocketpp::utf8_validator::validate;
+
+// reference implementation: the DFA applied byte by byte through the
+// iterator interface, which never takes the vectorized path
+bool reference_validate(std::string const & s) {
+    validator v;
+    if (!v.decode(s.begin(),s.end())) {
+        return false;
+    }
+    return v.complete();
+}
+
+BOOST_AUTO_TEST_CASE( valid_strings ) {
+    BOOST_CHECK( validate("") );
+    BOOST_CHECK( validate("hello world") );
+    // long ASCII (vector path)
+    BOOST_CHECK( validate(std::string(1000,'a')) );
+    // mixed multibyte spanning block boundaries
+    std::string mixed;
+    for (int i = 0; i < 100; i++) {
+        mixed += "ascii ";
+        mixed += "\xc3\xa9";         // e acute
+        mixed += "\xe2\x82\xac";     // euro sign
+        mixed += "\xf0\x9f\x92\xa9"; // 4 byte emoji
+    }
+    BOOST_CHECK( validate(mixed) );
+}
+
+BOOST_AUTO_TEST_CASE( invalid_strings ) {
+    std::string prefix(64,'a');
+    // lone continuation
+    BOOST_CHECK( !validate(prefix+"\x80") );
+    // truncated 3 byte sequence
+    BOOST_CHECK( !validate(prefix+"\xe2\x82") );
+    // overlong encoding of '/'
+    BOOST_CHECK( !validate(prefix+"\xc0\xaf") );
+    // UTF-16 surrogate half
+    BOOST_CHECK( !validate(prefix+"\xed\xa0\x80") );
+    // codepoint above U+10FFFF
+    BOOST_CHECK( !validate(prefix+"\xf4\x90\x80\x80") );
+    // error buried mid-block
+    BOOST_CHECK( !validate(prefix+"\xff"+prefix) );
+}
+
+BOOST_AUTO_TEST_CASE( streaming_carry ) {
+    // a 4 byte codepoint split across chunk boundaries must carry state
+    std::string part1 = std::string(40,'x') + "\xf0\x9f";
+    std::string part2 = "\x92\xa9" + std::string(40,'y');
+
+    validator v;
+    BOOST_CHECK( v.decode(part1.data(),part1.data()+part1.size()) );
+    BOOST_CHECK( !v.complete() );
+    BOOST_CHECK( v.decode(part2.data(),part2.data()+part2.size()) );
+    BOOST_CHECK( v.complete() );
+
+    // and a pending sequence aborted by an ASCII byte after the split
+    validator v2;
+    std::string bad2 = "ab" + std::string(40,'y');
+    BOOST_CHECK( v2.decode(part1.data(),part1.data()+part1.size()) );
+    BOOST_CHECK( !v2.decode(bad2.data(),bad2.data()+bad2.size()) );
+}
+
+BOOST_AUTO_TEST_CASE( fuzz_against_dfa ) {
+    // random byte soup and random valid-ish strings must agree with the DFA
+    std::srand(42);
+    for (int iter = 0; iter < 2000; iter++) {
+        size_t len = std::rand() % 200;
+        std::string s;
+        s.reserve(len);
+        bool mostly_ascii = (iter % 2) == 0;
+        for (size_t i = 0; i < len; i++) {
+            if (mostly_ascii && (std::rand() % 10) != 0) {
+                s += char(std::rand() % 0x80);
+            } else {
+                s += char(std::rand() % 256);
+            }
+        }
+        BOOST_CHECK_MESSAGE( validate(s) == reference_validate(s),
+            "mismatch on iteration " << iter );
+    }
+}
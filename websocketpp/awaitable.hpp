@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_AWAITABLE_HPP
+#define WEBSOCKETPP_AWAITABLE_HPP
+
+// C++20 coroutine surface over the callback API. Only compiled when the
+// translation unit is built with coroutine support; the rest of the library
+// is unaffected.
+#if defined(__cpp_impl_coroutine) || (defined(__cplusplus) && \
+    __cplusplus >= 202002L)
+
+#include <websocketpp/close.hpp>
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/system_error.hpp>
+#include <websocketpp/frame.hpp>
+
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace websocketpp {
+
+/// C++20 awaitable layer
+/**
+ * Wraps the callback based endpoint/connection API in awaiter objects so
+ * coroutine services can write sequential code:
+ *
+ * \code
+ * websocketpp::awaitable::acceptor<server> acc(ep);
+ * for (;;) {
+ *     auto con = co_await acc.accept();
+ *     websocketpp::awaitable::connection<server> c(con);
+ *     while (auto msg = co_await c.read_message()) {
+ *         co_await c.send(msg->get_payload(),msg->get_opcode());
+ *     }
+ * }
+ * \endcode
+ *
+ * The awaiter state is embedded in the wrapper objects (one slot plus a
+ * small queue guarded by a mutex), so awaiting performs no per operation
+ * heap allocation beyond what the coroutine frame itself requires.
+ * Coroutines resume on the transport thread that invoked the underlying
+ * handler. At most one coroutine may be awaiting a given wrapper at a time.
+ */
+namespace awaitable {
+
+/// Fire-and-forget coroutine return type for driving awaitable loops
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return detached_task(); }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/// Awaitable message source for one connection
+/**
+ * Registers itself as the connection's message and close handlers.
+ * read_message() completes with the next message, or an empty pointer once
+ * the connection closes or fails.
+ */
+template <typename endpoint_type>
+class connection {
+public:
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+    typedef typename endpoint_type::message_ptr message_ptr;
+
+    connection(endpoint_type & ep, connection_ptr con)
+      : m_endpoint(ep), m_con(con)
+    {
+        con->set_message_handler(
+            [this](connection_hdl, message_ptr msg) {
+                this->on_message(msg);
+            });
+        con->set_close_handler(
+            [this](connection_hdl) { this->on_terminate(); });
+        con->set_fail_handler(
+            [this](connection_hdl) { this->on_terminate(); });
+    }
+
+    /// Awaiter for the next inbound message
+    struct read_awaiter {
+        connection * self;
+        message_ptr result;
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(self->m_lock);
+            if (!self->m_queue.empty()) {
+                result = self->m_queue.front();
+                self->m_queue.pop_front();
+                return true;
+            }
+            return self->m_closed;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::lock_guard<std::mutex> lock(self->m_lock);
+            // re-check under the lock: a message may have landed between
+            // await_ready and here
+            if (!self->m_queue.empty() || self->m_closed) {
+                return false;
+            }
+            self->m_waiter = h;
+            return true;
+        }
+
+        message_ptr await_resume() {
+            if (result) {
+                return result;
+            }
+            std::lock_guard<std::mutex> lock(self->m_lock);
+            if (!self->m_queue.empty()) {
+                message_ptr msg = self->m_queue.front();
+                self->m_queue.pop_front();
+                return msg;
+            }
+            return message_ptr();
+        }
+    };
+
+    /// co_await the next message; empty pointer means closed
+    read_awaiter read_message() {
+        return read_awaiter{this,message_ptr()};
+    }
+
+    /// Awaiter for a send: queueing completes synchronously, so this never
+    /// suspends; the co_await returns the error code
+    struct send_awaiter {
+        lib::error_code ec;
+        bool await_ready() const noexcept { return true; }
+        void await_suspend(std::coroutine_handle<>) const noexcept {}
+        lib::error_code await_resume() const noexcept { return ec; }
+    };
+
+    /// co_await sending a payload (completes when queued)
+    send_awaiter send(std::string const & payload,
+        frame::opcode::value op = frame::opcode::TEXT)
+    {
+        send_awaiter a;
+        a.ec = m_con->send(payload,op);
+        return a;
+    }
+
+    /// co_await closing the connection
+    send_awaiter close(close::status::value code, std::string const & reason)
+    {
+        send_awaiter a;
+        m_con->close(code,reason,a.ec);
+        return a;
+    }
+
+    connection_ptr get() const { return m_con; }
+
+private:
+    void on_message(message_ptr msg) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_queue.push_back(msg);
+            waiter = m_waiter;
+            m_waiter = nullptr;
+        }
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+
+    void on_terminate() {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_closed = true;
+            waiter = m_waiter;
+            m_waiter = nullptr;
+        }
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+
+    endpoint_type & m_endpoint;
+    connection_ptr m_con;
+
+    std::mutex m_lock;
+    std::deque<message_ptr> m_queue;
+    std::coroutine_handle<> m_waiter;
+    bool m_closed = false;
+};
+
+/// Awaitable accept source for a server endpoint
+/**
+ * Registers itself as the endpoint's open handler; accept() completes with
+ * each newly opened connection in order.
+ */
+template <typename endpoint_type>
+class acceptor {
+public:
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+
+    explicit acceptor(endpoint_type & ep)
+      : m_endpoint(ep)
+    {
+        ep.set_open_handler([this](connection_hdl hdl) {
+            this->on_open(hdl);
+        });
+    }
+
+    struct accept_awaiter {
+        acceptor * self;
+        connection_ptr result;
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(self->m_lock);
+            if (!self->m_queue.empty()) {
+                result = self->m_queue.front();
+                self->m_queue.pop_front();
+                return true;
+            }
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::lock_guard<std::mutex> lock(self->m_lock);
+            if (!self->m_queue.empty()) {
+                return false;
+            }
+            self->m_waiter = h;
+            return true;
+        }
+
+        connection_ptr await_resume() {
+            if (result) {
+                return result;
+            }
+            std::lock_guard<std::mutex> lock(self->m_lock);
+            connection_ptr con = self->m_queue.front();
+            self->m_queue.pop_front();
+            return con;
+        }
+    };
+
+    /// co_await the next accepted (opened) connection
+    accept_awaiter accept() {
+        return accept_awaiter{this,connection_ptr()};
+    }
+
+private:
+    void on_open(connection_hdl hdl) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_queue.push_back(m_endpoint.get_con_from_hdl(hdl));
+            waiter = m_waiter;
+            m_waiter = nullptr;
+        }
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+
+    endpoint_type & m_endpoint;
+    std::mutex m_lock;
+    std::deque<connection_ptr> m_queue;
+    std::coroutine_handle<> m_waiter;
+};
+
+} // namespace awaitable
+} // namespace websocketpp
+
+#endif // coroutine support
+#endif // WEBSOCKETPP_AWAITABLE_HPP
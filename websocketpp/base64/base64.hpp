@@ -36,8 +36,15 @@
 #ifndef _BASE64_HPP_
 #define _BASE64_HPP_
 
+#include <cstddef>
 #include <string>
 
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && \
+    !defined(_BASE64_NO_SIMD_)
+    #define _BASE64_SIMD_X86_
+    #include <immintrin.h>
+#endif
+
 static const std::string base64_chars = 
              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
              "abcdefghijklmnopqrstuvwxyz"
@@ -50,73 +57,190 @@ static inline bool is_base64(unsigned char c) {
            (c >= 97 && c <= 122)); // a-z
 }
 
+#ifdef _BASE64_SIMD_X86_
+namespace base64_simd {
+
+// Translate 16 packed 6-bit indices to base64 ascii (Mula's improved
+// lookup: a saturating subtract classifies each index into one of five
+// ranges, then one pshufb picks the ascii offset for that range).
+__attribute__((target("ssse3")))
+static inline __m128i lookup_ascii(__m128i indices) {
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    __m128i const offsets = _mm_setr_epi8(
+        71,-4,-4,-4,-4,-4,-4,-4,-4,-4,-4,-19,-16,65,0,0);
+    result = _mm_shuffle_epi8(offsets, result);
+    return _mm_add_epi8(result, indices);
+}
+
+// Expand 12 input bytes (loaded as 16) into 16 packed 6-bit indices
+__attribute__((target("ssse3")))
+static inline __m128i unpack_12(__m128i data) {
+    __m128i const shuf = _mm_setr_epi8(1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10);
+    __m128i in = _mm_shuffle_epi8(data, shuf);
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    t0 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    t1 = _mm_mullo_epi16(t1, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+// Encode as many whole 12 byte blocks as can be loaded with 16 byte
+// reads. Returns input bytes consumed; writes consumed/3*4 chars.
+__attribute__((target("ssse3")))
+static inline size_t encode_blocks_ssse3(unsigned char const * in,
+    size_t len, char * out)
+{
+    size_t pos = 0;
+    while (pos + 16 <= len) {
+        __m128i data = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(in + pos));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+            lookup_ascii(unpack_12(data)));
+        pos += 12;
+        out += 16;
+    }
+    return pos;
+}
+
+// AVX2 variant: 24 input bytes per iteration, both lanes running the
+// SSSE3 algorithm on 12 bytes each.
+__attribute__((target("avx2")))
+static inline size_t encode_blocks_avx2(unsigned char const * in,
+    size_t len, char * out)
+{
+    __m256i const shuf = _mm256_setr_epi8(
+        1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10,
+        1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10);
+    __m256i const offsets = _mm256_setr_epi8(
+        71,-4,-4,-4,-4,-4,-4,-4,-4,-4,-4,-19,-16,65,0,0,
+        71,-4,-4,-4,-4,-4,-4,-4,-4,-4,-4,-19,-16,65,0,0);
+    size_t pos = 0;
+    while (pos + 28 <= len) {
+        __m256i data = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(
+                reinterpret_cast<__m128i const *>(in + pos))),
+            _mm_loadu_si128(
+                reinterpret_cast<__m128i const *>(in + pos + 12)),
+            1);
+        __m256i v = _mm256_shuffle_epi8(data, shuf);
+        __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        t0 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        t1 = _mm256_mullo_epi16(t1, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t0, t1);
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result,
+            _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_shuffle_epi8(offsets, result);
+        result = _mm256_add_epi8(result, indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), result);
+        pos += 24;
+        out += 32;
+    }
+    return pos + encode_blocks_ssse3(in + pos, len - pos, out);
+}
+
+typedef size_t (*encode_blocks_fn)(unsigned char const *, size_t, char *);
+
+static inline encode_blocks_fn select_encode_blocks() {
+    if (__builtin_cpu_supports("avx2")) {
+        return &encode_blocks_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return &encode_blocks_ssse3;
+    }
+    return 0;
+}
+
+} // namespace base64_simd
+#endif // _BASE64_SIMD_X86_
+
 inline std::string base64_encode(unsigned char const* bytes_to_encode, unsigned 
     int in_len)
 {
     std::string ret;
-    int i = 0;
-    int j = 0;
-    unsigned char char_array_3[3];
-    unsigned char char_array_4[4];
-
-    while (in_len--) {
-        char_array_3[i++] = *(bytes_to_encode++);
-        if (i == 3) {
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + 
-                              ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + 
-                              ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
-
-            for(i = 0; (i <4) ; i++) {
-                ret += base64_chars[char_array_4[i]];
-            }
-            i = 0;
-        }
+    ret.resize(4*((size_t(in_len)+2)/3));
+    if (in_len == 0) {
+        return ret;
     }
 
-    if (i) {
-        for(j = i; j < 3; j++) {
-            char_array_3[j] = '\0';
-        }
+    char * out = &ret[0];
+    size_t pos = 0;
+    size_t len = in_len;
 
-        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + 
-                          ((char_array_3[1] & 0xf0) >> 4);
-        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + 
-                          ((char_array_3[2] & 0xc0) >> 6);
-        char_array_4[3] = char_array_3[2] & 0x3f;
+#ifdef _BASE64_SIMD_X86_
+    static base64_simd::encode_blocks_fn const blocks =
+        base64_simd::select_encode_blocks();
+    if (blocks) {
+        pos = blocks(bytes_to_encode,len,out);
+        out += pos/3*4;
+    }
+#endif
 
-        for (j = 0; (j < i + 1); j++) {
-            ret += base64_chars[char_array_4[j]];
-        }
+    // whole 3 byte groups
+    while (pos + 3 <= len) {
+        unsigned char b0 = bytes_to_encode[pos];
+        unsigned char b1 = bytes_to_encode[pos+1];
+        unsigned char b2 = bytes_to_encode[pos+2];
+        *out++ = base64_chars[(b0 & 0xfc) >> 2];
+        *out++ = base64_chars[((b0 & 0x03) << 4) + ((b1 & 0xf0) >> 4)];
+        *out++ = base64_chars[((b1 & 0x0f) << 2) + ((b2 & 0xc0) >> 6)];
+        *out++ = base64_chars[b2 & 0x3f];
+        pos += 3;
+    }
 
-        while((i++ < 3)) {
-            ret += '=';
-        }
-  }
+    // trailing 1 or 2 bytes plus padding
+    if (pos < len) {
+        unsigned char b0 = bytes_to_encode[pos];
+        unsigned char b1 = (pos + 1 < len ? bytes_to_encode[pos+1] : 0);
+        *out++ = base64_chars[(b0 & 0xfc) >> 2];
+        *out++ = base64_chars[((b0 & 0x03) << 4) + ((b1 & 0xf0) >> 4)];
+        *out++ = (pos + 1 < len ? base64_chars[(b1 & 0x0f) << 2] : '=');
+        *out++ = '=';
+    }
 
-  return ret;
+    return ret;
 }
 
 inline std::string base64_encode(const std::string & data) {
     return base64_encode(reinterpret_cast<const unsigned char *>(data.data()),data.size());
 }
 
+/// Inverse of base64_chars, built once; -1 marks non-base64 bytes
+static inline signed char const * base64_inverse_table() {
+    static signed char table[256];
+    static bool built = false;
+    if (!built) {
+        for (int k = 0; k < 256; k++) {
+            table[k] = -1;
+        }
+        for (int k = 0; k < 64; k++) {
+            table[static_cast<unsigned char>(base64_chars[k])] =
+                static_cast<signed char>(k);
+        }
+        built = true;
+    }
+    return table;
+}
+
 inline std::string base64_decode(std::string const& encoded_string) {
     size_t in_len = encoded_string.size();
     int i = 0;
     int j = 0;
     int in_ = 0;
     unsigned char char_array_4[4], char_array_3[3];
+    signed char const * inverse = base64_inverse_table();
     std::string ret;
+    ret.reserve(((in_len+3)/4)*3);
 
     while (in_len-- && ( encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
         char_array_4[i++] = encoded_string[in_]; in_++;
         if (i ==4) {
             for (i = 0; i <4; i++) {
-                char_array_4[i] = static_cast<unsigned char>(base64_chars.find(char_array_4[i]));
+                char_array_4[i] = static_cast<unsigned char>(inverse[char_array_4[i]]);
             }
 
             char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
@@ -135,7 +259,7 @@ inline std::string base64_decode(std::string const& encoded_string) {
             char_array_4[j] = 0;
 
         for (j = 0; j <4; j++)
-            char_array_4[j] = static_cast<unsigned char>(base64_chars.find(char_array_4[j]));
+            char_array_4[j] = static_cast<unsigned char>(inverse[char_array_4[j]]) & 0x3f;
 
         char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
         char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
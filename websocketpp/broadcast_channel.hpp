@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_BROADCAST_CHANNEL_HPP
+#define WEBSOCKETPP_BROADCAST_CHANNEL_HPP
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/frame.hpp>
+
+#include <deque>
+#include <map>
+#include <string>
+
+namespace websocketpp {
+
+/// Delta-encoded broadcast channel with per-subscriber cursors
+/**
+ * Dashboard-style fanout usually ships full snapshots because per
+ * client diffing is too expensive application-side; this channel makes
+ * the diffing shared. Publishers push versioned deltas into a bounded
+ * ring; every subscriber carries a cursor of the last version it was
+ * sent, and delivery frames whatever each cursor needs -- the next
+ * delta for caught-up connections (the common case, one prepared
+ * message shared by every recipient: a queue push per subscriber, no
+ * re-framing), a catch-up run of deltas for stragglers still inside
+ * the ring, or a fresh snapshot when a cursor has fallen off the ring
+ * (snapshot-on-lag). Bandwidth becomes O(clients x delta) instead of
+ * O(clients x state).
+ *
+ * Wire format: text frames "D <version> "+delta and
+ * "S <version> "+snapshot; a client applies deltas in version order
+ * and resets its model on S. subscribe_at(version) serves reconnecting
+ * clients that present their last applied version: inside the ring
+ * they get the missing deltas, otherwise a snapshot.
+ *
+ * A send that fails (closed connection, full send queue under the
+ * watermark policy) leaves the subscriber's cursor unmoved; the next
+ * publish retries from there, escalating to snapshot-on-lag once the
+ * ring has moved past it.
+ *
+ * The snapshot provider is mandatory before the first subscribe; it
+ * returns the current full state matching the current version.
+ */
+template <typename endpoint_type>
+class broadcast_channel {
+public:
+    typedef lib::function<std::string()> snapshot_provider;
+
+    explicit broadcast_channel(endpoint_type & endpoint)
+      : m_endpoint(endpoint)
+      , m_ring_limit(256)
+      , m_version(0) {}
+
+    /// Provide the current-state snapshot function
+    void set_snapshot_provider(snapshot_provider provider) {
+        m_snapshot = provider;
+    }
+
+    /// Deltas retained for catch-up (default 256)
+    void set_ring_limit(size_t deltas) {
+        m_ring_limit = (deltas < 1 ? 1 : deltas);
+    }
+
+    /// Subscribe a connection, serving it the current snapshot
+    void subscribe(connection_hdl hdl) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        send_snapshot(hdl);
+        m_cursors[key_of(hdl)] = cursor_entry(hdl,m_version);
+    }
+
+    /// Subscribe a reconnecting client at its last applied version
+    /**
+     * Cursors inside the delta ring receive exactly the missing deltas;
+     * older ones receive a snapshot.
+     */
+    void subscribe_at(connection_hdl hdl, uint64_t last_version) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        cursor_entry e(hdl,last_version);
+        if (!catch_up(e)) {
+            send_snapshot(hdl);
+            e.version = m_version;
+        }
+        m_cursors[key_of(hdl)] = e;
+    }
+
+    /// Remove a connection from the channel
+    void unsubscribe(connection_hdl hdl) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        m_cursors.erase(key_of(hdl));
+    }
+
+    /// Publish one versioned delta and deliver per cursor
+    void publish(std::string const & delta) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        m_version++;
+
+        ring_entry re;
+        re.version = m_version;
+        re.framed = "D ";
+        append_u64(re.framed,m_version);
+        re.framed += ' ';
+        re.framed += delta;
+        m_ring.push_back(re);
+        while (m_ring.size() > m_ring_limit) {
+            m_ring.pop_front();
+        }
+
+        // one prepared frame shared by every caught-up subscriber
+        typename endpoint_type::message_ptr prepared;
+        typename std::map<std::string,cursor_entry>::iterator it;
+        for (it = m_cursors.begin(); it != m_cursors.end(); ++it) {
+            cursor_entry & e = it->second;
+            if (e.version == m_version-1) {
+                if (!prepared) {
+                    lib::error_code pec;
+                    prepared = m_endpoint.prepare_message(e.hdl,
+                        m_ring.back().framed,frame::opcode::text,pec);
+                    if (pec) {
+                        continue;
+                    }
+                }
+                lib::error_code ec;
+                m_endpoint.send(e.hdl,prepared,ec);
+                if (!ec) {
+                    e.version = m_version;
+                }
+            } else if (!catch_up(e)) {
+                // fallen off the ring: snapshot-on-lag
+                send_snapshot(e.hdl);
+                e.version = m_version;
+            }
+        }
+    }
+
+    /// Current channel version
+    uint64_t version() const {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        return m_version;
+    }
+
+    /// Subscribers currently tracked
+    size_t subscriber_count() const {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        return m_cursors.size();
+    }
+
+private:
+    struct ring_entry {
+        uint64_t version;
+        std::string framed;
+    };
+
+    struct cursor_entry {
+        cursor_entry() : version(0) {}
+        cursor_entry(connection_hdl h, uint64_t v) : hdl(h), version(v) {}
+
+        connection_hdl hdl;
+        uint64_t version;
+    };
+
+    /// Deliver every ring delta past the cursor; false when the cursor
+    /// is no longer inside the ring. m_lock held.
+    bool catch_up(cursor_entry & e) {
+        if (e.version == m_version) {
+            return true;
+        }
+        if (m_ring.empty() || m_ring.front().version > e.version+1) {
+            return false;
+        }
+        size_t start = static_cast<size_t>(
+            e.version+1-m_ring.front().version);
+        for (size_t i = start; i < m_ring.size(); i++) {
+            lib::error_code ec;
+            m_endpoint.send(e.hdl,m_ring[i].framed,
+                frame::opcode::text,ec);
+            if (ec) {
+                // backpressured: keep the cursor where delivery stopped
+                // and let the next publish resume from there
+                return true;
+            }
+            e.version = m_ring[i].version;
+        }
+        return true;
+    }
+
+    /// Frame and send the current snapshot. m_lock held.
+    void send_snapshot(connection_hdl hdl) {
+        std::string out = "S ";
+        append_u64(out,m_version);
+        out += ' ';
+        if (m_snapshot) {
+            out += m_snapshot();
+        }
+        lib::error_code ec;
+        m_endpoint.send(hdl,out,frame::opcode::text,ec);
+    }
+
+    static std::string key_of(connection_hdl hdl) {
+        char buf[24];
+        std::sprintf(buf,"%p",static_cast<void *>(hdl.lock().get()));
+        return std::string(buf);
+    }
+
+    static void append_u64(std::string & out, uint64_t v) {
+        char buf[24];
+        std::sprintf(buf,"%llu",static_cast<unsigned long long>(v));
+        out += buf;
+    }
+
+    endpoint_type & m_endpoint;
+    size_t m_ring_limit;
+    uint64_t m_version;
+    snapshot_provider m_snapshot;
+
+    mutable lib::mutex m_lock;
+    std::deque<ring_entry> m_ring;
+    std::map<std::string,cursor_entry> m_cursors;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_BROADCAST_CHANNEL_HPP
@@ -131,9 +131,49 @@ namespace status {
      * @param [in] code The code to test
      * @return Whether or not code is reserved
      */
+    /// Classification bits for the defined close code block (1000-1015)
+    /**
+     * The RFC-defined codes cluster in one 16 value block whose
+     * properties the predicates below otherwise re-derive with branch
+     * chains on every close; mass-disconnect paths classify each code
+     * with a single table load instead. Codes outside the block keep
+     * their (cheap) range checks.
+     */
+    namespace detail {
+        static unsigned char const flag_invalid = 0x01;
+        static unsigned char const flag_reserved = 0x02;
+        static unsigned char const flag_terminal = 0x04;
+
+        inline unsigned char classify_defined(value code) {
+            // index 0 = 1000 .. index 15 = 1015
+            static unsigned char const table[16] = {
+                0,              // 1000 normal
+                0,              // 1001 going away
+                flag_terminal,  // 1002 protocol error
+                0,              // 1003 unsupported data
+                flag_reserved,  // 1004 reserved
+                flag_invalid,   // 1005 no status (wire-illegal)
+                flag_invalid,   // 1006 abnormal close (wire-illegal)
+                flag_terminal,  // 1007 invalid payload
+                flag_terminal,  // 1008 policy violation
+                flag_terminal,  // 1009 message too big
+                0,              // 1010 extension required
+                flag_terminal,  // 1011 internal endpoint error
+                flag_reserved,  // 1012 reserved
+                flag_reserved,  // 1013 reserved
+                flag_reserved,  // 1014 reserved
+                flag_invalid    // 1015 tls handshake (wire-illegal)
+            };
+            return table[code-1000];
+        }
+    } // namespace detail
+
     inline bool reserved(value code) {
-        return ((code >= rsv_start && code <= rsv_end) ||
-                code == 1004 || code == 1012 || code == 1013 || code == 1014);
+        if (code >= 1000 && code <= 1015) {
+            return (detail::classify_defined(code)
+                & detail::flag_reserved) != 0;
+        }
+        return (code >= rsv_start && code <= rsv_end);
     }
 
     /// First value in range that is always invalid on the wire
@@ -147,9 +187,11 @@ namespace status {
      * @return Whether or not code is invalid on the wire
      */
     inline bool invalid(value code) {
-        return (code <= invalid_low || code >= invalid_high ||
-                code == no_status || code == abnormal_close ||
-                code == tls_handshake);
+        if (code >= 1000 && code <= 1015) {
+            return (detail::classify_defined(code)
+                & detail::flag_invalid) != 0;
+        }
+        return (code <= invalid_low || code >= invalid_high);
     }
 
     /// Determine if the code represents an unrecoverable error
@@ -165,9 +207,11 @@ namespace status {
      * @return True if the code represents an unrecoverable error
      */
     inline bool terminal(value code) {
-        return (code == protocol_error || code == invalid_payload ||
-                code == policy_violation || code == message_too_big ||
-                 code == internal_endpoint_error);
+        if (code >= 1000 && code <= 1015) {
+            return (detail::classify_defined(code)
+                & detail::flag_terminal) != 0;
+        }
+        return false;
     }
 } // namespace status
 
@@ -221,6 +265,27 @@ inline status::value extract_code(std::string const & payload, lib::error_code
     return code;
 }
 
+/// Validate a close payload's reason bytes without building a string
+/**
+ * The allocation-free half of extract_reason for paths that must
+ * validate every close (RFC 6455 requires failing on invalid UTF-8)
+ * but rarely read the reason text: the payload bytes past the code are
+ * validated in place and copied only by callers that want them.
+ *
+ * @param [in] payload The close frame payload
+ * @return Whether the reason portion is valid UTF-8
+ */
+inline bool reason_valid(std::string const & payload) {
+    if (payload.size() <= 2) {
+        return true;
+    }
+    utf8_validator::validator v;
+    if (!v.decode(payload.begin()+2,payload.end())) {
+        return false;
+    }
+    return v.complete();
+}
+
 /// Extract the reason string from a close payload
 /**
  * The string should be a valid UTF8 message. error::invalid_utf8 will be set if
@@ -53,6 +53,9 @@
     #ifndef _WEBSOCKETPP_INITIALIZER_LISTS_
         #define _WEBSOCKETPP_INITIALIZER_LISTS_
     #endif
+    #ifndef _WEBSOCKETPP_RVALUE_REFERENCES_
+        #define _WEBSOCKETPP_RVALUE_REFERENCES_
+    #endif
 #else
     // Test for noexcept
     #ifndef _WEBSOCKETPP_NOEXCEPT_TOKEN_
@@ -90,6 +93,64 @@
     #if __has_feature(cxx_generalized_initializers) && !defined(_WEBSOCKETPP_INITIALIZER_LISTS_)
         #define _WEBSOCKETPP_INITIALIZER_LISTS_
     #endif
+    
+    // Test for rvalue references
+    #if __has_feature(cxx_rvalue_references) && !defined(_WEBSOCKETPP_RVALUE_REFERENCES_)
+        #define _WEBSOCKETPP_RVALUE_REFERENCES_
+    #endif
+#endif
+
+
+// Conditional noexcept for config-selectable exception-free profiles:
+// expands to noexcept(cond) where the keyword exists and to nothing in
+// C++03 builds (which get no EH-elision either way).
+#ifndef _WEBSOCKETPP_COND_NOEXCEPT_
+    #if defined(_WEBSOCKETPP_CPP11_STL_) || __cplusplus >= 201103L
+        #define _WEBSOCKETPP_COND_NOEXCEPT_(cond) noexcept(cond)
+    #else
+        #define _WEBSOCKETPP_COND_NOEXCEPT_(cond)
+    #endif
 #endif
 
+// Cache line alignment for hot/cold member layout separation.
+//
+// Only enabled where C++17 aligned new (P0035) is available: an
+// over-aligned class allocated with plain operator new -- which is how
+// every connection is created -- does not actually receive its extended
+// alignment before that, so the annotation would promise a guarantee
+// heap objects never get (and GCC warns accordingly). Without aligned
+// new the macro expands to nothing; the hot/warm/cold member grouping
+// still clusters each access pattern's members onto as few lines as
+// the allocator's natural alignment allows, it just cannot pin the
+// section starts to 64 byte boundaries. Layout separation is an
+// optimization, not a correctness requirement.
+#ifndef _WEBSOCKETPP_CACHELINE_ALIGN_
+    #if defined(__cpp_aligned_new) && __cpp_aligned_new >= 201606L
+        #define _WEBSOCKETPP_CACHELINE_ALIGN_ alignas(64)
+    #else
+        #define _WEBSOCKETPP_CACHELINE_ALIGN_
+    #endif
+#endif
+
+namespace websocketpp {
+namespace detail {
+
+/// Maps any well formed type to void, for detecting optional config typedefs
+/**
+ * The SFINAE probe behind the optional-feature selectors (stats, tracer,
+ * fixed processor, allocator): a partial specialization keyed on
+ * `type_sink<typename config::foo>::type` participates only when the
+ * config actually names `foo`, and the primary template supplies the
+ * default otherwise. Lives here, next to the feature macros, because it
+ * is the same kind of capability probe aimed at configs rather than
+ * toolchains.
+ */
+template <typename T>
+struct type_sink {
+    typedef void type;
+};
+
+} // namespace detail
+} // namespace websocketpp
+
 #endif // WEBSOCKETPP_COMMON_CPP11_HPP
@@ -57,6 +57,10 @@ namespace lib {
         /// \todo this feels hacky, is there a better way?
         using ::_1;
         using ::_2;
+        using ::_3;
+        using ::_4;
+        using ::_5;
+        using ::_6;
     }
 #endif
 
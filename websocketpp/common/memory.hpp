@@ -62,6 +62,25 @@ namespace lib {
     typedef boost::scoped_array<unsigned char> unique_ptr_uchar_array;
 #endif
 
+/// Rebind an allocator to another value type, portably
+/**
+ * C++20 removed std::allocator's rebind member; allocator_traits is
+ * the sanctioned spelling from C++11 on, and the classic member
+ * template serves C++03 (where every allocator still provides it).
+ */
+#ifdef _WEBSOCKETPP_CPP11_MEMORY_
+template <typename Alloc, typename T>
+struct rebind_alloc {
+    typedef typename std::allocator_traits<Alloc>::
+        template rebind_alloc<T> type;
+};
+#else
+template <typename Alloc, typename T>
+struct rebind_alloc {
+    typedef typename Alloc::template rebind<T>::other type;
+};
+#endif
+
 } // namespace lib
 } // namespace websocketpp
 
@@ -28,9 +28,13 @@
 #ifndef WEBSOCKETPP_COMMON_NETWORK_HPP
 #define WEBSOCKETPP_COMMON_NETWORK_HPP
 
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/stdint.hpp>
+
 // For ntohs and htons
 #if defined(WIN32)
     #include <winsock2.h>
+    #include <intrin.h>
 #else
     //#include <arpa/inet.h>
     #include <netinet/in.h>
@@ -46,29 +50,38 @@ inline bool is_little_endian() {
     return (ptr[0] == 1);
 }
 
-#define TYP_INIT 0 
-#define TYP_SMLE 1 
-#define TYP_BIGE 2 
+/// Swap the byte order of a 64 bit value
+/**
+ * Uses the compiler's byte swap builtin where one is available (a single
+ * bswap instruction, constant-foldable) and a portable shift/mask form
+ * otherwise.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+inline _WEBSOCKETPP_CONSTEXPR_TOKEN_ uint64_t bswap64(uint64_t v) {
+    return __builtin_bswap64(v);
+}
+#elif defined(_MSC_VER)
+inline uint64_t bswap64(uint64_t v) {
+    return _byteswap_uint64(v);
+}
+#else
+inline _WEBSOCKETPP_CONSTEXPR_TOKEN_ uint64_t bswap64(uint64_t v) {
+    return ((v & 0x00000000000000ffULL) << 56) |
+           ((v & 0x000000000000ff00ULL) << 40) |
+           ((v & 0x0000000000ff0000ULL) << 24) |
+           ((v & 0x00000000ff000000ULL) << 8)  |
+           ((v & 0x000000ff00000000ULL) >> 8)  |
+           ((v & 0x0000ff0000000000ULL) >> 24) |
+           ((v & 0x00ff000000000000ULL) >> 40) |
+           ((v & 0xff00000000000000ULL) >> 56);
+}
+#endif
 
-inline uint64_t htonll(uint64_t src) { 
-    static int typ = TYP_INIT; 
-    unsigned char c; 
-    union { 
-        uint64_t ull; 
-        unsigned char c[8]; 
-    } x; 
-    if (typ == TYP_INIT) { 
-        x.ull = 0x01; 
-        typ = (x.c[7] == 0x01ULL) ? TYP_BIGE : TYP_SMLE; 
-    } 
-    if (typ == TYP_BIGE) 
-        return src;
-    x.ull = src; 
-    c = x.c[0]; x.c[0] = x.c[7]; x.c[7] = c; 
-    c = x.c[1]; x.c[1] = x.c[6]; x.c[6] = c; 
-    c = x.c[2]; x.c[2] = x.c[5]; x.c[5] = c; 
-    c = x.c[3]; x.c[3] = x.c[4]; x.c[4] = c; 
-    return x.ull; 
+inline uint64_t htonll(uint64_t src) {
+    if (is_little_endian()) {
+        return bswap64(src);
+    }
+    return src;
 }
 
 inline uint64_t ntohll(uint64_t src) { 
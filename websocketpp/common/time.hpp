@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_COMMON_TIME_HPP
+#define WEBSOCKETPP_COMMON_TIME_HPP
+
+#include <websocketpp/common/stdint.hpp>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+namespace websocketpp {
+namespace lib {
+
+/// Milliseconds from a monotonic clock
+/**
+ * Cheap steady timestamp for deadline bookkeeping (message TTLs). Uses
+ * the platform's monotonic clock directly so no chrono library link is
+ * introduced for C++03 builds; the epoch is arbitrary, only differences
+ * are meaningful.
+ */
+inline uint64_t steady_ms() {
+#if defined(_WIN32)
+    return static_cast<uint64_t>(GetTickCount64());
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return static_cast<uint64_t>(ts.tv_sec)*1000
+        + static_cast<uint64_t>(ts.tv_nsec)/1000000;
+#endif
+}
+
+/// Microseconds from a monotonic clock
+/**
+ * Companion to steady_ms for latency instrumentation, where millisecond
+ * granularity would flatten every bucket on a fast path.
+ */
+inline uint64_t steady_us() {
+#if defined(_WIN32)
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return static_cast<uint64_t>(c.QuadPart*1000000/f.QuadPart);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return static_cast<uint64_t>(ts.tv_sec)*1000000
+        + static_cast<uint64_t>(ts.tv_nsec)/1000;
+#endif
+}
+
+} // namespace lib
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_COMMON_TIME_HPP
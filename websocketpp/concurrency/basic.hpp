@@ -29,6 +29,9 @@
 #define WEBSOCKETPP_CONCURRENCY_BASIC_HPP
 
 #include <websocketpp/common/thread.hpp>
+#include <websocketpp/concurrency/send_queue.hpp>
+
+#include <memory>
 
 namespace websocketpp {
 namespace concurrency {
@@ -37,7 +40,33 @@ namespace concurrency {
 class basic {
 public:
     typedef lib::mutex mutex_type;
-    typedef lib::lock_guard<mutex_type> scoped_lock_type; 
+    typedef lib::lock_guard<mutex_type> scoped_lock_type;
+
+    /// Per-connection cross-thread upgrade hook; always locked already
+    static void upgrade(mutex_type &) {}
+
+    /// Send queue implementation to use for outgoing messages
+    template <typename T, typename Allocator = std::allocator<T> >
+    struct send_queue {
+        typedef locked_send_queue<T,basic,Allocator> type;
+    };
+};
+
+/// Concurrency policy that uses a lock free MPSC send queue
+/**
+ * Identical to basic except that the per connection outgoing message queue
+ * is a lock free multi-producer single-consumer queue: producer threads
+ * calling connection::send enqueue with a single atomic exchange rather
+ * than contending on the write lock, and the io thread drains without
+ * taking a mutex. Mutexes are still used for the remaining (cold) shared
+ * state.
+ */
+class basic_lockfree : public basic {
+public:
+    template <typename T, typename Allocator = std::allocator<T> >
+    struct send_queue {
+        typedef mpsc_send_queue<T,Allocator> type;
+    };
 };
 
 } // namespace concurrency
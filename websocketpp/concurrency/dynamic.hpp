@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CONCURRENCY_DYNAMIC_HPP
+#define WEBSOCKETPP_CONCURRENCY_DYNAMIC_HPP
+
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/concurrency/send_queue.hpp>
+
+#include <memory>
+
+namespace websocketpp {
+namespace concurrency {
+
+namespace dynamic_impl {
+
+/// Mutex that is a no-op until its owner is flagged cross-thread
+/**
+ * Starts in the disabled state where lock/unlock do nothing, matching
+ * the `none` policy's cost (one predictable branch). enable() upgrades
+ * it permanently to a real mutex, matching `basic`.
+ *
+ * The upgrade is one way and must complete before any concurrent access
+ * starts: flip it from the connection's own io thread (or before the
+ * handle is shared), never while another thread may already be inside a
+ * critical section that elided the lock.
+ */
+class switched_mutex {
+public:
+    switched_mutex() : m_enabled(false) {}
+
+    /// Permanently upgrade to real locking
+    void enable() {
+        m_enabled = true;
+    }
+
+    bool enabled() const {
+        return m_enabled;
+    }
+
+    lib::mutex & raw() {
+        return m_mutex;
+    }
+
+private:
+    lib::mutex m_mutex;
+    bool m_enabled;
+};
+
+/// Lock guard honoring the mutex's state at acquisition time
+/**
+ * The decision to lock is captured in the constructor so a concurrent
+ * (misused) enable() cannot cause an unlock without a matching lock.
+ */
+class switched_lock_guard {
+public:
+    explicit switched_lock_guard(switched_mutex & m)
+      : m_mutex(m), m_locked(m.enabled())
+    {
+        if (m_locked) {
+            m_mutex.raw().lock();
+        }
+    }
+    ~switched_lock_guard() {
+        if (m_locked) {
+            m_mutex.raw().unlock();
+        }
+    }
+
+private:
+    switched_mutex & m_mutex;
+    bool m_locked;
+};
+
+} // namespace dynamic_impl
+
+/// Concurrency policy selectable per connection at runtime
+/**
+ * For mixed topology deployments where nearly every connection is
+ * driven strictly by its io thread (no locks needed) but a few --
+ * admin or broadcast-source connections -- are touched cross-thread.
+ * Every mutex starts elided, giving the common case `none` semantics;
+ * calling connection::set_cross_thread() before sharing the handle
+ * upgrades that connection's mutexes permanently to real locking.
+ *
+ * Configs choose this policy exactly like `basic` or `none`:
+ *
+ * \code
+ * struct my_config : public websocketpp::config::asio {
+ *     typedef websocketpp::concurrency::dynamic concurrency_type;
+ * };
+ * \endcode
+ */
+class dynamic {
+public:
+    typedef dynamic_impl::switched_mutex mutex_type;
+    typedef dynamic_impl::switched_lock_guard scoped_lock_type;
+
+    /// Upgrade a mutex to real locking; hook for set_cross_thread
+    static void upgrade(mutex_type & m) {
+        m.enable();
+    }
+
+    /// Send queue implementation to use for outgoing messages
+    template <typename T, typename Allocator = std::allocator<T> >
+    struct send_queue {
+        typedef locked_send_queue<T,dynamic,Allocator> type;
+    };
+};
+
+} // namespace concurrency
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONCURRENCY_DYNAMIC_HPP
@@ -28,6 +28,10 @@
 #ifndef WEBSOCKETPP_CONCURRENCY_NONE_HPP
 #define WEBSOCKETPP_CONCURRENCY_NONE_HPP
 
+#include <websocketpp/concurrency/send_queue.hpp>
+
+#include <memory>
+
 namespace websocketpp {
 namespace concurrency {
 
@@ -50,6 +54,16 @@ class none {
 public:
     typedef none_impl::fake_mutex mutex_type;
     typedef none_impl::fake_lock_guard scoped_lock_type;
+
+    /// Per-connection cross-thread upgrade hook; this policy has no
+    /// locks to upgrade, single threaded use is a hard assumption
+    static void upgrade(mutex_type &) {}
+
+    /// Send queue implementation to use for outgoing messages
+    template <typename T, typename Allocator = std::allocator<T> >
+    struct send_queue {
+        typedef locked_send_queue<T,none,Allocator> type;
+    };
 };
 
 } // namespace concurrency
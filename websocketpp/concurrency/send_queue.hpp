@@ -0,0 +1,523 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CONCURRENCY_SEND_QUEUE_HPP
+#define WEBSOCKETPP_CONCURRENCY_SEND_QUEUE_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+#include <memory>
+#include <queue>
+
+namespace websocketpp {
+namespace concurrency {
+
+/// Outgoing message queues used by connection
+/**
+ * A send queue couples the queue of prepared outgoing messages with the
+ * "writer active" flag that guarantees at most one transport write is in
+ * flight per connection. Implementations provide four operations:
+ *
+ * **push**\n
+ * `bool push(T msg)`\n
+ * Enqueue a message from any thread. Returns whether the caller should
+ * start a writer (i.e. no writer appeared to be active). May return true
+ * spuriously; pop_for_write deduplicates.
+ *
+ * **push_priority**\n
+ * `bool push_priority(T msg)`\n
+ * As push, but into the control lane: priority messages are dequeued ahead
+ * of everything pushed normally, jumping the queue at the next frame
+ * boundary. Used for ping/pong/close frames, which RFC 6455 permits to be
+ * interjected between the frames of a fragmented message. Priority
+ * messages retain FIFO order among themselves.
+ *
+ * **pop_for_write**\n
+ * `T pop_for_write()`\n
+ * Attempt to claim the writer role and dequeue the next message. Returns an
+ * empty T if another writer is active or the queue is empty. Called only
+ * from the transport io thread.
+ *
+ * **write_complete**\n
+ * `bool write_complete()`\n
+ * Release the writer role after a transport write finishes. Returns whether
+ * more messages are queued (i.e. another write should be started).
+ *
+ * **drop_oldest_data**\n
+ * `T drop_oldest_data()`\n
+ * Remove and return the oldest queued data message for the drop-oldest
+ * slow consumer policy, or an empty T when nothing is droppable. Control
+ * lane messages are never dropped. The lock free queue always returns an
+ * empty T: its consumer end cannot safely be popped from producer
+ * threads, so callers fall back to rejecting the new message.
+ *
+ * **empty / size / bytes**\n
+ * Inspection methods. The lock free implementation returns approximate
+ * values for size and bytes.
+ *
+ * T must be a pointer-like type whose pointee exposes
+ * `get_payload().size()`, which is used for buffered amount accounting.
+ */
+
+/// Mutex guarded send queue
+/**
+ * Direct transliteration of the original m_send_queue + m_write_flag +
+ * m_write_lock protocol. Used by the basic and none concurrency policies.
+ */
+template <typename T, typename concurrency,
+    typename Allocator = std::allocator<T> >
+class locked_send_queue {
+public:
+    typedef typename concurrency::mutex_type mutex_type;
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+    typedef typename lib::rebind_alloc<Allocator,T>::type allocator_type;
+    typedef std::deque<T,allocator_type> queue_type;
+
+    explicit locked_send_queue(Allocator const & alloc = Allocator())
+      : m_queue(allocator_type(alloc))
+      , m_control(allocator_type(alloc))
+      , m_bytes(0)
+      , m_writer_active(false) {}
+
+    /// Upgrade the queue's mutex for cross-thread producers
+    /**
+     * No-op for always-locked and never-locked policies; under the
+     * dynamic policy this enables real locking for this queue.
+     */
+    void upgrade() {
+        concurrency::upgrade(m_lock);
+    }
+
+    /// Enqueue a message. Returns whether a writer should be started.
+    /**
+     * A message carrying a non empty conflation tag replaces a queued
+     * data message with the same tag in place (keeping its queue
+     * position) instead of lengthening the queue.
+     */
+    bool push(T msg) {
+        if (!msg) {
+            return false;
+        }
+        scoped_lock_type lock(m_lock);
+        if (!msg->get_conflation_tag().empty()) {
+            // keyed index into the queue slots: conflation costs one map
+            // lookup instead of a queue scan, so deep queues with many
+            // keys (market data fan-out) stay cheap. Deque slot addresses
+            // are stable under push_back/pop_front, the only operations
+            // the hot path performs.
+            typename conflate_index_type::iterator it =
+                m_conflate_index.find(msg->get_conflation_tag());
+            if (it != m_conflate_index.end()) {
+                T & slot = *(it->second);
+                m_bytes -= slot->get_payload().size();
+                m_bytes += msg->get_payload().size();
+                slot = msg;
+                return !m_writer_active;
+            }
+            m_queue.push_back(msg);
+            m_conflate_index[msg->get_conflation_tag()] = &m_queue.back();
+            m_bytes += msg->get_payload().size();
+            return !m_writer_active;
+        }
+        m_bytes += msg->get_payload().size();
+        m_queue.push_back(msg);
+        return !m_writer_active;
+    }
+
+    /// Remove and return the oldest droppable queued data message, if any
+    /**
+     * Messages marked non droppable (fragment train and streamed-send
+     * frames) are skipped; discarding one frame of a fragmented message
+     * would corrupt the framing of everything after it.
+     */
+    T drop_oldest_data() {
+        scoped_lock_type lock(m_lock);
+        for (typename queue_type::iterator it = m_queue.begin();
+             it != m_queue.end(); ++it)
+        {
+            if ((*it)->get_droppable()) {
+                T msg = *it;
+                m_queue.erase(it);
+                m_bytes -= msg->get_payload().size();
+                // a middle erase moves every later slot; rebuild the
+                // conflation index (overflow shedding is the cold path)
+                rebuild_conflate_index();
+                return msg;
+            }
+        }
+        return T();
+    }
+
+    /// Enqueue a control message ahead of all queued data messages
+    bool push_priority(T msg) {
+        if (!msg) {
+            return false;
+        }
+        scoped_lock_type lock(m_lock);
+        m_bytes += msg->get_payload().size();
+        m_control.push_back(msg);
+        return !m_writer_active;
+    }
+
+    /// Claim the writer role and dequeue, or return an empty T
+    T pop_for_write() {
+        scoped_lock_type lock(m_lock);
+        if (m_writer_active || (m_control.empty() && m_queue.empty())) {
+            return T();
+        }
+        T msg = pop_next();
+        m_writer_active = true;
+        return msg;
+    }
+
+    /// Dequeue an additional message while holding the writer role
+    /**
+     * Only valid between a successful pop_for_write and the matching
+     * write_complete. Returns an empty T when the queue is drained.
+     */
+    T pop_more() {
+        scoped_lock_type lock(m_lock);
+        if (m_control.empty() && m_queue.empty()) {
+            return T();
+        }
+        return pop_next();
+    }
+
+    /// Release the writer role. Returns whether more messages are queued.
+    bool write_complete() {
+        scoped_lock_type lock(m_lock);
+        m_writer_active = false;
+        return !(m_control.empty() && m_queue.empty());
+    }
+
+    bool empty() const {
+        scoped_lock_type lock(m_lock);
+        return m_control.empty() && m_queue.empty();
+    }
+
+    size_t size() const {
+        scoped_lock_type lock(m_lock);
+        return m_control.size() + m_queue.size();
+    }
+
+    /// Total payload bytes currently queued
+    size_t bytes() const {
+        scoped_lock_type lock(m_lock);
+        return m_bytes;
+    }
+
+    /// Discard all queued messages and release the writer role
+    /**
+     * Only valid when no transport write is in flight (e.g. when a
+     * terminated connection is reset for reuse).
+     */
+    void clear() {
+        scoped_lock_type lock(m_lock);
+        m_queue.clear();
+        m_control.clear();
+        m_conflate_index.clear();
+        m_bytes = 0;
+        m_writer_active = false;
+    }
+
+private:
+    /// Dequeue the control lane first. Caller holds the lock and has
+    /// checked that at least one lane is non-empty.
+    T pop_next() {
+        queue_type & q = m_control.empty() ? m_queue : m_control;
+        T msg = q.front();
+        if (&q == &m_queue && !msg->get_conflation_tag().empty()) {
+            m_conflate_index.erase(msg->get_conflation_tag());
+        }
+        q.pop_front();
+        m_bytes -= msg->get_payload().size();
+        return msg;
+    }
+
+    /// Re-point the conflation index after a middle-of-queue erase
+    void rebuild_conflate_index() {
+        m_conflate_index.clear();
+        for (typename queue_type::iterator it = m_queue.begin();
+             it != m_queue.end(); ++it)
+        {
+            if (!(*it)->get_conflation_tag().empty()) {
+                m_conflate_index[(*it)->get_conflation_tag()] = &(*it);
+            }
+        }
+    }
+
+    typedef std::map<std::string,T*> conflate_index_type;
+
+    mutable mutex_type m_lock;
+    queue_type m_queue;
+    queue_type m_control;
+    /// Conflation tag -> queue slot; see push
+    conflate_index_type m_conflate_index;
+    size_t m_bytes;
+    bool m_writer_active;
+};
+
+/// Lock free multi-producer single-consumer send queue
+/**
+ * Intrusive singly linked MPSC queue (Vyukov style): producers enqueue with
+ * a single atomic exchange plus a release store, the io thread dequeues
+ * without any atomic read-modify-write in the common case. Writer role
+ * claiming uses an atomic flag; the pop_for_write retry loop together with
+ * sequentially consistent flag/link ordering closes the classic race where
+ * a producer enqueues just as the consumer is releasing the writer role.
+ *
+ * Each push allocates one queue node. size and bytes are maintained with
+ * relaxed counters and are approximate while producers are active.
+ */
+template <typename T, typename Allocator = std::allocator<T> >
+class mpsc_send_queue {
+public:
+    explicit mpsc_send_queue(Allocator const & alloc = Allocator())
+      : m_size(0)
+      , m_bytes(0)
+      , m_writer_active(false)
+      , m_node_alloc(alloc)
+    {
+        node * stub = make_node();
+        m_head.store(stub,lib::memory_order_relaxed);
+        m_tail = stub;
+        node * cstub = make_node();
+        m_control_head.store(cstub,lib::memory_order_relaxed);
+        m_control_tail = cstub;
+    }
+
+    /// Cross-thread upgrade hook; the mpsc queue is already safe for
+    /// concurrent producers
+    void upgrade() {}
+
+    ~mpsc_send_queue() {
+        node * n = m_tail;
+        while (n) {
+            node * next = n->next.load(lib::memory_order_relaxed);
+            free_node(n);
+            n = next;
+        }
+        n = m_control_tail;
+        while (n) {
+            node * next = n->next.load(lib::memory_order_relaxed);
+            free_node(n);
+            n = next;
+        }
+    }
+
+    /// Enqueue a message. Returns whether a writer should be started.
+    bool push(T msg) {
+        if (!msg) {
+            return false;
+        }
+        size_t payload_bytes = msg->get_payload().size();
+
+        node * n = make_node(msg);
+        node * prev = m_head.exchange(n,lib::memory_order_acq_rel);
+        // seq_cst so this store and the writer flag load below order
+        // against pop_for_write's flag store / link load (Dekker pattern)
+        prev->next.store(n,lib::memory_order_seq_cst);
+
+        m_size.fetch_add(1,lib::memory_order_relaxed);
+        m_bytes.fetch_add(payload_bytes,lib::memory_order_relaxed);
+
+        return !m_writer_active.load(lib::memory_order_seq_cst);
+    }
+
+    /// Enqueue a control message ahead of all queued data messages
+    /**
+     * Same enqueue protocol as push, on the control lane; the consumer
+     * drains the control lane before touching the data lane.
+     */
+    bool push_priority(T msg) {
+        if (!msg) {
+            return false;
+        }
+        size_t payload_bytes = msg->get_payload().size();
+
+        node * n = make_node(msg);
+        node * prev = m_control_head.exchange(n,lib::memory_order_acq_rel);
+        prev->next.store(n,lib::memory_order_seq_cst);
+
+        m_size.fetch_add(1,lib::memory_order_relaxed);
+        m_bytes.fetch_add(payload_bytes,lib::memory_order_relaxed);
+
+        return !m_writer_active.load(lib::memory_order_seq_cst);
+    }
+
+    /// Claim the writer role and dequeue, or return an empty T
+    T pop_for_write() {
+        for (;;) {
+            if (m_writer_active.exchange(true,lib::memory_order_seq_cst)) {
+                // another writer is active; it will observe our message
+                return T();
+            }
+
+            T msg = try_pop();
+            if (msg) {
+                return msg;
+            }
+
+            // Queue looked empty. Release the writer role and re-check: a
+            // producer may have linked a node between our pop and the
+            // release, and observed the flag as still set.
+            m_writer_active.store(false,lib::memory_order_seq_cst);
+            if (!has_next()) {
+                return T();
+            }
+        }
+    }
+
+    /// Dequeue an additional message while holding the writer role
+    /**
+     * Only valid between a successful pop_for_write and the matching
+     * write_complete; the caller is the single consumer.
+     */
+    T pop_more() {
+        return try_pop();
+    }
+
+    /// Drop-oldest is unsupported: only the io thread may pop
+    /**
+     * Returning an empty T makes connection::check_send_watermarks fall
+     * back to rejecting the new message, which still bounds the queue.
+     */
+    T drop_oldest_data() {
+        return T();
+    }
+
+    /// Release the writer role. Returns whether more messages are queued.
+    bool write_complete() {
+        m_writer_active.store(false,lib::memory_order_seq_cst);
+        return has_next();
+    }
+
+    bool empty() const {
+        return !has_next();
+    }
+
+    /// Approximate number of queued messages
+    size_t size() const {
+        return m_size.load(lib::memory_order_relaxed);
+    }
+
+    /// Approximate total payload bytes currently queued
+    size_t bytes() const {
+        return m_bytes.load(lib::memory_order_relaxed);
+    }
+
+    /// Discard all queued messages and release the writer role
+    /**
+     * Only valid when no producers are active and no write is in flight
+     * (e.g. when a terminated connection is reset for reuse).
+     */
+    void clear() {
+        while (try_pop()) {}
+        m_writer_active.store(false,lib::memory_order_seq_cst);
+    }
+
+private:
+    struct node {
+        node() : next(NULL) {}
+        explicit node(T v) : next(NULL), value(v) {}
+
+        lib::atomic<node *> next;
+        T value;
+    };
+
+    /// Whether the consumer-visible end of either lane has a linked node
+    bool has_next() const {
+        return m_control_tail->next.load(lib::memory_order_seq_cst) != NULL
+            || m_tail->next.load(lib::memory_order_seq_cst) != NULL;
+    }
+
+    /// Single-consumer dequeue, control lane first. Only called with the
+    /// writer role held.
+    T try_pop() {
+        T msg = lane_pop(m_control_tail);
+        if (!msg) {
+            msg = lane_pop(m_tail);
+        }
+        return msg;
+    }
+
+    /// Dequeue from one lane's consumer end
+    T lane_pop(node * & tail_ref) {
+        node * tail = tail_ref;
+        node * next = tail->next.load(lib::memory_order_acquire);
+        if (!next) {
+            return T();
+        }
+        tail_ref = next;
+        T msg = next->value;
+        next->value = T();
+        free_node(tail);
+
+        m_size.fetch_sub(1,lib::memory_order_relaxed);
+        m_bytes.fetch_sub(msg->get_payload().size(),
+            lib::memory_order_relaxed);
+        return msg;
+    }
+
+    typedef typename lib::rebind_alloc<Allocator,node>::type
+        node_allocator_type;
+
+    node * make_node() {
+        node * n = m_node_alloc.allocate(1);
+        new (static_cast<void*>(n)) node();
+        return n;
+    }
+    node * make_node(T msg) {
+        node * n = m_node_alloc.allocate(1);
+        new (static_cast<void*>(n)) node(msg);
+        return n;
+    }
+    void free_node(node * n) {
+        n->~node();
+        m_node_alloc.deallocate(n,1);
+    }
+
+    lib::atomic<node *> m_head;
+    node * m_tail;
+    lib::atomic<node *> m_control_head;
+    node * m_control_tail;
+    node_allocator_type m_node_alloc;
+    lib::atomic<size_t> m_size;
+    lib::atomic<size_t> m_bytes;
+    lib::atomic<bool> m_writer_active;
+};
+
+} // namespace concurrency
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONCURRENCY_SEND_QUEUE_HPP
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CONCURRENCY_WORKER_POOL_HPP
+#define WEBSOCKETPP_CONCURRENCY_WORKER_POOL_HPP
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <queue>
+#include <vector>
+
+namespace websocketpp {
+namespace concurrency {
+
+/// A fixed size pool of worker threads consuming a shared task queue
+/**
+ * Used to move CPU bound work (notably permessage-deflate compression) off
+ * the io threads. Tasks run in FIFO submission order across the pool but
+ * with no ordering guarantee between tasks running on different workers;
+ * callers needing per object ordering (e.g. per connection) should chain
+ * their tasks, submitting the next only when the previous completes, as
+ * connection's compression pipeline does.
+ *
+ * The pool joins its threads on destruction after running any tasks still
+ * queued.
+ */
+class worker_pool {
+public:
+    typedef lib::shared_ptr<worker_pool> ptr;
+    typedef lib::function<void()> task_type;
+
+    explicit worker_pool(size_t num_threads = 1)
+      : m_stop(false)
+    {
+        if (num_threads < 1) {
+            num_threads = 1;
+        }
+        for (size_t i = 0; i < num_threads; i++) {
+            m_threads.push_back(lib::shared_ptr<lib::thread>(
+                new lib::thread(lib::bind(&worker_pool::run,this))));
+        }
+    }
+
+    ~worker_pool() {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (size_t i = 0; i < m_threads.size(); i++) {
+            m_threads[i]->join();
+        }
+    }
+
+    /// Queue a task for execution on one of the pool's threads
+    void post(task_type task) {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            m_tasks.push(task);
+        }
+        m_cond.notify_one();
+    }
+
+    /// Number of worker threads
+    size_t size() const {
+        return m_threads.size();
+    }
+
+private:
+    // non-copyable
+    worker_pool(worker_pool const &);
+    worker_pool & operator=(worker_pool const &);
+
+    void run() {
+        for (;;) {
+            task_type task;
+            {
+                lib::unique_lock<lib::mutex> lock(m_lock);
+                while (m_tasks.empty() && !m_stop) {
+                    m_cond.wait(lock);
+                }
+                if (m_tasks.empty()) {
+                    return;
+                }
+                task = m_tasks.front();
+                m_tasks.pop();
+            }
+            task();
+        }
+    }
+
+    lib::mutex m_lock;
+    lib::condition_variable m_cond;
+    std::queue<task_type> m_tasks;
+    std::vector<lib::shared_ptr<lib::thread> > m_threads;
+    bool m_stop;
+};
+
+} // namespace concurrency
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONCURRENCY_WORKER_POOL_HPP
@@ -82,11 +82,26 @@ struct core {
     typedef message_buffer::alloc::endpoint_msg_manager<con_msg_manager_type> 
         endpoint_msg_manager_type;
     
+    /// Static logging levels, declared ahead of the logger typedefs so
+    /// they can be baked into the logger type as a compile time filter.
+    /// See the full documentation below with the other static settings.
+    static const websocketpp::log::level elog_level =
+        websocketpp::log::elevel::all ^ websocketpp::log::elevel::devel;
+    static const websocketpp::log::level alog_level =
+        websocketpp::log::alevel::all ^ websocketpp::log::alevel::devel;
+
     /// Logging policies
+    /**
+     * The static log levels are part of the logger's type: write calls for
+     * filtered channels fold to nothing, and call sites using the
+     * static_test guard idiom skip constructing their log messages
+     * entirely. Configs that change elog_level/alog_level must instantiate
+     * their own logger typedefs with the matching filter.
+     */
     typedef websocketpp::log::basic<concurrency_type,
-        websocketpp::log::elevel> elog_type;
+        websocketpp::log::elevel,elog_level> elog_type;
     typedef websocketpp::log::basic<concurrency_type,
-        websocketpp::log::alevel> alog_type;
+        websocketpp::log::alevel,alog_level> alog_type;
     
     /// RNG policies
     typedef websocketpp::random::none::int_generator<uint32_t> rng_type;
@@ -143,6 +158,46 @@ struct core {
     static const long timeout_close_handshake = 5000;
     /// Length of time to wait for a pong after a ping
     static const long timeout_pong = 5000;
+
+    /// Exception-free hot path profile
+    /**
+     * When a config overrides this to true, the connection's per frame
+     * hot functions are declared noexcept, handler invocations are not
+     * wrapped in try/catch (an escaping handler exception terminates
+     * the process -- the terminate-on-throw contract), and library
+     * internal signaling on those paths is strictly error_code based.
+     * Handshake-phase HTTP parsing retains its internal exceptions
+     * either way; they are converted to error codes before reaching
+     * connection code.
+     */
+    static const bool exceptionless = false;
+
+    /// Maximum accepted inbound message size in bytes; 0 is unlimited
+    /**
+     * Enforced as frames arrive: a frame or reassembled message that
+     * would exceed the cap fails with message_too_big (close code
+     * 1009) before its payload is buffered. Because the cap is a
+     * compile time constant, configs bounded to the basic (<=125) or
+     * 16-bit (<=65535) length class also prune the larger extended
+     * length handling from the parser's code: a 64-bit length frame
+     * rejects on its header byte without the 8-byte length ever being
+     * parsed.
+     */
+    static const size_t max_message_size = 0;
+
+    /// Frame-level integrity instrumentation
+    /**
+     * When a config overrides this to true, a hardware CRC32C is
+     * computed over every data payload at the write point (as framed
+     * for the wire) and at the read point (after unmasking), feeding
+     * the per connection integrity counters
+     * (connection::get_integrity_stats). For production forensics --
+     * NIC or path corruption shows as diverging checksums between the
+     * two ends of an unmasked direction -- without touching
+     * application payloads. Off by default: the pass is cheap (the
+     * bytes are cache hot) but not free.
+     */
+    static const bool integrity_checks = false;
     
     /// WebSocket Protocol version to use as a client
     /**
@@ -161,9 +216,10 @@ struct core {
      * channel 
      * 
      * Default is all except for development/debug level errors
+     *
+     * (Declared with the logging policy typedefs above; documented here
+     * with the other static settings.)
      */ 
-    static const websocketpp::log::level elog_level = 
-        websocketpp::log::elevel::all ^ websocketpp::log::elevel::devel;
         
     /// Default static access logging channels
     /**
@@ -174,9 +230,10 @@ struct core {
      * channel 
      * 
      * Default is all except for development/debug level access messages
+     *
+     * (Declared with the logging policy typedefs above; documented here
+     * with the other static settings.)
      */ 
-    static const websocketpp::log::level alog_level = 
-        websocketpp::log::alevel::all ^ websocketpp::log::alevel::devel;
     
     /// 
     static const size_t connection_read_buffer_size = 512;
@@ -82,11 +82,18 @@ struct core_client {
     typedef message_buffer::alloc::endpoint_msg_manager<con_msg_manager_type> 
         endpoint_msg_manager_type;
     
+    /// Static logging levels, declared ahead of the logger typedefs so
+    /// they can be baked into the logger type as a compile time filter.
+    static const websocketpp::log::level elog_level =
+        websocketpp::log::elevel::all ^ websocketpp::log::elevel::devel;
+    static const websocketpp::log::level alog_level =
+        websocketpp::log::alevel::all ^ websocketpp::log::alevel::devel;
+
     /// Logging policies
     typedef websocketpp::log::basic<concurrency_type,
-        websocketpp::log::elevel> elog_type;
+        websocketpp::log::elevel,elog_level> elog_type;
     typedef websocketpp::log::basic<concurrency_type,
-        websocketpp::log::alevel> alog_type;
+        websocketpp::log::alevel,alog_level> alog_type;
     
     /// RNG policies
     typedef websocketpp::random::random_device::int_generator<uint32_t,
@@ -144,6 +151,17 @@ struct core_client {
     static const long timeout_close_handshake = 5000;
     /// Length of time to wait for a pong after a ping
     static const long timeout_pong = 5000;
+
+    /// Exception-free hot path profile; see config::core::exceptionless
+    static const bool exceptionless = false;
+
+    /// Maximum accepted inbound message size; see
+    /// config::core::max_message_size
+    static const size_t max_message_size = 0;
+
+    /// Frame-level integrity instrumentation; see
+    /// config::core::integrity_checks
+    static const bool integrity_checks = false;
     
     /// WebSocket Protocol version to use as a client
     /**
@@ -162,9 +180,9 @@ struct core_client {
      * channel 
      * 
      * Default is all except for development/debug level errors
+     *
+     * (Declared with the logging policy typedefs above.)
      */ 
-    static const websocketpp::log::level elog_level = 
-        websocketpp::log::elevel::all ^ websocketpp::log::elevel::devel;
         
     /// Default static access logging channels
     /**
@@ -175,9 +193,9 @@ struct core_client {
      * channel 
      * 
      * Default is all except for development/debug level access messages
+     *
+     * (Declared with the logging policy typedefs above.)
      */ 
-    static const websocketpp::log::level alog_level = 
-        websocketpp::log::alevel::all ^ websocketpp::log::alevel::devel;
     
     /// 
     static const size_t connection_read_buffer_size = 512;
@@ -144,6 +144,17 @@ struct debug_core {
     static const long timeout_close_handshake = 5000;
     /// Length of time to wait for a pong after a ping
     static const long timeout_pong = 5000;
+
+    /// Exception-free hot path profile; see config::core::exceptionless
+    static const bool exceptionless = false;
+
+    /// Maximum accepted inbound message size; see
+    /// config::core::max_message_size
+    static const size_t max_message_size = 0;
+
+    /// Frame-level integrity instrumentation; see
+    /// config::core::integrity_checks
+    static const bool integrity_checks = false;
     
     /// WebSocket Protocol version to use as a client
     /**
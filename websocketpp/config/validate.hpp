@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CONFIG_VALIDATE_HPP
+#define WEBSOCKETPP_CONFIG_VALIDATE_HPP
+
+#include <websocketpp/extensions/permessage_deflate/disabled.hpp>
+#include <websocketpp/processors/processor.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+// Not in namespace config: endpoints name their template parameter
+// 'config', which would shadow the namespace at the instantiation sites.
+namespace config_validation {
+
+namespace detail {
+
+/// C++03 compatible compile time assertion; the array type is ill formed
+/// (negative size) exactly when the condition fails, and its name carries
+/// the diagnostic
+template <bool Condition>
+struct config_check {
+    typedef char passed[1];
+};
+template <>
+struct config_check<false> {};
+
+/// Whether a config's permessage_deflate_type is the disabled stub
+template <typename T>
+struct pmd_enabled {
+    static bool const value = true;
+};
+template <typename T>
+struct pmd_enabled<extensions::permessage_deflate::disabled<T> > {
+    static bool const value = false;
+};
+
+} // namespace detail
+
+/// Compile time sanity checks for a config's tuning constants
+/**
+ * Instantiated by the endpoint for every config it is built with, so
+ * nonsensical combinations fail the build with the violated condition in
+ * the diagnostic instead of misbehaving in production. The checks are
+ * deliberately conservative: they reject only values that cannot work
+ * (a read buffer smaller than a frame header, zero or negative
+ * timeouts), not merely questionable tuning -- see config_report for
+ * surfacing the effective values themselves.
+ */
+template <typename config>
+struct validator {
+    // the read buffer must at least hold a maximal frame header, and a
+    // zero size buffer cannot make read progress at all
+    typedef typename detail::config_check<
+        config::connection_read_buffer_size >= 16
+        >::passed read_buffer_holds_a_frame_header;
+
+    // zero or negative handshake/close/pong timeouts would fire
+    // immediately (or never), wedging every connection
+    typedef typename detail::config_check<
+        (config::timeout_open_handshake > 0)
+        >::passed open_handshake_timeout_positive;
+    typedef typename detail::config_check<
+        (config::timeout_close_handshake > 0)
+        >::passed close_handshake_timeout_positive;
+    typedef typename detail::config_check<
+        (config::timeout_pong > 0)
+        >::passed pong_timeout_positive;
+
+    static bool const ok = true;
+};
+
+/// Compile time tuning report, emitted as a deprecation warning
+/**
+ * Define WEBSOCKETPP_CONFIG_REPORT to have every endpoint instantiation
+ * emit one warning whose template arguments spell out the config's
+ * effective tuning: read buffer size, handshake/pong timeouts, and
+ * whether permessage-deflate, the draft protocol processors, and a
+ * compile time fixed processor are in play. The build still succeeds;
+ * the report rides the compiler's template argument printing.
+ */
+template <size_t ReadBufferBytes, long OpenTimeoutMs, long PongTimeoutMs,
+    bool PermessageDeflate, bool LegacyVersions, bool FixedProcessor>
+struct config_report {
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((deprecated("websocketpp config tuning report")))
+#endif
+    static void emit() {}
+};
+
+template <typename config>
+struct reporter {
+    static void emit() {
+#ifdef WEBSOCKETPP_CONFIG_REPORT
+        config_report<
+            config::connection_read_buffer_size,
+            config::timeout_open_handshake,
+            config::timeout_pong,
+            detail::pmd_enabled<
+                typename config::permessage_deflate_type>::value,
+            processor::legacy_versions<config>::value,
+            processor::selector<config>::fixed
+        >::emit();
+#endif
+    }
+};
+
+} // namespace config_validation
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONFIG_VALIDATE_HPP
@@ -29,11 +29,18 @@
 #define WEBSOCKETPP_CONNECTION_HPP
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/common/arena.hpp>
 #include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/time.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
 #include <websocketpp/error.hpp>
 #include <websocketpp/frame.hpp>
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/crc32c.hpp>
+#include <websocketpp/instrumentation.hpp>
+#include <websocketpp/tracing.hpp>
+#include <websocketpp/concurrency/worker_pool.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/processors/processor.hpp>
@@ -47,6 +54,91 @@
 
 namespace websocketpp {
 
+/// Over-limit policies for the built-in rate limiter
+namespace rate_limit {
+    enum policy {
+        /// Pause transport reads until the bucket refills (backpressure)
+        delay = 0,
+        /// Discard over-limit complete messages without dispatching
+        drop = 1,
+        /// Close the connection with policy_violation
+        close = 2
+    };
+
+/// Endpoint-wide aggregate token bucket over striped atomics
+/**
+ * Shared by every connection of an endpoint; each connection charges
+ * the stripe its identity hashes to, so enforcement scales without a
+ * shared cache line. Total capacity is divided evenly across stripes,
+ * which makes the limit approximate (a stripe can run dry while
+ * another has budget) -- the usual striping trade, acceptable for
+ * abuse ceilings. Token arithmetic is in millitokens so fractional
+ * refill between microsecond stamps does not round to zero.
+ */
+struct striped_bucket {
+    typedef lib::shared_ptr<striped_bucket> ptr;
+    static size_t const stripes = 8;
+
+    explicit striped_bucket(double rate_per_sec) {
+        int64_t per_stripe = static_cast<int64_t>(
+            rate_per_sec*1000.0/stripes);
+        if (per_stripe < 1) {
+            per_stripe = 1;
+        }
+        m_rate_milli = per_stripe;
+        uint64_t now = lib::steady_us();
+        for (size_t i = 0; i < stripes; i++) {
+            m_stripe[i].tokens.store(per_stripe,
+                lib::memory_order_relaxed);
+            m_stripe[i].last_us.store(now,lib::memory_order_relaxed);
+        }
+    }
+
+    /// Charge `amount` tokens against the caller's stripe
+    /**
+     * @param key A stable per-connection hash selecting the stripe
+     * @param amount Tokens to consume
+     * @return Whether the stripe is over its limit after the charge
+     */
+    bool charge(size_t key, uint64_t amount) {
+        stripe & st = m_stripe[key % stripes];
+        uint64_t now = lib::steady_us();
+        uint64_t last = st.last_us.load(lib::memory_order_relaxed);
+        if (now > last
+            && st.last_us.compare_exchange_strong(last,now))
+        {
+            int64_t add = static_cast<int64_t>(
+                (now-last)*static_cast<uint64_t>(m_rate_milli)/1000000);
+            int64_t cur = st.tokens.fetch_add(add,
+                lib::memory_order_relaxed)+add;
+            if (cur > m_rate_milli) {
+                // clamp to one second of burst; the race with a
+                // concurrent charge only under-fills, never over-fills
+                st.tokens.store(m_rate_milli,lib::memory_order_relaxed);
+            }
+        }
+        int64_t cost = static_cast<int64_t>(amount)*1000;
+        int64_t after = st.tokens.fetch_sub(cost,
+            lib::memory_order_relaxed)-cost;
+        if (after < -m_rate_milli) {
+            st.tokens.store(-m_rate_milli,lib::memory_order_relaxed);
+        }
+        return after < 0;
+    }
+
+private:
+    struct stripe {
+        stripe() : tokens(0), last_us(0) {}
+        lib::atomic<int64_t> tokens;
+        lib::atomic<uint64_t> last_us;
+        char pad[64-2*sizeof(lib::atomic<int64_t>)];
+    };
+    stripe m_stripe[stripes];
+    int64_t m_rate_milli;
+};
+
+} // namespace rate_limit
+
 /// The type and function signature of an open handler
 /**
  * The open handler is called once for every successful WebSocket connection 
@@ -211,6 +303,61 @@ namespace internal_state {
 } // namespace internal_state
 } // namespace session
 
+/// Empty defaults for configs using static handler dispatch
+/**
+ * A config may name a static_handler_type: a class whose static
+ * on_message/on_open/on_close/on_fail methods are called directly from
+ * the connection's hot paths instead of through the std::function
+ * handler slots, letting the optimizer inline fixed-topology handlers
+ * and reclaiming the indirect call per event. Derive from this base to
+ * override only the events of interest:
+ *
+ * The base is parameterized on the message pointer type (configs
+ * typically inherit it from a stock config) so the handler class can be
+ * defined before the config that names it:
+ *
+ * \code
+ * struct my_handlers : public websocketpp::static_handler_base<
+ *     websocketpp::config::asio::message_type::ptr>
+ * {
+ *     static void on_message(connection_hdl hdl,
+ *         websocketpp::config::asio::message_type::ptr msg);
+ * };
+ * struct my_config : public websocketpp::config::asio {
+ *     typedef my_handlers static_handler_type;
+ * };
+ * \endcode
+ *
+ * The dynamic handler slots still work for every other event (and are
+ * not consulted for events a static handler owns).
+ */
+template <typename message_ptr_type>
+struct static_handler_base {
+    typedef message_ptr_type message_ptr;
+
+    static void on_message(connection_hdl, message_ptr) {}
+    static void on_open(connection_hdl) {}
+    static void on_close(connection_hdl) {}
+    static void on_fail(connection_hdl) {}
+};
+
+namespace detail {
+/// Selects the config's static_handler_type; fall back to none
+template <typename config, typename Enable = void>
+struct static_handler_selector {
+    static bool const enabled = false;
+    typedef void type;
+};
+
+template <typename config>
+struct static_handler_selector<config,
+    typename type_sink<typename config::static_handler_type>::type>
+{
+    static bool const enabled = true;
+    typedef typename config::static_handler_type type;
+};
+} // namespace detail
+
 /// Represents an individual WebSocket connection
 template <typename config>
 class connection
@@ -228,6 +375,18 @@ public:
     
     /// Type of the concurrency component of this connection
     typedef typename config::concurrency_type concurrency_type;
+    /// Allocator policy for connection-owned transient containers
+    /**
+     * Selected from the config's optional allocator_type typedef,
+     * defaulting to std::allocator. Plugging lib::arena_allocator routes
+     * the connection's container churn (read buffer, send queue nodes)
+     * through one per connection arena freed wholesale at teardown.
+     */
+    typedef typename lib::allocator_selector<config>::type allocator_type;
+    /// Type of the outgoing message queue selected by the concurrency policy
+    typedef typename concurrency_type::template send_queue<
+        typename config::message_type::ptr,allocator_type>::type
+        send_queue_type;
     /// Type of the access logging policy
     typedef typename config::alog_type alog_type;
     /// Type of the error logging policy
@@ -258,9 +417,74 @@ public:
     
     typedef processor::processor<config> processor_type;
     typedef lib::shared_ptr<processor_type> processor_ptr;
+
+    /// Compile time processor selection policy for this config
+    typedef processor::selector<config> processor_selector;
+
+    /// Instrumentation policy for this config (instrumentation::none unless
+    /// the config defines stats_type)
+    /// Compile time tracing policy for this config (tracing::none
+    /// unless the config defines tracer_type)
+    typedef typename tracing::selector<config>::type tracer;
+
+    typedef typename instrumentation::selector<config>::type stats_type;
+    typedef typename stats_type::ptr stats_ptr;
     
     // Message handler (needs to know message type)
     typedef lib::function<void(connection_hdl,message_ptr)> message_handler;
+    /// Batched message handler signature; see set_batch_message_handler
+    typedef lib::function<void(connection_hdl,message_ptr const *,size_t)>
+        batch_message_handler;
+
+    /// Type of the streaming message chunk handler
+    /**
+     * Invoked with unmasked, decompressed payload spans of a data message
+     * as they arrive, tagged with the message opcode, whether this is the
+     * first chunk of the message, and whether the message is complete. The
+     * end of a message is always signaled by a call with is_final true and
+     * a zero length span. The span points into transient processing
+     * buffers and must be consumed or copied before returning.
+     */
+    typedef lib::function<void(connection_hdl,frame::opcode::value,
+        char const *,size_t,bool,bool)> message_chunk_handler;
+
+    /// Immutable table of session handlers shared between connections
+    /**
+     * The endpoint owns a table holding its current default handlers and
+     * every connection references it by pointer, so creating a connection
+     * copies one shared_ptr instead of a dozen lib::function objects.
+     * Installing a per connection handler copies the table first
+     * (copy-on-write), leaving other connections and the endpoint's
+     * defaults untouched.
+     */
+    struct handler_table {
+        typedef lib::shared_ptr<handler_table> ptr;
+
+        open_handler            open;
+        close_handler           close;
+        fail_handler            fail;
+        ping_handler            ping;
+        pong_handler            pong;
+        pong_timeout_handler    pong_timeout;
+        interrupt_handler       interrupt;
+        http_handler            http;
+        validate_handler        validate;
+        message_handler         message;
+        /// Per-opcode handlers; take precedence over `message` for
+        /// their opcode when set
+        message_handler         text_message;
+        message_handler         binary_message;
+        /// First-byte routing table for binary messages; lazily sized
+        /// to 256 entries on the first set_binary_route
+        std::vector<message_handler> binary_routes;
+        batch_message_handler   batch_message;
+        message_chunk_handler   message_chunk;
+
+        /// Fired when the send queue crosses the high watermark
+        open_handler            send_queue_full;
+        /// Fired when the send queue drains back below the low watermark
+        open_handler            send_queue_drain;
+    };
     
     /// Type of a pointer to a transport timer handle
     typedef typename transport_con_type::timer_ptr timer_ptr;
@@ -279,21 +503,90 @@ public:
     explicit connection(bool is_server, std::string const & ua, alog_type& alog, 
         elog_type& elog, rng_type & rng)
       : transport_con_type(is_server,alog,elog)
-      , m_user_agent(ua)
       , m_state(session::state::connecting)
       , m_internal_state(session::internal_state::USER_INIT)
-      , m_msg_manager(new con_msg_manager_type())
-      , m_send_buffer_size(0)
-      , m_write_flag(false)
+      , m_buf(typename lib::rebind_alloc<allocator_type,char>::type(
+            m_allocator))
       , m_is_server(is_server)
       , m_alog(alog)
       , m_elog(elog)
       , m_rng(rng)
+      , m_send_queue(m_allocator)
+      , m_user_agent(ua)
       , m_local_close_code(close::status::abnormal_close)
+      , m_close_reason_deferred(false)
       , m_remote_close_code(close::status::abnormal_close)
       , m_was_clean(false)
     {
         m_alog.write(log::alevel::devel,"connection constructor");
+
+        // cold-start cost matters at accept storm rates: reference shared
+        // immutable defaults instead of allocating per connection (the
+        // endpoint installs its own table and stats immediately after
+        // construction, and copy-on-write protects the shared ones), and
+        // defer the read buffer until start() so armed-but-unconnected
+        // and pooled-idle connections hold no buffer
+        m_handlers = default_handler_table();
+        m_stats = default_stats();
+        m_full_reads = 0;
+        m_max_read_buffer_size = config::connection_read_buffer_size*64;
+        m_read_budget_frames = 0;
+        m_read_budget_us = 0;
+        m_read_resuming = false;
+        m_rl_enabled = false;
+        m_rl_policy = rate_limit::delay;
+        m_rl_msg_rate = 0;
+        m_rl_byte_rate = 0;
+        m_rl_msg_tokens = 0;
+        m_rl_byte_tokens = 0;
+        m_rl_last_us = 0;
+        m_rl_agg_key = 0;
+        m_swept_pong_timeouts = false;
+        m_mailbox_enabled = false;
+        m_mailbox_head.store(0,lib::memory_order_relaxed);
+        m_mailbox_armed.store(false,lib::memory_order_relaxed);
+        m_msg_manager_ready.store(false,lib::memory_order_relaxed);
+        m_handshake_gauge_held = false;
+        m_reads_observed = 0;
+        m_compact_requested.store(false,lib::memory_order_relaxed);
+        m_max_outgoing_frame_size = 0;
+        m_subprotocol_index = static_cast<size_t>(-1);
+        m_borrowed_messages = false;
+        m_validation_policy = processor::validation_policy::strict;
+        m_compression_dictionary.clear();
+        m_compress_reset_msgs = 0;
+        m_compress_reset_bytes = 0;
+        m_default_ttl_ms = 0;
+        m_last_read_us = 0;
+        m_max_header_bytes = http::max_header_size;
+        m_max_header_line_bytes = 0;
+        m_raw_continuations = false;
+        m_terminating = false;
+        m_prescreened = false;
+        m_http_keepalive_requests = 0;
+        m_http_keepalive_idle_ms = 5000;
+        m_http_requests_served = 0;
+        m_http_keepalive_this = false;
+        m_stream_active = false;
+        m_pong_count.store(0,lib::memory_order_relaxed);
+        m_compress_active = false;
+        m_offload_cap = 64;
+        m_offload_active = false;
+        m_offload_paused = false;
+        m_chunk_first = true;
+        m_direct_payload_reads = false;
+        m_send_high_watermark = 0;
+        m_send_low_watermark = 0;
+        m_slow_consumer_policy = slow_consumer_policy::none;
+        m_send_queue_over = false;
+        m_read_paused = false;
+        m_read_withheld = false;
+        m_auto_read_pause = false;
+
+        // store inbound handshake headers as slices of the raw bytes rather
+        // than map nodes; accessors materialize lazily so behavior is
+        // unchanged (see http::parser::parser::set_arena_parse)
+        m_request.set_arena_parse(true);
     }
     
     ///////////////////////////
@@ -308,7 +601,8 @@ public:
      * @param h The new open_handler
      */
     void set_open_handler(open_handler h) {
-        m_open_handler = h;
+        ensure_unique_handlers();
+        m_handlers->open = h;
     }
 
     /// Set close handler
@@ -318,7 +612,8 @@ public:
      * @param h The new close_handler
      */
     void set_close_handler(close_handler h) {
-        m_close_handler = h;
+        ensure_unique_handlers();
+        m_handlers->close = h;
     }
     
     /// Set fail handler
@@ -329,7 +624,8 @@ public:
      * @param h The new fail_handler
      */
     void set_fail_handler(fail_handler h) {
-        m_fail_handler = h;
+        ensure_unique_handlers();
+        m_handlers->fail = h;
     }
 
     /// Set ping handler
@@ -344,7 +640,8 @@ public:
      * @param h The new ping_handler
      */
     void set_ping_handler(ping_handler h) {
-        m_ping_handler = h;
+        ensure_unique_handlers();
+        m_handlers->ping = h;
     }
     
     /// Set pong handler
@@ -355,7 +652,8 @@ public:
      * @param h The new pong_handler
      */
     void set_pong_handler(pong_handler h) {
-        m_pong_handler = h;
+        ensure_unique_handlers();
+        m_handlers->pong = h;
     }
     
     /// Set pong timeout handler
@@ -378,7 +676,8 @@ public:
      * @param h The new pong_timeout_handler
      */
     void set_pong_timeout_handler(pong_timeout_handler h) {
-        m_pong_timeout_handler = h;
+        ensure_unique_handlers();
+        m_handlers->pong_timeout = h;
     }
     
     /// Set interrupt handler
@@ -389,7 +688,8 @@ public:
      * @param h The new interrupt_handler
      */
     void set_interrupt_handler(interrupt_handler h) {
-        m_interrupt_handler = h;
+        ensure_unique_handlers();
+        m_handlers->interrupt = h;
     }
 
     /// Set http handler
@@ -404,7 +704,8 @@ public:
      * @param h The new http_handler
      */
     void set_http_handler(http_handler h) {
-        m_http_handler = h;
+        ensure_unique_handlers();
+        m_handlers->http = h;
     }
     
     /// Set validate handler
@@ -420,7 +721,8 @@ public:
      * @param h The new validate_handler
      */
     void set_validate_handler(validate_handler h) {
-        m_validate_handler = h;
+        ensure_unique_handlers();
+        m_handlers->validate = h;
     }
     
     /// Set message handler
@@ -430,7 +732,315 @@ public:
      * @param h The new message_handler
      */
     void set_message_handler(message_handler h) {
-        m_message_handler = h;
+        ensure_unique_handlers();
+        m_handlers->message = h;
+    }
+
+    /// Set a handler for text messages only
+    /**
+     * Takes precedence over the generic message handler for TEXT
+     * frames, removing the application's opcode switch from the hot
+     * path. Control and unrouted messages still use the generic
+     * handler.
+     */
+    void set_text_message_handler(message_handler h) {
+        ensure_unique_handlers();
+        m_handlers->text_message = h;
+    }
+
+    /// Set a handler for binary messages only
+    /**
+     * @see set_text_message_handler
+     */
+    void set_binary_message_handler(message_handler h) {
+        ensure_unique_handlers();
+        m_handlers->binary_message = h;
+    }
+
+    /// Route binary messages by their first payload byte
+    /**
+     * A lightweight demux evaluated in the read loop before any generic
+     * dispatch: a non-empty binary message whose first byte has a route
+     * goes straight to that handler -- one array index, no payload
+     * copy, no application-level demux layer. First bytes without a
+     * route fall back to the binary handler, then the generic one.
+     * Pass an empty handler to remove a route.
+     *
+     * @param tag The first payload byte to match
+     * @param h The handler for messages tagged with that byte
+     */
+    void set_binary_route(uint8_t tag, message_handler h) {
+        ensure_unique_handlers();
+        if (m_handlers->binary_routes.empty()) {
+            m_handlers->binary_routes.resize(256);
+        }
+        m_handlers->binary_routes[tag] = h;
+    }
+
+    /// Set a batched message handler
+    /**
+     * When set (taking precedence over the single message handler), data
+     * messages completed within one transport read are collected and
+     * delivered in a single call as a span of message pointers, so a read
+     * carrying dozens of small frames pays the handler entry cost --
+     * typically a lock into the application -- once. Control frames are
+     * processed inline as usual, so their handlers may run between the
+     * frames of a batch. Borrowed payload views remain valid for the
+     * duration of the call, exactly as with per message delivery.
+     *
+     * @param h The new batch_message_handler
+     */
+    void set_batch_message_handler(batch_message_handler h) {
+        ensure_unique_handlers();
+        m_handlers->batch_message = h;
+    }
+
+    /// Set streaming message chunk handler
+    /**
+     * When set, complete data messages are no longer buffered or delivered
+     * to the message handler; instead payload spans stream through this
+     * handler as they clear the protocol processor, capping per connection
+     * memory at the read buffer size regardless of message size. Control
+     * frames and the rest of the connection life cycle are unaffected.
+     * Must be set before the handshake completes (e.g. at connection
+     * creation or from the validate handler).
+     *
+     * @param h The new message_chunk_handler
+     */
+    /// Stop arming transport reads for this connection
+    /**
+     * Takes effect at the next read re-arm decision on the transport
+     * thread; a read already in flight completes and is processed. While
+     * paused, inbound bytes accumulate in the kernel socket buffer and TCP
+     * flow control pushes back on the peer, bounding per connection memory
+     * to the receive window instead of the heap.
+     */
+    void pause_reading() {
+        m_read_paused = true;
+    }
+
+    /// Re-arm transport reads after pause_reading
+    /**
+     * Safe to call from any thread; the read is re-armed from the
+     * transport's event loop.
+     */
+    void resume_reading() {
+        m_read_paused = false;
+        transport_con_type::dispatch(lib::bind(
+            &connection::resume_reading_internal,
+            connection::shared_from_this()
+        ));
+    }
+
+    /// Automatically pause reads while the send queue is over the high
+    /// watermark
+    /**
+     * For relay/echo shaped workloads a producer faster than the consumer
+     * inflates the outgoing queue; with this mode enabled (and watermarks
+     * configured, see set_send_watermarks) crossing the high mark pauses
+     * reading and draining to the low mark resumes it, so backpressure
+     * propagates to the remote sender through TCP.
+     */
+    void set_auto_read_pause(bool value) {
+        m_auto_read_pause = value;
+    }
+
+    /// What to do with data sends while the queue is over the high watermark
+    struct slow_consumer_policy {
+        enum value {
+            /// Keep queueing (watermark handlers still fire). The default.
+            none = 0,
+            /// Refuse the send with error::send_queue_full, bounding the
+            /// queue without touching already accepted messages
+            /// (drop-newest)
+            reject,
+            /// Close the connection (policy_violation status)
+            close,
+            /// Discard queued data messages, oldest first, until the queue
+            /// is back under the high watermark, then accept the send.
+            /// Control frames are never dropped. Falls back to reject on
+            /// the lock free queue, whose consumer end cannot safely be
+            /// popped from a sending thread.
+            drop_oldest
+        };
+    };
+
+    /// Configure send queue watermarks
+    /**
+     * When the queued payload bytes rise past high the send_queue_full
+     * handler fires (once, on the sending thread); when they fall back to
+     * low or below, send_queue_drain fires (on the transport thread). A
+     * high of zero disables watermark processing. The slow consumer policy
+     * additionally bounds the queue: see slow_consumer_policy. Control
+     * frames (ping/pong/close) are never refused or dropped.
+     *
+     * @param high High watermark in payload bytes
+     * @param low Low watermark in payload bytes
+     */
+    void set_send_watermarks(size_t high, size_t low) {
+        m_send_high_watermark = high;
+        m_send_low_watermark = (low > high ? high : low);
+    }
+
+    /// Set the policy for data sends over the high watermark
+    void set_slow_consumer_policy(typename slow_consumer_policy::value p) {
+        m_slow_consumer_policy = p;
+    }
+
+    /// Set the handler fired when the send queue crosses the high watermark
+    void set_send_queue_full_handler(open_handler h) {
+        ensure_unique_handlers();
+        m_handlers->send_queue_full = h;
+    }
+
+    /// Set the handler fired when the send queue drains below the low
+    /// watermark
+    void set_send_queue_drain_handler(open_handler h) {
+        ensure_unique_handlers();
+        m_handlers->send_queue_drain = h;
+    }
+
+    /// Enable two-phase reads directly into message payload storage
+    /**
+     * When enabled, once a frame header has been parsed the remaining
+     * payload bytes of suitable frames (uncompressed data frames without a
+     * streaming sink) are read directly into the message buffer's own
+     * storage, leaving unmasking as the only touch of each byte. Reads
+     * never span past the current frame in this mode, so workloads of tiny
+     * messages may see more reads; it pays off from a few KB per message.
+     */
+    void set_direct_payload_reads(bool value) {
+        m_direct_payload_reads = value;
+    }
+
+    /// Restore this connection to a freshly constructed state for reuse
+    /**
+     * Called by the endpoint's connection pool after the previous session
+     * has fully terminated (no transport operations in flight, no external
+     * references). Everything the constructor establishes is restored; the
+     * message manager and read buffer storage are retained so their
+     * warmed-up state carries across sessions. The endpoint re-runs
+     * transport init and handler assignment afterwards, exactly as for a
+     * new connection.
+     */
+    /// Share an instrumentation object (endpoint wide totals)
+    /**
+     * Called by the endpoint at connection creation. With the none policy
+     * the hooks are empty inlines and this costs one pointer.
+     */
+    void set_stats(stats_ptr stats) {
+        if (stats) {
+            m_stats = stats;
+        }
+    }
+
+    /// Reference a shared handler table (endpoint defaults)
+    /**
+     * Replaces all session handlers at once with a shared reference;
+     * subsequent per connection setters copy-on-write. Called by the
+     * endpoint at connection creation.
+     */
+    void set_handler_table(typename handler_table::ptr table) {
+        if (table) {
+            m_handlers = table;
+        } else {
+            m_handlers.reset(new handler_table());
+        }
+    }
+
+    void reset_for_reuse() {
+        transport_con_type::reset_for_reuse();
+
+        m_state = session::state::connecting;
+        m_internal_state = session::internal_state::USER_INIT;
+
+        m_send_queue.clear();
+        m_send_buffer.clear();
+        m_current_msgs.clear();
+        m_handshake_buffer.clear();
+
+        m_buf_cursor = 0;
+        m_full_reads = 0;
+        // release the read buffer entirely while pooled; start() will
+        // materialize a fresh one
+        read_buffer_type empty(m_buf.get_allocator());
+        m_buf.swap(empty);
+
+        m_handshake_timer.reset();
+        m_ping_timer.reset();
+        m_processor.reset();
+
+        m_chunk_first = true;
+        m_direct_payload_reads = false;
+        m_send_queue_over = false;
+        m_stream_active = false;
+        m_stream_source = stream_source();
+        m_message_batch.clear();
+        m_self.reset();
+        m_terminating = false;
+        m_prescreened = false;
+        m_raw_read_continuation = transport::read_handler();
+        m_raw_write_continuation = lib::function<void()>();
+        release_handshake_gauge();
+        m_handshake_gauge.reset();
+        m_keepalive = keepalive_state();
+        m_rtt = rtt_stats();
+        m_integrity = integrity_stats();
+        m_swept_pong_timeouts = false;
+        m_mailbox_enabled = false;
+        clear_mailbox();
+        m_http_requests_served = 0;
+        m_http_keepalive_this = false;
+        m_pong_count.store(0,lib::memory_order_relaxed);
+        m_read_paused = false;
+        m_read_withheld = false;
+        m_auto_read_pause = false;
+        // drop any per connection handler overrides; the endpoint installs
+        // its current shared table before reuse
+        m_handlers.reset(new handler_table());
+
+        {
+            scoped_lock_type lock(m_compress_pipeline_lock);
+            while (!m_compress_pending.empty()) {
+                m_compress_pending.pop();
+            }
+            m_compress_active = false;
+        }
+
+        m_request = request_type();
+        m_request.set_arena_parse(true);
+        m_request.set_max_header_size(m_max_header_bytes);
+        m_request.set_max_header_line_size(m_max_header_line_bytes);
+        m_response = response_type();
+        m_uri.reset();
+        m_subprotocol.clear();
+        m_requested_subprotocols.clear();
+        m_subprotocol_index = static_cast<size_t>(-1);
+
+        m_local_close_code = close::status::abnormal_close;
+        m_local_close_reason.clear();
+        m_close_reason_deferred = false;
+        m_remote_close_code = close::status::abnormal_close;
+        m_remote_close_reason.clear();
+        m_ec = lib::error_code();
+        m_was_clean = false;
+        m_closed_by_me = false;
+        m_failed_by_me = false;
+        m_dropped_by_me = false;
+    }
+
+
+    void set_message_chunk_handler(message_chunk_handler h) {
+        ensure_unique_handlers();
+        m_handlers->message_chunk = h;
+        if (m_processor) {
+            // the processor already exists (e.g. set from the validate
+            // handler); install the streaming sink now
+            m_processor->set_payload_sink(lib::bind(
+                &connection::handle_message_chunk,this,
+                lib::placeholders::_1,lib::placeholders::_2,
+                lib::placeholders::_3));
+        }
     }
     
     //////////////////////////////////
@@ -450,6 +1060,827 @@ public:
      */
     size_t get_buffered_amount() const;
 
+    /// Set the maximum size the adaptive read buffer may grow to
+    /**
+     * The read buffer starts at connection_read_buffer_size (the adaptive
+     * minimum) and doubles while reads keep saturating it, up to this
+     * limit; it shrinks back toward the minimum when reads run small. Set
+     * to the minimum to disable growth. Endpoints apply their own default
+     * to new connections (see endpoint::set_max_read_buffer_size).
+     *
+     * @param size Maximum read buffer size in bytes
+     */
+    void set_max_read_buffer_size(size_t size) {
+        if (size < config::connection_read_buffer_size) {
+            size = config::connection_read_buffer_size;
+        }
+        m_max_read_buffer_size = size;
+    }
+
+    /// Bound the work one read-loop invocation may do before yielding
+    /**
+     * A connection receiving a dense burst of tiny frames can otherwise
+     * monopolize its io thread inside the consume/dispatch loop,
+     * starving sibling connections on the same thread. When either
+     * budget is exceeded mid buffer, the remaining input is shifted to
+     * the buffer front and the loop is re-posted through the io_service,
+     * letting other handlers run first. Zero (the default) disables the
+     * corresponding bound.
+     *
+     * @param max_frames Maximum consume iterations per invocation
+     * @param max_us Maximum microseconds per invocation
+     */
+    void set_read_loop_budget(size_t max_frames, uint64_t max_us) {
+        m_read_budget_frames = max_frames;
+        m_read_budget_us = max_us;
+    }
+
+    /// Enforce inbound rate limits on this connection
+    /**
+     * Token buckets checked inside the read loop, before payload
+     * processing: bytes are charged as they arrive from the transport
+     * and messages as they complete. Bucket state is io-thread owned,
+     * so steady state enforcement costs two arithmetic checks -- no
+     * lock, no extra clock read beyond the refill's. Burst capacity is
+     * one second's worth of each rate. Zero disables a bucket.
+     *
+     * Over-limit behavior is selectable: rate_limit::delay pauses
+     * transport reads until the bucket refills (kernel buffers then
+     * apply TCP backpressure to the peer), rate_limit::drop discards
+     * over-limit complete data messages, and rate_limit::close closes
+     * with policy_violation.
+     *
+     * @param msgs_per_sec Message budget per second (0 = unlimited)
+     * @param bytes_per_sec Byte budget per second (0 = unlimited)
+     * @param policy What to do when a bucket runs dry
+     */
+    void set_rate_limit(double msgs_per_sec, double bytes_per_sec,
+        rate_limit::policy policy)
+    {
+        m_rl_msg_rate = msgs_per_sec;
+        m_rl_byte_rate = bytes_per_sec;
+        m_rl_policy = policy;
+        m_rl_msg_tokens = msgs_per_sec;
+        m_rl_byte_tokens = bytes_per_sec;
+        m_rl_last_us = lib::steady_us();
+        m_rl_enabled = (msgs_per_sec > 0 || bytes_per_sec > 0);
+    }
+
+    /// Attach endpoint-wide aggregate buckets (see endpoint setter)
+    /**
+     * Over-limit on an aggregate bucket applies the same policy as the
+     * per connection buckets.
+     */
+    void set_aggregate_buckets(rate_limit::striped_bucket::ptr msgs,
+        rate_limit::striped_bucket::ptr bytes)
+    {
+        m_rl_agg_msgs = msgs;
+        m_rl_agg_bytes = bytes;
+        m_rl_agg_key = reinterpret_cast<size_t>(this)/64;
+        m_rl_enabled = m_rl_enabled || msgs || bytes;
+    }
+
+    /// Offload data message handlers to a worker pool
+    /**
+     * For handlers that block (a database hit) and would otherwise
+     * freeze the connection's io thread: completed data messages are
+     * queued and a pool task runs the message handler one message at a
+     * time per connection -- the serial executor that preserves today's
+     * per-connection ordering while unrelated connections' handlers run
+     * in parallel across the pool. When the per-connection backlog of
+     * offloaded messages passes max_outstanding, transport reads pause
+     * automatically (TCP backpressure) and resume as the pool drains
+     * below half the cap. Control frames (ping/pong/close) keep their
+     * io-thread processing; the batch and chunk delivery modes are not
+     * offloaded.
+     *
+     * @param pool The shared worker pool (empty to disable)
+     * @param max_outstanding Backlog cap that pauses reads (default 64)
+     */
+    void set_handler_pool(concurrency::worker_pool::ptr pool,
+        size_t max_outstanding = 64)
+    {
+        m_handler_pool = pool;
+        m_offload_cap = (max_outstanding < 1 ? 1 : max_outstanding);
+    }
+
+    /// Route cross-thread sends through an MPSC mailbox
+    /**
+     * For fanout threads issuing sends at high rate: with the mailbox
+     * enabled, send(message_ptr) from any thread enqueues onto a lock
+     * free MPSC stack and only the first enqueue after idle posts a
+     * wakeup to the io thread, which drains the whole mailbox in one
+     * pass -- frame preparation, queueing, and the single write
+     * dispatch all run on the io thread. N producer posts collapse
+     * into one reactor dispatch per busy period, and the write lock
+     * leaves the producer path entirely. Costs one small node
+     * allocation per message and moves preparation latency onto the io
+     * thread; leave it off for low-rate senders.
+     */
+    void set_send_mailbox(bool value) {
+        m_mailbox_enabled = value;
+    }
+
+    /// Flag this connection as accessed from threads beyond its own
+    /**
+     * Under the concurrency::dynamic policy every connection starts
+     * with its mutexes elided (lock free, `none` semantics). Call this
+     * before the connection's handle is shared with any other thread --
+     * typically from the open or accept handler -- to upgrade its
+     * mutexes permanently to real locking. Safe but redundant under the
+     * `basic` policy (always locked) and a documented no-op under
+     * `none`.
+     */
+    void set_cross_thread() {
+        concurrency_type::upgrade(m_connection_state_lock);
+        concurrency_type::upgrade(m_write_lock);
+        concurrency_type::upgrade(m_compress_pipeline_lock);
+        m_send_queue.upgrade();
+    }
+
+    /// Bookkeeping for the endpoint's keepalive service
+    /**
+     * Written only by the endpoint's keepalive sweep (transport timer
+     * context); the pong counter is incremented on the connection's read
+     * path and read by the sweep, hence atomic.
+     */
+    struct keepalive_state {
+        keepalive_state()
+          : last_ping_tick(0), pong_count_at_ping(0), awaiting_pong(false),
+            awaiting_user_pong(false), pong_count_at_user_ping(0),
+            user_pong_deadline_ms(0), reads_seen(0), idle_ticks(0),
+            compaction_pending(false) {}
+
+        size_t last_ping_tick;
+        size_t pong_count_at_ping;
+        bool awaiting_pong;
+        /// Application ping awaiting its pong, serviced by the sweep
+        /// instead of a per-ping timer (see set_swept_pong_timeouts)
+        bool awaiting_user_pong;
+        size_t pong_count_at_user_ping;
+        uint64_t user_pong_deadline_ms;
+        std::string user_ping_payload;
+        /// Idle compaction bookkeeping (endpoint sweep context)
+        size_t reads_seen;
+        size_t idle_ticks;
+        bool compaction_pending;
+    };
+
+    /// Access the endpoint keepalive service's per connection state
+    keepalive_state & get_keepalive_state() {
+        return m_keepalive;
+    }
+
+    /// Type of the shared handshake-in-progress counter
+    typedef lib::shared_ptr<lib::atomic<size_t> > handshake_gauge_ptr;
+
+    /// Count this connection against the endpoint's handshake gauge
+    /**
+     * Installed by the server role at accept; released (exactly once)
+     * when the handshake concludes -- upgrade served, HTTP response
+     * finished, or the connection terminated -- so the gauge tracks
+     * handshakes actually in progress. Together with the handshake
+     * header caps and arena parsing this turns handshake-stage memory
+     * into a fixed budget: max handshakes times the per-handshake cap.
+     */
+    void set_handshake_gauge(handshake_gauge_ptr gauge) {
+        m_handshake_gauge = gauge;
+        m_handshake_gauge_held = true;
+        gauge->fetch_add(1,lib::memory_order_relaxed);
+    }
+
+    /// Materialize lazily built per-connection state ahead of use
+    /**
+     * Warm-start support (endpoint::reserve): builds the message
+     * manager and cycles `messages` message objects through it so its
+     * freelist and control block caches are populated, and sizes the
+     * read buffer, so a connection drawn from the pool during a
+     * reconnect storm takes no allocator hits on its first frames.
+     */
+    void prewarm(size_t messages) {
+        con_msg_manager_ptr const & manager = msg_manager();
+        if (messages > 0) {
+            std::vector<message_ptr> held;
+            held.reserve(messages);
+            for (size_t i = 0; i < messages; i++) {
+                held.push_back(manager->get_message(
+                    frame::opcode::binary,0));
+            }
+            // releasing fills the manager's recycling caches
+        }
+        if (m_buf.size() < config::connection_read_buffer_size) {
+            m_buf.resize(config::connection_read_buffer_size);
+        }
+    }
+
+    /// The endpoint-issued fast handle for this connection
+    /**
+     * Assigned at registration; see endpoint::get_fast_handle.
+     */
+    fast_connection_hdl get_fast_handle() const {
+        return m_fast_handle;
+    }
+
+    /// Record the endpoint-issued fast handle (endpoint internal)
+    void set_fast_handle(fast_connection_hdl hdl) {
+        m_fast_handle = hdl;
+    }
+
+    /// This connection's message pool snapshot
+    /**
+     * Occupancy, hit/miss, recycle/drop counts of the per connection
+     * message manager; see message_buffer::pool_metrics. An empty
+     * snapshot when the manager has not materialized yet.
+     */
+    message_buffer::pool_metrics get_pool_metrics() const {
+        if (!m_msg_manager_ready.load(lib::memory_order_acquire)) {
+            return message_buffer::pool_metrics();
+        }
+        return m_msg_manager->get_pool_metrics();
+    }
+
+    /// Write a canned response straight to the transport, then terminate
+    /**
+     * The emergency load-shedding path: called by the server role on a
+     * freshly accepted connection instead of start(), it writes the
+     * endpoint's pre-serialized 503 bytes to the raw transport and
+     * tears down -- no handshake machinery runs, nothing is read or
+     * parsed, and with pooling the object recycles immediately. The
+     * response must outlive the write; the endpoint's static buffer
+     * does.
+     *
+     * @param response Pre-serialized bytes to write before closing
+     */
+    void shed(std::string const & response);
+
+    /// Request memory compaction at the next safe point
+    /**
+     * Thread safe (called by the endpoint's idle sweep). The shrink
+     * itself runs on the io thread between a read completion and the
+     * next re-arm -- the only point where no outstanding read
+     * references the buffer -- so on a fully idle connection it takes
+     * effect when the next keepalive pong (or any other inbound byte)
+     * completes a read. Shrinks the adaptive read buffer back to the
+     * configured minimum and releases grown scratch capacity (gather
+     * list, in-flight message list, batch list, handshake buffer).
+     */
+    void request_compaction() {
+        m_compact_requested.store(true,lib::memory_order_relaxed);
+    }
+
+    /// Transport reads observed over this connection's lifetime
+    /**
+     * Plain io-thread counter for the idle sweep's activity detection;
+     * reads from other threads see a possibly stale value, which is all
+     * idleness detection needs.
+     */
+    size_t get_read_count() const {
+        return m_reads_observed;
+    }
+
+    /// Route application ping timeouts through the keepalive sweep
+    /**
+     * Set by the endpoint when its keepalive sweep runs: ping() then
+     * records a pong deadline in the keepalive state instead of
+     * creating a timer per ping, and the sweep's wheel tick fires
+     * expired pong timeouts for the whole due cohort in one pass. Per
+     * connection pong timers -- the largest single source of timer
+     * objects under load -- disappear entirely.
+     */
+    void set_swept_pong_timeouts(bool value) {
+        m_swept_pong_timeouts = value;
+    }
+
+    /// Number of pong frames received over this connection's lifetime
+    size_t get_pong_count() const {
+        return m_pong_count.load(lib::memory_order_relaxed);
+    }
+
+    /// Frame integrity counters; see config::core::integrity_checks
+    /**
+     * io-thread owned, like the RTT statistics. running_* fold every
+     * checked payload into one CRC32C stream, so two endpoints of an
+     * unmasked direction can compare a single value per connection.
+     */
+    struct integrity_stats {
+        integrity_stats()
+          : frames_in(0), frames_out(0), bytes_in(0), bytes_out(0),
+            running_in(0), running_out(0) {}
+
+        uint64_t frames_in;
+        uint64_t frames_out;
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        uint32_t running_in;
+        uint32_t running_out;
+    };
+
+    /// The connection's integrity counters (all zero unless the config
+    /// enables integrity_checks)
+    integrity_stats const & get_integrity_stats() const {
+        return m_integrity;
+    }
+
+    /// Round trip time statistics from stamped pings
+    /**
+     * Updated on the connection's read path when a pong echoing a
+     * stamped ping arrives (see ping_rtt); all fields are io-thread
+     * owned, so reading them from a handler of this connection requires
+     * no lock. samples is zero until the first stamped pong.
+     */
+    struct rtt_stats {
+        rtt_stats()
+          : samples(0), last_us(0), min_us(0), max_us(0), ewma_us(0) {}
+
+        uint64_t samples;
+        uint64_t last_us;
+        uint64_t min_us;
+        uint64_t max_us;
+        /// Exponentially weighted moving average (alpha 1/8, TCP style)
+        double ewma_us;
+    };
+
+    /// The connection's RTT statistics (io-thread owned, lock free)
+    rtt_stats const & get_rtt_stats() const {
+        return m_rtt;
+    }
+
+    /// Send a ping stamped with a monotonic timestamp token
+    /**
+     * The peer's pong echoes the token back; the read path recognizes
+     * it and folds the measured round trip into get_rtt_stats without
+     * any map lookup or lock. The endpoint keepalive sweep sends its
+     * pings through this, so enabling keepalive yields RTT tracking for
+     * free; applications routing around degraded peers may also call it
+     * directly.
+     *
+     * @param [out] ec A status code describing any error that occurred
+     */
+    void ping_rtt(lib::error_code & ec);
+
+    /// Signature of the handshake pre-screen filter
+    /**
+     * Invoked on the first bytes read from a new server connection,
+     * before any HTTP parsing or response machinery runs. Return false
+     * to shed the connection immediately: no request object is
+     * populated, no response is serialized or sent (port scanners do not
+     * merit one), and with pooling enabled the connection object is
+     * recycled straight away.
+     */
+    typedef lib::function<bool(char const *,size_t)> prescreen_handler;
+
+    /// Install a handshake pre-screen filter
+    void set_prescreen_handler(prescreen_handler h) {
+        m_prescreen = h;
+    }
+
+    /// Cache of pre-serialized 101 response templates
+    /**
+     * Shared by every connection of a server endpoint. Most accepted
+     * handshakes produce byte identical responses apart from the
+     * Sec-WebSocket-Accept value, so the invariant bytes are serialized
+     * once per distinct negotiation outcome (extensions line,
+     * subprotocol, server header) and later handshakes patch in only the
+     * accept key. Bounded; cleared wholesale when full.
+     */
+    struct handshake_template_cache {
+        typedef lib::shared_ptr<handshake_template_cache> ptr;
+
+        struct entry {
+            std::string prefix;
+            std::string suffix;
+        };
+
+        static size_t const max_entries = 16;
+
+        lib::mutex lock;
+        std::map<std::string,entry> entries;
+    };
+
+    /// Share a handshake response template cache with this connection
+    void set_handshake_template_cache(
+        typename handshake_template_cache::ptr cache)
+    {
+        m_handshake_templates = cache;
+    }
+
+    /// Cache of pre-serialized client upgrade request templates
+    /**
+     * Client-side mirror of the response template cache: for each target
+     * (URI plus requested subprotocols) the invariant header block is
+     * serialized once and split around the Sec-WebSocket-Key value, so a
+     * reconnect assembles prefix + fresh key + suffix, skipping both the
+     * header population and serialization passes. Safe because this
+     * connection API exposes no client request mutation: the library
+     * alone determines the request from the URI, user agent, and
+     * subprotocol list, all of which are in the cache key or invariant
+     * per endpoint. On a template hit m_request carries only the
+     * Sec-WebSocket-Key (the single field response validation reads);
+     * introspecting the full outgoing request is a cache-miss-only
+     * affordance.
+     */
+    struct client_template_cache {
+        typedef lib::shared_ptr<client_template_cache> ptr;
+
+        struct entry {
+            std::string prefix;
+            std::string suffix;
+        };
+
+        static size_t const max_entries = 16;
+
+        lib::mutex lock;
+        std::map<std::string,entry> entries;
+    };
+
+    /// Share a client request template cache with this connection
+    void set_client_template_cache(
+        typename client_template_cache::ptr cache)
+    {
+        m_client_templates = cache;
+    }
+
+    /// Feed inbound bytes directly from a caller owned buffer
+    /**
+     * Zero copy ingest for embedders that own byte delivery (the iostream
+     * transport): once the connection is open, frames are parsed in place
+     * in buf -- masked payloads are unmasked there, so the buffer is
+     * mutated -- and with borrowed messages enabled the handler's payload
+     * views point straight into it. Handshake-phase bytes are routed
+     * through the transport's buffered readsome, the only phase that
+     * still copies. Returns how many bytes were consumed; a short count
+     * means the connection cannot take more right now (no pending
+     * handshake read, reads paused, or the connection closed) and the
+     * caller should retry the tail later.
+     *
+     * Requires a transport with a readsome input method (iostream).
+     * Serialize calls with any other input method (operator>>, readsome);
+     * like those, this must be driven from one thread at a time.
+     *
+     * @param buf Bytes to parse; mutated in place for masked frames
+     * @param len Number of valid bytes at buf
+     * @param ec Status code for protocol failures
+     * @return Bytes consumed
+     */
+    size_t read_external(char * buf, size_t len, lib::error_code & ec);
+
+    /// Serve multiple HTTP requests per connection (keep-alive)
+    /**
+     * By default the plain HTTP fallback (set_http_handler) serves one
+     * request and closes, so periodic health checks pay connection setup
+     * per probe. With keep-alive enabled the connection honors HTTP
+     * persistence (HTTP/1.1 unless the request says Connection: close,
+     * HTTP/1.0 only with Connection: keep-alive) and loops the request
+     * parser on the same connection, up to max_requests requests with at
+     * most idle_timeout_ms between them. A WebSocket upgrade arriving on
+     * a kept-alive connection proceeds normally.
+     *
+     * @param max_requests Requests served per connection; 0 disables
+     * keep-alive (the default single-request behavior)
+     * @param idle_timeout_ms How long to wait for the next request
+     */
+    void set_http_keepalive(size_t max_requests, long idle_timeout_ms) {
+        m_http_keepalive_requests = max_requests;
+        m_http_keepalive_idle_ms = idle_timeout_ms;
+    }
+
+    /// Endpoint wide cache of prepared close frames
+    /**
+     * Server close frames with an empty reason are identical per (code,
+     * terminal) pair -- unmasked, deterministic framing -- so they are
+     * prepared once and enqueued by reference thereafter, like broadcast
+     * prepared messages. Client frames are masked per send and never
+     * cached.
+     */
+    struct close_frame_cache {
+        typedef lib::shared_ptr<close_frame_cache> ptr;
+
+        lib::mutex lock;
+        std::map<uint32_t,message_ptr> frames;
+    };
+
+    /// Share the endpoint's close frame cache with this connection
+    void set_close_frame_cache(typename close_frame_cache::ptr cache) {
+        m_close_frames = cache;
+    }
+
+    /// Shared priority-ordered server subprotocol table
+    typedef lib::shared_ptr<std::vector<std::string> const>
+        subprotocol_table_ptr;
+
+    /// Install the endpoint's registered subprotocol table
+    void set_subprotocol_table(subprotocol_table_ptr table) {
+        m_subprotocol_table = table;
+    }
+
+    /// Index into the registered subprotocol table of the selection
+    /**
+     * Only meaningful when the endpoint registered subprotocols
+     * (endpoint::register_subprotocols) and a match was auto-selected:
+     * the position of the chosen entry in the registered (priority)
+     * order, cheap to switch on. Returns npos when nothing was selected
+     * or selection happened via select_subprotocol.
+     */
+    size_t get_subprotocol_index() const {
+        return m_subprotocol_index;
+    }
+
+    /// Bind steady-state continuations to a raw pointer
+    /**
+     * By default every async continuation binds shared_from_this, costing
+     * two atomic reference count operations per read or write; at
+     * millions of ops per second the control block's cacheline traffic is
+     * measurable. In raw mode the connection pins itself with one
+     * terminal self reference taken at start() and the hot io-thread
+     * continuations (the read re-arm and the write chain) are pre-built
+     * once around a raw pointer -- no per-op reference counting and no
+     * per-op bind allocation. The anchor is released from the io thread
+     * at the end of termination, after the transport shutdown completes,
+     * so canceled completions queued earlier still find the object alive.
+     * Cross-thread dispatches (send() from other threads, timers, the
+     * handshake) keep shared_ptr binding, preserving shared_ptr semantics
+     * at the API boundary.
+     *
+     * Must be set before start(). Off by default.
+     */
+    void set_raw_continuations(bool value) {
+        m_raw_continuations = value;
+    }
+
+    /// Cap the buffered handshake header bytes for this connection
+    /**
+     * Enforced as bytes arrive (see http::parser::set_max_header_size);
+     * crossing the cap rejects the handshake immediately instead of
+     * holding memory until the handshake timeout. The optional per line
+     * cap tightens the bound for single lines that never end.
+     *
+     * @param total_bytes Total buffered header cap
+     * @param line_bytes Per line cap; 0 leaves only the total
+     */
+    void set_max_http_header_size(size_t total_bytes,
+        size_t line_bytes = 0)
+    {
+        m_max_header_bytes = total_bytes;
+        m_max_header_line_bytes = line_bytes;
+        m_request.set_max_header_size(total_bytes);
+        m_request.set_max_header_line_size(line_bytes);
+    }
+
+    /// Default time-to-live applied to queued data messages
+    /**
+     * When nonzero, every unprepared data message sent without its own
+     * TTL (message::set_ttl) gets this one: if it is still queued when
+     * the TTL elapses it is discarded at dequeue and counted
+     * (messages_expired) instead of written. Bounds end-to-end staleness
+     * on slow consumers without app level queue mirroring. Control
+     * frames and prepared broadcast messages are never expired.
+     *
+     * @param ttl_ms Milliseconds a queued message stays sendable; 0
+     * (default) disables
+     */
+    void set_default_message_ttl(long ttl_ms) {
+        m_default_ttl_ms = ttl_ms;
+    }
+
+    /// Prime permessage-deflate with a shared dictionary
+    /**
+     * Both peers of a closed system prime identical out-of-band agreed
+     * dictionaries for markedly better small-message compression; see
+     * permessage_deflate::enabled::set_dictionary. Effective when set
+     * before the first compressed message (the codec initializes
+     * lazily); forwarded to the processor like the other knobs, with the
+     * connection-level call overriding any endpoint default.
+     */
+    void set_compression_dictionary(std::string const & dict) {
+        m_compression_dictionary = dict;
+        if (m_processor) {
+            m_processor->set_compression_dictionary(dict);
+        }
+    }
+
+    /// Bound write-side compression history under context takeover
+    /**
+     * See permessage_deflate::enabled::set_write_reset_interval: the
+     * deflate stream is reset every `messages` messages or `bytes`
+     * input bytes, keeping most of context takeover's ratio win while
+     * bounding the referenced history. Forwarded to the processor like
+     * the dictionary knob; zero/zero (default) never resets.
+     */
+    void set_compression_write_reset(size_t messages, size_t bytes) {
+        m_compress_reset_msgs = messages;
+        m_compress_reset_bytes = bytes;
+        if (m_processor) {
+            m_processor->set_compression_write_reset(messages,bytes);
+        }
+    }
+
+    /// Attach an adaptive compression level controller
+    /**
+     * See permessage_deflate::level_controller; forwarded to the
+     * processor like the other compression knobs.
+     */
+    void set_compression_level_controller(
+        extensions::permessage_deflate::level_controller::ptr controller)
+    {
+        m_level_controller = controller;
+        if (m_processor) {
+            m_processor->set_compression_level_controller(controller);
+        }
+    }
+
+    /// Select how inbound text payloads are UTF-8 validated
+    /**
+     * See processor::validation_policy. strict is the default;
+     * trusted_skip also skips close reason validation. Must be set
+     * before the handshake to affect the processor; like the other
+     * processor knobs it is forwarded at processor creation.
+     */
+    void set_validation_policy(processor::validation_policy::value v) {
+        m_validation_policy = v;
+        if (m_processor) {
+            m_processor->set_validation_policy(v);
+        }
+    }
+
+    /// Deliver suitable inbound messages as zero copy borrowed views
+    /**
+     * When enabled, a complete data message whose payload arrived as one
+     * contiguous span of the read buffer is handed to the message handler
+     * with its payload as a view over that buffer instead of a copy
+     * (message::is_borrowed; read it with payload_data/payload_size). The
+     * view is valid until the handler returns: keep the message beyond
+     * that by calling message::retain(), which copies once. Handles kept
+     * without retain read as empty afterwards. get_payload() on a
+     * borrowed message materializes the copy implicitly, so string based
+     * code stays correct. Messages that span reads, fragmented messages,
+     * and compressed messages are delivered as ordinary copies.
+     *
+     * Must be set before the handshake; only the RFC 6455 processor
+     * supports borrowing.
+     */
+    void set_borrowed_messages(bool value) {
+        m_borrowed_messages = value;
+        if (m_processor) {
+            m_processor->set_borrowed_payloads(value);
+        }
+    }
+
+    /// Fragment outgoing messages larger than the given payload size
+    /**
+     * When nonzero, send() splits any unprepared data message whose payload
+     * exceeds the limit into a FIN terminated train of frames of at most
+     * this many payload bytes each. This bounds per frame prepare buffer
+     * memory and lets queued control frames (which use the send queue's
+     * priority lane) interleave between fragments instead of waiting out
+     * one enormous frame. Text messages are split at UTF-8 sequence
+     * boundaries. Fragmented messages are sent uncompressed; messages at or
+     * under the limit, prepared messages, and messages routed through a
+     * compression pool are emitted as single frames as before.
+     *
+     * Disabled (0) by default.
+     *
+     * @param size Maximum outgoing frame payload size in bytes, 0 for
+     * unlimited
+     */
+    void set_max_outgoing_frame_size(size_t size) {
+        m_max_outgoing_frame_size = size;
+    }
+
+    /// Source callback for send_stream()
+    /**
+     * Called serially from the transport's event loop each time the
+     * connection is ready for another fragment. The source writes up to
+     * len bytes into buf and returns the number written; setting fin ends
+     * the stream with the current chunk as the final fragment. Returning 0
+     * without setting fin also ends the stream.
+     */
+    typedef lib::function<size_t(char * buf, size_t len, bool & fin)>
+        stream_source;
+
+    /// Send one raw frame with explicit opcode and fin
+    /**
+     * Relay-grade primitive: frames the span exactly as given (use
+     * CONTINUATION with fin false/true for the middles and end of a
+     * fragmented message) with masking applied by the processor's SIMD
+     * kernels as usual and no message-level bookkeeping. The caller owns
+     * fragmentation correctness: do not interleave other data sends into
+     * an unfinished fragment sequence on this connection. Compression is
+     * not applied.
+     *
+     * @param op Frame opcode (TEXT/BINARY for a first frame, CONTINUATION
+     * for the rest)
+     * @param fin Whether this frame ends its message
+     * @param payload Frame payload bytes
+     * @param len Number of payload bytes
+     */
+    lib::error_code send_frame(frame::opcode::value op, bool fin,
+        char const * payload, size_t len);
+
+    /// Relay this connection's inbound data frames to another connection
+    /**
+     * After both handshakes complete, frames arriving here are forwarded
+     * to target frame by frame -- unmasked spans straight from the
+     * processor re-framed (and re-masked by the SIMD kernels) on the
+     * target, with no message assembly and no message handler dispatch
+     * on this side. Control frames keep their local RFC handling
+     * (ping/pong answered per hop) and close remains the application's
+     * to propagate via its close handler. Call on both connections for a
+     * bidirectional relay; the target should not receive unrelated data
+     * sends while a relayed fragmented message is in flight.
+     *
+     * @param target The connection to forward to
+     */
+    void splice_to(ptr target) {
+        // weak: a bidirectional splice would otherwise form a shared_ptr
+        // cycle through the two handler tables and leak both connections
+        set_message_chunk_handler(lib::bind(
+            &connection::relay_chunk,this,weak_ptr(target),
+            lib::placeholders::_1,lib::placeholders::_2,
+            lib::placeholders::_3,lib::placeholders::_4,
+            lib::placeholders::_5,lib::placeholders::_6));
+    }
+
+    /// Send a message whose payload is pulled from a source callback
+    /**
+     * Frames successive chunks from the source as a fragment train
+     * (op, then continuations, FIN on the last) without ever holding the
+     * full payload in memory: at most one chunk is queued ahead of the
+     * transport, and the next chunk is pulled only after the previous
+     * frame's write completes, so a slow peer applies backpressure
+     * directly to the source. Each fragment is masked independently by
+     * the processor as usual; streamed messages bypass permessage-deflate
+     * for the same reason fragmented sends do.
+     *
+     * While a stream is active other data sends on this connection return
+     * invalid_state, since interleaving another data message into the
+     * train would violate RFC 6455 framing; control frames are unaffected.
+     * For TEXT streams every chunk must end on a UTF-8 sequence boundary;
+     * the library cannot re-chunk what it never buffers.
+     *
+     * @param source Chunk source callback
+     * @param op Opcode for the first frame (TEXT or BINARY)
+     * @param chunk_size Number of bytes to request per pull
+     */
+    lib::error_code send_stream(stream_source source,
+        frame::opcode::value op, size_t chunk_size);
+
+    /// Stream a file region as one binary message (POSIX)
+    /**
+     * Builds on send_stream: the region [offset, offset+len) of the
+     * open file is framed as a fragment train with the library's usual
+     * backpressure -- one chunk in flight, the next mapped-in only
+     * after the previous frame's write completes -- so a multi-gigabyte
+     * replay never holds more than a chunk in memory. The region is
+     * mmap'd (page-alignment handled internally, MADV_SEQUENTIAL
+     * advised) and each fragment is copied once, straight from the page
+     * cache into the frame being built; when mmap is unavailable the
+     * source falls back to pread directly into the frame, still one
+     * copy. The caller keeps fd open until the message completes; the
+     * mapping itself is owned by the stream and released when the last
+     * fragment is written.
+     *
+     * A kTLS sendfile path is deliberately absent: WebSocket frame
+     * headers interleave the payload, so the kernel could only ship a
+     * fragment's body per sendfile call at the cost of a syscall pair
+     * per fragment; the mmap copy is cheaper at realistic chunk sizes.
+     *
+     * @param fd An open readable file descriptor
+     * @param offset Byte offset of the region to send
+     * @param len Length of the region in bytes
+     * @param chunk_size Fragment payload size (default 64KB)
+     */
+    lib::error_code send_file(int fd, uint64_t offset, uint64_t len,
+        size_t chunk_size = 65536);
+
+    /// Route outgoing message preparation through a worker pool
+    /**
+     * When a pool is set, send() queues unprepared messages on an internal
+    * pipeline and returns immediately; a pool thread runs the processor's
+     * frame preparation (including permessage-deflate compression) and the
+     * prepared frame is queued for writing from the transport's event loop.
+     * Per connection ordering is preserved by preparing one message at a
+     * time per connection; parallelism comes from many connections sharing
+     * the pool. Messages that are already prepared bypass the pipeline.
+     *
+     * Preparation errors can no longer be returned from send(); they are
+     * logged and the offending message is dropped. Note also that close()
+     * does not wait for the pipeline: messages still awaiting preparation
+     * when the connection is closed may be dropped. Applications should
+     * stop sending and allow the pipeline to drain (buffered_amount and
+     * quiescence of their own send calls) before closing if every message
+     * must be delivered.
+     *
+     * Pass an empty pointer to return to synchronous preparation.
+     */
+    void set_compression_pool(concurrency::worker_pool::ptr pool) {
+        m_compress_pool = pool;
+    }
+
+    /// Current size of the adaptive read buffer
+    size_t get_read_buffer_size() const {
+        return m_buf.size();
+    }
+
     /// DEPRECATED: use get_buffered_amount instead
     size_t buffered_amount() const {
         return get_buffered_amount();
@@ -473,6 +1904,47 @@ public:
      */
     lib::error_code send(std::string const & payload, frame::opcode::value op = 
         frame::opcode::TEXT);
+
+    /// Send the latest value for a key, conflating queued predecessors
+    /**
+     * Creates a message tagged with key and sends it; while an earlier
+     * message with the same key is still waiting in the send queue, the
+     * new payload replaces it in place (position and ordering kept)
+     * instead of lengthening the queue -- slow consumers receive only
+     * the latest value per key, the natural shape for market data style
+     * feeds. Keyed replacement is indexed, so deep queues with many keys
+     * pay one map lookup per send rather than a queue scan. Requires the
+     * mutex guarded send queue; the lock free queue enqueues normally.
+     *
+     * @param key Conflation key (e.g. an instrument symbol)
+     * @param payload The payload to send
+     * @param op The opcode; text by default
+     */
+    lib::error_code send_conflated(std::string const & key,
+        std::string const & payload,
+        frame::opcode::value op = frame::opcode::TEXT);
+
+    /// Create a message with explicit compression eligibility and send it
+    /**
+     * Like send(payload,op), but sets the message's compression flag: with
+     * compress false the frame is always sent uncompressed (RSV1 clear)
+     * even when permessage-deflate is negotiated -- useful for payloads
+     * the application knows are already compressed. With compress true the
+     * extension's heuristics still apply.
+     */
+    lib::error_code send(std::string const & payload, frame::opcode::value op,
+        bool compress);
+
+#ifdef _WEBSOCKETPP_RVALUE_REFERENCES_
+    /// Create a message from an rvalue payload and send it
+    /**
+     * Move overload of send(payload,op): the payload string is moved into
+     * the outgoing message rather than copied, so relaying a received
+     * buffer costs no payload copy on the send side.
+     */
+    lib::error_code send(std::string&& payload, frame::opcode::value op =
+        frame::opcode::TEXT);
+#endif
         
     /// Send a message (raw array overload)
     /**
@@ -506,6 +1978,179 @@ public:
      */
     lib::error_code send(message_ptr msg);
 
+protected:
+    /// Split an oversized unprepared message into a fragment train
+    /**
+     * Helper for send(); see set_max_outgoing_frame_size.
+     */
+    lib::error_code send_fragmented(message_ptr msg);
+
+    /// Pull and send the next chunk of an active send_stream
+    void stream_pull_next();
+
+    /// Deliver and clear any messages collected for batch delivery
+    void flush_message_batch();
+
+    /// Match the request's subprotocol offer against the registered table
+    void auto_select_subprotocol();
+
+    /// The connection's message manager, created on first use
+    /**
+     * Armed-but-unconnected and pooled-idle connections never touch
+     * messages, so the manager (and its caches) materializes lazily.
+     * First use may come from any thread (fast handle sends are not
+     * serialized with each other), so construction is double-checked
+     * through an atomic ready flag: the lock-free fast path reads the
+     * flag, never the shared_ptr a racing initializer may be writing.
+     * Once set the manager lives for the connection's lifetime
+     * (reset_for_reuse keeps it), so the flag never clears.
+     */
+    con_msg_manager_ptr const & msg_manager() const {
+        if (!m_msg_manager_ready.load(lib::memory_order_acquire)) {
+            scoped_lock_type guard(m_msg_manager_lock);
+            if (!m_msg_manager) {
+                m_msg_manager.reset(new con_msg_manager_type());
+            }
+            m_msg_manager_ready.store(true,lib::memory_order_release);
+        }
+        return m_msg_manager;
+    }
+
+    /// Shared immutable default handler table for fresh connections
+    static typename handler_table::ptr const & default_handler_table() {
+        static typename handler_table::ptr table(new handler_table());
+        return table;
+    }
+
+    /// Shared default stats sink for connections without an endpoint
+    static stats_ptr const & default_stats() {
+        static stats_ptr stats(new stats_type());
+        return stats;
+    }
+
+    /// Re-enter the read loop after a budget yield
+    void resume_read_frame(size_t bytes)
+        _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless);
+
+    /// Completion of a shed write; tears the connection down
+    void handle_shed_write(lib::error_code const & ec);
+
+    /// Queue a data message for the handler pool (io thread)
+    void offload_enqueue(message_ptr msg);
+
+    /// Pool task: run handlers one message at a time per connection
+    void run_offload_task();
+
+    /// One mailbox entry; linked through a Treiber stack
+    struct mailbox_node {
+        message_ptr msg;
+        mailbox_node * next;
+    };
+
+    /// Enqueue on the mailbox; posts the drain on idle-to-busy
+    lib::error_code send_via_mailbox(message_ptr msg);
+
+    /// The non-mailbox send body; io-thread step of the mailbox drain
+    lib::error_code do_direct_send(message_ptr msg);
+
+    /// Drain the whole mailbox on the io thread in one pass
+    void drain_mailbox();
+
+    /// Free any undrained mailbox entries (terminate / pooled reuse)
+    void clear_mailbox() {
+        mailbox_node * head = m_mailbox_head.exchange(0,
+            lib::memory_order_acquire);
+        while (head) {
+            mailbox_node * next = head->next;
+            delete head;
+            head = next;
+        }
+        m_mailbox_armed.store(false,lib::memory_order_relaxed);
+    }
+
+    /// Release the handshake gauge slot exactly once
+    void release_handshake_gauge() {
+        if (m_handshake_gauge_held) {
+            m_handshake_gauge_held = false;
+            if (m_handshake_gauge) {
+                m_handshake_gauge->fetch_sub(1,lib::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Refill the rate limiter's buckets from elapsed time
+    void rl_refill();
+
+    /// Resume reads once a delayed (rate limited) connection refills
+    void rl_resume(lib::error_code const & ec);
+
+    /// Small-object read continuation for raw-continuation mode
+    /**
+     * Eight bytes so copies into a lib::function stay within the small
+     * object optimization: re-arming a read allocates nothing. Lifetime
+     * is governed by the m_self anchor, exactly as the bound form was.
+     */
+    struct raw_read_functor {
+        type * con;
+        void operator()(lib::error_code const & ec, size_t bytes) const {
+            con->handle_read_frame(ec,bytes);
+        }
+    };
+    /// Small-object write continuation for raw-continuation mode
+    struct raw_write_functor {
+        type * con;
+        void operator()() const {
+            con->write_frame();
+        }
+    };
+    /// Small-object write-completion continuation (raw-continuation mode)
+    /**
+     * Sixteen bytes (pointer plus terminal flag), still within the
+     * small object optimization, so issuing a write allocates nothing.
+     */
+    struct raw_write_complete_functor {
+        type * con;
+        bool terminal;
+        void operator()(lib::error_code const & ec) const {
+            con->handle_write_frame(terminal,ec);
+        }
+    };
+
+    /// Drop the raw continuation anchor (posted from handle_terminate)
+    void release_self();
+
+    /// Chunk handler body installed by splice_to
+    void relay_chunk(weak_ptr target, connection_hdl,
+        frame::opcode::value op, char const * data, size_t len,
+        bool first, bool fin);
+public:
+
+    /// Prepare a message once for repeated sending
+    /**
+     * Runs the payload through this connection's protocol processor exactly
+     * once and returns the resulting prepared message. The returned message
+     * can be passed to send() on this or any other connection speaking the
+     * same protocol version; prepared messages are enqueued by pointer, so a
+     * broadcast of the same payload to many connections performs no per
+     * connection framing, validation, copying, or compression.
+     *
+     * The message is always prepared uncompressed: with context takeover a
+     * deflated body is only meaningful to the compression context it was
+     * produced in, so a shared compressed message would corrupt other
+     * connections' streams. Masked (client) connections should not share
+     * prepared messages, as the masking key would be reused.
+     *
+     * @param payload The payload to prepare
+     *
+     * @param op The opcode to prepare the message with
+     *
+     * @param ec A status code describing any error that occurred
+     *
+     * @return A prepared message_ptr, or an empty pointer on error
+     */
+    message_ptr prepare_message(std::string const & payload,
+        frame::opcode::value op, lib::error_code & ec);
+
     /// Asyncronously invoke handler::on_inturrupt
     /**
      * Signals to the connection to asyncronously invoke the on_inturrupt
@@ -905,6 +2550,12 @@ public:
      * @return The WebSocket close reason sent by this endpoint.
      */
     std::string const & get_local_close_reason() const {
+        if (m_close_reason_deferred) {
+            // built on first read; mass disconnects that nobody
+            // inspects never pay the error message construction
+            m_close_reason_deferred = false;
+            m_local_close_reason = m_ec.message();
+        }
         return m_local_close_reason;
     }
     
@@ -984,13 +2635,17 @@ public:
         size_t bytes_transferred);
     
     void handle_send_http_response(lib::error_code const & ec);
+
+    /// Reset parser state and await the next request (HTTP keep-alive)
+    void continue_http_keepalive();
     void handle_send_http_request(lib::error_code const & ec);
     
     void handle_open_handshake_timeout(lib::error_code const & ec);
     void handle_close_handshake_timeout(lib::error_code const & ec);
     
     void handle_read_frame(lib::error_code const & ec,
-        size_t bytes_transferred);
+        size_t bytes_transferred)
+        _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless);
     
     /// Get array of WebSocket protocol versions that this connection supports.
     const std::vector<int>& get_supported_versions() const;
@@ -1008,7 +2663,8 @@ public:
      *
      * This method locks the m_write_lock mutex
      */
-    void write_frame();
+    void write_frame()
+        _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless);
     
     /// Process the results of a frame write operation and start the next write
     /**
@@ -1022,7 +2678,8 @@ public:
      * @param ec A status code from the transport layer, zero on success, 
      * non-zero otherwise.
      */
-    void handle_write_frame(bool terminate, lib::error_code const & ec);
+    void handle_write_frame(bool terminate, lib::error_code const & ec)
+        _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless);
 protected:
     void handle_transport_init(lib::error_code const & ec);
     
@@ -1044,7 +2701,7 @@ protected:
      * @param msg The message to include in the exception thrown
      */
     void atomic_state_change(istate_type req, istate_type dest,
-        std::string msg);
+        char const * msg);
     
     /// Atomically change the internal and external connection state.
     /**
@@ -1062,7 +2719,7 @@ protected:
      */
     void atomic_state_change(istate_type ireq, istate_type idest, 
         session::state::value ereq, session::state::value edest, 
-        std::string msg);
+        char const * msg);
     
     /// Atomically read and compared the internal state.
     /**
@@ -1071,7 +2728,7 @@ protected:
      *
      * @param msg The message to include in the exception thrown
      */
-    void atomic_state_check(istate_type req, std::string msg);
+    void atomic_state_check(istate_type req, char const * msg);
 private:
     /// Completes m_response, serializes it, and sends it out on the wire.
     void send_http_response();
@@ -1132,32 +2789,291 @@ private:
      * number.
      */ 
     processor_ptr get_processor(int version) const;
-   
-    /// Add a message to the write queue
+
+    /// Re-arm a withheld read on the transport thread
+    void resume_reading_internal();
+
+    /// Apply watermark bookkeeping and the slow consumer policy to a data
+    /// send. Returns an error when the policy refuses the send.
+    lib::error_code check_send_watermarks();
+
+    /// Fire the drain handler if the queue fell back below the low mark
+    void check_send_drain();
+
+    /// Clone the shared handler table before a per connection override
+    void ensure_unique_handlers() {
+        if (!m_handlers) {
+            m_handlers.reset(new handler_table());
+        } else if (!m_handlers.unique()) {
+            m_handlers.reset(new handler_table(*m_handlers));
+        }
+    }
+
+    /// Dispatch a completed message from the processor to the appropriate
+    /// handler (extracted from the read loop so the direct read path can
+    /// share it)
+    void dispatch_ready_message()
+        _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless);
+
+    /// Deliver one extracted message; see dispatch_ready_message
+    void dispatch_message(message_ptr msg)
+        _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless);
+
+    /// Completion handler for reads that landed directly in message storage
+    void handle_read_direct(lib::error_code const & ec,
+        size_t bytes_transferred);
+
+    /// Forward a payload span from the processor to the chunk handler
+    void handle_message_chunk(frame::opcode::value op, uint8_t const * buf,
+        size_t len)
+    {
+        if (m_handlers->message_chunk) {
+            m_handlers->message_chunk(m_connection_hdl,op,
+                reinterpret_cast<char const *>(buf),len,m_chunk_first,false);
+            m_chunk_first = false;
+        }
+    }
+
+    /// Prepare the next queued message on a worker pool thread
     /**
-     * Adds a message to the write queue and updates any associated shared state
-     *
-     * Must be called while holding m_write_lock
-     *
-     * @todo unit tests
-     *
-     * @param msg The message to push
+     * Runs on a pool thread. Pops one message from the pipeline, prepares
+     * it (compressing if negotiated), queues the result for writing, and
+     * chains the next task if more messages are pending.
      */
-    void write_push(message_ptr msg);
+    void run_compress_task();
 
-    /// Pop a message from the write queue
+    /// Resize the read buffer based on the size of the last read
     /**
-     * Removes and returns a message from the write queue and updates any 
-     * associated shared state.
-     *
-     * Must be called while holding m_write_lock
-     *
-     * @todo unit tests
-     *
-     * @return the message_ptr at the front of the queue
+     * Called between reads (never with a read outstanding). Two consecutive
+     * saturating reads double the buffer up to the configured maximum; a
+     * read under a quarter of the buffer halves it down to the configured
+     * minimum, releasing the excess capacity.
      */
-    message_ptr write_pop();
-    
+    void adapt_read_buffer(size_t last_read) {
+        size_t size = m_buf.size();
+
+        if (last_read >= size) {
+            if (++m_full_reads >= 2 && size*2 <= m_max_read_buffer_size) {
+                m_buf.resize(size*2);
+                m_full_reads = 0;
+            }
+        } else {
+            m_full_reads = 0;
+            if (last_read < size/4 &&
+                size/2 >= config::connection_read_buffer_size)
+            {
+                // swap trick so capacity is actually released
+                read_buffer_type smaller(size/2,char(),m_buf.get_allocator());
+                std::copy(m_buf.begin(),m_buf.begin()+size/2,
+                    smaller.begin());
+                m_buf.swap(smaller);
+            }
+        }
+    }
+
+    /// Apply a requested compaction; io thread, no read outstanding
+    void compact_now() {
+        // read buffer back to the configured floor
+        if (m_buf.capacity() > config::connection_read_buffer_size) {
+            read_buffer_type fresh(config::connection_read_buffer_size,
+                char(),m_buf.get_allocator());
+            m_buf.swap(fresh);
+            m_full_reads = 0;
+        }
+        // scratch containers grown by earlier bursts
+        if (m_send_buffer.capacity() > 16) {
+            std::vector<transport::buffer>().swap(m_send_buffer);
+        }
+        if (m_current_msgs.capacity() > 16) {
+            std::vector<message_ptr>().swap(m_current_msgs);
+        }
+        if (m_message_batch.capacity() > 16) {
+            std::vector<message_ptr>().swap(m_message_batch);
+        }
+        if (m_handshake_buffer.capacity() > 0) {
+            std::string().swap(m_handshake_buffer);
+        }
+    }
+
+    /// Tag selecting the exception profile at compile time
+    template <bool exceptionless>
+    struct exception_profile_tag {};
+
+    /// Guarded termination handler call (default profile)
+    void invoke_termination_handler(exception_profile_tag<false>) {
+        try {
+            m_termination_handler(type::shared_from_this());
+        } catch (const std::exception& e) {
+            m_elog.write(log::elevel::warn,
+                std::string("termination_handler call failed. Reason was: ")
+                +e.what());
+        }
+    }
+
+    /// Unguarded call under the exception-free profile: an escaping
+    /// exception terminates the process per the profile's contract
+    void invoke_termination_handler(exception_profile_tag<true>) {
+        m_termination_handler(type::shared_from_this());
+    }
+
+    /// Tag type used to select between fixed and virtual processor dispatch
+    /// at compile time
+    template <bool fixed>
+    struct processor_mode_tag {};
+    typedef processor_mode_tag<processor_selector::fixed> processor_mode;
+
+    /// Compile time selection of static vs dynamic handler dispatch
+    typedef detail::static_handler_selector<config> static_handlers;
+    template <bool Enabled>
+    struct static_handler_tag {};
+    typedef static_handler_tag<static_handlers::enabled> handler_mode;
+
+    void record_dispatch_latency() {
+        if (stats_type::timestamps && m_last_read_us != 0) {
+            uint64_t now = lib::steady_us();
+            if (now >= m_last_read_us) {
+                // zero delta is a real (sub-microsecond) sample
+                m_stats->on_wire_to_handler(now-m_last_read_us);
+            }
+        }
+    }
+
+    void fire_message(message_ptr msg, static_handler_tag<false>) {
+        if (m_handlers->message) {
+            record_dispatch_latency();
+            m_handlers->message(m_connection_hdl,msg);
+            msg->release_view();
+        }
+    }
+    void fire_message(message_ptr msg, static_handler_tag<true>) {
+        record_dispatch_latency();
+        static_handlers::type::on_message(m_connection_hdl,msg);
+        msg->release_view();
+    }
+    void fire_open(static_handler_tag<false>) {
+        if (m_handlers->open) {
+            m_handlers->open(m_connection_hdl);
+        }
+    }
+    void fire_open(static_handler_tag<true>) {
+        static_handlers::type::on_open(m_connection_hdl);
+    }
+    void fire_close(static_handler_tag<false>) {
+        if (m_handlers->close) {
+            m_handlers->close(m_connection_hdl);
+        }
+    }
+    void fire_close(static_handler_tag<true>) {
+        static_handlers::type::on_close(m_connection_hdl);
+    }
+    void fire_fail(static_handler_tag<false>) {
+        if (m_handlers->fail) {
+            m_stats->on_connection_failed();
+            m_handlers->fail(m_connection_hdl);
+        }
+    }
+    void fire_fail(static_handler_tag<true>) {
+        m_stats->on_connection_failed();
+        static_handlers::type::on_fail(m_connection_hdl);
+    }
+
+    /// Tag type selecting the legacy (draft protocol) processor factory
+    /// at compile time; the false variant never references hybi00/07/08
+    template <bool Enabled>
+    struct legacy_versions_tag {};
+
+    /// Construct a draft protocol processor, or nothing when disabled
+    processor_ptr make_legacy_processor(int version,
+        legacy_versions_tag<true>) const;
+    processor_ptr make_legacy_processor(int version,
+        legacy_versions_tag<false>) const;
+
+    /// Consume bytes through the processor
+    /**
+     * When the config fixes the processor type at compile time the call is
+     * made qualified through the concrete type, bypassing virtual dispatch
+     * so the frame parser can inline. Otherwise dispatches virtually.
+     */
+    size_t processor_consume(uint8_t * buf, size_t len, lib::error_code & ec) {
+        return processor_consume_impl(buf,len,ec,processor_mode());
+    }
+
+    size_t processor_consume_impl(uint8_t * buf, size_t len,
+        lib::error_code & ec, processor_mode_tag<false>)
+    {
+        return m_processor->consume(buf,len,ec);
+    }
+
+    size_t processor_consume_impl(uint8_t * buf, size_t len,
+        lib::error_code & ec, processor_mode_tag<true>)
+    {
+        typedef typename processor_selector::type concrete;
+        return static_cast<concrete *>(m_processor.get())
+            ->concrete::consume(buf,len,ec);
+    }
+
+    /// Whether the processor has a complete message ready (see
+    /// processor_consume regarding dispatch)
+    bool processor_ready() {
+        return processor_ready_impl(processor_mode());
+    }
+
+    bool processor_ready_impl(processor_mode_tag<false>) {
+        return m_processor->ready();
+    }
+
+    bool processor_ready_impl(processor_mode_tag<true>) {
+        typedef typename processor_selector::type concrete;
+        return static_cast<concrete *>(m_processor.get())->concrete::ready();
+    }
+
+    /// Extract the completed message from the processor (see
+    /// processor_consume regarding dispatch)
+    message_ptr processor_get_message() {
+        return processor_get_message_impl(processor_mode());
+    }
+
+    message_ptr processor_get_message_impl(processor_mode_tag<false>) {
+        return m_processor->get_message();
+    }
+
+    message_ptr processor_get_message_impl(processor_mode_tag<true>) {
+        typedef typename processor_selector::type concrete;
+        return static_cast<concrete *>(m_processor.get())
+            ->concrete::get_message();
+    }
+
+    /// Construct the compile time fixed processor, or an empty pointer when
+    /// the negotiated version does not match it
+    processor_ptr make_fixed_processor(int version,
+        processor_mode_tag<true>) const
+    {
+        processor_ptr p(new typename processor_selector::type(
+            transport_con_type::is_secure(),m_is_server,m_msg_manager,
+            m_rng));
+        if (p->get_version() != version) {
+            return processor_ptr();
+        }
+        return p;
+    }
+
+    processor_ptr make_fixed_processor(int, processor_mode_tag<false>) const {
+        return processor_ptr();
+    }
+
+    /// Protocol version of the compile time fixed processor
+    int make_fixed_processor_version() const {
+        return make_fixed_processor_version_impl(processor_mode());
+    }
+
+    int make_fixed_processor_version_impl(processor_mode_tag<true>) const {
+        return processor_selector::type::protocol_version;
+    }
+
+    int make_fixed_processor_version_impl(processor_mode_tag<false>) const {
+        return 0;
+    }
+   
     /// Prints information about the incoming connection to the access log
     /**
      * Prints information about the incoming connection to the access log.
@@ -1178,57 +3094,36 @@ private:
      */
     void log_fail_result();
     
-    // static settings
-    const std::string       m_user_agent;
-    
-    /// Pointer to the connection handle
-    connection_hdl          m_connection_hdl;
+    // Member layout contract
+    //
+    // Members are grouped by access pattern and -- on toolchains with
+    // C++17 aligned new, where heap allocations honor extended
+    // alignment -- the groups are separated to cache line boundaries,
+    // so io-thread frame processing, producer thread sends, and
+    // setup/teardown state do not share lines (perf c2c showed the old
+    // interleaved layout bouncing lines between the io thread's reads
+    // and producer sends). Pre-C++17 builds keep the grouping but not
+    // the boundary guarantee; see _WEBSOCKETPP_CACHELINE_ALIGN_:
+    //
+    //   HOT  -- touched by the io thread on every frame
+    //   WARM -- touched by producer threads on every send
+    //   COLD -- handshake/teardown state, touched rarely
+    //
+    // Keep new members in the section matching their access pattern; a
+    // hot-path member landing in COLD is a performance bug, not a style
+    // nit. m_allocator must stay declared before the containers
+    // constructed from it.
 
-    /// Handler objects
-    open_handler            m_open_handler;
-    close_handler           m_close_handler;
-    fail_handler            m_fail_handler;
-    ping_handler            m_ping_handler;
-    pong_handler            m_pong_handler;
-    pong_timeout_handler    m_pong_timeout_handler;
-    interrupt_handler       m_interrupt_handler;
-    http_handler            m_http_handler;
-    validate_handler        m_validate_handler;
-    message_handler         m_message_handler;
+    // ---- HOT: io-thread state, read/written per frame ----
 
-    /// External connection state
-    /**
-     * Lock: m_connection_state_lock
-     */
-    session::state::value   m_state;
+    /// Session state as a single atomic word; queries on hot paths are
+    /// relaxed loads and transitions use CAS (see atomic_state_change).
+    _WEBSOCKETPP_CACHELINE_ALIGN_
+    lib::atomic<session::state::value> m_state;
 
     /// Internal connection state
-    /**
-     * Lock: m_connection_state_lock
-     */
-    istate_type             m_internal_state;
-
-    mutable mutex_type      m_connection_state_lock;
-
-    /// The lock used to protect the message queue
-    /**
-     * Serializes access to the write queue as well as shared state within the 
-     * processor.
-     */
-    mutex_type              m_write_lock;
+    lib::atomic<istate_type> m_internal_state;
 
-    // connection resources
-    char                    m_buf[config::connection_read_buffer_size];
-    size_t                  m_buf_cursor;
-    termination_handler     m_termination_handler;
-    con_msg_manager_ptr     m_msg_manager;
-    timer_ptr               m_handshake_timer;
-    timer_ptr               m_ping_timer;
-    
-    /// @todo this is not memory efficient. this value is not used after the
-    /// handshake.
-    std::string m_handshake_buffer;
-    
     /// Pointer to the processor object for this connection
     /**
      * The processor provides functionality that is specific to the WebSocket 
@@ -1240,33 +3135,182 @@ private:
      */
     processor_ptr           m_processor;
 
-    /// Queue of unsent outgoing messages
-    /**
-     * Lock: m_write_lock
-     */
-    std::queue<message_ptr> m_send_queue;
+    mutable con_msg_manager_ptr     m_msg_manager;
+    /// Guards the lazy construction of m_msg_manager; the ready flag is
+    /// the lock-free fast path (see msg_manager())
+    mutable mutex_type              m_msg_manager_lock;
+    mutable lib::atomic<bool>       m_msg_manager_ready;
+
+    /// Allocator instance shared by this connection's containers; with an
+    /// arena policy, every copy feeds the same per connection arena.
+    /// Declared before the containers constructed from it.
+    allocator_type          m_allocator;
+    /// Transport read buffer. Starts at the config's
+    /// connection_read_buffer_size and is resized adaptively (see
+    /// adapt_read_buffer); only ever resized between reads.
+    typedef std::vector<char,
+        typename lib::rebind_alloc<allocator_type,char>::type>
+        read_buffer_type;
+    read_buffer_type        m_buf;
+    size_t                  m_buf_cursor;
+    /// Consecutive reads that filled the whole buffer
+    size_t                  m_full_reads;
+    /// Upper bound for adaptive growth of the read buffer
+    size_t                  m_max_read_buffer_size;
+    size_t                  m_read_budget_frames;
+    uint64_t                m_read_budget_us;
+    bool                    m_read_resuming;
+    bool                    m_rl_enabled;
+    rate_limit::policy      m_rl_policy;
+    double                  m_rl_msg_rate;
+    double                  m_rl_byte_rate;
+    double                  m_rl_msg_tokens;
+    double                  m_rl_byte_tokens;
+    uint64_t                m_rl_last_us;
+    rate_limit::striped_bucket::ptr m_rl_agg_msgs;
+    rate_limit::striped_bucket::ptr m_rl_agg_bytes;
+    size_t                  m_rl_agg_key;
+    /// Arrival time of the last transport read (latency instrumentation)
+    uint64_t                m_last_read_us;
+
+    /// Messages awaiting batched delivery; reused across reads
+    std::vector<message_ptr> m_message_batch;
 
-    /// Size in bytes of the outstanding payloads in the write queue
-    /**
-     * Lock: m_write_lock
-     */
-    size_t m_send_buffer_size;
-    
     /// buffer holding the various parts of the current message being writen
     /**
      * Lock m_write_lock
      */
     std::vector<transport::buffer> m_send_buffer;
+
+    /// Messages included in the write currently in flight. Held to keep
+    /// their header and payload storage alive until the gather write
+    /// completes.
+    std::vector<message_ptr> m_current_msgs;
+
+    /// Raw continuation mode; see set_raw_continuations
+    bool                    m_raw_continuations;
+    /// Set when terminate begins; stops raw chains from re-posting
+    bool                    m_terminating;
+    /// Terminal self reference pinning the connection in raw mode
+    ptr                     m_self;
+    /// Pre-built raw continuations, constructed once at start()
+    transport::read_handler m_raw_read_continuation;
+    lib::function<void()>   m_raw_write_continuation;
+
+    /// Whether to read payloads directly into message storage
+    bool m_direct_payload_reads;
+
+    /// Read pause state. m_read_paused is the requested state;
+    /// m_read_withheld records that a re-arm was skipped and must happen
+    /// on resume. m_read_withheld is only touched on the transport thread.
+    bool m_read_paused;
+    bool m_read_withheld;
+    bool m_auto_read_pause;
+
+    /// Whether the next streamed chunk starts a new message
+    bool m_chunk_first;
+
+    /// Active send_stream state; the source is only invoked from the
+    /// transport's event loop
+    stream_source           m_stream_source;
+    frame::opcode::value    m_stream_op;
+    size_t                  m_stream_chunk_size;
+    bool                    m_stream_first;
+    bool                    m_stream_active;
+
+    /// Handler objects
+    /// Shared (copy-on-write) table of session handlers
+    typename handler_table::ptr m_handlers;
+
+    /// Shared instrumentation sink (never null)
+    stats_ptr m_stats;
+
+    /// Byte budget for coalescing queued messages into one gather write
+    static size_t const write_batch_bytes = 65536;
+
+    bool const              m_is_server;
+    alog_type& m_alog;
+    elog_type& m_elog;
     
-    /// a pointer to hold on to the current message being written to keep it 
-    /// from going out of scope before the write is complete.
-    message_ptr m_current_msg;
-    
-    /// True if there is currently an outstanding transport write
+    rng_type & m_rng;
+
+    // ---- WARM: producer-thread send state ----
+
+    /// The lock used to protect the message queue
     /**
-     * Lock m_write_lock
+     * Serializes access to the write queue as well as shared state within the 
+     * processor.
+     */
+    _WEBSOCKETPP_CACHELINE_ALIGN_
+    mutex_type              m_write_lock;
+
+    /// Queue of unsent outgoing messages
+    /**
+     * Couples the message queue with the writer-active flag; thread safety
+     * is provided by the concurrency policy's send_queue implementation
+     * rather than m_write_lock.
+     */
+    send_queue_type m_send_queue;
+
+    /// Send queue watermark state
+    size_t m_send_high_watermark;
+    size_t m_send_low_watermark;
+    typename slow_consumer_policy::value m_slow_consumer_policy;
+    /// Whether the queue is currently above the high watermark
+    bool m_send_queue_over;
+
+    /// Maximum outgoing frame payload size; 0 disables fragmentation
+    size_t                  m_max_outgoing_frame_size;
+    /// Default TTL for queued data messages; 0 disables
+    long                    m_default_ttl_ms;
+
+    /// Count of pong frames received; see get_pong_count
+    lib::atomic<size_t>     m_pong_count;
+
+    /// Worker pool for asynchronous frame preparation (may be empty)
+    concurrency::worker_pool::ptr m_compress_pool;
+
+    /// Worker pool for offloaded message handlers (may be empty)
+    concurrency::worker_pool::ptr m_handler_pool;
+    /// Offload backlog cap; reads pause beyond it
+    size_t m_offload_cap;
+    /// Messages awaiting or running an offloaded handler
+    /**
+     * Lock: m_offload_lock
+     */
+    std::queue<message_ptr> m_offload_pending;
+    bool m_offload_active;
+    bool m_offload_paused;
+    mutex_type m_offload_lock;
+
+    /// Messages awaiting asynchronous preparation, in send order
+    /**
+     * Lock: m_compress_pipeline_lock
+     */
+    std::queue<message_ptr> m_compress_pending;
+
+    /// Whether a preparation task for this connection is queued or running
+    /**
+     * Lock: m_compress_pipeline_lock
      */
-    bool m_write_flag;
+    bool m_compress_active;
+
+    mutex_type m_compress_pipeline_lock;
+
+    mutable mutex_type      m_connection_state_lock;
+
+    // ---- COLD: handshake, configuration, and teardown state ----
+
+    // static settings
+    _WEBSOCKETPP_CACHELINE_ALIGN_
+    const std::string       m_user_agent;
+
+    /// Pointer to the connection handle
+    connection_hdl          m_connection_hdl;
+    /// Endpoint-issued fast handle; see get_fast_handle
+    fast_connection_hdl     m_fast_handle;
+
+    termination_handler     m_termination_handler;
 
     // connection data
     request_type            m_request;
@@ -1277,19 +3321,83 @@ private:
     // connection data that might not be necessary to keep around for the life
     // of the whole connection.
     std::vector<std::string> m_requested_subprotocols;
-    
-    bool const              m_is_server;
-    alog_type& m_alog;
-    elog_type& m_elog;
-    
-    rng_type & m_rng;
-    
+
+    /// @todo this is not memory efficient. this value is not used after the
+    /// handshake.
+    std::string m_handshake_buffer;
+
+    timer_ptr               m_handshake_timer;
+    timer_ptr               m_ping_timer;
+
+    /// Whether to request borrowed payload delivery from the processor
+    bool                    m_borrowed_messages;
+
+    /// Text validation policy forwarded to the processor
+    processor::validation_policy::value m_validation_policy;
+    /// Compression dictionary forwarded to the processor
+    std::string             m_compression_dictionary;
+    /// Write-side deflate reset interval; see set_compression_write_reset
+    size_t                  m_compress_reset_msgs;
+    size_t                  m_compress_reset_bytes;
+    extensions::permessage_deflate::level_controller::ptr
+        m_level_controller;
+    /// Handshake header caps reapplied on keep-alive parser rebuilds
+    size_t                  m_max_header_bytes;
+    size_t                  m_max_header_line_bytes;
+
+    /// Shared prepared close frames; null for clients
+    typename close_frame_cache::ptr m_close_frames;
+
+    /// Handshake pre-screen filter; empty means no screening
+    prescreen_handler       m_prescreen;
+    /// Whether this connection's first bytes were already screened
+    bool                    m_prescreened;
+
+    /// Registered subprotocols for allocation free auto-selection
+    subprotocol_table_ptr   m_subprotocol_table;
+    /// Table index of the auto-selected subprotocol; npos when none
+    size_t                  m_subprotocol_index;
+
+    /// Shared 101 response template cache; null for clients
+    typename handshake_template_cache::ptr m_handshake_templates;
+    /// Shared upgrade request template cache; null for servers
+    typename client_template_cache::ptr m_client_templates;
+    /// Scratch cache key for the request template lookup
+    std::string             m_template_key;
+
+    /// HTTP keep-alive limits; see set_http_keepalive
+    size_t                  m_http_keepalive_requests;
+    long                    m_http_keepalive_idle_ms;
+    /// Requests served on this connection so far
+    size_t                  m_http_requests_served;
+    /// Whether the current response should keep the connection open
+    bool                    m_http_keepalive_this;
+
+    /// Endpoint keepalive service bookkeeping
+    keepalive_state         m_keepalive;
+    rtt_stats               m_rtt;
+    integrity_stats         m_integrity;
+    bool                    m_swept_pong_timeouts;
+    /// Cross-thread send mailbox; see set_send_mailbox
+    bool                    m_mailbox_enabled;
+    lib::atomic<mailbox_node *> m_mailbox_head;
+    lib::atomic<bool>       m_mailbox_armed;
+    /// Handshake-in-progress accounting; see set_handshake_gauge
+    handshake_gauge_ptr     m_handshake_gauge;
+    bool                    m_handshake_gauge_held;
+    /// Reads observed; see get_read_count
+    size_t                  m_reads_observed;
+    /// Compaction request flag (set by the sweep, consumed on io thread)
+    lib::atomic<bool>       m_compact_requested;
+
     // Close state
     /// Close code that was sent on the wire by this endpoint
     close::status::value    m_local_close_code;
 
     /// Close reason that was sent on the wire by this endpoint
-    std::string             m_local_close_reason;
+    mutable std::string     m_local_close_reason;
+    /// Whether the local reason still needs materializing from m_ec
+    mutable bool            m_close_reason_deferred;
 
     /// Close code that was received on the wire from the remote endpoint
     close::status::value    m_remote_close_code;
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CRC32C_HPP
+#define WEBSOCKETPP_CRC32C_HPP
+
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+// Hardware CRC32C (Castagnoli) with a table fallback
+//
+// SSE4.2 provides the crc32 instruction family; AArch64 the CRC
+// extension. Either streams at tens of GB/s, so an integrity pass over
+// payload bytes that are already hot from masking or validation costs
+// close to nothing. The software fallback is a standard 8-bit table.
+#ifndef WEBSOCKETPP_DISABLE_HW_CRC32C
+    #if defined(__SSE4_2__)
+        #define WEBSOCKETPP_CRC32C_SSE42
+        #include <nmmintrin.h>
+    #endif
+    #if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+        #define WEBSOCKETPP_CRC32C_ARM
+        #include <arm_acle.h>
+    #endif
+#endif
+
+namespace websocketpp {
+namespace crc32c {
+
+namespace detail {
+
+/// Software CRC32C table, built on first use
+inline uint32_t const * table() {
+    static uint32_t t[256];
+    static bool built = false;
+    if (!built) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0x82f63b78u ^ (c >> 1)) : (c >> 1);
+            }
+            t[i] = c;
+        }
+        built = true;
+    }
+    return t;
+}
+
+} // namespace detail
+
+/// Extend a CRC32C over a byte span
+/**
+ * @param crc The running checksum (start from 0)
+ * @param data Bytes to fold in
+ * @param len Number of bytes
+ * @return The extended checksum
+ */
+inline uint32_t extend(uint32_t crc, void const * data, size_t len) {
+    uint8_t const * p = static_cast<uint8_t const *>(data);
+    crc = ~crc;
+#if defined(WEBSOCKETPP_CRC32C_SSE42)
+    while (len >= 8) {
+        uint64_t chunk;
+        __builtin_memcpy(&chunk,p,8);
+        crc = static_cast<uint32_t>(
+            _mm_crc32_u64(crc,chunk));
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc,*p++);
+        len--;
+    }
+#elif defined(WEBSOCKETPP_CRC32C_ARM)
+    while (len >= 8) {
+        uint64_t chunk;
+        __builtin_memcpy(&chunk,p,8);
+        crc = __crc32cd(crc,chunk);
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32cb(crc,*p++);
+        len--;
+    }
+#else
+    uint32_t const * t = detail::table();
+    while (len > 0) {
+        crc = t[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+#endif
+    return ~crc;
+}
+
+} // namespace crc32c
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CRC32C_HPP
@@ -29,9 +29,17 @@
 #define WEBSOCKETPP_ENDPOINT_HPP
 
 #include <websocketpp/connection.hpp>
+#include <websocketpp/extensions/permessage_deflate/budget.hpp>
 #include <websocketpp/logger/levels.hpp>
+#include <websocketpp/config/validate.hpp>
+#include <websocketpp/common/time.hpp>
+#include <websocketpp/message_buffer/metrics.hpp>
 #include <websocketpp/version.hpp>
 
+#include <cstring>
+#include <list>
+#include <utility>
+
 #include <iostream>
 #include <set>
 
@@ -91,14 +99,62 @@ public:
       : m_alog(config::alog_level, &std::cout)
       , m_elog(config::elog_level, &std::cerr)
       , m_user_agent(::websocketpp::user_agent)
+      , m_max_read_buffer_size(config::connection_read_buffer_size*64)
+      , m_max_outgoing_frame_size(0)
+      , m_read_budget_frames(0)
+      , m_read_budget_us(0)
+      , m_rl_msg_rate(0)
+      , m_rl_byte_rate(0)
+      , m_rl_policy(rate_limit::delay)
+      , m_borrowed_messages(false)
+      , m_validation_policy(processor::validation_policy::strict)
+      , m_raw_continuations_default(false)
+      , m_compress_reset_msgs(0)
+      , m_compress_reset_bytes(0)
+      , m_max_connections(0)
+      , m_max_handshakes(0)
+      , m_load_shedding(false)
+      , m_shed_response(
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Connection: close\r\n"
+            "Retry-After: 1\r\n"
+            "Content-Length: 0\r\n\r\n")
+      , m_handshake_gauge(new lib::atomic<size_t>(0))
+      , m_drain_active(false)
+      , m_drain_batch(0)
+      , m_drain_interval(1000)
+      , m_drain_initial(0)
+      , m_prepared_cache_capacity(64)
+      , m_cleanup_enabled(false)
+      , m_cleanup_stop(false)
+      , m_ka_enabled(false)
+      , m_ka_interval_ms(30000)
+      , m_ka_pong_timeout_ms(config::timeout_pong)
+      , m_ka_tick_ms(1000)
+      , m_ka_tick(0)
+      , m_compact_idle_ms(0)
       , m_is_server(is_server)
     {
+        m_con_shards.push_back(lib::shared_ptr<con_shard>(new con_shard()));
+        m_stats.reset(new typename connection_type::stats_type());
         m_alog.set_channels(config::alog_level);
         m_elog.set_channels(config::elog_level);
         
         m_alog.write(log::alevel::devel,"endpoint constructor");
 
+        m_handler_table.reset(new typename connection_type::handler_table());
+
         transport_type::init_logging(&m_alog,&m_elog);
+
+        // compile time config sanity checks and (opt in) tuning report
+        (void)config_validation::validator<config>::ok;
+        config_validation::reporter<config>::emit();
+    }
+
+    ~endpoint() {
+        // stop and join the cleanup reaper if it was started; queued
+        // references are drained first
+        disable_deferred_cleanup();
     }
     
     /// Returns the user agent string that this endpoint will use
@@ -221,45 +277,73 @@ public:
     void set_open_handler(open_handler h) {
         m_alog.write(log::alevel::devel,"set_open_handler");
         scoped_lock_type guard(m_mutex);
-        m_open_handler = h;
+        update_handler_table()->open = h;
     }
     void set_close_handler(close_handler h) {
         m_alog.write(log::alevel::devel,"set_close_handler");
         scoped_lock_type guard(m_mutex);
-        m_close_handler = h;
+        update_handler_table()->close = h;
     }
     void set_fail_handler(fail_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_fail_handler = h;
+        update_handler_table()->fail = h;
     }
     void set_ping_handler(ping_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_ping_handler = h;
+        update_handler_table()->ping = h;
     }
     void set_pong_handler(pong_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_pong_handler = h;
+        update_handler_table()->pong = h;
     }
     void set_pong_timeout_handler(pong_timeout_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_pong_timeout_handler = h;
+        update_handler_table()->pong_timeout = h;
     }
     void set_interrupt_handler(interrupt_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_interrupt_handler = h;
+        update_handler_table()->interrupt = h;
     }
     void set_http_handler(http_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_http_handler = h;
+        update_handler_table()->http = h;
     }
     void set_validate_handler(validate_handler h) {
         scoped_lock_type guard(m_mutex);
-        m_validate_handler = h;
+        update_handler_table()->validate = h;
     }
     void set_message_handler(message_handler h) {
         m_alog.write(log::alevel::devel,"set_message_handler");
         scoped_lock_type guard(m_mutex);
-        m_message_handler = h;
+        update_handler_table()->message = h;
+    }
+    /// @see connection::set_text_message_handler
+    void set_text_message_handler(message_handler h) {
+        scoped_lock_type guard(m_mutex);
+        update_handler_table()->text_message = h;
+    }
+    /// @see connection::set_binary_message_handler
+    void set_binary_message_handler(message_handler h) {
+        scoped_lock_type guard(m_mutex);
+        update_handler_table()->binary_message = h;
+    }
+    /// @see connection::set_binary_route
+    void set_binary_route(uint8_t tag, message_handler h) {
+        scoped_lock_type guard(m_mutex);
+        typename connection_type::handler_table::ptr table =
+            update_handler_table();
+        if (table->binary_routes.empty()) {
+            table->binary_routes.resize(256);
+        }
+        table->binary_routes[tag] = h;
+    }
+    /// @see connection::set_batch_message_handler
+    void set_batch_message_handler(
+        typename connection_type::batch_message_handler h)
+    {
+        m_alog.write(log::alevel::devel,"set_batch_message_handler");
+        scoped_lock_type guard(m_mutex);
+        update_handler_table()->batch_message = h;
     }
     
     /*************************************/
@@ -277,10 +361,891 @@ public:
     void interrupt(connection_hdl hdl, lib::error_code & ec);
     void interrupt(connection_hdl hdl);
 
+    /// Set the maximum adaptive read buffer size for new connections
+    /**
+     * Applied to connections created after this call; existing connections
+     * are unaffected. See connection::set_max_read_buffer_size.
+     */
+    void set_max_read_buffer_size(size_t size) {
+        m_max_read_buffer_size = size;
+    }
+
+    /// Fragment outgoing messages larger than the given payload size
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_max_outgoing_frame_size.
+     */
+    void set_max_outgoing_frame_size(size_t size) {
+        m_max_outgoing_frame_size = size;
+    }
+
+    /// Bound per-invocation read-loop work on future connections
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_read_loop_budget.
+     */
+    void set_read_loop_budget(size_t max_frames, uint64_t max_us) {
+        m_read_budget_frames = max_frames;
+        m_read_budget_us = max_us;
+    }
+
+    /// Rate limit inbound traffic on all future connections
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_rate_limit.
+     */
+    void set_rate_limit(double msgs_per_sec, double bytes_per_sec,
+        rate_limit::policy policy)
+    {
+        m_rl_msg_rate = msgs_per_sec;
+        m_rl_byte_rate = bytes_per_sec;
+        m_rl_policy = policy;
+    }
+
+    /// Rate limit aggregate inbound traffic across the whole endpoint
+    /**
+     * Striped atomic token buckets shared by every future connection;
+     * each connection charges the stripe its identity hashes to, so the
+     * ceiling is approximate but enforcement never contends on one
+     * cache line. Over-limit applies the per connection policy (see
+     * set_rate_limit). Zero disables a bucket.
+     */
+    void set_endpoint_rate_limit(double msgs_per_sec,
+        double bytes_per_sec)
+    {
+        m_rl_agg_msgs.reset();
+        m_rl_agg_bytes.reset();
+        if (msgs_per_sec > 0) {
+            m_rl_agg_msgs.reset(
+                new rate_limit::striped_bucket(msgs_per_sec));
+        }
+        if (bytes_per_sec > 0) {
+            m_rl_agg_bytes.reset(
+                new rate_limit::striped_bucket(bytes_per_sec));
+        }
+    }
+
+    /// Deliver suitable inbound messages as zero copy borrowed views
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_borrowed_messages.
+     */
+    void set_borrowed_messages(bool value) {
+        m_borrowed_messages = value;
+    }
+
+    /// Cap the number of simultaneous connections
+    /**
+     * Zero (the default) means unlimited. When the striped connection
+     * gauge is at or above the limit, newly accepted connections are
+     * rejected before any handshake machinery runs -- with pooling
+     * enabled the rejected object recycles immediately, so an accept
+     * storm at the ceiling costs a counter read and a recycle per
+     * attempt rather than real connection resources. Enforcement is
+     * wait-free; no lock serializes accepts.
+     */
+    void set_max_connections(size_t limit) {
+        m_max_connections = limit;
+    }
+
+    /// Emergency load shedding: reject new connections with a cheap 503
+    /**
+     * While active, the server role answers every accepted connection
+     * with a pre-serialized static 503 written straight from accept --
+     * nothing is read or parsed, no handshake machinery runs, and with
+     * pooling the connection object recycles immediately -- then closes.
+     * Rejecting this way costs a canned write instead of a full
+     * handshake, so an overloaded process sheds instead of collapsing.
+     * Drive it from whatever overload signal fits: send watermarks, the
+     * stats counters, an external controller. Thread safe.
+     */
+    void set_load_shedding(bool active) {
+        m_load_shedding.store(active,lib::memory_order_relaxed);
+    }
+
+    /// Whether load shedding is active
+    bool is_load_shedding() const {
+        return m_load_shedding.load(lib::memory_order_relaxed);
+    }
+
+    /// The canned load-shedding response bytes
+    /**
+     * Static for the endpoint's lifetime, so shed writes can reference
+     * it without copying. Customize before enabling shedding.
+     */
+    void set_shed_response(std::string const & response) {
+        m_shed_response = response;
+    }
+    std::string const & shed_response() const {
+        return m_shed_response;
+    }
+
+    /// Cap concurrent in-progress handshakes (server role)
+    /**
+     * During SYN-flood-adjacent events every embryonic connection holds
+     * handshake-stage buffers; capping how many may be mid-handshake at
+     * once converts that memory into a fixed budget (the cap times the
+     * per-handshake header cap, with arena parsing bounding each one).
+     * Accepts beyond the cap are shed before any handshake machinery
+     * runs, exactly like the total-connection ceiling. Zero (the
+     * default) means unlimited.
+     */
+    void set_max_handshakes(size_t limit) {
+        m_max_handshakes = limit;
+    }
+
+    /// Handshakes currently in progress
+    size_t current_handshakes() const {
+        return m_handshake_gauge->load(lib::memory_order_relaxed);
+    }
+
+    /// Whether the handshake ceiling is reached (server accept path)
+    bool handshake_limit_reached() const {
+        return m_max_handshakes > 0
+            && m_handshake_gauge->load(lib::memory_order_relaxed)
+                >= m_max_handshakes;
+    }
+
+    /// The shared handshake gauge for new server connections
+    typename connection_type::handshake_gauge_ptr handshake_gauge() {
+        return m_handshake_gauge;
+    }
+
+    /// Approximate number of live connections (wait-free read)
+    size_t current_connections() const {
+        return m_connection_gauge.read();
+    }
+
+    /// Whether the connection ceiling is currently reached
+    /**
+     * The gauge counts registered connection objects, which includes the
+     * accept chains' armed-but-unconnected ones; slack (the server's
+     * accept depth) compensates so the ceiling applies to live
+     * connections.
+     */
+    bool connection_limit_reached(size_t slack) const {
+        return m_max_connections != 0
+            && m_connection_gauge.read() >= m_max_connections + slack;
+    }
+
+    /// Approximate bytes accepted for sending but not yet written
+    /**
+     * Derived from the endpoint's cumulative instrumentation counters
+     * (message payload bytes accepted minus frame bytes written), so it
+     * is wait-free and slightly skewed by frame header overhead;
+     * suitable for ceilings, not billing. Requires the counters stats
+     * policy; the none policy reads as zero.
+     */
+    long long current_queued_bytes() const {
+        instrumentation::snapshot s = m_stats->get();
+        long long queued = static_cast<long long>(s.message_bytes_out)
+            - static_cast<long long>(s.write_bytes);
+        return (queued > 0 ? queued : 0);
+    }
+
+    /// Approximate messages accepted for sending but not yet written
+    /**
+     * Same derivation and caveats as current_queued_bytes.
+     */
+    long long current_messages_in_flight() const {
+        instrumentation::snapshot s = m_stats->get();
+        long long pending =
+            static_cast<long long>(s.messages_submitted)
+            - static_cast<long long>(s.messages_out);
+        return (pending > 0 ? pending : 0);
+    }
+
+    /// Install a handshake pre-screen filter on future connections
+    /**
+     * See connection::set_prescreen_handler. Passing an empty handler
+     * installs the built-in filter, which requires the first bytes to
+     * look like the start of a plausible upgrade request (a GET or
+     * CONNECT method token followed by a target and an HTTP version on a
+     * bounded request line).
+     */
+    void set_prescreen_handler(
+        typename connection_type::prescreen_handler h)
+    {
+        scoped_lock_type guard(m_mutex);
+        if (h) {
+            m_prescreen = h;
+        } else {
+            m_prescreen = &endpoint::default_prescreen;
+        }
+    }
+
+    /// Built-in plausibility filter for set_prescreen_handler
+    static bool default_prescreen(char const * data, size_t len) {
+        // method token: the upgrade paths use GET (RFC 6455) or CONNECT
+        // (RFC 8441 embedders); anything else is not a WebSocket client
+        if (len >= 4 && std::memcmp(data,"GET ",4) == 0) {
+            return prescreen_request_line(data,len);
+        }
+        if (len >= 8 && std::memcmp(data,"CONNECT ",8) == 0) {
+            return prescreen_request_line(data,len);
+        }
+        // fewer than 4 bytes cannot be judged yet; let the parser's
+        // framing limits handle pathological dribbles
+        return len < 4;
+    }
+
+    /// Bind steady-state continuations to a raw pointer
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_raw_continuations.
+     */
+    void set_raw_continuations(bool value) {
+        m_raw_continuations_default = value;
+    }
+
+    /// Prime permessage-deflate with a shared dictionary
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_compression_dictionary.
+     */
+    void set_compression_dictionary(std::string const & dict) {
+        m_compression_dictionary = dict;
+    }
+
+    /// Bound write-side compression history on future connections
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_compression_write_reset.
+     */
+    void set_compression_write_reset(size_t messages, size_t bytes) {
+        m_compress_reset_msgs = messages;
+        m_compress_reset_bytes = bytes;
+    }
+
+    /// Budget compression CPU; adapt deflate level automatically
+    /**
+     * Creates a shared permessage_deflate::level_controller targeting
+     * the given compression duty cycle (fraction of wall time spent in
+     * deflate across this endpoint's connections). Quiet periods drift
+     * the level up toward 9, converting idle CPU into egress savings;
+     * load drives it down toward 1. Applied to future connections.
+     *
+     * @param budget_fraction Target duty cycle, e.g. 0.05 for 5%
+     * @param initial_level Starting zlib level
+     */
+    void set_compression_cpu_budget(double budget_fraction,
+        int initial_level = 6)
+    {
+        m_level_controller.reset(
+            new extensions::permessage_deflate::level_controller(
+                budget_fraction,initial_level));
+    }
+
+    /// The endpoint's adaptive level controller (may be empty)
+    extensions::permessage_deflate::level_controller::ptr
+    get_level_controller() const {
+        return m_level_controller;
+    }
+
+    /// Select how inbound text payloads are UTF-8 validated
+    /**
+     * Applied to all future connections; existing connections are
+     * unaffected. See connection::set_validation_policy.
+     */
+    void set_validation_policy(processor::validation_policy::value v) {
+        m_validation_policy = v;
+    }
+
+    /// Register the server's supported subprotocols, highest priority first
+    /**
+     * With a table registered, connections whose validate handler does
+     * not choose a subprotocol auto-select the highest priority entry the
+     * client offered, matching against the raw header with no tokenizing
+     * allocations; the chosen entry's table index is available from
+     * connection::get_subprotocol_index for cheap dispatch. When no
+     * validate handler is set, the per handshake offer list is not
+     * tokenized at all. Applied to connections created after the call.
+     */
+    void register_subprotocols(std::vector<std::string> const & protocols) {
+        scoped_lock_type guard(m_mutex);
+        m_subprotocols.reset(
+            new std::vector<std::string>(protocols));
+    }
+
+    /// Snapshot the endpoint wide instrumentation totals
+    /**
+     * Meaningful with an instrumentation policy selected in the config
+     * (see instrumentation::counters); with the default none policy the
+     * snapshot is all zeros.
+     */
+    /// Direct access to the shared stats policy object
+    /**
+     * For policies exposing more than the common snapshot (e.g.
+     * histogram_counters' latency buckets).
+     */
+    typename connection_type::stats_ptr get_stats_object() const {
+        return m_stats;
+    }
+
+    instrumentation::snapshot get_stats() const {
+        return m_stats->get();
+    }
+
+    /// Set the default send-queue-full handler for new connections
+    void set_send_queue_full_handler(open_handler h) {
+        scoped_lock_type guard(m_mutex);
+        update_handler_table()->send_queue_full = h;
+    }
+
+    /// Set the default send-queue-drain handler for new connections
+    void set_send_queue_drain_handler(open_handler h) {
+        scoped_lock_type guard(m_mutex);
+        update_handler_table()->send_queue_drain = h;
+    }
+
+    /// Set the process wide compression memory budget
+    /**
+     * Convenience forwarder to
+     * extensions::permessage_deflate::memory_budget (the budget is
+     * necessarily process wide, as zlib state is shared through pools).
+     * See that class for the degradation behavior. Zero means unlimited.
+     */
+    void set_compression_memory_limit(size_t bytes) {
+        extensions::permessage_deflate::memory_budget::instance()
+            .set_limit(bytes);
+    }
+
+    /// Current estimated aggregate compression memory usage in bytes
+    size_t get_compression_memory_usage() const {
+        return extensions::permessage_deflate::memory_budget::instance()
+            .get_usage();
+    }
+
+    /// Enable pooling of connection objects across sessions
+    /**
+     * When a high-water mark is set, connection instances whose sessions
+     * have fully terminated (refcount reaching zero) are reset and
+     * recycled by create_connection instead of destroyed, avoiding the
+     * construction cost of the multi-KB connection object per accept. At
+     * most hwm instances are retained; beyond that they are destroyed as
+     * before. Zero (the default) disables pooling.
+     *
+     * @param hwm Maximum number of idle pooled connections to retain
+     */
+    void set_connection_pool_size(size_t hwm) {
+        if (!m_con_pool) {
+            m_con_pool.reset(new con_pool());
+        }
+        m_con_pool->hwm = hwm;
+    }
+
+    /// Size the sharded connection registry
+    /**
+     * The endpoint tracks every connection it creates in a sharded registry
+     * (connections are hashed to shards, each with its own lock). The
+     * default single shard matches the old behavior; raising the count
+     * spreads registration churn and for_each_connection iteration across
+     * independently locked shards. Must be called before any connections
+     * are created.
+     *
+     * @param num_shards Number of registry shards
+     */
+    void set_registry_shards(size_t num_shards) {
+        if (num_shards < 1) {
+            num_shards = 1;
+        }
+        m_con_shards.resize(num_shards);
+        for (size_t i = 0; i < num_shards; i++) {
+            if (!m_con_shards[i]) {
+                m_con_shards[i].reset(new con_shard());
+            }
+        }
+    }
+
+    /// Number of connection registry shards
+    size_t get_registry_shard_count() const {
+        return m_con_shards.size();
+    }
+
+    /// Invoke a function for every tracked connection
+    /**
+     * Iterates shard by shard: each shard's handle list is snapshotted
+     * under its own lock and the function is invoked outside any lock, so
+     * the callback is free to send, close, or otherwise re-enter the
+     * endpoint. Connections appear in the registry from creation until
+     * termination, so the callback may see connections that are not (yet)
+     * open; operations on them fail with invalid_state and can be ignored.
+     *
+     * Combined with prepare_message this makes broadcasts one queue push
+     * per subscriber. To parallelize across threads, have each thread call
+     * for_each_connection_in_shard with a disjoint range of shards.
+     *
+     * @param f Function invoked with each connection's handle
+     */
+    void for_each_connection(lib::function<void(connection_hdl)> f) {
+        for (size_t i = 0; i < m_con_shards.size(); i++) {
+            for_each_connection_in_shard(i,f);
+        }
+    }
+
+    /// Invoke a function for every tracked connection in one shard
+    /**
+     * @see for_each_connection
+     */
+    void for_each_connection_in_shard(size_t shard,
+        lib::function<void(connection_hdl)> f)
+    {
+        std::vector<connection_hdl> snapshot;
+        {
+            scoped_lock_type lock(m_con_shards.at(shard)->lock);
+            typename std::set<connection_ptr>::iterator it;
+            for (it = m_con_shards[shard]->cons.begin();
+                 it != m_con_shards[shard]->cons.end(); ++it)
+            {
+                snapshot.push_back((*it)->get_handle());
+            }
+        }
+        for (size_t i = 0; i < snapshot.size(); i++) {
+            f(snapshot[i]);
+        }
+    }
+
+    /// One generation-counted slot in the fast handle table
+    struct fast_slot {
+        fast_slot() : generation(1), raw(static_cast<connection_type *>(0)) {}
+        lib::atomic<uint32_t> generation;
+        /// Lock-free view of `con` for resolve_fast; shared_ptr reads
+        /// and writes are not atomic, the raw mirror is
+        lib::atomic<connection_type *> raw;
+        connection_ptr con;
+    };
+
+    /// Resolve a fast handle to its live connection, or NULL when stale
+    /**
+     * Lock free: the slot table has fixed capacity (see
+     * set_fast_handle_capacity) so the vector never reallocates under
+     * readers, and the connection pointer is read through the slot's
+     * atomic mirror rather than the shared_ptr. Seqlock-style: the
+     * generation is checked on both sides of the pointer load, so a
+     * release/reassign racing the read cannot hand a stale handle the
+     * slot's new occupant -- the trailing check sees the bumped
+     * generation and fails the resolve instead.
+     */
+    connection_type * resolve_fast(fast_connection_hdl hdl) {
+        if (hdl.slot >= m_fast_slots.size()) {
+            return 0;
+        }
+        fast_slot & slot = *m_fast_slots[hdl.slot];
+        if (slot.generation.load(lib::memory_order_acquire)
+            != hdl.generation)
+        {
+            return 0;
+        }
+        connection_type * con = slot.raw.load(lib::memory_order_acquire);
+        if (slot.generation.load(lib::memory_order_acquire)
+            != hdl.generation)
+        {
+            // the slot was recycled between the two loads; `con` may
+            // already belong to a different connection
+            return 0;
+        }
+        return con;
+    }
+
+    /// Size the fast handle slot table (before any connections)
+    /**
+     * The table is fixed capacity so lock-free resolution never races
+     * a reallocation; connections beyond it simply receive no fast
+     * handle (their fast sends fail with bad_connection, the ordinary
+     * handle path is unaffected). Call before the first connection is
+     * created; the default is 4096 slots.
+     */
+    void set_fast_handle_capacity(size_t capacity) {
+        scoped_lock_type guard(m_fast_slot_lock);
+        grow_fast_table(capacity);
+    }
+
+    /// Assign a slot to a newly registered connection
+    void assign_fast_slot(connection_ptr con) {
+        scoped_lock_type guard(m_fast_slot_lock);
+        if (m_fast_slots.empty()) {
+            // built at first use rather than in the constructor so
+            // set_fast_handle_capacity can size it first
+            grow_fast_table(default_fast_handle_capacity);
+        }
+        if (m_fast_free.empty()) {
+            // table exhausted: no fast handle; the invalid default
+            // (slot 0, generation 0) never resolves
+            con->set_fast_handle(fast_connection_hdl());
+            return;
+        }
+        uint32_t idx = m_fast_free.back();
+        m_fast_free.pop_back();
+        fast_slot & slot = *m_fast_slots[idx];
+        slot.con = con;
+        slot.raw.store(con.get(),lib::memory_order_release);
+        con->set_fast_handle(fast_connection_hdl(idx,
+            slot.generation.load(lib::memory_order_relaxed)));
+    }
+
+    /// Invalidate and recycle a deregistering connection's slot
+    void release_fast_slot(connection_ptr con) {
+        fast_connection_hdl hdl = con->get_fast_handle();
+        scoped_lock_type guard(m_fast_slot_lock);
+        if (hdl.slot >= m_fast_slots.size()) {
+            return;
+        }
+        fast_slot & slot = *m_fast_slots[hdl.slot];
+        if (slot.con != con) {
+            return;
+        }
+        // stale handles fail from this point; the strong reference is
+        // surrendered after the bump and the raw mirror clears
+        slot.generation.fetch_add(1,lib::memory_order_release);
+        slot.raw.store(static_cast<connection_type *>(0),
+            lib::memory_order_release);
+        slot.con.reset();
+        m_fast_free.push_back(hdl.slot);
+    }
+
+    /// Grow the slot table and free list together. Slot lock held.
+    /**
+     * Only before readers exist may the vector itself grow; the public
+     * setter documents that constraint.
+     */
+    void grow_fast_table(size_t capacity) {
+        if (capacity <= m_fast_slots.size()) {
+            return;
+        }
+        m_fast_slots.reserve(capacity);
+        m_fast_free.reserve(capacity);
+        while (m_fast_slots.size() < capacity) {
+            m_fast_free.push_back(
+                static_cast<uint32_t>(m_fast_slots.size()));
+            m_fast_slots.push_back(
+                lib::shared_ptr<fast_slot>(new fast_slot()));
+        }
+    }
+
+    /// Default fast handle table capacity
+    static size_t const default_fast_handle_capacity = 4096;
+
+    /// Move connection teardown off the io threads
+    /**
+     * When enabled, the endpoint's final reference to a terminated
+     * connection is handed to a background reaper thread instead of being
+     * dropped inline, so the heavy part of teardown -- compression
+     * contexts, buffers, TLS state, and with pooling the reset-for-reuse
+     * work -- runs off the reactor. Mass disconnect events then cost the
+     * io thread one queue push per connection rather than a full
+     * destructor each, keeping reactor pauses bounded. A transient
+     * handler reference can still occasionally be the last one and
+     * destroy inline; the reaper catches the overwhelming majority.
+     *
+     * The reaper starts on first enable and joins when the endpoint is
+     * destroyed.
+     */
+    void enable_deferred_cleanup() {
+        lib::lock_guard<lib::mutex> guard(m_cleanup_lock);
+        if (!m_cleanup_enabled) {
+            m_cleanup_enabled = true;
+            m_cleanup_stop = false;
+            m_cleanup_thread.reset(new lib::thread(
+                lib::bind(&endpoint::cleanup_reaper,this)));
+        }
+    }
+
+    /// Stop deferring teardown; pending items are still drained
+    void disable_deferred_cleanup() {
+        lib::shared_ptr<lib::thread> thread;
+        {
+            lib::lock_guard<lib::mutex> guard(m_cleanup_lock);
+            if (!m_cleanup_enabled) {
+                return;
+            }
+            m_cleanup_enabled = false;
+            m_cleanup_stop = true;
+            thread = m_cleanup_thread;
+            m_cleanup_thread.reset();
+            m_cleanup_cond.notify_all();
+        }
+        if (thread) {
+            thread->join();
+        }
+    }
+
+    /// Enable endpoint driven keepalive pings for all connections
+    /**
+     * A single repeating transport timer sweeps the connection registry in
+     * batches: any open connection that has not been pinged for
+     * interval_ms is sent a ping, and a connection whose ping is not
+     * answered within pong_timeout_ms is closed (or handed to the
+     * application's pong_timeout handler when one is set, matching
+     * connection::ping semantics). Liveness is tracked with a per
+     * connection pong counter rather than per connection timer objects,
+     * so enabling keepalive adds no timers beyond the one sweep timer
+     * regardless of connection count.
+     *
+     * Deadlines are measured in sweep ticks, so they are accurate to
+     * tick_ms; a tick of a second or so is appropriate for keepalive
+     * intervals measured in tens of seconds.
+     *
+     * Requires a transport with endpoint timer support (asio).
+     *
+     * @param interval_ms Quiet time before a connection is pinged
+     * @param pong_timeout_ms Time to wait for the pong before giving up
+     * @param tick_ms Sweep granularity
+     */
+    void enable_keepalive(long interval_ms,
+        long pong_timeout_ms = config::timeout_pong, long tick_ms = 1000)
+    {
+        if (tick_ms < 1) {
+            tick_ms = 1;
+        }
+        m_ka_interval_ms = interval_ms;
+        m_ka_pong_timeout_ms = pong_timeout_ms;
+        m_ka_tick_ms = tick_ms;
+        if (!m_ka_enabled) {
+            m_ka_enabled = true;
+            transport_type::set_timer(m_ka_tick_ms,lib::bind(
+                &endpoint::keepalive_tick,this,lib::placeholders::_1));
+        }
+    }
+
+    /// Compact idle connections' memory during keepalive sweeps
+    /**
+     * Piggybacks on the keepalive sweep (enable_keepalive must be
+     * active): a connection with no transport reads for idle_ms is
+     * flagged for compaction, which the connection applies at its next
+     * safe point -- the read completion of the keepalive pong, for a
+     * fully idle peer. Reclaims grown read buffers and scratch
+     * capacity from burst-heavy connections on idle-heavy fleets. Zero
+     * disables.
+     */
+    void enable_idle_compaction(long idle_ms) {
+        m_compact_idle_ms = idle_ms;
+    }
+
+    /// Stop the keepalive sweep
+    /**
+     * Connections already awaiting a pong are no longer checked; nothing
+     * is closed on their behalf.
+     */
+    void disable_keepalive() {
+        m_ka_enabled = false;
+    }
+
+    /// Signature of the drain completion handler
+    typedef lib::function<void()> drain_complete_handler;
+
+    /// Begin winding the endpoint down for a zero-downtime restart
+    /**
+     * Stops accepting new connections (via the transport's
+     * stop_listening), then closes established connections with 1001
+     * going-away in batches of batch_size every batch_interval_ms --
+     * spreading 300k reconnects over minutes instead of a thundering
+     * herd -- and fires on_complete once the connection registry is
+     * empty. A batch_size of zero skips the forced closes: the endpoint
+     * just stops accepting and completes when connections leave on
+     * their own. Progress is observable through get_drain_remaining and
+     * get_connection_count.
+     *
+     * @param batch_size Connections to close per tick (0 = none)
+     * @param batch_interval_ms Milliseconds between ticks
+     * @param on_complete Invoked (from the timer context) when empty
+     */
+    void begin_drain(size_t batch_size, long batch_interval_ms,
+        drain_complete_handler on_complete = drain_complete_handler())
+    {
+        if (m_drain_active) {
+            return;
+        }
+        m_drain_active = true;
+        m_drain_batch = batch_size;
+        m_drain_interval = (batch_interval_ms < 1 ? 1 : batch_interval_ms);
+        m_drain_complete = on_complete;
+        m_drain_initial = get_connection_count();
+
+        lib::error_code ec;
+        transport_type::stop_listening(ec);
+        // already not listening is fine; draining an idle endpoint is
+        // legal
+        drain_tick(lib::error_code());
+    }
+
+    /// Whether a drain is in progress
+    bool is_draining() const {
+        return m_drain_active;
+    }
+
+    /// Connections still tracked since begin_drain, and the start count
+    size_t get_drain_remaining() const {
+        return get_connection_count();
+    }
+    size_t get_drain_initial() const {
+        return m_drain_initial;
+    }
+
+    /// Declared capacity for a warm start; see reserve()
+    struct capacity_profile {
+        capacity_profile()
+          : connections(0), messages_per_connection(4),
+            registry_shards(0) {}
+
+        /// Expected concurrent connections to pre-build
+        size_t connections;
+        /// Message objects to pre-populate per pooled connection
+        size_t messages_per_connection;
+        /// Registry shards to size (0 keeps the current count)
+        size_t registry_shards;
+    };
+
+    /// Pre-build pools for a declared capacity before listen()
+    /**
+     * A cold-started server otherwise grows every pool -- connection
+     * objects, message freelists and their control block caches, read
+     * buffers, timer wheels, registry shards -- during the reconnect
+     * storm that follows a restart, the worst possible moment for
+     * allocator traffic. reserve() takes the declared target and does
+     * that growth up front: the connection pool is filled with
+     * `connections` fully prewarmed objects (requires/implies pooling;
+     * the pool high-water mark is raised to fit), each with its message
+     * caches populated and read buffer sized, the registry is sharded,
+     * and the transport builds its lazily created state (timer wheels).
+     * Call after configuration (pool size, wheel, shards all interact)
+     * and before listen.
+     */
+    void reserve(capacity_profile const & profile) {
+        if (profile.registry_shards > 0) {
+            set_registry_shards(profile.registry_shards);
+        }
+        transport_type::prewarm();
+
+        if (profile.connections == 0) {
+            return;
+        }
+        if (!m_con_pool) {
+            m_con_pool.reset(new con_pool());
+        }
+        if (m_con_pool->hwm < profile.connections) {
+            m_con_pool->hwm = profile.connections;
+        }
+        scoped_lock_type guard(m_con_pool->lock);
+        while (m_con_pool->idle.size() < profile.connections) {
+            connection_type * raw = new connection_type(
+                m_is_server,m_user_agent,m_alog,m_elog,m_rng);
+            raw->prewarm(profile.messages_per_connection);
+            m_con_pool->idle.push_back(raw);
+        }
+    }
+
+    /// Issue a generation-counted fast handle for a connection
+    /**
+     * Fast handles make the per-call handle resolution one relaxed
+     * atomic load and an index compare instead of a weak_ptr::lock's
+     * control block round trip; the fast send/close overloads accept
+     * them. A handle goes stale when its connection leaves the
+     * registry: later calls fail with bad_connection, and a recycled
+     * slot's bumped generation keeps old handles from touching a new
+     * connection.
+     *
+     * Lifetime contract: the slot holds a strong reference until the
+     * connection deregisters (termination), so a fast call racing the
+     * same connection's teardown from another thread has the same
+     * hazard as any cross-thread use of a dying connection -- fail-safe
+     * against slot reuse, not a substitute for the application not
+     * racing teardown. Identical in practice to caching a
+     * connection_ptr per subscriber, minus the refcount traffic.
+     */
+    fast_connection_hdl get_fast_handle(connection_hdl hdl,
+        lib::error_code & ec)
+    {
+        // get_con_from_hdl only sets ec on failure; clear any stale
+        // value the caller's ec carried in
+        ec = lib::error_code();
+        connection_ptr con = get_con_from_hdl(hdl,ec);
+        if (ec) { return fast_connection_hdl(); }
+        return con->get_fast_handle();
+    }
+
+    /// Send via a fast handle; see get_fast_handle
+    void send(fast_connection_hdl hdl, std::string const & payload,
+        frame::opcode::value op, lib::error_code & ec)
+    {
+        connection_type * con = resolve_fast(hdl);
+        if (!con) {
+            ec = error::make_error_code(error::bad_connection);
+            return;
+        }
+        ec = con->send(payload,op);
+    }
+
+    /// Close via a fast handle; see get_fast_handle
+    void close(fast_connection_hdl hdl, close::status::value code,
+        std::string const & reason, lib::error_code & ec)
+    {
+        connection_type * con = resolve_fast(hdl);
+        if (!con) {
+            ec = error::make_error_code(error::bad_connection);
+            return;
+        }
+        con->close(code,reason,ec);
+    }
+
+    /// Aggregate message pool metrics across every tracked connection
+    /**
+     * Sums each live connection's pool snapshot (occupancy and traffic
+     * counters add; high_water takes the maximum single pool) for
+     * capacity planning: hit rates say whether pool sizes earn their
+     * memory, drop counts whether the caps bite. Counters are relaxed
+     * and per connection, so the walk is approximate under load.
+     */
+    message_buffer::pool_metrics aggregate_pool_metrics() {
+        message_buffer::pool_metrics total;
+        for (size_t i = 0; i < m_con_shards.size(); i++) {
+            scoped_lock_type lock(m_con_shards[i]->lock);
+            typename std::set<connection_ptr>::iterator it;
+            for (it = m_con_shards[i]->cons.begin();
+                 it != m_con_shards[i]->cons.end(); ++it)
+            {
+                total += (*it)->get_pool_metrics();
+            }
+        }
+        return total;
+    }
+
+    /// Number of tracked connections across all shards
+    size_t get_connection_count() const {
+        size_t total = 0;
+        for (size_t i = 0; i < m_con_shards.size(); i++) {
+            scoped_lock_type lock(m_con_shards[i]->lock);
+            total += m_con_shards[i]->cons.size();
+        }
+        return total;
+    }
+
+    /// Share a worker pool for asynchronous frame preparation
+    /**
+     * Applied to connections created after this call. See
+     * connection::set_compression_pool.
+     */
+    void set_compression_pool(concurrency::worker_pool::ptr pool) {
+        m_compression_pool = pool;
+    }
+
+    /// Create and share a worker pool with the given number of threads
+    void init_compression_pool(size_t num_threads) {
+        m_compression_pool.reset(
+            new concurrency::worker_pool(num_threads));
+    }
+
     void send(connection_hdl hdl, std::string const & payload, 
         frame::opcode::value op, lib::error_code & ec);
     void send(connection_hdl hdl, std::string const & payload,
         frame::opcode::value op);
+
+#ifdef _WEBSOCKETPP_RVALUE_REFERENCES_
+    /// Move overloads; see connection::send(std::string&&,op)
+    void send(connection_hdl hdl, std::string&& payload,
+        frame::opcode::value op, lib::error_code & ec);
+    void send(connection_hdl hdl, std::string&& payload,
+        frame::opcode::value op);
+#endif
         
     void send(connection_hdl hdl, void const * payload, size_t len,
         frame::opcode::value op, lib::error_code & ec);
@@ -289,6 +1254,74 @@ public:
 
     void send(connection_hdl hdl, message_ptr msg, lib::error_code & ec);
     void send(connection_hdl hdl, message_ptr msg);
+
+    /// Send the latest value for a key, conflating queued predecessors
+    /**
+     * @see connection::send_conflated
+     */
+    void send_conflated(connection_hdl hdl, std::string const & key,
+        std::string const & payload, frame::opcode::value op,
+        lib::error_code & ec);
+    void send_conflated(connection_hdl hdl, std::string const & key,
+        std::string const & payload, frame::opcode::value op);
+
+    /// Send with explicit compression eligibility
+    /**
+     * @see connection::send(payload,op,compress)
+     */
+    void send(connection_hdl hdl, std::string const & payload,
+        frame::opcode::value op, bool compress, lib::error_code & ec);
+    void send(connection_hdl hdl, std::string const & payload,
+        frame::opcode::value op, bool compress);
+
+    /// Prepare a message once for broadcast to many connections
+    /**
+     * Frames the payload through the given connection's protocol processor
+     * and returns the prepared message. Passing the result to send() for
+     * each subscriber enqueues the same message object by pointer, avoiding
+     * per connection framing and payload copies.
+     *
+     * @see connection::prepare_message for caveats regarding compression
+     * and masked (client) connections.
+     */
+    message_ptr prepare_message(connection_hdl hdl,
+        std::string const & payload, frame::opcode::value op,
+        lib::error_code & ec);
+
+    /// Prepare a message through the endpoint's LRU prepared-frame cache
+    /**
+     * For identical small payloads sent repeatedly over time (heartbeat
+     * JSON, subscription acks): the first call frames the payload via
+     * the given connection's processor exactly as prepare_message does,
+     * then caches the prepared message endpoint-wide keyed by opcode and
+     * payload. Later calls return the cached object without re-framing,
+     * from any connection. Least recently used entries are evicted past
+     * the cache capacity (set_prepared_cache_capacity).
+     *
+     * Cached frames are prepared uncompressed, like every shared
+     * prepared message, since a compressed frame would be coupled to one
+     * connection's compression context. The caveats of prepare_message
+     * for masked (client side) connections apply unchanged.
+     *
+     * @param hdl A connection to frame through on a cache miss
+     * @param payload The message payload
+     * @param op The message opcode
+     * @param [out] ec A status code
+     * @return The prepared message, empty on failure
+     */
+    message_ptr prepare_cached(connection_hdl hdl,
+        std::string const & payload, frame::opcode::value op,
+        lib::error_code & ec);
+
+    /// Set the prepared-frame cache capacity (default 64 entries)
+    /**
+     * Shrinking the capacity takes effect as later insertions evict
+     * down to the new bound.
+     */
+    void set_prepared_cache_capacity(size_t capacity) {
+        scoped_lock_type guard(m_mutex);
+        m_prepared_cache_capacity = (capacity < 1 ? 1 : capacity);
+    }
     
     void close(connection_hdl hdl, close::status::value const code, 
         std::string const & reason, lib::error_code & ec);
@@ -373,34 +1406,488 @@ public:
 protected:
     connection_ptr create_connection();
     void remove_connection(connection_ptr con);
+
+    /// The current default handler table (for roles restoring handlers
+    /// on pooled or warm connections)
+    typename connection_type::handler_table::ptr
+    current_handler_table() const {
+        scoped_lock_type guard(m_mutex);
+        return m_handler_table;
+    }
     
     alog_type m_alog;
     elog_type m_elog;
 private:
+    /// Cacheline striped wait-free up/down gauge
+    /**
+     * Increments and decrements land on one of several padded stripes
+     * (picked by caller address bits) so concurrent accepts and
+     * teardowns on different threads do not ping-pong one counter line;
+     * reads sum the stripes and are approximate while writers are
+     * active, which is the accuracy ceilings need.
+     */
+    struct striped_gauge {
+        static size_t const stripes = 8;
+
+        striped_gauge() {
+            for (size_t i = 0; i < stripes; i++) {
+                m_stripe[i].value.store(0,lib::memory_order_relaxed);
+            }
+        }
+
+        void add(void const * who, long delta) {
+            size_t idx = (reinterpret_cast<uintptr_t>(who) >> 6) % stripes;
+            m_stripe[idx].value.fetch_add(delta,lib::memory_order_relaxed);
+        }
+
+        size_t read() const {
+            long total = 0;
+            for (size_t i = 0; i < stripes; i++) {
+                total += m_stripe[i].value.load(lib::memory_order_relaxed);
+            }
+            return (total > 0 ? static_cast<size_t>(total) : 0);
+        }
+
+        struct padded {
+            lib::atomic<long> value;
+            char pad[64-sizeof(lib::atomic<long>)];
+        };
+        padded m_stripe[stripes];
+    };
+
+    /// Shared request line shape check for the built-in pre-screen
+    static bool prescreen_request_line(char const * data, size_t len) {
+        // within a bounded prefix the line must reach " HTTP/1." or be
+        // short enough that it still could
+        size_t const line_cap = 2048;
+        size_t scan = (len < line_cap ? len : line_cap);
+        for (size_t i = 0; i + 8 <= scan; i++) {
+            if (data[i] == '\r' || data[i] == '\n') {
+                return false; // line ended without a version token
+            }
+            if (std::memcmp(data+i," HTTP/1.",8) == 0) {
+                return true;
+            }
+        }
+        // no verdict yet: accept only if the line could still complete
+        return len < line_cap;
+    }
+
+    /// Background reaper: drop deferred connection references off the
+    /// io threads
+    void cleanup_reaper() {
+        // how many passes to wait out transient references before giving
+        // a connection back to whoever still holds it
+        int const max_attempts = 64;
+
+        size_t busy_streak = 0;
+        for (;;) {
+            connection_ptr con;
+            int attempts = 0;
+            {
+                lib::unique_lock<lib::mutex> lock(m_cleanup_lock);
+                while (m_cleanup_queue.empty() && !m_cleanup_stop) {
+                    m_cleanup_cond.wait(lock);
+                }
+                if (m_cleanup_queue.empty()) {
+                    return;
+                }
+                con = m_cleanup_queue.front().first;
+                attempts = m_cleanup_queue.front().second;
+                m_cleanup_queue.pop_front();
+            }
+
+            if (con.use_count() > 1 && !m_cleanup_stop
+                && attempts < max_attempts)
+            {
+                // the terminate handler chain still holds a transient
+                // reference; dropping ours now would make the io thread's
+                // release the last one and pull the destructor back
+                // inline. Requeue and give the handler a moment to unwind.
+                // After max_attempts the holder is not transient (the
+                // application kept the pointer) and destruction correctly
+                // becomes its problem.
+                {
+                    lib::lock_guard<lib::mutex> lock(m_cleanup_lock);
+                    m_cleanup_queue.push_back(
+                        std::make_pair(con,attempts+1));
+                    busy_streak++;
+                    if (busy_streak < m_cleanup_queue.size()) {
+                        continue;
+                    }
+                }
+                busy_streak = 0;
+                con.reset();
+                lib::this_thread::yield();
+                continue;
+            }
+            busy_streak = 0;
+
+            // the last reference dies here, running the destructor or
+            // pooled reset on this thread
+            con.reset();
+        }
+    }
+
+    /// Hand a terminated connection's reference to the reaper
+    /**
+     * Returns whether the reference was taken; false means deferred
+     * cleanup is off and the caller should drop it inline.
+     */
+    bool defer_cleanup(connection_ptr con) {
+        lib::lock_guard<lib::mutex> guard(m_cleanup_lock);
+        if (!m_cleanup_enabled) {
+            return false;
+        }
+        m_cleanup_queue.push_back(std::make_pair(con,0));
+        m_cleanup_cond.notify_one();
+        return true;
+    }
+
+    /// One keepalive sweep: check deadlines, send due pings, re-arm
+    void keepalive_tick(lib::error_code const & ec) {
+        if (ec || !m_ka_enabled) {
+            return;
+        }
+        m_ka_tick++;
+
+        size_t interval_ticks = static_cast<size_t>(
+            m_ka_interval_ms / m_ka_tick_ms);
+        size_t timeout_ticks = static_cast<size_t>(
+            m_ka_pong_timeout_ms / m_ka_tick_ms);
+        if (interval_ticks < 1) { interval_ticks = 1; }
+        if (timeout_ticks < 1) { timeout_ticks = 1; }
+
+        // snapshot the shared handler table under the endpoint lock; the
+        // sweep reads it outside any lock while setters may replace it
+        typename connection_type::handler_table::ptr table;
+        {
+            scoped_lock_type guard(m_mutex);
+            table = m_handler_table;
+        }
+
+        for_each_connection(lib::bind(
+            &endpoint::keepalive_visit,
+            this,
+            lib::placeholders::_1,
+            interval_ticks,
+            timeout_ticks,
+            table
+        ));
+
+        transport_type::set_timer(m_ka_tick_ms,lib::bind(
+            &endpoint::keepalive_tick,this,lib::placeholders::_1));
+    }
+
+    /// One drain tick: close a batch, check for completion, re-arm
+    void drain_tick(lib::error_code const & ec) {
+        if (ec || !m_drain_active) {
+            return;
+        }
+
+        if (get_connection_count() == 0) {
+            m_drain_active = false;
+            if (m_drain_complete) {
+                m_drain_complete();
+            }
+            return;
+        }
+
+        if (m_drain_batch > 0) {
+            size_t closed = 0;
+            for (size_t i = 0;
+                 i < m_con_shards.size() && closed < m_drain_batch; i++)
+            {
+                std::vector<connection_hdl> snapshot;
+                {
+                    scoped_lock_type lock(m_con_shards[i]->lock);
+                    typename std::set<connection_ptr>::iterator it;
+                    for (it = m_con_shards[i]->cons.begin();
+                         it != m_con_shards[i]->cons.end(); ++it)
+                    {
+                        snapshot.push_back((*it)->get_handle());
+                    }
+                }
+                for (size_t j = 0;
+                     j < snapshot.size() && closed < m_drain_batch; j++)
+                {
+                    lib::error_code cec;
+                    connection_ptr con = get_con_from_hdl(snapshot[j],cec);
+                    if (cec
+                        || con->get_state() != session::state::open)
+                    {
+                        // connecting/closing connections will leave the
+                        // registry on their own; count neither
+                        continue;
+                    }
+                    con->close(close::status::going_away,
+                        "server draining",cec);
+                    if (!cec) {
+                        closed++;
+                    }
+                }
+            }
+        }
+
+        transport_type::set_timer(m_drain_interval,lib::bind(
+            &endpoint::drain_tick,this,lib::placeholders::_1));
+    }
+
+    /// Apply keepalive policy to one connection
+    void keepalive_visit(connection_hdl hdl, size_t interval_ticks,
+        size_t timeout_ticks,
+        typename connection_type::handler_table::ptr table)
+    {
+        lib::error_code ec;
+        connection_ptr con = get_con_from_hdl(hdl,ec);
+        if (ec || con->get_state() != session::state::open) {
+            return;
+        }
+
+        typename connection_type::keepalive_state & ks =
+            con->get_keepalive_state();
+
+        // idle compaction: connections with no reads for the configured
+        // span get flagged; the io thread shrinks at its next safe point
+        if (m_compact_idle_ms > 0) {
+            size_t reads = con->get_read_count();
+            if (reads != ks.reads_seen) {
+                ks.reads_seen = reads;
+                ks.idle_ticks = 0;
+                ks.compaction_pending = false;
+            } else if (!ks.compaction_pending) {
+                ks.idle_ticks++;
+                if (static_cast<long>(ks.idle_ticks*m_ka_tick_ms)
+                    >= m_compact_idle_ms)
+                {
+                    ks.compaction_pending = true;
+                    con->request_compaction();
+                }
+            }
+        }
+
+        // application pings routed through the sweep: fire expired pong
+        // timeouts here, for the whole due cohort in one tick, instead
+        // of one timer object per ping
+        if (ks.awaiting_user_pong) {
+            if (con->get_pong_count() != ks.pong_count_at_user_ping) {
+                ks.awaiting_user_pong = false;
+            } else if (lib::steady_ms() >= ks.user_pong_deadline_ms) {
+                ks.awaiting_user_pong = false;
+                if (table->pong_timeout) {
+                    table->pong_timeout(hdl,ks.user_ping_payload);
+                }
+            }
+        }
+
+        if (ks.awaiting_pong) {
+            if (con->get_pong_count() != ks.pong_count_at_ping) {
+                ks.awaiting_pong = false;
+            } else if (m_ka_tick - ks.last_ping_tick >= timeout_ticks) {
+                ks.awaiting_pong = false;
+                if (table->pong_timeout) {
+                    // let the application decide, as connection::ping does
+                    table->pong_timeout(hdl,std::string());
+                } else {
+                    lib::error_code cec;
+                    con->close(close::status::going_away,
+                        "keepalive timeout",cec);
+                }
+                return;
+            }
+        }
+
+        if (!ks.awaiting_pong &&
+            m_ka_tick - ks.last_ping_tick >= interval_ticks)
+        {
+            lib::error_code pec;
+            // stamped ping: the pong fills the connection's RTT stats
+            con->ping_rtt(pec);
+            if (!pec) {
+                ks.last_ping_tick = m_ka_tick;
+                ks.pong_count_at_ping = con->get_pong_count();
+                ks.awaiting_pong = true;
+            }
+        }
+    }
+
     // dynamic settings
     std::string                 m_user_agent;
-    
-    open_handler                m_open_handler;
-    close_handler               m_close_handler;
-    fail_handler                m_fail_handler;
-    ping_handler                m_ping_handler;
-    pong_handler                m_pong_handler;
-    pong_timeout_handler        m_pong_timeout_handler;
-    interrupt_handler           m_interrupt_handler;
-    http_handler                m_http_handler;
-    validate_handler            m_validate_handler;
-    message_handler             m_message_handler;
+
+    /// Replace the handler table with an amended copy and return it
+    /**
+     * Must be called with m_mutex held. Connections created before the
+     * update keep referencing the old table.
+     */
+    typename connection_type::handler_table::ptr update_handler_table() {
+        m_handler_table.reset(new typename connection_type::handler_table(
+            *m_handler_table));
+        return m_handler_table;
+    }
+
+    /// Current default handler table shared with new connections
+    /**
+     * Updated immutably: endpoint setters replace the table with an
+     * amended copy, so connections referencing the previous table are
+     * unaffected.
+     */
+    typename connection_type::handler_table::ptr m_handler_table;
     
     rng_type m_rng;
-    
+
+    /// Default adaptive read buffer cap applied to new connections
+    size_t m_max_read_buffer_size;
+    size_t m_max_outgoing_frame_size;
+    size_t m_read_budget_frames;
+    uint64_t m_read_budget_us;
+    double m_rl_msg_rate;
+    double m_rl_byte_rate;
+    rate_limit::policy m_rl_policy;
+    rate_limit::striped_bucket::ptr m_rl_agg_msgs;
+    rate_limit::striped_bucket::ptr m_rl_agg_bytes;
+    bool m_borrowed_messages;
+    processor::validation_policy::value m_validation_policy;
+    bool m_raw_continuations_default;
+    std::string m_compression_dictionary;
+    size_t m_compress_reset_msgs;
+    size_t m_compress_reset_bytes;
+    extensions::permessage_deflate::level_controller::ptr
+        m_level_controller;
+    typename connection_type::subprotocol_table_ptr m_subprotocols;
+    typename connection_type::prescreen_handler m_prescreen;
+    /// Live connection gauge; see current_connections
+    striped_gauge m_connection_gauge;
+    /// Simultaneous connection ceiling; 0 means unlimited
+    size_t m_max_connections;
+    /// Concurrent handshake ceiling; 0 means unlimited
+    size_t m_max_handshakes;
+    /// Fast handle slot table; see get_fast_handle
+    std::vector<lib::shared_ptr<fast_slot> > m_fast_slots;
+    std::vector<uint32_t> m_fast_free;
+    lib::mutex m_fast_slot_lock;
+
+    /// Emergency load shedding switch; see set_load_shedding
+    lib::atomic<bool> m_load_shedding;
+    /// Pre-serialized shed response (static per endpoint lifetime)
+    std::string m_shed_response;
+    typename connection_type::handshake_gauge_ptr m_handshake_gauge;
+
+    /// Drain mode state; see begin_drain
+    bool m_drain_active;
+    size_t m_drain_batch;
+    long m_drain_interval;
+    size_t m_drain_initial;
+    drain_complete_handler m_drain_complete;
+
+    /// Worker pool shared with new connections for async preparation
+    concurrency::worker_pool::ptr m_compression_pool;
+
+    /// Shared instrumentation totals for all connections of this endpoint
+    typename connection_type::stats_ptr m_stats;
+
+    /// Shared 101 response template cache (server endpoints)
+    typename connection_type::handshake_template_cache::ptr
+        m_handshake_templates;
+
+    /// Shared prepared close frames (server endpoints)
+    typename connection_type::close_frame_cache::ptr m_close_frames;
+
+    /// Shared upgrade request templates (client endpoints)
+    typename connection_type::client_template_cache::ptr
+        m_client_templates;
+
+    /// LRU cache of shared prepared frames (see prepare_cached)
+    struct prepared_frame_entry {
+        message_ptr msg;
+        std::list<std::string>::iterator lru_pos;
+    };
+    std::map<std::string,prepared_frame_entry> m_prepared_frames;
+    std::list<std::string> m_prepared_lru;
+    size_t m_prepared_cache_capacity;
+
     // endpoint resources
-    std::set<connection_ptr>    m_connections;
+
+    /// One lock-sharded slice of the connection registry
+    struct con_shard {
+        mutable mutex_type lock;
+        std::set<connection_ptr> cons;
+    };
+
+    /// Sharded registry of connections from creation to termination
+    std::vector<lib::shared_ptr<con_shard> > m_con_shards;
+
+    /// Deferred teardown state; see enable_deferred_cleanup
+    bool m_cleanup_enabled;
+    bool m_cleanup_stop;
+    mutable lib::mutex m_cleanup_lock;
+    lib::condition_variable m_cleanup_cond;
+    lib::shared_ptr<lib::thread> m_cleanup_thread;
+    std::list<std::pair<connection_ptr,int> > m_cleanup_queue;
+
+    /// Keepalive sweep state; see enable_keepalive
+    bool m_ka_enabled;
+    long m_ka_interval_ms;
+    long m_ka_pong_timeout_ms;
+    long m_ka_tick_ms;
+    size_t m_ka_tick;
+    /// Idle compaction threshold in ms; 0 disabled
+    long m_compact_idle_ms;
+
+    /// Pool of idle connection objects for recycling across sessions
+    /**
+     * Held by shared_ptr so the recycling deleter of outstanding
+     * connections stays valid even if the endpoint is destroyed first;
+     * the pool deletes its contents when the last reference drops.
+     */
+    struct con_pool {
+        con_pool() : hwm(0) {}
+        ~con_pool() {
+            for (size_t i = 0; i < idle.size(); i++) {
+                delete idle[i];
+            }
+        }
+
+        mutex_type lock;
+        std::vector<connection_type *> idle;
+        size_t hwm;
+    };
+    typedef lib::shared_ptr<con_pool> con_pool_ptr;
+
+    /// Deleter that returns terminated connections to the pool
+    /**
+     * Holds the pool weakly: a strong reference would cycle through the
+     * recycled connection's own enable_shared_from_this bookkeeping (the
+     * deleter object lives in the control block until the weak count
+     * drops, and the pooled connection holds that weak reference). If the
+     * pool is already gone the connection is simply destroyed.
+     */
+    struct con_recycler {
+        explicit con_recycler(con_pool_ptr p) : pool(p) {}
+
+        void operator()(connection_type * con) const {
+            con_pool_ptr p = pool.lock();
+            if (p) {
+                scoped_lock_type guard(p->lock);
+                if (p->idle.size() < p->hwm) {
+                    p->idle.push_back(con);
+                    return;
+                }
+            }
+            delete con;
+        }
+
+        lib::weak_ptr<con_pool> pool;
+    };
+
+    con_pool_ptr m_con_pool;
     
     // static settings
     bool const                  m_is_server;
     
     // endpoint state
-    mutex_type                  m_mutex;
+    // mutable: const accessors (get_user_agent, current_handler_table)
+    // lock it
+    mutable mutex_type          m_mutex;
 };
 
 } // namespace websocketpp
@@ -114,7 +114,14 @@ enum value {
     close_handshake_timeout,
 
     /// Invalid port in URI
-    invalid_port
+    invalid_port,
+
+    /// Connection shed by the handshake pre-screen filter
+    rejected,
+
+    /// HTTP handshake parsing failed; details carried by the parser's
+    /// get_parse_error_status/get_parse_error_msg
+    http_parse_error
 }; // enum value
 
 
@@ -176,6 +183,10 @@ public:
                 return "The closing handshake timed out";
             case error::invalid_port:
                 return "Invalid URI port";
+            case error::rejected:
+                return "Connection rejected by the handshake pre-screen";
+            case error::http_parse_error:
+                return "HTTP handshake parse error";
             default:
                 return "Unknown";
         }
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_EXTENSIONS_CHAIN_HPP
+#define WEBSOCKETPP_EXTENSIONS_CHAIN_HPP
+
+#include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/extensions/permessage_deflate/controller.hpp>
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+#include <websocketpp/error.hpp>
+#include <websocketpp/http/constants.hpp>
+#include <websocketpp/utf8_validator.hpp>
+
+#include <string>
+
+namespace websocketpp {
+namespace extensions {
+
+/// Statically composed chain of per-message extensions
+/**
+ * Composes two extension stages into one object that itself models the
+ * per-message extension interface the hybi13 processor consumes
+ * (`is_implemented`, `is_enabled`, `negotiate_token`, `should_compress`,
+ * `compress`, `decompress`, `set_dictionary`). Chains nest to arbitrary
+ * length:
+ *
+ * \code
+ * typedef extensions::chain<
+ *     my_delta_encoding<config>,
+ *     extensions::permessage_deflate::enabled<config>
+ * > permessage_deflate_type;
+ * \endcode
+ *
+ * Stage order is wire order for outbound transformation: `first` runs
+ * before `rest` on compress, and the fold reverses on decompress. Each
+ * stage negotiates independently under its own extension token via
+ * `negotiate_token`; offers whose token no stage claims are ignored, and
+ * accepted responses are joined with commas per RFC 6455 section 9.1.
+ *
+ * All composed stages share the frame's RSV1 bit, so a chain is limited
+ * to extensions in the per-message-transform family (like
+ * permessage-deflate itself). The single-extension common case should
+ * use the extension type directly rather than a one-element chain; every
+ * chain method is a pair of inlineable forwards, so the composed fast
+ * path costs nothing beyond the stages themselves.
+ */
+template <typename first_type, typename rest_type>
+class chain {
+public:
+    chain() {}
+
+    /// Chain is implemented if any stage is
+    bool is_implemented() const {
+        return m_first.is_implemented() || m_rest.is_implemented();
+    }
+
+    /// Chain is enabled if any stage negotiated successfully
+    bool is_enabled() const {
+        return m_first.is_enabled() || m_rest.is_enabled();
+    }
+
+    /// Negotiate the stage registered under the given extension token
+    /**
+     * Dispatches the offer to the first stage claiming `name`. Returns
+     * extensions::error::unknown_token when no stage claims it, which
+     * the processor treats as "not ours, skip" rather than a failure.
+     *
+     * @param name The extension token from Sec-WebSocket-Extensions
+     * @param offer The attributes attached to that token
+     * @return An error code and the negotiated response on success
+     */
+    err_str_pair negotiate_token(std::string const & name,
+        http::attribute_list const & offer)
+    {
+        err_str_pair ret = m_first.negotiate_token(name,offer);
+        if (ret.first == error::make_error_code(error::unknown_token)) {
+            ret = m_rest.negotiate_token(name,offer);
+        }
+        return ret;
+    }
+
+    /// Whether any enabled stage wants to transform this payload
+    bool should_compress(std::string const & payload) const {
+        return (m_first.is_enabled() && m_first.should_compress(payload))
+            || (m_rest.is_enabled() && m_rest.should_compress(payload));
+    }
+
+    /// Transform outbound payload through each enabled stage in order
+    lib::error_code compress(std::string const & in, std::string & out) {
+        if (!m_first.is_enabled()) {
+            return m_rest.compress(in,out);
+        }
+        if (!m_rest.is_enabled()) {
+            return m_first.compress(in,out);
+        }
+        std::string mid;
+        lib::error_code ec = m_first.compress(in,mid);
+        if (ec) {
+            return ec;
+        }
+        return m_rest.compress(mid,out);
+    }
+
+    /// Reverse the outbound transform: later stages decode first
+    lib::error_code decompress(uint8_t const * buf, size_t len,
+        std::string & out)
+    {
+        if (!m_rest.is_enabled()) {
+            return m_first.decompress(buf,len,out);
+        }
+        if (!m_first.is_enabled()) {
+            return m_rest.decompress(buf,len,out);
+        }
+        std::string mid;
+        lib::error_code ec = m_rest.decompress(buf,len,mid);
+        if (ec) {
+            return ec;
+        }
+        return m_first.decompress(
+            reinterpret_cast<uint8_t const *>(mid.data()),mid.size(),out);
+    }
+
+    /// Decompress with fused UTF-8 validation on the final stage
+    /**
+     * Mirrors the single-extension fused path: the stage producing the
+     * final plaintext validates chunks while they are cache-hot. When
+     * both stages are enabled the intermediate decode cannot be
+     * validated (it is not yet text), so only the last decode fuses.
+     */
+    lib::error_code decompress_validated(uint8_t const * buf, size_t len,
+        std::string & out, utf8_validator::validator & validator)
+    {
+        if (!m_rest.is_enabled()) {
+            return m_first.decompress_validated(buf,len,out,validator);
+        }
+        if (!m_first.is_enabled()) {
+            return m_rest.decompress_validated(buf,len,out,validator);
+        }
+        std::string mid;
+        lib::error_code ec = m_rest.decompress(buf,len,mid);
+        if (ec) {
+            return ec;
+        }
+        return m_first.decompress_validated(
+            reinterpret_cast<uint8_t const *>(mid.data()),mid.size(),
+            out,validator);
+    }
+
+    /// Signal inbound message completion to every enabled stage
+    /**
+     * Decode order (later stage first), matching decompress; stage
+     * completion output is defined to be empty, so no re-chaining of
+     * bytes is required.
+     */
+    lib::error_code finish_decompress(std::string & out) {
+        if (m_rest.is_enabled()) {
+            lib::error_code ec = m_rest.finish_decompress(out);
+            if (ec) {
+                return ec;
+            }
+        }
+        if (m_first.is_enabled()) {
+            return m_first.finish_decompress(out);
+        }
+        return lib::error_code();
+    }
+
+    /// Forward the shared compression dictionary to every stage
+    void set_dictionary(std::string const & dict) {
+        m_first.set_dictionary(dict);
+        m_rest.set_dictionary(dict);
+    }
+
+    /// Forward the write-side reset interval to every stage
+    void set_write_reset_interval(size_t messages, size_t bytes) {
+        m_first.set_write_reset_interval(messages,bytes);
+        m_rest.set_write_reset_interval(messages,bytes);
+    }
+
+    /// Forward the adaptive level controller to every stage
+    void set_level_controller(
+        permessage_deflate::level_controller::ptr controller)
+    {
+        m_first.set_level_controller(controller);
+        m_rest.set_level_controller(controller);
+    }
+
+    /// Access a stage by index for chain-aware tuning (0 is `first`)
+    first_type & first() {
+        return m_first;
+    }
+    rest_type & rest() {
+        return m_rest;
+    }
+
+private:
+    first_type m_first;
+    rest_type m_rest;
+};
+
+} // namespace extensions
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_EXTENSIONS_CHAIN_HPP
@@ -55,7 +55,12 @@ enum value {
     general = 1,
 
     /// Extension disabled
-    disabled
+    disabled,
+
+    /// Offered extension token is not handled by this extension object.
+    /// Returned from negotiate_token so chains and the processor can
+    /// distinguish "not ours" from a failed negotiation.
+    unknown_token
 };
 
 class category : public lib::error_category {
@@ -72,6 +77,8 @@ public:
                 return "Generic extension error";
             case disabled:
                 return "Use of methods from disabled extension";
+            case unknown_token:
+                return "Extension token not handled by this extension";
             default:
                 return "Unknown permessage-compress error";
         }
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_BUDGET_HPP
+#define WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_BUDGET_HPP
+
+#include <websocketpp/common/thread.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace extensions {
+namespace permessage_deflate {
+
+/// Process wide compression memory budget
+/**
+ * Tracks the estimated aggregate zlib allocation of negotiated
+ * permessage-deflate connections. While the budget fills, new
+ * negotiations degrade gracefully: first the offered s2c window shrinks
+ * step by step, then compression is refused outright (the connection
+ * proceeds uncompressed), converting out-of-memory risk into a
+ * compression/throughput tradeoff. The default limit of zero means
+ * unlimited. Usage is charged at negotiation and released when the
+ * extension instance is destroyed.
+ */
+class memory_budget {
+public:
+    /// Get the process wide budget instance
+    static memory_budget & instance() {
+        static memory_budget budget;
+        return budget;
+    }
+
+    /// Set the aggregate budget in bytes (0 = unlimited)
+    void set_limit(size_t bytes) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_limit = bytes;
+    }
+
+    size_t get_limit() {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_limit;
+    }
+
+    /// Current estimated aggregate zlib allocation in bytes
+    size_t get_usage() {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_usage;
+    }
+
+    /// Try to reserve bytes against the budget
+    bool reserve(size_t bytes) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        if (m_limit != 0 && m_usage+bytes > m_limit) {
+            return false;
+        }
+        m_usage += bytes;
+        return true;
+    }
+
+    /// Return previously reserved bytes
+    void release(size_t bytes) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_usage -= (bytes < m_usage ? bytes : m_usage);
+    }
+
+    /// Estimated zlib cost of a connection with the given window bits
+    /**
+     * deflate: (1 << (windowBits+2)) + (1 << (memLevel+9)); inflate:
+     * 1 << windowBits; plus the shared frame buffer. Directions using
+     * pooled contexts (no_context_takeover) are not charged.
+     */
+    static size_t estimate(uint8_t deflate_bits, uint8_t mem_level,
+        bool deflate_pooled, uint8_t inflate_bits, bool inflate_pooled)
+    {
+        size_t cost = 16384; // compress buffer
+        if (!deflate_pooled) {
+            cost += (size_t(1) << (deflate_bits+2)) +
+                    (size_t(1) << (mem_level+9));
+        }
+        if (!inflate_pooled) {
+            cost += (size_t(1) << inflate_bits);
+        }
+        return cost;
+    }
+
+private:
+    memory_budget() : m_limit(0), m_usage(0) {}
+
+    lib::mutex m_lock;
+    size_t m_limit;
+    size_t m_usage;
+};
+
+
+} // namespace permessage_deflate
+} // namespace extensions
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_BUDGET_HPP
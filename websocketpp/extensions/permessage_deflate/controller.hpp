@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_PROCESSOR_EXTENSION_PERMESSAGEDEFLATE_CONTROLLER_HPP
+#define WEBSOCKETPP_PROCESSOR_EXTENSION_PERMESSAGEDEFLATE_CONTROLLER_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/time.hpp>
+
+namespace websocketpp {
+namespace extensions {
+namespace permessage_deflate {
+
+/// Adaptive compression level controller
+/**
+ * Shared by every connection of an endpoint: each compressed message
+ * reports its deflate time, and once per window the controller compares
+ * the compression duty cycle against the configured CPU budget, moving
+ * the target zlib level one step down when compression is eating more
+ * than the budget (storm days: fall toward level 1) and one step up
+ * when it uses less than half of it (quiet nights: spend the idle CPU
+ * on egress savings). Connections apply the target lazily via
+ * deflateParams before their next message, so the fleet converges in
+ * increments without synchronization beyond relaxed atomics.
+ */
+struct level_controller {
+    typedef lib::shared_ptr<level_controller> ptr;
+
+    /// @param budget_fraction Compression duty cycle target (0..1),
+    /// e.g. 0.05 to spend at most 5% of wall time deflating
+    /// @param initial_level Starting zlib level
+    explicit level_controller(double budget_fraction,
+        int initial_level = 6)
+      : m_budget(budget_fraction)
+      , m_level(initial_level)
+      , m_busy_us(0)
+      , m_window_start_us(lib::steady_us())
+    {}
+
+    /// Report one message's compression time and adjust on window end
+    void record(uint64_t busy_us) {
+        m_busy_us.fetch_add(busy_us,lib::memory_order_relaxed);
+
+        uint64_t start = m_window_start_us.load(lib::memory_order_relaxed);
+        uint64_t now = lib::steady_us();
+        if (now-start < window_us) {
+            return;
+        }
+        // one recorder wins the window close; the rest keep accumulating
+        if (!m_window_start_us.compare_exchange_strong(start,now)) {
+            return;
+        }
+        uint64_t busy = m_busy_us.exchange(0,lib::memory_order_relaxed);
+        double duty = static_cast<double>(busy)
+            /static_cast<double>(now-start);
+
+        int level = m_level.load(lib::memory_order_relaxed);
+        if (duty > m_budget && level > 1) {
+            m_level.store(level-1,lib::memory_order_relaxed);
+        } else if (duty < m_budget*0.5 && level < 9) {
+            m_level.store(level+1,lib::memory_order_relaxed);
+        }
+    }
+
+    /// The level connections should currently compress at
+    int level() const {
+        return m_level.load(lib::memory_order_relaxed);
+    }
+
+    /// Adjustment window length
+    static uint64_t const window_us = 1000000;
+
+    double m_budget;
+    lib::atomic<int> m_level;
+    lib::atomic<uint64_t> m_busy_us;
+    lib::atomic<uint64_t> m_window_start_us;
+};
+
+} // namespace permessage_deflate
+} // namespace extensions
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_PROCESSOR_EXTENSION_PERMESSAGEDEFLATE_CONTROLLER_HPP
@@ -29,10 +29,12 @@
 #define WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_DISABLED_HPP
 
 #include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/utf8_validator.hpp>
 #include <websocketpp/common/system_error.hpp>
 
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/extensions/permessage_deflate/controller.hpp>
 
 #include <map>
 #include <string>
@@ -53,10 +55,27 @@ class disabled {
     typedef std::pair<lib::error_code,std::string> err_str_pair;
 
 public:
+    /// Stub negotiate_token; claims no extension token at all
+    err_str_pair negotiate_token(std::string const &,
+        http::attribute_list const &)
+    {
+        return err_str_pair(
+            extensions::error::make_error_code(
+                extensions::error::unknown_token),std::string());
+    }
+
     err_str_pair negotiate(http::attribute_list const & attributes) {
         return make_pair(make_error_code(error::disabled),std::string());
     }
     
+    /// Compression heuristics stubs (never consulted; the extension is
+    /// disabled)
+    void set_min_compress_size(size_t) {}
+    void set_compression_sampling(bool) {}
+    bool should_compress(std::string const &) const {
+        return false;
+    }
+
     /// Returns true if the extension is capable of providing 
     /// permessage_deflate functionality
     bool is_implemented() const {
@@ -79,6 +98,21 @@ public:
         return make_error_code(error::disabled);
     }
 
+    /// Stub; interface parity with the enabled extension
+    void set_dictionary(std::string const &) {}
+    void set_write_reset_interval(size_t, size_t) {}
+    void set_level_controller(level_controller::ptr) {}
+    lib::error_code finish_decompress(std::string &) {
+        return make_error_code(error::disabled);
+    }
+
+    /// Stub; interface parity with the enabled extension
+    lib::error_code decompress_validated(uint8_t const *, size_t,
+        std::string &, websocketpp::utf8_validator::validator &)
+    {
+        return make_error_code(error::disabled);
+    }
+
     lib::error_code decompress(std::string const & in, std::string & out) {
         return make_error_code(error::disabled);
     }
@@ -34,9 +34,18 @@
 #include <websocketpp/error.hpp>
 
 #include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/common/time.hpp>
+#include <websocketpp/extensions/permessage_deflate/controller.hpp>
+#include <websocketpp/utf8_validator.hpp>
+#include <websocketpp/extensions/permessage_deflate/budget.hpp>
 
 #include "zlib.h"
 
+#include <websocketpp/common/thread.hpp>
+
+#include <cstring>
+#include <map>
+
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -106,6 +115,12 @@ enum value {
 
     /// Uninitialized
     uninitialized,
+
+    /// The endpoint's compression memory budget is exhausted
+    memory_budget_exceeded,
+
+    /// Decompressed text failed UTF-8 validation mid-stream
+    invalid_utf8,
 };
 
 /// Permessage-deflate error category
@@ -135,6 +150,10 @@ public:
                 return "A zlib function returned an error";
             case uninitialized:
                 return "Object must be initialized before use";
+            case memory_budget_exceeded:
+                return "Compression memory budget exhausted";
+            case invalid_utf8:
+                return "Invalid UTF-8 in decompressed text";
             default:
                 return "Unknown permessage-compress error";
         }
@@ -195,18 +214,260 @@ enum value {
 };
 } // namespace mode 
 
-template <typename config>
+/// Codec backend policy wrapping stock zlib
+/**
+ * The extension performs all deflate work through a backend policy so
+ * configs can substitute a faster codec without patching this header. A
+ * backend supplies a zlib-shaped stream_type (next_in/avail_in/next_out/
+ * avail_out fields) plus the init/run/reset/end entry points below;
+ * streaming semantics (Z_SYNC_FLUSH per call, raw windows) must match
+ * zlib's. Select one via the extension's second template parameter:
+ *
+ * \code
+ * typedef websocketpp::extensions::permessage_deflate::enabled<
+ *     config, websocketpp::extensions::permessage_deflate::zlibng_backend>
+ *     permessage_deflate_type;
+ * \endcode
+ */
+struct zlib_backend {
+    typedef z_stream stream_type;
+
+    static int deflate_init(stream_type * s, int window_bits,
+        int mem_level)
+    {
+        return deflateInit2(s,Z_DEFAULT_COMPRESSION,Z_DEFLATED,
+            -1*window_bits,mem_level,Z_FIXED);
+    }
+    static int deflate_run(stream_type * s, int flush) {
+        return deflate(s,flush);
+    }
+    static int deflate_reset(stream_type * s) {
+        return deflateReset(s);
+    }
+    static int deflate_end(stream_type * s) {
+        return deflateEnd(s);
+    }
+    static int inflate_init(stream_type * s, int window_bits) {
+        return inflateInit2(s,-1*window_bits);
+    }
+    static int inflate_run(stream_type * s, int flush) {
+        return inflate(s,flush);
+    }
+    static int inflate_reset(stream_type * s) {
+        return inflateReset(s);
+    }
+    static int inflate_end(stream_type * s) {
+        return inflateEnd(s);
+    }
+    static int deflate_set_dictionary(stream_type * s,
+        unsigned char const * dict, unsigned int len)
+    {
+        return deflateSetDictionary(s,dict,len);
+    }
+
+    /// Change the stream's compression level between messages
+    static int deflate_params(stream_type * s, int level) {
+        return deflateParams(s,level,Z_DEFAULT_STRATEGY);
+    }
+    static int inflate_set_dictionary(stream_type * s,
+        unsigned char const * dict, unsigned int len)
+    {
+        return inflateSetDictionary(s,dict,len);
+    }
+};
+
+#ifdef WEBSOCKETPP_PERMESSAGE_DEFLATE_ZLIBNG
+/// Codec backend using zlib-ng's native API
+/**
+ * zlib-ng's vectorized longest-match makes deflate considerably faster on
+ * typical payloads. Only available when the build defines
+ * WEBSOCKETPP_PERMESSAGE_DEFLATE_ZLIBNG and provides <zlib-ng.h>;
+ * zlib-ng's zlib compat mode needs no backend at all.
+ */
+struct zlibng_backend {
+    typedef zng_stream stream_type;
+
+    static int deflate_init(stream_type * s, int window_bits,
+        int mem_level)
+    {
+        return zng_deflateInit2(s,Z_DEFAULT_COMPRESSION,Z_DEFLATED,
+            -1*window_bits,mem_level,Z_FIXED);
+    }
+    static int deflate_run(stream_type * s, int flush) {
+        return zng_deflate(s,flush);
+    }
+    static int deflate_reset(stream_type * s) {
+        return zng_deflateReset(s);
+    }
+    static int deflate_end(stream_type * s) {
+        return zng_deflateEnd(s);
+    }
+    static int inflate_init(stream_type * s, int window_bits) {
+        return zng_inflateInit2(s,-1*window_bits);
+    }
+    static int inflate_run(stream_type * s, int flush) {
+        return zng_inflate(s,flush);
+    }
+    static int inflate_reset(stream_type * s) {
+        return zng_inflateReset(s);
+    }
+    static int inflate_end(stream_type * s) {
+        return zng_inflateEnd(s);
+    }
+    static int deflate_set_dictionary(stream_type * s,
+        unsigned char const * dict, unsigned int len)
+    {
+        return zng_deflateSetDictionary(s,dict,len);
+    }
+
+    /// Change the stream's compression level between messages
+    static int deflate_params(stream_type * s, int level) {
+        return zng_deflateParams(s,level,Z_DEFAULT_STRATEGY);
+    }
+    static int inflate_set_dictionary(stream_type * s,
+        unsigned char const * dict, unsigned int len)
+    {
+        return zng_inflateSetDictionary(s,dict,len);
+    }
+};
+#endif // WEBSOCKETPP_PERMESSAGE_DEFLATE_ZLIBNG
+
+/// Process wide pool of reusable zlib contexts
+/**
+ * With no_context_takeover negotiated the compression state is reset
+ * between messages anyway, so connections need not pin zlib's sizable
+ * per-stream allocation for their whole lifetime: they check a context out
+ * of this pool per message and return it reset. Contexts are segregated by
+ * window bits; the pool caps how many idle contexts it retains per size.
+ */
+template <typename backend>
+class zlib_context_pool {
+public:
+    typedef typename backend::stream_type stream_type;
+
+    static size_t const max_idle_per_bits = 16;
+
+    /// Get the process wide pool instance (one per backend)
+    static zlib_context_pool & instance() {
+        static zlib_context_pool pool;
+        return pool;
+    }
+
+    /// Check out a raw-deflate context for the given window bits
+    stream_type * acquire_deflate(int window_bits) {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            std::vector<stream_type *> & idle = m_deflate[window_bits];
+            if (!idle.empty()) {
+                stream_type * zs = idle.back();
+                idle.pop_back();
+                return zs;
+            }
+        }
+        stream_type * zs = new stream_type();
+        std::memset(zs,0,sizeof(stream_type));
+        if (backend::deflate_init(zs,window_bits,8) != Z_OK) {
+            delete zs;
+            return NULL;
+        }
+        return zs;
+    }
+
+    /// Return a deflate context; it must already have been deflateReset
+    void release_deflate(int window_bits, stream_type * zs) {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            std::vector<stream_type *> & idle = m_deflate[window_bits];
+            if (idle.size() < max_idle_per_bits) {
+                idle.push_back(zs);
+                return;
+            }
+        }
+        backend::deflate_end(zs);
+        delete zs;
+    }
+
+    /// Check out a raw-inflate context for the given window bits
+    stream_type * acquire_inflate(int window_bits) {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            std::vector<stream_type *> & idle = m_inflate[window_bits];
+            if (!idle.empty()) {
+                stream_type * zs = idle.back();
+                idle.pop_back();
+                return zs;
+            }
+        }
+        stream_type * zs = new stream_type();
+        std::memset(zs,0,sizeof(stream_type));
+        if (backend::inflate_init(zs,window_bits) != Z_OK) {
+            delete zs;
+            return NULL;
+        }
+        return zs;
+    }
+
+    /// Return an inflate context; it must already have been inflateReset
+    void release_inflate(int window_bits, stream_type * zs) {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            std::vector<stream_type *> & idle = m_inflate[window_bits];
+            if (idle.size() < max_idle_per_bits) {
+                idle.push_back(zs);
+                return;
+            }
+        }
+        backend::inflate_end(zs);
+        delete zs;
+    }
+
+    ~zlib_context_pool() {
+        typename std::map<int,std::vector<stream_type *> >::iterator it;
+        for (it = m_deflate.begin(); it != m_deflate.end(); ++it) {
+            for (size_t i = 0; i < it->second.size(); i++) {
+                backend::deflate_end(it->second[i]);
+                delete it->second[i];
+            }
+        }
+        for (it = m_inflate.begin(); it != m_inflate.end(); ++it) {
+            for (size_t i = 0; i < it->second.size(); i++) {
+                backend::inflate_end(it->second[i]);
+                delete it->second[i];
+            }
+        }
+    }
+
+private:
+    zlib_context_pool() {}
+
+    lib::mutex m_lock;
+    std::map<int,std::vector<stream_type *> > m_deflate;
+    std::map<int,std::vector<stream_type *> > m_inflate;
+};
+
+template <typename config, typename backend = zlib_backend>
 class enabled {
 public:
     enabled() 
       : m_enabled(false)
       , m_s2c_no_context_takeover(false)
+      , m_applied_level(Z_DEFAULT_COMPRESSION)
+      , m_write_reset_msgs(0)
+      , m_write_reset_bytes(0)
+      , m_msgs_since_reset(0)
+      , m_bytes_since_reset(0)
       , m_c2s_no_context_takeover(false)
       , m_s2c_max_window_bits(15)
       , m_c2s_max_window_bits(15)
       , m_s2c_max_window_bits_mode(mode::accept)
       , m_c2s_max_window_bits_mode(mode::accept)
       , m_initialized(false)
+      , m_deflate_pooled(false)
+      , m_inflate_pooled(false)
+      , m_budget_charged(0)
+      , m_mem_level(8)
+      , m_min_compress_size(64)
+      , m_entropy_sampling(true)
       , m_compress_buffer_size(16384)
     {
         m_dstate.zalloc = Z_NULL;
@@ -221,22 +482,30 @@ public:
     }
     
     ~enabled() {
+        if (m_budget_charged > 0) {
+            memory_budget::instance().release(m_budget_charged);
+        }
+
         if (!m_initialized) {
             return;
         }
 
-        int ret = deflateEnd(&m_dstate);
+        if (!m_deflate_pooled) {
+            int ret = backend::deflate_end(&m_dstate);
 
-        if (ret != Z_OK) {
-            //std::cout << "error cleaning up zlib compression state" 
-            //          << std::endl;
+            if (ret != Z_OK) {
+                //std::cout << "error cleaning up zlib compression state" 
+                //          << std::endl;
+            }
         }
 
-        ret = inflateEnd(&m_istate);
+        if (!m_inflate_pooled) {
+            int ret = backend::inflate_end(&m_istate);
 
-        if (ret != Z_OK) {
-            //std::cout << "error cleaning up zlib decompression state" 
-            //          << std::endl;
+            if (ret != Z_OK) {
+                //std::cout << "error cleaning up zlib decompression state" 
+                //          << std::endl;
+            }
         }
     }
     
@@ -247,6 +516,10 @@ public:
      * @todo server detection is hardcoded
      */
     lib::error_code init() {
+        if (m_initialized) {
+            return lib::error_code();
+        }
+
         uint8_t deflate_bits;
         uint8_t inflate_bits;
 
@@ -258,26 +531,30 @@ public:
             inflate_bits = m_s2c_max_window_bits;
         }
 
-        int ret = deflateInit2(
-            &m_dstate,
-            Z_DEFAULT_COMPRESSION,
-            Z_DEFLATED,
-            -1*deflate_bits,
-            8, // memory level 1-9
-            /*Z_DEFAULT_STRATEGY*/Z_FIXED
-        );
+        // directions negotiated with no_context_takeover reset their state
+        // between messages, so they borrow a pooled context per message
+        // rather than holding zlib's allocation per connection
+        m_deflate_pooled = m_s2c_no_context_takeover;
+        m_inflate_pooled = m_c2s_no_context_takeover;
+
+        if (!m_deflate_pooled) {
+            // memory level 1-9; lowered under budget pressure
+            int ret = backend::deflate_init(&m_dstate,deflate_bits,
+                m_mem_level);
 
-        if (ret != Z_OK) {
-            return make_error_code(error::zlib_error);
+            if (ret != Z_OK) {
+                return make_error_code(error::zlib_error);
+            }
+            prime_deflate(&m_dstate);
         }
 
-        ret = inflateInit2(
-            &m_istate,
-            -1*inflate_bits
-        );
+        if (!m_inflate_pooled) {
+            int ret = backend::inflate_init(&m_istate,inflate_bits);
 
-        if (ret != Z_OK) {
-            return make_error_code(error::zlib_error);
+            if (ret != Z_OK) {
+                return make_error_code(error::zlib_error);
+            }
+            prime_inflate(&m_istate);
         }
         
         m_compress_buffer.reset(new unsigned char[m_compress_buffer_size]);
@@ -285,6 +562,63 @@ public:
         return lib::error_code();
     }
 
+    /// Set the minimum payload size worth compressing
+    /**
+     * Payloads below this size skip compression entirely (their frames are
+     * sent with RSV1 clear); tiny messages pay deflate's fixed cost for
+     * little or negative gain. Default 64 bytes.
+     */
+    void set_min_compress_size(size_t bytes) {
+        m_min_compress_size = bytes;
+    }
+
+    /// Enable or disable incompressibility sampling
+    /**
+     * When enabled (the default), a small evenly spaced sample of the
+     * payload is checked for byte diversity; payloads that look already
+     * compressed or encrypted are sent uncompressed rather than growing
+     * through deflate.
+     */
+    void set_compression_sampling(bool value) {
+        m_entropy_sampling = value;
+    }
+
+    /// Decide whether compressing the given payload is worthwhile
+    /**
+     * Applies the minimum size threshold and, if enabled, the entropy
+     * sample. The protocol's per message RSV1 bit makes skipping free:
+     * uncompressed messages interoperate with any conformant peer.
+     */
+    bool should_compress(std::string const & payload) const {
+        if (payload.size() < m_min_compress_size) {
+            return false;
+        }
+
+        if (m_entropy_sampling) {
+            // sample up to 256 evenly spaced bytes; very high byte
+            // diversity indicates incompressible data
+            bool seen[256] = {false};
+            size_t sample = (payload.size() < 256 ? payload.size() : 256);
+            size_t stride = payload.size()/sample;
+            size_t distinct = 0;
+            for (size_t i = 0; i < sample; i++) {
+                unsigned char c = static_cast<unsigned char>(
+                    payload[i*stride]);
+                if (!seen[c]) {
+                    seen[c] = true;
+                    distinct++;
+                }
+            }
+            // 256 random bytes cover ~162 distinct values on average;
+            // text and structured data stay far lower
+            if (sample >= 128 && distinct*2 > sample) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     /// Test if this object impliments the permessage-deflate specification
     /**
      * Because this object does impliment it, it will always return true.
@@ -331,6 +665,40 @@ public:
         m_s2c_no_context_takeover = true;
     }
 
+    /// Bound write-side history: periodic resets under context takeover
+    /**
+     * The middle ground between full context takeover (best ratio,
+     * window history retained indefinitely) and no_context_takeover
+     * (every message self-contained, ~20% worse ratio): takeover is
+     * negotiated normally, but the write-side deflate stream is reset
+     * after every `messages` compressed messages or `bytes` compressed
+     * input bytes, whichever comes first. Resetting our own deflater at
+     * a message boundary is always RFC-legal -- subsequent output
+     * simply stops referencing older history, which the peer's intact
+     * inflate window tolerates by construction -- so most of the ratio
+     * win inside each interval is kept while the referenced history is
+     * bounded. The read side is untouched: the peer controls its own
+     * references, so inflate context cannot be reset unilaterally.
+     * Zero for both (the default) never resets.
+     *
+     * @param messages Reset after this many compressed messages
+     * @param bytes Reset after this many compressed input bytes
+     */
+    void set_write_reset_interval(size_t messages, size_t bytes) {
+        m_write_reset_msgs = messages;
+        m_write_reset_bytes = bytes;
+    }
+
+    /// Attach the endpoint's adaptive compression level controller
+    /**
+     * Each compressed message reports its deflate time; the shared
+     * controller moves the target level with CPU duty cycle and this
+     * stream applies it (deflateParams) at its next message boundary.
+     */
+    void set_level_controller(level_controller::ptr controller) {
+        m_level_controller = controller;
+    }
+
     /// Reset client's outgoing LZ77 sliding window for each new message
     /**
      * Enabling this setting will cause the client's compressor to reset the
@@ -436,6 +804,24 @@ public:
         
     }
 
+    /// Negotiate when offered under the matching extension token
+    /**
+     * Extension-chain entry point: claims the "permessage-deflate" token
+     * and defers to negotiate(); any other token yields
+     * extensions::error::unknown_token so the next stage in a chain (or
+     * the processor) can try it.
+     */
+    err_str_pair negotiate_token(std::string const & name,
+        http::attribute_list const & offer)
+    {
+        if (name != "permessage-deflate") {
+            return err_str_pair(
+                extensions::error::make_error_code(
+                    extensions::error::unknown_token),std::string());
+        }
+        return negotiate(offer);
+    }
+
     /// Negotiate extension
     /**
      * Confirm that the client's extension negotiation offer has settings
@@ -468,6 +854,36 @@ public:
         }
         
         if (ret.first == lib::error_code()) {
+            // degrade under memory pressure: shrink the offered s2c window
+            // until the reservation fits, then refuse compression outright
+            if (m_budget_charged > 0) {
+                // re-negotiation; return the previous reservation first
+                memory_budget::instance().release(m_budget_charged);
+                m_budget_charged = 0;
+            }
+            for (;;) {
+                size_t cost = memory_budget::estimate(
+                    m_s2c_max_window_bits,m_mem_level,
+                    m_s2c_no_context_takeover,
+                    m_c2s_max_window_bits,m_c2s_no_context_takeover);
+                if (memory_budget::instance().reserve(cost)) {
+                    m_budget_charged = cost;
+                    break;
+                }
+                // zlib windows below 9 bits misbehave; 9 is the floor
+                if (m_s2c_max_window_bits > 9) {
+                    m_s2c_max_window_bits--;
+                } else if (m_mem_level > 4) {
+                    m_mem_level--;
+                } else {
+                    ret.first = make_error_code(
+                        error::memory_budget_exceeded);
+                    return ret;
+                }
+            }
+
+            // zlib state is initialized lazily on the first compressed
+            // frame; negotiated-but-quiet connections allocate nothing
             m_enabled = true;
             ret.second = generate_response();
         }
@@ -481,28 +897,155 @@ public:
      * @param [out] out String to append compressed bytes to
      * @return Error or status code
      */
+    /// Prime both directions with a shared compression dictionary
+    /**
+     * Both peers of a closed system prime identical (out-of-band agreed)
+     * dictionaries so the match window starts full of their common
+     * structure; small structured payloads compress substantially better
+     * and faster. Must be set before the first compressed message (the
+     * streams initialize lazily, so any time up to and including the
+     * open handler works); the dictionary is re-primed automatically
+     * after every no-context-takeover reset, including on pooled
+     * contexts.
+     *
+     * @param dict The dictionary bytes; most-common strings last, per
+     * zlib convention
+     */
+    void set_dictionary(std::string const & dict) {
+        m_dictionary = dict;
+    }
+
+    /// Apply the dictionary to a deflate context, if one is set
+    void prime_deflate(typename backend::stream_type * zs) {
+        if (!m_dictionary.empty()) {
+            backend::deflate_set_dictionary(zs,
+                reinterpret_cast<unsigned char const *>(
+                    m_dictionary.data()),
+                static_cast<unsigned int>(m_dictionary.size()));
+        }
+    }
+
+    /// Restore the deflate tail at the end of an inbound message
+    /**
+     * RFC 7692 7.2.2: the sender removed the trailing
+     * 0x00 0x00 0xff 0xff from each message; the receiver appends it
+     * before finishing inflation so the stream ends at a block
+     * boundary. Called by the processor when a compressed message's
+     * final frame completes; inflates to zero output bytes. Without
+     * it a context-takeover stream misreads the next message's first
+     * bytes as the missing block header.
+     */
+    lib::error_code finish_decompress(std::string & out) {
+        static uint8_t const tail[4] = {0x00,0x00,0xff,0xff};
+        return decompress(tail,4,out);
+    }
+
+    /// Apply the dictionary to an inflate context, if one is set
+    /**
+     * Raw deflate streams accept the dictionary up front; there is no
+     * Z_NEED_DICT round trip.
+     */
+    void prime_inflate(typename backend::stream_type * zs) {
+        if (!m_dictionary.empty()) {
+            backend::inflate_set_dictionary(zs,
+                reinterpret_cast<unsigned char const *>(
+                    m_dictionary.data()),
+                static_cast<unsigned int>(m_dictionary.size()));
+        }
+    }
+
     lib::error_code compress(std::string const & in, std::string & out) {
         if (!m_initialized) {
-            return make_error_code(error::uninitialized);
+            // lazy: streams are allocated on the first compressed frame so
+            // negotiated-but-quiet connections pay nothing
+            lib::error_code ec = init();
+            if (ec) {
+                return ec;
+            }
         }
 
         size_t output;
         int ret;
 
-        m_dstate.avail_out = m_compress_buffer_size;
-        m_dstate.next_in = (unsigned char *)(const_cast<char *>(in.data()));
+        // with no_context_takeover the stream is reset per message, so a
+        // pooled context is checked out instead of holding one per
+        // connection
+        uint64_t level_t0 = 0;
+        if (m_level_controller) {
+            // apply a changed target level at the message boundary; the
+            // stream is drained here so deflateParams is safe
+            int target = m_level_controller->level();
+            if (target != m_applied_level) {
+                if (backend::deflate_params(&m_dstate,target) == Z_OK) {
+                    m_applied_level = target;
+                }
+            }
+            level_t0 = lib::steady_us();
+        }
+
+        typename backend::stream_type * zs = &m_dstate;
+        int pool_bits = 0;
+        if (m_deflate_pooled) {
+            pool_bits = m_s2c_max_window_bits;
+            zs = zlib_context_pool<backend>::instance().acquire_deflate(pool_bits);
+            if (!zs) {
+                return make_error_code(error::zlib_error);
+            }
+            prime_deflate(zs);
+        }
+
+        zs->next_in = (unsigned char *)(const_cast<char *>(in.data()));
+        zs->avail_in = in.size();
+
+        size_t const out_base = out.size();
 
         do {
             // Output to local buffer
-            m_dstate.avail_out = m_compress_buffer_size;
-            m_dstate.next_out = m_compress_buffer.get();
+            zs->avail_out = m_compress_buffer_size;
+            zs->next_out = m_compress_buffer.get();
 
-            ret = deflate(&m_dstate, Z_SYNC_FLUSH);
+            ret = backend::deflate_run(zs, Z_SYNC_FLUSH);
             
-            output = m_compress_buffer_size - m_dstate.avail_out;
+            output = m_compress_buffer_size - zs->avail_out;
 
             out.append((char *)(m_compress_buffer.get()),output);
-        } while (m_dstate.avail_out == 0);
+        } while (zs->avail_out == 0);
+
+        if (m_level_controller) {
+            m_level_controller->record(lib::steady_us()-level_t0);
+        }
+
+        // RFC 7692 7.2.1: the sender removes the 0x00 0x00 0xff 0xff that
+        // Z_SYNC_FLUSH appends; the receiver restores it before inflating.
+        // Leaving it in breaks spec-compliant peers on the second message
+        // of a context-takeover stream (the restored tail lands mid-block)
+        if (out.size()-out_base >= 4
+            && out.compare(out.size()-4,4,"\x00\x00\xff\xff",4) == 0)
+        {
+            out.resize(out.size()-4);
+        }
+
+        if (m_deflate_pooled) {
+            backend::deflate_reset(zs);
+            zlib_context_pool<backend>::instance().release_deflate(pool_bits,zs);
+        } else if (m_s2c_no_context_takeover) {
+            backend::deflate_reset(zs);
+            prime_deflate(zs);
+        } else if (m_write_reset_msgs > 0 || m_write_reset_bytes > 0) {
+            // bounded-history takeover: see set_write_reset_interval
+            m_msgs_since_reset++;
+            m_bytes_since_reset += in.size();
+            if ((m_write_reset_msgs > 0
+                    && m_msgs_since_reset >= m_write_reset_msgs)
+                || (m_write_reset_bytes > 0
+                    && m_bytes_since_reset >= m_write_reset_bytes))
+            {
+                backend::deflate_reset(zs);
+                prime_deflate(zs);
+                m_msgs_since_reset = 0;
+                m_bytes_since_reset = 0;
+            }
+        }
 
         return lib::error_code();
     }
@@ -518,32 +1061,133 @@ public:
         out)
     {
         if (!m_initialized) {
-            return make_error_code(error::uninitialized);
+            lib::error_code ec = init();
+            if (ec) {
+                return ec;
+            }
         }
 
         int ret;
 
-        m_istate.avail_in = len;
-        m_istate.next_in = const_cast<unsigned char *>(buf);
+        typename backend::stream_type * zs = &m_istate;
+        int pool_bits = 0;
+        if (m_inflate_pooled) {
+            pool_bits = m_c2s_max_window_bits;
+            zs = zlib_context_pool<backend>::instance().acquire_inflate(pool_bits);
+            if (!zs) {
+                return make_error_code(error::zlib_error);
+            }
+            prime_inflate(zs);
+        }
+
+        zs->avail_in = len;
+        zs->next_in = const_cast<unsigned char *>(buf);
 
         do {
-            m_istate.avail_out = m_compress_buffer_size;
-            m_istate.next_out = m_compress_buffer.get();
+            zs->avail_out = m_compress_buffer_size;
+            zs->next_out = m_compress_buffer.get();
 
-            ret = inflate(&m_istate, Z_SYNC_FLUSH);
+            ret = backend::inflate_run(zs, Z_SYNC_FLUSH);
 
             if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+                if (m_inflate_pooled) {
+                    backend::inflate_reset(zs);
+                    zlib_context_pool<backend>::instance().release_inflate(pool_bits,
+                        zs);
+                }
                 return make_error_code(error::zlib_error);
             }
 
             out.append(
                 reinterpret_cast<char *>(m_compress_buffer.get()),
-                m_compress_buffer_size - m_istate.avail_out
+                m_compress_buffer_size - zs->avail_out
             );
-        } while (m_istate.avail_out == 0);
+        } while (zs->avail_out == 0);
+
+        if (m_inflate_pooled) {
+            backend::inflate_reset(zs);
+            zlib_context_pool<backend>::instance().release_inflate(pool_bits,zs);
+        } else if (m_c2s_no_context_takeover) {
+            backend::inflate_reset(zs);
+            prime_inflate(zs);
+        }
 
         return lib::error_code();
     }
+
+    /// Decompress with UTF-8 validation fused into the inflate loop
+    /**
+     * Identical to decompress, but each inflated chunk is run through the
+     * caller's incremental UTF-8 validator while it is still hot in
+     * cache, before being appended to out; invalid text aborts inflation
+     * at the offending chunk (error::invalid_utf8) instead of finishing
+     * the message and validating a third pass over cold data.
+     */
+    lib::error_code decompress_validated(uint8_t const * buf, size_t len,
+        std::string & out, utf8_validator::validator & validator)
+    {
+        if (!m_initialized) {
+            lib::error_code ec = init();
+            if (ec) {
+                return ec;
+            }
+        }
+
+        int ret;
+
+        typename backend::stream_type * zs = &m_istate;
+        int pool_bits = 0;
+        if (m_inflate_pooled) {
+            pool_bits = m_c2s_max_window_bits;
+            zs = zlib_context_pool<backend>::instance().acquire_inflate(
+                pool_bits);
+            if (!zs) {
+                return make_error_code(error::zlib_error);
+            }
+            prime_inflate(zs);
+        }
+
+        zs->avail_in = len;
+        zs->next_in = const_cast<unsigned char *>(buf);
+
+        lib::error_code fail;
+        do {
+            zs->avail_out = m_compress_buffer_size;
+            zs->next_out = m_compress_buffer.get();
+
+            ret = backend::inflate_run(zs, Z_SYNC_FLUSH);
+
+            if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR
+                || ret == Z_MEM_ERROR)
+            {
+                fail = make_error_code(error::zlib_error);
+                break;
+            }
+
+            uint8_t const * chunk = m_compress_buffer.get();
+            size_t produced = m_compress_buffer_size - zs->avail_out;
+            if (!validator.decode(chunk,chunk+produced)) {
+                fail = make_error_code(error::invalid_utf8);
+                break;
+            }
+
+            out.append(reinterpret_cast<char const *>(chunk),produced);
+        } while (zs->avail_out == 0);
+
+        if (m_inflate_pooled) {
+            backend::inflate_reset(zs);
+            zlib_context_pool<backend>::instance().release_inflate(
+                pool_bits,zs);
+        } else if (fail || m_c2s_no_context_takeover) {
+            // an aborted stream leaves the context mid-message; reset so
+            // takeover state is not poisoned (the connection is failing
+            // anyway when fail is set)
+            backend::inflate_reset(zs);
+            prime_inflate(zs);
+        }
+
+        return fail;
+    }
 private:
     /// Generate negotiation response
     /**
@@ -704,6 +1348,12 @@ private:
 
     bool m_enabled;
     bool m_s2c_no_context_takeover;
+    level_controller::ptr m_level_controller;
+    int m_applied_level;
+    size_t m_write_reset_msgs;
+    size_t m_write_reset_bytes;
+    size_t m_msgs_since_reset;
+    size_t m_bytes_since_reset;
     bool m_c2s_no_context_takeover;
     uint8_t m_s2c_max_window_bits;
     uint8_t m_c2s_max_window_bits;
@@ -711,10 +1361,18 @@ private:
     mode::value m_c2s_max_window_bits_mode;
 
     bool m_initialized;
+    /// Shared compression dictionary; empty when unset
+    std::string m_dictionary;
+    bool m_deflate_pooled;
+    bool m_inflate_pooled;
+    size_t m_budget_charged;
+    uint8_t m_mem_level;
+    size_t m_min_compress_size;
+    bool m_entropy_sampling;
     size_t m_compress_buffer_size;
     lib::unique_ptr_uchar_array m_compress_buffer;
-    z_stream m_dstate;
-    z_stream m_istate;
+    typename backend::stream_type m_dstate;
+    typename backend::stream_type m_istate;
 };
 
 } // namespace permessage_deflate
@@ -29,12 +29,40 @@
 #define WEBSOCKETPP_FRAME_HPP
 
 #include <algorithm>
+#include <cstring>
 
 #include <websocketpp/common/system_error.hpp>
 #include <websocketpp/common/network.hpp>
 
 #include <websocketpp/utilities.hpp>
 
+// SIMD masking kernel detection
+//
+// Unless WEBSOCKETPP_DISABLE_SIMD_MASKING is defined, frame.hpp will compile
+// vectorized masking kernels for instruction sets available to the compiler
+// and select the widest usable one at runtime. The scalar word-at-a-time
+// implementation is always compiled and is used as the fallback.
+#ifndef WEBSOCKETPP_DISABLE_SIMD_MASKING
+    #if defined(__SSE2__) || (defined(_MSC_VER) && \
+        (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+        #define WEBSOCKETPP_SIMD_MASKING_SSE2
+        #include <emmintrin.h>
+    #endif
+    #if defined(WEBSOCKETPP_SIMD_MASKING_SSE2) && \
+        (defined(__GNUC__) || defined(__clang__)) && !defined(__MINGW32__)
+        // With GCC/Clang the AVX2 kernel is compiled with a target attribute
+        // and guarded by a cpuid check, so it is available even when the
+        // translation unit itself is not built with -mavx2.
+        #define WEBSOCKETPP_SIMD_MASKING_AVX2
+        #include <immintrin.h>
+    #endif
+    #if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && \
+        !defined(__ARM_BIG_ENDIAN)
+        #define WEBSOCKETPP_SIMD_MASKING_NEON
+        #include <arm_neon.h>
+    #endif
+#endif
+
 namespace websocketpp {
 /// Data structures and utility functions for manipulating WebSocket frames
 /**
@@ -286,6 +314,8 @@ bool get_masked(basic_header const &h);
 void set_masked(basic_header &h, bool value);
 uint8_t get_basic_size(basic_header const &);
 size_t get_header_len(basic_header const &);
+size_t decode_header(uint8_t const * buf, size_t len, basic_header & bh,
+    extended_header & eh);
 unsigned int get_masking_key_offset(basic_header const &);
 
 std::string write_header(basic_header const &, extended_header const &);
@@ -456,6 +486,98 @@ inline size_t get_header_len(basic_header const & h) {
     return size;
 }
 
+/// Portable best-effort software prefetch
+#if defined(__GNUC__) || defined(__clang__)
+    #define WEBSOCKETPP_PREFETCH(addr) __builtin_prefetch((addr),0,1)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define WEBSOCKETPP_PREFETCH(addr) \
+        _mm_prefetch(reinterpret_cast<char const *>(addr),_MM_HINT_T1)
+#else
+    #define WEBSOCKETPP_PREFETCH(addr) ((void)0)
+#endif
+
+/// Peek a frame's total wire length from contiguous bytes
+/**
+ * Companion to decode_header for parse-ahead prefetching: computes
+ * header length plus payload length without touching any state, or 0
+ * when the bytes available cannot determine it (split header, or a
+ * 64-bit length whose high words overflow size_t). No validation.
+ */
+inline size_t peek_frame_len(uint8_t const * buf, size_t len) {
+    if (len < BASIC_HEADER_LENGTH) {
+        return 0;
+    }
+    uint8_t plen = buf[1] & 0x7f;
+    size_t ext = (plen == payload_size_code_16bit ? 2 : 0)
+               + (plen == payload_size_code_64bit ? 8 : 0);
+    size_t mask = (buf[1] & BHB1_MASK) ? 4 : 0;
+    size_t hlen = BASIC_HEADER_LENGTH+ext+mask;
+    if (len < BASIC_HEADER_LENGTH+ext) {
+        return 0;
+    }
+    uint64_t payload;
+    if (ext == 0) {
+        payload = plen;
+    } else if (ext == 2) {
+        payload = (static_cast<uint64_t>(buf[2]) << 8) | buf[3];
+    } else {
+        payload = 0;
+        for (int i = 0; i < 8; i++) {
+            payload = (payload << 8) | buf[2+i];
+        }
+        if (payload > static_cast<uint64_t>(~static_cast<size_t>(0))/2) {
+            return 0;
+        }
+    }
+    return hlen+static_cast<size_t>(payload);
+}
+
+/// One-shot decode of a complete frame header from contiguous bytes
+/**
+ * Fast path for the overwhelmingly common case where a transport read
+ * contains the whole (at most 14 byte) header: the length class and
+ * mask bit select the extended length in branch-light arithmetic and
+ * the extended bytes land in one unaligned copy, replacing the
+ * state machine's per-byte transitions. Returns the header length
+ * consumed, or 0 when fewer bytes than the header needs are available
+ * -- the caller then falls back to the incremental state machine for
+ * the split-header case. No validation is performed; the decoded
+ * headers feed the same validators as the incremental path.
+ *
+ * @param buf Start of a frame
+ * @param len Contiguous bytes available at buf
+ * @param [out] bh Receives the basic header
+ * @param [out] eh Receives the extended header bytes, wire layout
+ * @return Bytes consumed (the header length), or 0 if len is short
+ */
+inline size_t decode_header(uint8_t const * buf, size_t len,
+    basic_header & bh, extended_header & eh)
+{
+    if (len < BASIC_HEADER_LENGTH) {
+        return 0;
+    }
+    uint8_t b0 = buf[0];
+    uint8_t b1 = buf[1];
+
+    uint8_t plen = b1 & 0x7f;
+    // 126 -> 2 extended bytes, 127 -> 8, else 0; compiles to cmovs
+    size_t ext = (plen == payload_size_code_16bit ? 2 : 0)
+               + (plen == payload_size_code_64bit ? 8 : 0);
+    size_t mask = (b1 & BHB1_MASK) ? 4 : 0;
+    size_t hlen = BASIC_HEADER_LENGTH+ext+mask;
+
+    if (len < hlen) {
+        return 0;
+    }
+
+    bh.b0 = b0;
+    bh.b1 = b1;
+    // single unaligned copy of length bytes and masking key together,
+    // in the wire layout the accessors expect
+    std::memcpy(eh.bytes,buf+2,ext+mask);
+    return hlen;
+}
+
 /// Set the frame's size
 /**
  * @param [out] h The basic header to set.
@@ -612,6 +734,82 @@ inline uint64_t get_payload_size(const basic_header &h, const
     }
 }
 
+/// Decoded WebSocket frame header
+/**
+ * Filled in by decode_header: everything the first pass over a contiguous
+ * frame header yields in one place.
+ */
+struct header_info {
+    uint64_t payload_size;
+    size_t header_len;
+    masking_key_type key;
+    opcode::value op;
+    bool fin;
+    bool masked;
+    uint8_t rsv;
+};
+
+/// Combined basic+extended header decode over a contiguous buffer
+/**
+ * Decodes the basic header, the (possibly absent) extended length, and the
+ * (possibly absent) masking key in a single pass with branch-light length
+ * selection; the 64 bit length read collapses to one load plus byte swap.
+ * Returns false when the buffer does not yet contain the complete header
+ * (the caller should read more and retry); no validation beyond structural
+ * completeness is performed.
+ *
+ * @param buf Pointer to the start of a frame
+ * @param len Number of valid bytes at buf
+ * @param [out] out Decoded header fields
+ * @return Whether a complete header was present and decoded
+ */
+inline bool decode_header(uint8_t const * buf, size_t len, header_info & out)
+{
+    if (len < BASIC_HEADER_LENGTH) {
+        return false;
+    }
+
+    uint8_t b0 = buf[0];
+    uint8_t b1 = buf[1];
+    uint8_t code = b1 & 0x7F;
+
+    // 0, 2, or 8 extended length bytes; computed without a branch chain
+    unsigned ext = (code == payload_size_code_16bit ? 2u :
+                   (code == payload_size_code_64bit ? 8u : 0u));
+    bool masked = (b1 & BHB1_MASK) != 0;
+    size_t header_len = BASIC_HEADER_LENGTH + ext + (masked ? 4 : 0);
+
+    if (len < header_len) {
+        return false;
+    }
+
+    uint64_t size = code;
+    if (ext == 2) {
+        uint16_converter c16;
+        c16.c[0] = buf[2];
+        c16.c[1] = buf[3];
+        size = ntohs(c16.i);
+    } else if (ext == 8) {
+        uint64_converter c64;
+        std::copy(buf+2,buf+10,c64.c);
+        size = lib::net::ntohll(c64.i);
+    }
+
+    out.payload_size = size;
+    out.header_len = header_len;
+    out.op = static_cast<opcode::value>(b0 & BHB0_OPCODE);
+    out.fin = (b0 & BHB0_FIN) != 0;
+    out.masked = masked;
+    out.rsv = static_cast<uint8_t>(b0 & (BHB0_RSV1|BHB0_RSV2|BHB0_RSV3));
+    if (masked) {
+        std::copy(buf+BASIC_HEADER_LENGTH+ext,
+            buf+BASIC_HEADER_LENGTH+ext+4,out.key.c);
+    } else {
+        out.key.i = 0;
+    }
+    return true;
+}
+
 /// Extract a masking key into a value the size of a machine word.
 /** 
  * Machine word size must be 4 or 8.
@@ -883,6 +1081,194 @@ inline size_t byte_mask_circ(uint8_t* data, size_t length, size_t prepared_key){
     return byte_mask_circ(data,data,length,prepared_key);
 }
 
+#ifdef WEBSOCKETPP_SIMD_MASKING_SSE2
+/// SSE2 circular mask/unmask
+/**
+ * Vectorized variant of word_mask_circ that XORs sixteen bytes per iteration.
+ * Because the SIMD block size is a multiple of the four byte masking key no
+ * key rotation is needed between blocks; the sub-block remainder is delegated
+ * to word_mask_circ, which also produces the rotated key for the next call.
+ *
+ * Buffer size requirements and key semantics are identical to word_mask_circ.
+ *
+ * @param input Character buffer to mask
+ *
+ * @param output Character buffer to store the masked output
+ *
+ * @param length Length of data
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the prepared_key shifted to account for the input length
+ */
+inline size_t sse2_mask_circ(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    __m128i key_block = _mm_set1_epi32(static_cast<int32_t>(
+        static_cast<uint32_t>(prepared_key)));
+    size_t n = length / 16;
+
+    for (size_t i = 0; i < n; i++) {
+        __m128i in = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(input + i*16));
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(output + i*16),
+            _mm_xor_si128(in,key_block)
+        );
+    }
+
+    return word_mask_circ(input+n*16,output+n*16,length-n*16,prepared_key);
+}
+#endif // WEBSOCKETPP_SIMD_MASKING_SSE2
+
+#ifdef WEBSOCKETPP_SIMD_MASKING_AVX2
+/// AVX2 circular mask/unmask
+/**
+ * Vectorized variant of word_mask_circ that XORs thirty two bytes per
+ * iteration. Must only be called after a runtime check that the processor
+ * supports AVX2 (see simd_mask_circ, which performs this check once).
+ *
+ * Buffer size requirements and key semantics are identical to word_mask_circ.
+ *
+ * @param input Character buffer to mask
+ *
+ * @param output Character buffer to store the masked output
+ *
+ * @param length Length of data
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the prepared_key shifted to account for the input length
+ */
+__attribute__((target("avx2")))
+inline size_t avx2_mask_circ(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    __m256i key_block = _mm256_set1_epi32(static_cast<int32_t>(
+        static_cast<uint32_t>(prepared_key)));
+    size_t n = length / 32;
+
+    for (size_t i = 0; i < n; i++) {
+        __m256i in = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(input + i*32));
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(output + i*32),
+            _mm256_xor_si256(in,key_block)
+        );
+    }
+
+    return word_mask_circ(input+n*32,output+n*32,length-n*32,prepared_key);
+}
+#endif // WEBSOCKETPP_SIMD_MASKING_AVX2
+
+#ifdef WEBSOCKETPP_SIMD_MASKING_NEON
+/// NEON circular mask/unmask
+/**
+ * Vectorized variant of word_mask_circ that XORs sixteen bytes per iteration
+ * using ARM NEON instructions.
+ *
+ * Buffer size requirements and key semantics are identical to word_mask_circ.
+ *
+ * @param input Character buffer to mask
+ *
+ * @param output Character buffer to store the masked output
+ *
+ * @param length Length of data
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the prepared_key shifted to account for the input length
+ */
+inline size_t neon_mask_circ(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    uint32x4_t key_block = vdupq_n_u32(static_cast<uint32_t>(prepared_key));
+    size_t n = length / 16;
+
+    for (size_t i = 0; i < n; i++) {
+        uint32x4_t in = vreinterpretq_u32_u8(vld1q_u8(input + i*16));
+        vst1q_u8(output + i*16,vreinterpretq_u8_u32(veorq_u32(in,key_block)));
+    }
+
+    return word_mask_circ(input+n*16,output+n*16,length-n*16,prepared_key);
+}
+#endif // WEBSOCKETPP_SIMD_MASKING_NEON
+
+/// Function pointer type for the dispatched masking kernel
+typedef size_t (*mask_circ_fn)(uint8_t *, uint8_t *, size_t, size_t);
+
+namespace detail {
+
+/// Select the widest masking kernel usable on this processor
+/**
+ * Performs the (one time) runtime selection of the masking kernel used by
+ * simd_mask_circ. Compile time detection narrows the candidates to kernels
+ * the compiler could build; the AVX2 kernel is additionally gated on a cpuid
+ * check as it is compiled via a target attribute rather than globally
+ * enabled instructions.
+ *
+ * @return Pointer to the selected masking kernel
+ */
+inline mask_circ_fn select_mask_circ_kernel() {
+#ifdef WEBSOCKETPP_SIMD_MASKING_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return &avx2_mask_circ;
+    }
+#endif
+#ifdef WEBSOCKETPP_SIMD_MASKING_SSE2
+    return &sse2_mask_circ;
+#elif defined(WEBSOCKETPP_SIMD_MASKING_NEON)
+    return &neon_mask_circ;
+#else
+    return &word_mask_circ;
+#endif
+}
+
+} // namespace detail
+
+/// Circular mask/unmask dispatched to the best available kernel
+/**
+ * Semantically identical to word_mask_circ, including the requirement that
+ * the underlying allocated size of both buffers be a multiple of the machine
+ * word size. On processors with usable vector units this masks sixteen or
+ * thirty two bytes per iteration rather than one word; otherwise it falls
+ * back to word_mask_circ. Kernel selection happens once per process.
+ *
+ * @param input Character buffer to mask
+ *
+ * @param output Character buffer to store the masked output
+ *
+ * @param length Length of data
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the prepared_key shifted to account for the input length
+ */
+inline size_t simd_mask_circ(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    static mask_circ_fn const kernel = detail::select_mask_circ_kernel();
+    return kernel(input,output,length,prepared_key);
+}
+
+/// Circular mask/unmask dispatched to the best available kernel (in place)
+/**
+ * In place version of simd_mask_circ
+ *
+ * @see simd_mask_circ
+ *
+ * @param data Character buffer to read from and write to
+ *
+ * @param length Length of data
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the prepared_key shifted to account for the input length
+ */
+inline size_t simd_mask_circ(uint8_t* data, size_t length, size_t prepared_key){
+    return simd_mask_circ(data,data,length,prepared_key);
+}
+
 } // namespace frame
 } // namespace websocketpp
 
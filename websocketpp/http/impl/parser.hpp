@@ -43,6 +43,15 @@ inline void parser::set_version(std::string const & version) {
 inline std::string const & parser::get_header(std::string const & key) const {
     header_list::const_iterator h = m_headers.find(key);
 
+    if (h == m_headers.end() && !m_header_slices.empty()) {
+        // arena mode: materialize this entry into the map on first access
+        // so a stable reference can be returned
+        utility::string_ref ref = get_header_ref(utility::string_ref(key));
+        if (ref.data) {
+            h = m_headers.insert(std::make_pair(key,ref.str())).first;
+        }
+    }
+
     if (h == m_headers.end()) {
         return empty_header;
     } else {
@@ -50,16 +59,90 @@ inline std::string const & parser::get_header(std::string const & key) const {
     }
 }
 
+inline utility::string_ref parser::get_header_ref(utility::string_ref key)
+    const
+{
+    // entries that were mutated or already materialized take precedence
+    header_list::const_iterator h = m_headers.find(std::string(key.data,
+        key.len));
+    if (h != m_headers.end()) {
+        return utility::string_ref(h->second);
+    }
+
+    // binary search the sorted slice index
+    size_t lo = 0;
+    size_t hi = m_header_slices.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi-lo)/2;
+        if (utility::ci_less_ref(slice_key(m_header_slices[mid]),key)) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < m_header_slices.size() &&
+        utility::ci_equal(slice_key(m_header_slices[lo]),key))
+    {
+        return slice_val(m_header_slices[lo]);
+    }
+    return utility::string_ref();
+}
+
+inline void parser::finalize_arena() {
+    if (m_header_slices.empty()) {
+        return;
+    }
+
+    // sort case insensitively by key for binary search
+    std::stable_sort(m_header_slices.begin(),m_header_slices.end(),
+        slice_less(*this));
+
+    // join duplicate keys into the map (append_header semantics) and drop
+    // them from the index; the map is consulted first on lookup
+    size_t i = 0;
+    while (i+1 < m_header_slices.size()) {
+        if (utility::ci_equal(slice_key(m_header_slices[i]),
+            slice_key(m_header_slices[i+1])))
+        {
+            std::string key = slice_key(m_header_slices[i]).str();
+            std::string val = slice_val(m_header_slices[i]).str();
+            size_t j = i+1;
+            while (j < m_header_slices.size() &&
+                   utility::ci_equal(slice_key(m_header_slices[i]),
+                       slice_key(m_header_slices[j])))
+            {
+                val += ", " + slice_val(m_header_slices[j]).str();
+                j++;
+            }
+            m_headers[key] = val;
+            m_header_slices.erase(m_header_slices.begin()+i,
+                m_header_slices.begin()+j);
+        } else {
+            i++;
+        }
+    }
+}
+
+inline void parser::ensure_materialized() const {
+    for (size_t i = 0; i < m_header_slices.size(); i++) {
+        std::string key = slice_key(m_header_slices[i]).str();
+        if (m_headers.find(key) == m_headers.end()) {
+            m_headers[key] = slice_val(m_header_slices[i]).str();
+        }
+    }
+    m_header_slices.clear();
+}
+
 inline bool parser::get_header_as_plist(std::string const & key, 
     parameter_list & out) const
 {
-    header_list::const_iterator it = m_headers.find(key);
+    std::string const & value = this->get_header(key);
 
-    if (it == m_headers.end() || it->second.size() == 0) {
+    if (value.size() == 0) {
         return false;
     }
 
-    return this->parse_parameter_list(it->second,out);
+    return this->parse_parameter_list(value,out);
 }
 
 inline void parser::append_header(std::string const & key, std::string const &
@@ -69,6 +152,8 @@ inline void parser::append_header(std::string const & key, std::string const &
         throw exception("Invalid header name",status_code::bad_request);
     }
 
+    ensure_materialized();
+
     if (this->get_header(key) == "") {
         m_headers[key] = val;
     } else {
@@ -79,10 +164,12 @@ inline void parser::append_header(std::string const & key, std::string const &
 inline void parser::replace_header(std::string const & key, std::string const &
     val)
 {
+    ensure_materialized();
     m_headers[key] = val;
 }
 
 inline void parser::remove_header(std::string const & key) {
+    ensure_materialized();
     m_headers.erase(key);
 }
 
@@ -136,23 +223,84 @@ inline bool parser::parse_headers(std::istream & s) {
 inline void parser::process_header(std::string::iterator begin, 
     std::string::iterator end)
 {
-    std::string::iterator cursor = std::search(
-        begin,
-        end,
-        header_separator,
-        header_separator + sizeof(header_separator) - 1
-    );
+    // vectorized ':' scan with the following-space confirmation fused,
+    // matching the exact "name: value" separator the grammar uses
+    std::string::iterator cursor = end;
+    if (begin != end) {
+        char const * base = &*begin;
+        char const * b = base;
+        char const * e = base+(end-begin);
+        while (b < e) {
+            char const * c = websocketpp::http::detail::find_byte(b,e,':');
+            if (c == e || c+1 == e) {
+                break;
+            }
+            if (c[1] == ' ') {
+                cursor = begin+(c-base);
+                break;
+            }
+            b = c+1;
+        }
+    }
     
     if (cursor == end) {
         throw exception("Invalid header line",status_code::bad_request);
     }
+
+    if (m_arena_parse) {
+        // store the raw bytes once and index them; no map nodes or string
+        // temporaries. Duplicates are collapsed by finalize_arena.
+        header_slice slice;
+        slice.key_off = m_arena.size();
+        slice.key_len = static_cast<size_t>(cursor-begin);
+        m_arena.append(begin,cursor);
+        std::string::iterator vbegin = cursor+sizeof(header_separator)-1;
+        slice.val_off = m_arena.size();
+        slice.val_len = static_cast<size_t>(end-vbegin);
+        m_arena.append(vbegin,end);
+        m_header_slices.push_back(slice);
+        return;
+    }
     
     append_header(std::string(begin,cursor),
                   std::string(cursor+sizeof(header_separator)-1,end));
 }
 
+namespace detail {
+/// Append an unsigned integer's decimal digits without streams
+inline void append_uint(std::string & out, unsigned int value) {
+    char buf[12];
+    char * end = buf + sizeof(buf);
+    char * pos = end;
+    do {
+        *--pos = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    out.append(pos,end-pos);
+}
+} // namespace detail
+
+inline size_t parser::get_header_count() const {
+    ensure_materialized();
+    return m_headers.size();
+}
+
+inline void parser::serialize_headers(std::string & out) const {
+    ensure_materialized();
+
+    header_list::const_iterator it;
+    for (it = m_headers.begin(); it != m_headers.end(); it++) {
+        out.append(it->first);
+        out.append(": ",2);
+        out.append(it->second);
+        out.append("\r\n",2);
+    }
+}
+
 inline std::string parser::raw_headers() const {
     std::stringstream raw;
+
+    ensure_materialized();
     
     header_list::const_iterator it;
     for (it = m_headers.begin(); it != m_headers.end(); it++) {
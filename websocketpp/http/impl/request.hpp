@@ -28,6 +28,7 @@
 #ifndef HTTP_PARSER_REQUEST_IMPL_HPP
 #define HTTP_PARSER_REQUEST_IMPL_HPP
 
+#include <websocketpp/error.hpp>
 #include <algorithm>
 #include <sstream>
 
@@ -64,10 +65,29 @@ inline bool request::parse_complete(std::istream& s) {
     return parse_headers(s);
 }
     
+inline size_t request::consume(char const * buf, size_t len,
+    lib::error_code & ec)
+{
+    // the parser's internal control flow stays exception based (it spans
+    // a dozen helpers); this boundary converts to error codes so the
+    // connection's read path carries no EH frames
+    try {
+        ec = lib::error_code();
+        return consume(buf,len);
+    } catch (exception const & e) {
+        m_parse_status = e.m_error_code;
+        m_parse_msg = e.m_error_msg;
+        ec = websocketpp::error::make_error_code(
+            websocketpp::error::http_parse_error);
+        return 0;
+    }
+}
+
 inline size_t request::consume(const char *buf, size_t len) {
     if (m_ready) {return 0;}
     
-    if (m_buf->size() + len > max_header_size) {
+    m_header_bytes_seen += len;
+    if (m_header_bytes_seen > m_max_header_size) {
         // exceeded max header size
         throw exception("Maximum header size exceeded.",
                         status_code::request_header_fields_too_large);
@@ -82,12 +102,10 @@ inline size_t request::consume(const char *buf, size_t len) {
         
     for (;;) {
         // search for line delimiter
-        end = std::search(
-            begin,
-            m_buf->end(),
-            header_delimiter,
-            header_delimiter+sizeof(header_delimiter)-1
-        );
+        // vectorized CRLF scan; see http::detail::find_crlf
+        end = m_buf->begin()+(websocketpp::http::detail::find_crlf(
+            m_buf->data()+(begin-m_buf->begin()),
+            m_buf->data()+m_buf->size())-m_buf->data());
         
         //std::cout << "mark5: " << end-begin << std::endl;
         //std::cout << "mark6: " << sizeof(header_delimiter) << std::endl;
@@ -95,15 +113,30 @@ inline size_t request::consume(const char *buf, size_t len) {
         if (end == m_buf->end()) {
             // we are out of bytes. Discard the processed bytes and copy the
             // remaining unprecessed bytes to the beginning of the buffer
+            if (m_max_header_line_size != 0 &&
+                static_cast<size_t>(end-begin) > m_max_header_line_size)
+            {
+                // a single line ran past the per-line cap without ending
+                throw exception("Maximum header line size exceeded.",
+                    status_code::request_header_fields_too_large);
+            }
             std::copy(begin,end,m_buf->begin());
             m_buf->resize(static_cast<std::string::size_type>(end-begin));
                             
             return len;
         }
         
+        if (m_max_header_line_size != 0 &&
+            static_cast<size_t>(end-begin) > m_max_header_line_size)
+        {
+            throw exception("Maximum header line size exceeded.",
+                status_code::request_header_fields_too_large);
+        }
+        
         //the range [begin,end) now represents a line to be processed.      
         if (end-begin == 0) {
             // we got a blank line
+            finalize_arena();
             if (m_method.empty() || get_header("Host") == "") {
                 throw exception("Incomplete Request",status_code::bad_request);
             }
@@ -132,13 +165,24 @@ inline size_t request::consume(const char *buf, size_t len) {
 }
     
 inline std::string request::raw() {
+    std::string out;
+    serialize(out);
+    return out;
+}
+
+inline void request::serialize(std::string & out) {
     // TODO: validation. Make sure all required fields have been set?
-    std::stringstream raw;
-    
-    raw << m_method << " " << m_uri << " " << get_version() << "\r\n";
-    raw << raw_headers() << "\r\n" << m_body;
-    
-    return raw.str();
+    out.reserve(out.size()+128+m_body.size());
+
+    out.append(m_method);
+    out.append(" ",1);
+    out.append(m_uri);
+    out.append(" ",1);
+    out.append(get_version());
+    out.append("\r\n",2);
+    serialize_headers(out);
+    out.append("\r\n",2);
+    out.append(m_body);
 }
     
 inline void request::set_method(const std::string& method) {
@@ -28,6 +28,7 @@
 #ifndef HTTP_PARSER_RESPONSE_IMPL_HPP
 #define HTTP_PARSER_RESPONSE_IMPL_HPP
 
+#include <websocketpp/error.hpp>
 #include <algorithm>
 #include <sstream>
 
@@ -37,6 +38,22 @@ namespace websocketpp {
 namespace http {
 namespace parser {
 
+inline size_t response::consume(char const * buf, size_t len,
+    lib::error_code & ec)
+{
+    // see request::consume(buf,len,ec)
+    try {
+        ec = lib::error_code();
+        return consume(buf,len);
+    } catch (exception const & e) {
+        m_parse_status = e.m_error_code;
+        m_parse_msg = e.m_error_msg;
+        ec = websocketpp::error::make_error_code(
+            websocketpp::error::http_parse_error);
+        return 0;
+    }
+}
+
 inline size_t response::consume(const char *buf, size_t len) {
     if (m_state == DONE) {return 0;}
     
@@ -44,7 +61,7 @@ inline size_t response::consume(const char *buf, size_t len) {
         return this->process_body(buf,len);
     }
     
-    if (m_read + len > max_header_size) {
+    if (m_read + len > m_max_header_size) {
         // exceeded max header size
         throw exception("Maximum header size exceeded.",
                         status_code::request_header_fields_too_large);
@@ -60,12 +77,10 @@ inline size_t response::consume(const char *buf, size_t len) {
     
     for (;;) {
         // search for delimiter
-        end = std::search(
-            begin,
-            m_buf->end(),
-            header_delimiter,
-            header_delimiter + sizeof(header_delimiter) - 1
-        );
+        // vectorized CRLF scan; see http::detail::find_crlf
+        end = m_buf->begin()+(websocketpp::http::detail::find_crlf(
+            m_buf->data()+(begin-m_buf->begin()),
+            m_buf->data()+m_buf->size())-m_buf->data());
                     
         if (end == m_buf->end()) {
             // we are out of bytes. Discard the processed bytes and copy the
@@ -86,6 +101,8 @@ inline size_t response::consume(const char *buf, size_t len) {
                 throw exception("Incomplete Request",status_code::bad_request);
             }
             
+            finalize_arena();
+
             // TODO: grab content-length
             std::string length = get_header("Content-Length");
             
@@ -199,16 +216,24 @@ inline bool response::parse_complete(std::istream& s) {
 }
 
 inline std::string response::raw() const {
+    std::string out;
+    serialize(out);
+    return out;
+}
+
+inline void response::serialize(std::string & out) const {
     // TODO: validation. Make sure all required fields have been set?
-    
-    std::stringstream raw;
-    
-    raw << get_version() << " " << m_status_code << " " << m_status_msg;
-    raw << "\r\n" << raw_headers() << "\r\n";
-    
-    raw << m_body;
-    
-    return raw.str();
+    out.reserve(out.size()+128+m_body.size());
+
+    out.append(get_version());
+    out.append(" ",1);
+    detail::append_uint(out,static_cast<unsigned int>(m_status_code));
+    out.append(" ",1);
+    out.append(m_status_msg);
+    out.append("\r\n",2);
+    serialize_headers(out);
+    out.append("\r\n",2);
+    out.append(m_body);
 }
     
 inline void response::set_status(status_code::value code) {
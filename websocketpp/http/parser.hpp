@@ -35,8 +35,104 @@
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/http/constants.hpp>
 
+
+// Vectorized byte scanners for header parsing
+//
+// Unless WEBSOCKETPP_DISABLE_SIMD_HTTP is defined, SSE2/NEON kernels for
+// locating CRLF line boundaries and the "name: value" separator are
+// compiled when the instruction set is available to the compiler; the
+// scalar fallback is always compiled.
+#ifndef WEBSOCKETPP_DISABLE_SIMD_HTTP
+    #if defined(__SSE2__) || (defined(_MSC_VER) && \
+        (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+        #define WEBSOCKETPP_SIMD_HTTP_SSE2
+        #include <emmintrin.h>
+    #endif
+    #if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && \
+        !defined(__ARM_BIG_ENDIAN)
+        #define WEBSOCKETPP_SIMD_HTTP_NEON
+        #include <arm_neon.h>
+    #endif
+#endif
+
 namespace websocketpp {
 namespace http {
+
+
+namespace detail {
+
+/// Find the first occurrence of `target` in [begin,end), or end
+inline char const * find_byte(char const * begin, char const * end,
+    char target)
+{
+#if defined(WEBSOCKETPP_SIMD_HTTP_SSE2)
+    __m128i const needle = _mm_set1_epi8(target);
+    while (end-begin >= 16) {
+        __m128i chunk = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(begin));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk,needle));
+        if (mask != 0) {
+#if defined(_MSC_VER)
+            unsigned long idx;
+            _BitScanForward(&idx,static_cast<unsigned long>(mask));
+            return begin+idx;
+#else
+            return begin+__builtin_ctz(static_cast<unsigned>(mask));
+#endif
+        }
+        begin += 16;
+    }
+#elif defined(WEBSOCKETPP_SIMD_HTTP_NEON)
+    uint8x16_t const needle = vdupq_n_u8(static_cast<uint8_t>(target));
+    while (end-begin >= 16) {
+        uint8x16_t chunk = vld1q_u8(
+            reinterpret_cast<uint8_t const *>(begin));
+        uint8x16_t eq = vceqq_u8(chunk,needle);
+        // narrow to a 64-bit summary; nonzero means a hit in the block
+        uint64x1_t folded = vreinterpret_u64_u8(vshrn_n_u16(
+            vreinterpretq_u16_u8(eq),4));
+        uint64_t bits = vget_lane_u64(folded,0);
+        if (bits != 0) {
+            for (int i = 0; i < 16; i++) {
+                if (begin[i] == target) {
+                    return begin+i;
+                }
+            }
+        }
+        begin += 16;
+    }
+#endif
+    while (begin != end && *begin != target) {
+        ++begin;
+    }
+    return begin;
+}
+
+/// Find the first CRLF pair in [begin,end), or end
+/**
+ * Vector scan for '\r' with the '\n' confirmation fused: a lone '\r'
+ * (legal inside header values per the grammar we tolerate) restarts
+ * the scan after it rather than ending the line.
+ */
+inline char const * find_crlf(char const * begin, char const * end) {
+    while (begin < end) {
+        char const * r = find_byte(begin,end,'\r');
+        if (r == end) {
+            return end;
+        }
+        if (r+1 == end) {
+            // split pair; the caller buffers and retries with more bytes
+            return end;
+        }
+        if (r[1] == '\n') {
+            return r;
+        }
+        begin = r+1;
+    }
+    return end;
+}
+
+} // namespace detail
 namespace parser {
 
 namespace state {
@@ -50,6 +146,147 @@ namespace state {
 
 typedef std::map<std::string, std::string, utility::ci_less > header_list;
 
+/// One extension offer parsed as views into the header value
+/**
+ * Allocation-free companion to the generic parameter_list machinery for
+ * the Sec-WebSocket-Extensions grammar the hybi13 negotiation walks on
+ * every handshake: the extension token and up to max_params attribute
+ * name/value pairs are exposed as spans of the original header bytes.
+ */
+struct extension_offer_view {
+    static size_t const max_params = 8;
+
+    struct param_view {
+        char const * name;
+        size_t name_len;
+        char const * value;
+        size_t value_len;
+    };
+
+    char const * name;
+    size_t name_len;
+    size_t param_count;
+    param_view params[max_params];
+
+    /// Exact comparison of the extension token against a literal
+    bool name_is(char const * token) const {
+        size_t i = 0;
+        for (; i < name_len; i++) {
+            if (token[i] == '\0' || token[i] != name[i]) {
+                return false;
+            }
+        }
+        return token[i] == '\0';
+    }
+};
+
+/// Scan a Sec-WebSocket-Extensions value into view offers, alloc-free
+/**
+ * Grammar handled: `ext *( ";" param )` offers separated by commas,
+ * params as `token [ "=" token ]`. Quoted-string parameter values and
+ * offers exceeding max_params or max_offers set `fallback` -- the
+ * caller should re-parse with the generic (allocating) machinery,
+ * which handles the full grammar. Leading/trailing spaces and tabs
+ * around tokens are trimmed.
+ *
+ * @param [in] begin Start of the header value
+ * @param [in] end End of the header value
+ * @param [out] out Fixed array of offer views to fill
+ * @param [in] max_offers Capacity of out
+ * @param [out] fallback Set when the value needs the generic parser
+ * @return The number of offers written to out
+ */
+inline size_t parse_extension_offers(char const * begin, char const * end,
+    extension_offer_view * out, size_t max_offers, bool & fallback)
+{
+    fallback = false;
+    size_t count = 0;
+    char const * p = begin;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) {
+            ++p;
+        }
+        if (p >= end) {
+            break;
+        }
+        if (count == max_offers) {
+            fallback = true;
+            return count;
+        }
+        extension_offer_view & offer = out[count];
+        offer.param_count = 0;
+        offer.name = p;
+        while (p < end && is_token_char(*p)) {
+            ++p;
+        }
+        offer.name_len = static_cast<size_t>(p-offer.name);
+        if (offer.name_len == 0) {
+            fallback = true;
+            return count;
+        }
+        count++;
+
+        // parameters until the next offer or the end
+        for (;;) {
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            if (p >= end || *p == ',') {
+                ++p;
+                break;
+            }
+            if (*p != ';') {
+                fallback = true;
+                return count;
+            }
+            ++p;
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            if (offer.param_count == extension_offer_view::max_params) {
+                fallback = true;
+                return count;
+            }
+            extension_offer_view::param_view & prm =
+                offer.params[offer.param_count];
+            prm.name = p;
+            while (p < end && is_token_char(*p)) {
+                ++p;
+            }
+            prm.name_len = static_cast<size_t>(p-prm.name);
+            prm.value = 0;
+            prm.value_len = 0;
+            if (prm.name_len == 0) {
+                fallback = true;
+                return count;
+            }
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            if (p < end && *p == '=') {
+                ++p;
+                while (p < end && (*p == ' ' || *p == '\t')) {
+                    ++p;
+                }
+                if (p < end && *p == '"') {
+                    // quoted strings may contain escapes a view cannot
+                    // represent; punt to the generic parser
+                    fallback = true;
+                    return count;
+                }
+                prm.value = p;
+                while (p < end && is_token_char(*p)) {
+                    ++p;
+                }
+                prm.value_len = static_cast<size_t>(p-prm.value);
+            }
+            offer.param_count++;
+        }
+    }
+    return count;
+}
+
 /// Read and return the next token in the stream
 /**
  * Read until a non-token character is found and then return the token and
@@ -373,7 +610,14 @@ InputIterator extract_parameters(InputIterator begin, InputIterator end,
  * as headers, versions, bodies, etc.
  */
 class parser {
-public:    
+public:
+    parser()
+      : m_parse_status(status_code::uninitialized)
+      , m_max_header_size(max_header_size)
+      , m_max_header_line_size(0)
+      , m_header_bytes_seen(0)
+      , m_arena_parse(false) {}
+    
     /// Get the HTTP version string
     /**
      * @return The version string for this parser
@@ -400,6 +644,83 @@ public:
      */
     std::string const & get_header(std::string const & key) const;
 
+    /// Number of headers currently set
+    size_t get_header_count() const;
+
+    /// Cap the total buffered header bytes for this parser
+    /**
+     * Enforced inside consume as bytes arrive, so a peer dribbling an
+     * oversized header block is rejected the moment the cap is crossed
+     * rather than holding memory until a timeout. Defaults to
+     * http::max_header_size.
+     */
+    void set_max_header_size(size_t bytes) {
+        m_max_header_size = bytes;
+    }
+
+    /// Cap a single header line's length
+    /**
+     * A lone line that never ends still accumulates toward the total
+     * cap; this tightens the bound per line. Zero (default) applies no
+     * per-line limit beyond the total.
+     */
+    void set_max_header_line_size(size_t bytes) {
+        m_max_header_line_size = bytes;
+    }
+
+    /// Append all headers to a caller provided buffer
+    /**
+     * Single pass serialization variant of raw_headers: appends
+     * "Name: value\r\n" for every header to out without intermediate
+     * streams or temporaries. The caller reserves.
+     */
+    void serialize_headers(std::string & out) const;
+
+    /// Status and message of the last failed ec-based consume
+    /**
+     * Populated by the request/response consume(buf,len,ec) overloads
+     * when parsing fails, carrying what the thrown exception would have:
+     * the HTTP status to respond with and its text.
+     */
+    status_code::value get_parse_error_status() const {
+        return m_parse_status;
+    }
+    std::string const & get_parse_error_msg() const {
+        return m_parse_msg;
+    }
+
+
+    /// Get a zero copy reference to the value of an HTTP header
+    /**
+     * In arena parse mode (see set_arena_parse) the returned ref points
+     * directly into the stored raw header bytes and no allocation occurs.
+     * Outside arena mode it points into the header map's stored string. In
+     * both cases the ref is invalidated by mutating the parser. Returns an
+     * empty ref if the header is not present.
+     *
+     * @param [in] key The name/key of the header to get.
+     * @return A reference to the bytes of the header value.
+     */
+    utility::string_ref get_header_ref(utility::string_ref key) const;
+
+    /// Enable or disable arena backed header parsing
+    /**
+     * In arena parse mode the raw header bytes are stored once in a single
+     * buffer and headers are recorded as offset/length slices into it,
+     * replacing the per header map nodes and string temporaries. Header
+     * values are available without allocation through get_header_ref;
+     * get_header and the mutation methods remain fully functional and
+     * materialize entries into the header map lazily, so existing callers
+     * are unaffected. Note that lazy materialization means get_header is no
+     * longer safe to call concurrently from multiple threads on the same
+     * parser in arena mode.
+     *
+     * Must be set before the first bytes are consumed.
+     */
+    void set_arena_parse(bool value) {
+        m_arena_parse = value;
+    }
+
     /// Extract an HTTP parameter list from a parser header.
     /**
      * If the header requested doesn't exist or exists and is empty the 
@@ -505,6 +826,22 @@ protected:
      */
     void process_header(std::string::iterator begin, std::string::iterator end);
 
+    /// Finish arena parsing: order the header slices and collapse duplicates
+    /**
+     * Called once when the header block is complete. Duplicate keys are
+     * joined into the header map (matching append_header semantics) and
+     * removed from the slice index.
+     */
+    void finalize_arena();
+
+    /// Move every arena header slice into the header map
+    /**
+     * Called before any mutation so that map operations see all headers.
+     * Afterwards the arena index is empty and the parser behaves exactly as
+     * in non arena mode.
+     */
+    void ensure_materialized() const;
+
     /// Generate and return the HTTP headers as a string
     /**
      * Each headers will be followed by the \r\n sequence including the last one.
@@ -514,9 +851,55 @@ protected:
      */
     std::string raw_headers() const;
 
+
+
+    /// One parsed header stored as slices of the arena buffer
+    struct header_slice {
+        size_t key_off;
+        size_t key_len;
+        size_t val_off;
+        size_t val_len;
+    };
+
+    /// Orders header slices case insensitively by key
+    struct slice_less {
+        explicit slice_less(parser const & p) : m_parser(p) {}
+
+        bool operator()(header_slice const & a, header_slice const & b) const {
+            return utility::ci_less_ref(m_parser.slice_key(a),
+                m_parser.slice_key(b));
+        }
+
+        parser const & m_parser;
+    };
+
+    utility::string_ref slice_key(header_slice const & s) const {
+        return utility::string_ref(m_arena.data()+s.key_off,s.key_len);
+    }
+
+    utility::string_ref slice_val(header_slice const & s) const {
+        return utility::string_ref(m_arena.data()+s.val_off,s.val_len);
+    }
+
     std::string m_version;
-    header_list m_headers;
+    status_code::value m_parse_status;
+    std::string m_parse_msg;
+    /// Streaming caps; see set_max_header_size / set_max_header_line_size
+    size_t m_max_header_size;
+    size_t m_max_header_line_size;
+    /// Cumulative header bytes consumed; parsed lines leave the buffer,
+    /// so the cap must count what has passed through, not what remains
+    size_t m_header_bytes_seen;
+
+    mutable header_list m_headers;
     std::string m_body;
+
+    // arena parse mode state. m_arena stores the raw header bytes once;
+    // m_header_slices indexes it, sorted case insensitively by key after
+    // finalize_arena.
+    bool m_arena_parse;
+    std::string m_arena;
+    mutable std::vector<header_slice> m_header_slices;
 };
 
 } // namespace parser
@@ -29,6 +29,7 @@
 #define HTTP_PARSER_REQUEST_HPP
 
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/system_error.hpp>
 #include <websocketpp/http/parser.hpp>
 
 namespace websocketpp {
@@ -78,6 +79,15 @@ public:
      * @return Number of bytes processed.
      */
     size_t consume(const char *buf, size_t len);
+
+    /// As consume, reporting parse failures via an error code
+    /**
+     * On failure ec is set and the HTTP status/text that a response
+     * should carry are available from get_parse_error_status /
+     * get_parse_error_msg; no exception escapes. The exception-free
+     * entry point for hot connection paths.
+     */
+    size_t consume(char const * buf, size_t len, lib::error_code & ec);
     
     /// Returns whether or not the request is ready for reading.
     bool ready() const {
@@ -86,6 +96,12 @@ public:
     
     /// Returns the full raw request
     std::string raw();
+
+    /// Serialize the request into a caller provided buffer
+    /**
+     * @see response::serialize
+     */
+    void serialize(std::string & out);
     
     /// Set the HTTP method. Must be a valid HTTP token
     void set_method(const std::string& method);
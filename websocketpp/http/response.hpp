@@ -28,6 +28,7 @@
 #ifndef HTTP_PARSER_RESPONSE_HPP
 #define HTTP_PARSER_RESPONSE_HPP
 
+#include <websocketpp/common/system_error.hpp>
 #include <websocketpp/http/parser.hpp>
 
 namespace websocketpp {
@@ -83,6 +84,12 @@ public:
      * @return Number of bytes processed.
      */
     size_t consume(const char *buf, size_t len);
+
+    /// As consume, reporting parse failures via an error code
+    /**
+     * @see request::consume(char const *, size_t, lib::error_code &)
+     */
+    size_t consume(char const * buf, size_t len, lib::error_code & ec);
     
     size_t consume(std::istream & s);
     
@@ -104,6 +111,14 @@ public:
     
     /// Returns the full raw response
     std::string raw() const;
+
+    /// Serialize the response into a caller provided buffer
+    /**
+     * Appends the status line, headers, and body to out in one pass with
+     * no stream or temporary string construction; the buffer's existing
+     * capacity is reused across handshakes when the caller keeps it.
+     */
+    void serialize(std::string & out) const;
     
     /// Set response status code and message
     /**
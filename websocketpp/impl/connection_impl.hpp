@@ -29,12 +29,23 @@
 #define WEBSOCKETPP_CONNECTION_IMPL_HPP
 
 #include <websocketpp/common/system_error.hpp>
+#include <websocketpp/common/time.hpp>
+
+#include <cstring>
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 #include <websocketpp/processors/processor.hpp>
+#include <websocketpp/utf8_validator.hpp>
 
+#ifndef WEBSOCKETPP_NO_LEGACY_PROCESSORS
 #include <websocketpp/processors/hybi00.hpp>
 #include <websocketpp/processors/hybi07.hpp>
 #include <websocketpp/processors/hybi08.hpp>
+#endif
 #include <websocketpp/processors/hybi13.hpp>
 
 namespace websocketpp {
@@ -62,82 +73,819 @@ const std::string& connection<config>::get_origin() const {
 template <typename config>
 size_t connection<config>::get_buffered_amount() const {
     //scoped_lock_type lock(m_connection_state_lock);
-    return m_send_buffer_size;
+    return m_send_queue.bytes();
 }
 
 template <typename config>
 session::state::value connection<config>::get_state() const {
-    //scoped_lock_type lock(m_connection_state_lock);
-    return m_state;
+    // hot path query: a relaxed load is sufficient, state transitions are
+    // ordered by the operations that publish them
+    return m_state.load(lib::memory_order_relaxed);
 }
 
 template <typename config>
 lib::error_code connection<config>::send(const std::string& payload, 
     frame::opcode::value op)
 {
-    message_ptr msg = m_msg_manager->get_message(op,payload.size());
+    message_ptr msg = msg_manager()->get_message(op,payload.size());
     msg->append_payload(payload);
     
     return send(msg);
 }
 
+#ifdef _WEBSOCKETPP_RVALUE_REFERENCES_
+template <typename config>
+lib::error_code connection<config>::send(std::string&& payload,
+    frame::opcode::value op)
+{
+    message_ptr msg = msg_manager()->get_message();
+    if (!msg) {
+        return error::make_error_code(error::no_outgoing_buffers);
+    }
+    msg->reset(op);
+    msg->set_payload(std::move(payload));
+    
+    return send(msg);
+}
+#endif
+
+template <typename config>
+lib::error_code connection<config>::send_conflated(std::string const & key,
+    std::string const & payload, frame::opcode::value op)
+{
+    message_ptr msg = msg_manager()->get_message(op,payload.size());
+    if (!msg) {
+        return error::make_error_code(error::no_outgoing_buffers);
+    }
+    msg->append_payload(payload);
+    msg->set_conflation_tag(key);
+
+    return send(msg);
+}
+
+template <typename config>
+lib::error_code connection<config>::send(std::string const & payload,
+    frame::opcode::value op, bool compress)
+{
+    message_ptr msg = msg_manager()->get_message(op,payload.size());
+    if (!msg) {
+        return error::make_error_code(error::no_outgoing_buffers);
+    }
+    msg->append_payload(payload);
+    msg->set_compressed(compress);
+
+    return send(msg);
+}
+
 template <typename config>
 lib::error_code connection<config>::send(const void* payload, size_t len,
     frame::opcode::value op)
 {
-    message_ptr msg = m_msg_manager->get_message(op,len);
+    message_ptr msg = msg_manager()->get_message(op,len);
     msg->append_payload(payload,len);
     
     return send(msg);
 }
 
+template <typename config>
+lib::error_code connection<config>::check_send_watermarks() {
+    if (m_send_high_watermark == 0) {
+        return lib::error_code();
+    }
+
+    size_t buffered = m_send_queue.bytes();
+
+    if (buffered >= m_send_high_watermark) {
+        if (!m_send_queue_over) {
+            m_send_queue_over = true;
+            if (m_handlers->send_queue_full) {
+                m_handlers->send_queue_full(m_connection_hdl);
+            }
+        }
+
+        if (m_auto_read_pause) {
+            m_read_paused = true;
+        }
+
+        if (m_slow_consumer_policy == slow_consumer_policy::reject) {
+            m_stats->on_send_rejected();
+            return error::make_error_code(error::send_queue_full);
+        }
+        if (m_slow_consumer_policy == slow_consumer_policy::close) {
+            lib::error_code cec;
+            this->close(close::status::policy_violation,
+                "send queue overflow",cec);
+            return error::make_error_code(error::send_queue_full);
+        }
+        if (m_slow_consumer_policy == slow_consumer_policy::drop_oldest) {
+            // shed queued data, oldest first, to make room for this send;
+            // if nothing is droppable (everything in flight, or the lock
+            // free queue) behave like reject so the queue stays bounded
+            while (m_send_queue.bytes() >= m_send_high_watermark) {
+                message_ptr dropped = m_send_queue.drop_oldest_data();
+                if (!dropped) {
+                    m_stats->on_send_rejected();
+                    return error::make_error_code(error::send_queue_full);
+                }
+                m_stats->on_send_rejected();
+            }
+        }
+    }
+
+    return lib::error_code();
+}
+
+template <typename config>
+void connection<config>::resume_reading_internal() {
+    if (m_read_paused || !m_read_withheld) {
+        return;
+    }
+    m_read_withheld = false;
+    // re-enter the read path with no new bytes; it selects the appropriate
+    // target and arms the read
+    this->handle_read_frame(lib::error_code(),0);
+}
+
+template <typename config>
+void connection<config>::check_send_drain() {
+    if (m_send_high_watermark == 0 || !m_send_queue_over) {
+        return;
+    }
+    if (m_send_queue.bytes() <= m_send_low_watermark) {
+        m_send_queue_over = false;
+        if (m_auto_read_pause && m_read_paused) {
+            this->resume_reading();
+        }
+        if (m_handlers->send_queue_drain) {
+            m_handlers->send_queue_drain(m_connection_hdl);
+        }
+    }
+}
+
 template <typename config>
 lib::error_code connection<config>::send(typename config::message_type::ptr msg)
 {
     m_alog.write(log::alevel::devel,"connection send");
+
+    if (m_mailbox_enabled) {
+        return send_via_mailbox(msg);
+    }
+    return do_direct_send(msg);
+}
+
+/// The non-mailbox body of send(message_ptr); also the mailbox drain's
+/// per message step (always on the io thread in that mode)
+template <typename config>
+lib::error_code connection<config>::do_direct_send(message_ptr msg)
+{
     // TODO: 
     
-    if (m_state != session::state::open) {
+    // relaxed: the transition to open happens-before any legitimate send
+    if (m_state.load(lib::memory_order_relaxed) != session::state::open) {
        return error::make_error_code(error::invalid_state);
     }
     
     message_ptr outgoing_msg;
     bool needs_writing = false;
     
+    // an active streamed send owns the data lane; interleaving another
+    // data message into its fragment train would break RFC 6455 framing
+    if (m_stream_active) {
+        return error::make_error_code(error::invalid_state);
+    }
+
+    // a borrowed inbound message being relayed must own its bytes before
+    // frame preparation, which reads the owned payload string
+    if (msg->is_borrowed()) {
+        msg->retain();
+    }
+    
+    {
+        lib::error_code wec = check_send_watermarks();
+        if (wec) {
+            return wec;
+        }
+    }
+
+    // counted after the watermark and stream gates so rejected sends do
+    // not inflate the in-flight accounting; fragmented sends count once
+    // as the logical message
+    m_stats->on_message_out(msg->payload_size());
+
+    // apply the connection's default staleness budget to data messages
+    // that did not bring their own
+    if (m_default_ttl_ms > 0 && msg->get_deadline_ms() == 0
+        && !msg->get_prepared()
+        && !frame::opcode::is_control(msg->get_opcode()))
+    {
+        msg->set_ttl(m_default_ttl_ms);
+    }
+
+    if (m_max_outgoing_frame_size > 0
+        && !msg->get_prepared()
+        && !m_compress_pool
+        && !frame::opcode::is_control(msg->get_opcode())
+        && msg->get_payload().size() > m_max_outgoing_frame_size)
+    {
+        return send_fragmented(msg);
+    }
+
     if (msg->get_prepared()) {
         outgoing_msg = msg;
         
+        // pushed under the write lock so a fragment train being queued by
+        // another thread stays contiguous
         scoped_lock_type lock(m_write_lock);
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        if (m_stream_active) {
+            // re-check under the lock: the early check may have read a
+            // stale flag while a stream was starting on another thread
+            return error::make_error_code(error::invalid_state);
+        }
+        if (stats_type::timestamps) {
+            outgoing_msg->set_enqueued_us(lib::steady_us());
+        }
+        if (tracer::enabled) {
+            tracer::on_enqueue(this,lib::steady_us(),
+                outgoing_msg->get_payload().size());
+        }
+        needs_writing = m_send_queue.push(outgoing_msg);
+    } else if (m_compress_pool) {
+        // asynchronous preparation: enqueue on the pipeline and let a pool
+        // thread run prepare_data_frame; ordering is preserved by chaining
+        // one task at a time per connection
+        bool start_task = false;
+        {
+            scoped_lock_type lock(m_compress_pipeline_lock);
+            m_compress_pending.push(msg);
+            if (!m_compress_active) {
+                m_compress_active = true;
+                start_task = true;
+            }
+        }
+        if (start_task) {
+            m_compress_pool->post(lib::bind(
+                &type::run_compress_task,
+                type::shared_from_this()
+            ));
+        }
+        return lib::error_code();
     } else {
-        outgoing_msg = m_msg_manager->get_message();
+        outgoing_msg = msg_manager()->get_message();
         
         if (!outgoing_msg) {
             return error::make_error_code(error::no_outgoing_buffers);
         }
         
+        {
+            // the write lock serializes access to the processor's shared
+            // frame preparation state (rng, compression context) and keeps
+            // this push from landing inside another thread's fragment train
+            scoped_lock_type lock(m_write_lock);
+            if (m_stream_active) {
+                return error::make_error_code(error::invalid_state);
+            }
+            lib::error_code ec = m_processor->prepare_data_frame(msg,outgoing_msg);
+            
+            if (ec) {
+                return ec;
+            }
+            
+            // the queue conflates on the prepared message, so the tag has
+            // to travel from the application's message to it, as does the
+            // send deadline
+            outgoing_msg->set_conflation_tag(msg->get_conflation_tag());
+            outgoing_msg->set_deadline_ms(msg->get_deadline_ms());
+            if (stats_type::timestamps) {
+                outgoing_msg->set_enqueued_us(lib::steady_us());
+            }
+            if (tracer::enabled) {
+                tracer::on_enqueue(this,lib::steady_us(),
+                    outgoing_msg->get_payload().size());
+            }
+            
+            needs_writing = m_send_queue.push(outgoing_msg);
+        }
+    }
+    
+    if (needs_writing) {
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
+    }
+
+    return lib::error_code();
+}
+
+template <typename config>
+lib::error_code connection<config>::send_fragmented(message_ptr msg)
+{
+    std::string const & payload = msg->get_payload();
+    frame::opcode::value op = msg->get_opcode();
+
+    // validate the whole text payload up front; the processor only sees
+    // (and only validates) one fragment at a time
+    if (op == frame::opcode::TEXT && !utf8_validator::validate(payload)) {
+        return processor::error::make_error_code(
+            processor::error::invalid_payload);
+    }
+
+    bool needs_writing = false;
+    size_t offset = 0;
+    bool first = true;
+    std::vector<message_ptr> train;
+
+    {
+        // the write lock also keeps the fragment train contiguous in the
+        // send queue; every other send path pushes while holding it, so a
+        // concurrent send() cannot interleave its frames between these
+        // fragments
         scoped_lock_type lock(m_write_lock);
-        lib::error_code ec = m_processor->prepare_data_frame(msg,outgoing_msg);
-        
+
+        if (m_stream_active) {
+            return error::make_error_code(error::invalid_state);
+        }
+
+        while (offset < payload.size()) {
+            size_t len = payload.size()-offset;
+            bool last = true;
+            if (len > m_max_outgoing_frame_size) {
+                len = m_max_outgoing_frame_size;
+                last = false;
+            }
+
+            if (op == frame::opcode::TEXT && !last) {
+                // never split a UTF-8 sequence across fragments
+                size_t tail = utf8_validator::simd::incomplete_suffix_length(
+                    reinterpret_cast<uint8_t const *>(payload.data()+offset),
+                    len);
+                if (tail < len) {
+                    len -= tail;
+                }
+            }
+
+            message_ptr in = msg_manager()->get_message(
+                first ? op : frame::opcode::CONTINUATION, len);
+            message_ptr out = msg_manager()->get_message();
+
+            if (!in || !out) {
+                return error::make_error_code(error::no_outgoing_buffers);
+            }
+
+            in->append_payload(payload.data()+offset,len);
+            in->set_fin(last);
+            // fragments bypass permessage-deflate; per message compression
+            // would require carrying stream state across the train
+            in->set_compressed(false);
+
+            lib::error_code ec = m_processor->prepare_data_frame(in,out);
+            if (ec) {
+                return ec;
+            }
+
+            // dropping any frame of a train corrupts the framing; exempt
+            // them from the drop-oldest policy
+            out->set_droppable(false);
+
+            // queue nothing until the whole train prepares; a partial
+            // train would leave the peer waiting for a FIN that never
+            // comes and make every later data frame a protocol violation
+            train.push_back(out);
+
+            offset += len;
+            first = false;
+        }
+
+        for (size_t i = 0; i < train.size(); i++) {
+            if (m_send_queue.push(train[i])) {
+                needs_writing = true;
+            }
+        }
+    }
+
+    if (needs_writing) {
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
+    }
+
+    return lib::error_code();
+}
+
+template <typename config>
+lib::error_code connection<config>::send_frame(frame::opcode::value op,
+    bool fin, char const * payload, size_t len)
+{
+    if (m_state.load(lib::memory_order_relaxed) != session::state::open) {
+        return error::make_error_code(error::invalid_state);
+    }
+
+    message_ptr in = msg_manager()->get_message(op,len);
+    message_ptr out = msg_manager()->get_message();
+    if (!in || !out) {
+        return error::make_error_code(error::no_outgoing_buffers);
+    }
+
+    in->append_payload(payload,len);
+    in->set_fin(fin);
+    // raw frames are what the relay received; re-compressing per hop is
+    // not this primitive's business
+    in->set_compressed(false);
+
+    bool needs_writing = false;
+    {
+        scoped_lock_type lock(m_write_lock);
+        lib::error_code ec = m_processor->prepare_data_frame(in,out);
         if (ec) {
             return ec;
         }
-        
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        out->set_droppable(false);
+        needs_writing = m_send_queue.push(out);
     }
-    
+
     if (needs_writing) {
-        transport_con_type::dispatch(lib::bind(
-            &type::write_frame,
-            type::shared_from_this()
-        ));
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
     }
 
     return lib::error_code();
 }
 
+template <typename config>
+void connection<config>::relay_chunk(weak_ptr target_weak, connection_hdl,
+    frame::opcode::value op, char const * data, size_t len, bool first,
+    bool fin)
+{
+    ptr target = target_weak.lock();
+    if (!target) {
+        return;
+    }
+
+    // the end-of-message marker arrives as a zero length final span; it
+    // only needs forwarding when no bytes accompanied it (otherwise the
+    // final data span already carried fin)
+    if (len == 0 && fin && !first) {
+        target->send_frame(frame::opcode::CONTINUATION,true,"",0);
+        return;
+    }
+    if (len == 0 && !fin) {
+        return;
+    }
+    target->send_frame(first ? op : frame::opcode::CONTINUATION,fin,
+        (data ? data : ""),len);
+}
+
+template <typename config>
+lib::error_code connection<config>::send_stream(stream_source source,
+    frame::opcode::value op, size_t chunk_size)
+{
+    if (m_state.load(lib::memory_order_relaxed) != session::state::open) {
+        return error::make_error_code(error::invalid_state);
+    }
+    if (!source || chunk_size == 0) {
+        return processor::error::make_error_code(
+            processor::error::invalid_arguments);
+    }
+    if (frame::opcode::is_control(op)) {
+        return processor::error::make_error_code(
+            processor::error::invalid_opcode);
+    }
+    if (m_stream_active) {
+        return error::make_error_code(error::invalid_state);
+    }
+
+    m_stream_source = source;
+    m_stream_op = op;
+    m_stream_chunk_size = chunk_size;
+    m_stream_first = true;
+    m_stream_active = true;
+
+    // all pulls, including the first, run on the transport's event loop so
+    // the source only ever sees one thread
+    transport_con_type::dispatch_affine(lib::bind(
+        &type::stream_pull_next,
+        type::shared_from_this()
+    ));
+
+    return lib::error_code();
+}
+
+#ifndef _WIN32
+namespace detail {
+
+/// Stream source over an mmap'd (or pread) file region; see send_file
+/**
+ * Owned by the stream_source copies via shared_ptr; the destructor of
+ * the last copy releases the mapping when the final fragment has been
+ * written.
+ */
+struct file_region {
+    typedef lib::shared_ptr<file_region> ptr;
+
+    file_region(int fd, uint64_t offset, uint64_t len)
+      : m_map(MAP_FAILED), m_map_len(0), m_delta(0), m_fd(fd),
+        m_offset(offset), m_remaining(len), m_pos(0)
+    {
+        long page = ::sysconf(_SC_PAGESIZE);
+        uint64_t pa = offset & ~static_cast<uint64_t>(page-1);
+        m_delta = static_cast<size_t>(offset-pa);
+        m_map_len = static_cast<size_t>(len)+m_delta;
+        m_map = ::mmap(0,m_map_len,PROT_READ,MAP_PRIVATE,fd,
+            static_cast<off_t>(pa));
+#ifdef MADV_SEQUENTIAL
+        if (m_map != MAP_FAILED) {
+            ::madvise(m_map,m_map_len,MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    ~file_region() {
+        if (m_map != MAP_FAILED) {
+            ::munmap(m_map,m_map_len);
+        }
+    }
+
+    size_t pull(char * buf, size_t len, bool & fin) {
+        size_t take = len;
+        if (take > m_remaining) {
+            take = static_cast<size_t>(m_remaining);
+        }
+        if (take > 0) {
+            if (m_map != MAP_FAILED) {
+                std::memcpy(buf,
+                    static_cast<char const *>(m_map)+m_delta+m_pos,take);
+            } else {
+                // mmap unavailable (pipe-backed fd, exotic fs): pread
+                // straight into the frame, still a single copy
+                ssize_t got = ::pread(m_fd,buf,take,
+                    static_cast<off_t>(m_offset+m_pos));
+                if (got <= 0) {
+                    fin = true;
+                    return 0;
+                }
+                take = static_cast<size_t>(got);
+            }
+        }
+        m_pos += take;
+        m_remaining -= take;
+        if (m_remaining == 0) {
+            fin = true;
+        }
+        return take;
+    }
+
+    void * m_map;
+    size_t m_map_len;
+    size_t m_delta;
+    int m_fd;
+    uint64_t m_offset;
+    uint64_t m_remaining;
+    uint64_t m_pos;
+};
+
+/// Copyable functor adapting file_region to the stream_source signature
+struct file_region_source {
+    file_region::ptr region;
+    size_t operator()(char * buf, size_t len, bool & fin) const {
+        return region->pull(buf,len,fin);
+    }
+};
+
+} // namespace detail
+#endif // _WIN32
+
+template <typename config>
+lib::error_code connection<config>::send_file(int fd, uint64_t offset,
+    uint64_t len, size_t chunk_size)
+{
+#ifdef _WIN32
+    (void)fd; (void)offset; (void)len; (void)chunk_size;
+    // no POSIX file descriptors to stream from on this platform
+    return error::make_error_code(error::general);
+#else
+    // clamp to the file's actual extent: an over-long region would fault
+    // the mapping (SIGBUS) when the stream walked past EOF
+    struct stat st;
+    if (::fstat(fd,&st) != 0) {
+        return error::make_error_code(error::general);
+    }
+    if (offset >= static_cast<uint64_t>(st.st_size)) {
+        len = 0;
+    } else if (offset+len > static_cast<uint64_t>(st.st_size)) {
+        len = static_cast<uint64_t>(st.st_size)-offset;
+    }
+    if (len == 0) {
+        // degenerate region: an empty binary message, no stream needed
+        return send(std::string(),frame::opcode::binary);
+    }
+    detail::file_region_source source;
+    source.region.reset(new detail::file_region(fd,offset,len));
+    return send_stream(source,frame::opcode::binary,chunk_size);
+#endif
+}
+
+template <typename config>
+void connection<config>::stream_pull_next() {
+    if (!m_stream_active) {
+        return;
+    }
+    if (m_state.load(lib::memory_order_relaxed) != session::state::open) {
+        // connection went away mid-stream; the close/fail path already
+        // notifies the application
+        m_stream_active = false;
+        m_stream_source = stream_source();
+        return;
+    }
+
+    message_ptr in = msg_manager()->get_message(
+        m_stream_first ? m_stream_op : frame::opcode::CONTINUATION,
+        m_stream_chunk_size);
+    message_ptr out = msg_manager()->get_message();
+
+    if (!in || !out) {
+        m_elog.write(log::elevel::rerror,
+            "send_stream aborted: no outgoing buffers");
+        m_stream_active = false;
+        m_stream_source = stream_source();
+        this->terminate(error::make_error_code(error::no_outgoing_buffers));
+        return;
+    }
+
+    std::string & buf = in->get_raw_payload();
+    buf.resize(m_stream_chunk_size);
+    bool fin = false;
+    size_t n = m_stream_source(&buf[0],m_stream_chunk_size,fin);
+    if (n > m_stream_chunk_size) {
+        n = m_stream_chunk_size;
+    }
+    buf.resize(n);
+    if (n == 0) {
+        fin = true;
+    }
+
+    in->set_fin(fin);
+    // streamed fragments bypass permessage-deflate; see send_fragmented
+    in->set_compressed(false);
+
+    bool needs_writing = false;
+    {
+        scoped_lock_type lock(m_write_lock);
+        lib::error_code ec = m_processor->prepare_data_frame(in,out);
+        if (ec) {
+            m_elog.write(log::elevel::rerror,
+                "send_stream aborted: "+ec.message());
+            m_stream_active = false;
+            m_stream_source = stream_source();
+            this->terminate(ec);
+            return;
+        }
+        out->set_droppable(false);
+        needs_writing = m_send_queue.push(out);
+    }
+
+    m_stream_first = false;
+
+    if (fin) {
+        m_stream_active = false;
+        m_stream_source = stream_source();
+    }
+
+    if (needs_writing) {
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
+    }
+}
+
+template <typename config>
+typename config::message_type::ptr connection<config>::prepare_message(
+    std::string const & payload, frame::opcode::value op, lib::error_code & ec)
+{
+    if (m_state != session::state::open) {
+        ec = error::make_error_code(error::invalid_state);
+        return message_ptr();
+    }
+
+    message_ptr in = msg_manager()->get_message(op,payload.size());
+    message_ptr out = msg_manager()->get_message();
+
+    if (!in || !out) {
+        ec = error::make_error_code(error::no_outgoing_buffers);
+        return message_ptr();
+    }
+
+    in->append_payload(payload);
+    // a shared prepared message must not depend on any per connection
+    // compression context; see the declaration for details
+    in->set_compressed(false);
+
+    {
+        scoped_lock_type lock(m_write_lock);
+        ec = m_processor->prepare_data_frame(in,out);
+    }
+    if (ec) {
+        return message_ptr();
+    }
+
+    return out;
+}
+
+template <typename config>
+void connection<config>::run_compress_task() {
+    message_ptr msg;
+    {
+        scoped_lock_type lock(m_compress_pipeline_lock);
+        if (m_compress_pending.empty()) {
+            m_compress_active = false;
+            return;
+        }
+        msg = m_compress_pending.front();
+        m_compress_pending.pop();
+    }
+
+    message_ptr outgoing_msg = msg_manager()->get_message();
+    bool needs_writing = false;
+
+    if (!outgoing_msg) {
+        m_elog.write(log::elevel::rerror,
+            "async prepare failed: no outgoing buffers; message dropped");
+    } else {
+        lib::error_code ec;
+        {
+            scoped_lock_type lock(m_write_lock);
+            ec = m_processor->prepare_data_frame(msg,outgoing_msg);
+        }
+        if (ec) {
+            m_elog.write(log::elevel::rerror,
+                "async prepare failed: "+ec.message()+"; message dropped");
+        } else {
+            needs_writing = m_send_queue.push(outgoing_msg);
+        }
+    }
+
+    if (needs_writing) {
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
+    }
+
+    // chain the next pending message, preserving per connection order
+    bool more;
+    {
+        scoped_lock_type lock(m_compress_pipeline_lock);
+        more = !m_compress_pending.empty();
+        if (!more) {
+            m_compress_active = false;
+        }
+    }
+    if (more) {
+        m_compress_pool->post(lib::bind(
+            &type::run_compress_task,
+            type::shared_from_this()
+        ));
+    }
+}
+
 template <typename config>
 void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
     m_alog.write(log::alevel::devel,"connection ping");
@@ -147,7 +895,7 @@ void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
         return;
     }
     
-    message_ptr msg = m_msg_manager->get_message();
+    message_ptr msg = msg_manager()->get_message();
     if (!msg) {
         ec = error::make_error_code(error::no_outgoing_buffers);
         return;
@@ -157,11 +905,21 @@ void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
     if (ec) {return;}
     
     // set ping timer if we are listening for one
-    if (m_pong_timeout_handler) {
+    if (m_handlers->pong_timeout && m_swept_pong_timeouts) {
+        // batched liveness: the endpoint's keepalive sweep services the
+        // deadline, so no timer object is created per ping
+        m_keepalive.awaiting_user_pong = true;
+        m_keepalive.pong_count_at_user_ping =
+            m_pong_count.load(lib::memory_order_relaxed);
+        m_keepalive.user_pong_deadline_ms =
+            lib::steady_ms()+config::timeout_pong;
+        m_keepalive.user_ping_payload = payload;
+    } else if (m_handlers->pong_timeout) {
         // Cancel any existing timers
         if (m_ping_timer) {
             m_ping_timer->cancel();
         }
+        m_keepalive.awaiting_user_pong = false;
         
         m_ping_timer = transport_con_type::set_timer(
             config::timeout_pong,
@@ -180,18 +938,20 @@ void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
         }
     }
     
-    bool needs_writing = false;
-    {
-        scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
-    }
+    bool needs_writing = m_send_queue.push_priority(msg);
 
     if (needs_writing) {
-        transport_con_type::dispatch(lib::bind(
-            &type::write_frame,
-            type::shared_from_this()
-        ));
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
     }
     
     ec = lib::error_code();
@@ -216,13 +976,30 @@ void connection<config>::handle_pong_timeout(std::string payload, const lib::err
             return;
         }
         
-        m_elog.write(log::elevel::devel,"pong_timeout error: "+ec.message());
+        if (m_elog.static_test(log::elevel::devel)) {
+            m_elog.write(log::elevel::devel,
+                "pong_timeout error: "+ec.message());
+        }
         return;
     }
     
-    if (m_pong_timeout_handler) {
-        m_pong_timeout_handler(m_connection_hdl,payload);
+    if (m_handlers->pong_timeout) {
+        m_handlers->pong_timeout(m_connection_hdl,payload);
+    }
+}
+
+/// Stamped ping carrying a monotonic timestamp token (see header)
+template <typename config>
+void connection<config>::ping_rtt(lib::error_code & ec) {
+    char token[26];
+    uint64_t now = lib::steady_us();
+    static char const hexd[] = "0123456789abcdef";
+    std::memcpy(token,"wspp-rtt:",9);
+    for (int i = 15; i >= 0; i--) {
+        token[9+i] = hexd[now & 0xf];
+        now >>= 4;
     }
+    ping(std::string(token,25),ec);
 }
 
 template <typename config>
@@ -234,7 +1011,7 @@ void connection<config>::pong(const std::string& payload, lib::error_code& ec) {
         return;
     }
     
-    message_ptr msg = m_msg_manager->get_message();
+    message_ptr msg = msg_manager()->get_message();
     if (!msg) {
         ec = error::make_error_code(error::no_outgoing_buffers);
         return;
@@ -243,18 +1020,20 @@ void connection<config>::pong(const std::string& payload, lib::error_code& ec) {
     ec = m_processor->prepare_pong(payload,msg);
     if (ec) {return;}
     
-    bool needs_writing = false;
-    {
-        scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
-    }
+    bool needs_writing = m_send_queue.push_priority(msg);
 
     if (needs_writing) {
-        transport_con_type::dispatch(lib::bind(
-            &type::write_frame,
-            type::shared_from_this()
-        ));
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
     }
 
     ec = lib::error_code();
@@ -316,8 +1095,8 @@ lib::error_code connection<config>::interrupt() {
 
 template <typename config>
 void connection<config>::handle_interrupt() {
-    if (m_interrupt_handler) {
-        m_interrupt_handler(m_connection_hdl);
+    if (m_handlers->interrupt) {
+        m_handlers->interrupt(m_connection_hdl);
     }
 }
 
@@ -413,7 +1192,43 @@ void connection<config>::add_subprotocol(const std::string & value) {
     }
 }
 
-
+
+/// Allocation free matching of the raw subprotocol offer against the
+/// registered table, in table (priority) order
+template <typename config>
+void connection<config>::auto_select_subprotocol() {
+    std::string const & offer =
+        m_request.get_header("Sec-WebSocket-Protocol");
+    if (offer.empty()) {
+        return;
+    }
+
+    std::vector<std::string> const & table = *m_subprotocol_table;
+    for (size_t t = 0; t < table.size(); t++) {
+        std::string const & want = table[t];
+        size_t pos = 0;
+        while (pos < offer.size()) {
+            // token boundaries: commas, surrounded by optional whitespace
+            size_t start = offer.find_first_not_of(" \t,",pos);
+            if (start == std::string::npos) {
+                break;
+            }
+            size_t end = offer.find_first_of(" \t,",start);
+            if (end == std::string::npos) {
+                end = offer.size();
+            }
+            if (end-start == want.size()
+                && offer.compare(start,want.size(),want) == 0)
+            {
+                m_subprotocol = want;
+                m_subprotocol_index = t;
+                return;
+            }
+            pos = end;
+        }
+    }
+}
+
 template <typename config>
 void connection<config>::select_subprotocol(const std::string & value, 
     lib::error_code & ec)
@@ -557,6 +1372,27 @@ void connection<config>::remove_header(
 template <typename config>
 void connection<config>::start() {
     m_alog.write(log::alevel::devel,"connection start");
+
+    // the read buffer is materialized here rather than at construction
+    // so armed and pooled-idle connections hold none
+    if (m_buf.size() < config::connection_read_buffer_size) {
+        m_buf.resize(config::connection_read_buffer_size);
+    }
+    // materialize the message manager here too: every later use is
+    // ordered after start() by the transport, so the lazy branch in
+    // msg_manager() never has to create under concurrency
+    msg_manager();
+
+    if (m_raw_continuations) {
+        // pin the connection with one terminal reference and build the
+        // hot continuations once around the raw pointer; see
+        // set_raw_continuations for the lifetime rules
+        m_self = type::shared_from_this();
+        raw_read_functor rrf = { this };
+        m_raw_read_continuation = rrf;
+        raw_write_functor rwf = { this };
+        m_raw_write_continuation = rwf;
+    }
     
     this->atomic_state_change(
         istate::USER_INIT,
@@ -615,6 +1451,34 @@ void connection<config>::handle_transport_init(lib::error_code const & ec) {
         // We are a client. Set the processor to the version specified in the
         // config file and send a handshake request.
         m_processor = get_processor(config::client_version);
+        if (m_processor && m_handlers->message_chunk) {
+            m_processor->set_payload_sink(lib::bind(
+                &type::handle_message_chunk,this,
+                lib::placeholders::_1,lib::placeholders::_2,
+                lib::placeholders::_3));
+        }
+        if (m_processor && m_borrowed_messages) {
+            m_processor->set_borrowed_payloads(true);
+        }
+        if (m_processor
+            && m_validation_policy != processor::validation_policy::strict)
+        {
+            m_processor->set_validation_policy(m_validation_policy);
+        }
+        if (m_processor && !m_compression_dictionary.empty()) {
+            m_processor->set_compression_dictionary(
+                m_compression_dictionary);
+        }
+        if (m_processor
+            && (m_compress_reset_msgs > 0 || m_compress_reset_bytes > 0))
+        {
+            m_processor->set_compression_write_reset(
+                m_compress_reset_msgs,m_compress_reset_bytes);
+        }
+        if (m_processor && m_level_controller) {
+            m_processor->set_compression_level_controller(
+                m_level_controller);
+        }
         this->send_http_request();
     }
 }
@@ -634,8 +1498,8 @@ void connection<config>::read_handshake(size_t num_bytes) {
     
     transport_con_type::async_read_at_least(
         num_bytes,
-        m_buf,
-        config::connection_read_buffer_size,
+        &m_buf[0],
+        m_buf.size(),
         lib::bind(
             &type::handle_read_handshake,
             type::shared_from_this(),
@@ -645,153 +1509,676 @@ void connection<config>::read_handshake(size_t num_bytes) {
     );
 }
 
-// All exit paths for this function need to call send_http_response() or submit 
-// a new read request with this function as the handler.
-template <typename config>
-void connection<config>::handle_read_handshake(const lib::error_code& ec, 
-    size_t bytes_transferred)
-{
-    m_alog.write(log::alevel::devel,"connection handle_read_handshake");
-    
-    this->atomic_state_check(
-        istate::READ_HTTP_REQUEST,
-        "handle_read_handshake must be called from READ_HTTP_REQUEST state"
-    );
-    
-    if (ec) {
-        if (ec == transport::error::eof) {
-            // we expect to get eof if the connection is closed already
-            if (m_state == session::state::closed) {
-                m_alog.write(log::alevel::devel,"got eof from closed con");
-                return;
-            }
+// All exit paths for this function need to call send_http_response() or submit 
+// a new read request with this function as the handler.
+template <typename config>
+void connection<config>::handle_read_handshake(const lib::error_code& ec, 
+    size_t bytes_transferred)
+{
+    m_alog.write(log::alevel::devel,"connection handle_read_handshake");
+    
+    this->atomic_state_check(
+        istate::READ_HTTP_REQUEST,
+        "handle_read_handshake must be called from READ_HTTP_REQUEST state"
+    );
+    
+    if (ec) {
+        if (ec == transport::error::eof) {
+            // we expect to get eof if the connection is closed already
+            if (m_state == session::state::closed) {
+                m_alog.write(log::alevel::devel,"got eof from closed con");
+                return;
+            }
+        }
+        
+        std::stringstream s;
+        s << "error in handle_read_handshake: "<< ec.message();
+        m_elog.write(log::elevel::fatal,s.str());
+        this->terminate(ec);
+        return;
+    }
+            
+    // Boundaries checking. TODO: How much of this should be done?
+    if (bytes_transferred > m_buf.size()) {
+        m_elog.write(log::elevel::fatal,"Fatal boundaries checking error.");
+        this->terminate(make_error_code(error::general));
+        return;
+    }
+    
+    if (m_prescreen && !m_prescreened && m_is_server) {
+        // cheap plausibility filter over the raw first bytes: shed junk
+        // before any parsing or response machinery spends real resources
+        m_prescreened = true;
+        if (!m_prescreen(&m_buf[0],bytes_transferred)) {
+            m_alog.write(log::alevel::devel,
+                "connection shed by handshake pre-screen");
+            this->terminate(make_error_code(error::rejected));
+            return;
+        }
+    }
+
+    lib::error_code pec;
+    size_t bytes_processed = m_request.consume(&m_buf[0],
+        bytes_transferred,pec);
+    if (pec) {
+        // Parse failures fail the request with an error response; no
+        // more bytes will be read on this connection.
+        m_response.set_status(m_request.get_parse_error_status(),
+            m_request.get_parse_error_msg());
+        this->send_http_response_error();
+        return;
+    }
+    
+    // More paranoid boundaries checking. 
+    // TODO: Is this overkill?
+    if (bytes_processed > m_buf.size()) {
+        m_elog.write(log::elevel::fatal,"Fatal boundaries checking error.");
+        this->terminate(make_error_code(error::general));
+        return;
+    }
+    
+    if (m_alog.static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "bytes_transferred: " << bytes_transferred 
+          << " bytes, bytes processed: " << bytes_processed << " bytes";
+        m_alog.write(log::alevel::devel,s.str());
+    }
+    
+    if (!m_request.ready() && !m_request.get_method().empty()
+        && !m_handlers->http)
+    {
+        // the request line is in and no HTTP fallback is registered:
+        // anything that cannot become an upgrade is rejected now rather
+        // than buffering the rest of its headers
+        std::string const & method = m_request.get_method();
+        if (method != "GET" && method != "CONNECT") {
+            m_alog.write(log::alevel::devel,
+                "BAD REQUEST: unupgradeable method "+method);
+            m_response.set_status(http::status_code::not_implemented);
+            this->send_http_response_error();
+            return;
+        }
+    }
+
+    if (m_request.ready()) {
+        if (!this->initialize_processor()) {
+            this->send_http_response_error();
+            return;
+        }
+        
+        if (m_processor && m_processor->get_version() == 0) {
+            // Version 00 has an extra requirement to read some bytes after the
+            // handshake
+            if (bytes_transferred-bytes_processed >= 8) {
+                m_request.replace_header(
+                    "Sec-WebSocket-Key3",
+                    std::string(m_buf.begin()+bytes_processed,
+                m_buf.begin()+bytes_processed+8)
+                );
+                bytes_processed += 8;
+            } else {
+                // TODO: need more bytes
+                m_alog.write(log::alevel::devel,"short key3 read");
+                m_response.set_status(http::status_code::internal_server_error);
+                this->send_http_response_error();
+                return;
+            }
+        }
+        
+        if (m_alog.static_test(log::alevel::devel)) {
+            m_alog.write(log::alevel::devel,m_request.raw());
+            if (m_request.get_header("Sec-WebSocket-Key3") != "") {
+                m_alog.write(log::alevel::devel,
+                    utility::to_hex(m_request.get_header("Sec-WebSocket-Key3")));
+            }
+        }
+        
+        // The remaining bytes in m_buf are frame data. Copy them to the 
+        // beginning of the buffer and note the length. They will be read after
+        // the handshake completes and before more bytes are read.
+        std::copy(m_buf.begin()+bytes_processed,
+            m_buf.begin()+bytes_transferred,m_buf.begin());
+        m_buf_cursor = bytes_transferred-bytes_processed;
+        
+        this->atomic_state_change(
+            istate::READ_HTTP_REQUEST,
+            istate::PROCESS_HTTP_REQUEST,
+            "send_http_response must be called from READ_HTTP_REQUEST state"
+        );
+        
+        // We have the complete request. Process it.
+        this->process_handshake_request();
+        this->send_http_response();
+    } else {
+        // read at least 1 more byte
+        transport_con_type::async_read_at_least(
+            1,
+            &m_buf[0],
+            m_buf.size(),
+            lib::bind(
+                &type::handle_read_handshake,
+                type::shared_from_this(),
+                lib::placeholders::_1,
+                lib::placeholders::_2
+            )
+        );
+    }
+}
+
+// send_http_response requires the request to be fully read and the connection
+// to be in the PROCESS_HTTP_REQUEST state. In some cases we can detect errors
+// before the request is fully read (specifically at a point where we aren't
+// sure if the hybi00 key3 bytes need to be read). This method sets the correct
+// state and calls send_http_response
+template <typename config>
+void connection<config>::send_http_response_error() {
+    this->atomic_state_change(
+        istate::READ_HTTP_REQUEST,
+        istate::PROCESS_HTTP_REQUEST,
+        "send_http_response must be called from READ_HTTP_REQUEST state"
+    );
+    this->send_http_response();
+}
+
+// All exit paths for this function need to call send_http_response() or submit 
+// a new read request with this function as the handler.
+template <typename config>
+void connection<config>::dispatch_ready_message()
+    _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless)
+{
+    if (m_alog.static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "Complete frame received. Dispatching";
+        m_alog.write(log::alevel::devel,s.str());
+    }
+
+    message_ptr msg = this->processor_get_message();
+    this->dispatch_message(msg);
+}
+
+/// Deliver one extracted message (data to handlers, control to the
+/// control machinery); split from dispatch_ready_message so the rate
+/// limiter can extract first and decide per opcode
+template <typename config>
+void connection<config>::dispatch_message(message_ptr msg)
+    _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless)
+{
+    if (msg) {
+        // inbound wire length reconstructed from the frame grammar:
+        // base header, extended length, and the mask key clients must
+        // send (this connection is a server exactly when its peer masks)
+        size_t pl = msg->payload_size();
+        size_t wire = pl+2+(pl > 65535 ? 8 : (pl > 125 ? 2 : 0))
+            +(m_is_server ? 4 : 0);
+        m_stats->on_frame_in(static_cast<uint8_t>(msg->get_opcode()),
+            pl,wire,transport_con_type::is_secure());
+    }
+    if (config::integrity_checks && msg
+        && !is_control(msg->get_opcode()))
+    {
+        // payload bytes are hot from unmasking/validation; the CRC
+        // pass rides the cache
+        m_integrity.running_in = crc32c::extend(
+            m_integrity.running_in,msg->payload_data(),
+            msg->payload_size());
+        m_integrity.frames_in++;
+        m_integrity.bytes_in += msg->payload_size();
+    }
+    if (tracer::enabled && msg) {
+        tracer::on_message_complete(this,lib::steady_us(),
+            msg->payload_size());
+    }
+
+    if (msg) {
+        // payload_size, not get_payload: the latter would materialize a
+        // borrowed view before the handler ever sees it
+        m_stats->on_message_in(msg->payload_size());
+    }
+
+    if (!msg) {
+        m_alog.write(log::alevel::devel,
+            "null message from m_processor");
+    } else if (!is_control(msg->get_opcode())) {
+        // data message, dispatch to user
+        if (m_state != session::state::open) {
+            m_elog.write(log::elevel::warn,
+                "got non-close data frame in state closing");
+        } else if (m_handlers->message_chunk) {
+            // streaming mode: payloads normally stream through the
+            // sink and arrive here empty. A processor that does not
+            // support sinks (hybi00) still accumulates; deliver
+            // that as one chunk so no bytes are lost.
+            std::string const & residue = msg->get_payload();
+            if (!residue.empty()) {
+                m_handlers->message_chunk(m_connection_hdl,
+                    msg->get_opcode(),residue.data(),residue.size(),
+                    m_chunk_first,false);
+                m_chunk_first = false;
+            }
+            m_handlers->message_chunk(m_connection_hdl,
+                msg->get_opcode(),NULL,0,m_chunk_first,true);
+            m_chunk_first = true;
+        } else if (msg->get_opcode() == frame::opcode::binary
+            && !m_handlers->binary_routes.empty()
+            && msg->payload_size() > 0
+            && m_handlers->binary_routes[static_cast<uint8_t>(
+                *msg->payload_data())])
+        {
+            // first-byte demux: one array index replaces the
+            // application's opcode switch and type-byte dispatch
+            m_handlers->binary_routes[static_cast<uint8_t>(
+                *msg->payload_data())](m_connection_hdl,msg);
+        } else if (msg->get_opcode() == frame::opcode::text
+            && m_handlers->text_message)
+        {
+            m_handlers->text_message(m_connection_hdl,msg);
+        } else if (msg->get_opcode() == frame::opcode::binary
+            && m_handlers->binary_message)
+        {
+            m_handlers->binary_message(m_connection_hdl,msg);
+        } else if (m_handlers->batch_message) {
+            // collected; the read loop delivers the whole batch in one
+            // handler call when the buffer is drained
+            m_message_batch.push_back(msg);
+        } else if (m_handler_pool) {
+            // blocking-handler offload: serial per connection, parallel
+            // across connections; see set_handler_pool
+            this->offload_enqueue(msg);
+        } else {
+            // static or dynamic dispatch selected at compile time; the
+            // borrowed payload view is revoked when the handler returns
+            this->fire_message(msg,handler_mode());
+        }
+    } else {
+        process_control_frame(msg);
+    }
+}
+
+template <typename config>
+void connection<config>::handle_read_direct(lib::error_code const & ec,
+    size_t bytes_transferred)
+{
+    if (ec) {
+        // reuse the normal read error handling; no scratch bytes pending
+        this->handle_read_frame(ec,0);
+        return;
+    }
+
+    lib::error_code cec;
+    m_processor->consume_in_place(bytes_transferred,cec);
+
+    if (cec) {
+        if (m_elog.static_test(log::elevel::rerror)
+            && m_elog.dynamic_test(log::elevel::rerror))
+        {
+            m_elog.write(log::elevel::rerror,
+                "consume error: "+cec.message());
+        }
+        if (config::drop_on_protocol_error) {
+            this->terminate(cec);
+        } else {
+            lib::error_code close_ec;
+            this->close(processor::error::to_ws(cec),cec.message(),close_ec);
+            if (close_ec) {
+                m_elog.write(log::elevel::fatal,
+                    "Failed to send a close frame after protocol error: "
+                    +close_ec.message());
+                this->terminate(close_ec);
+            }
+        }
+        return;
+    }
+
+    if (this->processor_ready()) {
+        this->dispatch_ready_message();
+    }
+
+    // re-enter the normal read path (which may pick another direct target)
+    this->handle_read_frame(lib::error_code(),0);
+}
+
+template <typename config>
+size_t connection<config>::read_external(char * buf, size_t len,
+    lib::error_code & ec)
+{
+    ec = lib::error_code();
+    size_t total = 0;
+
+    while (total < len) {
+        if (m_state.load(lib::memory_order_relaxed)
+            != session::state::open)
+        {
+            // handshake or closing traffic goes through the transport's
+            // buffered feed; a zero return means nothing is waiting for
+            // bytes and the caller should hold the tail
+            size_t n = transport_con_type::readsome(buf+total,len-total);
+            if (n == 0) {
+                return total;
+            }
+            total += n;
+            continue;
+        }
+
+        if (m_read_paused) {
+            return total;
+        }
+
+        size_t span = len-total;
+        m_stats->on_read(span);
+
+        size_t p = 0;
+        while (p < span) {
+            lib::error_code cec;
+            p += this->processor_consume(
+                reinterpret_cast<uint8_t*>(buf+total)+p,span-p,cec);
+
+            if (cec) {
+                if (m_elog.static_test(log::elevel::rerror)
+                    && m_elog.dynamic_test(log::elevel::rerror))
+                {
+                    m_elog.write(log::elevel::rerror,
+                        "consume error: "+cec.message());
+                }
+                this->flush_message_batch();
+                if (config::drop_on_protocol_error) {
+                    this->terminate(cec);
+                } else {
+                    lib::error_code close_ec;
+                    this->close(processor::error::to_ws(cec),cec.message(),
+                        close_ec);
+                    if (close_ec) {
+                        this->terminate(close_ec);
+                    }
+                }
+                ec = cec;
+                return total+p;
+            }
+
+            if (this->processor_ready()) {
+                this->dispatch_ready_message();
+            }
+
+            // a consumed close frame flips the state mid span; route the
+            // remainder through the non-open path above
+            if (m_state.load(lib::memory_order_relaxed)
+                != session::state::open)
+            {
+                break;
+            }
+        }
+        this->flush_message_batch();
+
+        total += p;
+        if (p < span && m_state.load(lib::memory_order_relaxed)
+            == session::state::open)
+        {
+            // no progress while open should be impossible; bail rather
+            // than spin
+            return total;
+        }
+    }
+
+    return total;
+}
+
+template <typename config>
+void connection<config>::flush_message_batch() {
+    if (m_message_batch.empty()) {
+        return;
+    }
+    if (m_handlers->batch_message) {
+        this->record_dispatch_latency();
+        m_handlers->batch_message(m_connection_hdl,
+            &m_message_batch[0],m_message_batch.size());
+    }
+    for (size_t i = 0; i < m_message_batch.size(); i++) {
+        m_message_batch[i]->release_view();
+    }
+    m_message_batch.clear();
+}
+
+
+/// Advance the rate limiter's buckets by elapsed wall time
+template <typename config>
+void connection<config>::rl_refill() {
+    uint64_t now = lib::steady_us();
+    double dt = static_cast<double>(now-m_rl_last_us)/1e6;
+    m_rl_last_us = now;
+    if (m_rl_msg_rate > 0) {
+        m_rl_msg_tokens += dt*m_rl_msg_rate;
+        if (m_rl_msg_tokens > m_rl_msg_rate) {
+            m_rl_msg_tokens = m_rl_msg_rate;
+        }
+    }
+    if (m_rl_byte_rate > 0) {
+        m_rl_byte_tokens += dt*m_rl_byte_rate;
+        if (m_rl_byte_tokens > m_rl_byte_rate) {
+            m_rl_byte_tokens = m_rl_byte_rate;
+        }
+    }
+}
+
+/// Timer continuation releasing a rate-limit read pause
+template <typename config>
+void connection<config>::rl_resume(lib::error_code const & ec) {
+    if (ec) {
+        return;
+    }
+    this->resume_reading();
+}
+
+/// Mailbox producer path; see set_send_mailbox
+template <typename config>
+lib::error_code connection<config>::send_via_mailbox(message_ptr msg) {
+    if (m_state.load(lib::memory_order_relaxed) != session::state::open) {
+        return error::make_error_code(error::invalid_state);
+    }
+    if (!msg) {
+        return error::make_error_code(error::invalid_state);
+    }
+
+    mailbox_node * node = new mailbox_node();
+    node->msg = msg;
+    node->next = m_mailbox_head.load(lib::memory_order_relaxed);
+    while (!m_mailbox_head.compare_exchange_weak(node->next,node,
+        lib::memory_order_release,lib::memory_order_relaxed))
+    {}
+
+    // only the idle-to-busy transition posts a wakeup; the drain re-arms
+    if (!m_mailbox_armed.exchange(true,lib::memory_order_acq_rel)) {
+        transport_con_type::dispatch(lib::bind(
+            &type::drain_mailbox,
+            type::shared_from_this()
+        ));
+    }
+    return lib::error_code();
+}
+
+/// Mailbox consumer; io thread only
+template <typename config>
+void connection<config>::drain_mailbox() {
+    // disarm before taking the stack: an enqueue racing this point
+    // either lands in the batch below or posts its own drain
+    m_mailbox_armed.store(false,lib::memory_order_release);
+    mailbox_node * head = m_mailbox_head.exchange(0,
+        lib::memory_order_acquire);
+
+    // the stack is LIFO; reverse for send order
+    mailbox_node * fifo = 0;
+    while (head) {
+        mailbox_node * next = head->next;
+        head->next = fifo;
+        fifo = head;
+        head = next;
+    }
+
+    while (fifo) {
+        mailbox_node * next = fifo->next;
+        // the io-thread send path: prepare, queue, and (once per busy
+        // period) dispatch the writer. m_mailbox_enabled is not
+        // consulted here, so no recursion.
+        lib::error_code ec = do_direct_send(fifo->msg);
+        if (ec && m_elog.static_test(log::elevel::rerror)
+            && m_elog.dynamic_test(log::elevel::rerror))
+        {
+            m_elog.write(log::elevel::rerror,
+                "mailbox send failed: "+ec.message());
         }
-        
-        std::stringstream s;
-        s << "error in handle_read_handshake: "<< ec.message();
-        m_elog.write(log::elevel::fatal,s.str());
-        this->terminate(ec);
-        return;
+        delete fifo;
+        fifo = next;
     }
-            
-    // Boundaries checking. TODO: How much of this should be done?
-    if (bytes_transferred > config::connection_read_buffer_size) {
-        m_elog.write(log::elevel::fatal,"Fatal boundaries checking error.");
-        this->terminate(make_error_code(error::general));
-        return;
+}
+
+/// Queue a completed data message for the handler pool; io thread
+template <typename config>
+void connection<config>::offload_enqueue(message_ptr msg) {
+    // a borrowed view must own its bytes before leaving the io thread;
+    // the backing read buffer is reused by the next read
+    if (msg->is_borrowed()) {
+        msg->retain();
     }
-    
-    size_t bytes_processed = 0;
-    try {
-        bytes_processed = m_request.consume(m_buf,bytes_transferred);
-    } catch (http::exception &e) {
-        // All HTTP exceptions will result in this request failing and an error 
-        // response being returned. No more bytes will be read in this con.
-        m_response.set_status(e.m_error_code,e.m_error_msg);
-        this->send_http_response_error();
-        return;
+
+    bool start_task = false;
+    bool pause = false;
+    {
+        scoped_lock_type guard(m_offload_lock);
+        m_offload_pending.push(msg);
+        if (!m_offload_active) {
+            m_offload_active = true;
+            start_task = true;
+        }
+        if (m_offload_pending.size() >= m_offload_cap
+            && !m_offload_paused)
+        {
+            m_offload_paused = true;
+            pause = true;
+        }
     }
-    
-    // More paranoid boundaries checking. 
-    // TODO: Is this overkill?
-    if (bytes_processed > config::connection_read_buffer_size) {
-        m_elog.write(log::elevel::fatal,"Fatal boundaries checking error.");
-        this->terminate(make_error_code(error::general));
-        return;
+    if (pause) {
+        // io thread: takes effect before the next re-arm
+        this->pause_reading();
     }
-    
-    if (m_alog.static_test(log::alevel::devel)) {
-        std::stringstream s;
-        s << "bytes_transferred: " << bytes_transferred 
-          << " bytes, bytes processed: " << bytes_processed << " bytes";
-        m_alog.write(log::alevel::devel,s.str());
+    if (start_task) {
+        m_handler_pool->post(lib::bind(
+            &type::run_offload_task,
+            type::shared_from_this()
+        ));
     }
-    
-    if (m_request.ready()) {
-        if (!this->initialize_processor()) {
-            this->send_http_response_error();
+}
+
+/// One offloaded handler invocation, then chain the next; pool thread
+template <typename config>
+void connection<config>::run_offload_task() {
+    message_ptr msg;
+    {
+        scoped_lock_type guard(m_offload_lock);
+        if (m_offload_pending.empty()) {
+            m_offload_active = false;
             return;
         }
-        
-        if (m_processor && m_processor->get_version() == 0) {
-            // Version 00 has an extra requirement to read some bytes after the
-            // handshake
-            if (bytes_transferred-bytes_processed >= 8) {
-                m_request.replace_header(
-                    "Sec-WebSocket-Key3",
-                    std::string(m_buf+bytes_processed,m_buf+bytes_processed+8)
-                );
-                bytes_processed += 8;
-            } else {
-                // TODO: need more bytes
-                m_alog.write(log::alevel::devel,"short key3 read");
-                m_response.set_status(http::status_code::internal_server_error);
-                this->send_http_response_error();
-                return;
-            }
+        msg = m_offload_pending.front();
+        m_offload_pending.pop();
+    }
+
+    this->fire_message(msg,handler_mode());
+
+    bool resume = false;
+    bool more = false;
+    {
+        scoped_lock_type guard(m_offload_lock);
+        more = !m_offload_pending.empty();
+        if (!more) {
+            m_offload_active = false;
         }
-        
-        if (m_alog.static_test(log::alevel::devel)) {
-            m_alog.write(log::alevel::devel,m_request.raw());
-            if (m_request.get_header("Sec-WebSocket-Key3") != "") {
-                m_alog.write(log::alevel::devel,
-                    utility::to_hex(m_request.get_header("Sec-WebSocket-Key3")));
-            }
+        if (m_offload_paused
+            && m_offload_pending.size() <= m_offload_cap/2)
+        {
+            m_offload_paused = false;
+            resume = true;
         }
-        
-        // The remaining bytes in m_buf are frame data. Copy them to the 
-        // beginning of the buffer and note the length. They will be read after
-        // the handshake completes and before more bytes are read.
-        std::copy(m_buf+bytes_processed,m_buf+bytes_transferred,m_buf);
-        m_buf_cursor = bytes_transferred-bytes_processed;
-        
-        this->atomic_state_change(
-            istate::READ_HTTP_REQUEST,
-            istate::PROCESS_HTTP_REQUEST,
-            "send_http_response must be called from READ_HTTP_REQUEST state"
-        );
-        
-        // We have the complete request. Process it.
-        this->process_handshake_request();
-        this->send_http_response();
-    } else {
-        // read at least 1 more byte
-        transport_con_type::async_read_at_least(
-            1,
-            m_buf,
-            config::connection_read_buffer_size,
-            lib::bind(
-                &type::handle_read_handshake,
-                type::shared_from_this(),
-                lib::placeholders::_1,
-                lib::placeholders::_2
-            )
-        );
+    }
+    if (resume) {
+        // safe from the pool thread: resume posts its re-arm through
+        // the transport
+        this->resume_reading();
+    }
+    if (more) {
+        // one task at a time preserves per connection ordering
+        m_handler_pool->post(lib::bind(
+            &type::run_offload_task,
+            type::shared_from_this()
+        ));
     }
 }
 
-// send_http_response requires the request to be fully read and the connection
-// to be in the PROCESS_HTTP_REQUEST state. In some cases we can detect errors
-// before the request is fully read (specifically at a point where we aren't
-// sure if the hybi00 key3 bytes need to be read). This method sets the correct
-// state and calls send_http_response
+/// Emergency load-shedding response; see the header declaration
 template <typename config>
-void connection<config>::send_http_response_error() {
-    this->atomic_state_change(
-        istate::READ_HTTP_REQUEST,
-        istate::PROCESS_HTTP_REQUEST,
-        "send_http_response must be called from READ_HTTP_REQUEST state"
+void connection<config>::shed(std::string const & response) {
+    transport_con_type::async_write(
+        response.data(),
+        response.size(),
+        lib::bind(
+            &type::handle_shed_write,
+            type::shared_from_this(),
+            lib::placeholders::_1
+        )
     );
-    this->send_http_response();
 }
 
-// All exit paths for this function need to call send_http_response() or submit 
-// a new read request with this function as the handler.
+template <typename config>
+void connection<config>::handle_shed_write(lib::error_code const &) {
+    // shed connections terminate regardless of the write's fate; the
+    // rejected code routes them through the recycle path
+    this->terminate(error::make_error_code(error::rejected));
+}
+
+/// Continuation of a budget-yielded read loop
+/**
+ * Posted through the io_service by handle_read_frame when a fairness
+ * budget was exhausted with input still buffered; the remainder was
+ * moved to the front of the read buffer before posting.
+ */
+template <typename config>
+void connection<config>::resume_read_frame(size_t bytes)
+    _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless)
+{
+    this->handle_read_frame(lib::error_code(),bytes);
+}
+
 template <typename config>
 void connection<config>::handle_read_frame(const lib::error_code& ec, 
     size_t bytes_transferred)
+    _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless)
 {
     //m_alog.write(log::alevel::devel,"connection handle_read_frame");
+
+    // a budget-yield continuation re-enters with bytes that were already
+    // counted when the transport delivered them
+    if (bytes_transferred > 0 && !m_read_resuming) {
+        m_reads_observed++;
+        m_stats->on_read(bytes_transferred);
+        if (stats_type::timestamps) {
+            m_last_read_us = lib::steady_us();
+        }
+        if (m_rl_enabled && m_rl_byte_rate > 0) {
+            rl_refill();
+            m_rl_byte_tokens -= static_cast<double>(bytes_transferred);
+            // debt floor of one second's budget keeps a single giant
+            // read from pausing the connection for minutes
+            if (m_rl_byte_tokens < -m_rl_byte_rate) {
+                m_rl_byte_tokens = -m_rl_byte_rate;
+            }
+        }
+        if (m_rl_agg_bytes
+            && m_rl_agg_bytes->charge(m_rl_agg_key,bytes_transferred)
+            && m_rl_byte_tokens >= 0)
+        {
+            // aggregate endpoint budget exhausted: express it as local
+            // byte debt so the policy machinery below applies unchanged
+            m_rl_byte_tokens = -1;
+        }
+    }
+    m_read_resuming = false;
     
     this->atomic_state_check(
         istate::PROCESS_CONNECTION,
@@ -819,21 +2206,30 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
 			return;
         }
         
-        std::stringstream s;
-        s << "error in handle_read_frame: " << ec.message() << " (" << ec << ")";
-        m_elog.write(log::elevel::fatal,s.str());
+        if (m_elog.static_test(log::elevel::fatal)
+            && m_elog.dynamic_test(log::elevel::fatal))
+        {
+            // string construction only when something will consume it;
+            // disconnect storms hit this path once per connection
+            std::stringstream s;
+            s << "error in handle_read_frame: " << ec.message()
+              << " (" << ec << ")";
+            m_elog.write(log::elevel::fatal,s.str());
+        }
         this->terminate(ec);
         return;
     }
     
     // Boundaries checking. TODO: How much of this should be done?
-    if (bytes_transferred > config::connection_read_buffer_size) {
+    if (bytes_transferred > m_buf.size()) {
         m_elog.write(log::elevel::fatal,"Fatal boundaries checking error");
         this->terminate(make_error_code(error::general));
         return;
     }
     
     size_t p = 0;
+    size_t frames_consumed = 0;
+    uint64_t loop_start_us = m_read_budget_us ? lib::steady_us() : 0;
     
     if (m_alog.static_test(log::alevel::devel)) {
         std::stringstream s;
@@ -842,6 +2238,25 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
     }
     
     while (p < bytes_transferred) {
+        // fairness budget: when one buffer carries a dense burst of tiny
+        // frames, cap the work done inline and re-post the remainder so
+        // sibling connections on this io thread get a turn
+        if ((m_read_budget_frames
+                && frames_consumed >= m_read_budget_frames)
+            || (m_read_budget_us
+                && lib::steady_us() - loop_start_us >= m_read_budget_us))
+        {
+            this->flush_message_batch();
+            std::memmove(&m_buf[0],&m_buf[0]+p,bytes_transferred-p);
+            m_read_resuming = true;
+            transport_con_type::dispatch(lib::bind(
+                &type::resume_read_frame,
+                type::shared_from_this(),
+                bytes_transferred-p
+            ));
+            return;
+        }
+
         if (m_alog.static_test(log::alevel::devel)) {
             std::stringstream s;
             s << "calling consume with " << bytes_transferred-p << " bytes";
@@ -850,8 +2265,8 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
         
         lib::error_code ec;
 
-        p += m_processor->consume(
-            reinterpret_cast<uint8_t*>(m_buf)+p,
+        p += this->processor_consume(
+            reinterpret_cast<uint8_t*>(&m_buf[0])+p,
             bytes_transferred-p,
             ec
         );
@@ -862,7 +2277,16 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
             m_alog.write(log::alevel::devel,s.str());
         }
         if (ec) {
-            m_elog.write(log::elevel::rerror,"consume error: "+ec.message());
+            if (m_elog.static_test(log::elevel::rerror)
+                && m_elog.dynamic_test(log::elevel::rerror))
+            {
+                m_elog.write(log::elevel::rerror,
+                    "consume error: "+ec.message());
+            }
+            
+            // messages completed earlier in this buffer still belong to
+            // the application; deliver them before tearing down
+            this->flush_message_batch();
             
             if (config::drop_on_protocol_error) {
                 this->terminate(ec);
@@ -882,32 +2306,146 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
             return;
         }
 
-        if (m_processor->ready()) {
-            if (m_alog.static_test(log::alevel::devel)) {
-                std::stringstream s;
-                s << "Complete frame received. Dispatching";
-                m_alog.write(log::alevel::devel,s.str());
-            }
-            
-            message_ptr msg = m_processor->get_message();
-           
-            if (!msg) {
-                m_alog.write(log::alevel::devel,
-                    "null message from m_processor");
-            } else if (!is_control(msg->get_opcode())) {
-                // data message, dispatch to user
-                if (m_state != session::state::open) {
-                    m_elog.write(log::elevel::warn,
-                        "got non-close data frame in state closing");
-                } else if (m_message_handler) {
-                    m_message_handler(m_connection_hdl, msg);
+        if (this->processor_ready()) {
+            if (m_rl_enabled) {
+                if (m_rl_msg_rate > 0) {
+                    rl_refill();
+                    m_rl_msg_tokens -= 1.0;
+                    if (m_rl_msg_tokens < -m_rl_msg_rate) {
+                        m_rl_msg_tokens = -m_rl_msg_rate;
+                    }
+                }
+                if (m_rl_agg_msgs
+                    && m_rl_agg_msgs->charge(m_rl_agg_key,1)
+                    && m_rl_msg_tokens >= 0)
+                {
+                    m_rl_msg_tokens = -1;
+                }
+                if ((m_rl_msg_tokens < 0 || m_rl_byte_tokens < 0)
+                    && m_rl_policy == rate_limit::close)
+                {
+                    this->flush_message_batch();
+                    lib::error_code cec;
+                    this->close(close::status::policy_violation,
+                        "rate limit exceeded",cec);
+                    return;
+                }
+                if ((m_rl_msg_tokens < 0 || m_rl_byte_tokens < 0)
+                    && m_rl_policy == rate_limit::drop)
+                {
+                    // extract and discard over-limit data; control
+                    // frames always pass or the close/ping machinery
+                    // would wedge
+                    message_ptr msg = this->processor_get_message();
+                    if (msg && is_control(msg->get_opcode())) {
+                        this->dispatch_message(msg);
+                    }
+                } else {
+                    this->dispatch_ready_message();
                 }
             } else {
-                process_control_frame(msg);
+                this->dispatch_ready_message();
             }
         }
+        frames_consumed++;
     }
     
+    this->flush_message_batch();
+
+    // rate limit delay policy: with a bucket in debt, pause reads and
+    // re-arm once the refill clears the deficit; the kernel buffer then
+    // backpressures the peer via TCP
+    if (m_rl_enabled && m_rl_policy == rate_limit::delay && !m_read_paused
+        && (m_rl_msg_tokens < 0 || m_rl_byte_tokens < 0))
+    {
+        // the resume continuation re-enters with no bytes, so the debt
+        // read below would be stale without an explicit refill here
+        rl_refill();
+        // debt in a bucket with no local rate is the aggregate-limit
+        // sentinel: clear it and retry after a fixed backoff (the
+        // shared stripe refills itself on the next charge)
+        bool agg_debt = false;
+        if (m_rl_msg_rate <= 0 && m_rl_msg_tokens < 0) {
+            m_rl_msg_tokens = 0;
+            agg_debt = true;
+        }
+        if (m_rl_byte_rate <= 0 && m_rl_byte_tokens < 0) {
+            m_rl_byte_tokens = 0;
+            agg_debt = true;
+        }
+        if (m_rl_msg_tokens < 0 || m_rl_byte_tokens < 0 || agg_debt) {
+            double wait_s = agg_debt ? 0.025 : 0;
+            if (m_rl_msg_rate > 0 && m_rl_msg_tokens < 0) {
+                wait_s = -m_rl_msg_tokens/m_rl_msg_rate;
+            }
+            if (m_rl_byte_rate > 0 && m_rl_byte_tokens < 0) {
+                double b = -m_rl_byte_tokens/m_rl_byte_rate;
+                if (b > wait_s) {
+                    wait_s = b;
+                }
+            }
+            this->pause_reading();
+            m_read_withheld = true;
+            transport_con_type::set_timer(
+                static_cast<long>(wait_s*1000.0)+1,
+                lib::bind(&type::rl_resume,type::shared_from_this(),
+                    lib::placeholders::_1));
+            return;
+        }
+    }
+
+    // honor a read pause: remember that a read must be re-armed on resume
+    // and let the kernel socket buffer absorb further inbound bytes
+    if (m_read_paused) {
+        m_read_withheld = true;
+        return;
+    }
+
+    // two-phase read mode: if the processor is mid payload on a suitable
+    // frame, read the remaining bytes directly into the message's own
+    // storage, skipping the scratch buffer copy entirely
+    if (m_direct_payload_reads && m_processor) {
+        uint8_t * target;
+        size_t target_len;
+        if (m_processor->get_payload_read_target(&target,&target_len)) {
+            transport_con_type::async_read_at_least(
+                1,
+                reinterpret_cast<char *>(target),
+                target_len,
+                lib::bind(
+                    &type::handle_read_direct,
+                    type::shared_from_this(),
+                    lib::placeholders::_1,
+                    lib::placeholders::_2
+                )
+            );
+            return;
+        }
+    }
+
+    // Adapt the read buffer to the observed throughput before re-arming:
+    // grow geometrically while reads keep saturating it (cutting syscalls
+    // on hot connections), shrink back toward the configured minimum when
+    // reads run small (returning memory on idle ones). Safe here because no
+    // read is outstanding.
+    if (m_compact_requested.load(lib::memory_order_relaxed)) {
+        m_compact_requested.store(false,lib::memory_order_relaxed);
+        this->compact_now();
+    } else {
+        this->adapt_read_buffer(bytes_transferred);
+    }
+
+    if (m_raw_continuations && m_raw_read_continuation) {
+        if (m_terminating) {
+            return;
+        }
+        // the pre-built raw continuation: no refcount traffic and no
+        // fresh bind per read
+        transport_con_type::async_read_at_least(1,&m_buf[0],m_buf.size(),
+            m_raw_read_continuation);
+        return;
+    }
+
     transport_con_type::async_read_at_least(
         // std::min wont work with undefined static const values.
         // TODO: is there a more elegant way to do this?
@@ -917,8 +2455,8 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
         /*(m_processor->get_bytes_needed() > config::connection_read_buffer_size ?
          config::connection_read_buffer_size : m_processor->get_bytes_needed())*/
         1,
-        m_buf,
-        config::connection_read_buffer_size,
+        &m_buf[0],
+        m_buf.size(),
         lib::bind(
             &type::handle_read_frame,
             type::shared_from_this(),
@@ -947,6 +2485,33 @@ bool connection<config>::initialize_processor() {
     }
     
     m_processor = get_processor(version);
+    if (m_processor && m_handlers->message_chunk) {
+        m_processor->set_payload_sink(lib::bind(
+            &type::handle_message_chunk,this,
+            lib::placeholders::_1,lib::placeholders::_2,
+            lib::placeholders::_3));
+    }
+    if (m_processor && m_borrowed_messages) {
+        m_processor->set_borrowed_payloads(true);
+    }
+    if (m_processor
+        && m_validation_policy != processor::validation_policy::strict)
+    {
+        m_processor->set_validation_policy(m_validation_policy);
+    }
+    if (m_processor && !m_compression_dictionary.empty()) {
+        m_processor->set_compression_dictionary(
+            m_compression_dictionary);
+    }
+    if (m_processor
+        && (m_compress_reset_msgs > 0 || m_compress_reset_bytes > 0))
+    {
+        m_processor->set_compression_write_reset(
+            m_compress_reset_msgs,m_compress_reset_bytes);
+    }
+    if (m_processor && m_level_controller) {
+        m_processor->set_compression_level_controller(m_level_controller);
+    }
     
     // if the processor is not null we are done
     if (m_processor) {
@@ -962,7 +2527,8 @@ bool connection<config>::initialize_processor() {
     std::stringstream ss;
     std::string sep = "";
     std::vector<int>::const_iterator it;
-    for (it = versions_supported.begin(); it != versions_supported.end(); it++)
+    std::vector<int> const & versions = get_supported_versions();
+    for (it = versions.begin(); it != versions.end(); it++)
     {
         ss << sep << *it;
         sep = ",";
@@ -993,8 +2559,8 @@ bool connection<config>::process_handshake_request() {
             return false;
         }
         
-        if (m_http_handler) {
-            m_http_handler(m_connection_hdl);
+        if (m_handlers->http) {
+            m_handlers->http(m_connection_hdl);
         } else {
             set_status(http::status_code::upgrade_required);
         }
@@ -1046,16 +2612,25 @@ bool connection<config>::process_handshake_request() {
         return false;
     }
     
-    // extract subprotocols
-    lib::error_code subp_ec = m_processor->extract_subprotocols(m_request,
-        m_requested_subprotocols);
-    
-    if (subp_ec) {
-        // should we do anything?
+    // extract subprotocols. With a registered table and no validate
+    // handler nothing consults the tokenized list, so the per handshake
+    // vector/string churn is skipped and matching runs on the raw header.
+    if (!(m_subprotocol_table && !m_handlers->validate)) {
+        lib::error_code subp_ec = m_processor->extract_subprotocols(
+            m_request,m_requested_subprotocols);
+
+        if (subp_ec) {
+            // should we do anything?
+        }
     }
     
     // Ask application to validate the connection
-    if (!m_validate_handler || m_validate_handler(m_connection_hdl)) {
+    if (!m_handlers->validate || m_handlers->validate(m_connection_hdl)) {
+        if (m_subprotocol_table && m_subprotocol.empty()) {
+            // the validate handler (if any) declined to choose; pick the
+            // highest priority registered protocol the client offered
+            this->auto_select_subprotocol();
+        }
         m_response.set_status(http::status_code::switching_protocols);
         
         // Write the appropriate response headers based on request and 
@@ -1096,6 +2671,33 @@ void connection<config>::send_http_response() {
     }
     
     m_response.set_version("HTTP/1.1");
+
+    // decide HTTP persistence for plain (non upgrade) responses before the
+    // response is serialized, honoring the request's Connection semantics
+    m_http_keepalive_this = false;
+    if (m_http_keepalive_requests > 0
+        && m_response.get_status_code()
+            != http::status_code::switching_protocols
+        && m_http_requests_served + 1 < m_http_keepalive_requests
+        && m_request.ready())
+    {
+        // only fully parsed requests are eligible: after a parse failure
+        // the request boundary is unknown and the connection must close
+
+        std::string con_hdr = m_request.get_header("Connection");
+        bool wants_close = utility::ci_find_substr(con_hdr,
+            std::string("close")) != con_hdr.end();
+        bool wants_keep = utility::ci_find_substr(con_hdr,
+            std::string("keep-alive")) != con_hdr.end();
+        if (m_request.get_version() == "HTTP/1.0") {
+            m_http_keepalive_this = wants_keep;
+        } else {
+            m_http_keepalive_this = !wants_close;
+        }
+        if (m_http_keepalive_this) {
+            m_response.replace_header("Connection","keep-alive");
+        }
+    }
     
     // Set server header based on the user agent settings
     if (m_response.get_header("Server") == "") {
@@ -1108,14 +2710,76 @@ void connection<config>::send_http_response() {
     
     // have the processor generate the raw bytes for the wire (if it exists)
     if (m_processor) {
-        m_handshake_buffer = m_processor->get_raw(m_response);
+        // accepted handshakes are nearly always byte identical apart from
+        // the accept key; serve the invariant bytes from the endpoint's
+        // template cache when one negotiated the same outcome before.
+        // hybi00 responses carry a per-handshake body and are excluded.
+        bool templated = false;
+        if (m_handshake_templates
+            && m_response.get_status_code()
+                == http::status_code::switching_protocols
+            && m_processor->get_version() >= 7)
+        {
+            std::string accept =
+                m_response.get_header("Sec-WebSocket-Accept");
+            // the key is the full header block minus the accept line, so
+            // any header a handler adds or changes (cookies, per user
+            // values) naturally lands in a different template
+            std::string key;
+            m_response.serialize_headers(key);
+            std::string const marker = "Sec-WebSocket-Accept: ";
+            size_t kpos = key.find(marker+accept);
+            if (kpos != std::string::npos) {
+                key.erase(kpos,marker.size()+accept.size()+2);
+            }
+
+            lib::lock_guard<lib::mutex> guard(m_handshake_templates->lock);
+            typename handshake_template_cache::entry & e =
+                m_handshake_templates->entries[key];
+            if (!e.prefix.empty()) {
+                m_handshake_buffer.clear();
+                m_handshake_buffer.reserve(
+                    e.prefix.size()+accept.size()+e.suffix.size());
+                m_handshake_buffer.append(e.prefix);
+                m_handshake_buffer.append(accept);
+                m_handshake_buffer.append(e.suffix);
+                templated = true;
+            } else {
+                m_handshake_buffer.clear();
+                m_processor->append_raw(m_response,m_handshake_buffer);
+                // split at the accept value to build the template
+                size_t pos = m_handshake_buffer.find(marker+accept);
+                if (pos != std::string::npos) {
+                    if (m_handshake_templates->entries.size()
+                        > handshake_template_cache::max_entries)
+                    {
+                        m_handshake_templates->entries.clear();
+                    } else {
+                        pos += marker.size();
+                        e.prefix.assign(m_handshake_buffer,0,pos);
+                        e.suffix.assign(m_handshake_buffer,
+                            pos+accept.size(),std::string::npos);
+                    }
+                }
+                templated = true;
+            }
+        }
+        if (!templated) {
+            m_handshake_buffer.clear();
+            m_processor->append_raw(m_response,m_handshake_buffer);
+        }
     } else {
         // a processor wont exist for raw HTTP responses.
-        m_handshake_buffer = m_response.raw();
+        // serialize straight into the (reused) handshake buffer
+        m_handshake_buffer.clear();
+        m_response.serialize(m_handshake_buffer);
     }
     
     if (m_alog.static_test(log::alevel::devel)) {
-        m_alog.write(log::alevel::devel,"Raw Handshake response:\n"+m_handshake_buffer);
+        if (m_alog.static_test(log::alevel::devel)) {
+            m_alog.write(log::alevel::devel,
+                "Raw Handshake response:\n"+m_handshake_buffer);
+        }
         if (m_response.get_header("Sec-WebSocket-Key3") != "") {
             m_alog.write(log::alevel::devel,
                 utility::to_hex(m_response.get_header("Sec-WebSocket-Key3")));
@@ -1153,9 +2817,15 @@ void connection<config>::handle_send_http_response(
     }
     
     this->log_open_result();
+    this->release_handshake_gauge();
     
     if (m_response.get_status_code() != http::status_code::switching_protocols) 
     {
+        if (m_http_keepalive_this) {
+            m_http_requests_served++;
+            this->continue_http_keepalive();
+            return;
+        }
         if (m_processor) {
             // if this was not a websocket connection, we have written 
             // the expected response and the connection can be closed.
@@ -1172,22 +2842,80 @@ void connection<config>::handle_send_http_response(
     
     if (m_handshake_timer) {
         m_handshake_timer->cancel();
-        m_handshake_timer.reset();
+        m_handshake_timer.reset();
+    }
+    
+    this->atomic_state_change(
+        istate::PROCESS_HTTP_REQUEST,
+        istate::PROCESS_CONNECTION,
+        session::state::connecting,
+        session::state::open,
+        "handle_send_http_response must be called from PROCESS_HTTP_REQUEST state"
+    );
+    
+    m_stats->on_connection_opened();
+    m_stats->on_handshake();
+
+    this->fire_open(handler_mode());
+
+    this->handle_read_frame(lib::error_code(), m_buf_cursor);
+}
+
+/// Reset parser state and wait for the next request on a kept-alive
+/// connection
+template <typename config>
+void connection<config>::continue_http_keepalive() {
+    m_alog.write(log::alevel::devel,"connection http keep-alive continue");
+
+    // fresh parsers; the read buffer itself is reused, and any pipelined
+    // bytes already sit at its front (m_buf_cursor)
+    m_request = request_type();
+    m_request.set_arena_parse(true);
+    m_request.set_max_header_size(m_max_header_bytes);
+    m_request.set_max_header_line_size(m_max_header_line_bytes);
+    m_response = response_type();
+    m_processor.reset();
+    m_uri.reset();
+
+    this->atomic_state_change(
+        istate::PROCESS_HTTP_REQUEST,
+        istate::READ_HTTP_REQUEST,
+        "continue_http_keepalive must be called from PROCESS_HTTP_REQUEST"
+    );
+
+    // per request idle budget replaces the open handshake timer
+    if (m_handshake_timer) {
+        m_handshake_timer->cancel();
     }
-    
-    this->atomic_state_change(
-        istate::PROCESS_HTTP_REQUEST,
-        istate::PROCESS_CONNECTION,
-        session::state::connecting,
-        session::state::open,
-        "handle_send_http_response must be called from PROCESS_HTTP_REQUEST state"
+    m_handshake_timer = transport_con_type::set_timer(
+        m_http_keepalive_idle_ms,
+        lib::bind(
+            &type::handle_open_handshake_timeout,
+            type::shared_from_this(),
+            lib::placeholders::_1
+        )
     );
-    
-    if (m_open_handler) {
-        m_open_handler(m_connection_hdl);
+
+    if (m_buf_cursor > 0) {
+        // pipelined request bytes are already buffered; process them as if
+        // they had just been read
+        size_t cursor = m_buf_cursor;
+        m_buf_cursor = 0;
+        this->handle_read_handshake(lib::error_code(),cursor);
+        return;
     }
 
-    this->handle_read_frame(lib::error_code(), m_buf_cursor);
+    transport_con_type::async_read_at_least(
+        1,
+        &m_buf[0],
+        m_buf.size(),
+        lib::bind(
+            &type::handle_read_handshake,
+            type::shared_from_this(),
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        )
+    );
 }
 
 template <typename config>
@@ -1196,42 +2924,111 @@ void connection<config>::send_http_request() {
     
     // TODO: origin header?
         
-    // Have the protocol processor fill in the appropriate fields based on the
-    // selected client version
-    if (m_processor) {
+    if (!m_processor) {
+        m_elog.write(log::elevel::fatal,
+            "Internal library error: missing processor");
+        return;
+    }
+
+    // template fast path: the serialized request for this target is
+    // invariant apart from the key, so a cache hit skips both the header
+    // population and the serialization passes entirely. Only the key is
+    // recorded in m_request (validation reads nothing else from it).
+    typename client_template_cache::entry * hit = 0;
+    std::string ws_key;
+    if (m_client_templates && m_uri) {
+        ws_key = m_processor->generate_client_key();
+        if (!ws_key.empty()) {
+            m_template_key = m_uri->str();
+            for (size_t i = 0; i < m_requested_subprotocols.size(); i++) {
+                m_template_key += '\n';
+                m_template_key += m_requested_subprotocols[i];
+            }
+            lib::lock_guard<lib::mutex> guard(m_client_templates->lock);
+            typename std::map<std::string,
+                typename client_template_cache::entry>::iterator it =
+                m_client_templates->entries.find(m_template_key);
+            if (it != m_client_templates->entries.end()
+                && !it->second.prefix.empty())
+            {
+                hit = &it->second;
+                m_handshake_buffer.clear();
+                m_handshake_buffer.reserve(hit->prefix.size()
+                    +ws_key.size()+hit->suffix.size());
+                m_handshake_buffer.append(hit->prefix);
+                m_handshake_buffer.append(ws_key);
+                m_handshake_buffer.append(hit->suffix);
+            }
+        }
+    }
+
+    if (hit) {
+        m_request.replace_header("Sec-WebSocket-Key",ws_key);
+    } else {
+        // Have the protocol processor fill in the appropriate fields
+        // based on the selected client version
         lib::error_code ec;
         ec = m_processor->client_handshake_request(m_request,m_uri,
             m_requested_subprotocols);
-        
+
         if (ec) {
             m_elog.write(log::elevel::fatal,
                 "Internal library error: processor error: "+ec.message());
             return;
         }
-    } else {
-        m_elog.write(log::elevel::fatal,
-            "Internal library error: missing processor");
-        return;
-    }
-    
-    // Unless the user has overridden the user agent, send generic WS++ UA.
-    if (m_request.get_header("User-Agent") == "") {
-        if (!m_user_agent.empty()) {
-            m_request.replace_header("User-Agent",m_user_agent);
-        } else {
-            m_request.remove_header("User-Agent");
+
+        // Unless the user has overridden the user agent, send generic
+        // WS++ UA.
+        if (m_request.get_header("User-Agent") == "") {
+            if (!m_user_agent.empty()) {
+                m_request.replace_header("User-Agent",m_user_agent);
+            } else {
+                m_request.remove_header("User-Agent");
+            }
+        }
+
+        m_handshake_buffer.clear();
+        m_request.serialize(m_handshake_buffer);
+
+        if (m_client_templates && m_uri && !m_template_key.empty()) {
+            std::string const & built_key =
+                m_request.get_header("Sec-WebSocket-Key");
+            size_t pos = m_handshake_buffer.find(built_key);
+            if (pos != std::string::npos && !built_key.empty()) {
+                lib::lock_guard<lib::mutex> guard(
+                    m_client_templates->lock);
+                if (m_client_templates->entries.size()
+                    >= client_template_cache::max_entries)
+                {
+                    // a client roaming many targets: drop and rebuild
+                    // rather than grow without bound
+                    m_client_templates->entries.clear();
+                }
+                typename client_template_cache::entry & e =
+                    m_client_templates->entries[m_template_key];
+                e.prefix.assign(m_handshake_buffer,0,pos);
+                e.suffix.assign(m_handshake_buffer,
+                    pos+built_key.size(),std::string::npos);
+            }
         }
     }
-        
-    m_handshake_buffer = m_request.raw();
     
     if (m_alog.static_test(log::alevel::devel)) {
         m_alog.write(log::alevel::devel,
             "Raw Handshake request:\n"+m_handshake_buffer);
     }
     
+    // the WebSocket handshake is the last stage of the client's connect
+    // budget; cap its timeout by whatever the earlier stages left
+    long handshake_timeout = config::timeout_open_handshake;
+    {
+        long remaining = transport_con_type::remaining_connect_budget();
+        if (remaining > 0 && remaining < handshake_timeout) {
+            handshake_timeout = remaining;
+        }
+    }
     m_handshake_timer = transport_con_type::set_timer(
-        config::timeout_open_handshake,
+        handshake_timeout,
         lib::bind(
             &type::handle_open_handshake_timeout,
             type::shared_from_this(),
@@ -1274,8 +3071,8 @@ void connection<config>::handle_send_http_request(const lib::error_code& ec) {
     
     transport_con_type::async_read_at_least(
         1,
-        m_buf,
-        config::connection_read_buffer_size,
+        &m_buf[0],
+        m_buf.size(),
         lib::bind(
             &type::handle_read_http_response,
             type::shared_from_this(),
@@ -1302,18 +3099,21 @@ void connection<config>::handle_read_http_response(const lib::error_code& ec,
         this->terminate(ec);
         return;
     }
-    size_t bytes_processed = 0;
-    // TODO: refactor this to use error codes rather than exceptions
-    try {
-        bytes_processed = m_response.consume(m_buf,bytes_transferred);
-    } catch (http::exception & e) {
+    lib::error_code pec;
+    size_t bytes_processed = m_response.consume(&m_buf[0],
+        bytes_transferred,pec);
+    if (pec) {
         m_elog.write(log::elevel::rerror,
-            std::string("error in handle_read_http_response: ")+e.what());
+            "error in handle_read_http_response: "
+            +m_response.get_parse_error_msg());
         this->terminate(make_error_code(error::general));
         return;
     }
     
-    m_alog.write(log::alevel::devel,std::string("Raw response: ")+m_response.raw());
+    if (m_alog.static_test(log::alevel::devel)) {
+        m_alog.write(log::alevel::devel,
+            std::string("Raw response: ")+m_response.raw());
+    }
     
     if (m_response.headers_ready()) {
         lib::error_code ec = m_processor->validate_server_handshake_response(
@@ -1344,23 +3144,25 @@ void connection<config>::handle_read_http_response(const lib::error_code& ec,
         }
 
         this->log_open_result();
-        
-        if (m_open_handler) {
-            m_open_handler(m_connection_hdl);
-        }
+
+        m_stats->on_connection_opened();
+        m_stats->on_handshake();
+
+        this->fire_open(handler_mode());
 
         // The remaining bytes in m_buf are frame data. Copy them to the 
         // beginning of the buffer and note the length. They will be read after
         // the handshake completes and before more bytes are read.
-        std::copy(m_buf+bytes_processed,m_buf+bytes_transferred,m_buf);
+        std::copy(m_buf.begin()+bytes_processed,
+            m_buf.begin()+bytes_transferred,m_buf.begin());
         m_buf_cursor = bytes_transferred-bytes_processed;
         
         this->handle_read_frame(lib::error_code(), m_buf_cursor);
     } else {
         transport_con_type::async_read_at_least(
             1,
-            m_buf,
-            config::connection_read_buffer_size,
+            &m_buf[0],
+            m_buf.size(),
             lib::bind(
                 &type::handle_read_http_response,
                 type::shared_from_this(),
@@ -1407,6 +3209,16 @@ void connection<config>::handle_close_handshake_timeout(
 
 template <typename config>
 void connection<config>::terminate(const lib::error_code & ec) {
+    // raw continuation chains check this before re-arming or re-posting,
+    // so nothing raw-bound is queued after the anchor release below
+    m_terminating = true;
+
+    // a connection torn down mid-handshake frees its gauge slot here
+    this->release_handshake_gauge();
+
+    // undelivered mailbox entries are dropped with the connection
+    this->clear_mailbox();
+
     if (m_alog.static_test(log::alevel::devel)) {
         m_alog.write(log::alevel::devel,"connection terminate");
     }
@@ -1416,12 +3228,23 @@ void connection<config>::terminate(const lib::error_code & ec) {
         m_handshake_timer->cancel();
         m_handshake_timer.reset();
     }
+    if (m_ping_timer) {
+        m_ping_timer->cancel();
+        m_ping_timer.reset();
+    }
+    // revoke anything else scheduled for this connection (keepalive
+    // pongs, proxy timeouts) in one grouped operation where the
+    // transport supports it
+    transport_con_type::cancel_timers();
 
     terminate_status tstat = unknown;
     if (ec) {
         m_ec = ec;
         m_local_close_code = close::status::abnormal_close;
-        m_local_close_reason = ec.message();
+        // reason text materializes lazily from m_ec when something
+        // actually reads it; see get_local_close_reason
+        m_local_close_reason.clear();
+        m_close_reason_deferred = true;
     }
     
     if (m_state == session::state::connecting) {
@@ -1461,14 +3284,10 @@ void connection<config>::handle_terminate(terminate_status tstat,
     
     // clean shutdown
     if (tstat == failed) {
-        if (m_fail_handler) {
-            m_fail_handler(m_connection_hdl);
-        }
+        this->fire_fail(handler_mode());
         log_fail_result();
     } else if (tstat == closed) {
-        if (m_close_handler) {
-            m_close_handler(m_connection_hdl);
-        }
+        this->fire_close(handler_mode());
         log_close_result();
     } else {
         m_elog.write(log::elevel::rerror,"Unknown terminate_status");
@@ -1478,92 +3297,194 @@ void connection<config>::handle_terminate(terminate_status tstat,
     // if it exists it might (but shouldn't) refer to a bad memory location. 
     // If it does, we don't care and should catch and ignore it.
     if (m_termination_handler) {
-        try {
-            m_termination_handler(type::shared_from_this());
-        } catch (const std::exception& e) {
-            m_elog.write(log::elevel::warn,
-                std::string("termination_handler call failed. Reason was: ")
-                +e.what());
-        }
+        this->invoke_termination_handler(
+            exception_profile_tag<config::exceptionless>());
+    }
+
+    if (m_self) {
+        // drop the raw mode anchor via a post so any canceled completions
+        // already queued on the io thread run (with the object alive)
+        // first; the bound shared_ptr keeps the connection valid through
+        // the release itself
+        transport_con_type::dispatch(lib::bind(
+            &type::release_self,
+            type::shared_from_this()
+        ));
     }
 }
 
 template <typename config>
-void connection<config>::write_frame() {
+void connection<config>::release_self() {
+    // only the anchor: the cached continuations stay valid in case a
+    // straggler completion queued before this post still references them
+    m_self.reset();
+}
+
+template <typename config>
+void connection<config>::write_frame()
+    _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless)
+{
     //m_alog.write(log::alevel::devel,"connection write_frame");
     
-    {
-        scoped_lock_type lock(m_write_lock);
-        
-        // Check the write flag. If true, there is an outstanding transport
-        // write already. In this case we just return. The write handler will
-        // start a new write if the write queue isn't empty. If false, we set
-        // the write flag and proceed to initiate a transport write.
-        if (m_write_flag) {
-            return;
-        }
-        
-        // Get the next message in the queue. This will return an empty
-        // message if the queue was empty.
-        m_current_msg = write_pop();
-        
-        if (!m_current_msg) {
-            return;
+    // Claim the writer role and the next message in one operation. This
+    // returns an empty message if another write is outstanding (the write
+    // handler will start a new write when it completes) or if the queue is
+    // empty. On success we own the writer role until the write finishes or
+    // errors.
+    message_ptr first = m_send_queue.pop_for_write();
+    
+    if (!first) {
+        return;
+    }
+
+    // stale messages (per message TTL) are discarded at dequeue and
+    // counted rather than written; one timestamp covers the whole batch
+    uint64_t now_ms = lib::steady_ms();
+    while (first && first->expired(now_ms)) {
+        m_stats->on_message_expired();
+        first = m_send_queue.pop_more();
+    }
+    if (!first) {
+        // everything claimed was stale; release the writer role (and
+        // start a fresh write if new messages arrived meanwhile). The
+        // expiries may have drained the queue below the low watermark,
+        // so run the drain check that a normal write completion would.
+        bool more = m_send_queue.write_complete();
+        this->check_send_drain();
+        if (more) {
+            transport_con_type::dispatch(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
         }
-        
-        // At this point we own the next message to be sent and are 
-        // responsible for holding the write flag until it is successfully
-        // sent or there is some error
-        m_write_flag = true;
+        return;
     }
 
-    const std::string& header = m_current_msg->get_header();
-    const std::string& payload = m_current_msg->get_payload();
+    // Drain additional queued messages (up to the batch byte budget, and
+    // never past a terminal message) into the same gather write so a burst
+    // of small sends becomes a single transport write.
+    m_current_msgs.push_back(first);
+    size_t batch_bytes = first->get_header().size() +
+        first->get_payload().size();
+    bool terminal = first->get_terminal();
 
-    m_send_buffer.push_back(transport::buffer(header.c_str(),header.size()));
-    m_send_buffer.push_back(transport::buffer(payload.c_str(),payload.size()));
-    
-    
-    if (m_alog.static_test(log::alevel::frame_header)) {
-    if (m_alog.dynamic_test(log::alevel::frame_header)) {
-        std::stringstream s;
-        s << "Dispatching write with " << header.size() 
-          << " header bytes and " << payload.size() 
-          << " payload bytes" << std::endl;
-        m_alog.write(log::alevel::frame_header,s.str());
-        m_alog.write(log::alevel::frame_header,"Header: "+utility::to_hex(header));
+    while (!terminal && batch_bytes < write_batch_bytes) {
+        message_ptr next = m_send_queue.pop_more();
+        if (!next) {
+            break;
+        }
+        if (next->expired(now_ms)) {
+            m_stats->on_message_expired();
+            continue;
+        }
+        m_current_msgs.push_back(next);
+        batch_bytes += next->get_header().size()+next->get_payload().size();
+        terminal = next->get_terminal();
     }
+
+    for (size_t i = 0; i < m_current_msgs.size(); i++) {
+        std::string const & header = m_current_msgs[i]->get_header();
+        std::string const & payload = m_current_msgs[i]->get_payload();
+
+        if (config::integrity_checks) {
+            m_integrity.running_out = crc32c::extend(
+                m_integrity.running_out,payload.data(),payload.size());
+            m_integrity.frames_out++;
+            m_integrity.bytes_out += payload.size();
+        }
+
+        // opcode from the serialized header: prepared messages carry
+        // their frame in header+payload form and the message object's
+        // own opcode field is not authoritative for the wire
+        m_stats->on_frame_out(
+            header.empty() ? 0
+                : static_cast<uint8_t>(header[0]) & 0x0f,
+            payload.size(),header.size()+payload.size(),
+            transport_con_type::is_secure());
+
+        m_send_buffer.push_back(transport::buffer(header.c_str(),
+            header.size()));
+        m_send_buffer.push_back(transport::buffer(payload.c_str(),
+            payload.size()));
+
+        if (m_alog.static_test(log::alevel::frame_header)) {
+        if (m_alog.dynamic_test(log::alevel::frame_header)) {
+            std::stringstream s;
+            s << "Dispatching write with " << header.size() 
+              << " header bytes and " << payload.size() 
+              << " payload bytes" << std::endl;
+            m_alog.write(log::alevel::frame_header,s.str());
+            m_alog.write(log::alevel::frame_header,"Header: "+utility::to_hex(header));
+        }
+        }
+        if (m_alog.static_test(log::alevel::frame_payload)) {
+        if (m_alog.dynamic_test(log::alevel::frame_payload)) {
+            m_alog.write(log::alevel::frame_payload,"Payload: "+utility::to_hex(payload));
+        }
+        }
     }
-    if (m_alog.static_test(log::alevel::frame_payload)) {
-    if (m_alog.dynamic_test(log::alevel::frame_payload)) {
-        m_alog.write(log::alevel::frame_payload,"Payload: "+utility::to_hex(payload));
+    
+    m_stats->on_write(batch_bytes,m_current_msgs.size());
+
+    if (tracer::enabled) {
+        tracer::on_dequeue(this,lib::steady_us(),m_current_msgs.size());
     }
+
+    // bytes still queued behind this write are the transport's signal to
+    // widen the kernel send buffer if autotuning is configured
+    transport_con_type::hint_buffered_amount(m_send_queue.bytes());
+
+    if (m_raw_continuations && !m_terminating) {
+        // small-object completion; the m_self anchor pins the connection
+        raw_write_complete_functor f = { this, terminal };
+        transport_con_type::async_write(m_send_buffer,f);
+    } else {
+        transport_con_type::async_write(
+            m_send_buffer,
+            lib::bind(
+                &type::handle_write_frame,
+                type::shared_from_this(),
+                terminal,
+                lib::placeholders::_1
+            )
+        );
     }
-    
-    transport_con_type::async_write(
-        m_send_buffer,
-        lib::bind(
-            &type::handle_write_frame,
-            type::shared_from_this(),
-            m_current_msg->get_terminal(),
-            lib::placeholders::_1
-        )
-    );
 }
 
 template <typename config>
 void connection<config>::handle_write_frame(bool terminate, 
     const lib::error_code& ec)
+    _WEBSOCKETPP_COND_NOEXCEPT_(config::exceptionless)
 {
+    if (tracer::enabled) {
+        tracer::on_write_complete(this,lib::steady_us(),
+            m_current_msgs.size());
+    }
     if (m_alog.static_test(log::alevel::devel)) {
         m_alog.write(log::alevel::devel,"connection handle_write_frame");
     }
 
+    if (stats_type::timestamps) {
+        // queue-to-wire latency for every message in the completed batch
+        uint64_t now = lib::steady_us();
+        for (size_t i = 0; i < m_current_msgs.size(); i++) {
+            uint64_t t = m_current_msgs[i]->get_enqueued_us();
+            if (t != 0 && now >= t) {
+                m_stats->on_queue_to_wire(now-t);
+            }
+        }
+    }
+
     m_send_buffer.clear();
-    m_current_msg.reset();
+    m_current_msgs.clear();
 
     if (ec) {
-        m_elog.write(log::elevel::fatal,"error in handle_write_frame: "+ec.message());
+        if (m_elog.static_test(log::elevel::fatal)
+            && m_elog.dynamic_test(log::elevel::fatal))
+        {
+            m_elog.write(log::elevel::fatal,
+                "error in handle_write_frame: "+ec.message());
+        }
         this->terminate(ec);
         return;
     }
@@ -1574,43 +3495,52 @@ void connection<config>::handle_write_frame(bool terminate,
     }
 
     bool needs_writing = false;
-    {
-        scoped_lock_type lock(m_write_lock);
-        
-        // release write flag
-        m_write_flag = false;
-        
-        needs_writing = !m_send_queue.empty();
-    }
+    // release the writer role; start another write if messages are queued
+    needs_writing = m_send_queue.write_complete();
+
+    this->check_send_drain();
 
     if (needs_writing) {
-        transport_con_type::dispatch(lib::bind(
-            &type::write_frame,
-            type::shared_from_this()
-        ));
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
+    }
+
+    // the transport drained a frame; pull the next streamed chunk, keeping
+    // at most one chunk queued ahead of the socket
+    if (m_stream_active) {
+        this->stream_pull_next();
     }
 }
 
 template <typename config>
 void connection<config>::atomic_state_change(istate_type req, 
-    istate_type dest, std::string msg)
+    istate_type dest, char const * msg)
 {
-    scoped_lock_type lock(m_connection_state_lock);
-
-    if (m_internal_state != req) {
+    // single word CAS transition; no lock needed
+    istate_type expected = req;
+    if (!m_internal_state.compare_exchange_strong(expected,dest)) {
         throw error::make_error_code(error::invalid_state);
         //throw exception(msg,error::INVALID_STATE);
     }
-    
-    m_internal_state = dest;
 }
 
 template <typename config>
 void connection<config>::atomic_state_change(
     istate_type internal_req, istate_type internal_dest, 
     session::state::value external_req, session::state::value external_dest,
-    std::string msg)
+    char const * msg)
 {
+    // the two-field transition keeps the mutex: the internal and external
+    // words must change together
     scoped_lock_type lock(m_connection_state_lock);
 
     if (m_internal_state != internal_req || m_state != external_req) {
@@ -1624,11 +3554,9 @@ void connection<config>::atomic_state_change(
 
 template <typename config>
 void connection<config>::atomic_state_check(istate_type req,
-    std::string msg)
+    char const * msg)
 {
-    scoped_lock_type lock(m_connection_state_lock);
-
-    if (m_internal_state != req) {
+    if (m_internal_state.load() != req) {
         throw error::make_error_code(error::invalid_state);
         //throw exception(msg,error::INVALID_STATE);
     }
@@ -1637,6 +3565,16 @@ void connection<config>::atomic_state_check(istate_type req,
 template <typename config>
 const std::vector<int>& connection<config>::get_supported_versions() const
 {
+    if (processor_selector::fixed) {
+        // only the compile time selected processor's version is acceptable
+        static std::vector<int> const fixed_version(1,
+            make_fixed_processor_version());
+        return fixed_version;
+    }
+    if (!processor::legacy_versions<config>::value) {
+        static std::vector<int> const rfc_only(1,13);
+        return rfc_only;
+    }
     return versions_supported;
 }
 
@@ -1665,8 +3603,8 @@ void connection<config>::process_control_frame(typename
     if (op == frame::opcode::PING) {
         bool pong = true;
         
-        if (m_ping_handler) {
-            pong = m_ping_handler(m_connection_hdl, msg->get_payload());
+        if (m_handlers->ping) {
+            pong = m_handlers->ping(m_connection_hdl, msg->get_payload());
         }
 
         if (pong) {
@@ -1677,8 +3615,44 @@ void connection<config>::process_control_frame(typename
             }
         }
     } else if (op == frame::opcode::PONG) {
-        if (m_pong_handler) {
-            m_pong_handler(m_connection_hdl, msg->get_payload());
+        m_pong_count.fetch_add(1,lib::memory_order_relaxed);
+        std::string const & pl = msg->get_payload();
+        if (pl.size() == 25 && pl.compare(0,9,"wspp-rtt:") == 0) {
+            // echo of a stamped ping: fold the measured round trip into
+            // the io-thread owned statistics, no lock or map involved
+            uint64_t sent = 0;
+            bool valid = true;
+            for (size_t i = 9; i < 25; i++) {
+                char c = pl[i];
+                sent <<= 4;
+                if (c >= '0' && c <= '9') {
+                    sent |= static_cast<uint64_t>(c-'0');
+                } else if (c >= 'a' && c <= 'f') {
+                    sent |= static_cast<uint64_t>(c-'a'+10);
+                } else {
+                    valid = false;
+                    break;
+                }
+            }
+            uint64_t now = lib::steady_us();
+            if (valid && now >= sent) {
+                uint64_t rtt = now-sent;
+                if (m_rtt.samples == 0) {
+                    m_rtt.min_us = rtt;
+                    m_rtt.max_us = rtt;
+                    m_rtt.ewma_us = static_cast<double>(rtt);
+                } else {
+                    if (rtt < m_rtt.min_us) { m_rtt.min_us = rtt; }
+                    if (rtt > m_rtt.max_us) { m_rtt.max_us = rtt; }
+                    m_rtt.ewma_us += (static_cast<double>(rtt)
+                        - m_rtt.ewma_us)/8.0;
+                }
+                m_rtt.last_us = rtt;
+                m_rtt.samples++;
+            }
+        }
+        if (m_handlers->pong) {
+            m_handlers->pong(m_connection_hdl, pl);
         }
         if (m_ping_timer) {
             m_ping_timer->cancel();
@@ -1709,7 +3683,17 @@ void connection<config>::process_control_frame(typename
             return;
         }
         
-        m_remote_close_reason = close::extract_reason(msg->get_payload(),ec);
+        // validate in place, copy only when a reason is present: mass
+        // disconnects with bare codes stay allocation free
+        if (!close::reason_valid(msg->get_payload())
+            && m_validation_policy
+                != processor::validation_policy::trusted_skip)
+        {
+            ec = error::make_error_code(error::invalid_utf8);
+        } else if (msg->get_payload().size() > 2) {
+            m_remote_close_reason.assign(
+                msg->get_payload(),2,std::string::npos);
+        }
         if (ec) {
             if (config::drop_on_protocol_error) {
                 m_elog.write(log::elevel::devel,
@@ -1729,10 +3713,14 @@ void connection<config>::process_control_frame(typename
         }
 
         if (m_state == session::state::open) {
-            std::stringstream s;
-            s << "Received close frame with code " << m_remote_close_code 
-              << " and reason " << m_remote_close_reason;
-            m_alog.write(log::alevel::devel,s.str());
+            if (m_alog.static_test(log::alevel::devel)) {
+            if (m_alog.dynamic_test(log::alevel::devel)) {
+                std::stringstream s;
+                s << "Received close frame with code " << m_remote_close_code 
+                  << " and reason " << m_remote_close_reason;
+                m_alog.write(log::alevel::devel,s.str());
+            }
+            }
             
             ec = send_close_ack();
             if (ec) {
@@ -1788,23 +3776,28 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
         m_alog.write(log::alevel::devel,"closing silently");
         m_local_close_code = close::status::no_status;
         m_local_close_reason = "";
+        m_close_reason_deferred = false;
     } else if (code != close::status::blank) {
         m_alog.write(log::alevel::devel,"closing with specified codes");
         m_local_close_code = code;
         m_local_close_reason = reason;
+        m_close_reason_deferred = false;
     } else if (!ack) {
         m_alog.write(log::alevel::devel,"closing with no status code");
         m_local_close_code = close::status::no_status;
         m_local_close_reason = "";
+        m_close_reason_deferred = false;
     } else if (m_remote_close_code == close::status::no_status) {
         m_alog.write(log::alevel::devel,
             "acknowledging a no-status close with normal code");
         m_local_close_code = close::status::normal;
         m_local_close_reason = "";
+        m_close_reason_deferred = false;
     } else {
         m_alog.write(log::alevel::devel,"acknowledging with remote codes");
         m_local_close_code = m_remote_close_code;
         m_local_close_reason = m_remote_close_reason;
+        m_close_reason_deferred = false;
     }
     
     std::stringstream s;
@@ -1812,22 +3805,55 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
       << m_local_close_reason;
     m_alog.write(log::alevel::devel,s.str());
     
-    message_ptr msg = m_msg_manager->get_message();
-    if (!msg) {
-        return error::make_error_code(error::no_outgoing_buffers);
-    }
+    message_ptr msg;
 
-    lib::error_code ec = m_processor->prepare_close(m_local_close_code,
-        m_local_close_reason,msg);
-    if (ec) {
-        return ec;
-    }
-    
-    // Messages flagged terminal will result in the TCP connection being dropped
-    // after the message has been written. This is typically used when servers 
-    // send an ack and when any endpoint encounters a protocol error
-    if (terminal) {
-        msg->set_terminal(true);
+    // the common server closes (status code, empty reason) produce
+    // identical unmasked frames; serve them from the endpoint's cache,
+    // prepared once per (code, terminal) pair. Client frames carry a
+    // fresh mask and draft processors use different close framing, so
+    // both take the uncached path.
+    if (m_close_frames && m_is_server && m_local_close_reason.empty()
+        && m_processor && m_processor->get_version() >= 7)
+    {
+        uint32_t key = (static_cast<uint32_t>(m_local_close_code) << 1)
+            | (terminal ? 1u : 0u);
+        lib::lock_guard<lib::mutex> guard(m_close_frames->lock);
+        message_ptr & slot = m_close_frames->frames[key];
+        if (!slot) {
+            message_ptr fresh = msg_manager()->get_message();
+            if (!fresh) {
+                return error::make_error_code(error::no_outgoing_buffers);
+            }
+            lib::error_code ec = m_processor->prepare_close(
+                m_local_close_code,m_local_close_reason,fresh);
+            if (ec) {
+                return ec;
+            }
+            if (terminal) {
+                fresh->set_terminal(true);
+            }
+            slot = fresh;
+        }
+        msg = slot;
+    } else {
+        msg = msg_manager()->get_message();
+        if (!msg) {
+            return error::make_error_code(error::no_outgoing_buffers);
+        }
+
+        lib::error_code ec = m_processor->prepare_close(m_local_close_code,
+            m_local_close_reason,msg);
+        if (ec) {
+            return ec;
+        }
+
+        // Messages flagged terminal will result in the TCP connection
+        // being dropped after the message has been written. This is
+        // typically used when servers send an ack and when any endpoint
+        // encounters a protocol error
+        if (terminal) {
+            msg->set_terminal(true);
+        }
     }
     
     m_state = session::state::closing;
@@ -1847,18 +3873,20 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
         )    
     );
     
-    bool needs_writing = false;
-    {
-        scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
-    }
+    bool needs_writing = m_send_queue.push_priority(msg);
     
     if (needs_writing) {
-        transport_con_type::dispatch(lib::bind(
-            &type::write_frame,
-            type::shared_from_this()
-        ));
+        if (m_raw_continuations && m_raw_write_continuation) {
+            if (!m_terminating) {
+                transport_con_type::dispatch_affine(
+                    m_raw_write_continuation);
+            }
+        } else {
+            transport_con_type::dispatch_affine(lib::bind(
+                &type::write_frame,
+                type::shared_from_this()
+            ));
+        }
     }
 
     return lib::error_code();
@@ -1867,92 +3895,85 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
 template <typename config>
 typename connection<config>::processor_ptr
 connection<config>::get_processor(int version) const {
-    // TODO: allow disabling certain versions
+    if (processor_selector::fixed) {
+        // the config fixed the processor at compile time; construct it and
+        // reject handshakes for any other protocol version
+        return make_fixed_processor(version,processor_mode());
+    }
+
+    if (version == 13) {
+        return processor_ptr(
+            new processor::hybi13<config>(
+                transport_con_type::is_secure(),
+                m_is_server,
+                msg_manager(),
+                m_rng
+            )
+        );
+    }
+
+    // draft protocol versions, compiled out when the config disables them
+    return make_legacy_processor(version,
+        legacy_versions_tag<processor::legacy_versions<config>::value>());
+}
+
+#ifndef WEBSOCKETPP_NO_LEGACY_PROCESSORS
+template <typename config>
+typename connection<config>::processor_ptr
+connection<config>::make_legacy_processor(int version,
+    legacy_versions_tag<true>) const
+{
     switch (version) {
         case 0:
             return processor_ptr(
                 new processor::hybi00<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
-                    m_msg_manager
+                    msg_manager()
                 )
             );
-            break;
         case 7:
             return processor_ptr(
                 new processor::hybi07<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
-                    m_msg_manager,
+                    msg_manager(),
                     m_rng
                 )
             );
-            break;
         case 8:
             return processor_ptr(
                 new processor::hybi08<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
-                    m_msg_manager,
-                    m_rng
-                )
-            );
-            break;
-        case 13:
-            return processor_ptr(
-                new processor::hybi13<config>(
-                    transport_con_type::is_secure(),
-                    m_is_server,
-                    m_msg_manager,
+                    msg_manager(),
                     m_rng
                 )
             );
-            break;
         default:
             return processor_ptr();
     }
 }
+#endif // WEBSOCKETPP_NO_LEGACY_PROCESSORS
 
 template <typename config>
-void connection<config>::write_push(typename config::message_type::ptr msg)
+typename connection<config>::processor_ptr
+connection<config>::make_legacy_processor(int,
+    legacy_versions_tag<false>) const
 {
-    if (!msg) {
-        return;
-    }
-    
-    m_send_buffer_size += msg->get_payload().size();
-    m_send_queue.push(msg);
-    
-    std::stringstream s;
-    s << "write_push: message count: " << m_send_queue.size()
-      << " buffer size: " << m_send_buffer_size;
-    m_alog.write(log::alevel::devel,s.str());
+    // draft versions disabled; the handshake response advertises 13 only
+    return processor_ptr();
 }
 
 template <typename config>
-typename config::message_type::ptr connection<config>::write_pop()
+void connection<config>::log_open_result()
 {
-    message_ptr msg;
-    
-    if (m_send_queue.empty()) {
-        return msg;
+    if (!m_alog.static_test(log::alevel::connect)
+        || !m_alog.dynamic_test(log::alevel::connect))
+    {
+        return;
     }
-    
-    msg = m_send_queue.front();
-    
-    m_send_buffer_size -= msg->get_payload().size();
-    m_send_queue.pop();
-    
-    std::stringstream s;
-    s << "write_pop: message count: " << m_send_queue.size()
-      << " buffer size: " << m_send_buffer_size;
-    m_alog.write(log::alevel::devel,s.str());
-    return msg;
-}
 
-template <typename config>
-void connection<config>::log_open_result()
-{
     std::stringstream s;
     
     int version;
@@ -1994,6 +4015,12 @@ void connection<config>::log_open_result()
 template <typename config>
 void connection<config>::log_close_result()
 {
+    if (!m_alog.static_test(log::alevel::disconnect)
+        || !m_alog.dynamic_test(log::alevel::disconnect))
+    {
+        return;
+    }
+
     std::stringstream s;
     
     s << "Disconnect "
@@ -2010,7 +4037,11 @@ void connection<config>::log_fail_result()
 {
     // TODO: include more information about the connection?
     // should this be filed under connect rather than disconnect?
-    m_alog.write(log::alevel::disconnect,"Failed: "+m_ec.message());
+    if (m_alog.static_test(log::alevel::disconnect)
+        && m_alog.dynamic_test(log::alevel::disconnect))
+    {
+        m_alog.write(log::alevel::disconnect,"Failed: "+m_ec.message());
+    }
 }
 
 } // namespace websocketpp
@@ -40,9 +40,31 @@ endpoint<connection,config>::create_connection() {
         return connection_ptr();
     }*/
     
-    // Create a connection on the heap and manage it using a shared pointer
-    connection_ptr con(new connection_type(m_is_server,m_user_agent,m_alog,
-        m_elog, m_rng));
+    // Create a connection on the heap and manage it using a shared pointer.
+    // With pooling enabled, a recycled instance is reset and re-wrapped (a
+    // fresh control block, so handles from the previous session stay
+    // expired); otherwise allocate as usual.
+    connection_ptr con;
+    if (m_con_pool && m_con_pool->hwm > 0) {
+        connection_type * raw = NULL;
+        {
+            scoped_lock_type guard(m_con_pool->lock);
+            if (!m_con_pool->idle.empty()) {
+                raw = m_con_pool->idle.back();
+                m_con_pool->idle.pop_back();
+            }
+        }
+        if (raw) {
+            raw->reset_for_reuse();
+        } else {
+            raw = new connection_type(m_is_server,m_user_agent,m_alog,
+                m_elog,m_rng);
+        }
+        con.reset(raw,con_recycler(m_con_pool));
+    } else {
+        con.reset(new connection_type(m_is_server,m_user_agent,m_alog,
+            m_elog,m_rng));
+    }
     
     connection_weak_ptr w(con);
     
@@ -54,18 +76,66 @@ endpoint<connection,config>::create_connection() {
 
     //
     con->set_handle(w);
+    con->set_max_read_buffer_size(m_max_read_buffer_size);
+    con->set_max_outgoing_frame_size(m_max_outgoing_frame_size);
+    con->set_read_loop_budget(m_read_budget_frames,m_read_budget_us);
+    if (m_rl_msg_rate > 0 || m_rl_byte_rate > 0) {
+        con->set_rate_limit(m_rl_msg_rate,m_rl_byte_rate,m_rl_policy);
+    }
+    if (m_rl_agg_msgs || m_rl_agg_bytes) {
+        con->set_aggregate_buckets(m_rl_agg_msgs,m_rl_agg_bytes);
+    }
+    con->set_borrowed_messages(m_borrowed_messages);
+    con->set_validation_policy(m_validation_policy);
+    con->set_raw_continuations(m_raw_continuations_default);
+    if (!m_compression_dictionary.empty()) {
+        con->set_compression_dictionary(m_compression_dictionary);
+    }
+    if (m_compress_reset_msgs > 0 || m_compress_reset_bytes > 0) {
+        con->set_compression_write_reset(
+            m_compress_reset_msgs,m_compress_reset_bytes);
+    }
+    if (m_level_controller) {
+        con->set_compression_level_controller(m_level_controller);
+    }
+    if (m_prescreen) {
+        con->set_prescreen_handler(m_prescreen);
+    }
+    if (m_subprotocols) {
+        con->set_subprotocol_table(m_subprotocols);
+    }
+    if (m_is_server) {
+        if (!m_handshake_templates) {
+            m_handshake_templates.reset(
+                new typename connection_type::handshake_template_cache());
+        }
+        con->set_handshake_template_cache(m_handshake_templates);
+        if (!m_close_frames) {
+            m_close_frames.reset(
+                new typename connection_type::close_frame_cache());
+        }
+        con->set_close_frame_cache(m_close_frames);
+    } else {
+        if (!m_client_templates) {
+            m_client_templates.reset(
+                new typename connection_type::client_template_cache());
+        }
+        con->set_client_template_cache(m_client_templates);
+    }
+    // start the keepalive quiet period from now, not from tick zero
+    con->get_keepalive_state().last_ping_tick = m_ka_tick;
+    if (m_ka_enabled) {
+        con->set_swept_pong_timeouts(true);
+    }
+    con->set_stats(m_stats);
+    if (m_compression_pool) {
+        con->set_compression_pool(m_compression_pool);
+    }
     
-    // Copy default handlers from the endpoint
-    con->set_open_handler(m_open_handler);
-    con->set_close_handler(m_close_handler);
-    con->set_fail_handler(m_fail_handler);
-    con->set_ping_handler(m_ping_handler);
-    con->set_pong_handler(m_pong_handler);
-    con->set_pong_timeout_handler(m_pong_timeout_handler);
-    con->set_interrupt_handler(m_interrupt_handler);
-    con->set_http_handler(m_http_handler);
-    con->set_validate_handler(m_validate_handler);
-    con->set_message_handler(m_message_handler);
+    // Reference the endpoint's shared handler table; one pointer copy
+    // instead of a dozen lib::function copies. Per connection overrides
+    // copy-on-write.
+    con->set_handler_table(m_handler_table);
     
     con->set_termination_handler(
         lib::bind(
@@ -83,8 +153,15 @@ endpoint<connection,config>::create_connection() {
         return connection_ptr();
     }
     
-    scoped_lock_type lock(m_mutex);
-    m_connections.insert(con);
+    {
+        lib::shared_ptr<con_shard> shard = m_con_shards[
+            reinterpret_cast<uintptr_t>(con.get())/64 % m_con_shards.size()];
+        scoped_lock_type lock(shard->lock);
+        shard->cons.insert(con);
+    }
+
+    m_connection_gauge.add(con.get(),1);
+    assign_fast_slot(con);
     
     return con;
 }
@@ -127,6 +204,48 @@ void endpoint<connection,config>::send(connection_hdl hdl, std::string const &
     if (ec) { throw ec; }
 }
 
+#ifdef _WEBSOCKETPP_RVALUE_REFERENCES_
+template <typename connection, typename config>
+void endpoint<connection,config>::send(connection_hdl hdl,
+    std::string&& payload, frame::opcode::value op, lib::error_code & ec)
+{
+    connection_ptr con = get_con_from_hdl(hdl,ec);
+    if (ec) {return;}
+
+    ec = con->send(std::move(payload),op);
+}
+
+template <typename connection, typename config>
+void endpoint<connection,config>::send(connection_hdl hdl,
+    std::string&& payload, frame::opcode::value op)
+{
+    lib::error_code ec;
+    send(hdl,std::move(payload),op,ec);
+    if (ec) { throw ec; }
+}
+#endif
+
+template <typename connection, typename config>
+void endpoint<connection,config>::send_conflated(connection_hdl hdl,
+    std::string const & key, std::string const & payload,
+    frame::opcode::value op, lib::error_code & ec)
+{
+    connection_ptr con = get_con_from_hdl(hdl,ec);
+    if (ec) {return;}
+
+    ec = con->send_conflated(key,payload,op);
+}
+
+template <typename connection, typename config>
+void endpoint<connection,config>::send_conflated(connection_hdl hdl,
+    std::string const & key, std::string const & payload,
+    frame::opcode::value op)
+{
+    lib::error_code ec;
+    send_conflated(hdl,key,payload,op,ec);
+    if (ec) { throw ec; }
+}
+
 template <typename connection, typename config>
 void endpoint<connection,config>::send(connection_hdl hdl, void const * payload,
     size_t len, frame::opcode::value op, lib::error_code & ec)
@@ -161,6 +280,83 @@ void endpoint<connection,config>::send(connection_hdl hdl, message_ptr msg) {
     if (ec) { throw ec; }
 }
 
+template <typename connection, typename config>
+void endpoint<connection,config>::send(connection_hdl hdl,
+    std::string const & payload, frame::opcode::value op, bool compress,
+    lib::error_code & ec)
+{
+    connection_ptr con = get_con_from_hdl(hdl,ec);
+    if (ec) {return;}
+    ec = con->send(payload,op,compress);
+}
+
+template <typename connection, typename config>
+void endpoint<connection,config>::send(connection_hdl hdl,
+    std::string const & payload, frame::opcode::value op, bool compress)
+{
+    lib::error_code ec;
+    send(hdl,payload,op,compress,ec);
+    if (ec) { throw ec; }
+}
+
+template <typename connection, typename config>
+typename endpoint<connection,config>::message_ptr
+endpoint<connection,config>::prepare_message(connection_hdl hdl,
+    std::string const & payload, frame::opcode::value op, lib::error_code & ec)
+{
+    connection_ptr con = get_con_from_hdl(hdl,ec);
+    if (ec) {return message_ptr();}
+    return con->prepare_message(payload,op,ec);
+}
+
+template <typename connection, typename config>
+typename endpoint<connection,config>::message_ptr
+endpoint<connection,config>::prepare_cached(connection_hdl hdl,
+    std::string const & payload, frame::opcode::value op, lib::error_code & ec)
+{
+    // opcode folded into the key ahead of the payload bytes
+    std::string key;
+    key.reserve(payload.size()+1);
+    key += static_cast<char>(op);
+    key += payload;
+
+    {
+        scoped_lock_type guard(m_mutex);
+        typename std::map<std::string,prepared_frame_entry>::iterator it
+            = m_prepared_frames.find(key);
+        if (it != m_prepared_frames.end()) {
+            // refresh recency
+            m_prepared_lru.splice(m_prepared_lru.begin(),m_prepared_lru,
+                it->second.lru_pos);
+            ec = lib::error_code();
+            return it->second.msg;
+        }
+    }
+
+    connection_ptr con = get_con_from_hdl(hdl,ec);
+    if (ec) {return message_ptr();}
+
+    message_ptr msg = con->prepare_message(payload,op,ec);
+    if (ec) {return message_ptr();}
+
+    scoped_lock_type guard(m_mutex);
+    // a racing miss may have inserted meanwhile; keep the first entry
+    typename std::map<std::string,prepared_frame_entry>::iterator it
+        = m_prepared_frames.find(key);
+    if (it != m_prepared_frames.end()) {
+        return it->second.msg;
+    }
+    m_prepared_lru.push_front(key);
+    prepared_frame_entry & entry = m_prepared_frames[key];
+    entry.msg = msg;
+    entry.lru_pos = m_prepared_lru.begin();
+    while (m_prepared_frames.size() > m_prepared_cache_capacity) {
+        m_prepared_frames.erase(m_prepared_lru.back());
+        m_prepared_lru.pop_back();
+    }
+    return msg;
+}
+
 template <typename connection, typename config>
 void endpoint<connection,config>::close(connection_hdl hdl, close::status::value
     const code, std::string const & reason, 
@@ -218,16 +414,26 @@ void endpoint<connection,config>::pong(connection_hdl hdl, std::string const &
 
 template <typename connection, typename config>
 void endpoint<connection,config>::remove_connection(connection_ptr con) {
-    std::stringstream s;
-    s << "remove_connection. New count: " << m_connections.size()-1;
-    m_alog.write(log::alevel::devel,s.str());
-    
-    scoped_lock_type lock(m_mutex);
-        
-    // unregister the termination handler
-    con->set_termination_handler(termination_handler());
-    
-    m_connections.erase(con);
+    m_alog.write(log::alevel::devel,"remove_connection");
+
+    lib::shared_ptr<con_shard> shard = m_con_shards[
+        reinterpret_cast<uintptr_t>(con.get())/64 % m_con_shards.size()];
+    {
+        scoped_lock_type lock(shard->lock);
+
+        // unregister the termination handler
+        con->set_termination_handler(termination_handler());
+
+        shard->cons.erase(con);
+    }
+
+    m_connection_gauge.add(con.get(),-1);
+    release_fast_slot(con);
+
+    // with deferred cleanup the registry's reference -- typically the
+    // last -- is destroyed on the reaper thread instead of here on the
+    // io thread
+    defer_cleanup(con);
 }
 
 } // namespace websocketpp
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_INSTRUMENTATION_HPP
+#define WEBSOCKETPP_INSTRUMENTATION_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+
+/// Instrumentation policies
+/**
+ * An instrumentation policy receives hooks from the connection's read and
+ * write paths and aggregates whatever it likes. The `none` policy (the
+ * default when a config does not define a stats_type typedef) has empty
+ * inline hooks that compile to nothing; the `counters` policy maintains
+ * relaxed atomic totals shared endpoint wide, snapshotted through
+ * endpoint::get_stats(). Select with:
+ *
+ * \code
+ * struct my_config : public websocketpp::config::asio {
+ *     typedef websocketpp::instrumentation::counters stats_type;
+ * };
+ * \endcode
+ */
+namespace instrumentation {
+
+/// A point in time copy of the counters policy's totals
+struct snapshot {
+    snapshot()
+      : connections_opened(0), connections_failed(0)
+      , reads(0), read_bytes(0), writes(0), write_bytes(0)
+      , messages_in(0), message_bytes_in(0)
+      , messages_out(0), message_bytes_out(0)
+      , messages_submitted(0), messages_expired(0)
+      , sends_rejected(0), handshakes(0) {}
+
+    uint64_t connections_opened;
+    uint64_t connections_failed;
+    uint64_t reads;
+    uint64_t read_bytes;
+    uint64_t writes;
+    uint64_t write_bytes;
+    uint64_t messages_in;
+    uint64_t message_bytes_in;
+    uint64_t messages_out;
+    uint64_t message_bytes_out;
+    uint64_t messages_submitted;
+    uint64_t messages_expired;
+    uint64_t sends_rejected;
+    uint64_t handshakes;
+};
+
+/// No-op instrumentation policy; every hook is an empty inline
+class none {
+public:
+    typedef lib::shared_ptr<none> ptr;
+
+    void on_connection_opened() {}
+    void on_connection_failed() {}
+    void on_read(size_t) {}
+    void on_write(size_t, size_t) {}
+    void on_message_in(size_t) {}
+    void on_message_out(size_t) {}
+    void on_send_rejected() {}
+    void on_message_expired() {}
+    void on_queue_to_wire(uint64_t) {}
+    void on_wire_to_handler(uint64_t) {}
+    void on_frame_out(uint8_t, size_t, size_t, bool) {}
+    void on_frame_in(uint8_t, size_t, size_t, bool) {}
+
+    /// Whether connections should take latency timestamps for this policy
+    static bool const timestamps = false;
+    void on_handshake() {}
+
+    snapshot get() const {
+        return snapshot();
+    }
+};
+
+/// Relaxed atomic counter instrumentation policy
+class counters {
+public:
+    typedef lib::shared_ptr<counters> ptr;
+
+    counters()
+      : m_connections_opened(0), m_connections_failed(0)
+      , m_reads(0), m_read_bytes(0), m_writes(0), m_write_bytes(0)
+      , m_messages_in(0), m_message_bytes_in(0)
+      , m_messages_out(0), m_message_bytes_out(0)
+      , m_messages_submitted(0), m_messages_expired(0)
+      , m_sends_rejected(0), m_handshakes(0) {}
+
+    void on_connection_opened() {
+        m_connections_opened.fetch_add(1,lib::memory_order_relaxed);
+    }
+    void on_connection_failed() {
+        m_connections_failed.fetch_add(1,lib::memory_order_relaxed);
+    }
+    void on_read(size_t bytes) {
+        m_reads.fetch_add(1,lib::memory_order_relaxed);
+        m_read_bytes.fetch_add(bytes,lib::memory_order_relaxed);
+    }
+    void on_write(size_t bytes, size_t messages) {
+        m_writes.fetch_add(1,lib::memory_order_relaxed);
+        m_write_bytes.fetch_add(bytes,lib::memory_order_relaxed);
+        m_messages_out.fetch_add(messages,lib::memory_order_relaxed);
+    }
+    void on_message_in(size_t payload_bytes) {
+        m_messages_in.fetch_add(1,lib::memory_order_relaxed);
+        m_message_bytes_in.fetch_add(payload_bytes,
+            lib::memory_order_relaxed);
+    }
+    void on_frame_out(uint8_t, size_t, size_t, bool) {}
+    void on_frame_in(uint8_t, size_t, size_t, bool) {}
+
+    void on_message_out(size_t payload_bytes) {
+        m_messages_submitted.fetch_add(1,lib::memory_order_relaxed);
+        m_message_bytes_out.fetch_add(payload_bytes,
+            lib::memory_order_relaxed);
+    }
+    void on_send_rejected() {
+        m_sends_rejected.fetch_add(1,lib::memory_order_relaxed);
+    }
+    void on_message_expired() {
+        m_messages_expired.fetch_add(1,lib::memory_order_relaxed);
+    }
+    void on_queue_to_wire(uint64_t) {}
+    void on_wire_to_handler(uint64_t) {}
+
+    static bool const timestamps = false;
+    void on_handshake() {
+        m_handshakes.fetch_add(1,lib::memory_order_relaxed);
+    }
+
+    snapshot get() const {
+        snapshot s;
+        s.connections_opened = m_connections_opened.load(
+            lib::memory_order_relaxed);
+        s.connections_failed = m_connections_failed.load(
+            lib::memory_order_relaxed);
+        s.reads = m_reads.load(lib::memory_order_relaxed);
+        s.read_bytes = m_read_bytes.load(lib::memory_order_relaxed);
+        s.writes = m_writes.load(lib::memory_order_relaxed);
+        s.write_bytes = m_write_bytes.load(lib::memory_order_relaxed);
+        s.messages_in = m_messages_in.load(lib::memory_order_relaxed);
+        s.message_bytes_in = m_message_bytes_in.load(
+            lib::memory_order_relaxed);
+        s.messages_out = m_messages_out.load(lib::memory_order_relaxed);
+        s.message_bytes_out = m_message_bytes_out.load(
+            lib::memory_order_relaxed);
+        s.messages_submitted = m_messages_submitted.load(
+            lib::memory_order_relaxed);
+        s.messages_expired = m_messages_expired.load(
+            lib::memory_order_relaxed);
+        s.sends_rejected = m_sends_rejected.load(lib::memory_order_relaxed);
+        s.handshakes = m_handshakes.load(lib::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    lib::atomic<uint64_t> m_connections_opened;
+    lib::atomic<uint64_t> m_connections_failed;
+    lib::atomic<uint64_t> m_reads;
+    lib::atomic<uint64_t> m_read_bytes;
+    lib::atomic<uint64_t> m_writes;
+    lib::atomic<uint64_t> m_write_bytes;
+    lib::atomic<uint64_t> m_messages_in;
+    lib::atomic<uint64_t> m_message_bytes_in;
+    lib::atomic<uint64_t> m_messages_out;
+    lib::atomic<uint64_t> m_message_bytes_out;
+    lib::atomic<uint64_t> m_messages_submitted;
+    lib::atomic<uint64_t> m_messages_expired;
+    lib::atomic<uint64_t> m_sends_rejected;
+    lib::atomic<uint64_t> m_handshakes;
+};
+
+/// Lock free log2 bucketed latency histogram
+/**
+ * Thirty-two power-of-two microsecond buckets (sub-microsecond up
+ * through ~35 minutes) updated with relaxed atomic adds; an HDR style
+ * shape that answers percentile questions at SLO granularity without
+ * per-sample allocation or locking. Reads are approximate while writers
+ * are active.
+ */
+struct latency_histogram {
+    latency_histogram() {
+        for (int i = 0; i < 32; i++) {
+            m_buckets[i].store(0,lib::memory_order_relaxed);
+        }
+    }
+
+    void record(uint64_t us) {
+        int b = 0;
+        while (us > 1 && b < 31) {
+            us >>= 1;
+            b++;
+        }
+        m_buckets[b].fetch_add(1,lib::memory_order_relaxed);
+    }
+
+    /// Copy the bucket counts out; index i covers [2^(i-1), 2^i) us
+    void read(uint64_t out[32]) const {
+        for (int i = 0; i < 32; i++) {
+            out[i] = m_buckets[i].load(lib::memory_order_relaxed);
+        }
+    }
+
+    lib::atomic<uint64_t> m_buckets[32];
+};
+
+/// Counters policy with queue-to-wire and wire-to-handler histograms
+/**
+ * Select in a config to make connections timestamp messages at enqueue
+ * and reads at arrival, feeding two endpoint wide histograms: how long
+ * accepted messages waited before reaching the transport, and how long
+ * received bytes waited before the application handler ran. The
+ * timestamps constant gates every clock read at compile time, so
+ * configs using counters or none pay nothing.
+ *
+ * \code
+ * struct my_config : public websocketpp::config::asio {
+ *     typedef websocketpp::instrumentation::histogram_counters stats_type;
+ * };
+ * \endcode
+ */
+class histogram_counters : public counters {
+public:
+    typedef lib::shared_ptr<histogram_counters> ptr;
+
+    static bool const timestamps = true;
+
+    void on_queue_to_wire(uint64_t us) {
+        m_queue_to_wire.record(us);
+    }
+    void on_wire_to_handler(uint64_t us) {
+        m_wire_to_handler.record(us);
+    }
+
+    /// Copy the queue-to-wire histogram buckets
+    void get_queue_to_wire(uint64_t out[32]) const {
+        m_queue_to_wire.read(out);
+    }
+    /// Copy the wire-to-handler histogram buckets
+    void get_wire_to_handler(uint64_t out[32]) const {
+        m_wire_to_handler.read(out);
+    }
+
+    /// Totals for one opcode or one size bucket
+    struct frame_profile {
+        frame_profile() : count(0), payload_bytes(0), wire_bytes(0) {}
+
+        uint64_t count;
+        uint64_t payload_bytes;
+        /// Frame header + payload, plus an estimated TLS record
+        /// overhead (header, tag, padding) on secure transports
+        uint64_t wire_bytes;
+    };
+
+    /// Estimated per-frame TLS record overhead (TLS 1.2/1.3 AES-GCM:
+    /// 5 byte record header plus a 16 byte tag and nonce/padding slack)
+    static size_t const tls_record_overhead = 29;
+
+    void on_frame_out(uint8_t opcode, size_t payload, size_t wire,
+        bool secure)
+    {
+        record_frame(m_out_by_opcode,m_out_by_size,opcode,payload,
+            wire+(secure ? tls_record_overhead : 0));
+    }
+    void on_frame_in(uint8_t opcode, size_t payload, size_t wire,
+        bool secure)
+    {
+        record_frame(m_in_by_opcode,m_in_by_size,opcode,payload,
+            wire+(secure ? tls_record_overhead : 0));
+    }
+
+    /// Per-opcode outbound totals (opcode 0-15)
+    frame_profile get_out_by_opcode(uint8_t opcode) const {
+        return read_profile(m_out_by_opcode[opcode & 0xf]);
+    }
+    frame_profile get_in_by_opcode(uint8_t opcode) const {
+        return read_profile(m_in_by_opcode[opcode & 0xf]);
+    }
+    /// Per size-bucket totals; bucket i covers payloads in
+    /// [2^i, 2^(i+1)) bytes, bucket 0 includes empty payloads
+    frame_profile get_out_by_size(size_t bucket) const {
+        return read_profile(m_out_by_size[bucket & 0xf]);
+    }
+    frame_profile get_in_by_size(size_t bucket) const {
+        return read_profile(m_in_by_size[bucket & 0xf]);
+    }
+
+private:
+    struct atomic_profile {
+        atomic_profile() : count(0), payload_bytes(0), wire_bytes(0) {}
+
+        lib::atomic<uint64_t> count;
+        lib::atomic<uint64_t> payload_bytes;
+        lib::atomic<uint64_t> wire_bytes;
+    };
+
+    static size_t size_bucket(size_t payload) {
+        size_t b = 0;
+        while (payload > 1 && b < 15) {
+            payload >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    static void record_frame(atomic_profile * by_op,
+        atomic_profile * by_size, uint8_t opcode, size_t payload,
+        size_t wire)
+    {
+        atomic_profile & o = by_op[opcode & 0xf];
+        o.count.fetch_add(1,lib::memory_order_relaxed);
+        o.payload_bytes.fetch_add(payload,lib::memory_order_relaxed);
+        o.wire_bytes.fetch_add(wire,lib::memory_order_relaxed);
+        atomic_profile & z = by_size[size_bucket(payload)];
+        z.count.fetch_add(1,lib::memory_order_relaxed);
+        z.payload_bytes.fetch_add(payload,lib::memory_order_relaxed);
+        z.wire_bytes.fetch_add(wire,lib::memory_order_relaxed);
+    }
+
+    static frame_profile read_profile(atomic_profile const & p) {
+        frame_profile out;
+        out.count = p.count.load(lib::memory_order_relaxed);
+        out.payload_bytes =
+            p.payload_bytes.load(lib::memory_order_relaxed);
+        out.wire_bytes = p.wire_bytes.load(lib::memory_order_relaxed);
+        return out;
+    }
+
+    latency_histogram m_queue_to_wire;
+    latency_histogram m_wire_to_handler;
+    atomic_profile m_out_by_opcode[16];
+    atomic_profile m_in_by_opcode[16];
+    atomic_profile m_out_by_size[16];
+    atomic_profile m_in_by_size[16];
+};
+
+/// Selects the config's stats_type, defaulting to none when absent
+template <typename config, typename Enable = void>
+struct selector {
+    typedef none type;
+};
+
+template <typename config>
+struct selector<config,
+    typename detail::type_sink<typename config::stats_type>::type>
+{
+    typedef typename config::stats_type type;
+};
+
+} // namespace instrumentation
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_INSTRUMENTATION_HPP
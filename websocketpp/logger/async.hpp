@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_LOGGER_ASYNC_HPP
+#define WEBSOCKETPP_LOGGER_ASYNC_HPP
+
+#include <websocketpp/logger/levels.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <deque>
+
+namespace websocketpp {
+namespace log {
+
+/// Asynchronous logger that moves formatting and I/O off the calling thread
+/**
+ * Drop in replacement for log::basic (same constructor and member
+ * signatures, including the optional static_filter template parameter), for
+ * selection via config::alog_type/elog_type (remember to override the
+ * nested transport_config's logger typedefs as well). write() copies the message
+ * into a fixed capacity ring buffer under a short lock and returns; a
+ * background thread formats (timestamp, channel name) and writes to the
+ * ostream. When the buffer is full the message is dropped and counted; the
+ * drop count is reported inline in the output when space frees up. flush()
+ * blocks until everything queued so far has been written, which tests and
+ * orderly shutdown use.
+ *
+ * A single bounded buffer is used rather than per-thread rings: with
+ * formatting and I/O out of the way the critical section is a string move,
+ * and contention on it is negligible compared to the ostream work this
+ * policy removes from the hot path.
+ */
+template <typename concurrency, typename names,
+    level static_filter = 0xffffffff>
+class async {
+public:
+    /// Number of messages the ring buffer holds before dropping
+    static size_t const buffer_capacity = 4096;
+
+    async(std::ostream * out = &std::cout)
+      : m_static_channels(0xffffffff)
+      , m_dynamic_channels(0)
+      , m_out(out)
+      , m_dropped(0)
+      , m_stop(false)
+      , m_running(false)
+      , m_in_flight(false)
+    {}
+
+    async(level c, std::ostream * out = &std::cout)
+      : m_static_channels(c)
+      , m_dynamic_channels(0)
+      , m_out(out)
+      , m_dropped(0)
+      , m_stop(false)
+      , m_running(false)
+      , m_in_flight(false)
+    {}
+
+    ~async() {
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        if (m_writer) {
+            m_writer->join();
+        }
+    }
+
+    void set_ostream(std::ostream * out) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_out = out;
+    }
+
+    void set_channels(level channels) {
+        if (channels == names::none) {
+            clear_channels(names::all);
+            return;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_dynamic_channels |= (channels & m_static_channels);
+    }
+
+    void clear_channels(level channels) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_dynamic_channels &= ~channels;
+    }
+
+    void write(level channel, std::string const & msg) {
+        if (!static_test(channel)) { return; }
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        if (!dynamic_test_nolock(channel)) { return; }
+
+        if (m_queue.size() >= buffer_capacity) {
+            m_dropped++;
+            return;
+        }
+
+        m_queue.push_back(entry(channel,msg));
+        start_writer_nolock();
+        m_cond.notify_one();
+    }
+
+    void write(level channel, char const * msg) {
+        write(channel,std::string(msg));
+    }
+
+    bool static_test(level channel) const {
+        return ((channel & static_filter) != 0) &&
+               ((channel & m_static_channels) != 0);
+    }
+
+    bool dynamic_test(level channel) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return dynamic_test_nolock(channel);
+    }
+
+    /// Block until every message queued so far has been written
+    void flush() {
+        lib::unique_lock<lib::mutex> lock(m_lock);
+        while (m_running && (!m_queue.empty() || m_in_flight)) {
+            m_cond.wait(lock);
+        }
+    }
+
+    /// Number of messages dropped due to buffer overflow so far
+    size_t get_dropped_count() {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_dropped;
+    }
+
+private:
+    // non-copyable
+    async(async const &);
+    async & operator=(async const &);
+
+    struct entry {
+        entry(level c, std::string const & m) : channel(c), msg(m) {}
+
+        level channel;
+        std::string msg;
+    };
+
+    bool dynamic_test_nolock(level channel) {
+        return ((channel & m_dynamic_channels) != 0);
+    }
+
+    /// Start the background writer on first use. m_lock held.
+    void start_writer_nolock() {
+        if (!m_running) {
+            m_running = true;
+            m_writer.reset(new lib::thread(lib::bind(&async::run,this)));
+        }
+    }
+
+    void run() {
+        lib::unique_lock<lib::mutex> lock(m_lock);
+        for (;;) {
+            while (m_queue.empty() && !m_stop) {
+                m_cond.wait(lock);
+            }
+            if (m_queue.empty() && m_stop) {
+                return;
+            }
+
+            entry e = m_queue.front();
+            m_queue.pop_front();
+            size_t dropped = m_dropped;
+            m_dropped = 0;
+            std::ostream * out = m_out;
+            m_in_flight = true;
+
+            // format and write without holding the lock
+            lock.unlock();
+            if (dropped > 0) {
+                *out << "[" << timestamp << "] [async logger] "
+                     << dropped << " messages dropped\n";
+            }
+            *out << "[" << timestamp << "] "
+                 << "[" << names::channel_name(e.channel) << "] "
+                 << e.msg << "\n";
+            out->flush();
+            lock.lock();
+            m_in_flight = false;
+
+            // wake any flush() waiters when the queue empties
+            if (m_queue.empty()) {
+                m_cond.notify_all();
+            }
+        }
+    }
+
+    // Timestamp formatter, identical to log::basic
+    static std::ostream & timestamp(std::ostream & os) {
+        std::time_t t = std::time(NULL);
+        std::tm* lt = std::localtime(&t);
+        #ifdef _WEBSOCKETPP_CPP11_CHRONO_
+            return os << std::put_time(lt,"%Y-%m-%d %H:%M:%S");
+        #else
+            char buffer[20];
+            std::strftime(buffer,sizeof(buffer),"%Y-%m-%d %H:%M:%S",lt);
+            return os << buffer;
+        #endif
+    }
+
+    level const m_static_channels;
+    level m_dynamic_channels;
+    std::ostream * m_out;
+
+    lib::mutex m_lock;
+    lib::condition_variable m_cond;
+    std::deque<entry> m_queue;
+    size_t m_dropped;
+    bool m_stop;
+    bool m_running;
+    bool m_in_flight;
+    lib::shared_ptr<lib::thread> m_writer;
+};
+
+} // namespace log
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_LOGGER_ASYNC_HPP
@@ -51,15 +51,25 @@ namespace websocketpp {
 namespace log {
 
 /// Basic logger that outputs to an ostream
-template <typename concurrency, typename names>
+/**
+ * The optional static_filter template parameter bakes a channel mask into
+ * the type: static_test becomes a pure compile time constant for literal
+ * channels, so writes (and, at call sites using the static_test guard
+ * idiom, their argument construction) below the filter are eliminated as
+ * dead code. The default of all-bits keeps the old purely runtime
+ * behavior. Configs that override their log levels should instantiate
+ * their logger typedefs with the matching filter (see config/core.hpp).
+ */
+template <typename concurrency, typename names,
+    level static_filter = 0xffffffff>
 class basic {
 public:
-    basic<concurrency,names>(std::ostream* out = &std::cout) 
+    basic(std::ostream* out = &std::cout)
       : m_static_channels(0xffffffff)
       , m_dynamic_channels(0)
       , m_out(out) {}
     
-    basic<concurrency,names>(level c, std::ostream* out = &std::cout)
+    basic(level c, std::ostream* out = &std::cout)
       : m_static_channels(c)
       , m_dynamic_channels(0)
       , m_out(out) {}
@@ -84,6 +94,7 @@ public:
     }
     
     void write(level channel, const std::string& msg) {
+        if (!static_test(channel)) { return; }
         scoped_lock_type lock(m_lock);
         if (!this->dynamic_test(channel)) { return; }
         *m_out << "[" << timestamp << "] " 
@@ -93,6 +104,7 @@ public:
     }
     
     void write(level channel, const char* msg) {
+        if (!static_test(channel)) { return; }
         scoped_lock_type lock(m_lock);
         if (!this->dynamic_test(channel)) { return; }
         *m_out << "[" << timestamp << "] "
@@ -102,7 +114,10 @@ public:
     }
     
     bool static_test(level channel) const {
-        return ((channel & m_static_channels) != 0);
+        // the template filter folds to a constant for literal channels;
+        // the runtime mask preserves the constructor based behavior
+        return ((channel & static_filter) != 0) &&
+               ((channel & m_static_channels) != 0);
     }
     
     bool dynamic_test(level channel) {
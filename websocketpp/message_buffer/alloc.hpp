@@ -28,32 +28,167 @@
 #ifndef WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
 #define WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
 
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/message_buffer/metrics.hpp>
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
 #include <websocketpp/frame.hpp>
 
+#include <cstddef>
+
 namespace websocketpp {
 namespace message_buffer {
 namespace alloc {
 
-/// A connection message manager that allocates a new message for each
-/// request.
+namespace detail {
+
+/// Small mutex guarded freelist of fixed size raw blocks
+/**
+ * Recycles the shared_ptr control blocks that wrap this manager's
+ * messages, so re-wrapping a cached message allocates nothing. The block
+ * size is fixed by the first allocation (control blocks for one message
+ * type share a size); other sizes fall through to the heap. Guarded by a
+ * mutex rather than the pooled manager's tagged pointer compare-exchange
+ * so default configs do not pick up a wide-atomic link dependency.
+ */
+class control_block_cache {
+public:
+    typedef lib::shared_ptr<control_block_cache> ptr;
+
+    static size_t const max_blocks = 8;
+
+    control_block_cache() : m_block_size(0), m_count(0) {}
+
+    ~control_block_cache() {
+        for (size_t i = 0; i < m_count; i++) {
+            ::operator delete(m_blocks[i]);
+        }
+    }
+
+    void * allocate(size_t size) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        if (m_block_size == 0) {
+            m_block_size = size;
+        }
+        if (size != m_block_size || m_count == 0) {
+            return ::operator new(size);
+        }
+        return m_blocks[--m_count];
+    }
+
+    void deallocate(void * p, size_t size) {
+        {
+            lib::lock_guard<lib::mutex> guard(m_lock);
+            if (size == m_block_size && m_count < max_blocks) {
+                m_blocks[m_count++] = p;
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+private:
+    lib::mutex m_lock;
+    size_t m_block_size;
+    size_t m_count;
+    void * m_blocks[max_blocks];
+};
+
+/// std allocator facade over control_block_cache
+template <typename T>
+struct cb_allocator {
+    typedef T value_type;
+
+    explicit cb_allocator(control_block_cache::ptr c) : cache(c) {}
+    template <typename U>
+    cb_allocator(cb_allocator<U> const & other) : cache(other.cache) {}
+
+    T * allocate(size_t n) {
+        return static_cast<T *>(cache->allocate(n*sizeof(T)));
+    }
+    void deallocate(T * p, size_t n) {
+        cache->deallocate(p,n*sizeof(T));
+    }
+
+    template <typename U> struct rebind { typedef cb_allocator<U> other; };
+    template <typename U>
+    bool operator==(cb_allocator<U> const & other) const {
+        return cache == other.cache;
+    }
+    template <typename U>
+    bool operator!=(cb_allocator<U> const & other) const {
+        return cache != other.cache;
+    }
+
+    control_block_cache::ptr cache;
+};
+
+/// shared_ptr deleter routing released messages through the recycle chain
+template <typename T>
+void recycling_deleter(T * msg) {
+    try {
+        if (!msg->recycle()) {
+            delete msg;
+        }
+    } catch (...) {
+        delete msg;
+    }
+}
+} // namespace detail
+
+/// A connection message manager that allocates messages on demand
+/**
+ * Allocates a message per request, with a small fixed cache: when the
+ * last reference to a message drops it is kept (with its payload
+ * capacity) if the payload is at most cache_capacity bytes and a cache
+ * slot is free, and later requests reuse it. A few slots cover the
+ * frames simultaneously alive in an echo or request/reply cadence, so
+ * steady state small-frame traffic (ticks, acks, pings) performs no
+ * message or payload allocations without needing the pooled manager;
+ * messages that grew past the threshold are freed rather than pinning
+ * large buffers. The threshold is the cache_capacity constant; the
+ * message template's manager slot only admits single parameter
+ * templates, so configs needing different limits define a derived
+ * manager overriding them.
+ */
 template <typename message>
 class con_msg_manager 
   : public lib::enable_shared_from_this<con_msg_manager<message> > 
 {
 public:
+    /// Largest payload capacity worth caching, in bytes
+    static size_t const cache_capacity = 128;
+    /// Number of released messages retained
+    static size_t const cache_slots = 4;
+
     typedef con_msg_manager<message> type;
     typedef lib::shared_ptr<con_msg_manager> ptr;
     typedef lib::weak_ptr<con_msg_manager> weak_ptr;
 
     typedef typename message::ptr message_ptr;
+
+    con_msg_manager()
+      : m_control_blocks(new detail::control_block_cache())
+    {
+        for (size_t i = 0; i < cache_slots; i++) {
+            m_cache[i].store(static_cast<message *>(0),
+                lib::memory_order_relaxed);
+        }
+    }
+
+    ~con_msg_manager() {
+        for (size_t i = 0; i < cache_slots; i++) {
+            delete m_cache[i].exchange(static_cast<message *>(0),
+                lib::memory_order_acq_rel);
+        }
+    }
     
     /// Get an empty message buffer 
     /**
      * @return A shared pointer to an empty new message
      */
     message_ptr get_message() {
-        return message_ptr(new message(type::shared_from_this()));
+        return get_message(frame::opcode::CONTINUATION,0);
     }
 
     /// Get a message buffer with specified size and opcode
@@ -61,25 +196,78 @@ public:
      * @param op The opcode to use
      * @param size Minimum size in bytes to request for the message payload.
      *
-     * @return A shared pointer to a new message with specified size.
+     * @return A shared pointer to a message with the requested settings,
+     * reusing the cached message when one is available
      */
     message_ptr get_message(frame::opcode::value op,size_t size) {
-        return message_ptr(new message(type::shared_from_this(),op,size));
+        message * raw = 0;
+        for (size_t i = 0; i < cache_slots; i++) {
+            raw = m_cache[i].exchange(static_cast<message *>(0),
+                lib::memory_order_acq_rel);
+            if (raw) {
+                break;
+            }
+        }
+        if (raw) {
+            m_metrics.on_hit();
+            raw->reset(op);
+        } else {
+            m_metrics.on_miss();
+            raw = new message(type::shared_from_this(),op,size);
+        }
+        if (size > 0 && raw->get_raw_payload().capacity() < size) {
+            raw->get_raw_payload().reserve(size);
+        }
+        return message_ptr(raw,&detail::recycling_deleter<message>,
+            detail::cb_allocator<char>(m_control_blocks));
     }
 
     /// Recycle a message
     /**
-     * This method shouldn't be called. If it is, return false to indicate an
-     * error. The rest of the method recycle chain should notice this and free
-     * the memory.
+     * Called via the shared_ptr deleter when the last reference to a
+     * message drops. Takes the message into the one slot cache when its
+     * payload storage is within the threshold and the slot is free.
      *
      * @param msg The message to be recycled.
      *
-     * @return true if the message was successfully recycled, false otherwse.
+     * @return true if the message was taken (the caller must not free it)
      */
     bool recycle(message * msg) {
+        if (msg->get_raw_payload().capacity() > cache_capacity) {
+            m_metrics.on_drop();
+            return false;
+        }
+        // drop references and content so the cached message does not pin
+        // other buffers while idle
+        msg->reset(frame::opcode::CONTINUATION);
+        for (size_t i = 0; i < cache_slots; i++) {
+            message * expected = 0;
+            if (m_cache[i].compare_exchange_strong(expected,msg,
+                lib::memory_order_acq_rel))
+            {
+                m_metrics.on_recycle(i+1);
+                return true;
+            }
+        }
+        m_metrics.on_drop();
         return false;
     }
+
+    /// Cache occupancy and traffic snapshot (see pool_metrics)
+    pool_metrics get_pool_metrics() const {
+        size_t occupied = 0;
+        for (size_t i = 0; i < cache_slots; i++) {
+            if (m_cache[i].load(lib::memory_order_relaxed) != 0) {
+                occupied++;
+            }
+        }
+        return m_metrics.snapshot(occupied);
+    }
+private:
+    lib::atomic<message *> m_cache[cache_slots];
+    message_buffer::detail::pool_counters m_metrics;
+    /// Recycles the shared_ptr control blocks wrapping these messages
+    detail::control_block_cache::ptr m_control_blocks;
 };
 
 /// An endpoint message manager that allocates a new manager for each
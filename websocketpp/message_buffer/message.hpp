@@ -28,6 +28,8 @@
 #ifndef WEBSOCKETPP_MESSAGE_BUFFER_MESSAGE_HPP
 #define WEBSOCKETPP_MESSAGE_BUFFER_MESSAGE_HPP
 
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/time.hpp>
 #include <websocketpp/common/memory.hpp>
 #include <websocketpp/frame.hpp>
 
@@ -95,10 +97,16 @@ public:
      */
     message(const con_msg_man_ptr manager)
       : m_manager(manager)
+      , m_pool_next(NULL)
       , m_prepared(false)
       , m_fin(true)
       , m_terminal(false)
-      , m_compressed(false) {}
+      , m_compressed(true)
+      , m_droppable(true)
+      , m_deadline_ms(0)
+      , m_enqueued_us(0)
+      , m_view_data(NULL)
+      , m_view_len(0) {}
     
     /// Construct a message and fill in some values
     /**
@@ -106,11 +114,17 @@ public:
      */
     message(const con_msg_man_ptr manager, frame::opcode::value op, size_t size = 128) 
       : m_manager(manager)
+      , m_pool_next(NULL)
       , m_opcode(op)
       , m_prepared(false)
       , m_fin(true)
       , m_terminal(false)
-      , m_compressed(false)
+      , m_compressed(true)
+      , m_droppable(true)
+      , m_deadline_ms(0)
+      , m_enqueued_us(0)
+      , m_view_data(NULL)
+      , m_view_len(0)
     {
         m_payload.reserve(size);
     }
@@ -136,8 +150,11 @@ public:
     
     /// Return whether or not the message is flagged as compressed
     /**
-     * The compression flag is used to indicate whether or not the message is
-     * or should be compressed.
+     * The compression flag marks the message as eligible for outbound
+     * compression. It defaults to true; whether a frame is actually
+     * deflated additionally depends on permessage-deflate having been
+     * negotiated and on the extension's per message heuristics (minimum
+     * size, entropy sampling).
      *
      * @return whether or not the message is/should be compressed
      */
@@ -231,10 +248,22 @@ public:
     
     /// Get a reference to the payload string
     /**
+     * If this message references another message's payload (see
+     * set_shared_payload) the referenced payload is returned instead.
+     *
      * @return A const reference to the message's payload string
      */
     const std::string& get_payload() const {
-        return m_payload;
+        if (m_view_data) {
+            // materialize the borrowed view; an implicit retain() keeps
+            // string-based callers correct at the cost of the copy this
+            // mode exists to avoid (use payload_data/payload_size to stay
+            // zero copy)
+            m_payload.assign(m_view_data,m_view_len);
+            m_view_data = NULL;
+            m_view_len = 0;
+        }
+        return (m_payload_ref ? m_payload_ref->get_payload() : m_payload);
     }
     
     /// Get a non-const reference to the payload string
@@ -246,15 +275,208 @@ public:
     }
 
     void set_payload(const std::string& payload) {
+        m_payload_ref.reset();
         m_payload = payload;
     }
-    
+
+#ifdef _WEBSOCKETPP_RVALUE_REFERENCES_
+    /// Take ownership of the caller's string as the payload
+    /**
+     * Move overload; no payload bytes are copied.
+     */
+    void set_payload(std::string&& payload) {
+        m_payload_ref.reset();
+        m_payload = std::move(payload);
+    }
+#endif
+
     void set_payload(const void *payload, size_t len) {
+        m_payload_ref.reset();
         m_payload.reserve(len);
         const char* pl = static_cast<const char *>(payload);
         m_payload.assign(pl, pl + len);
     }
+
+    /// Reference another message's payload rather than storing a copy
+    /**
+     * Sets this message's payload to be a reference to the payload of the
+     * supplied source message. No payload bytes are copied; get_payload will
+     * return the source message's payload and the source message will be
+     * kept alive at least as long as this message holds the reference.
+     *
+     * This is used by protocol processors to build prepared outgoing
+     * messages whose payload needs no transformation (no masking, no
+     * compression), letting the transport gather write the original bytes
+     * directly. The source payload must not be modified until this message
+     * has been written.
+     *
+     * @param source The message whose payload should be referenced
+     */
+    void set_shared_payload(ptr source) {
+        m_payload_ref = source;
+    }
     
+    /// Whether the payload is currently a borrowed view
+    /**
+     * Borrowed messages reference bytes in the connection's read buffer
+     * instead of owning a copy; see connection::set_borrowed_messages.
+     */
+    bool is_borrowed() const {
+        return m_view_data != NULL;
+    }
+
+    /// Pointer to the payload bytes, borrowed or owned
+    char const * payload_data() const {
+        if (m_view_data) {
+            return m_view_data;
+        }
+        return (m_payload_ref ? m_payload_ref->get_payload().data()
+                              : m_payload.data());
+    }
+
+    /// Number of payload bytes, borrowed or owned
+    size_t payload_size() const {
+        if (m_view_data) {
+            return m_view_len;
+        }
+        return (m_payload_ref ? m_payload_ref->get_payload().size()
+                              : m_payload.size());
+    }
+
+    /// Install a borrowed payload view (processor use)
+    /**
+     * The message does not own the bytes; they are valid only until the
+     * message handler returns, after which the connection calls
+     * release_view. retain() converts the view into an owned copy.
+     */
+    void set_payload_view(char const * data, size_t len) {
+        m_view_data = data;
+        m_view_len = len;
+        m_payload.clear();
+        m_payload_ref.reset();
+    }
+
+    /// Copy a borrowed payload into owned storage
+    /**
+     * After retain() the message behaves like an ordinary copied message
+     * and outlives the handler. A no-op on messages that already own
+     * their payload.
+     */
+    void retain() {
+        if (m_view_data) {
+            m_payload.assign(m_view_data,m_view_len);
+            m_view_data = NULL;
+            m_view_len = 0;
+        }
+    }
+
+    /// Drop an unretained borrowed view (connection use)
+    /**
+     * Called when the handler returns. A message handle kept without
+     * retain() reads as empty afterwards rather than dangling into the
+     * recycled read buffer.
+     */
+    void release_view() {
+        m_view_data = NULL;
+        m_view_len = 0;
+    }
+
+    /// Give this message a time-to-live before sending
+    /**
+     * A message still waiting in the send queue when its TTL elapses is
+     * discarded at dequeue time and counted instead of written -- stale
+     * data is dropped where it sits rather than delivered late. Zero
+     * (the default) means no deadline. Set before queueing; control
+     * frames are never expired by the library.
+     *
+     * @param ttl_ms Milliseconds from now after which the queued message
+     * is stale
+     */
+    void set_ttl(long ttl_ms) {
+        m_deadline_ms = lib::steady_ms()+static_cast<uint64_t>(ttl_ms);
+    }
+
+    /// The absolute monotonic deadline; 0 when none
+    uint64_t get_deadline_ms() const {
+        return m_deadline_ms;
+    }
+
+    /// Latency instrumentation: when this message was queued (us)
+    uint64_t get_enqueued_us() const {
+        return m_enqueued_us;
+    }
+    void set_enqueued_us(uint64_t us) {
+        m_enqueued_us = us;
+    }
+
+    /// Copy another message's deadline (prepared-from-input plumbing)
+    void set_deadline_ms(uint64_t deadline) {
+        m_deadline_ms = deadline;
+    }
+
+    /// Whether the message's TTL has elapsed
+    bool expired(uint64_t now_ms) const {
+        return m_deadline_ms != 0 && now_ms > m_deadline_ms;
+    }
+
+    /// Whether the drop-oldest policy may discard this queued message
+    bool get_droppable() const {
+        return m_droppable;
+    }
+
+    /// Mark a message as immune to the drop-oldest policy
+    /**
+     * Cleared on fragment train and streamed-send frames: dropping one
+     * frame of a fragmented message would corrupt the framing for every
+     * later message on the connection.
+     */
+    void set_droppable(bool value) {
+        m_droppable = value;
+    }
+
+    /// Get the conflation tag; empty when unset
+    std::string const & get_conflation_tag() const {
+        return m_conflation_tag;
+    }
+
+    /// Tag this message for send queue conflation
+    /**
+     * While a message with the same (non empty) tag is waiting in a
+     * connection's send queue, queueing this one replaces it in place
+     * instead of lengthening the queue -- the natural shape for market
+     * data style feeds where only the latest value per key matters.
+     * Conflation requires the mutex guarded send queue; the lock free
+     * queue cannot be traversed safely and enqueues normally.
+     */
+    void set_conflation_tag(std::string const & tag) {
+        m_conflation_tag = tag;
+    }
+
+    /// Remove and return the payload, leaving this message empty
+    /**
+     * Transfers the payload string out of the message without copying,
+     * for pipelines that need ownership of a received payload beyond the
+     * message's lifetime. Shared payloads (set_shared_payload) have
+     * another owner and are returned as a copy instead.
+     *
+     * @return The message's payload, by value
+     */
+    std::string steal_payload() {
+        if (m_view_data) {
+            // borrowed bytes cannot be stolen, only copied
+            std::string out(m_view_data,m_view_len);
+            m_view_data = NULL;
+            m_view_len = 0;
+            return out;
+        }
+        if (m_payload_ref) {
+            return m_payload_ref->get_payload();
+        }
+        std::string out;
+        out.swap(m_payload);
+        return out;
+    }
+
     void append_payload(const std::string& payload) {
         m_payload.append(payload);
     }
@@ -264,6 +486,50 @@ public:
         m_payload.append(static_cast<const char *>(payload),len);
     }
 
+    /// Reset the message to a fresh state for reuse
+    /**
+     * Returns the message to the state produced by the two argument
+     * constructor. Called by pooling message managers before handing out a
+     * recycled message. The payload string's capacity is retained so that
+     * reuse avoids payload reallocation.
+     *
+     * @param op The opcode to reset the message to
+     */
+    void reset(frame::opcode::value op) {
+        m_opcode = op;
+        m_prepared = false;
+        m_fin = true;
+        m_terminal = false;
+        m_compressed = true;
+        m_header.clear();
+        m_extension_data.clear();
+        m_payload.clear();
+        m_payload_ref.reset();
+        m_conflation_tag.clear();
+        m_droppable = true;
+        m_deadline_ms = 0;
+        m_enqueued_us = 0;
+        m_view_data = NULL;
+        m_view_len = 0;
+    }
+
+    /// Intrusive freelist hook for pooling message managers
+    /**
+     * Only meaningful while the message is held by a pooling manager's
+     * freelist; not part of the public message interface.
+     */
+    message * get_pool_next() const {
+        return m_pool_next;
+    }
+
+    /// Set the intrusive freelist hook
+    /**
+     * @see get_pool_next
+     */
+    void set_pool_next(message * next) {
+        m_pool_next = next;
+    }
+
     /// Recycle the message
     /**
      * A request to recycle this message was received. Forward that request to
@@ -288,14 +554,27 @@ public:
     }
 private:
     con_msg_man_weak_ptr        m_manager;
+    message *                   m_pool_next;
+    ptr                         m_payload_ref;
+    /// Send queue conflation key; see set_conflation_tag
+    std::string                 m_conflation_tag;
     std::string                 m_header;
     std::string                 m_extension_data;
-    std::string                 m_payload;
+    mutable std::string         m_payload;
     frame::opcode::value        m_opcode;
     bool                        m_prepared;
     bool                        m_fin;
     bool                        m_terminal;
     bool                        m_compressed;
+    /// Whether drop-oldest may discard this message; see set_droppable
+    bool                        m_droppable;
+    /// Absolute monotonic send deadline in ms; 0 means none
+    uint64_t                    m_deadline_ms;
+    /// Enqueue timestamp for latency instrumentation; 0 when unstamped
+    uint64_t                    m_enqueued_us;
+    /// Borrowed payload view; mutable so get_payload can materialize it
+    mutable char const *        m_view_data;
+    mutable size_t              m_view_len;
 };
 
 } // namespace message_buffer
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_METRICS_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_METRICS_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace message_buffer {
+
+/// Snapshot of one pool's occupancy and traffic counters
+/**
+ * Returned by the message managers' get_pool_metrics (and aggregated by
+ * endpoint::aggregate_pool_metrics) for capacity planning: hit rate
+ * tells whether the pool is sized usefully, high_water whether its cap
+ * is ever reached, dropped how much recycling the caps refuse. Values
+ * are read with relaxed loads from counters updated on the pool fast
+ * paths, so a snapshot is approximate under concurrency -- sizing
+ * decisions, not an audit log.
+ */
+struct pool_metrics {
+    pool_metrics()
+      : hits(0), misses(0), recycled(0), dropped(0),
+        occupancy(0), high_water(0) {}
+
+    /// Requests served from the pool
+    uint64_t hits;
+    /// Requests that fell through to the allocator
+    uint64_t misses;
+    /// Objects returned to the pool
+    uint64_t recycled;
+    /// Returns refused by a cap (freed instead)
+    uint64_t dropped;
+    /// Objects currently idle in the pool
+    size_t occupancy;
+    /// Highest occupancy observed
+    size_t high_water;
+
+    pool_metrics & operator+=(pool_metrics const & rhs) {
+        hits += rhs.hits;
+        misses += rhs.misses;
+        recycled += rhs.recycled;
+        dropped += rhs.dropped;
+        occupancy += rhs.occupancy;
+        if (rhs.high_water > high_water) {
+            high_water = rhs.high_water;
+        }
+        return *this;
+    }
+};
+
+namespace detail {
+
+/// The counters behind a pool_metrics snapshot; relaxed atomics only
+struct pool_counters {
+    pool_counters() : hits(0), misses(0), recycled(0), dropped(0),
+        high_water(0) {}
+
+    void on_hit() { hits.fetch_add(1,lib::memory_order_relaxed); }
+    void on_miss() { misses.fetch_add(1,lib::memory_order_relaxed); }
+    void on_recycle(size_t occupancy_now) {
+        recycled.fetch_add(1,lib::memory_order_relaxed);
+        // benign race: two concurrent updates may settle on the smaller
+        // value for one snapshot; the mark is advisory
+        if (occupancy_now > high_water.load(lib::memory_order_relaxed)) {
+            high_water.store(occupancy_now,lib::memory_order_relaxed);
+        }
+    }
+    void on_drop() { dropped.fetch_add(1,lib::memory_order_relaxed); }
+
+    pool_metrics snapshot(size_t occupancy) const {
+        pool_metrics m;
+        m.hits = hits.load(lib::memory_order_relaxed);
+        m.misses = misses.load(lib::memory_order_relaxed);
+        m.recycled = recycled.load(lib::memory_order_relaxed);
+        m.dropped = dropped.load(lib::memory_order_relaxed);
+        m.occupancy = occupancy;
+        m.high_water = high_water.load(lib::memory_order_relaxed);
+        return m;
+    }
+
+    lib::atomic<uint64_t> hits;
+    lib::atomic<uint64_t> misses;
+    lib::atomic<uint64_t> recycled;
+    lib::atomic<uint64_t> dropped;
+    lib::atomic<size_t> high_water;
+};
+
+} // namespace detail
+} // namespace message_buffer
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_METRICS_HPP
@@ -11,10 +11,10 @@
  *     * Neither the name of the WebSocket++ Project nor the
  *       names of its contributors may be used to endorse or promote products
  *       derived from this software without specific prior written permission.
- * 
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
- * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
- * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
  * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
  * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
  * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
@@ -22,180 +22,446 @@
  * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- * 
+ *
  */
 
-#ifndef WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
-#define WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
 
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/message_buffer/metrics.hpp>
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/frame.hpp>
 
-#include <string>
+#include <cstddef>
 
 namespace websocketpp {
 namespace message_buffer {
 
-/* # message:
- * object that stores a message while it is being sent or received. Contains
- * the message payload itself, the message header, the extension data, and the
- * opcode.
- * 
- * # connection_message_manager:
- * An object that manages all of the message_buffers associated with a given
- * connection. Impliments the get_message_buffer(size) method that returns
- * a message buffer at least size bytes long.
- * 
- * Message buffers are reference counted with shared ownership semantics. Once 
- * requested from the manager the requester and it's associated downstream code
- * may keep a pointer to the message indefinitely at a cost of extra resource
- * usage. Once the reference count drops to the point where the manager is the
- * only reference the messages is recycled using whatever method is implemented
- * in the manager.
- * 
- * # endpoint_message_manager:
- * An object that manages connection_message_managers. Impliments the 
- * get_message_manager() method. This is used once by each connection to 
- * request the message manager that they are supposed to use to manage message
- * buffers for their own use.
- * 
- * TYPES OF CONNECTION_MESSAGE_MANAGERS
- * - allocate a message with the exact size every time one is requested
- * - maintain a pool of pre-allocated messages and return one when needed. 
- *   Recycle previously used messages back into the pool
- * 
- * TYPES OF ENDPOINT_MESSAGE_MANAGERS
- *  - allocate a new connection manager for each connection. Message pools
- *    become connection specific. This increases memory usage but improves
- *    concurrency.
- *  - allocate a single connection manager and share a pointer to it with all
- *    connections created by this endpoint. The message pool will be shared
- *    among all connections, improving memory usage and performance at the cost
- *    of reduced concurrency
+/// Pooling message managers
+/**
+ * Drop in replacements for the alloc message managers that recycle message
+ * objects (including their payload string capacity) through a lock free
+ * freelist instead of allocating fresh ones per message. Select them in a
+ * config the same way the alloc managers are selected:
+ *
+ * \code
+ * typedef message_buffer::message<message_buffer::pool::con_msg_manager>
+ *     message_type;
+ * typedef message_buffer::pool::con_msg_manager<message_type>
+ *     con_msg_manager_type;
+ * typedef message_buffer::pool::endpoint_msg_manager<con_msg_manager_type>
+ *     endpoint_msg_manager_type;
+ * \endcode
+ *
+ * Recycled messages retain their payload capacity, so a connection in steady
+ * state receives and sends without message or payload allocations. To bound
+ * memory, messages whose payload capacity grew beyond the recycle capacity
+ * cap are freed rather than pooled, and the freelist itself is capped.
+ *
+ * The freelists use double width (pointer plus tag) atomics; on gcc/clang
+ * targets without native 16 byte compare-exchange this requires linking
+ * libatomic.
  */
+namespace pool {
 
-/// Custom deleter for use in shared_ptrs to message.
-/** 
- * This is used to catch messages about to be deleted and offer the manager the
- * ability to recycle them instead. Message::recycle will return true if it was
- * successfully recycled and false otherwise. In the case of exceptions or error
- * this deleter frees the memory.
+/// Custom deleter for shared_ptrs to pooled messages
+/**
+ * Invoked when the last reference to a pooled message drops. Offers the
+ * message back to its manager via the message::recycle chain; if recycling
+ * is refused (pool full, payload too large, manager gone) the message is
+ * freed normally.
  */
 template <typename T>
-void message_deleter(T* msg) {
+void message_deleter(T * msg) {
     try {
         if (!msg->recycle()) {
             delete msg;
         }
     } catch (...) {
-        // TODO: is there a better way to ensure this function doesn't throw?
         delete msg;
     }
 }
 
-/// Represents a buffer for a single WebSocket message.
+/// Lock free freelist of fixed size raw memory blocks
 /**
- *
- *
+ * Recycles the shared_ptr control blocks that wrap pooled messages so that
+ * handing out a recycled message performs no heap allocation at all. The
+ * block size is fixed by the first allocation (control blocks for a given
+ * message type are all the same size); requests of any other size fall
+ * through to the global heap. Blocks are only returned to the heap when the
+ * freelist is destroyed, which makes the stale-read in the pop loop safe.
  */
-template <typename con_msg_manager>
-class message {
+class block_freelist {
 public:
-    typedef lib::shared_ptr<message> ptr;
-    
-    typedef typename con_msg_manager::weak_ptr con_msg_man_ptr;
+    typedef lib::shared_ptr<block_freelist> ptr;
 
-    message(con_msg_man_ptr manager, size_t size = 128) 
-      : m_manager(manager)
-      , m_payload(size) {}
+    /// Maximum number of blocks retained
+    static size_t const max_blocks = 64;
 
-    frame::opcode::value get_opcode() const {
-        return m_opcode;
+    block_freelist() : m_block_size(0), m_count(0) {
+        tagged_head init = {NULL,0};
+        m_free.store(init);
     }
-    const std::string& get_header() const {
-        return m_header;
-    }
-    const std::string& get_extension_data() const {
-        return m_extension_data;
+
+    ~block_freelist() {
+        node * cur = m_free.load(lib::memory_order_relaxed).ptr;
+        while (cur) {
+            node * next = cur->next;
+            ::operator delete(static_cast<void *>(cur));
+            cur = next;
+        }
     }
-    const std::string& get_payload() const {
-        return m_payload;
+
+    void * allocate(size_t size) {
+        size_t expected = 0;
+        if (m_block_size.load(lib::memory_order_relaxed) == 0) {
+            // first allocation fixes the recycled block size
+            m_block_size.compare_exchange_strong(expected,size);
+        }
+        if (size != m_block_size.load(lib::memory_order_relaxed)) {
+            m_metrics.on_miss();
+            return ::operator new(size);
+        }
+
+        tagged_head old = m_free.load();
+        tagged_head next;
+        do {
+            if (!old.ptr) {
+                m_metrics.on_miss();
+                return ::operator new(size);
+            }
+            next.ptr = old.ptr->next;
+            next.tag = old.tag+1;
+        } while (!m_free.compare_exchange_weak(old,next));
+
+        m_count.fetch_sub(1,lib::memory_order_relaxed);
+        m_metrics.on_hit();
+        return static_cast<void *>(old.ptr);
     }
-    
-    /// Recycle the message
-    /**
-     * A request to recycle this message was received. Forward that request to
-     * the connection message manager for processing. Errors and exceptions
-     * from the manager's recycle member function should be passed back up the
-     * call chain. The caller to message::recycle will deal with them.
-     *
-     * Recycle must *only* be called by the message shared_ptr's destructor. 
-     * Once recycled successfully, ownership of the memory has been passed to 
-     * another system and must not be accessed again.
-     * 
-     * @return true if the message was successfully recycled, false otherwise.
-     */
-    bool recycle() {
-        typename con_msg_manager::ptr shared = m_manager.lock();
 
-        if (shared) {
-            return shared->(recycle(this));
-        } else {
-            return false;
+    void deallocate(void * p, size_t size) {
+        if (size != m_block_size.load(lib::memory_order_relaxed) ||
+            m_count.load(lib::memory_order_relaxed) >= max_blocks)
+        {
+            m_metrics.on_drop();
+            ::operator delete(p);
+            return;
         }
+
+        node * n = static_cast<node *>(p);
+        tagged_head old = m_free.load();
+        tagged_head next;
+        do {
+            n->next = old.ptr;
+            next.ptr = n;
+            next.tag = old.tag+1;
+        } while (!m_free.compare_exchange_weak(old,next));
+
+        m_metrics.on_recycle(
+            m_count.fetch_add(1,lib::memory_order_relaxed)+1);
+    }
+
+    /// Occupancy and traffic snapshot for capacity planning
+    pool_metrics get_pool_metrics() const {
+        return m_metrics.snapshot(m_count.load(lib::memory_order_relaxed));
     }
+
 private:
-    con_msg_man_ptr             m_manager;
-    
-    frame::opcode::value        m_opcode;
-    std::string                 m_header;
-    std::string                 m_extension_data;
-    std::string                 m_payload;
+    // non-copyable
+    block_freelist(block_freelist const &);
+    block_freelist & operator=(block_freelist const &);
+
+    struct node {
+        node * next;
+    };
+
+    struct tagged_head {
+        node * ptr;
+        size_t tag;
+    };
+
+    lib::atomic<size_t> m_block_size;
+    lib::atomic<size_t> m_count;
+    lib::atomic<tagged_head> m_free;
+    message_buffer::detail::pool_counters m_metrics;
 };
 
-namespace alloc {
+/// std allocator adapter over a block_freelist
+/**
+ * Holds the freelist by shared_ptr so control blocks allocated from it can
+ * outlive the message manager that created them.
+ */
+template <typename T>
+struct block_allocator {
+    typedef T value_type;
+
+    explicit block_allocator(block_freelist::ptr f) : freelist(f) {}
+
+    template <typename U>
+    block_allocator(block_allocator<U> const & other)
+      : freelist(other.freelist) {}
+
+    T * allocate(std::size_t n) {
+        return static_cast<T *>(freelist->allocate(n*sizeof(T)));
+    }
+
+    void deallocate(T * p, std::size_t n) {
+        freelist->deallocate(static_cast<void *>(p),n*sizeof(T));
+    }
 
-/// A connection message manager that allocates a new message for each
-/// request.
+    template <typename U>
+    bool operator==(block_allocator<U> const & other) const {
+        return freelist == other.freelist;
+    }
+
+    template <typename U>
+    bool operator!=(block_allocator<U> const & other) const {
+        return freelist != other.freelist;
+    }
+
+    block_freelist::ptr freelist;
+};
+
+/// Connection message manager with a lock free message freelist
+/**
+ * Maintains recycled messages on an intrusive Treiber stack (messages link
+ * through their pool hook) with a tag counter to avoid ABA, so both
+ * producers returning messages and threads requesting them operate without
+ * locks. Messages handed out are wrapped in shared_ptrs whose deleter
+ * routes them back here.
+ *
+ * The pool is capped in two dimensions: at most max_pool_size messages are
+ * retained, and messages whose payload capacity exceeds
+ * max_recycle_capacity bytes are freed on recycle so a single jumbo message
+ * cannot pin its buffer forever.
+ */
 template <typename message>
-class con_msg_manager {
+class con_msg_manager
+  : public lib::enable_shared_from_this<con_msg_manager<message> >
+{
 public:
+    typedef con_msg_manager<message> type;
     typedef lib::shared_ptr<con_msg_manager> ptr;
     typedef lib::weak_ptr<con_msg_manager> weak_ptr;
 
     typedef typename message::ptr message_ptr;
-    
-    /// Get a message buffer with specified size
+
+    /// Default maximum number of messages retained in the freelist
+    static size_t const default_max_pool_size = 32;
+    /// Default payload capacity (bytes) above which messages are not
+    /// pooled; matches the largest size class tier
+    static size_t const default_max_recycle_capacity = 1048576;
+
+    /// Number of payload size classes
+    static size_t const size_classes = 4;
+    /// Size class capacity tiers: a request is served from the smallest
+    /// class that fits and new payloads are reserved up to their tier,
+    /// so a 64 byte ack and a snapshot never trade buffers and reused
+    /// capacity matches demand instead of fragmenting toward the
+    /// largest burst. (Payload storage is std::string, whose alignment
+    /// the allocator fixes; the SIMD kernels handle arbitrary heads, so
+    /// classing is about capacity fit, not alignment.)
+    static size_t class_capacity(size_t cls) {
+        static size_t const caps[size_classes] =
+            {256, 4096, 65536, 1048576};
+        return caps[cls];
+    }
+    /// Retention cap per class; small buffers are cheap to keep, big
+    /// ones are not
+    static size_t class_retention(size_t cls) {
+        static size_t const caps[size_classes] = {16, 8, 6, 2};
+        return caps[cls];
+    }
+    /// The class serving a payload of the given size, or size_classes
+    /// when it exceeds every tier (never pooled)
+    static size_t class_for(size_t size) {
+        for (size_t i = 0; i < size_classes; i++) {
+            if (size <= class_capacity(i)) {
+                return i;
+            }
+        }
+        return size_classes;
+    }
+
+    explicit con_msg_manager(
+        size_t max_pool_size = default_max_pool_size,
+        size_t max_recycle_capacity = default_max_recycle_capacity)
+      : m_max_pool_size(max_pool_size)
+      , m_max_recycle_capacity(max_recycle_capacity)
+      , m_blocks(new block_freelist())
+    {
+        tagged_head init = {NULL,0};
+        for (size_t i = 0; i < size_classes; i++) {
+            m_free[i].store(init);
+            m_free_count[i].store(0,lib::memory_order_relaxed);
+        }
+    }
+
+    ~con_msg_manager() {
+        for (size_t i = 0; i < size_classes; i++) {
+            message * cur = m_free[i].load(lib::memory_order_relaxed).ptr;
+            while (cur) {
+                message * next = cur->get_pool_next();
+                delete cur;
+                cur = next;
+            }
+        }
+    }
+
+    /// Get an empty message buffer
     /**
+     * @return A shared pointer to an empty message, recycled if possible
+     */
+    message_ptr get_message() {
+        return get_message(frame::opcode::CONTINUATION,0);
+    }
+
+    /// Get a message buffer with specified size and opcode
+    /**
+     * @param op The opcode to use
      * @param size Minimum size in bytes to request for the message payload.
      *
-     * @return A shared pointer to a new message with specified size.
+     * @return A shared pointer to a message with the requested settings,
+     * recycled if possible
      */
-    message_ptr get_message(size_t size) const {
-        return message_ptr(new message(size));
+    message_ptr get_message(frame::opcode::value op, size_t size) {
+        size_t cls = class_for(size);
+        message * raw = (cls < size_classes ? pop(cls) : NULL);
+        if (raw) {
+            m_metrics.on_hit();
+            raw->reset(op);
+        } else {
+            m_metrics.on_miss();
+            // construct with the tier capacity directly: a second
+            // reserve on an already-sized string over-allocates
+            // (libstdc++ grows reserve geometrically), pushing the
+            // buffer out of its class
+            raw = new message(type::shared_from_this(),op,
+                (cls < size_classes && size > 0)
+                    ? class_capacity(cls) : size);
+        }
+        if (raw->get_payload().capacity() < size) {
+            raw->get_raw_payload().reserve(size);
+        }
+        return message_ptr(raw,&message_deleter<message>,
+            block_allocator<char>(m_blocks));
     }
-    
+
     /// Recycle a message
     /**
-     * This method shouldn't be called. If it is, return false to indicate an
-     * error. The rest of the method recycle chain should notice this and free
-     * the memory.
+     * Called (via the shared_ptr deleter and message::recycle) when the last
+     * reference to a message drops. Returns the message to the freelist
+     * unless a cap would be exceeded.
      *
      * @param msg The message to be recycled.
      *
-     * @return true if the message was successfully recycled, false otherwse.
+     * @return true if the message was taken by the pool (the caller must not
+     * free it), false if the caller should free it
      */
     bool recycle(message * msg) {
-        return false;
+        // judge the message's own payload storage, not a payload it may be
+        // referencing (see message::set_shared_payload); classify it by
+        // capacity so it returns to the tier it can actually serve
+        size_t cap = msg->get_raw_payload().capacity();
+        size_t cls = class_for(cap);
+        if (cls >= size_classes || cap > m_max_recycle_capacity) {
+            m_metrics.on_drop();
+            return false;
+        }
+        if (m_free_count[cls].load(lib::memory_order_relaxed)
+            >= class_retention(cls)
+            || pool_size() >= m_max_pool_size)
+        {
+            m_metrics.on_drop();
+            return false;
+        }
+
+        // drop payload references and content now so pooled messages do not
+        // pin other messages or buffers while idle in the freelist
+        msg->reset(frame::opcode::CONTINUATION);
+
+        tagged_head old = m_free[cls].load();
+        tagged_head next;
+        do {
+            msg->set_pool_next(old.ptr);
+            next.ptr = msg;
+            next.tag = old.tag+1;
+        } while (!m_free[cls].compare_exchange_weak(old,next));
+
+        m_metrics.on_recycle(
+            m_free_count[cls].fetch_add(1,lib::memory_order_relaxed)+1);
+        return true;
+    }
+
+    /// Approximate number of messages currently pooled, all classes
+    size_t pool_size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < size_classes; i++) {
+            total += m_free_count[i].load(lib::memory_order_relaxed);
+        }
+        return total;
     }
+
+    /// Messages currently pooled in one size class
+    size_t pool_size(size_t cls) const {
+        return m_free_count[cls].load(lib::memory_order_relaxed);
+    }
+
+    /// Message pool occupancy and traffic snapshot
+    pool_metrics get_pool_metrics() const {
+        return m_metrics.snapshot(pool_size());
+    }
+
+    /// Control-block pool snapshot (the shared_ptr block freelist)
+    pool_metrics get_block_pool_metrics() const {
+        return m_blocks->get_pool_metrics();
+    }
+
+private:
+    /// Freelist head with a modification counter to avoid ABA
+    struct tagged_head {
+        message * ptr;
+        size_t tag;
+    };
+
+    /// Pop a message from the freelist, or NULL if it is empty
+    /**
+     * Messages on the freelist are never freed while the manager is alive,
+     * so dereferencing a stale head to read its next pointer is safe; the
+     * tag comparison rejects the exchange if the head moved.
+     */
+    message * pop(size_t cls) {
+        tagged_head old = m_free[cls].load();
+        tagged_head next;
+        do {
+            if (!old.ptr) {
+                return NULL;
+            }
+            next.ptr = old.ptr->get_pool_next();
+            next.tag = old.tag+1;
+        } while (!m_free[cls].compare_exchange_weak(old,next));
+
+        m_free_count[cls].fetch_sub(1,lib::memory_order_relaxed);
+        return old.ptr;
+    }
+
+    size_t const m_max_pool_size;
+    size_t const m_max_recycle_capacity;
+
+    lib::atomic<tagged_head> m_free[size_classes];
+    lib::atomic<size_t> m_free_count[size_classes];
+    message_buffer::detail::pool_counters m_metrics;
+    block_freelist::ptr m_blocks;
 };
 
-/// An endpoint message manager that allocates a new manager for each
-/// connection.
+/// An endpoint message manager that allocates a new pooling manager for
+/// each connection
 template <typename con_msg_manager>
 class endpoint_msg_manager {
 public:
     typedef typename con_msg_manager::ptr con_msg_man_ptr;
-    
+
     /// Get a pointer to a connection message manager
     /**
      * @return A pointer to the requested connection message manager.
@@ -205,25 +471,8 @@ public:
     }
 };
 
-} // namespace alloc
-
-namespace pool {
-
-/// A connection messages manager that maintains a pool of messages that is
-/// used to fulfill get_message requests.
-class con_msg_manager {
-
-};
-    
-/// An endpoint manager that maintains a shared pool of connection managers
-/// and returns an appropriate one for the requesting connection.
-class endpoint_msg_manager {
-
-};
-
 } // namespace pool
-
 } // namespace message_buffer
 } // namespace websocketpp
 
-#endif // WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
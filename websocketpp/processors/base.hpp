@@ -35,6 +35,9 @@
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/uri.hpp>
 
+#include <websocketpp/sha1/sha1.hpp>
+
+#include <cstring>
 #include <map>
 #include <string>
 
@@ -50,6 +53,59 @@ static char const handshake_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
 } // namespace constants
 
+/// Compute the Sec-WebSocket-Accept value for a client key in one pass
+/**
+ * Concatenates the client key with the handshake GUID in a stack buffer,
+ * hashes it (using hardware SHA1 when available), and base64 encodes the
+ * digest directly into the supplied output string, which afterwards holds
+ * exactly the 28 character accept token. No intermediate strings are
+ * allocated; out may alias key.
+ *
+ * @param key The Sec-WebSocket-Key header value sent by the client
+ * @param out String to receive the accept token
+ */
+inline void make_accept_key(std::string const & key, std::string & out) {
+    static char const b64_table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // client keys are 24 bytes; allow modest slack before falling back to
+    // heap concatenation for oversized input
+    unsigned char buf[128];
+    unsigned char digest[20];
+    size_t guid_len = sizeof(constants::handshake_guid)-1;
+
+    if (key.size() <= sizeof(buf)-guid_len) {
+        std::memcpy(buf,key.data(),key.size());
+        std::memcpy(buf+key.size(),constants::handshake_guid,guid_len);
+        sha1_one_shot(buf,key.size()+guid_len,digest);
+    } else {
+        std::string full = key;
+        full.append(constants::handshake_guid,guid_len);
+        sha1_one_shot(full.data(),full.size(),digest);
+    }
+
+    // base64 of 20 bytes = 28 chars including one pad character
+    out.resize(28);
+    size_t o = 0;
+    for (size_t i = 0; i < 18; i += 3) {
+        uint32_t n = (static_cast<uint32_t>(digest[i]) << 16) |
+                     (static_cast<uint32_t>(digest[i+1]) << 8) |
+                      static_cast<uint32_t>(digest[i+2]);
+        out[o++] = b64_table[(n >> 18) & 0x3F];
+        out[o++] = b64_table[(n >> 12) & 0x3F];
+        out[o++] = b64_table[(n >> 6) & 0x3F];
+        out[o++] = b64_table[n & 0x3F];
+    }
+    {
+        uint32_t n = (static_cast<uint32_t>(digest[18]) << 16) |
+                     (static_cast<uint32_t>(digest[19]) << 8);
+        out[o++] = b64_table[(n >> 18) & 0x3F];
+        out[o++] = b64_table[(n >> 12) & 0x3F];
+        out[o++] = b64_table[(n >> 6) & 0x3F];
+        out[o++] = '=';
+    }
+}
+
 
 /// Processor class related error codes
 namespace error_cat {
@@ -64,8 +64,11 @@ public:
       , m_state(HEADER)
       , m_msg_manager(manager) {}
     
+    /// Protocol version this processor implements
+    static int const protocol_version = 0;
+
     int get_version() const {
-        return 0;
+        return protocol_version;
     }
     
     lib::error_code validate_handshake(request_type const & r) const {
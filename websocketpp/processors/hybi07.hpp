@@ -56,8 +56,11 @@ public:
         return error::make_error_code(error::no_protocol_support);
     }
 
+    /// Protocol version this processor implements
+    static int const protocol_version = 7;
+
     int get_version() const {
-        return 7;
+        return protocol_version;
     }
 private:
 };
@@ -57,8 +57,11 @@ public:
         return error::make_error_code(error::no_protocol_support);
     }
     
+    /// Protocol version this processor implements
+    static int const protocol_version = 8;
+
     int get_version() const {
-        return 8;
+        return protocol_version;
     }
     
     const std::string& get_origin(request_type const & r) const {
@@ -30,12 +30,16 @@
 
 #include <cassert>
 
+#include <websocketpp/extensions/extension.hpp>
 #include <websocketpp/frame.hpp>
 #include <websocketpp/utf8_validator.hpp>
 #include <websocketpp/common/network.hpp>
 #include <websocketpp/http/constants.hpp>
+#include <websocketpp/http/parser.hpp>
 
 #include <websocketpp/processors/processor.hpp>
+#include <websocketpp/common/time.hpp>
+#include <websocketpp/tracing.hpp>
 
 #include <websocketpp/sha1/sha1.hpp>
 #include <websocketpp/base64/base64.hpp>
@@ -64,6 +68,21 @@ public:
     typedef typename config::rng_type rng_type;
 
     typedef typename config::permessage_deflate_type permessage_deflate_type;
+    typedef typename tracing::selector<config>::type tracer;
+
+    /// Compile time message-size-class bounds from the config's cap:
+    /// a cap within the 16-bit length class makes every 64-bit length
+    /// frame invalid by construction, and a cap within the basic class
+    /// likewise both extended classes -- the rejects below then fold to
+    /// header-byte compares and the pruned length handling never runs
+    static bool const size_bounded =
+        config::max_message_size != 0;
+    static bool const size_fits_16bit =
+        config::max_message_size != 0
+        && config::max_message_size <= 65535;
+    static bool const size_fits_basic =
+        config::max_message_size != 0
+        && config::max_message_size <= 125;
     
     typedef std::pair<lib::error_code,std::string> err_str_pair;
 
@@ -71,13 +90,151 @@ public:
         rng_type& rng) 
       : processor<config>(secure,server)
       , m_msg_manager(manager)
+      , m_direct_active(false)
+      , m_borrowed_payloads(false)
+      , m_validation(validation_policy::strict)
       , m_rng(rng)
+      , m_data_msg_compressed(false)
     {
         reset_headers();
     } 
     
+    /// Protocol version this processor implements
+    static int const protocol_version = 13;
+
     int get_version() const {
-        return 13;
+        return protocol_version;
+    }
+
+    /// Install a streaming payload sink
+    /**
+     * With a sink installed, data message payloads are delivered to it as
+     * spans directly from process_payload_bytes (after unmasking,
+     * decompression, and UTF-8 validation) and are not accumulated in the
+     * message buffer; completed data messages surface with an empty
+     * payload. Control frame payloads are unaffected.
+     */
+    void set_payload_sink(typename base::payload_sink sink) {
+        m_payload_sink = sink;
+    }
+
+    void set_borrowed_payloads(bool value) {
+        m_borrowed_payloads = value;
+    }
+
+    void set_validation_policy(validation_policy::value v) {
+        m_validation = v;
+    }
+
+    void set_compression_dictionary(std::string const & dict) {
+        m_permessage_deflate.set_dictionary(dict);
+    }
+
+    void set_compression_write_reset(size_t messages, size_t bytes) {
+        m_permessage_deflate.set_write_reset_interval(messages,bytes);
+    }
+
+    void set_compression_level_controller(
+        extensions::permessage_deflate::level_controller::ptr controller)
+    {
+        m_permessage_deflate.set_level_controller(controller);
+    }
+
+    /// Apply the validation policy at the end of a text message
+    /**
+     * strict: the incremental validator must be at a code point boundary.
+     * on_complete: validate the assembled payload in one pass (span
+     * delivered messages have nothing assembled and pass).
+     * trusted_skip: always passes.
+     */
+    bool text_message_complete() {
+        if (frame::get_opcode(m_basic_header) != frame::opcode::TEXT
+            || m_validation == validation_policy::trusted_skip)
+        {
+            return true;
+        }
+        if (m_validation == validation_policy::on_complete) {
+            // assembled messages validate in one pass here (the spans were
+            // not fed to the incremental validator); span delivered
+            // messages were, so their boundary check still applies
+            std::string const & payload =
+                m_current_msg->msg_ptr->get_payload();
+            return utf8_validator::validate(payload)
+                && m_current_msg->validator.complete();
+        }
+        return m_current_msg->validator.complete();
+    }
+
+    /// Expose the current message's payload storage as a read target
+    /**
+     * Available while mid payload on an uncompressed data frame with no
+     * streaming sink installed. The payload string is resized up front to
+     * hold the rest of the frame; only unmasking remains as an in place
+     * pass once bytes land (see consume_in_place).
+     */
+    bool get_payload_read_target(uint8_t ** target, size_t * max_len) {
+        if (m_state != APPLICATION || m_bytes_needed == 0 || !m_current_msg ||
+            m_payload_sink ||
+            frame::opcode::is_control(m_current_msg->msg_ptr->get_opcode()) ||
+            (m_permessage_deflate.is_enabled() &&
+             frame::get_rsv1(m_basic_header)))
+        {
+            return false;
+        }
+
+        std::string & out = m_current_msg->msg_ptr->get_raw_payload();
+        if (!m_direct_active) {
+            out.resize(out.size()+m_bytes_needed);
+            m_direct_active = true;
+        }
+        *target = reinterpret_cast<uint8_t *>(
+            &out[out.size()-m_bytes_needed]);
+        *max_len = m_bytes_needed;
+        return true;
+    }
+
+    /// Unmask, validate, and account for directly read payload bytes
+    size_t consume_in_place(size_t len, lib::error_code & ec) {
+        ec = lib::error_code();
+
+        std::string & out = m_current_msg->msg_ptr->get_raw_payload();
+        uint8_t * data = reinterpret_cast<uint8_t *>(
+            &out[out.size()-m_bytes_needed]);
+
+        if (frame::get_masked(m_basic_header)) {
+            // byte oriented unmasking: unlike the word/SIMD kernels it
+            // never touches bytes past the span, which matters here since
+            // the span ends exactly at the string's size
+            m_current_msg->prepared_key = frame::byte_mask_circ(
+                data,len,m_current_msg->prepared_key);
+        }
+
+        if (m_validation == validation_policy::strict
+            && m_current_msg->msg_ptr->get_opcode() == frame::opcode::TEXT)
+        {
+            if (!m_current_msg->validator.decode(data,data+len)) {
+                ec = make_error_code(error::invalid_utf8);
+                m_state = FATAL_ERROR;
+                return 0;
+            }
+        }
+
+        m_bytes_needed -= len;
+
+        if (m_bytes_needed == 0) {
+            m_direct_active = false;
+            if (frame::get_fin(m_basic_header)) {
+                if (!text_message_complete()) {
+                    ec = make_error_code(error::invalid_utf8);
+                    m_state = FATAL_ERROR;
+                    return 0;
+                }
+                m_state = READY;
+            } else {
+                this->reset_headers();
+            }
+        }
+        return len;
     }
     
     bool has_permessage_deflate() const {
@@ -94,43 +251,79 @@ public:
             return ret;
         }
         
-        http::parameter_list p;
-
-        bool error = req.get_header_as_plist("Sec-WebSocket-Extensions",p);
-        
-        if (error) {
-            ret.first = make_error_code(error::extension_parse_error);
+        std::string const & raw = req.get_header("Sec-WebSocket-Extensions");
+        if (raw.empty()) {
             return ret;
         }
-        
-        // If there are no extensions parsed then we are done!
-        if (p.size() == 0) {
+        if (!m_permessage_deflate.is_implemented()) {
+            // no extension to negotiate, but a malformed header is still
+            // a parse error, exactly as before this fast path existed
+            http::parameter_list check;
+            if (req.get_header_as_plist("Sec-WebSocket-Extensions",check)) {
+                ret.first = make_error_code(error::extension_parse_error);
+            }
             return ret;
         }
-        
-        http::parameter_list::const_iterator it;
-        
-        if (m_permessage_deflate.is_implemented()) {
-            err_str_pair neg_ret;
-            for (it = p.begin(); it != p.end(); ++it) {
-                // look through each extension, if the key is permessage-deflate
-                if (it->first == "permessage-deflate") {
-                    neg_ret = m_permessage_deflate.negotiate(it->second);
-                    
-                    if (neg_ret.first) {
-                        // Figure out if this is an error that should halt all
-                        // extension negotiations or simply cause negotiation of
-                        // this specific extension to fail.
-                        std::cout << "permessage-compress negotiation failed: " 
-                                  << neg_ret.first.message() << std::endl;
-                    } else {
-                        // Note: this list will need commas if WebSocket++ ever
-                        // supports more than one extension
-                        ret.second += neg_ret.second;
-                        continue;
-                    }
+
+        // allocation-free scan of the common offer grammar; only an
+        // offer the extension actually claims materializes an attribute
+        // map, so the typical single permessage-deflate offer costs a
+        // handful of map nodes instead of a full parameter_list of
+        // every token
+        http::parser::extension_offer_view offers[8];
+        bool fallback = false;
+        size_t n = http::parser::parse_extension_offers(
+            raw.data(),raw.data()+raw.size(),offers,8,fallback);
+
+        http::parameter_list p;
+        if (fallback) {
+            // quoted strings or an oversized offer list: the generic
+            // parser handles the full grammar
+            if (req.get_header_as_plist("Sec-WebSocket-Extensions",p)) {
+                ret.first = make_error_code(error::extension_parse_error);
+                return ret;
+            }
+        }
+
+        err_str_pair neg_ret;
+        size_t total = fallback ? p.size() : n;
+        std::string token;
+        for (size_t i = 0; i < total; i++) {
+            http::attribute_list attrs;
+            if (fallback) {
+                token = p[i].first;
+                attrs = p[i].second;
+            } else {
+                token.assign(offers[i].name,offers[i].name_len);
+                for (size_t j = 0; j < offers[i].param_count; j++) {
+                    http::parser::extension_offer_view::param_view const &
+                        prm = offers[i].params[j];
+                    attrs[std::string(prm.name,prm.name_len)] =
+                        prm.value ? std::string(prm.value,prm.value_len)
+                                  : std::string();
                 }
             }
+
+            // offer each extension token to the configured extension
+            // (or chain); unknown_token means no stage claims it
+            neg_ret = m_permessage_deflate.negotiate_token(token,attrs);
+
+            if (neg_ret.first == extensions::error::make_error_code(
+                extensions::error::unknown_token))
+            {
+                continue;
+            } else if (neg_ret.first) {
+                // Figure out if this is an error that should halt all
+                // extension negotiations or simply cause negotiation of
+                // this specific extension to fail.
+                std::cout << "permessage-compress negotiation failed: "
+                          << neg_ret.first.message() << std::endl;
+            } else {
+                if (!ret.second.empty()) {
+                    ret.second += ", ";
+                }
+                ret.second += neg_ret.second;
+            }
         }
 
         return ret;
@@ -206,17 +399,26 @@ public:
         }
         
         // Generate handshake key
+        req.replace_header("Sec-WebSocket-Key",generate_client_key());
+                
+        return lib::error_code();
+    }
+
+    /// Generate a fresh random Sec-WebSocket-Key value
+    /**
+     * Factored from client_handshake_request so the client request
+     * template fast path can mint a key without re-populating the whole
+     * request.
+     */
+    std::string generate_client_key() const /*override*/ {
         frame::uint32_converter conv;
         unsigned char raw_key[16];
-        
+
         for (int i = 0; i < 4; i++) {
             conv.i = m_rng();
             std::copy(conv.c,conv.c+4,&raw_key[i*4]);
         }
-        
-        req.replace_header("Sec-WebSocket-Key",base64_encode(raw_key, 16));
-                
-        return lib::error_code();
+        return base64_encode(raw_key, 16);
     }
     
     lib::error_code validate_server_handshake_response(request_type const & req,
@@ -258,6 +460,10 @@ public:
         return res.raw();
     }
     
+    void append_raw(response_type const & res, std::string & out) const {
+        res.serialize(out);
+    }
+    
     std::string const & get_origin(request_type const & r) const {
         return r.get_header("Origin");
     }
@@ -325,6 +531,43 @@ public:
                (p < len || m_bytes_needed == 0))
         {
             if (m_state == HEADER_BASIC) {
+                // fast path: a fresh header with its full extent already
+                // buffered decodes in one shot (the overwhelmingly common
+                // case); split headers fall through to the state machine
+                if (m_bytes_needed == frame::BASIC_HEADER_LENGTH) {
+                    size_t consumed = frame::decode_header(buf+p,len-p,
+                        m_basic_header,m_extended_header);
+                    if (consumed) {
+#ifdef WEBSOCKETPP_CONSUME_PREFETCH
+                        // prefetch the next frame's header: its offset
+                        // falls out of the decode just done. Opt-in:
+                        // this only pays when read buffers arrive cold
+                        // (large buffers, streamed straight off the
+                        // NIC); on the cache-hot replay corpus the hint
+                        // measures as pure overhead, so defaults leave
+                        // it out
+                        {
+                            size_t next = p+consumed+static_cast<size_t>(
+                                frame::get_payload_size(m_basic_header,
+                                    m_extended_header));
+                            if (next+frame::BASIC_HEADER_LENGTH <= len) {
+                                WEBSOCKETPP_PREFETCH(buf+next);
+                            }
+                        }
+#endif
+                        p += consumed;
+                        m_bytes_needed = 0;
+                        ec = this->validate_incoming_basic_header(
+                            m_basic_header, base::m_server,
+                            !m_data_msg.msg_ptr
+                        );
+                        if (ec) {break;}
+                        ec = this->finish_header();
+                        if (ec) {break;}
+                        continue;
+                    }
+                }
+
                 p += this->copy_basic_header_bytes(buf+p,len-p);
                 
                 if (m_bytes_needed > 0) {
@@ -347,45 +590,9 @@ public:
                 if (m_bytes_needed > 0) {
                     continue;
                 }
-                
-                ec = validate_incoming_extended_header(m_basic_header,m_extended_header);
+
+                ec = this->finish_header();
                 if (ec){break;}
-                    
-                m_state = APPLICATION;
-                m_bytes_needed = static_cast<size_t>(get_payload_size(m_basic_header,m_extended_header));
-                    
-                // check if this frame is the start of a new message and set up
-                // the appropriate message metadata.
-                frame::opcode::value op = frame::get_opcode(m_basic_header);
-                
-                // TODO: get_message failure conditions
-                
-                if (frame::opcode::is_control(op)) {
-                    m_control_msg = msg_metadata(
-                        m_msg_manager->get_message(op,m_bytes_needed),
-                        frame::get_masking_key(m_basic_header,m_extended_header)
-                    );
-                    
-                    m_current_msg = &m_control_msg;
-                } else {
-                    if (!m_data_msg.msg_ptr) {
-                        m_data_msg = msg_metadata(
-                            m_msg_manager->get_message(op,m_bytes_needed),
-                            frame::get_masking_key(m_basic_header,m_extended_header)
-                        );
-                    } else {
-                        // Each frame starts a new masking key. All other state
-                        // remains between frames.
-                        m_data_msg.prepared_key = prepare_masking_key(
-                            frame::get_masking_key(
-                                m_basic_header,
-                                m_extended_header
-                            )
-                        );
-                        // TODO: reserve space in the existing message for the new bytes
-                    }
-                    m_current_msg = &m_data_msg;
-                }
             } else if (m_state == EXTENSION) {
                 m_state = APPLICATION;
             } else if (m_state == APPLICATION) {
@@ -404,14 +611,30 @@ public:
                 // If this was the last frame in the message set the ready flag.
                 // Otherwise, reset processor state to read additional frames.
                 if (frame::get_fin(m_basic_header)) {
-                    // ensure that text messages end on a valid UTF8 code point
-                    if (frame::get_opcode(m_basic_header) == frame::opcode::TEXT) {
-                        if (!m_current_msg->validator.complete()) {
+                    if (m_current_msg == &m_data_msg
+                        && m_data_msg_compressed)
+                    {
+                        // message end: let the extension restore the
+                        // removed deflate tail (RFC 7692 7.2.2); zero
+                        // output bytes, but the inflate stream must end
+                        // on a block boundary or context takeover
+                        // misreads the next message
+                        lib::error_code dec = m_permessage_deflate
+                            .finish_decompress(m_payload_sink
+                                ? m_sink_scratch
+                                : m_data_msg.msg_ptr->get_raw_payload());
+                        if (dec) {
                             ec = make_error_code(error::invalid_utf8);
                             break;
                         }
                     }
 
+                    // ensure that text messages end on a valid UTF8 code point
+                    if (!text_message_complete()) {
+                        ec = make_error_code(error::invalid_utf8);
+                        break;
+                    }
+
                     m_state = READY;
                 } else {
                     this->reset_headers();
@@ -512,52 +735,75 @@ public:
         std::string& i = in->get_raw_payload();
         std::string& o = out->get_raw_payload();
         
-        // validate payload utf8
-        if (op == frame::opcode::TEXT && !utf8_validator::validate(i)) {
-            return make_error_code(error::invalid_payload);
+        // validate payload utf8 (trusted links skip outbound validation
+        // symmetrically with inbound). A non-fin first fragment is a
+        // partial message and may legally end mid code point, so it is
+        // held to prefix validity only.
+        if (m_validation != validation_policy::trusted_skip
+            && op == frame::opcode::TEXT)
+        {
+            bool valid = (in->get_fin()
+                ? utf8_validator::validate(i)
+                : utf8_validator::validate_prefix(i));
+            if (!valid) {
+                return make_error_code(error::invalid_payload);
+            }
         }
         
         frame::masking_key_type key;
         bool masked = !base::m_server;
         bool compressed = m_permessage_deflate.is_enabled() 
-                          && in->get_compressed();
+                          && in->get_compressed()
+                          && m_permessage_deflate.should_compress(i);
         bool fin = in->get_fin();
-        
-        // generate header
-        frame::basic_header h(op,i.size(),fin,masked,compressed);
-        
+
         if (masked) {
             // Generate masking key.
             key.i = m_rng();
-            
-            frame::extended_header e(i.size(),key.i);
-            out->set_header(frame::prepare_header(h,e));
-        } else {
-            frame::extended_header e(i.size());
-            out->set_header(frame::prepare_header(h,e));
         }
-                
-        // prepare payload
+
+        // prepare the payload first; compression changes its length and the
+        // header must describe the bytes actually sent
+        size_t payload_size;
         if (compressed) {
             // compress and store in o after header.
-            m_permessage_deflate.compress(i,o);
+            lib::error_code cec = m_permessage_deflate.compress(i,o);
+            if (cec) {
+                return cec;
+            }
 
             // mask in place if necessary
             if (masked) {
                 this->masked_copy(o,o,key);
             }
+            payload_size = o.size();
         } else {
-            // no compression, just copy data into the output buffer
-            o.resize(i.size());
-            
+            // no compression
             // if we are masked, have the masking function write to the output
-            // buffer directly to avoid another copy. If not masked, copy
-            // directly without masking.
+            // buffer directly to avoid another copy. If not masked, the
+            // payload needs no transformation at all, so reference the input
+            // message's payload rather than copying it. The transport's
+            // gather write sends the original bytes in place.
             if (masked) {
+                o.resize(i.size());
                 this->masked_copy(i,o,key);
-            } else {
-                std::copy(i.begin(),i.end(),o.begin());
+            } else if (in != out) {
+                // in == out would make the message reference itself and
+                // leak; in that case the payload is already in place.
+                out->set_shared_payload(in);
             }
+            payload_size = i.size();
+        }
+
+        // generate header
+        frame::basic_header h(op,payload_size,fin,masked,compressed);
+
+        if (masked) {
+            frame::extended_header e(payload_size,key.i);
+            out->set_header(frame::prepare_header(h,e));
+        } else {
+            frame::extended_header e(payload_size);
+            out->set_header(frame::prepare_header(h,e));
         }
 
         out->set_prepared(true);
@@ -612,29 +858,10 @@ public:
 protected:
     /// Convert a client handshake key into a server response key in place
     lib::error_code process_handshake_key(std::string & key) const {
-        key.append(constants::handshake_guid);
-                
-        sha1 sha;
-        uint32_t message_digest[5];
-        
-        sha << key.c_str();
-                
-        if (sha.get_raw_digest(message_digest)){
-            // convert sha1 hash bytes to network byte order because this sha1
-            //  library works on ints rather than bytes
-            for (int i = 0; i < 5; i++) {
-                message_digest[i] = htonl(message_digest[i]);
-            }
-            
-            key = base64_encode(
-                reinterpret_cast<unsigned char const *>(message_digest),
-                20
-            );
-            
-            return lib::error_code();
-        } else {
-            return error::make_error_code(error::sha1_library);
-        }
+        // fused hash + encode: no intermediate string allocations and
+        // hardware SHA1 when the processor supports it
+        make_accept_key(key,key);
+        return lib::error_code();
     }
     
     /// Reads bytes from buf into m_basic_header
@@ -669,6 +896,98 @@ protected:
         }
     }
 
+    /// Complete header processing once basic+extended bytes are in hand
+    /**
+     * Shared tail of the one-shot and incremental header paths:
+     * validates the extended header, transitions to payload consumption,
+     * and sets up the message the frame belongs to.
+     */
+    lib::error_code finish_header() {
+        if (tracer::enabled) {
+            tracer::on_header_parsed(this,lib::steady_us());
+        }
+
+        // size-class pruning: with a compile time cap inside the basic
+        // or 16-bit class, larger length classes reject on the header
+        // byte and their length handling below is dead code
+        if (size_fits_basic
+            && frame::get_basic_size(m_basic_header) > 125)
+        {
+            return make_error_code(error::message_too_big);
+        }
+        if (size_fits_16bit
+            && frame::get_basic_size(m_basic_header)
+                == frame::payload_size_code_64bit)
+        {
+            return make_error_code(error::message_too_big);
+        }
+
+        lib::error_code ec = validate_incoming_extended_header(
+            m_basic_header,m_extended_header);
+        if (ec) {
+            return ec;
+        }
+
+        m_state = APPLICATION;
+        m_bytes_needed = static_cast<size_t>(
+            get_payload_size(m_basic_header,m_extended_header));
+
+        if (size_bounded) {
+            // the frame alone, or the reassembled message so far plus
+            // this frame, past the cap: refuse before buffering payload
+            size_t accumulated = m_data_msg.msg_ptr
+                ? m_data_msg.msg_ptr->get_payload().size() : 0;
+            if (m_bytes_needed > config::max_message_size
+                || (!frame::opcode::is_control(
+                        frame::get_opcode(m_basic_header))
+                    && accumulated
+                        > config::max_message_size-m_bytes_needed))
+            {
+                return make_error_code(error::message_too_big);
+            }
+        }
+
+        // check if this frame is the start of a new message and set up
+        // the appropriate message metadata.
+        frame::opcode::value op = frame::get_opcode(m_basic_header);
+
+        // permessage-deflate marks only a message's first frame with
+        // RSV1; remember it for the continuations
+        if (!frame::opcode::is_control(op)
+            && op != frame::opcode::CONTINUATION)
+        {
+            m_data_msg_compressed = m_permessage_deflate.is_enabled()
+                && frame::get_rsv1(m_basic_header);
+        }
+
+        if (frame::opcode::is_control(op)) {
+            m_control_msg = msg_metadata(
+                m_msg_manager->get_message(op,m_bytes_needed),
+                frame::get_masking_key(m_basic_header,m_extended_header)
+            );
+
+            m_current_msg = &m_control_msg;
+        } else {
+            if (!m_data_msg.msg_ptr) {
+                m_data_msg = msg_metadata(
+                    m_msg_manager->get_message(op,m_bytes_needed),
+                    frame::get_masking_key(m_basic_header,m_extended_header)
+                );
+            } else {
+                // Each frame starts a new masking key. All other state
+                // remains between frames.
+                m_data_msg.prepared_key = prepare_masking_key(
+                    frame::get_masking_key(
+                        m_basic_header,
+                        m_extended_header
+                    )
+                );
+            }
+            m_current_msg = &m_data_msg;
+        }
+        return lib::error_code();
+    }
+
     /// Reads bytes from buf into m_extended_header
     size_t copy_extended_header_bytes(uint8_t const * buf, size_t len) {
         size_t bytes_to_read = std::min(m_bytes_needed,len);
@@ -695,8 +1014,103 @@ protected:
      */
     size_t process_payload_bytes(uint8_t * buf, size_t len, lib::error_code& ec)
     {
+        bool const masked = frame::get_masked(m_basic_header);
+        // data messages carry their compressed bit on the first frame
+        // only (the continuations have RSV1 clear); control frames are
+        // never compressed
+        bool const compressed = !frame::opcode::is_control(
+                m_current_msg->msg_ptr->get_opcode())
+            && m_data_msg_compressed;
+        bool const sink_path = m_payload_sink
+            && !frame::opcode::is_control(m_current_msg->msg_ptr->get_opcode());
+
+        if (m_borrowed_payloads && !compressed && !sink_path
+            && !frame::opcode::is_control(
+                m_current_msg->msg_ptr->get_opcode())
+            && m_current_msg->msg_ptr->get_raw_payload().empty()
+            && !m_current_msg->msg_ptr->is_borrowed()
+            && len == m_bytes_needed
+            && frame::get_fin(m_basic_header))
+        {
+            // zero copy delivery: the whole message is one contiguous span
+            // of the read buffer. Unmask in place and hand the span to the
+            // message as a borrowed view; the connection revokes it when
+            // the handler returns.
+            if (masked) {
+                #ifdef WEBSOCKETPP_STRICT_MASKING
+                    m_current_msg->prepared_key = frame::byte_mask_circ(
+                        buf,len,m_current_msg->prepared_key);
+                #else
+                    m_current_msg->prepared_key = frame::simd_mask_circ(
+                        buf,len,m_current_msg->prepared_key);
+                #endif
+            }
+
+            if (m_validation != validation_policy::trusted_skip
+                && m_current_msg->msg_ptr->get_opcode()
+                    == frame::opcode::TEXT)
+            {
+                // the borrowed span is the whole message, so incremental
+                // and on-complete validation coincide here
+                if (!m_current_msg->validator.decode(buf,buf+len)) {
+                    ec = make_error_code(error::invalid_utf8);
+                    return 0;
+                }
+            }
+
+            m_current_msg->msg_ptr->set_payload_view(
+                reinterpret_cast<char const *>(buf),len);
+            m_bytes_needed -= len;
+            return len;
+        }
+
+        if (masked && !compressed && !sink_path) {
+            // fused fast path: XOR the mask while copying into the message
+            // payload in one logical pass. The unmask writes go through a
+            // cache resident scratch block (string::resize would zero fill
+            // the destination first, re-adding the pass this removes), so
+            // each payload byte is read from the wire buffer once and
+            // written to the payload buffer once.
+            std::string & out = m_current_msg->msg_ptr->get_raw_payload();
+            size_t offset = out.size();
+            out.reserve(offset+len);
+
+            uint8_t scratch[4096];
+            size_t done = 0;
+            while (done < len) {
+                size_t chunk = len-done;
+                if (chunk > sizeof(scratch)) {
+                    chunk = sizeof(scratch);
+                }
+            #ifdef WEBSOCKETPP_STRICT_MASKING
+                m_current_msg->prepared_key = frame::byte_mask_circ(
+                    buf+done,scratch,chunk,m_current_msg->prepared_key);
+            #else
+                m_current_msg->prepared_key = frame::simd_mask_circ(
+                    buf+done,scratch,chunk,m_current_msg->prepared_key);
+            #endif
+                out.append(reinterpret_cast<char *>(scratch),chunk);
+                done += chunk;
+            }
+
+            if (m_validation == validation_policy::strict
+                && m_current_msg->msg_ptr->get_opcode()
+                    == frame::opcode::TEXT)
+            {
+                if (!m_current_msg->validator.decode(out.data()+offset,
+                    out.data()+out.size()))
+                {
+                    ec = make_error_code(error::invalid_utf8);
+                    return 0;
+                }
+            }
+
+            m_bytes_needed -= len;
+            return len;
+        }
+
         // unmask if masked
-        if (frame::get_masked(m_basic_header)) {
+        if (masked) {
             #ifdef WEBSOCKETPP_STRICT_MASKING
                 m_current_msg->prepared_key = frame::byte_mask_circ(
                     buf,
@@ -704,7 +1118,7 @@ protected:
                     m_current_msg->prepared_key
                 );
             #else
-                m_current_msg->prepared_key = frame::word_mask_circ(
+                m_current_msg->prepared_key = frame::simd_mask_circ(
                     buf,
                     len,
                     m_current_msg->prepared_key
@@ -712,15 +1126,85 @@ protected:
             #endif
         }
         
+        // streaming delivery: hand data message spans to the sink instead
+        // of accumulating them in the message buffer
+        if (sink_path) {
+            uint8_t const * span;
+            size_t span_len;
+
+            bool is_text = m_current_msg->msg_ptr->get_opcode()
+                == frame::opcode::TEXT;
+            bool validate_span = is_text
+                && m_validation != validation_policy::trusted_skip;
+
+            if (compressed) {
+                m_sink_scratch.clear();
+                if (validate_span) {
+                    // fused: validation rides the inflate loop while the
+                    // chunks are hot, and bad text aborts inflation early
+                    lib::error_code dec = m_permessage_deflate
+                        .decompress_validated(buf,len,m_sink_scratch,
+                            m_current_msg->validator);
+                    if (dec) {
+                        // both bad text and a corrupt deflate stream land
+                        // here; the processor cannot name the extension's
+                        // error enum without committing to a concrete
+                        // extension type, and either way the payload is
+                        // undecodable
+                        ec = make_error_code(error::invalid_utf8);
+                        return 0;
+                    }
+                    validate_span = false;
+                } else {
+                    m_permessage_deflate.decompress(buf,len,m_sink_scratch);
+                }
+                span = reinterpret_cast<uint8_t const *>(
+                    m_sink_scratch.data());
+                span_len = m_sink_scratch.size();
+            } else {
+                span = buf;
+                span_len = len;
+            }
+
+            if (validate_span) {
+                // span delivery has no assembled buffer; on_complete
+                // validates per span like strict
+                if (!m_current_msg->validator.decode(span,span+span_len)) {
+                    ec = make_error_code(error::invalid_utf8);
+                    return 0;
+                }
+            }
+
+            m_payload_sink(m_current_msg->msg_ptr->get_opcode(),span,
+                span_len);
+
+            m_bytes_needed -= len;
+            return len;
+        }
+
         std::string & out = m_current_msg->msg_ptr->get_raw_payload();
         size_t offset = out.size();
 
+        bool strict_text = m_validation == validation_policy::strict
+            && m_current_msg->msg_ptr->get_opcode() == frame::opcode::TEXT;
+
         // decompress message if needed.
-        if (m_permessage_deflate.is_enabled() 
-            && frame::get_rsv1(m_basic_header))
-        {
-            // Decompress current buffer into the message buffer
-            m_permessage_deflate.decompress(buf,len,out);
+        if (compressed) {
+            if (strict_text) {
+                // fused: validation rides the inflate loop while chunks
+                // are hot in cache, and invalid text aborts inflation
+                lib::error_code dec = m_permessage_deflate
+                    .decompress_validated(buf,len,out,
+                        m_current_msg->validator);
+                if (dec) {
+                    ec = make_error_code(error::invalid_utf8);
+                    return 0;
+                }
+                strict_text = false;
+            } else {
+                // Decompress current buffer into the message buffer
+                m_permessage_deflate.decompress(buf,len,out);
+            }
             
             // get the length of the newly uncompressed output
             offset = out.size() - offset;
@@ -730,8 +1214,10 @@ protected:
         }
 
         // validate unmasked, decompressed values
-        if (m_current_msg->msg_ptr->get_opcode() == frame::opcode::TEXT) {
-            if (!m_current_msg->validator.decode(out.begin()+offset,out.end())) {
+        if (strict_text) {
+            if (!m_current_msg->validator.decode(out.data()+offset,
+                out.data()+out.size()))
+            {
                 ec = make_error_code(error::invalid_utf8);
                 return 0;
             }
@@ -966,6 +1452,13 @@ protected:
     
     // Pointer to a manager that can create message buffers for us.
     msg_manager_ptr m_msg_manager;
+    typename base::payload_sink m_payload_sink;
+    std::string m_sink_scratch;
+    bool m_direct_active;
+    /// Whether to deliver single span messages as borrowed views
+    bool m_borrowed_payloads;
+    /// Text payload validation policy; see processor::validation_policy
+    validation_policy::value m_validation;
 
     // Number of bytes needed to complete the current operation
     size_t m_bytes_needed;
@@ -997,6 +1490,8 @@ protected:
 
     // Extensions
     permessage_deflate_type m_permessage_deflate;
+    /// Whether the in-progress data message negotiated compression
+    bool m_data_msg_compressed;
 };
 
 } // namespace processor
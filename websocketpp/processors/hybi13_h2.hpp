@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_PROCESSOR_HYBI13_H2_HPP
+#define WEBSOCKETPP_PROCESSOR_HYBI13_H2_HPP
+
+#include <websocketpp/processors/hybi13.hpp>
+
+namespace websocketpp {
+namespace processor {
+
+/// Processor for WebSocket over HTTP/2 extended CONNECT (RFC 8441)
+/**
+ * RFC 8441 replaces the GET/Upgrade handshake with an HTTP/2 extended
+ * CONNECT request carrying :protocol = websocket; the Key/Accept exchange
+ * disappears (stream establishment provides the equivalent guarantee) and
+ * a successful handshake is a plain 200 on the stream. Everything after
+ * the handshake is ordinary RFC 6455 framing, including client masking,
+ * so this processor is hybi13 with the handshake methods swapped out.
+ *
+ * This library does not contain an HTTP/2 framing layer (HPACK, stream
+ * multiplexing, flow control); the intended deployment embeds each
+ * CONNECT stream as one core-config connection whose bytes the h2 layer
+ * shuttles via the iostream transport's write callbacks and
+ * connection::read_external, and whose handshake it presents here with
+ * the pseudo headers mapped to the ":method"/":protocol"/":path"/
+ * ":authority" header names used below.
+ */
+template <typename config>
+class hybi13_h2 : public hybi13<config> {
+public:
+    typedef typename config::request_type request_type;
+    typedef typename config::response_type response_type;
+    typedef typename config::message_type::ptr message_ptr;
+    typedef typename config::con_msg_manager_type::ptr msg_manager_ptr;
+    typedef typename config::rng_type rng_type;
+
+    explicit hybi13_h2(bool secure, bool p_is_server, msg_manager_ptr manager,
+        rng_type& rng)
+      : hybi13<config>(secure,p_is_server,manager,rng) {}
+
+    /// Validate an RFC 8441 extended CONNECT handshake
+    lib::error_code validate_handshake(request_type const & r) const {
+        if (r.get_header(":method") != "CONNECT"
+            && r.get_method() != "CONNECT")
+        {
+            return make_error_code(error::invalid_http_method);
+        }
+
+        if (r.get_header(":protocol") != "websocket") {
+            return make_error_code(error::missing_required_header);
+        }
+
+        // :authority stands in for Host and is required by RFC 8441
+        if (r.get_header(":authority").empty()
+            && r.get_header("Host").empty())
+        {
+            return make_error_code(error::missing_required_header);
+        }
+
+        // no Sec-WebSocket-Key on h2; stream establishment replaces it
+
+        return lib::error_code();
+    }
+
+    /// Build the server's response to an extended CONNECT handshake
+    /**
+     * Success on h2 is a plain 200; there is no Accept key and no
+     * Upgrade/Connection headers (they are connection specific and
+     * forbidden in HTTP/2 messages).
+     */
+    lib::error_code process_handshake(request_type const & request,
+        std::string const & subprotocol, response_type & response) const
+    {
+        (void)request;
+
+        response.set_status(http::status_code::ok);
+
+        if (!subprotocol.empty()) {
+            response.replace_header("Sec-WebSocket-Protocol",subprotocol);
+        }
+
+        return lib::error_code();
+    }
+
+    /// Fill in an extended CONNECT request for the client side
+    lib::error_code client_handshake_request(request_type & req, uri_ptr uri,
+        std::vector<std::string> const & subprotocols) const
+    {
+        req.set_method("CONNECT");
+        req.set_uri(uri->get_resource());
+        req.set_version("HTTP/1.1"); // serialized by the h2 layer as HEADERS
+
+        req.replace_header(":method","CONNECT");
+        req.replace_header(":protocol","websocket");
+        req.replace_header(":path",uri->get_resource());
+        req.replace_header(":authority",uri->get_host_port());
+        req.replace_header("Sec-WebSocket-Version","13");
+
+        if (!subprotocols.empty()) {
+            std::ostringstream result;
+            std::vector<std::string>::const_iterator it =
+                subprotocols.begin();
+            result << *it++;
+            while (it != subprotocols.end()) {
+                result << ", " << *it++;
+            }
+            req.replace_header("Sec-WebSocket-Protocol",result.str());
+        }
+
+        return lib::error_code();
+    }
+
+    /// Validate the server's response to an extended CONNECT handshake
+    lib::error_code validate_server_handshake_response(
+        request_type const & req, response_type & res) const
+    {
+        (void)req;
+
+        // success on a CONNECT stream is 2xx; anything else refused the
+        // protocol
+        if (res.get_status_code() < 200 || res.get_status_code() >= 300) {
+            return error::make_error_code(error::invalid_http_status);
+        }
+
+        return lib::error_code();
+    }
+};
+
+} // namespace processor
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_PROCESSOR_HYBI13_H2_HPP
@@ -28,10 +28,14 @@
 #ifndef WEBSOCKETPP_PROCESSOR_HPP
 #define WEBSOCKETPP_PROCESSOR_HPP
 
+#include <websocketpp/extensions/permessage_deflate/controller.hpp>
 #include <websocketpp/processors/base.hpp>
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
 #include <websocketpp/common/system_error.hpp>
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/frame.hpp>
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/uri.hpp>
 
@@ -64,20 +68,24 @@ namespace processor {
  */ 
 template <typename request_type>
 bool is_websocket_handshake(request_type& r) {
-    using utility::ci_find_substr;
-    
-    std::string const & upgrade_header = r.get_header("Upgrade");
-    
-    if (ci_find_substr(upgrade_header, constants::upgrade_token,
-        sizeof(constants::upgrade_token)-1) == upgrade_header.end())
+    // zero copy header access; with arena parsing these checks perform no
+    // allocations
+    utility::string_ref upgrade_header = r.get_header_ref(
+        utility::string_ref("Upgrade",7));
+
+    if (!utility::ci_contains(upgrade_header,
+        utility::string_ref(constants::upgrade_token,
+            sizeof(constants::upgrade_token)-1)))
     {
         return false;
     }
-    
-    std::string const & con_header = r.get_header("Connection");
-    
-    if (ci_find_substr(con_header, constants::connection_token,
-        sizeof(constants::connection_token)-1) == con_header.end())
+
+    utility::string_ref con_header = r.get_header_ref(
+        utility::string_ref("Connection",10));
+
+    if (!utility::ci_contains(con_header,
+        utility::string_ref(constants::connection_token,
+            sizeof(constants::connection_token)-1)))
     {
         return false;
     }
@@ -103,17 +111,33 @@ bool is_websocket_handshake(request_type& r) {
  */
 template <typename request_type>
 int get_websocket_version(request_type& r) {
-    if (r.get_header("Sec-WebSocket-Version") == "") {
+    utility::string_ref v = r.get_header_ref(
+        utility::string_ref("Sec-WebSocket-Version",21));
+    if (v.empty()) {
         return 0;
     }
-    
-    int version;
-    std::istringstream ss(r.get_header("Sec-WebSocket-Version"));
-                
-    if ((ss >> version).fail()) {
+
+    // parse a small non negative integer without stream machinery
+    int version = 0;
+    size_t digits = 0;
+    size_t i = 0;
+    while (i < v.len && (v.data[i] == ' ' || v.data[i] == '\t')) { i++; }
+    for (; i < v.len; i++) {
+        char c = v.data[i];
+        if (c < '0' || c > '9') {
+            break;
+        }
+        if (version > 1000) {
+            return -1;
+        }
+        version = version*10 + (c-'0');
+        digits++;
+    }
+    if (digits == 0) {
+        // non numeric version header; extraction error
         return -1;
     }
-    
+
     return version;
 }
 
@@ -150,9 +174,108 @@ uri_ptr get_uri_from_host(request_type & request, std::string scheme) {
 }
 
 /// WebSocket protocol processor abstract base class
+template <typename config>
+class processor;
+
+/// Compile time processor selection policy
+/**
+ * By default (primary template) connections dispatch to their protocol
+ * processor through the processor<config> virtual interface, selecting the
+ * implementation at runtime from the negotiated protocol version.
+ *
+ * A config may instead fix the processor implementation at compile time by
+ * defining a fixed_processor_type typedef, e.g.:
+ *
+ * \code
+ * struct my_config : public websocketpp::config::asio {
+ *     typedef websocketpp::processor::hybi13<my_config>
+ *         fixed_processor_type;
+ * };
+ * \endcode
+ *
+ * With a fixed processor the connection's consume path calls the
+ * implementation directly (qualified, bypassing virtual dispatch) so the
+ * frame parser can inline, and handshakes for any other protocol version
+ * are rejected. The fixed type must be one of the hybi07/hybi08/hybi13
+ * family (hybi00 has a different constructor signature).
+ */
+template <typename config, typename Enable = void>
+struct selector {
+    /// Whether the processor type is fixed at compile time
+    static bool const fixed = false;
+    /// The type the connection's consume path dispatches to
+    typedef processor<config> type;
+};
+
+/// Specialization used when the config defines fixed_processor_type
+template <typename config>
+struct selector<config,typename detail::type_sink<
+    typename config::fixed_processor_type>::type>
+{
+    static bool const fixed = true;
+    typedef typename config::fixed_processor_type type;
+};
+
+/// Text payload validation policies
+/**
+ * How much UTF-8 validation inbound text payloads (and close reasons)
+ * receive. strict is the RFC 6455 default. on_complete validates whole
+ * assembled messages once instead of incrementally per span, trading a
+ * small amount of per-chunk work for validating only at message
+ * boundaries; span-delivered paths (chunk handlers, streaming sinks)
+ * still validate per span since no assembled buffer exists.
+ * trusted_skip performs no UTF-8 validation at all: only for closed
+ * systems where both peers are trusted and payloads are re-validated by
+ * the application, since it forgoes an RFC requirement.
+ */
+namespace validation_policy {
+    enum value {
+        strict = 0,
+        on_complete,
+        trusted_skip
+    };
+} // namespace validation_policy
+
+/// Whether a config keeps the pre-RFC6455 processors available
+/**
+ * Reads the config's optional `static bool const enable_legacy_versions`;
+ * absent (every existing config) means true. A config that sets it false
+ * never instantiates hybi00/07/08, shrinking the binary and dropping the
+ * version switch to a single branch. Defining
+ * WEBSOCKETPP_NO_LEGACY_PROCESSORS additionally skips the legacy
+ * processor headers (and hybi00's MD5 dependency) entirely and forces
+ * this trait false for every config.
+ */
+template <typename config, typename Enable = void>
+struct legacy_versions {
+#ifdef WEBSOCKETPP_NO_LEGACY_PROCESSORS
+    static bool const value = false;
+#else
+    static bool const value = true;
+#endif
+};
+
+#ifndef WEBSOCKETPP_NO_LEGACY_PROCESSORS
+template <typename config>
+struct legacy_versions<config,typename detail::type_sink<
+    int[sizeof(config::enable_legacy_versions)]>::type>
+{
+    static bool const value = config::enable_legacy_versions;
+};
+#endif
+
 template <typename config>
 class processor {
 public:
+    /// Signature of a streaming payload sink
+    /**
+     * Receives unmasked, decompressed payload spans of the current data
+     * message as they are processed, tagged with the message's opcode. See
+     * connection::set_message_chunk_handler.
+     */
+    typedef lib::function<void(frame::opcode::value, uint8_t const *,
+        size_t)> payload_sink;
+
     typedef processor<config> type;
     typedef typename config::request_type request_type;
     typedef typename config::response_type response_type;
@@ -168,6 +291,106 @@ public:
     /// Get the protocol version of this processor
     virtual int get_version() const = 0;
 
+    /// Install a streaming payload sink (optional)
+    /**
+     * Processors that support streaming delivery forward data message
+     * payload spans to the sink instead of accumulating them in the
+     * message buffer. The default implementation ignores the sink and
+     * retains the accumulating behavior.
+     */
+    virtual void set_payload_sink(payload_sink) {}
+
+    /// Serialize a handshake response into a caller provided buffer
+    /**
+     * Appends the processor's wire form of the response to out. The
+     * default delegates to get_raw; processors without special framing
+     * override with a single pass append (see hybi13).
+     */
+    virtual void append_raw(response_type const & res,
+        std::string & out) const
+    {
+        out.append(get_raw(res));
+    }
+
+
+    /// Select how inbound text payloads are UTF-8 validated
+    /**
+     * See validation_policy. Ignored by processors without support.
+     */
+    virtual void set_validation_policy(validation_policy::value) {}
+
+    /// Prime the compression extension with a shared dictionary
+    /**
+     * Forwarded to permessage-deflate where negotiated; ignored by
+     * processors without compression support. See
+     * permessage_deflate::enabled::set_dictionary.
+     */
+    virtual void set_compression_dictionary(std::string const &) {}
+
+    /// Bound write-side compression history under context takeover
+    /**
+     * Forwarded to the permessage-deflate extension; see
+     * permessage_deflate::enabled::set_write_reset_interval. No-op for
+     * processors without compression.
+     */
+    virtual void set_compression_write_reset(size_t, size_t) {}
+
+    /// Attach the endpoint's adaptive compression level controller
+    /**
+     * Forwarded to the permessage-deflate extension; see
+     * permessage_deflate::level_controller. No-op for processors
+     * without compression.
+     */
+    virtual void set_compression_level_controller(
+        extensions::permessage_deflate::level_controller::ptr) {}
+
+    /// Generate a fresh client handshake key, or empty when the
+    /// protocol version has no single-header key (pre-RFC drafts)
+    /**
+     * Used by the client request template fast path; an empty return
+     * disables the template for this processor.
+     */
+    virtual std::string generate_client_key() const {
+        return std::string();
+    }
+
+    /// Enable borrowed (zero copy) payload delivery
+    /**
+     * When supported by the processor, complete single span data
+     * messages are delivered with their payload as a view over the read
+     * buffer instead of a copy; see connection::set_borrowed_messages.
+     * Ignored by processors without the capability.
+     */
+    virtual void set_borrowed_payloads(bool) {}
+
+    /// Expose storage for reading payload bytes directly (optional)
+    /**
+     * Two-phase read support: when the processor is mid payload on a
+     * suitable frame it may expose the message buffer's own storage so the
+     * transport can read into it, eliminating the copy from the scratch
+     * read buffer. Bytes landed this way are reported via
+     * consume_in_place. The default implementation offers no target.
+     *
+     * @param [out] target Start of writable payload storage
+     * @param [out] max_len Maximum number of bytes to read into it
+     * @return Whether a target is available
+     */
+    virtual bool get_payload_read_target(uint8_t **, size_t *) {
+        return false;
+    }
+
+    /// Account for bytes read directly into the payload target (optional)
+    /**
+     * Performs in place unmasking and validation of len bytes previously
+     * read into the pointer returned by get_payload_read_target and
+     * advances the frame state machine.
+     */
+    virtual size_t consume_in_place(size_t, lib::error_code & ec) {
+        ec = make_error_code(error::general);
+        return 0;
+    }
+
+
     /// Returns whether or not the permessage_compress extension is implemented
     /**
      * Compile time flag that indicates whether this processor has implemented
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_RANDOM_BUFFERED_HPP
+#define WEBSOCKETPP_RANDOM_BUFFERED_HPP
+
+#include <websocketpp/common/random.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+namespace websocketpp {
+namespace random {
+/// RNG policy that amortizes system entropy reads over a buffer
+namespace buffered {
+
+/// Thread safe buffered non-deterministic random integer generator.
+/**
+ * Drop in replacement for random_device::int_generator for configs whose
+ * send rate makes one system RNG read per masking key measurable: entropy
+ * is pulled a block at a time (one read of /dev/urandom per 4KB on POSIX,
+ * about a thousand masking keys) and values are served from the buffer.
+ * On platforms without /dev/urandom the refill falls back to the lib
+ * random_device a word at a time, which keeps correctness and thread
+ * safety but not the amortization.
+ *
+ * Select it in a config with:
+ *
+ * \code
+ * typedef websocketpp::random::buffered::int_generator<
+ *     uint32_t, concurrency_type> rng_type;
+ * \endcode
+ *
+ * Thread-safety is provided via locking based on the concurrency template
+ * parameter, matching random_device::int_generator.
+ */
+template <typename int_type, typename concurrency>
+class int_generator {
+    public:
+        typedef typename concurrency::scoped_lock_type scoped_lock_type;
+        typedef typename concurrency::mutex_type mutex_type;
+
+        int_generator() : m_urandom(NULL), m_pos(sizeof(m_buffer)) {
+#ifndef _WIN32
+            m_urandom = std::fopen("/dev/urandom","rb");
+            if (m_urandom) {
+                // unbuffered: the block read below is the buffer
+                std::setvbuf(m_urandom,NULL,_IONBF,0);
+            }
+#endif
+        }
+
+        ~int_generator() {
+            if (m_urandom) {
+                std::fclose(m_urandom);
+            }
+        }
+
+        /// returns the next buffered value, refilling as needed
+        int_type operator()() {
+            scoped_lock_type guard(m_lock);
+            if (m_pos + sizeof(int_type) > sizeof(m_buffer)) {
+                refill();
+            }
+            int_type value;
+            std::memcpy(&value,m_buffer+m_pos,sizeof(value));
+            m_pos += sizeof(value);
+            return value;
+        }
+    private:
+        // non-copyable (owns a FILE handle)
+        int_generator(int_generator const &);
+        int_generator & operator=(int_generator const &);
+
+        /// Refill the buffer with one bulk entropy read
+        void refill() {
+            if (m_urandom && std::fread(m_buffer,1,sizeof(m_buffer),
+                m_urandom) == sizeof(m_buffer))
+            {
+                m_pos = 0;
+                return;
+            }
+            // no urandom (or a short read): fall back to the system RNG a
+            // word at a time; uniform words make uniform bytes
+            for (size_t i = 0; i < sizeof(m_buffer);
+                 i += sizeof(unsigned int))
+            {
+                unsigned int word = static_cast<unsigned int>(m_rng());
+                std::memcpy(m_buffer+i,&word,sizeof(word));
+            }
+            m_pos = 0;
+        }
+
+        lib::random_device m_rng;
+        std::FILE * m_urandom;
+        unsigned char m_buffer[4096];
+        size_t m_pos;
+
+        mutex_type m_lock;
+};
+
+} // namespace buffered
+} // namespace random
+} // namespace websocketpp
+
+#endif //WEBSOCKETPP_RANDOM_BUFFERED_HPP
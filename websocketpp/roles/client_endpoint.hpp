@@ -29,6 +29,10 @@
 #define WEBSOCKETPP_CLIENT_ENDPOINT_HPP
 
 #include <websocketpp/endpoint.hpp>
+
+#include <list>
+#include <map>
+#include <string>
 #include <websocketpp/logger/levels.hpp>
 
 #include <iostream>
@@ -69,6 +73,78 @@ public:
         endpoint_type::m_alog.write(log::alevel::devel,
             "client constructor");
     }
+
+    /// Maintain warm standby connections to a URI
+    /**
+     * The client keeps target open connections to the URI on standby,
+     * establishing them in the background (DNS, TCP, TLS, and the
+     * WebSocket handshake all paid ahead of need) and re-establishing
+     * replacements as standbys are checked out or die -- failed
+     * attempts retry on a timer so an unreachable partner does not spin.
+     * Standbys participate in the endpoint keepalive scheduler like any
+     * connection, so dead ones are detected and replaced. Check one out
+     * with get_warm_connection; failover then costs a queue pop instead
+     * of a full reconnect.
+     *
+     * Standby connections run with no-op handlers until checkout; a
+     * target of zero stops replenishment (existing standbys drain as
+     * they are used or die).
+     *
+     * @param u The URI to keep warm
+     * @param target Number of standby connections to maintain
+     */
+    void set_warm_pool(std::string const & u, size_t target) {
+        {
+            scoped_lock_type guard(m_warm_lock);
+            m_warm[u].target = target;
+        }
+        replenish_warm(u);
+    }
+
+    /// Check out an open standby connection for a URI
+    /**
+     * Returns an already-open connection with the endpoint's current
+     * default handlers installed -- the open event happened at standby
+     * establishment, so no open handler fires on checkout; the caller
+     * proceeds straight to sending. Returns an empty pointer (ec set)
+     * when no standby is ready, in which case the caller falls back to
+     * the ordinary connect path. Checkout triggers background
+     * replenishment.
+     *
+     * @param u The URI previously registered with set_warm_pool
+     * @param [out] ec Set when no standby is available
+     * @return An open connection, or an empty pointer
+     */
+    connection_ptr get_warm_connection(std::string const & u,
+        lib::error_code & ec)
+    {
+        connection_ptr con;
+        {
+            scoped_lock_type guard(m_warm_lock);
+            typename warm_map::iterator it = m_warm.find(u);
+            if (it == m_warm.end() || it->second.ready.empty()) {
+                ec = error::make_error_code(error::con_creation_failed);
+                return connection_ptr();
+            }
+            con = it->second.ready.front();
+            it->second.ready.pop_front();
+        }
+
+        // hand the connection back with the application's current
+        // default handlers in place of the standby no-ops
+        con->set_handler_table(endpoint_type::current_handler_table());
+
+        ec = lib::error_code();
+        replenish_warm(u);
+        return con;
+    }
+
+    /// Number of open standbys currently ready for a URI
+    size_t warm_connections_ready(std::string const & u) const {
+        scoped_lock_type guard(m_warm_lock);
+        typename warm_map::const_iterator it = m_warm.find(u);
+        return (it == m_warm.end() ? 0 : it->second.ready.size());
+    }
     
     /// Get a new connection
     /**
@@ -150,6 +226,103 @@ public:
     // connect(...)
 private:
     // handle_connect
+    /// Start standby establishment until ready+pending reaches target
+    void replenish_warm(std::string const & u) {
+        for (;;) {
+            {
+                scoped_lock_type guard(m_warm_lock);
+                typename warm_map::iterator it = m_warm.find(u);
+                if (it == m_warm.end()
+                    || it->second.ready.size()+it->second.pending
+                        >= it->second.target)
+                {
+                    return;
+                }
+                it->second.pending++;
+            }
+
+            lib::error_code ec;
+            connection_ptr con = get_connection(u,ec);
+            if (ec) {
+                // undo the reservation; the retry timer will try again
+                {
+                    scoped_lock_type guard(m_warm_lock);
+                    typename warm_map::iterator it = m_warm.find(u);
+                    if (it != m_warm.end() && it->second.pending > 0) {
+                        it->second.pending--;
+                    }
+                }
+                warm_attempt_failed(u);
+                return;
+            }
+
+            // standby handlers: park on success, schedule a retry on
+            // failure; the real handlers are installed at checkout
+            con->set_open_handler(lib::bind(
+                &type::warm_opened,this,u,lib::placeholders::_1));
+            con->set_fail_handler(lib::bind(
+                &type::warm_lost,this,u,true,lib::placeholders::_1));
+            con->set_close_handler(lib::bind(
+                &type::warm_lost,this,u,false,lib::placeholders::_1));
+            con->set_message_handler(
+                typename connection_type::message_handler());
+
+            connect(con);
+        }
+    }
+
+    void warm_opened(std::string u, connection_hdl hdl) {
+        lib::error_code ec;
+        connection_ptr con = endpoint_type::get_con_from_hdl(hdl,ec);
+        if (ec) {
+            warm_attempt_failed(u);
+            return;
+        }
+        scoped_lock_type guard(m_warm_lock);
+        typename warm_map::iterator it = m_warm.find(u);
+        if (it == m_warm.end()) {
+            return;
+        }
+        it->second.pending--;
+        it->second.ready.push_back(con);
+    }
+
+    /// A standby failed to establish or died while parked
+    void warm_lost(std::string u, bool was_pending, connection_hdl hdl) {
+        {
+            scoped_lock_type guard(m_warm_lock);
+            typename warm_map::iterator it = m_warm.find(u);
+            if (it == m_warm.end()) {
+                return;
+            }
+            if (was_pending) {
+                it->second.pending--;
+            } else {
+                // remove from ready if it died while parked
+                lib::error_code ec;
+                connection_ptr con =
+                    endpoint_type::get_con_from_hdl(hdl,ec);
+                if (!ec) {
+                    it->second.ready.remove(con);
+                }
+            }
+        }
+        warm_attempt_failed(u);
+    }
+
+    /// Schedule a delayed replenish so a dead partner is not hammered
+    void warm_attempt_failed(std::string const & u) {
+        transport_type::set_timer(warm_retry_ms,lib::bind(
+            &type::warm_retry,this,u,lib::placeholders::_1));
+    }
+
+    void warm_retry(std::string u, lib::error_code const & ec) {
+        if (ec) {
+            return;
+        }
+        replenish_warm(u);
+    }
+
     void handle_connect(connection_hdl hdl, const lib::error_code & ec) {
         lib::error_code hdl_ec;
         connection_ptr con = endpoint_type::get_con_from_hdl(hdl,hdl_ec);
@@ -177,6 +350,22 @@ private:
             con->start();
         }
     }
+    /// Warm standby pool bookkeeping
+    static long const warm_retry_ms = 1000;
+
+    struct warm_pool {
+        warm_pool() : target(0), pending(0) {}
+        size_t target;
+        size_t pending;
+        std::list<connection_ptr> ready;
+    };
+    typedef std::map<std::string,warm_pool> warm_map;
+
+    typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
+
+    mutable typename concurrency_type::mutex_type m_warm_lock;
+    warm_map m_warm;
+
 };
 
 } // namespace websocketpp
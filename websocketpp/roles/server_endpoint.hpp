@@ -67,11 +67,35 @@ public:
     
     // TODO: clean up these types
 
-    explicit server() : endpoint_type(true)
+    explicit server()
+      : endpoint_type(true)
+      , m_accept_depth(1)
     {
         endpoint_type::m_alog.write(log::alevel::devel,
             "server constructor");
     }
+
+    /// Set how many accepts are kept outstanding on the listener
+    /**
+     * With the default depth of 1 a new accept is armed only after the
+     * previous one completes, which caps the accept rate during reconnect
+     * storms. A larger depth keeps that many accepts outstanding at once
+     * (each completion immediately re-arms itself before the accepted
+     * connection is started), letting the kernel's listen backlog drain at
+     * accept speed rather than connection setup speed.
+     *
+     * Must be set before start_accept. Sharded endpoints
+     * (init_asio_shards) need a depth of at least the shard count so that
+     * every SO_REUSEPORT listener gets an accept chain.
+     *
+     * @param depth Number of concurrent outstanding accepts (minimum 1)
+     */
+    void set_accept_depth(size_t depth) {
+        if (depth < 1) {
+            depth = 1;
+        }
+        m_accept_depth = depth;
+    }
     
     // return an initialized connection_ptr. Call start() on this object to 
     // begin the processing loop.
@@ -82,21 +106,22 @@ public:
     }
     
     // Starts the server's async connection acceptance loop.
+    /**
+     * Arms accept_depth (default 1) outstanding accepts; each one re-arms
+     * itself on completion, so this is called once.
+     */
     void start_accept() {
-        connection_ptr con = get_connection();
-        
-        transport_type::async_accept(
-            lib::static_pointer_cast<transport_con_type>(con),
-            lib::bind(
-                &type::handle_accept,
-                this,
-                lib::placeholders::_1,
-                lib::placeholders::_2
-            )
-        );
+        for (size_t i = 0; i < m_accept_depth; i++) {
+            start_accept_one();
+        }
     }
     
     void handle_accept(connection_hdl hdl, const lib::error_code& ec) {
+        // re-arm before touching the accepted connection so the listener
+        // is never idle while connection setup runs
+        // TODO: are there cases where we should terminate this loop?
+        start_accept_one();
+        
         lib::error_code hdl_ec;
         connection_ptr con = endpoint_type::get_con_from_hdl(hdl,hdl_ec);
         
@@ -118,15 +143,57 @@ public:
 
                 endpoint_type::m_elog.write(log::elevel::rerror,
                     "handle_accept error: "+ec.message());
+            } else if (endpoint_type::is_load_shedding()) {
+                // overload: canned 503 straight from accept, nothing
+                // read, no handshake machinery constructed
+                endpoint_type::m_alog.write(log::alevel::connect,
+                    "connection shed: endpoint load shedding active");
+                con->shed(endpoint_type::shed_response());
+            } else if (endpoint_type::handshake_limit_reached()) {
+                // embryonic-connection ceiling: shed before any
+                // handshake buffers are touched
+                endpoint_type::m_alog.write(log::alevel::connect,
+                    "connection rejected: endpoint handshake limit");
+                con->terminate(error::make_error_code(error::rejected));
+            } else if (endpoint_type::connection_limit_reached(
+                m_accept_depth+1)) {
+                // slack covers the armed accept chains plus this
+                // connection itself, which is registered but not yet live
+                // at the ceiling: shed before any handshake machinery
+                // runs; with pooling the object recycles immediately
+                endpoint_type::m_alog.write(log::alevel::connect,
+                    "connection rejected: endpoint connection limit");
+                con->terminate(error::make_error_code(error::rejected));
             } else {
+                con->set_handshake_gauge(
+                    endpoint_type::handshake_gauge());
                 con->start();
             }
         }
-        
-        // TODO: are there cases where we should terminate this loop?
-        start_accept();
     }
 private:
+    /// Arm a single self-perpetuating accept
+    void start_accept_one() {
+        // the listener may be gone (stop_listening / drain mode): the
+        // accept loop ends here instead of re-arming into a dead
+        // acceptor
+        if (!transport_type::is_listening()) {
+            return;
+        }
+        connection_ptr con = get_connection();
+        
+        transport_type::async_accept(
+            lib::static_pointer_cast<transport_con_type>(con),
+            lib::bind(
+                &type::handle_accept,
+                this,
+                lib::placeholders::_1,
+                lib::placeholders::_2
+            )
+        );
+    }
+    
+    size_t m_accept_depth;
 };
 
 } // namespace websocketpp
@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_SESSION_RESUME_HPP
+#define WEBSOCKETPP_SESSION_RESUME_HPP
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/random.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/common/time.hpp>
+#include <websocketpp/frame.hpp>
+
+#include <deque>
+#include <map>
+#include <string>
+
+namespace websocketpp {
+
+/// Server-side session resumption shim
+/**
+ * A reconnecting client's transport setup is cheap; the application's
+ * session rebuild (full re-subscription and state transfer) is what
+ * reconnect storms amplify. This shim keeps a bounded replay buffer of
+ * undelivered messages per logical session, so a resuming client
+ * receives the delta since its last acknowledgement instead of a full
+ * rebuild.
+ *
+ * Wire protocol (a subprotocol-style shim above the connection; all
+ * control lines are text messages, data flows as the application's own
+ * messages prefixed with a sequence number):
+ *
+ *   server -> client  "WSRS S <token>"       session established/resumed
+ *   client -> server  "WSRS R <token>"       resume request (first message)
+ *   client -> server  "WSRS A <seq>"         cumulative acknowledgement
+ *   server -> client  "WSRS M <seq> "+payload  sequenced data message
+ *   server -> client  "WSRS X"               resume failed: rebuild fully
+ *
+ * Integration: call open() from the open handler (it issues or resumes
+ * the session and replays the delta), route inbound text messages
+ * through handle_message() (returns true when consumed as shim
+ * control), send application data with send(), and notify detach from
+ * the close handler. Buffers are byte-capped per session; overflow
+ * marks the session broken so the next resume answers "WSRS X" and the
+ * application falls back to a full rebuild. Expired sessions (TTL
+ * since detach) are reaped lazily and by sweep(). Tokens are random
+ * bearer credentials, and a resume naming a session that is still
+ * attached to a connection is refused with "WSRS X" -- only a
+ * detached session can be claimed.
+ *
+ * Thread safety: all members are mutex guarded; handlers of the owning
+ * endpoint may call from any io thread.
+ */
+template <typename endpoint_type>
+class resumable_sessions {
+public:
+    typedef typename endpoint_type::message_ptr message_ptr;
+
+    explicit resumable_sessions(endpoint_type & endpoint)
+      : m_endpoint(endpoint)
+      , m_replay_limit(262144)
+      , m_session_ttl_ms(60000) {}
+
+    /// Per-session replay buffer cap in bytes (default 256KB)
+    void set_replay_limit(size_t bytes) {
+        m_replay_limit = bytes;
+    }
+
+    /// How long a detached session remains resumable (default 60s)
+    void set_session_ttl(uint64_t ms) {
+        m_session_ttl_ms = ms;
+    }
+
+    /// Establish a session for a fresh connection
+    /**
+     * Call from the open handler. Issues a token and sends the
+     * "WSRS S" line. If the client intends to resume it will send
+     * "WSRS R <token>" instead of waiting; handle_message takes over
+     * from there, migrating this connection onto the old session.
+     */
+    void open(connection_hdl hdl) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        std::string token = make_token();
+        session & s = m_sessions[token];
+        s.token = token;
+        s.current = hdl;
+        s.attached = true;
+        m_by_connection[key_of(hdl)] = token;
+        send_line(hdl,"WSRS S "+token);
+    }
+
+    /// Route an inbound message through the shim
+    /**
+     * @return true when the message was shim control traffic and has
+     * been consumed; false when the application should process it
+     */
+    bool handle_message(connection_hdl hdl, message_ptr msg) {
+        std::string const & p = msg->get_payload();
+        if (p.compare(0,5,"WSRS ") != 0) {
+            return false;
+        }
+        if (p.size() > 7 && p[5] == 'R') {
+            resume(hdl,p.substr(7));
+            return true;
+        }
+        if (p.size() > 7 && p[5] == 'A') {
+            acknowledge(hdl,strtoull(p.c_str()+7,0,10));
+            return true;
+        }
+        return true;
+    }
+
+    /// Send sequenced application data on a session
+    /**
+     * Buffered until acknowledged; delivered immediately when the
+     * session has a live connection. Overflowing the replay cap marks
+     * the session broken (next resume triggers a full rebuild).
+     */
+    void send(connection_hdl hdl, std::string const & payload,
+        frame::opcode::value op)
+    {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        session * s = find_by_connection(hdl);
+        if (!s) {
+            return;
+        }
+        buffer_and_deliver(*s,payload,op);
+    }
+
+    /// The session token bound to a connection, or empty
+    /**
+     * For the application's user-to-session map, enabling
+     * send_to_token publishes while the user is disconnected.
+     */
+    std::string get_token(connection_hdl hdl) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        session * s = find_by_connection(hdl);
+        return s ? s->token : std::string();
+    }
+
+    /// Send sequenced data to a session by token
+    /**
+     * The detached-publish path: buffered for replay whether or not a
+     * connection is currently attached.
+     *
+     * @return Whether the token named a live (unbroken) session
+     */
+    bool send_to_token(std::string const & token,
+        std::string const & payload, frame::opcode::value op)
+    {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        typename std::map<std::string,session>::iterator it =
+            m_sessions.find(token);
+        if (it == m_sessions.end() || it->second.broken) {
+            return false;
+        }
+        buffer_and_deliver(it->second,payload,op);
+        return true;
+    }
+
+    /// Note a connection's departure; its session stays resumable
+    void detach(connection_hdl hdl) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        session * s = find_by_connection(hdl);
+        if (!s) {
+            return;
+        }
+        s->attached = false;
+        s->detached_at_ms = lib::steady_ms();
+        m_by_connection.erase(key_of(hdl));
+    }
+
+    /// Reap sessions whose TTL has expired
+    void sweep() {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        uint64_t now = lib::steady_ms();
+        typename std::map<std::string,session>::iterator it =
+            m_sessions.begin();
+        while (it != m_sessions.end()) {
+            if (!it->second.attached
+                && now-it->second.detached_at_ms >= m_session_ttl_ms)
+            {
+                m_sessions.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Sessions currently tracked (attached and resumable)
+    size_t session_count() const {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        return m_sessions.size();
+    }
+
+private:
+    struct entry {
+        uint64_t seq;
+        frame::opcode::value op;
+        std::string payload;
+    };
+
+    struct session {
+        session() : next_seq(0), bytes(0), attached(false), broken(false),
+            detached_at_ms(0) {}
+
+        std::string token;
+        connection_hdl current;
+        uint64_t next_seq;
+        std::deque<entry> replay;
+        size_t bytes;
+        bool attached;
+        bool broken;
+        uint64_t detached_at_ms;
+    };
+
+    /// Sequence, buffer (cap enforced), and deliver when attached
+    void buffer_and_deliver(session & s, std::string const & payload,
+        frame::opcode::value op)
+    {
+        s.next_seq++;
+        entry e;
+        e.seq = s.next_seq;
+        e.op = op;
+        e.payload = payload;
+        s.bytes += payload.size();
+        s.replay.push_back(e);
+        while (s.bytes > m_replay_limit && !s.replay.empty()) {
+            // an overflowing session can no longer promise a complete
+            // delta; poison it rather than silently dropping messages
+            s.bytes -= s.replay.front().payload.size();
+            s.replay.pop_front();
+            s.broken = true;
+        }
+        if (s.attached) {
+            deliver(s.current,e);
+        }
+    }
+
+    /// Migrate a connection onto an existing session and replay the delta
+    void resume(connection_hdl hdl, std::string const & token) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        typename std::map<std::string,session>::iterator it =
+            m_sessions.find(token);
+        uint64_t now = lib::steady_ms();
+        if (it != m_sessions.end() && it->second.attached) {
+            // the token names a session another connection still holds;
+            // rebinding would hand that session's replay buffer and all
+            // future traffic to the requester. Refuse -- a legitimate
+            // reconnect becomes resumable once the close handler's
+            // detach() runs, and until then the requester keeps the
+            // fresh session open() issued it.
+            send_line(hdl,"WSRS X");
+            return;
+        }
+        if (it == m_sessions.end() || it->second.broken
+            || (!it->second.attached
+                && now-it->second.detached_at_ms >= m_session_ttl_ms))
+        {
+            if (it != m_sessions.end()) {
+                m_sessions.erase(it);
+            }
+            send_line(hdl,"WSRS X");
+            return;
+        }
+        session & s = it->second;
+        // the connection open() created a placeholder session for this
+        // handle; fold it away
+        std::map<std::string,std::string>::iterator bc =
+            m_by_connection.find(key_of(hdl));
+        if (bc != m_by_connection.end() && bc->second != token) {
+            m_sessions.erase(bc->second);
+        }
+        s.current = hdl;
+        s.attached = true;
+        m_by_connection[key_of(hdl)] = token;
+        send_line(hdl,"WSRS S "+token);
+        for (size_t i = 0; i < s.replay.size(); i++) {
+            deliver(hdl,s.replay[i]);
+        }
+    }
+
+    /// Trim entries at or below the acknowledged sequence
+    void acknowledge(connection_hdl hdl, uint64_t seq) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        session * s = find_by_connection(hdl);
+        if (!s) {
+            return;
+        }
+        while (!s->replay.empty() && s->replay.front().seq <= seq) {
+            s->bytes -= s->replay.front().payload.size();
+            s->replay.pop_front();
+        }
+    }
+
+    void deliver(connection_hdl hdl, entry const & e) {
+        // sequenced frame: "WSRS M <seq> " + payload
+        std::string out = "WSRS M ";
+        append_u64(out,e.seq);
+        out += ' ';
+        out += e.payload;
+        lib::error_code ec;
+        m_endpoint.send(hdl,out,e.op,ec);
+    }
+
+    void send_line(connection_hdl hdl, std::string const & line) {
+        lib::error_code ec;
+        m_endpoint.send(hdl,line,frame::opcode::text,ec);
+    }
+
+    session * find_by_connection(connection_hdl hdl) {
+        std::map<std::string,std::string>::iterator it =
+            m_by_connection.find(key_of(hdl));
+        if (it == m_by_connection.end()) {
+            return 0;
+        }
+        typename std::map<std::string,session>::iterator sit =
+            m_sessions.find(it->second);
+        return sit == m_sessions.end() ? 0 : &sit->second;
+    }
+
+    static std::string key_of(connection_hdl hdl) {
+        char buf[24];
+        std::sprintf(buf,"%p",static_cast<void *>(hdl.lock().get()));
+        return std::string(buf);
+    }
+
+    /// Mint an unguessable session token. m_lock held.
+    /**
+     * Tokens are bearer credentials -- presenting one hands over the
+     * session's replay buffer and future traffic -- so they carry 128
+     * bits of system entropy, never counters or timestamps a client
+     * could extrapolate from its own token.
+     */
+    std::string make_token() {
+        std::string t;
+        do {
+            t = "t";
+            char buf[16];
+            for (int i = 0; i < 4; i++) {
+                std::sprintf(buf,"%08x",
+                    static_cast<unsigned int>(m_rng()&0xffffffffu));
+                t += buf;
+            }
+        } while (m_sessions.count(t) != 0);
+        return t;
+    }
+
+    static void append_u64(std::string & out, uint64_t v) {
+        char buf[24];
+        std::sprintf(buf,"%llu",static_cast<unsigned long long>(v));
+        out += buf;
+    }
+
+    endpoint_type & m_endpoint;
+    size_t m_replay_limit;
+    uint64_t m_session_ttl_ms;
+    lib::random_device m_rng;
+
+    mutable lib::mutex m_lock;
+    std::map<std::string,session> m_sessions;
+    /// connection identity -> session token
+    std::map<std::string,std::string> m_by_connection;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_SESSION_RESUME_HPP
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRACING_HPP
+#define WEBSOCKETPP_TRACING_HPP
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+#include <cstdio>
+
+namespace websocketpp {
+
+/// Compile time frame-level tracing policy
+/**
+ * A config selects its tracer with an optional typedef:
+ *
+ * \code
+ * struct traced_config : public websocketpp::config::asio {
+ *     typedef websocketpp::tracing::stderr_trace tracer_type;
+ *
+ *     // the transport resolves its tracer from its own config; define
+ *     // it there too to cover the transport tracepoints (timer fire)
+ *     struct transport_config
+ *         : public websocketpp::config::asio::transport_config
+ *     {
+ *         typedef websocketpp::tracing::stderr_trace tracer_type;
+ *     };
+ *     typedef websocketpp::transport::asio::endpoint<transport_config>
+ *         transport_type;
+ * };
+ * \endcode
+ *
+ * Tracepoints fire at: frame header parsed, message complete, message
+ * enqueued for writing, messages dequeued into a write, write complete,
+ * and timer fire. Each receives a connection identity (the address of
+ * the traced component) and a monotonic microsecond timestamp taken at
+ * the point, plus a point-specific size where one is meaningful.
+ *
+ * Every call site is guarded by the tracer's compile time `enabled`
+ * constant, so the default `none` policy compiles to nothing -- no
+ * timestamp is even read. A production backend (USDT probes via
+ * DTRACE_PROBE, a perfetto track event, a ring buffer) implements the
+ * same six static functions; stderr_trace below is the reference
+ * backend and doubles as the verification vehicle.
+ */
+namespace tracing {
+
+/// Null tracer; every tracepoint compiles to nothing
+struct none {
+    static bool const enabled = false;
+
+    static void on_header_parsed(void const *, uint64_t) {}
+    static void on_message_complete(void const *, uint64_t, size_t) {}
+    static void on_enqueue(void const *, uint64_t, size_t) {}
+    static void on_dequeue(void const *, uint64_t, size_t) {}
+    static void on_write_complete(void const *, uint64_t, size_t) {}
+    static void on_timer_fire(void const *, uint64_t) {}
+};
+
+/// Reference backend: one line per event on stderr
+/**
+ * For ad hoc latency chases and for validating custom backends; a
+ * production tracer would emit USDT probes or perfetto events instead
+ * of formatted IO.
+ */
+struct stderr_trace {
+    static bool const enabled = true;
+
+    static void emit(char const * point, void const * id, uint64_t us,
+        size_t n)
+    {
+        std::fprintf(stderr,"wspp-trace %s id=%p us=%llu n=%zu\n",
+            point,id,static_cast<unsigned long long>(us),n);
+    }
+
+    static void on_header_parsed(void const * id, uint64_t us) {
+        emit("header_parsed",id,us,0);
+    }
+    static void on_message_complete(void const * id, uint64_t us,
+        size_t bytes)
+    {
+        emit("message_complete",id,us,bytes);
+    }
+    static void on_enqueue(void const * id, uint64_t us, size_t bytes) {
+        emit("enqueue",id,us,bytes);
+    }
+    static void on_dequeue(void const * id, uint64_t us, size_t count) {
+        emit("dequeue",id,us,count);
+    }
+    static void on_write_complete(void const * id, uint64_t us,
+        size_t count)
+    {
+        emit("write_complete",id,us,count);
+    }
+    static void on_timer_fire(void const * id, uint64_t us) {
+        emit("timer_fire",id,us,0);
+    }
+};
+
+/// Selects the config's tracer_type, defaulting to none when absent
+template <typename config, typename Enable = void>
+struct selector {
+    typedef none type;
+};
+
+template <typename config>
+struct selector<config,
+    typename detail::type_sink<typename config::tracer_type>::type>
+{
+    typedef typename config::tracer_type type;
+};
+
+} // namespace tracing
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRACING_HPP
@@ -28,8 +28,10 @@
 #ifndef WEBSOCKETPP_TRANSPORT_ASIO_BASE_HPP
 #define WEBSOCKETPP_TRANSPORT_ASIO_BASE_HPP
 
+#include <websocketpp/common/atomic.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
 #include <websocketpp/common/system_error.hpp>
 
 #include <boost/system/error_code.hpp>
@@ -48,6 +50,20 @@ namespace asio {
 typedef lib::function<void(boost::system::error_code const &)>
     socket_shutdown_handler;
 
+/// Live load accounting for one io_service shard
+/**
+ * Shared by every connection assigned to the shard; with a shared
+ * shard_pool, also shared across all endpoints attached to it, so
+ * least-loaded placement sees the whole process's load. Counters are
+ * relaxed atomics -- they steer placement, they are not an audit log.
+ */
+struct shard_load {
+    shard_load() : connections(0), bytes_out(0) {}
+    lib::atomic<std::size_t> connections;
+    lib::atomic<uint64_t> bytes_out;
+    typedef lib::shared_ptr<shard_load> ptr;
+};
+
 /// Asio transport errors
 namespace error {
 enum value {
@@ -65,7 +81,16 @@ enum value {
     proxy_failed,
 
     /// Invalid Proxy URI
-    proxy_invalid
+    proxy_invalid,
+
+    /// Total connect budget exhausted during DNS resolution
+    budget_dns_resolve,
+
+    /// Total connect budget exhausted during TCP connect
+    budget_tcp_connect,
+
+    /// Total connect budget exhausted during socket post-init (TLS)
+    budget_post_init
 };
 
 /// Asio transport error category
@@ -87,6 +112,12 @@ public:
                 return "Proxy connection failed";
             case error::proxy_invalid:
                 return "Invalid proxy URI";
+            case error::budget_dns_resolve:
+                return "Connect budget exhausted during DNS resolution";
+            case error::budget_tcp_connect:
+                return "Connect budget exhausted during TCP connect";
+            case error::budget_post_init:
+                return "Connect budget exhausted during socket post-init";
             default:
                 return "Unknown";
         }
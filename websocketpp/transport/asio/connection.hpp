@@ -30,11 +30,20 @@
 
 #include <websocketpp/common/memory.hpp>
 #include <websocketpp/common/functional.hpp>
+#ifndef NDEBUG
+    #include <websocketpp/common/thread.hpp>
+    #include <cassert>
+#include <cstring>
+#endif
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/transport/asio/base.hpp>
+#include <websocketpp/transport/asio/handler_allocator.hpp>
+#include <websocketpp/transport/asio/timer_wheel.hpp>
 #include <websocketpp/transport/base/connection.hpp>
+#include <websocketpp/transport/recording.hpp>
+#include <websocketpp/tracing.hpp>
 
 #include <websocketpp/base64/base64.hpp>
 #include <websocketpp/error.hpp>
@@ -70,6 +79,7 @@ public:
     /// Type of a shared pointer to the socket connection component
     typedef typename socket_con_type::ptr socket_con_ptr;
     /// Type of this transport's access logging policy
+    typedef typename tracing::selector<config>::type tracer;
     typedef typename config::alog_type alog_type;
     /// Type of this transport's error logging policy
     typedef typename config::elog_type elog_type;
@@ -82,11 +92,56 @@ public:
     /// Type of a pointer to the ASIO io_service being used
     typedef boost::asio::io_service* io_service_ptr;    
     /// Type of a pointer to the ASIO timer class
-    typedef lib::shared_ptr<boost::asio::deadline_timer> timer_ptr;
+    typedef lib::shared_ptr<boost::asio::deadline_timer> native_timer_ptr;
+    typedef timer_object::ptr timer_ptr;
     
     // generate and manage our own io_service
+    /// Get the accept shard this connection is associated with
+    /**
+     * Only meaningful for server connections created by an endpoint in
+     * sharded accept mode; 0 otherwise.
+     */
+    std::size_t get_shard() const {
+        return m_shard;
+    }
+
+    /// Associate this connection with an accept shard
+    /**
+     * Called by the endpoint transport component during init.
+     */
+    void set_shard(std::size_t shard) {
+        m_shard = shard;
+    }
+
+    /// Per shard load totals shared between an endpoint and its connections
+    /// Shard load accounting; see transport::asio::shard_load
+    typedef asio::shard_load shard_load;
+
+    /// Attach this connection to a shard's load accounting
+    /**
+     * Called by the endpoint at init in pooled/sharded mode; the counter
+     * was already incremented for this connection. Released (decremented)
+     * when the connection is reset for reuse or destroyed.
+     */
+    void set_shard_load(typename shard_load::ptr load) {
+        m_shard_load = load;
+    }
+
+    ~connection() {
+        release_shard_load();
+    }
+
     explicit connection(bool is_server, alog_type& alog, elog_type& elog)
       : m_is_server(is_server)
+      , m_shard(0)
+      , m_speculative_writes(false)
+      , m_socket_nonblocking(false)
+      , m_connect_deadline_ms(0)
+      , m_drain_reads(false)
+      , m_drain_iter_budget(8)
+      , m_drain_depth(0)
+      , m_drain_buf(0)
+      , m_drain_len(0)
       , m_alog(alog)
       , m_elog(elog)
     {
@@ -96,6 +151,55 @@ public:
     bool is_secure() const {
         return socket_con_type::is_secure();
     }
+
+#ifndef NDEBUG
+    /// Debug check that socket operations stay on one io thread
+    /**
+     * The transport runs strand free: asio sockets are not thread safe,
+     * so correctness relies on every read and write being initiated from
+     * the connection's home io thread (cross thread work arrives via
+     * dispatch(), which posts). The first socket operation binds the home
+     * thread; any later operation from a different thread asserts. Debug
+     * builds only; release builds carry no per-op cost.
+     */
+    void debug_assert_home_thread() {
+        note_home_thread();
+        assert(lib::this_thread::get_id() == m_home_thread &&
+            "asio socket operation off the connection's home io thread");
+    }
+#endif
+
+    /// Record the io thread driving this connection's socket operations
+    /**
+     * Bound at the first socket operation (always compiled, unlike the
+     * debug assertion) so dispatch_affine can recognize same-thread
+     * callers and invoke inline instead of round-tripping the reactor.
+     */
+    void note_home_thread() {
+        if (m_home_thread == lib::thread::id()) {
+            m_home_thread = lib::this_thread::get_id();
+        }
+    }
+
+    /// Dispatch that invokes inline when already on the home io thread
+    /**
+     * The affine executor: same-thread calls (a message handler sending,
+     * for instance -- about a third of all posts in traced fanout
+     * workloads) run the handler immediately with no allocation and no
+     * reactor round trip; true cross-thread calls post as before. Only
+     * for handlers that tolerate inline execution -- paths that post to
+     * YIELD (the read loop's fairness budget) must keep dispatch().
+     */
+    lib::error_code dispatch_affine(dispatch_handler handler) {
+        if (m_home_thread != lib::thread::id()
+            && lib::this_thread::get_id() == m_home_thread)
+        {
+            handler();
+            return lib::error_code();
+        }
+        m_io_service->post(handler);
+        return lib::error_code();
+    }
     
     /// Finish constructing the transport
     /**
@@ -111,6 +215,16 @@ public:
      *
      * @return Status code for the success or failure of the initialization
      */
+    /// Cancel outstanding socket operations
+    /**
+     * Forwards to the socket policy's cancel_socket. Like init_asio this is
+     * public rather than protected because the endpoint's connect timeout
+     * handler needs to call it.
+     */
+    void cancel_socket() {
+        socket_con_type::cancel_socket();
+    }
+    
     lib::error_code init_asio (io_service_ptr io_service) {
         // do we need to store or use the io_service at this level?
         m_io_service = io_service;
@@ -281,7 +395,17 @@ public:
      * needed.
      */
     timer_ptr set_timer(long duration, timer_handler callback) {
-        timer_ptr new_timer(
+        // when the endpoint shares a timing wheel with this connection's
+        // io_service, schedule there: O(1) and no per-timeout heap object
+        if (m_timer_wheel) {
+            if (!m_timer_group) {
+                m_timer_group.reset(new timer_wheel::group());
+            }
+            return timer_ptr(new timer_object(
+                m_timer_wheel->set_timer(duration,callback,m_timer_group)));
+        }
+
+        native_timer_ptr new_timer(
             new boost::asio::deadline_timer(
                 *m_io_service,
                 boost::posix_time::milliseconds(duration)
@@ -298,7 +422,127 @@ public:
             )
         );
         
-        return new_timer;
+        return timer_ptr(new timer_object(new_timer));
+    }
+
+    /// Attach a shared timing wheel for this connection's timeouts
+    /**
+     * Called by the endpoint during connection initialization. The wheel
+     * must be driven by the same io_service as this connection.
+     */
+    void set_timer_wheel(timer_wheel::ptr wheel) {
+        m_timer_wheel = wheel;
+    }
+
+    /// Cancel every outstanding timeout for this connection at once
+    /**
+     * Wheel-scheduled timeouts are revoked as a group: one lock, no
+     * reactor operations, regardless of how many timers are live. Called
+     * from core terminate so mass disconnects do not serialize four
+     * cancel ops per connection through the reactor. Native asio timers
+     * (no wheel attached) are unaffected; their individual handle
+     * cancels still apply.
+     */
+    void cancel_timers() {
+        if (m_timer_group) {
+            m_timer_group->cancel_all();
+        }
+    }
+
+    /// Return the transport component to a reusable state
+    /**
+     * Part of the connection pooling protocol; the endpoint re-runs init
+     * afterwards, which rebuilds the socket.
+     */
+    void reset_for_reuse() {
+        socket_con_type::reset_for_reuse();
+        m_bufs.clear();
+        m_proxy.clear();
+        m_proxy_data.reset();
+        m_socket_nonblocking = false;
+        m_drain_depth = 0;
+        release_shard_load();
+        m_home_thread = lib::thread::id();
+        m_timer_wheel.reset();
+        m_timer_group.reset();
+        m_recorder.reset();
+        m_shard = 0;
+    }
+
+    /// Attach a wire traffic recorder to this connection
+    /**
+     * Every inbound span delivered to the core connection and every
+     * outbound buffer handed to the socket is appended to the
+     * recorder's log with a monotonic timestamp; see
+     * transport::recording::recorder for format and replay. Null
+     * detaches. Off (one pointer test per operation) by default.
+     */
+    void set_recorder(transport::recording::recorder::ptr rec) {
+        m_recorder = rec;
+    }
+
+    /// Enable or disable the speculative synchronous write fast path
+    /**
+     * Off by default. Not used on secure (TLS) connections. See
+     * write_bufs.
+     */
+    void set_speculative_writes(bool value) {
+        m_speculative_writes = value;
+    }
+
+    /// Enable opportunistic batched reads (socket drain before re-arm)
+    /**
+     * Off by default; never used on secure (TLS) connections. When a
+     * read is (re)armed and bytes are already waiting in the kernel
+     * buffer, a non blocking read satisfies it inline -- no epoll
+     * wakeup -- and after an asynchronous read completes, additional
+     * waiting bytes are drained into the remaining buffer space before
+     * the handler runs, so the parser chews one larger batch. Inline
+     * completions recurse through the caller's read loop; max_inline
+     * bounds consecutive inline completions (stack depth and shard
+     * fairness) before forcing one reactor round trip.
+     *
+     * The trade-off: under sustained inbound load the reactor round
+     * trips collapse (epoll wakeups drop several-fold); under sparse
+     * trickle traffic the eager reads consume data in smaller pieces
+     * than waiting in the reactor would have accumulated -- lower
+     * latency, but more (small) read syscalls. Enable it for
+     * connections expected to run hot.
+     *
+     * @param value Whether to drain
+     * @param max_inline Consecutive inline completions before yielding
+     */
+    void set_drain_reads(bool value, size_t max_inline = 8) {
+        m_drain_reads = value;
+        m_drain_iter_budget = (max_inline < 1 ? 1 : max_inline);
+    }
+
+    /// Set the absolute connect deadline (lib::steady_ms reference)
+    /**
+     * Installed by the client endpoint when a total connect budget is
+     * configured; every connect stage (DNS, TCP connect, post-init,
+     * and the core handshake via remaining_connect_budget) then
+     * consumes from this one deadline instead of stacking independent
+     * per-stage timeouts. Zero means no budget.
+     */
+    void set_connect_deadline(uint64_t deadline_ms) {
+        m_connect_deadline_ms = deadline_ms;
+    }
+
+    /// Milliseconds left in the connect budget; 0 when no budget is set
+    /**
+     * Negative budgets are reported as 1ms so callers arm a timer that
+     * fires immediately rather than dividing by zero semantics.
+     */
+    long remaining_connect_budget() const {
+        if (m_connect_deadline_ms == 0) {
+            return 0;
+        }
+        uint64_t now = lib::steady_ms();
+        if (now >= m_connect_deadline_ms) {
+            return 1;
+        }
+        return static_cast<long>(m_connect_deadline_ms-now);
     }
     
     /// Timer callback
@@ -312,9 +556,12 @@ public:
      *
      * @param ec The status code
      */
-    void handle_timer(timer_ptr t, timer_handler callback, const 
+    void handle_timer(native_timer_ptr t, timer_handler callback, const 
         boost::system::error_code& ec)
     {
+        if (tracer::enabled && !ec) {
+            tracer::on_timer_fire(this,lib::steady_us());
+        }
         if (ec) {
             if (ec == boost::asio::error::operation_aborted) {
                 callback(make_error_code(transport::error::operation_aborted)); 
@@ -384,6 +631,15 @@ protected:
         }
     }
     
+    /// Post-init stage timeout, capped by the connect budget
+    long post_init_budget() const {
+        long remaining = remaining_connect_budget();
+        if (remaining == 0 || remaining > config::timeout_socket_post_init) {
+            return config::timeout_socket_post_init;
+        }
+        return remaining;
+    }
+
     void post_init(init_handler callback) {
         if (m_alog.static_test(log::alevel::devel)) {
             m_alog.write(log::alevel::devel,"asio connection post_init");
@@ -391,7 +647,7 @@ protected:
         
         timer_ptr post_timer;
         post_timer = set_timer(
-            config::timeout_socket_post_init,
+            post_init_budget(),
             lib::bind(
                 &type::handle_post_init_timeout,
                 this,
@@ -443,7 +699,7 @@ protected:
         lib::error_code& ec) 
     {
         if (ec == transport::error::operation_aborted || 
-            post_timer->expires_from_now().is_negative())
+            post_timer->expired())
         {
             m_alog.write(log::alevel::devel,"post_init cancelled");
             return;
@@ -530,7 +786,7 @@ protected:
         // Whatever aborted it will be issuing the callback so we are safe to
         // return
         if (ec == boost::asio::error::operation_aborted || 
-            m_proxy_data->timer->expires_from_now().is_negative())
+            m_proxy_data->timer->expired())
         {
             m_elog.write(log::elevel::devel,"write operation aborted");
             return;
@@ -584,7 +840,7 @@ protected:
         // Whatever aborted it will be issuing the callback so we are safe to
         // return
         if (ec == boost::asio::error::operation_aborted || 
-            m_proxy_data->timer->expires_from_now().is_negative())
+            m_proxy_data->timer->expired())
         {
             m_elog.write(log::elevel::devel,"read operation aborted");
             return;
@@ -657,6 +913,11 @@ protected:
     void async_read_at_least(size_t num_bytes, char *buf, size_t len, 
         read_handler handler)
     {
+#ifndef NDEBUG
+        debug_assert_home_thread();
+#else
+        note_home_thread();
+#endif
         if (m_alog.static_test(log::alevel::devel)) {
             std::stringstream s;
             s << "asio async_read_at_least: " << num_bytes;
@@ -671,24 +932,102 @@ protected:
             return;
         }
         
+        m_drain_buf = buf;
+        m_drain_len = len;
+
+        size_t got = 0;
+        if (m_drain_reads && !socket_con_type::is_secure()
+            && m_drain_depth < m_drain_iter_budget)
+        {
+            boost::system::error_code sec;
+            if (!m_socket_nonblocking) {
+                socket_con_type::get_raw_socket().non_blocking(true,sec);
+                if (!sec) {
+                    m_socket_nonblocking = true;
+                }
+            }
+            if (m_socket_nonblocking) {
+                // speculative read: bytes already in the kernel buffer
+                // satisfy the request with no reactor round trip
+                got = socket_con_type::get_next_layer().read_some(
+                    boost::asio::buffer(buf,len),sec);
+                if (!sec && got >= num_bytes) {
+                    m_drain_depth++;
+                    if (m_recorder) {
+                        m_recorder->record(
+                            transport::recording::direction::inbound,
+                            buf,got);
+                    }
+                    handler(lib::error_code(),got);
+                    return;
+                }
+                if (sec && sec != boost::asio::error::would_block &&
+                    sec != boost::asio::error::try_again &&
+                    sec != boost::asio::error::interrupted)
+                {
+                    m_drain_depth = 0;
+                    handle_async_read(handler,sec,got);
+                    return;
+                }
+                // partial (or nothing): fall through to the reactor for
+                // the remainder
+            }
+        }
+        m_drain_depth = 0;
+
         boost::asio::async_read(
             socket_con_type::get_socket(),
-            boost::asio::buffer(buf,len),
-            boost::asio::transfer_at_least(num_bytes),
-            lib::bind(
-                &type::handle_async_read,
-                this,
-                handler,
-                lib::placeholders::_1,
-                lib::placeholders::_2
+            boost::asio::buffer(buf+got,len-got),
+            boost::asio::transfer_at_least(num_bytes-got),
+            make_custom_alloc_handler(
+                m_read_handler_allocator,
+                lib::bind(
+                    &type::handle_async_read_base,
+                    this,
+                    handler,
+                    got,
+                    lib::placeholders::_1,
+                    lib::placeholders::_2
+                )
             )
         );
     }
-    
+
+    /// Async read completion carrying speculatively pre-read bytes
+    /**
+     * After the reactor delivers a read, any further bytes that arrived
+     * meanwhile are drained into the remaining buffer space so the
+     * handler dispatches once over the larger batch.
+     */
+    void handle_async_read_base(read_handler handler, size_t base,
+        boost::system::error_code const & ec, size_t bytes_transferred)
+    {
+        size_t total = base+bytes_transferred;
+        if (!ec && m_drain_reads && m_socket_nonblocking
+            && !socket_con_type::is_secure()
+            && total < m_drain_len)
+        {
+            boost::system::error_code sec;
+            size_t extra = socket_con_type::get_next_layer().read_some(
+                boost::asio::buffer(m_drain_buf+total,m_drain_len-total),
+                sec);
+            if (!sec) {
+                total += extra;
+            }
+            // would_block and real errors alike are left to the next
+            // armed read; the bytes already in hand must be delivered
+        }
+        handle_async_read(handler,ec,total);
+    }
+
     void handle_async_read(read_handler handler, const 
         boost::system::error_code& ec, size_t bytes_transferred)
     {
         if (!ec) {
+            if (m_recorder && bytes_transferred > 0) {
+                m_recorder->record(transport::recording::direction::inbound,
+                    m_drain_buf,bytes_transferred);
+            }
             handler(lib::error_code(), bytes_transferred);
             return;
         }
@@ -708,39 +1047,192 @@ protected:
     }
     
     void async_write(const char* buf, size_t len, write_handler handler) {
+#ifndef NDEBUG
+        debug_assert_home_thread();
+#else
+        note_home_thread();
+#endif
+        if (m_shard_load) {
+            m_shard_load->bytes_out.fetch_add(len,
+                lib::memory_order_relaxed);
+        }
         m_bufs.push_back(boost::asio::buffer(buf,len));
-        
-        boost::asio::async_write(
-            socket_con_type::get_socket(),
-            m_bufs,
-            lib::bind(
-                &type::handle_async_write,
-                this,
-                handler,
-                lib::placeholders::_1
-            )
-        );
+
+        write_bufs(handler);
     }
     
     void async_write(const std::vector<buffer>& bufs, write_handler handler) {
+#ifndef NDEBUG
+        debug_assert_home_thread();
+#else
+        note_home_thread();
+#endif
+        if (m_shard_load) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < bufs.size(); i++) {
+                total += bufs[i].len;
+            }
+            m_shard_load->bytes_out.fetch_add(total,
+                lib::memory_order_relaxed);
+        }
         std::vector<buffer>::const_iterator it;
 
         for (it = bufs.begin(); it != bufs.end(); ++it) {
             m_bufs.push_back(boost::asio::buffer((*it).buf,(*it).len));
         }
         
+        write_bufs(handler);
+    }
+
+    /// Pack the gather list into TLS-record sized staging buffers
+    /**
+     * asio's ssl::stream issues one SSL_write per gather buffer, so a
+     * frame split into small header and payload buffers becomes two
+     * undersized TLS records, each paying its own MAC and padding.
+     * Before a secure write, small buffers are copied into pooled
+     * 16KB staging chunks (the TLS record payload ceiling) so every
+     * record ships full frames; buffers already at least half a record
+     * are passed through unstaged. The chunks are connection-owned and
+     * reused write after write -- exactly one write is outstanding at a
+     * time -- so the copy is the only cost.
+     */
+    void coalesce_tls_bufs() {
+        static size_t const record_size = 16384;
+        static size_t const passthrough = 8192;
+
+        m_tls_packed.clear();
+        size_t chunk = 0;
+        size_t used = record_size;  // forces a chunk open on first use
+
+        for (size_t i = 0; i < m_bufs.size(); i++) {
+            char const * data = boost::asio::buffer_cast<char const *>(
+                m_bufs[i]);
+            size_t len = boost::asio::buffer_size(m_bufs[i]);
+
+            if (len >= passthrough) {
+                if (used > 0 && used < record_size && chunk > 0) {
+                    // close the open chunk before the passthrough so
+                    // ordering is preserved
+                    m_tls_packed.push_back(boost::asio::buffer(
+                        &(*m_tls_staging[chunk-1])[0],used));
+                    used = record_size;
+                }
+                m_tls_packed.push_back(m_bufs[i]);
+                continue;
+            }
+
+            while (len > 0) {
+                if (used == record_size) {
+                    if (chunk == m_tls_staging.size()) {
+                        m_tls_staging.push_back(
+                            lib::shared_ptr<std::vector<char> >(
+                                new std::vector<char>(record_size)));
+                    }
+                    chunk++;
+                    used = 0;
+                }
+                size_t take = record_size-used;
+                if (take > len) {
+                    take = len;
+                }
+                std::memcpy(&(*m_tls_staging[chunk-1])[used],data,take);
+                used += take;
+                data += take;
+                len -= take;
+                if (used == record_size) {
+                    m_tls_packed.push_back(boost::asio::buffer(
+                        &(*m_tls_staging[chunk-1])[0],record_size));
+                }
+            }
+        }
+        if (used > 0 && used < record_size && chunk > 0) {
+            m_tls_packed.push_back(boost::asio::buffer(
+                &(*m_tls_staging[chunk-1])[0],used));
+        }
+        m_bufs.swap(m_tls_packed);
+    }
+
+    /// Write m_bufs, speculatively synchronous when enabled
+    /**
+     * In speculative mode a non blocking write_some is attempted first; if
+     * it consumes every byte the handler runs inline with no reactor round
+     * trip (callers must tolerate inline completion, which the library's
+     * own write path does -- its continuation re-posts through dispatch).
+     * On a partial write the remainder falls back to async_write; on
+     * would_block the whole operation does.
+     */
+    void write_bufs(write_handler handler) {
+        if (m_recorder) {
+            for (size_t i = 0; i < m_bufs.size(); i++) {
+                m_recorder->record(
+                    transport::recording::direction::outbound,
+                    boost::asio::buffer_cast<void const *>(m_bufs[i]),
+                    boost::asio::buffer_size(m_bufs[i]));
+            }
+        }
+        if (socket_con_type::is_secure() && m_bufs.size() > 1) {
+            coalesce_tls_bufs();
+        }
+        if (m_speculative_writes && !socket_con_type::is_secure()) {
+            boost::system::error_code sec;
+            if (!m_socket_nonblocking) {
+                socket_con_type::get_raw_socket().non_blocking(true,sec);
+                if (!sec) {
+                    m_socket_nonblocking = true;
+                }
+            }
+            if (m_socket_nonblocking) {
+                // next_layer rather than raw socket: the raw socket type
+                // does not expose synchronous I/O on newer asio, and the
+                // is_secure guard above keeps TLS off this path
+                size_t written = socket_con_type::get_next_layer().write_some(
+                    m_bufs,sec);
+                if (!sec) {
+                    // trim what was consumed; complete inline if everything
+                    size_t remaining = written;
+                    size_t i = 0;
+                    while (i < m_bufs.size() && remaining >=
+                           boost::asio::buffer_size(m_bufs[i]))
+                    {
+                        remaining -= boost::asio::buffer_size(m_bufs[i]);
+                        i++;
+                    }
+                    if (i == m_bufs.size()) {
+                        m_bufs.clear();
+                        handler(lib::error_code());
+                        return;
+                    }
+                    m_bufs.erase(m_bufs.begin(),m_bufs.begin()+i);
+                    m_bufs[0] = m_bufs[0]+remaining;
+                } else if (sec != boost::asio::error::would_block &&
+                           sec != boost::asio::error::try_again &&
+                           sec != boost::asio::error::interrupted)
+                {
+                    m_bufs.clear();
+                    log_err(log::elevel::info,"asio speculative write",sec);
+                    handler(make_error_code(transport::error::pass_through));
+                    return;
+                }
+            }
+        }
+
         boost::asio::async_write(
             socket_con_type::get_socket(),
             m_bufs,
-            lib::bind(
-                &type::handle_async_write,
-                this,
-                handler,
-                lib::placeholders::_1
+            make_custom_alloc_handler(
+                m_write_handler_allocator,
+                lib::bind(
+                    &type::handle_async_write,
+                    this,
+                    handler,
+                    lib::placeholders::_1
+                )
             )
         );
     }
 
+
+
     void handle_async_write(write_handler handler, const 
         boost::system::error_code& ec)
     {
@@ -842,7 +1334,7 @@ protected:
         callback, const boost::system::error_code & ec)
     {
         if (ec == boost::asio::error::operation_aborted || 
-            shutdown_timer->expires_from_now().is_negative())
+            shutdown_timer->expired())
         {
             m_alog.write(log::alevel::devel,"async_shutdown cancelled");
             return;
@@ -879,10 +1371,44 @@ private:
         m_elog.write(l,s.str());
     }
     
+    /// Drop this connection from its shard's connection count, once
+    void release_shard_load() {
+        if (m_shard_load) {
+            m_shard_load->connections.fetch_sub(1,
+                lib::memory_order_relaxed);
+            m_shard_load.reset();
+        }
+    }
+
     // static settings
     const bool m_is_server;
+    std::size_t m_shard;
+    timer_wheel::ptr m_timer_wheel;
+    timer_wheel::group::ptr m_timer_group;
+    bool m_speculative_writes;
+    bool m_socket_nonblocking;
+    transport::recording::recorder::ptr m_recorder;
+    uint64_t m_connect_deadline_ms;
+    bool m_drain_reads;
+    size_t m_drain_iter_budget;
+    size_t m_drain_depth;
+    char * m_drain_buf;
+    size_t m_drain_len;
+    /// Shard load accounting; null outside sharded mode
+    typename shard_load::ptr m_shard_load;
+    /// Home io thread bound by the first socket operation; read by
+    /// dispatch_affine and (in debug builds) the home thread assertion
+    lib::thread::id m_home_thread;
+
     alog_type& m_alog;
     elog_type& m_elog;
+
+    /// Recycling allocators for read and write completion handlers. The
+    /// library guarantees at most one outstanding read and one outstanding
+    /// write per connection, so one block each suffices for allocation-free
+    /// steady state operation.
+    handler_allocator m_read_handler_allocator;
+    handler_allocator m_write_handler_allocator;
     
     struct proxy_data {
         proxy_data() : timeout_proxy(config::timeout_proxy) {}
@@ -902,6 +1428,9 @@ private:
     io_service_ptr      m_io_service;
     connection_hdl      m_connection_hdl;
     std::vector<boost::asio::const_buffer> m_bufs;
+    /// Scratch gather list and pooled staging chunks for TLS coalescing
+    std::vector<boost::asio::const_buffer> m_tls_packed;
+    std::vector<lib::shared_ptr<std::vector<char> > > m_tls_staging;
 
     // Handlers
     tcp_init_handler    m_tcp_init_handler;
@@ -35,6 +35,9 @@
 #include <websocketpp/transport/asio/security/none.hpp>
 
 #include <boost/asio.hpp>
+
+#include <chrono>
+#include <cstdio>
 #include <boost/bind.hpp>
 #include <boost/system/error_code.hpp>
     
@@ -49,6 +52,85 @@ namespace asio {
  * transport::asio::endpoint implements an endpoint transport component using
  * Boost ASIO.
  */
+/// A set of io_service shards shareable by multiple endpoints
+/**
+ * For processes running several endpoints (ports/roles) whose load
+ * skews: instead of one private thread pool per endpoint, create one
+ * shard_pool and attach every endpoint to it with
+ * init_asio_shards_shared. The shards' load accounting is shared, so
+ * each endpoint's least-loaded placement of new connections steers
+ * toward shards that are idle process-wide, regardless of which
+ * endpoint their load came from. Core counts are tuned once, for the
+ * pool.
+ *
+ * Run the pool exactly once -- via run(), or by driving the io_service
+ * objects yourself -- after every endpoint has begun listening.
+ */
+struct shard_pool {
+    typedef lib::shared_ptr<shard_pool> ptr;
+
+    /// Create a pool of num_shards io_service shards
+    static ptr create(std::size_t num_shards) {
+        if (num_shards < 1) {
+            num_shards = 1;
+        }
+        ptr pool(new shard_pool());
+        for (std::size_t i = 0; i < num_shards; i++) {
+            pool->io_services.push_back(new boost::asio::io_service());
+            pool->loads.push_back(shard_load::ptr(new shard_load()));
+        }
+        return pool;
+    }
+
+    ~shard_pool() {
+        for (std::size_t i = 0; i < io_services.size(); i++) {
+            delete io_services[i];
+        }
+    }
+
+    /// Run one thread per shard and block until they drain
+    /**
+     * @param pin_cpus Pin thread i to CPU i (Linux only)
+     */
+    void run(bool pin_cpus = false) {
+        std::vector<lib::shared_ptr<lib::thread> > threads;
+        for (std::size_t i = 0; i < io_services.size(); i++) {
+            threads.push_back(lib::shared_ptr<lib::thread>(new lib::thread(
+                lib::bind(&shard_pool::run_shard,this,i,pin_cpus))));
+        }
+        for (std::size_t i = 0; i < threads.size(); i++) {
+            threads[i]->join();
+        }
+    }
+
+    /// Stop every shard's io_service
+    void stop() {
+        for (std::size_t i = 0; i < io_services.size(); i++) {
+            io_services[i]->stop();
+        }
+    }
+
+    std::vector<boost::asio::io_service *> io_services;
+    std::vector<shard_load::ptr> loads;
+
+private:
+    shard_pool() {}
+
+    void run_shard(std::size_t shard, bool pin_cpus) {
+#if defined(__linux__)
+        if (pin_cpus) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(shard % CPU_SETSIZE,&set);
+            pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+        }
+#else
+        (void)pin_cpus;
+#endif
+        io_services[shard]->run();
+    }
+};
+
 template <typename config>
 class endpoint : public config::socket_type {
 public:
@@ -78,8 +160,11 @@ public:
     
     /// Type of a pointer to the ASIO io_service being used
     typedef boost::asio::io_service* io_service_ptr;
+    /// Protocol the socket policy runs over (ip::tcp, or
+    /// local::stream_protocol for the unix domain policy)
+    typedef typename config::socket_type::protocol_type protocol_type;
     /// Type of a shared pointer to the acceptor being used
-    typedef lib::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor_ptr;
+    typedef lib::shared_ptr<typename protocol_type::acceptor> acceptor_ptr;
     /// Type of a shared pointer to the resolver being used
     typedef lib::shared_ptr<boost::asio::ip::tcp::resolver> resolver_ptr;
     /// Type of timer handle
@@ -88,14 +173,36 @@ public:
     // generate and manage our own io_service
     explicit endpoint() 
       : m_external_io_service(false)
+      , m_speculative_writes(false)
+      , m_drain_reads(false)
+      , m_drain_max_inline(8)
+      , m_poll_cursor(0)
+      , m_connect_budget_ms(0)
+      , m_dns_cache_ttl(0)
+      , m_parallel_connect(false)
+      , m_wheel_enabled(false)
+      , m_wheel_tick_ms(50)
+      , m_wheel_slots(1024)
       , m_state(UNINITIALIZED)
     {
         //std::cout << "transport::asio::endpoint constructor" << std::endl; 
     }
     
     ~endpoint() {
-        // clean up our io_service if we were initialized with an internal one.
+        // every member referencing an io_service must release before the
+        // services are deleted below; their destructors deregister from
+        // the service (the timer wheels' tick timers especially), which
+        // is a use-after-free once the service is gone
+        m_timer_wheels.clear();
+        m_resolver.reset();
         m_acceptor.reset();
+        m_shard_acceptors.clear();
+        if (!m_shard_pool && m_shard_io_services.size() > 1) {
+            // shard 0 is m_io_service and is deleted below
+            for (size_t i = 1; i < m_shard_io_services.size(); i++) {
+                delete m_shard_io_services[i];
+            }
+        }
         if (m_state != UNINITIALIZED && !m_external_io_service) {
             delete m_io_service;
         }
@@ -163,7 +270,7 @@ public:
         
         m_io_service = ptr;
         m_external_io_service = true;
-        m_acceptor.reset(new boost::asio::ip::tcp::acceptor(*m_io_service));
+        m_acceptor.reset(new typename protocol_type::acceptor(*m_io_service));
         m_state = READY;
     }
     
@@ -175,6 +282,342 @@ public:
         init_asio(new boost::asio::io_service());
         m_external_io_service = false;
     }
+
+    /// Initialize asio transport in sharded accept mode
+    /**
+     * Creates num_shards internal io_service objects, each with its own
+     * acceptor. listen() will bind every acceptor to the listen port with
+     * SO_REUSEPORT so the kernel distributes incoming connections between
+     * the shards, and each accepted connection is initialized on its
+     * accepting shard's io_service, so no cross thread handoff of new
+     * connections ever occurs. Run one thread per shard with run_shard(i).
+     *
+     * New connections are associated with shards round robin at creation
+     * time, which keeps exactly one accept outstanding per shard once the
+     * accept loop is primed. Priming requires one accept chain per shard:
+     * call server::set_accept_depth with at least num_shards before
+     * start_accept, or clients hashed to an unarmed listener wait in its
+     * backlog. Run one thread per shard (run_shard); connections never
+     * migrate between shards, which is what lets the transport stay
+     * strand free (debug builds assert the invariant).
+     *
+     * Only available on platforms that define SO_REUSEPORT.
+     *
+     * @param num_shards Number of io_service/acceptor shards to create
+     */
+    void init_asio_shards(std::size_t num_shards) {
+        if (num_shards < 1) {
+            num_shards = 1;
+        }
+        init_asio();
+        m_shard_io_services.push_back(m_io_service);
+        m_shard_acceptors.push_back(m_acceptor);
+        for (std::size_t i = 1; i < num_shards; i++) {
+            io_service_ptr ios = new boost::asio::io_service();
+            m_shard_io_services.push_back(ios);
+            m_shard_acceptors.push_back(acceptor_ptr(
+                new typename protocol_type::acceptor(*ios)));
+        }
+        for (std::size_t i = 0; i < num_shards; i++) {
+            m_shard_slots.push_back(lib::shared_ptr<lib::atomic<int> >(
+                new lib::atomic<int>(0)));
+            m_shard_loads.push_back(
+                typename transport_con_type::shard_load::ptr(
+                    new typename transport_con_type::shard_load()));
+        }
+    }
+
+    /// Attach this endpoint to a shared shard pool
+    /**
+     * The alternative to init_asio_shards for multi-endpoint processes:
+     * this endpoint creates its acceptors over the pool's io_service
+     * shards and adopts the pool's shared load accounting, so new
+     * connections are placed on the shard that is least loaded across
+     * every endpoint sharing the pool. The pool outlives the endpoint
+     * (shared ownership) and its services are never deleted here.
+     *
+     * As with init_asio_shards, call server::set_accept_depth with at
+     * least the shard count before listen so every shard's acceptor is
+     * armed.
+     *
+     * @param pool The shared pool to attach to
+     */
+    void init_asio_shards_shared(shard_pool::ptr pool) {
+        init_asio(pool->io_services[0]);
+        m_shard_pool = pool;
+        m_shard_io_services = pool->io_services;
+        m_shard_loads = pool->loads;
+        for (std::size_t i = 0; i < pool->io_services.size(); i++) {
+            if (i == 0) {
+                m_shard_acceptors.push_back(m_acceptor);
+            } else {
+                m_shard_acceptors.push_back(acceptor_ptr(
+                    new typename protocol_type::acceptor(
+                        *pool->io_services[i])));
+            }
+            m_shard_slots.push_back(lib::shared_ptr<lib::atomic<int> >(
+                new lib::atomic<int>(0)));
+        }
+    }
+
+    /// Signature of the pool thread lifecycle hooks
+    /**
+     * Invoked on the worker thread itself: start immediately after
+     * naming and pinning, before the first reactor iteration; stop
+     * after the reactor drains, before the thread exits. The shard
+     * index identifies which reactor the thread served.
+     */
+    typedef lib::function<void(std::size_t)> thread_hook;
+
+    /// Install pool thread lifecycle hooks
+    /**
+     * For app-side per-thread setup that must not race the reactor:
+     * profiler registration, scheduler tweaks, per-shard accounting.
+     * Applies to threads started by run_pool and run_pool_numa.
+     */
+    void set_thread_hooks(thread_hook on_start, thread_hook on_stop) {
+        m_thread_start_hook = on_start;
+        m_thread_stop_hook = on_stop;
+    }
+
+    /// Name pool threads for ops tooling (perf, top, /proc)
+    /**
+     * Each worker becomes "<prefix><shard>" (truncated to the kernel's
+     * 15 character limit on Linux; ignored where the platform has no
+     * thread naming). Applied on the worker thread before it runs, so
+     * every sample of the thread carries the name.
+     */
+    void set_thread_name_prefix(std::string const & prefix) {
+        m_thread_name_prefix = prefix;
+    }
+
+    /// Pin pool threads to explicit CPUs, one entry per shard
+    /**
+     * Overrides run_pool's sequential pin_cpus numbering: thread for
+     * shard i lands on cpus[i % cpus.size()]. Applied before the first
+     * reactor iteration -- no post-start affinity race. Linux only;
+     * ignored elsewhere.
+     */
+    void set_thread_affinity(std::vector<int> const & cpus) {
+        m_thread_cpus = cpus;
+    }
+
+    /// Run the sharded endpoint on a pool of threads
+    /**
+     * Convenience wrapper around run_shard: starts n_threads threads,
+     * thread i serving shard i modulo the shard count (use n_threads ==
+     * num_shards for the canonical one-thread-per-reactor layout), and
+     * blocks until they all return. With pin_cpus true each thread is
+     * pinned to CPU i (Linux only; ignored elsewhere). Non sharded
+     * endpoints run all threads on the single io_service, which requires
+     * strands the transport does not provide -- use init_asio_shards.
+     *
+     * @param n_threads Number of threads to start
+     * @param pin_cpus Whether to pin thread i to CPU i
+     */
+    void run_pool(std::size_t n_threads, bool pin_cpus = false) {
+        if (n_threads < 1) {
+            n_threads = 1;
+        }
+        if (m_shard_io_services.empty() && n_threads > 1) {
+            // multiple threads on one io_service would need strands the
+            // transport does not provide; serve it with one thread
+            m_elog->write(log::elevel::warn,
+                "run_pool on a non-sharded endpoint; clamping to 1 thread. "
+                "Use init_asio_shards for a thread pool.");
+            n_threads = 1;
+        }
+        std::vector<lib::shared_ptr<lib::thread> > threads;
+        for (std::size_t i = 0; i < n_threads; i++) {
+            std::size_t shard = (m_shard_io_services.empty() ?
+                0 : i % m_shard_io_services.size());
+            threads.push_back(lib::shared_ptr<lib::thread>(new lib::thread(
+                lib::bind(&endpoint::run_pool_thread,this,shard,i,
+                    pin_cpus))));
+        }
+        for (std::size_t i = 0; i < threads.size(); i++) {
+            threads[i]->join();
+        }
+    }
+
+    /// Run the sharded endpoint with NUMA node aware thread placement
+    /**
+     * Reads the node topology from /sys/devices/system/node and pins
+     * each shard's thread to its node's whole cpuset (shards distributed
+     * round robin across nodes), so a connection's reactor, its io
+     * thread, and -- through first touch allocation by that thread --
+     * its message buffers, arena chunks, and compression contexts all
+     * live on one node. Per connection message managers already allocate
+     * from the owning connection's thread, which is what makes first
+     * touch placement effective; steer NIC queue IRQ affinity to match
+     * externally. Falls back to one-thread-per-shard without pinning
+     * when the topology is unavailable (non-Linux, single node).
+     *
+     * Exactly one thread serves each shard -- more would run a shard's
+     * io_service from multiple threads, which the strand free transport
+     * forbids -- so size parallelism with init_asio_shards. Blocks until
+     * the pool drains, like run_pool.
+     */
+    void run_pool_numa() {
+#if defined(__linux__)
+        std::vector<std::vector<int> > nodes = read_numa_topology();
+        if (!nodes.empty() && !nodes[0].empty()) {
+            std::vector<lib::shared_ptr<lib::thread> > threads;
+            std::size_t shard_count = (m_shard_io_services.empty() ?
+                1 : m_shard_io_services.size());
+            for (std::size_t shard = 0; shard < shard_count; shard++) {
+                std::vector<int> const & cpus =
+                    nodes[shard % nodes.size()];
+                threads.push_back(lib::shared_ptr<lib::thread>(
+                    new lib::thread(lib::bind(
+                        &endpoint::run_numa_thread,this,shard,cpus))));
+            }
+            for (std::size_t i = 0; i < threads.size(); i++) {
+                threads[i]->join();
+            }
+            return;
+        }
+#endif
+        run_pool(1);
+    }
+
+    /// Connections currently assigned to a shard
+    std::size_t get_shard_connection_count(std::size_t shard) const {
+        return m_shard_loads.at(shard)->connections.load(
+            lib::memory_order_relaxed);
+    }
+
+    /// Total bytes handed to the transport for writing on a shard
+    uint64_t get_shard_bytes_out(std::size_t shard) const {
+        return m_shard_loads.at(shard)->bytes_out.load(
+            lib::memory_order_relaxed);
+    }
+
+    /// Enable the speculative synchronous write fast path on new connections
+    /**
+     * See connection::set_speculative_writes.
+     */
+    void set_speculative_writes(bool value) {
+        m_speculative_writes = value;
+    }
+
+    /// Budget total client connect latency as one number
+    /**
+     * When set, every stage of connection establishment -- DNS resolve,
+     * TCP connect, socket post-init (TLS handshake), and the WebSocket
+     * handshake -- consumes from a single deadline started at
+     * async_connect, instead of each stage getting its own full
+     * timeout (whose worst cases stack to the sum). A stage that finds
+     * the budget spent fails immediately with a stage-attributed error
+     * (error::budget_dns_resolve / budget_tcp_connect /
+     * budget_post_init; handshake exhaustion surfaces as the usual
+     * open handshake timeout). Zero disables budgeting and restores
+     * the independent per-stage config timeouts.
+     *
+     * @param total_ms The time-to-connected budget in milliseconds
+     */
+    void set_connect_budget(long total_ms) {
+        m_connect_budget_ms = total_ms;
+    }
+
+    /// Enable opportunistic batched reads on new connections
+    /**
+     * See connection::set_drain_reads.
+     */
+    void set_drain_reads(bool value, size_t max_inline = 8) {
+        m_drain_reads = value;
+        m_drain_max_inline = max_inline;
+    }
+
+    /// Pre-create lazily built transport state ahead of traffic
+    /**
+     * Part of endpoint::reserve: timer wheels are normally created at
+     * the first connection on each io_service; a warm start builds
+     * them (slot vectors included) before listen so the reconnect
+     * storm's first connections find them ready.
+     */
+    void prewarm() {
+        if (!m_wheel_enabled) {
+            return;
+        }
+        if (m_shard_io_services.empty()) {
+            get_timer_wheel(m_io_service);
+        } else {
+            for (size_t i = 0; i < m_shard_io_services.size(); i++) {
+                get_timer_wheel(m_shard_io_services[i]);
+            }
+        }
+    }
+
+    /// Share a timing wheel with every connection of this endpoint
+    /**
+     * Once enabled, connection timeouts (handshake, pong, close, shutdown)
+     * are multiplexed onto one tick timer per io_service instead of one
+     * heap managed asio timer per timeout. Wheels are created lazily per
+     * io_service, so sharded endpoints get one wheel per shard.
+     *
+     * @param tick_ms Tick length (firing granularity) in milliseconds
+     * @param num_slots Wheel slot count; tick_ms*num_slots per rotation
+     */
+    void enable_timer_wheel(long tick_ms = 50, size_t num_slots = 1024) {
+        m_wheel_enabled = true;
+        m_wheel_tick_ms = tick_ms;
+        m_wheel_slots = num_slots;
+    }
+
+    /// Cache successful DNS resolutions for reuse on reconnect
+    /**
+     * When set to a nonzero TTL, the endpoint of every successful resolver
+     * query is remembered per host:port and reused by subsequent connect
+     * calls until it expires, removing the resolver round trip from the
+     * reconnect path. Disabled (0) by default.
+     *
+     * @param ttl_ms Cache entry lifetime in milliseconds, 0 to disable
+     */
+    void set_dns_cache_ttl(long ttl_ms) {
+        m_dns_cache_ttl = ttl_ms;
+        if (ttl_ms <= 0) {
+            lib::lock_guard<lib::mutex> guard(m_dns_cache_lock);
+            m_dns_cache.clear();
+        }
+    }
+
+    /// Race TCP connects across all resolved endpoints
+    /**
+     * When enabled, connect attempts are started to every resolved
+     * endpoint at once (address families interleaved) on scratch sockets;
+     * the first to establish is kept and the rest are closed, in the
+     * style of Happy Eyeballs (RFC 8305) minus the stagger delay. When
+     * disabled (the default) endpoints are tried one at a time in
+     * resolver order, as before.
+     *
+     * Requires move assignable asio sockets (C++11); without them the
+     * sequential path is used regardless of this setting.
+     */
+    void set_parallel_connect(bool value) {
+        m_parallel_connect = value;
+    }
+
+    /// Set the filesystem path outgoing unix domain connections use
+    /**
+     * Only meaningful with the local_socket policy: async_connect ignores
+     * the connection URI's host (which still populates the Host header)
+     * and connects the stream socket to this path.
+     */
+    void set_socket_path(std::string const & path) {
+        m_socket_path = path;
+    }
+
+    /// Number of accept shards (1 unless init_asio_shards was used)
+    std::size_t get_num_shards() const {
+        return (m_shard_io_services.empty() ?
+            1 : m_shard_io_services.size());
+    }
+
+    /// Run one shard's io_service. Call from one thread per shard.
+    std::size_t run_shard(std::size_t shard) {
+        return m_shard_io_services.at(shard)->run();
+    }
     
     /// Sets the tcp init handler
     /**
@@ -189,7 +632,7 @@ public:
     }
 
     // listen manually
-    void listen(const boost::asio::ip::tcp::endpoint& e) {
+    void listen(typename protocol_type::endpoint const & e) {
         if (m_state != READY) {
             // TODO
             m_elog->write(log::elevel::library,
@@ -199,15 +642,68 @@ public:
         
         m_alog->write(log::alevel::devel,"asio::listen");
         
-        m_acceptor->open(e.protocol());
-        m_acceptor->set_option(boost::asio::socket_base::reuse_address(true));
-        m_acceptor->bind(e);
-        m_acceptor->listen();
+        if (m_shard_acceptors.size() > 1) {
+#ifdef SO_REUSEPORT
+            // one SO_REUSEPORT listener per shard; the kernel spreads
+            // incoming connections across them
+            typedef boost::asio::detail::socket_option::boolean<
+                SOL_SOCKET,SO_REUSEPORT> reuse_port;
+            for (size_t i = 0; i < m_shard_acceptors.size(); i++) {
+                m_shard_acceptors[i]->open(e.protocol());
+                m_shard_acceptors[i]->set_option(
+                    boost::asio::socket_base::reuse_address(true));
+                m_shard_acceptors[i]->set_option(reuse_port(true));
+                m_shard_acceptors[i]->bind(e);
+                m_shard_acceptors[i]->listen();
+            }
+#else
+            m_elog->write(log::elevel::library,
+                "sharded listen requires SO_REUSEPORT");
+            throw;
+#endif
+        } else {
+            m_acceptor->open(e.protocol());
+            m_acceptor->set_option(boost::asio::socket_base::reuse_address(true));
+            m_acceptor->bind(e);
+            m_acceptor->listen();
+        }
         m_state = LISTENING;
         
         m_alog->write(log::alevel::devel,"mark");
     }
     
+    /// Stop accepting new connections
+    /**
+     * Closes every listener (all shards when sharded) and returns the
+     * endpoint to the pre-listen state; outstanding accepts complete
+     * with operation_aborted and established connections are untouched.
+     *
+     * @param [out] ec A status code describing any error
+     */
+    void stop_listening(lib::error_code & ec) {
+        if (m_state != LISTENING) {
+            ec = lib::error_code(boost::system::errc::invalid_argument,
+                boost::system::generic_category());
+            return;
+        }
+        boost::system::error_code bec;
+        for (size_t i = 1; i < m_shard_acceptors.size(); i++) {
+            m_shard_acceptors[i]->cancel(bec);
+            m_shard_acceptors[i]->close(bec);
+        }
+        m_acceptor->cancel(bec);
+        m_acceptor->close(bec);
+        m_state = READY;
+        ec = lib::error_code();
+    }
+
+    /// Stop accepting new connections (exception variant)
+    void stop_listening() {
+        lib::error_code ec;
+        stop_listening(ec);
+        if (ec) { throw ec; }
+    }
+
     void cancel() {
         if (m_state != LISTENING) {
             // TODO
@@ -215,6 +711,11 @@ public:
         }
         
         // TODO: figure out if this is a good way to stop listening.
+        // close every shard's listener; element 0 aliases m_acceptor
+        for (size_t i = 1; i < m_shard_acceptors.size(); i++) {
+            m_shard_acceptors[i]->cancel();
+            m_shard_acceptors[i]->close();
+        }
         m_acceptor->cancel();
         m_acceptor->close();
     }
@@ -232,11 +733,16 @@ public:
         m_alog->write(log::alevel::devel, "asio::async_accept");
         
         // TEMP
-        m_acceptor->async_accept(
+        acceptor_ptr acceptor = m_acceptor;
+        if (m_shard_acceptors.size() > 1) {
+            acceptor = m_shard_acceptors[tcon->get_shard()];
+        }
+        acceptor->async_accept(
             tcon->get_raw_socket(),
             lib::bind(
                 &type::handle_accept,
                 this,
+                tcon->get_shard(),
                 tcon->get_handle(),
                 callback,
                 lib::placeholders::_1
@@ -250,18 +756,111 @@ public:
     }
     
     /// wraps the stop method of the internal io_service object
+    /**
+     * In sharded mode every shard's io_service is stopped.
+     */
     void stop() {
+        for (size_t i = 1; i < m_shard_io_services.size(); i++) {
+            m_shard_io_services[i]->stop();
+        }
         m_io_service->stop();
     }
     
-    /// wraps the poll method of the internal io_service object
+    /// Run all handlers that are ready to run, without blocking
+    /**
+     * Frame-loop embedding entry point: executes, on the calling
+     * thread, every handler currently ready and returns. Ready handlers
+     * include transport completions (accepts, reads, writes), expired
+     * timers (timing wheel ticks, keepalive and drain sweeps), and --
+     * through them -- every user handler those trigger (validate, open,
+     * message, close, fail, ...). No user handler of this endpoint runs
+     * outside poll/poll_one/poll_some/run* calls, which is what makes
+     * single threaded frame-loop embedding deterministic.
+     *
+     * In sharded mode every shard's io_service is polled.
+     *
+     * @return The number of handlers executed
+     */
     std::size_t poll() {
-        return m_io_service->poll();
+        std::size_t n = 0;
+        for (size_t i = 1; i < m_shard_io_services.size(); i++) {
+            n += m_shard_io_services[i]->poll();
+        }
+        return n+m_io_service->poll();
     }
     
-    /// wraps the poll_one method of the internal io_service object
+    /// Run at most one ready handler, without blocking
+    /**
+     * @see poll for which handlers may run. Sharded endpoints are
+     * scanned round robin from a persistent cursor so no shard is
+     * starved by a busy sibling.
+     *
+     * @return The number of handlers executed (0 or 1)
+     */
     std::size_t poll_one() {
-        return m_io_service->poll_one();
+        if (m_shard_io_services.size() <= 1) {
+            return m_io_service->poll_one();
+        }
+        for (size_t i = 0; i < m_shard_io_services.size(); i++) {
+            size_t shard = (m_poll_cursor+i) % m_shard_io_services.size();
+            if (m_shard_io_services[shard]->poll_one() > 0) {
+                m_poll_cursor = shard+1;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    /// Run at most max_handlers ready handlers, without blocking
+    /**
+     * The budgeted variant for fixed frame times: a 120Hz loop can
+     * spend a bounded number of handler invocations per frame and carry
+     * the rest over, instead of poll() occasionally running a burst's
+     * whole backlog inside one frame. @see poll for which handlers may
+     * run.
+     *
+     * @param max_handlers Handler budget for this call
+     * @return The number of handlers executed (at most max_handlers)
+     */
+    std::size_t poll_some(std::size_t max_handlers) {
+        std::size_t n = 0;
+        while (n < max_handlers && poll_one() > 0) {
+            n++;
+        }
+        return n;
+    }
+
+    /// Run at most one handler, blocking up to timeout_ms for one to
+    /// become ready
+    /**
+     * @see poll for which handlers may run. Sharded endpoints fall back
+     * to non blocking poll_one -- blocking on one shard would starve
+     * the others -- so a sharded game loop should sleep on its own
+     * clock between poll_some calls instead.
+     *
+     * @param timeout_ms Maximum time to wait for a handler
+     * @return The number of handlers executed (0 or 1)
+     */
+    std::size_t run_one_for(long timeout_ms) {
+        if (m_shard_io_services.size() > 1) {
+            return poll_one();
+        }
+        return m_io_service->run_one_for(
+            std::chrono::milliseconds(timeout_ms));
+    }
+
+    /// Run at most one handler, blocking until the given steady-clock
+    /// deadline (milliseconds, lib::steady_ms reference) at the latest
+    /**
+     * Deadline form of run_one_for for loops that track an absolute
+     * next-frame time.
+     */
+    std::size_t run_one_until(uint64_t steady_deadline_ms) {
+        uint64_t now = lib::steady_ms();
+        if (steady_deadline_ms <= now) {
+            return poll_one();
+        }
+        return run_one_for(static_cast<long>(steady_deadline_ms-now));
     }
     
     /// wraps the reset method of the internal io_service object
@@ -382,9 +981,15 @@ protected:
         m_elog = e;
     }
 
-    void handle_accept(connection_hdl hdl, accept_handler callback,
-        const boost::system::error_code& error)
+    void handle_accept(std::size_t shard, connection_hdl hdl,
+        accept_handler callback, const boost::system::error_code& error)
     {
+        // free the shard's accept slot so the connection created by the
+        // callback's start_accept re-arms this listener
+        if (shard < m_shard_slots.size()) {
+            m_shard_slots[shard]->store(0);
+        }
+
         if (error) {
             //con->terminate();
             // TODO: Better translation of errors at this point
@@ -401,6 +1006,11 @@ protected:
     void async_connect(transport_con_ptr tcon, uri_ptr u, connect_handler cb) {
         using namespace boost::asio::ip;
         
+        if (m_connect_budget_ms > 0) {
+            tcon->set_connect_deadline(
+                lib::steady_ms()+static_cast<uint64_t>(m_connect_budget_ms));
+        }
+        
         // Create a resolver
         if (!m_resolver) {
             m_resolver.reset(new boost::asio::ip::tcp::resolver(*m_io_service));
@@ -433,6 +1043,38 @@ protected:
             port = pu->get_port_str();
         }
         
+        // protocol dispatch: TCP resolves and connects over the network,
+        // the unix domain policy connects straight to a filesystem path
+        async_connect_impl(tcon,host,port,cb,protocol_tag<protocol_type>());
+    }
+    
+    /// Empty tag for overload dispatch on the socket policy's protocol
+    /**
+     * asio protocol classes are not default constructible, so overloads
+     * take this tag rather than a protocol value.
+     */
+    template <typename Protocol>
+    struct protocol_tag {};
+    
+    /// TCP connect path: resolver (with optional cache) then start_connect
+    void async_connect_impl(transport_con_ptr tcon, std::string const & host,
+        std::string const & port, connect_handler cb,
+        protocol_tag<boost::asio::ip::tcp>)
+    {
+        using namespace boost::asio::ip;
+        
+        if (m_dns_cache_ttl > 0) {
+            std::vector<tcp::endpoint> cached;
+            if (dns_cache_lookup(host+":"+port,cached)) {
+                if (m_alog->static_test(log::alevel::devel)) {
+                    m_alog->write(log::alevel::devel,
+                        "DNS cache hit for "+host+":"+port);
+                }
+                start_connect(tcon,cached,cb);
+                return;
+            }
+        }
+
         tcp::resolver::query query(host,port);
         
         if (m_alog->static_test(log::alevel::devel)) {
@@ -440,10 +1082,17 @@ protected:
                 "starting async DNS resolve for "+host+":"+port);
         }
         
+        long dns_budget = stage_budget(tcon,config::timeout_dns_resolve);
+        if (dns_budget < 0) {
+            cb(tcon->get_handle(),
+                make_error_code(error::budget_dns_resolve));
+            return;
+        }
+
         timer_ptr dns_timer;
         
         dns_timer = set_timer(
-            config::timeout_dns_resolve,
+            dns_budget,
             lib::bind(
                 &type::handle_resolve_timeout,
                 this,
@@ -461,6 +1110,7 @@ protected:
                 this,
                 tcon,
                 dns_timer,
+                host+":"+port,
                 cb,
                 lib::placeholders::_1,
                 lib::placeholders::_2
@@ -468,6 +1118,73 @@ protected:
         );
     }
     
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    /// Unix domain connect path: straight to the configured socket path
+    /// A stage's timer duration under the connect budget
+    /**
+     * Returns the smaller of the stage's configured timeout and the
+     * budget remaining on the connection; -1 when the budget is
+     * already spent (the caller fails fast with its stage's error).
+     */
+    long stage_budget(transport_con_ptr tcon, long stage_timeout) const {
+        long remaining = tcon->remaining_connect_budget();
+        if (remaining == 0) {
+            return stage_timeout;
+        }
+        if (remaining <= 1) {
+            return -1;
+        }
+        return (remaining < stage_timeout ? remaining : stage_timeout);
+    }
+
+    void async_connect_impl(transport_con_ptr tcon, std::string const &,
+        std::string const &, connect_handler cb,
+        protocol_tag<boost::asio::local::stream_protocol>)
+    {
+        if (m_socket_path.empty()) {
+            m_elog->write(log::elevel::library,
+                "local connect attempted without a socket path; "
+                "call set_socket_path first");
+            cb(tcon->get_handle(),make_error_code(error::pass_through));
+            return;
+        }
+        
+        long con_budget = stage_budget(tcon,config::timeout_connect);
+        if (con_budget < 0) {
+            callback(tcon->get_handle(),
+                make_error_code(error::budget_tcp_connect));
+            return;
+        }
+
+        timer_ptr con_timer;
+        
+        con_timer = set_timer(
+            con_budget,
+            lib::bind(
+                &type::handle_connect_timeout,
+                this,
+                tcon,
+                con_timer,
+                cb,
+                lib::placeholders::_1
+            )
+        );
+        
+        boost::asio::local::stream_protocol::endpoint ep(m_socket_path);
+        tcon->get_raw_socket().async_connect(
+            ep,
+            lib::bind(
+                &type::handle_connect,
+                this,
+                tcon,
+                con_timer,
+                cb,
+                lib::placeholders::_1
+            )
+        );
+    }
+#endif
+    
     void handle_resolve_timeout(transport_con_ptr tcon, timer_ptr dns_timer, 
         connect_handler callback, const lib::error_code & ec)
     {
@@ -492,7 +1209,8 @@ protected:
     }
     
     void handle_resolve(transport_con_ptr tcon, timer_ptr dns_timer,
-        connect_handler callback, const boost::system::error_code& ec, 
+        std::string key, connect_handler callback,
+        const boost::system::error_code& ec,
         boost::asio::ip::tcp::resolver::iterator iterator)
     {
         if (ec == boost::asio::error::operation_aborted ||
@@ -522,14 +1240,53 @@ protected:
             m_alog->write(log::alevel::devel,s.str());
         }
         
+        std::vector<boost::asio::ip::tcp::endpoint> eps;
+        boost::asio::ip::tcp::resolver::iterator it = iterator, end;
+        for (; it != end; ++it) {
+            eps.push_back((*it).endpoint());
+        }
+        
+        if (m_dns_cache_ttl > 0) {
+            dns_cache_store(key,eps);
+        }
+        
+        start_connect(tcon,eps,callback);
+    }
+    
+    /// Begin TCP connect attempts against a resolved endpoint list
+    void start_connect(transport_con_ptr tcon,
+        std::vector<boost::asio::ip::tcp::endpoint> const & eps,
+        connect_handler callback)
+    {
+        using namespace boost::asio::ip;
+        
+        if (eps.empty()) {
+            callback(tcon->get_handle(),make_error_code(error::pass_through));
+            return;
+        }
+        
         m_alog->write(log::alevel::devel,"Starting async connect");
         
+#ifdef BOOST_ASIO_HAS_MOVE
+        if (m_parallel_connect && eps.size() > 1) {
+            start_parallel_connect(tcon,eps,callback);
+            return;
+        }
+#endif
+        
+        long con_budget = stage_budget(tcon,config::timeout_connect);
+        if (con_budget < 0) {
+            callback(tcon->get_handle(),
+                make_error_code(error::budget_tcp_connect));
+            return;
+        }
+
         timer_ptr con_timer;
         
         con_timer = set_timer(
-            config::timeout_connect,
+            con_budget,
             lib::bind(
-                &type::handle_resolve_timeout,
+                &type::handle_connect_timeout,
                 this,
                 tcon,
                 con_timer,
@@ -538,13 +1295,20 @@ protected:
             )
         );
         
+        // The endpoint list is shared with the completion handler so the
+        // iterator range stays valid for the duration of the attempts.
+        lib::shared_ptr<std::vector<tcp::endpoint> > hold(
+            new std::vector<tcp::endpoint>(eps));
+        
         boost::asio::async_connect(
             tcon->get_raw_socket(),
-            iterator,
+            hold->begin(),
+            hold->end(),
             lib::bind(
-                &type::handle_connect,
+                &type::handle_connect_list,
                 this,
                 tcon,
+                hold,
                 con_timer,
                 callback,
                 lib::placeholders::_1
@@ -552,6 +1316,172 @@ protected:
         );
     }
     
+    /// Completion handler for range based async_connect
+    /**
+     * Holds a reference to the endpoint list backing the iterator range
+     * until the attempts finish, then defers to handle_connect.
+     */
+    void handle_connect_list(transport_con_ptr tcon,
+        lib::shared_ptr<std::vector<boost::asio::ip::tcp::endpoint> > hold,
+        timer_ptr con_timer, connect_handler callback,
+        const boost::system::error_code& ec)
+    {
+        hold.reset();
+        handle_connect(tcon,con_timer,callback,ec);
+    }
+    
+#ifdef BOOST_ASIO_HAS_MOVE
+    /// Shared state for one racing parallel connect attempt set
+    struct connect_race {
+        std::vector<lib::shared_ptr<boost::asio::ip::tcp::socket> > sockets;
+        size_t outstanding;
+        bool done;
+        lib::mutex lock;
+    };
+    typedef lib::shared_ptr<connect_race> race_ptr;
+    
+    /// Race connect attempts to every resolved endpoint at once
+    /**
+     * One scratch socket per endpoint, address families interleaved so
+     * neither family can starve the other of attempts. The first socket to
+     * establish is moved into the connection; every other socket is closed,
+     * which surfaces in its handler as operation_aborted.
+     */
+    void start_parallel_connect(transport_con_ptr tcon,
+        std::vector<boost::asio::ip::tcp::endpoint> const & eps,
+        connect_handler callback)
+    {
+        using namespace boost::asio::ip;
+        
+        // interleave: alternate the first endpoint's family with the other
+        std::vector<tcp::endpoint> a, b, order;
+        for (size_t i = 0; i < eps.size(); i++) {
+            (eps[i].protocol() == eps[0].protocol() ? a : b).push_back(eps[i]);
+        }
+        for (size_t i = 0; i < a.size() || i < b.size(); i++) {
+            if (i < a.size()) { order.push_back(a[i]); }
+            if (i < b.size()) { order.push_back(b[i]); }
+        }
+        
+        race_ptr race(new connect_race());
+        race->outstanding = order.size();
+        race->done = false;
+        
+        long con_budget = stage_budget(tcon,config::timeout_connect);
+        if (con_budget < 0) {
+            callback(tcon->get_handle(),
+                make_error_code(error::budget_tcp_connect));
+            return;
+        }
+
+        timer_ptr con_timer;
+        
+        con_timer = set_timer(
+            con_budget,
+            lib::bind(
+                &type::handle_race_timeout,
+                this,
+                tcon,
+                race,
+                callback,
+                lib::placeholders::_1
+            )
+        );
+        
+        for (size_t i = 0; i < order.size(); i++) {
+            race->sockets.push_back(lib::shared_ptr<tcp::socket>(
+                new tcp::socket(*m_io_service)));
+        }
+        for (size_t i = 0; i < order.size(); i++) {
+            race->sockets[i]->async_connect(
+                order[i],
+                lib::bind(
+                    &type::handle_race_connect,
+                    this,
+                    tcon,
+                    race,
+                    i,
+                    con_timer,
+                    callback,
+                    lib::placeholders::_1
+                )
+            );
+        }
+    }
+    
+    void handle_race_timeout(transport_con_ptr tcon, race_ptr race,
+        connect_handler callback, const lib::error_code & ec)
+    {
+        if (ec == transport::error::operation_aborted) {
+            m_alog->write(log::alevel::devel,
+                "asio handle_race_timeout timer cancelled");
+            return;
+        }
+        
+        {
+            lib::lock_guard<lib::mutex> guard(race->lock);
+            if (race->done) {
+                return;
+            }
+            race->done = true;
+            for (size_t i = 0; i < race->sockets.size(); i++) {
+                boost::system::error_code cec;
+                race->sockets[i]->close(cec);
+            }
+        }
+        
+        m_alog->write(log::alevel::devel,"TCP connect timed out");
+        callback(tcon->get_handle(),
+            ec ? ec : make_error_code(transport::error::timeout));
+    }
+    
+    void handle_race_connect(transport_con_ptr tcon, race_ptr race,
+        size_t index, timer_ptr con_timer, connect_handler callback,
+        const boost::system::error_code& ec)
+    {
+        bool won = false;
+        bool exhausted = false;
+        
+        {
+            lib::lock_guard<lib::mutex> guard(race->lock);
+            if (race->done) {
+                // a sibling won or the race timed out; discard this socket
+                boost::system::error_code cec;
+                race->sockets[index]->close(cec);
+                return;
+            }
+            if (!ec) {
+                race->done = true;
+                won = true;
+                tcon->get_raw_socket() = std::move(*race->sockets[index]);
+                for (size_t i = 0; i < race->sockets.size(); i++) {
+                    if (i != index) {
+                        boost::system::error_code cec;
+                        race->sockets[i]->close(cec);
+                    }
+                }
+            } else if (--race->outstanding == 0) {
+                race->done = true;
+                exhausted = true;
+            }
+        }
+        
+        if (won) {
+            con_timer->cancel();
+            if (m_alog->static_test(log::alevel::devel)) {
+                m_alog->write(log::alevel::devel,
+                    "Parallel connect to "+tcon->get_remote_endpoint()+
+                    " successful.");
+            }
+            callback(tcon->get_handle(),lib::error_code());
+        } else if (exhausted) {
+            con_timer->cancel();
+            log_err(log::elevel::info,"asio parallel connect",ec);
+            callback(tcon->get_handle(),make_error_code(error::pass_through));
+        }
+    }
+#endif // BOOST_ASIO_HAS_MOVE
+    
     void handle_connect_timeout(transport_con_ptr tcon, timer_ptr con_timer, 
         connect_handler callback, const lib::error_code & ec)
     {
@@ -601,6 +1531,50 @@ protected:
         callback(tcon->get_handle(),lib::error_code());
     }
     
+    /// A cached resolver result and the time it stops being trustworthy
+    struct dns_cache_entry {
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+        boost::posix_time::ptime expires;
+    };
+    
+    /// Look up a fresh cached resolution, erasing it if expired
+    bool dns_cache_lookup(std::string const & key,
+        std::vector<boost::asio::ip::tcp::endpoint> & out)
+    {
+        lib::lock_guard<lib::mutex> guard(m_dns_cache_lock);
+        typename std::map<std::string,dns_cache_entry>::iterator it
+            = m_dns_cache.find(key);
+        if (it == m_dns_cache.end()) {
+            return false;
+        }
+        if (boost::posix_time::microsec_clock::universal_time()
+            > it->second.expires)
+        {
+            m_dns_cache.erase(it);
+            return false;
+        }
+        out = it->second.endpoints;
+        return true;
+    }
+    
+    /// Remember a resolver result for m_dns_cache_ttl milliseconds
+    void dns_cache_store(std::string const & key,
+        std::vector<boost::asio::ip::tcp::endpoint> const & eps)
+    {
+        dns_cache_entry e;
+        e.endpoints = eps;
+        e.expires = boost::posix_time::microsec_clock::universal_time()
+            + boost::posix_time::milliseconds(m_dns_cache_ttl);
+        lib::lock_guard<lib::mutex> guard(m_dns_cache_lock);
+        // expired entries are only reaped on lookup, so bound the map to
+        // keep a client that contacts many distinct hosts from growing it
+        // without limit
+        if (m_dns_cache.size() >= 1024) {
+            m_dns_cache.clear();
+        }
+        m_dns_cache[key] = e;
+    }
+    
     bool is_listening() const {
         return (m_state == LISTENING);
     }
@@ -624,15 +1598,117 @@ protected:
             transport_con_type>(tcon));
         
         lib::error_code ec;
+        io_service_ptr target_io_service = m_io_service;
         
-        ec = tcon->init_asio(m_io_service);
+        if (m_shard_io_services.size() > 1) {
+            // Each shard has one accept slot. A new connection claims the
+            // first free slot, which (because the slot is released when the
+            // previous accept on that shard completes) keeps exactly one
+            // accept outstanding per SO_REUSEPORT listener -- essential, as
+            // the kernel pins each incoming connection to one listener.
+            // Connections beyond the slot count fall back to round robin.
+            size_t shard = 0;
+            bool claimed = false;
+            // accept slots only apply to listening (server) endpoints;
+            // outbound client connections place purely by load
+            if (m_state == LISTENING) {
+            // among free slots, prefer the least loaded shard (with a
+            // shared pool the loads span every attached endpoint); for
+            // inbound connections the kernel still hashes across the
+            // armed SO_REUSEPORT listeners, but outbound placement and
+            // arming order both steer toward idle shards
+            while (!claimed) {
+                size_t best = m_shard_slots.size();
+                size_t best_count = 0;
+                for (size_t i = 0; i < m_shard_slots.size(); i++) {
+                    if (m_shard_slots[i]->load(lib::memory_order_relaxed)
+                        != 0)
+                    {
+                        continue;
+                    }
+                    size_t count = m_shard_loads[i]->connections.load(
+                        lib::memory_order_relaxed);
+                    if (best == m_shard_slots.size()
+                        || count < best_count)
+                    {
+                        best = i;
+                        best_count = count;
+                    }
+                }
+                if (best == m_shard_slots.size()) {
+                    break;
+                }
+                int expected = 0;
+                if (m_shard_slots[best]->compare_exchange_strong(
+                    expected,1))
+                {
+                    shard = best;
+                    claimed = true;
+                }
+                // lost the race for that slot; rescan
+            }
+            }
+            if (!claimed) {
+                // least loaded by live connection count; round robin (the
+                // old behavior) pins hot connections wherever the cursor
+                // happened to be
+                size_t best = 0;
+                size_t best_count = m_shard_loads[0]->connections.load(
+                    lib::memory_order_relaxed);
+                for (size_t i = 1; i < m_shard_loads.size(); i++) {
+                    size_t count = m_shard_loads[i]->connections.load(
+                        lib::memory_order_relaxed);
+                    if (count < best_count) {
+                        best = i;
+                        best_count = count;
+                    }
+                }
+                shard = best;
+            }
+            m_shard_loads[shard]->connections.fetch_add(1,
+                lib::memory_order_relaxed);
+            tcon->set_shard_load(m_shard_loads[shard]);
+            tcon->set_shard(shard);
+            target_io_service = m_shard_io_services[shard];
+            ec = tcon->init_asio(target_io_service);
+        } else {
+            ec = tcon->init_asio(m_io_service);
+        }
         if (ec) {return ec;}
+
+        if (m_wheel_enabled) {
+            tcon->set_timer_wheel(get_timer_wheel(target_io_service));
+        }
+        if (m_speculative_writes) {
+            tcon->set_speculative_writes(true);
+        }
+        if (m_drain_reads) {
+            tcon->set_drain_reads(true,m_drain_max_inline);
+        }
         
         tcon->set_tcp_init_handler(m_tcp_init_handler);
         
         return lib::error_code();
     }
 private:
+    /// Get (lazily creating) the timing wheel for an io_service
+    /**
+     * Locked: init(tcon) runs concurrently on shard threads in sharded
+     * accept mode.
+     */
+    timer_wheel::ptr get_timer_wheel(io_service_ptr ios) {
+        lib::lock_guard<lib::mutex> lock(m_timer_wheel_lock);
+        std::map<void *,timer_wheel::ptr>::iterator it =
+            m_timer_wheels.find(ios);
+        if (it != m_timer_wheels.end()) {
+            return it->second;
+        }
+        timer_wheel::ptr wheel(new timer_wheel(*ios,m_wheel_tick_ms,
+            m_wheel_slots));
+        m_timer_wheels[ios] = wheel;
+        return wheel;
+    }
+
     /// Convenience method for logging the code and message for an error_code
     template <typename error_type>
     void log_err(log::level l,const char * msg, const error_type & ec) {
@@ -655,6 +1731,166 @@ private:
     bool                m_external_io_service;
     acceptor_ptr        m_acceptor;
     resolver_ptr        m_resolver;
+
+    // sharded accept mode state; empty when not sharded. Element 0 aliases
+    // m_io_service/m_acceptor.
+    std::vector<io_service_ptr> m_shard_io_services;
+    std::vector<acceptor_ptr>   m_shard_acceptors;
+    std::vector<lib::shared_ptr<lib::atomic<int> > > m_shard_slots;
+    std::vector<typename transport_con_type::shard_load::ptr> m_shard_loads;
+    /// Keeps a shared shard pool alive; empty for private shards
+    shard_pool::ptr m_shard_pool;
+
+    bool m_speculative_writes;
+    bool m_drain_reads;
+    size_t m_drain_max_inline;
+    /// Round robin cursor for sharded poll_one
+    size_t m_poll_cursor;
+    /// Total connect budget for clients; 0 disabled
+    long m_connect_budget_ms;
+    /// Pool thread lifecycle hooks and identity options
+    thread_hook m_thread_start_hook;
+    thread_hook m_thread_stop_hook;
+    std::string m_thread_name_prefix;
+    std::vector<int> m_thread_cpus;
+
+#if defined(__linux__)
+    /// Parse /sys node cpulists into per-node cpu id vectors
+    static std::vector<std::vector<int> > read_numa_topology() {
+        std::vector<std::vector<int> > nodes;
+        for (int n = 0; n < 64; n++) {
+            char path[64];
+            std::sprintf(path,
+                "/sys/devices/system/node/node%d/cpulist",n);
+            std::FILE * f = std::fopen(path,"r");
+            if (!f) {
+                break;
+            }
+            char line[256];
+            std::vector<int> cpus;
+            if (std::fgets(line,sizeof(line),f)) {
+                // cpulist format: comma separated ids and ranges (0-3,8)
+                char * p = line;
+                while (*p && *p != '\n') {
+                    int lo = (int)std::strtol(p,&p,10);
+                    int hi = lo;
+                    if (*p == '-') {
+                        hi = (int)std::strtol(p+1,&p,10);
+                    }
+                    for (int c = lo; c <= hi; c++) {
+                        cpus.push_back(c);
+                    }
+                    if (*p == ',') {
+                        p++;
+                    }
+                }
+            }
+            std::fclose(f);
+            nodes.push_back(cpus);
+        }
+        return nodes;
+    }
+
+    /// Body of one NUMA pool thread: pin to the node's cpuset, run the
+    /// shard
+    void run_numa_thread(std::size_t shard, std::vector<int> cpus) {
+        if (!m_thread_name_prefix.empty()) {
+            char name[16];
+            std::snprintf(name,sizeof(name),"%s%u",
+                m_thread_name_prefix.c_str(),
+                static_cast<unsigned>(shard));
+            pthread_setname_np(pthread_self(),name);
+        }
+        if (!cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (std::size_t i = 0; i < cpus.size(); i++) {
+                if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+                    CPU_SET(cpus[i],&set);
+                }
+            }
+            pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+        }
+        if (m_thread_start_hook) {
+            m_thread_start_hook(shard);
+        }
+        if (m_shard_io_services.empty()) {
+            m_io_service->run();
+        } else {
+            m_shard_io_services[shard]->run();
+        }
+        if (m_thread_stop_hook) {
+            m_thread_stop_hook(shard);
+        }
+    }
+#endif
+
+    /// Body of one run_pool thread: naming, pinning, hooks, reactor
+    void run_pool_thread(std::size_t shard, std::size_t index,
+        bool pin_cpus)
+    {
+        apply_thread_identity(shard,index,pin_cpus);
+        if (m_thread_start_hook) {
+            m_thread_start_hook(shard);
+        }
+        if (m_shard_io_services.empty()) {
+            m_io_service->run();
+        } else {
+            m_shard_io_services[shard]->run();
+        }
+        if (m_thread_stop_hook) {
+            m_thread_stop_hook(shard);
+        }
+    }
+
+    /// Apply the configured name and affinity to the calling thread
+    void apply_thread_identity(std::size_t shard, std::size_t index,
+        bool pin_cpus)
+    {
+#if defined(__linux__)
+        if (!m_thread_name_prefix.empty()) {
+            char name[16];
+            std::snprintf(name,sizeof(name),"%s%u",
+                m_thread_name_prefix.c_str(),
+                static_cast<unsigned>(shard));
+            pthread_setname_np(pthread_self(),name);
+        }
+        if (!m_thread_cpus.empty()) {
+            int cpu = m_thread_cpus[shard % m_thread_cpus.size()];
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu,&set);
+                pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+            }
+        } else if (pin_cpus) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index % CPU_SETSIZE,&set);
+            pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+        }
+#else
+        (void)shard;
+        (void)index;
+        (void)pin_cpus;
+#endif
+    }
+
+    // unix domain connect target; only used by the local_socket policy
+    std::string m_socket_path;
+
+    // client side resolver cache; only touched when m_dns_cache_ttl > 0
+    long m_dns_cache_ttl;
+    std::map<std::string,dns_cache_entry> m_dns_cache;
+    lib::mutex m_dns_cache_lock;
+    bool m_parallel_connect;
+
+    // timing wheel state; wheels are created lazily per io_service
+    bool m_wheel_enabled;
+    long m_wheel_tick_ms;
+    size_t m_wheel_slots;
+    std::map<void *,timer_wheel::ptr> m_timer_wheels;
+    lib::mutex m_timer_wheel_lock;
     
     elog_type* m_elog;
     alog_type* m_alog;
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_HANDLER_ALLOCATOR_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_HANDLER_ALLOCATOR_HPP
+
+#include <cstddef>
+
+#ifdef _WEBSOCKETPP_CPP11_STL_
+    #include <type_traits>
+    #include <utility>
+#endif
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// Recycling storage for asio completion handler allocations
+/**
+ * Implements the classic asio custom handler allocation pattern. Each
+ * allocator owns a single fixed block of storage big enough for the
+ * temporary allocation asio performs per asynchronous operation. As long as
+ * only one operation using the allocator is outstanding at a time (which
+ * the library guarantees separately for reads and for writes) steady state
+ * operations perform no heap allocations; oversized or concurrent requests
+ * fall back to the global heap.
+ */
+class handler_allocator {
+public:
+    handler_allocator() : m_in_use(false) {}
+
+    void * allocate(std::size_t size) {
+        if (!m_in_use && size < sizeof(m_storage)) {
+            m_in_use = true;
+            return &m_storage;
+        } else {
+            return ::operator new(size);
+        }
+    }
+
+    void deallocate(void * pointer) {
+        if (pointer == &m_storage) {
+            m_in_use = false;
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+private:
+    // non-copyable
+    handler_allocator(handler_allocator const &);
+    handler_allocator & operator=(handler_allocator const &);
+
+    /// Correctly aligned storage for a completion handler plus asio's
+    /// per-operation bookkeeping
+    union {
+        double for_alignment;
+        long double for_alignment2;
+        void * for_alignment3;
+        char bytes[1024];
+    } m_storage;
+    bool m_in_use;
+};
+
+/// Wrapper that associates a handler with a recycling allocator
+/**
+ * Hooks both allocation protocols: the asio_handler_allocate /
+ * asio_handler_deallocate free function hooks used by older asio, and the
+ * nested allocator_type / get_allocator members used by the C++11
+ * associated allocator protocol.
+ */
+template <typename Handler>
+class custom_alloc_handler {
+public:
+    /// Minimal std allocator backed by a handler_allocator
+    template <typename T>
+    struct rebound_allocator {
+        typedef T value_type;
+
+        /// Rebind support for pre-C++11 allocator use
+        template <typename U>
+        struct rebind {
+            typedef rebound_allocator<U> other;
+        };
+
+        explicit rebound_allocator(handler_allocator * a) : raw(a) {}
+
+        template <typename U>
+        rebound_allocator(rebound_allocator<U> const & other)
+          : raw(other.raw) {}
+
+        T * allocate(std::size_t n) {
+            return static_cast<T *>(raw->allocate(n*sizeof(T)));
+        }
+
+        void deallocate(T * p, std::size_t) {
+            raw->deallocate(p);
+        }
+
+        template <typename U>
+        bool operator==(rebound_allocator<U> const & other) const {
+            return raw == other.raw;
+        }
+
+        template <typename U>
+        bool operator!=(rebound_allocator<U> const & other) const {
+            return raw != other.raw;
+        }
+
+        handler_allocator * raw;
+    };
+
+    typedef rebound_allocator<char> allocator_type;
+
+    custom_alloc_handler(handler_allocator & a, Handler const & h)
+      : m_allocator(&a)
+      , m_handler(h)
+    {}
+
+#ifdef _WEBSOCKETPP_CPP11_STL_
+    /// Move the handler in rather than copying it; handlers wrap
+    /// lib::function objects whose copies allocate.
+    custom_alloc_handler(handler_allocator & a, Handler && h)
+      : m_allocator(&a)
+      , m_handler(std::move(h))
+    {}
+
+    custom_alloc_handler(custom_alloc_handler const &) = default;
+    custom_alloc_handler(custom_alloc_handler &&) = default;
+#endif
+
+    allocator_type get_allocator() const {
+        return allocator_type(m_allocator);
+    }
+
+    template <typename Arg1>
+    void operator()(Arg1 const & arg1) {
+        m_handler(arg1);
+    }
+
+    template <typename Arg1, typename Arg2>
+    void operator()(Arg1 const & arg1, Arg2 const & arg2) {
+        m_handler(arg1,arg2);
+    }
+
+    friend void * asio_handler_allocate(std::size_t size,
+        custom_alloc_handler<Handler> * this_handler)
+    {
+        return this_handler->m_allocator->allocate(size);
+    }
+
+    friend void asio_handler_deallocate(void * pointer, std::size_t,
+        custom_alloc_handler<Handler> * this_handler)
+    {
+        this_handler->m_allocator->deallocate(pointer);
+    }
+
+private:
+    handler_allocator * m_allocator;
+    Handler m_handler;
+};
+
+/// Helper to deduce the handler type for custom_alloc_handler
+#ifdef _WEBSOCKETPP_CPP11_STL_
+template <typename Handler>
+inline custom_alloc_handler<typename std::decay<Handler>::type>
+make_custom_alloc_handler(handler_allocator & a, Handler && h)
+{
+    return custom_alloc_handler<typename std::decay<Handler>::type>(
+        a,std::forward<Handler>(h));
+}
+#else
+template <typename Handler>
+inline custom_alloc_handler<Handler> make_custom_alloc_handler(
+    handler_allocator & a, Handler const & h)
+{
+    return custom_alloc_handler<Handler>(a,h);
+}
+#endif
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_HANDLER_ALLOCATOR_HPP
@@ -36,6 +36,12 @@
 
 #include <boost/asio.hpp>
 
+#ifdef __linux__
+    #include <netinet/in.h>
+    #include <netinet/ip.h>
+    #include <netinet/tcp.h>
+#endif
+
 #include <iostream>
 #include <string>
 
@@ -70,6 +76,131 @@ namespace socket {
  * policies and support code for the ASIO transport types.
  */
 
+/// TCP socket tuning options applied before the handshake
+/**
+ * A deployment-tunable bundle of socket options that the socket
+ * component applies to the raw TCP socket during pre_init, before any
+ * user socket_init_handler runs (the handler can still override any of
+ * them). Options left at their defaults are not touched, so kernel
+ * autotuning stays in effect unless explicitly overridden.
+ *
+ * When autotune_send_buffer is set, the transport additionally grows
+ * SO_SNDBUF geometrically -- up to send_buffer_max -- whenever the
+ * connection's buffered amount (bytes queued behind the socket) exceeds
+ * the current buffer size, so a connection that falls behind widens its
+ * kernel pipe instead of stalling the writer.
+ */
+struct socket_options {
+    socket_options()
+      : nodelay(true)
+      , quickack(false)
+      , send_buffer_size(0)
+      , receive_buffer_size(0)
+      , tos(-1)
+      , autotune_send_buffer(false)
+      , send_buffer_max(4194304) {}
+
+    /// Disable Nagle's algorithm (TCP_NODELAY); on by default as latency
+    /// is almost always the constraint for WebSocket workloads
+    bool nodelay;
+    /// Request immediate ACKs (TCP_QUICKACK, Linux only; ignored
+    /// elsewhere)
+    bool quickack;
+    /// SO_SNDBUF in bytes; 0 leaves the kernel default
+    int send_buffer_size;
+    /// SO_RCVBUF in bytes; 0 leaves the kernel default
+    int receive_buffer_size;
+    /// IP_TOS byte (e.g. DSCP marking); -1 leaves the kernel default
+    int tos;
+    /// Grow SO_SNDBUF on demand from the buffered-amount signal
+    bool autotune_send_buffer;
+    /// Upper bound for autotuned SO_SNDBUF growth, in bytes
+    int send_buffer_max;
+};
+
+namespace detail {
+
+/// Apply a socket_options bundle to an open TCP socket
+/**
+ * Shared by the plain and TLS socket components. Errors applying
+ * individual options are deliberately swallowed: these are performance
+ * hints, and a socket that cannot honor one (e.g. TOS inside an
+ * unprivileged container) should still connect.
+ */
+template <typename socket_type>
+void apply_socket_options(socket_type & s, socket_options const & opts) {
+    boost::system::error_code ec;
+
+    if (opts.nodelay) {
+        s.set_option(boost::asio::ip::tcp::no_delay(true),ec);
+    }
+    if (opts.send_buffer_size > 0) {
+        s.set_option(boost::asio::socket_base::send_buffer_size(
+            opts.send_buffer_size),ec);
+    }
+    if (opts.receive_buffer_size > 0) {
+        s.set_option(boost::asio::socket_base::receive_buffer_size(
+            opts.receive_buffer_size),ec);
+    }
+#ifdef __linux__
+    if (opts.quickack) {
+        int one = 1;
+        setsockopt(s.native_handle(),IPPROTO_TCP,TCP_QUICKACK,
+            &one,sizeof(one));
+    }
+    if (opts.tos >= 0) {
+        int tos = opts.tos;
+        setsockopt(s.native_handle(),IPPROTO_IP,IP_TOS,
+            &tos,sizeof(tos));
+    }
+#endif
+}
+
+/// One autotune step: widen SO_SNDBUF when the writer has fallen behind
+/**
+ * Called from the write path with the current buffered amount. Doubles
+ * the send buffer (starting from the kernel's reported size) while the
+ * backlog exceeds it, clamped to send_buffer_max. current_size caches
+ * the last applied value so the getsockopt round trip happens once.
+ */
+template <typename socket_type>
+void autotune_send_buffer_step(socket_type & s, socket_options const & opts,
+    size_t buffered, int & current_size)
+{
+    if (!opts.autotune_send_buffer) {
+        return;
+    }
+    boost::system::error_code ec;
+    if (current_size == 0) {
+        boost::asio::socket_base::send_buffer_size cur;
+        s.get_option(cur,ec);
+        if (ec) {
+            return;
+        }
+        current_size = cur.value();
+    }
+    if (buffered <= static_cast<size_t>(current_size)
+        || current_size >= opts.send_buffer_max)
+    {
+        return;
+    }
+    int target = current_size;
+    while (static_cast<size_t>(target) < buffered
+        && target < opts.send_buffer_max)
+    {
+        target *= 2;
+    }
+    if (target > opts.send_buffer_max) {
+        target = opts.send_buffer_max;
+    }
+    s.set_option(boost::asio::socket_base::send_buffer_size(target),ec);
+    if (!ec) {
+        current_size = target;
+    }
+}
+
+} // namespace detail
+
 /// Errors related to asio transport sockets
 namespace error {
     enum value {
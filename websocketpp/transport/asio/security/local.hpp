@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_SECURITY_LOCAL_HPP
+#define WEBSOCKETPP_TRANSPORT_SECURITY_LOCAL_HPP
+
+#include <websocketpp/transport/asio/security/base.hpp>
+
+#include <boost/asio.hpp>
+
+#include <sstream>
+#include <string>
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// Unix domain socket policy for the asio transport
+/**
+ * transport::asio::local_socket mirrors basic_socket but runs over
+ * asio::local::stream_protocol, for same host hops that should not pay
+ * loopback TCP's checksum and conntrack overhead. Substitute
+ * local_socket::endpoint for basic_socket::endpoint in a config's
+ * transport_config; servers listen on a stream_protocol::endpoint
+ * (a filesystem path) and clients connect to the path given to the
+ * transport endpoint's set_socket_path.
+ *
+ * Only available when asio exposes local sockets
+ * (BOOST_ASIO_HAS_LOCAL_SOCKETS, i.e. POSIX platforms).
+ */
+namespace local_socket {
+
+typedef lib::function<void(connection_hdl,
+    boost::asio::local::stream_protocol::socket&)> socket_init_handler;
+
+/// Unix domain connection socket component
+class connection {
+public:
+    /// Type of this connection socket component
+    typedef connection type;
+    /// Type of a shared pointer to this connection socket component
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the ASIO protocol in use
+    typedef boost::asio::local::stream_protocol protocol_type;
+    /// Type of a pointer to the ASIO io_service being used
+    typedef boost::asio::io_service* io_service_ptr;
+    /// Type of a shared pointer to the socket being used.
+    typedef lib::shared_ptr<protocol_type::socket> socket_ptr;
+
+    explicit connection() : m_state(UNINITIALIZED) {}
+
+    /// Check whether or not this connection is secure
+    /**
+     * Unix domain sockets never cross a host boundary but carry no
+     * transport encryption; they report insecure like basic_socket.
+     */
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Set the socket initialization handler
+    /**
+     * The socket initialization handler is called after the socket object is
+     * created but before it is used. This gives the application a chance to
+     * set any ASIO socket options it needs.
+     *
+     * @param h The new socket_init_handler
+     */
+    void set_socket_init_handler(socket_init_handler h) {
+        m_socket_init_handler = h;
+    }
+
+    /// Retrieve a pointer to the underlying socket
+    /**
+     * This is used internally. It can also be used to set socket options, etc
+     */
+    protocol_type::socket & get_socket() {
+        return *m_socket;
+    }
+
+    /// Retrieve a pointer to the underlying socket
+    /**
+     * This is used internally.
+     */
+    protocol_type::socket & get_next_layer() {
+        return *m_socket;
+    }
+
+    /// Retrieve a pointer to the underlying socket
+    /**
+     * This is used internally. It can also be used to set socket options, etc
+     */
+    protocol_type::socket & get_raw_socket() {
+        return *m_socket;
+    }
+
+    /// Get the remote endpoint address
+    /**
+     * Unix domain peers connect anonymously, so unlike TCP there is often
+     * no path to report; a placeholder is returned in that case.
+     *
+     * @return A string identifying the address of the remote endpoint
+     */
+    std::string get_remote_endpoint(lib::error_code &ec) const {
+        boost::system::error_code bec;
+        protocol_type::endpoint ep = m_socket->remote_endpoint(bec);
+
+        if (bec) {
+            ec = error::make_error_code(error::pass_through);
+            std::stringstream s;
+            s << "Error getting remote endpoint: " << bec
+              << " (" << bec.message() << ")";
+            return s.str();
+        }
+        ec = lib::error_code();
+        std::string path = ep.path();
+        return (path.empty() ? std::string("unix domain socket") : path);
+    }
+protected:
+    /// Perform one time initializations
+    /**
+     * init_asio is called once immediately after construction to initialize
+     * boost::asio components to the io_service
+     *
+     * @param service A pointer to the endpoint's io_service
+     * @param is_server Whether or not the endpoint is a server or not.
+     */
+    lib::error_code init_asio (io_service_ptr service, bool is_server) {
+        if (m_state != UNINITIALIZED) {
+            return socket::make_error_code(socket::error::invalid_state);
+        }
+
+        m_socket.reset(new protocol_type::socket(*service));
+
+        m_state = READY;
+
+        return lib::error_code();
+    }
+
+    /// Return the socket component to its freshly constructed state
+    /**
+     * Used by connection pooling; init_asio will build a fresh socket on
+     * the next session.
+     */
+    void reset_for_reuse() {
+        m_socket.reset();
+        m_state = UNINITIALIZED;
+    }
+
+    /// Pre-initialize security policy
+    /**
+     * Called by the transport after a new connection is created to initialize
+     * the socket component of the connection. This method is not allowed to
+     * write any bytes to the wire.
+     *
+     * @param callback Handler to call back with completion information
+     */
+    /// Socket options do not apply to local sockets; accepted for
+    /// interface parity and ignored
+    void set_socket_options(socket::socket_options const &) {}
+
+    /// Buffered-amount hint; no TCP send buffer to autotune here
+    void hint_buffered_amount(size_t) {}
+
+    void pre_init(init_handler callback) {
+        if (m_state != READY) {
+            callback(socket::make_error_code(socket::error::invalid_state));
+            return;
+        }
+
+        if (m_socket_init_handler) {
+            m_socket_init_handler(m_hdl,*m_socket);
+        }
+
+        m_state = READING;
+
+        callback(lib::error_code());
+    }
+
+    /// Post-initialize security policy
+    /**
+     * @param callback Handler to call back with completion information
+     */
+    void post_init(init_handler callback) {
+        callback(lib::error_code());
+    }
+
+    /// Sets the connection handle
+    /**
+     * The connection handle is passed to any handlers to identify the
+     * connection
+     *
+     * @param hdl The new handle
+     */
+    void set_handle(connection_hdl hdl) {
+        m_hdl = hdl;
+    }
+
+    /// Cancel all async operations on this socket
+    void cancel_socket() {
+        m_socket->cancel();
+    }
+
+    void async_shutdown(socket_shutdown_handler h) {
+        boost::system::error_code ec;
+        m_socket->shutdown(protocol_type::socket::shutdown_both,ec);
+        h(ec);
+    }
+
+    lib::error_code get_ec() const {
+        return lib::error_code();
+    }
+private:
+    enum state {
+        UNINITIALIZED = 0,
+        READY = 1,
+        READING = 2
+    };
+
+    socket_ptr          m_socket;
+    state               m_state;
+
+    connection_hdl      m_hdl;
+    socket_init_handler m_socket_init_handler;
+};
+
+/// Unix domain endpoint socket component
+class endpoint {
+public:
+    /// The type of this endpoint socket component
+    typedef endpoint type;
+
+    /// Type of the ASIO protocol in use
+    typedef boost::asio::local::stream_protocol protocol_type;
+    /// The type of the corresponding connection socket component
+    typedef connection socket_con_type;
+    /// The type of a shared pointer to the corresponding connection socket
+    /// component.
+    typedef socket_con_type::ptr socket_con_ptr;
+
+    explicit endpoint() {}
+
+    /// Checks whether the endpoint creates secure connections
+    /**
+     * @return Whether or not the endpoint creates secure connections
+     */
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Set socket init handler
+    /**
+     * The socket init handler is called after a connection's socket is
+     * created but before it is used. This gives the end application an
+     * opportunity to set asio socket specific parameters.
+     *
+     * @param h The new socket_init_handler
+     */
+    void set_socket_init_handler(socket_init_handler h) {
+        m_socket_init_handler = h;
+    }
+
+    /// Socket options do not apply to local sockets; accepted for
+    /// interface parity and ignored
+    void set_socket_options(socket::socket_options const &) {}
+protected:
+    /// Initialize a connection
+    /**
+     * Called by the transport after a new connection is created to initialize
+     * the socket component of the connection.
+     *
+     * @param scon Pointer to the socket component of the connection
+     *
+     * @return Error code (empty on success)
+     */
+    lib::error_code init(socket_con_ptr scon) {
+        scon->set_socket_init_handler(m_socket_init_handler);
+        return lib::error_code();
+    }
+
+private:
+    socket_init_handler m_socket_init_handler;
+};
+
+} // namespace local_socket
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+#endif // WEBSOCKETPP_TRANSPORT_SECURITY_LOCAL_HPP
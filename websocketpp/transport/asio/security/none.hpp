@@ -30,7 +30,9 @@
 
 #include <websocketpp/transport/asio/security/base.hpp>
 
+#include <boost/aligned_storage.hpp>
 #include <boost/asio.hpp>
+#include <boost/type_traits/alignment_of.hpp>
 
 #include <iostream>
 #include <string>
@@ -55,15 +57,23 @@ public:
     /// Type of a shared pointer to this connection socket component
     typedef lib::shared_ptr<type> ptr;
 
+    /// Type of the ASIO protocol in use
+    typedef boost::asio::ip::tcp protocol_type;
     /// Type of a pointer to the ASIO io_service being used
     typedef boost::asio::io_service* io_service_ptr;
     /// Type of a shared pointer to the socket being used.
     typedef lib::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr;
     
-    explicit connection() : m_state(UNINITIALIZED) {
+    explicit connection() : m_socket(0), m_state(UNINITIALIZED),
+        m_sndbuf_size(0)
+    {
         //std::cout << "transport::asio::basic_socket::connection constructor" 
         //          << std::endl; 
     }
+
+    ~connection() {
+        destroy_socket();
+    }
     
     /// Check whether or not this connection is secure
     /**
@@ -85,6 +95,20 @@ public:
         m_socket_init_handler = h;
     }
 
+    /// Set the TCP tuning options to apply during pre_init
+    void set_socket_options(socket::socket_options const & opts) {
+        m_socket_options = opts;
+        m_sndbuf_size = 0;
+    }
+
+    /// Buffered-amount hint from the write path, drives SO_SNDBUF autotune
+    void hint_buffered_amount(size_t buffered) {
+        if (m_socket && m_socket_options.autotune_send_buffer) {
+            socket::detail::autotune_send_buffer_step(
+                *m_socket,m_socket_options,buffered,m_sndbuf_size);
+        }
+    }
+
     /// Retrieve a pointer to the underlying socket
     /**
      * This is used internally. It can also be used to set socket options, etc
@@ -151,13 +175,24 @@ protected:
             return socket::make_error_code(socket::error::invalid_state);
         }
         
-        m_socket.reset(new boost::asio::ip::tcp::socket(*service));
+        m_socket = new (&m_socket_storage)
+            boost::asio::ip::tcp::socket(*service);
         
         m_state = READY;
         
         return lib::error_code();
     }
     
+    /// Return the socket component to its freshly constructed state
+    /**
+     * Used by connection pooling; init_asio will build a fresh socket on
+     * the next session.
+     */
+    void reset_for_reuse() {
+        destroy_socket();
+        m_state = UNINITIALIZED;
+    }
+
     /// Pre-initialize security policy
     /**
      * Called by the transport after a new connection is created to initialize
@@ -173,6 +208,8 @@ protected:
             return;
         }
         
+        socket::detail::apply_socket_options(*m_socket,m_socket_options);
+
         if (m_socket_init_handler) {
             m_socket_init_handler(m_hdl,*m_socket);
         }
@@ -226,11 +263,31 @@ private:
         READING = 2
     };
     
-    socket_ptr          m_socket;
+    /// Destroy the placement-constructed socket, if any
+    void destroy_socket() {
+        if (m_socket) {
+            m_socket->~basic_stream_socket();
+            m_socket = 0;
+        }
+    }
+
+    /// The plain socket lives inline in the connection object: one less
+    /// pointer chase on every read/write issue and completion, which is
+    /// the whole indirection budget of the non-TLS fast path (the
+    /// security policy itself is already collapsed at compile time).
+    /// Placement-constructed by init_asio because the socket needs the
+    /// io_service; destroyed explicitly on reuse/destruction.
+    boost::asio::ip::tcp::socket * m_socket;
+    boost::aligned_storage<
+        sizeof(boost::asio::ip::tcp::socket),
+        boost::alignment_of<boost::asio::ip::tcp::socket>::value
+    >::type m_socket_storage;
     state               m_state;
         
     connection_hdl      m_hdl;
     socket_init_handler m_socket_init_handler;
+    socket::socket_options m_socket_options;
+    int m_sndbuf_size;
 };
 
 /// Basic ASIO endpoint socket component
@@ -243,6 +300,8 @@ public:
     /// The type of this endpoint socket component
     typedef endpoint type;
     
+    /// Type of the ASIO protocol in use
+    typedef boost::asio::ip::tcp protocol_type;
     /// The type of the corresponding connection socket component
     typedef connection socket_con_type;
     /// The type of a shared pointer to the corresponding connection socket
@@ -270,6 +329,16 @@ public:
     void set_socket_init_handler(socket_init_handler h) {
         m_socket_init_handler = h;
     }
+
+    /// Set the TCP tuning options applied to every new connection socket
+    /**
+     * @see socket::socket_options for the available knobs
+     *
+     * @param opts The options bundle to apply pre-handshake
+     */
+    void set_socket_options(socket::socket_options const & opts) {
+        m_socket_options = opts;
+    }
 protected:
     /// Initialize a connection
     /**
@@ -282,10 +351,12 @@ protected:
      */
     lib::error_code init(socket_con_ptr scon) {
         scon->set_socket_init_handler(m_socket_init_handler);
+        scon->set_socket_options(m_socket_options);
         return lib::error_code();
     }
 private:
     socket_init_handler m_socket_init_handler;
+    socket::socket_options m_socket_options;
 };
 
 } // namespace basic_socket
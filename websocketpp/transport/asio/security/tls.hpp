@@ -29,9 +29,11 @@
 #define WEBSOCKETPP_TRANSPORT_SECURITY_TLS_HPP
 
 #include <websocketpp/transport/asio/security/base.hpp>
+#include <websocketpp/common/atomic.hpp>
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/functional.hpp>
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
@@ -50,6 +52,26 @@ typedef lib::function<void(connection_hdl,boost::asio::ssl::stream<
 typedef lib::function<lib::shared_ptr<boost::asio::ssl::context>(connection_hdl)>
     tls_init_handler;
 
+/// A point in time copy of an endpoint's TLS resumption counters
+struct resumption_stats {
+    resumption_stats() : handshakes(0), resumed(0) {}
+
+    /// Completed TLS handshakes
+    uint64_t handshakes;
+    /// Handshakes that resumed a previous session (ticket or cache hit)
+    uint64_t resumed;
+};
+
+/// Endpoint wide TLS resumption counters, shared with every connection
+struct resumption_counter {
+    resumption_counter() : handshakes(0), resumed(0) {}
+
+    lib::atomic<uint64_t> handshakes;
+    lib::atomic<uint64_t> resumed;
+
+    typedef lib::shared_ptr<resumption_counter> ptr;
+};
+
 /// TLS enabled Boost ASIO connection socket component
 /**
  * transport::asio::tls_socket::connection implements a secure connection socket
@@ -62,6 +84,8 @@ public:
     /// Type of a shared pointer to this connection socket component
     typedef lib::shared_ptr<type> ptr;
     
+    /// Type of the ASIO protocol in use
+    typedef boost::asio::ip::tcp protocol_type;
     /// Type of the ASIO socket being used
     typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket_type;
     /// Type of a shared pointer to the ASIO socket being used
@@ -73,7 +97,14 @@ public:
     
     typedef boost::system::error_code boost_error;
     
-    explicit connection() {
+    explicit connection()
+      : m_release_buffers(false)
+      , m_ktls(false)
+      , m_session_cache(false)
+      , m_session_cache_timeout(300)
+      , m_session_cache_size(20480)
+      , m_sndbuf_size(0)
+    {
         //std::cout << "transport::asio::tls_socket::connection constructor" 
         //          << std::endl; 
     }
@@ -122,6 +153,20 @@ public:
         m_socket_init_handler = h;
     }
 
+    /// Set the TCP tuning options to apply during pre_init
+    void set_socket_options(socket::socket_options const & opts) {
+        m_socket_options = opts;
+        m_sndbuf_size = 0;
+    }
+
+    /// Buffered-amount hint from the write path, drives SO_SNDBUF autotune
+    void hint_buffered_amount(size_t buffered) {
+        if (m_socket && m_socket_options.autotune_send_buffer) {
+            socket::detail::autotune_send_buffer_step(
+                get_raw_socket(),m_socket_options,buffered,m_sndbuf_size);
+        }
+    }
+
     /// Set TLS init handler
     /**
      * The tls init handler is called when needed to request a TLS context for
@@ -135,6 +180,45 @@ public:
         m_tls_init_handler = h;
     }
     
+    /// Set TLS context tuning applied when the context is installed
+    /**
+     * Forwarded from the endpoint; see endpoint::set_tls_release_buffers
+     * and endpoint::set_tls_session_cache.
+     */
+    void set_tls_tuning(bool release_buffers, bool session_cache,
+        long cache_timeout, size_t cache_size,
+        resumption_counter::ptr counter, bool ktls)
+    {
+        m_release_buffers = release_buffers;
+        m_session_cache = session_cache;
+        m_session_cache_timeout = cache_timeout;
+        m_session_cache_size = cache_size;
+        m_resumption_counter = counter;
+        m_ktls = ktls;
+    }
+
+    /// Whether kernel TLS engaged for this connection
+    /**
+     * Meaningful after the handshake with set_tls_ktls enabled: true when
+     * OpenSSL moved the record crypto for both directions into the
+     * kernel, at which point socket level zero copy (sendfile/splice)
+     * operates on this connection's fd. False when the cipher, kernel,
+     * or OpenSSL build does not support offload; traffic then flows
+     * through userspace crypto exactly as without the option.
+     */
+    bool ktls_active() const {
+#if defined(SSL_OP_ENABLE_KTLS)
+        if (!m_socket) {
+            return false;
+        }
+        SSL * ssl = m_socket->native_handle();
+        return BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0
+            && BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0;
+#else
+        return false;
+#endif
+    }
+    
     /// Get the remote endpoint address
     /**
      * The iostream transport has no information about the ultimate remote 
@@ -162,6 +246,17 @@ public:
             return s.str();
         }
     }
+public:
+    /// Return the socket component to its freshly constructed state
+    /**
+     * Used by connection pooling; init_asio rebuilds the stream and
+     * context on the next session.
+     */
+    void reset_for_reuse() {
+        m_socket.reset();
+        m_context.reset();
+    }
+
 protected:
     /// Perform one time initializations
     /**
@@ -180,6 +275,35 @@ protected:
         if (!m_context) {
             return socket::make_error_code(socket::error::invalid_tls_context);
         }
+        
+        // Context level tuning. Contexts are commonly shared between
+        // connections; these calls are idempotent so reapplying them per
+        // connection is harmless.
+#ifdef SSL_MODE_RELEASE_BUFFERS
+        if (m_release_buffers) {
+            SSL_CTX_set_mode(m_context->native_handle(),
+                SSL_MODE_RELEASE_BUFFERS);
+        }
+#endif
+#if defined(SSL_OP_ENABLE_KTLS)
+        if (m_ktls) {
+            // OpenSSL installs the session keys on the socket with
+            // setsockopt(TLS_TX/TLS_RX) after the handshake and routes
+            // records through plain socket ops; where unsupported the
+            // option is simply inert
+            SSL_CTX_set_options(m_context->native_handle(),
+                SSL_OP_ENABLE_KTLS);
+        }
+#endif
+        if (m_session_cache) {
+            SSL_CTX_set_session_cache_mode(m_context->native_handle(),
+                is_server ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_CLIENT);
+            SSL_CTX_sess_set_cache_size(m_context->native_handle(),
+                m_session_cache_size);
+            SSL_CTX_set_timeout(m_context->native_handle(),
+                m_session_cache_timeout);
+        }
+        
         m_socket.reset(new socket_type(*service,*m_context));
         
         m_io_service = service;
@@ -198,6 +322,9 @@ protected:
      * @param callback Handler to call back with completion information
      */
     void pre_init(init_handler callback) {
+        socket::detail::apply_socket_options(
+            get_raw_socket(),m_socket_options);
+
         if (m_socket_init_handler) {
             m_socket_init_handler(m_hdl,get_socket());
         }
@@ -246,6 +373,14 @@ protected:
             m_ec = socket::make_error_code(socket::error::pass_through);
         } else {
             m_ec = lib::error_code();
+            if (m_resumption_counter) {
+                m_resumption_counter->handshakes.fetch_add(1,
+                    lib::memory_order_relaxed);
+                if (SSL_session_reused(m_socket->native_handle())) {
+                    m_resumption_counter->resumed.fetch_add(1,
+                        lib::memory_order_relaxed);
+                }
+            }
         }
         
         callback(m_ec);
@@ -276,6 +411,15 @@ private:
     context_ptr         m_context;
     socket_ptr          m_socket;
     bool                m_is_server;
+    socket::socket_options m_socket_options;
+    int                 m_sndbuf_size;
+    
+    bool                m_release_buffers;
+    bool                m_ktls;
+    bool                m_session_cache;
+    long                m_session_cache_timeout;
+    size_t              m_session_cache_size;
+    resumption_counter::ptr m_resumption_counter;
     
     lib::error_code     m_ec;
     
@@ -294,13 +438,22 @@ public:
     /// The type of this endpoint socket component
     typedef endpoint type;
 
+    /// Type of the ASIO protocol in use
+    typedef boost::asio::ip::tcp protocol_type;
     /// The type of the corresponding connection socket component
     typedef connection socket_con_type;
     /// The type of a shared pointer to the corresponding connection socket
     /// component.
     typedef socket_con_type::ptr socket_con_ptr;
 
-    explicit endpoint() {}
+    explicit endpoint()
+      : m_release_buffers(false)
+      , m_ktls(false)
+      , m_session_cache(false)
+      , m_session_cache_timeout(300)
+      , m_session_cache_size(20480)
+      , m_resumption_counter(new resumption_counter())
+    {}
 
     /// Checks whether the endpoint creates secure connections
     /**
@@ -321,6 +474,16 @@ public:
     void set_socket_init_handler(socket_init_handler h) {
         m_socket_init_handler = h;
     }
+
+    /// Set the TCP tuning options applied to every new connection socket
+    /**
+     * @see socket::socket_options for the available knobs
+     *
+     * @param opts The options bundle to apply pre-handshake
+     */
+    void set_socket_options(socket::socket_options const & opts) {
+        m_socket_options = opts;
+    }
     
     /// Set TLS init handler
     /**
@@ -334,6 +497,69 @@ public:
     void set_tls_init_handler(tls_init_handler h) {
         m_tls_init_handler = h;
     }
+    
+    /// Release OpenSSL's per connection read/write buffers when idle
+    /**
+     * Sets SSL_MODE_RELEASE_BUFFERS on every context returned by the tls
+     * init handler, allowing OpenSSL to free a connection's ~34KB of
+     * encrypt/decrypt buffers whenever they are empty rather than holding
+     * them for the connection's lifetime. Worthwhile for endpoints with
+     * many mostly idle connections; costs a buffer reallocation when a
+     * quiet connection next transfers data. No effect when the linked
+     * OpenSSL does not support the mode.
+     */
+    void set_tls_release_buffers(bool value) {
+        m_release_buffers = value;
+    }
+
+    /// Request kernel TLS offload on new connections
+    /**
+     * Sets SSL_OP_ENABLE_KTLS on the contexts connections install, so
+     * OpenSSL moves post-handshake record crypto into the kernel when
+     * the cipher suite, kernel (tls module), and build support it --
+     * cutting userspace crypto CPU and enabling sendfile/splice zero
+     * copy on the raw socket. Engagement is per connection and best
+     * effort; query connection::ktls_active after the handshake.
+     * Requires OpenSSL 3.0+; a no-op otherwise.
+     */
+    void set_tls_ktls(bool value) {
+        m_ktls = value;
+    }
+    
+    /// Enable the OpenSSL session cache on contexts this endpoint uses
+    /**
+     * Servers cache completed sessions so that clients reconnecting within
+     * the timeout can resume with an abbreviated handshake; clients cache
+     * received sessions for the application to reuse. Applied alongside
+     * OpenSSL's session tickets, which remain governed by the context the
+     * tls init handler returns.
+     *
+     * @param value Whether to enable the session cache
+     * @param timeout_secs Session lifetime in seconds
+     * @param size Maximum number of cached sessions
+     */
+    void set_tls_session_cache(bool value, long timeout_secs = 300,
+        size_t size = 20480)
+    {
+        m_session_cache = value;
+        m_session_cache_timeout = timeout_secs;
+        m_session_cache_size = size;
+    }
+    
+    /// Retrieve a snapshot of this endpoint's TLS resumption counters
+    /**
+     * Counts completed TLS handshakes across all connections and how many
+     * of them resumed an earlier session instead of performing a full key
+     * exchange.
+     */
+    resumption_stats get_tls_resumption_stats() const {
+        resumption_stats s;
+        s.handshakes = m_resumption_counter->handshakes.load(
+            lib::memory_order_relaxed);
+        s.resumed = m_resumption_counter->resumed.load(
+            lib::memory_order_relaxed);
+        return s;
+    }
 protected:
     /// Initialize a connection
     /**
@@ -347,12 +573,24 @@ protected:
     lib::error_code init(socket_con_ptr scon) {
         scon->set_socket_init_handler(m_socket_init_handler);
         scon->set_tls_init_handler(m_tls_init_handler);
+        scon->set_tls_tuning(m_release_buffers,m_session_cache,
+            m_session_cache_timeout,m_session_cache_size,
+            m_resumption_counter,m_ktls);
+        scon->set_socket_options(m_socket_options);
         return lib::error_code();
     }
 
 private:
     socket_init_handler m_socket_init_handler;
     tls_init_handler m_tls_init_handler;
+    socket::socket_options m_socket_options;
+    
+    bool m_release_buffers;
+    bool m_ktls;
+    bool m_session_cache;
+    long m_session_cache_timeout;
+    size_t m_session_cache_size;
+    resumption_counter::ptr m_resumption_counter;
 };
 
 } // namespace tls_socket
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <boost/asio.hpp>
+
+#include <list>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// A hashed timing wheel multiplexing many timeouts onto one asio timer
+/**
+ * Connection timeouts (handshake, pong, close, shutdown) are numerous,
+ * coarse, and usually canceled before they fire, which makes the reactor's
+ * per-timer heap churn pure overhead. A timer_wheel instead hashes each
+ * timeout into one of a fixed number of slots and drives them all from a
+ * single deadline_timer that ticks at a fixed interval; scheduling and
+ * canceling are O(1) and firing accuracy is bounded by the tick length
+ * (adequate for the multi-second timeouts the library uses).
+ *
+ * One wheel should be shared per io_service; handlers run on the thread(s)
+ * driving that io_service, exactly like plain asio timers. All operations
+ * are internally locked and safe to call from any thread. The underlying
+ * tick timer only runs while entries are pending.
+ */
+class timer_wheel : public lib::enable_shared_from_this<timer_wheel> {
+public:
+    typedef lib::shared_ptr<timer_wheel> ptr;
+    typedef lib::weak_ptr<timer_wheel> weak_ptr;
+    typedef lib::function<void(lib::error_code const &)> handler_type;
+
+    /// A single scheduled timeout
+    /**
+     * cancel() marks the entry and immediately releases its handler (so
+     * canceled timeouts do not pin their closures -- typically a connection
+     * shared_ptr -- until the wheel's cursor collects the slot); the
+     * operation_aborted callback is consequently not delivered for wheel
+     * timers, matching what every handler in the library does with it
+     * (ignore it). Cancel is O(1) and thread safe.
+     */
+    struct entry {
+        typedef lib::shared_ptr<entry> ptr;
+
+        entry(handler_type h, size_t r) : handler(h), rounds(r),
+            canceled(false), fired(false) {}
+
+        void cancel() {
+            timer_wheel::ptr wheel = owner.lock();
+            if (wheel) {
+                lib::lock_guard<lib::mutex> lock(wheel->m_lock);
+                canceled = true;
+                handler = handler_type();
+            } else {
+                canceled = true;
+            }
+        }
+
+        handler_type handler;
+        size_t rounds;
+        bool canceled;
+        bool fired;
+        timer_wheel::weak_ptr owner;
+    };
+
+    /// A cancellation group: one anchor for all of a connection's timers
+    /**
+     * Every timeout a connection schedules can be linked to its group;
+     * cancel_all() then revokes the whole set under a single lock
+     * acquisition with no reactor operations at all, which is what mass
+     * disconnects want (four individual cancels per connection otherwise
+     * serialize through the reactor during failover storms). Handlers
+     * are released immediately, exactly as entry::cancel does, so the
+     * group never pins connection closures. Fired and individually
+     * canceled entries are pruned when new timers are linked, bounding
+     * the member list at the live-timer count.
+     */
+    struct group {
+        typedef lib::shared_ptr<group> ptr;
+
+        /// Cancel every member timeout; one lock, zero reactor ops
+        void cancel_all() {
+            timer_wheel::ptr wheel = owner.lock();
+            if (!wheel) {
+                return;
+            }
+            lib::lock_guard<lib::mutex> lock(wheel->m_lock);
+            for (size_t i = 0; i < members.size(); i++) {
+                members[i]->canceled = true;
+                members[i]->handler = handler_type();
+            }
+            members.clear();
+        }
+
+        std::vector<entry::ptr> members;
+        timer_wheel::weak_ptr owner;
+    };
+
+    /// Construct a wheel over the given io_service
+    /**
+     * @param ios The io_service that will run the tick timer and handlers
+     * @param tick_ms Tick length in milliseconds (firing granularity)
+     * @param num_slots Number of hash slots; tick_ms*num_slots is the span
+     * of one full rotation
+     */
+    explicit timer_wheel(boost::asio::io_service & ios, long tick_ms = 50,
+        size_t num_slots = 1024)
+      : m_tick_timer(ios)
+      , m_tick_ms(tick_ms < 1 ? 1 : tick_ms)
+      , m_slots(num_slots < 2 ? 2 : num_slots)
+      , m_cursor(0)
+      , m_pending(0)
+      , m_running(false)
+    {}
+
+    /// Schedule a timeout. O(1).
+    /**
+     * @param duration Timeout in milliseconds, rounded up to whole ticks
+     * @param handler Called with no error when the timeout expires; not
+     * called at all if the timeout is canceled first (see entry)
+     * @return A handle whose cancel() aborts the timeout
+     */
+    entry::ptr set_timer(long duration, handler_type handler) {
+        size_t ticks = static_cast<size_t>(
+            (duration + m_tick_ms - 1) / m_tick_ms);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+
+        size_t slot = (m_cursor + ticks) % m_slots.size();
+        // (ticks-1)/slots, not ticks/slots: a timeout of exactly one
+        // rotation lands in the cursor's own slot and must fire on the
+        // first pass, not the second
+        entry::ptr e(new entry(handler,(ticks-1) / m_slots.size()));
+        e->owner = shared_from_this();
+        m_slots[slot].push_back(e);
+        m_pending++;
+
+        if (!m_running) {
+            m_running = true;
+            arm_tick();
+        }
+        return e;
+    }
+
+    /// Schedule a timeout linked to a cancellation group. O(1).
+    /**
+     * As set_timer, but the entry is also anchored to `g` so that
+     * group::cancel_all revokes it along with the rest of the
+     * connection's timeouts. Dead members are pruned here rather than
+     * on cancel, keeping both operations allocation free.
+     */
+    entry::ptr set_timer(long duration, handler_type handler,
+        group::ptr const & g)
+    {
+        entry::ptr e = set_timer(duration,handler);
+        if (g) {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            if (!g->owner.lock()) {
+                g->owner = shared_from_this();
+            }
+            size_t live = 0;
+            for (size_t i = 0; i < g->members.size(); i++) {
+                if (!g->members[i]->canceled && !g->members[i]->fired) {
+                    g->members[live++] = g->members[i];
+                }
+            }
+            g->members.resize(live);
+            g->members.push_back(e);
+        }
+        return e;
+    }
+
+    /// Number of timeouts currently scheduled (including canceled entries
+    /// not yet collected)
+    size_t pending() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_pending;
+    }
+
+private:
+    void arm_tick() {
+        // m_lock held
+        m_tick_timer.expires_from_now(
+            boost::posix_time::milliseconds(m_tick_ms));
+        m_tick_timer.async_wait(lib::bind(
+            &timer_wheel::handle_tick,
+            shared_from_this(),
+            lib::placeholders::_1
+        ));
+    }
+
+    void handle_tick(boost::system::error_code const & ec) {
+        if (ec) {
+            // io_service shutting down; entries are dropped
+            return;
+        }
+
+        std::list<handler_type> due;
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            m_cursor = (m_cursor+1) % m_slots.size();
+
+            std::list<entry::ptr> & slot = m_slots[m_cursor];
+            std::list<entry::ptr>::iterator it = slot.begin();
+            while (it != slot.end()) {
+                if ((*it)->canceled) {
+                    // canceled entries dropped; handler already released
+                    it = slot.erase(it);
+                    m_pending--;
+                } else if ((*it)->rounds == 0) {
+                    (*it)->fired = true;
+                    due.push_back((*it)->handler);
+                    it = slot.erase(it);
+                    m_pending--;
+                } else {
+                    (*it)->rounds--;
+                    ++it;
+                }
+            }
+
+            if (m_pending > 0) {
+                arm_tick();
+            } else {
+                m_running = false;
+            }
+        }
+
+        // invoke handlers outside the lock
+        std::list<handler_type>::iterator it;
+        for (it = due.begin(); it != due.end(); ++it) {
+            (*it)(lib::error_code());
+        }
+    }
+
+    boost::asio::deadline_timer m_tick_timer;
+    long m_tick_ms;
+    std::vector<std::list<entry::ptr> > m_slots;
+    size_t m_cursor;
+    size_t m_pending;
+    bool m_running;
+    mutable lib::mutex m_lock;
+};
+
+/// Cancelable handle covering both native asio timers and wheel entries
+/**
+ * The connection transport's timer_ptr resolves to this type so that the
+ * core library's uniform handle->cancel() usage works regardless of which
+ * backing store a timeout was scheduled in.
+ */
+struct timer_object {
+    typedef lib::shared_ptr<timer_object> ptr;
+
+    explicit timer_object(lib::shared_ptr<boost::asio::deadline_timer> t)
+      : native(t) {}
+
+    explicit timer_object(timer_wheel::entry::ptr e)
+      : wheel_entry(e) {}
+
+    void cancel() {
+        if (native) {
+            native->cancel();
+        }
+        if (wheel_entry) {
+            wheel_entry->cancel();
+        }
+    }
+
+    /// Whether the timeout has already fired
+    /**
+     * Mirrors the expires_from_now().is_negative() idiom used with native
+     * asio timers to detect "operation completed but the timeout fired
+     * concurrently" races.
+     */
+    bool expired() const {
+        if (native) {
+            return native->expires_from_now().is_negative();
+        }
+        if (wheel_entry) {
+            return wheel_entry->fired;
+        }
+        return false;
+    }
+
+    lib::shared_ptr<boost::asio::deadline_timer> native;
+    timer_wheel::entry::ptr wheel_entry;
+};
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
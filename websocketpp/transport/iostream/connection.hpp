@@ -91,6 +91,45 @@ public:
         scoped_lock_type lock(m_read_mutex);
         m_output_stream = o;
     }
+
+    /// Signature of the flat embedder write callback
+    /**
+     * Receives one contiguous span to write to the embedder's output.
+     * Return an empty error code on success; the returned code is passed
+     * through to the write's completion handler.
+     */
+    typedef lib::function<lib::error_code(connection_hdl,char const *,
+        size_t)> write_callback;
+
+    /// Signature of the vectored embedder write callback
+    /**
+     * Receives the write's buffer list exactly as the library's frame
+     * writer built it (header and payload spans separate, batches of
+     * queued frames together), enabling writev style output with no
+     * coalescing copy. The spans are only valid for the duration of the
+     * call; write or copy them before returning.
+     */
+    typedef lib::function<lib::error_code(connection_hdl,
+        transport::buffer const *,size_t)> vector_write_callback;
+
+    /// Route writes to an embedder callback instead of the ostream
+    /**
+     * Takes precedence over a registered ostream. With only the flat
+     * callback set, scatter-gather writes invoke it once per buffer.
+     */
+    void set_write_callback(write_callback h) {
+        m_write_callback = h;
+    }
+
+    /// Route writes to a vectored embedder callback
+    /**
+     * Takes precedence over the flat callback and the ostream; see
+     * vector_write_callback.
+     */
+    void set_vector_write_callback(vector_write_callback h) {
+        m_vector_write_callback = h;
+    }
+
     
     /// Overloaded stream input operator
     /**
@@ -149,6 +188,29 @@ public:
     bool is_secure() const {
         return false;
     }
+
+    /// Buffered-amount hint from the core write path
+    /**
+     * The iostream transport has no kernel socket to tune; the hint is
+     * accepted and ignored.
+     */
+    void hint_buffered_amount(size_t) {}
+
+    /// Grouped timer cancellation hook from core terminate
+    /**
+     * This transport schedules no grouped timers; the call is a no-op.
+     */
+    void cancel_timers() {}
+
+    /// Connect budget hook; this transport has no budgeted connect
+    long remaining_connect_budget() const {
+        return 0;
+    }
+
+    /// Affine dispatch; this transport's dispatch already runs inline
+    lib::error_code dispatch_affine(dispatch_handler handler) {
+        return dispatch(handler);
+    }
     
     /// Get the remote endpoint address
     /**
@@ -184,6 +246,18 @@ public:
     timer_ptr set_timer(long duration, timer_handler callback) {
         return timer_ptr();
     }
+public:
+    /// Return the transport component to a reusable state
+    /**
+     * Part of the connection pooling protocol.
+     */
+    void reset_for_reuse() {
+        m_output_stream = NULL;
+        m_reading = false;
+        m_write_callback = write_callback();
+        m_vector_write_callback = vector_write_callback();
+    }
+
 protected:
     void init(init_handler callback) {
         m_alog.write(log::alevel::devel,"iostream connection init");
@@ -220,9 +294,13 @@ protected:
     void async_read_at_least(size_t num_bytes, char *buf, size_t len, 
         read_handler handler)
     {
-        std::stringstream s;
-        s << "iostream_con async_read_at_least: " << num_bytes;
-        m_alog.write(log::alevel::devel,s.str());
+        if (m_alog.static_test(log::alevel::devel)) {
+        if (m_alog.dynamic_test(log::alevel::devel)) {
+            std::stringstream s;
+            s << "iostream_con async_read_at_least: " << num_bytes;
+            m_alog.write(log::alevel::devel,s.str());
+        }
+        }
         
         if (num_bytes > len) {
             handler(make_error_code(error::invalid_num_bytes),size_t(0));
@@ -265,6 +343,16 @@ protected:
         m_alog.write(log::alevel::devel,"iostream_con async_write");
         // TODO: lock transport state?
         
+        if (m_vector_write_callback) {
+            transport::buffer b(buf,len);
+            handler(m_vector_write_callback(m_connection_hdl,&b,1));
+            return;
+        }
+        if (m_write_callback) {
+            handler(m_write_callback(m_connection_hdl,buf,len));
+            return;
+        }
+        
         if (!m_output_stream) {
             handler(make_error_code(error::output_stream_required));
             return;
@@ -296,6 +384,27 @@ protected:
         m_alog.write(log::alevel::devel,"iostream_con async_write buffer list");
         // TODO: lock transport state?
         
+        if (m_vector_write_callback) {
+            // hand the buffer list over intact; this is the writev path
+            handler(m_vector_write_callback(m_connection_hdl,
+                (bufs.empty() ? static_cast<buffer const *>(0) : &bufs[0]),
+                bufs.size()));
+            return;
+        }
+        if (m_write_callback) {
+            std::vector<buffer>::const_iterator cit;
+            for (cit = bufs.begin(); cit != bufs.end(); cit++) {
+                lib::error_code cec = m_write_callback(m_connection_hdl,
+                    (*cit).buf,(*cit).len);
+                if (cec) {
+                    handler(cec);
+                    return;
+                }
+            }
+            handler(lib::error_code());
+            return;
+        }
+        
         if (!m_output_stream) {
             handler(make_error_code(error::output_stream_required));
             return;
@@ -306,7 +415,10 @@ protected:
             m_output_stream->write((*it).buf,(*it).len);
             
             if (m_output_stream->bad()) {
+                // report the stream error once; continuing would both
+                // write garbage and invoke the handler twice
                 handler(make_error_code(error::bad_stream));
+                return;
             }
         }
         
@@ -382,7 +494,9 @@ private:
         
         size_t bytes_to_copy = std::min(len,m_len-m_cursor);
         
-        std::copy(buf,buf+bytes_to_copy,m_buf);
+        // append at the cursor; copying to the buffer start would clobber
+        // bytes accumulated by earlier partial reads
+        std::copy(buf,buf+bytes_to_copy,m_buf+m_cursor);
         
         m_cursor += bytes_to_copy;
         
@@ -404,6 +518,8 @@ private:
     // transport resources
     std::ostream*   m_output_stream;
     connection_hdl  m_connection_hdl;
+    write_callback  m_write_callback;
+    vector_write_callback m_vector_write_callback;
     
     bool            m_reading;
     const bool      m_is_server;
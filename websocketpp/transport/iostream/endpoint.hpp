@@ -43,6 +43,9 @@ namespace iostream {
 template <typename config>
 class endpoint {
 public:
+    /// Warm-start hook (endpoint::reserve); nothing lazy to build here
+    void prewarm() {}
+
     /// Type of this endpoint transport component
     typedef endpoint type;
     /// Type of a pointer to this endpoint transport component
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_RECORDING_HPP
+#define WEBSOCKETPP_TRANSPORT_RECORDING_HPP
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/common/time.hpp>
+
+#include <iostream>
+#include <string>
+
+namespace websocketpp {
+namespace transport {
+namespace recording {
+
+/// Direction of a recorded span
+namespace direction {
+    enum value {
+        inbound = 0,
+        outbound = 1
+    };
+}
+
+/// Wire traffic recorder
+/**
+ * Captures every inbound and outbound byte span of a connection with a
+ * monotonic microsecond timestamp into a compact binary log:
+ *
+ *   record := u8 direction, u64le timestamp_us, u32le length, bytes
+ *
+ * Attach to an asio transport connection with set_recorder; the hooks
+ * sit exactly where the transport meets the core connection, so the
+ * log reproduces what the connection machinery actually saw, in order,
+ * with timing. One recorder may serve one connection; give each
+ * connection its own sink.
+ *
+ * Replay with `player` below: it feeds the inbound spans back into any
+ * connection exposing readsome (the iostream transport) with faithful
+ * or scaled timing, turning a production heisenbug into a local,
+ * repeatable unit of bytes.
+ */
+class recorder {
+public:
+    typedef lib::shared_ptr<recorder> ptr;
+
+    explicit recorder(std::ostream & sink) : m_sink(sink) {}
+
+    /// Append one span to the log
+    void record(direction::value dir, void const * data, size_t len) {
+        lib::lock_guard<lib::mutex> guard(m_lock);
+        uint64_t ts = lib::steady_us();
+        uint32_t len32 = static_cast<uint32_t>(len);
+        char hdr[13];
+        hdr[0] = static_cast<char>(dir);
+        for (int i = 0; i < 8; i++) {
+            hdr[1+i] = static_cast<char>((ts >> (8*i)) & 0xff);
+        }
+        for (int i = 0; i < 4; i++) {
+            hdr[9+i] = static_cast<char>((len32 >> (8*i)) & 0xff);
+        }
+        m_sink.write(hdr,13);
+        m_sink.write(static_cast<char const *>(data),
+            static_cast<std::streamsize>(len));
+    }
+
+private:
+    std::ostream & m_sink;
+    lib::mutex m_lock;
+};
+
+/// One record read back from a log
+struct record {
+    direction::value dir;
+    uint64_t timestamp_us;
+    std::string bytes;
+};
+
+/// Read the next record from a log; false at end or on a short read
+inline bool read_record(std::istream & log, record & out) {
+    char hdr[13];
+    if (!log.read(hdr,13)) {
+        return false;
+    }
+    out.dir = static_cast<direction::value>(
+        static_cast<unsigned char>(hdr[0]));
+    out.timestamp_us = 0;
+    for (int i = 7; i >= 0; i--) {
+        out.timestamp_us = (out.timestamp_us << 8)
+            | static_cast<unsigned char>(hdr[1+i]);
+    }
+    uint32_t len = 0;
+    for (int i = 3; i >= 0; i--) {
+        len = (len << 8) | static_cast<unsigned char>(hdr[9+i]);
+    }
+    out.bytes.resize(len);
+    if (len > 0 && !log.read(&out.bytes[0],
+        static_cast<std::streamsize>(len)))
+    {
+        return false;
+    }
+    return true;
+}
+
+/// Replay a recording's inbound traffic into a connection
+/**
+ * Feeds each inbound span to the connection's readsome (the iostream
+ * transport's ingest) after sleeping the recorded inter-arrival gap
+ * scaled by time_scale: 1.0 replays faithfully, 0 replays as fast as
+ * the machinery can consume, anything between accelerates. Outbound
+ * records are skipped -- register an ostream on the connection under
+ * test and compare what it writes against the log's outbound spans for
+ * divergence checks.
+ *
+ * @param log The recording
+ * @param con The connection under test (handshake-ready; call start())
+ * @param time_scale Inter-arrival scaling factor
+ * @return Spans delivered
+ */
+template <typename connection_ptr>
+size_t play(std::istream & log, connection_ptr con, double time_scale) {
+    record r;
+    uint64_t last_ts = 0;
+    bool first = true;
+    size_t delivered = 0;
+    while (read_record(log,r)) {
+        if (r.dir != direction::inbound) {
+            continue;
+        }
+        if (!first && time_scale > 0 && r.timestamp_us > last_ts) {
+            // spin-free wait on the monotonic clock; portable across the
+            // lib thread wrappers without a chrono dependency
+            uint64_t gap = static_cast<uint64_t>(
+                static_cast<double>(r.timestamp_us-last_ts)*time_scale);
+            uint64_t until = lib::steady_us()+gap;
+            while (lib::steady_us() < until) {
+                lib::this_thread::yield();
+            }
+        }
+        first = false;
+        last_ts = r.timestamp_us;
+        size_t off = 0;
+        while (off < r.bytes.size()) {
+            size_t took = con->readsome(r.bytes.data()+off,
+                r.bytes.size()-off);
+            if (took == 0) {
+                break;
+            }
+            off += took;
+        }
+        delivered++;
+    }
+    return delivered;
+}
+
+} // namespace recording
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_RECORDING_HPP
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_BASE_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_BASE_HPP
+
+#ifndef __linux__
+    #error "The uring transport policy is only available on Linux"
+#endif
+
+#include <liburing.h>
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/system_error.hpp>
+
+#include <string>
+
+namespace websocketpp {
+namespace transport {
+/// Transport policy that uses Linux io_uring for I/O and timers
+/**
+ * This policy implements the same transport concepts as the asio policy
+ * (async_read_at_least, async_write, timers, dispatch/interrupt) on top of a
+ * single io_uring instance owned by the endpoint. Reads may use registered
+ * buffers and the server accept loop uses multishot accept where the running
+ * kernel supports it, falling back to re-armed single shot accept otherwise.
+ *
+ * Requires liburing and a kernel with io_uring support (5.1+; multishot
+ * accept requires 5.19+). The io thread is the thread that calls
+ * endpoint::run or endpoint::poll; handlers are always invoked there.
+ */
+namespace uring {
+
+/// The signature of a completion record handler. Receives the raw cqe result
+/// (negative errno on failure, otherwise the operation dependent count) and
+/// the cqe flags (needed to detect multishot retirement).
+typedef lib::function<void(int, uint32_t)> completion_handler;
+
+/// Completion record attached to each submitted sqe
+/**
+ * Every sqe submitted by this transport carries a heap allocated operation
+ * record in its user_data field. When the matching cqe is reaped the handler
+ * is invoked with the cqe result and the record is freed, unless the record
+ * is flagged persistent (multishot operations), in which case it is reused
+ * until a cqe without IORING_CQE_F_MORE retires it.
+ */
+struct operation {
+    explicit operation(completion_handler h, bool p = false)
+      : handler(h), persistent(p) {}
+
+    completion_handler handler;
+    bool persistent;
+};
+
+/// uring transport errors
+namespace error {
+enum value {
+    /// Catch-all error for transport policy errors that don't fit in other
+    /// categories
+    general = 1,
+
+    /// io_uring_queue_init failed
+    ring_init_failed,
+
+    /// The submission queue was full and could not be flushed
+    submission_queue_full,
+
+    /// async_read_at_least call requested more bytes than buffer can store
+    invalid_num_bytes,
+
+    /// A socket level system call failed
+    socket_error,
+
+    /// An operation was attempted on an endpoint that is not listening
+    not_listening,
+
+    /// The remote end closed the connection
+    eof,
+
+    /// The operation was canceled
+    operation_aborted
+};
+
+/// uring transport error category
+class category : public lib::error_category {
+    public:
+    category() {}
+
+    char const * name() const _WEBSOCKETPP_NOEXCEPT_TOKEN_ {
+        return "websocketpp.transport.uring";
+    }
+
+    std::string message(int value) const {
+        switch(value) {
+            case general:
+                return "Generic uring transport policy error";
+            case ring_init_failed:
+                return "io_uring initialization failed";
+            case submission_queue_full:
+                return "io_uring submission queue full";
+            case invalid_num_bytes:
+                return "async_read_at_least call requested more bytes than buffer can store";
+            case socket_error:
+                return "A socket system call failed";
+            case not_listening:
+                return "The endpoint is not listening";
+            case eof:
+                return "The remote end closed the connection";
+            case operation_aborted:
+                return "The operation was canceled";
+            default:
+                return "Unknown";
+        }
+    }
+};
+
+/// Get a reference to a static copy of the uring transport error category
+inline lib::error_category const & get_category() {
+    static category instance;
+    return instance;
+}
+
+/// Get an error code with the given value and the uring transport category
+inline lib::error_code make_error_code(error::value e) {
+    return lib::error_code(static_cast<int>(e), get_category());
+}
+
+} // namespace error
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+_WEBSOCKETPP_ERROR_CODE_ENUM_NS_START_
+template<> struct is_error_code_enum<websocketpp::transport::uring::error::value>
+{
+    static bool const value = true;
+};
+_WEBSOCKETPP_ERROR_CODE_ENUM_NS_END_
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_BASE_HPP
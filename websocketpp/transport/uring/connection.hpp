@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_CON_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_CON_HPP
+
+#include <websocketpp/transport/uring/base.hpp>
+
+#include <websocketpp/transport/base/connection.hpp>
+
+#include <websocketpp/logger/levels.hpp>
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/functional.hpp>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+/// Shared handle to the endpoint's io_uring instance
+/**
+ * liburing's submission queue is not thread safe; every sqe
+ * acquisition/submission in this transport goes through the handle's lock.
+ * A plain std::mutex is used rather than the concurrency policy because the
+ * handle is shared between config-free helper code and templated transport
+ * components. Completions are only reaped on the io thread.
+ */
+struct ring_handle {
+    ring_handle() : initialized(false) {}
+
+    io_uring ring;
+    std::mutex sq_lock;
+    bool initialized;
+
+    /// Acquire an sqe, flushing the submission queue once if it is full
+    io_uring_sqe * get_sqe() {
+        io_uring_sqe * sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+        }
+        return sqe;
+    }
+};
+
+typedef lib::shared_ptr<ring_handle> ring_handle_ptr;
+
+/// uring transport timer
+/**
+ * Wraps an io_uring timeout operation. cancel issues a timeout_remove keyed
+ * on the original operation record; the pending handler then fires with
+ * operation_aborted.
+ */
+struct timer {
+    timer(ring_handle_ptr r, operation * o) : ring(r), op(o) {}
+
+    void cancel() {
+        std::lock_guard<std::mutex> lock(ring->sq_lock);
+        io_uring_sqe * sqe = ring->get_sqe();
+        if (!sqe) { return; }
+        io_uring_prep_timeout_remove(sqe,
+            reinterpret_cast<uint64_t>(op), 0);
+        io_uring_sqe_set_data(sqe, NULL);
+        io_uring_submit(&ring->ring);
+    }
+
+    ring_handle_ptr ring;
+    operation * op;
+};
+
+template <typename config>
+class connection : public lib::enable_shared_from_this< connection<config> > {
+public:
+    /// Type of this connection transport component
+    typedef connection<config> type;
+    /// Type of a shared pointer to this connection transport component
+    typedef lib::shared_ptr<type> ptr;
+
+    /// transport concurrency policy
+    typedef typename config::concurrency_type concurrency_type;
+    /// Type of this transport's access logging policy
+    typedef typename config::alog_type alog_type;
+    /// Type of this transport's error logging policy
+    typedef typename config::elog_type elog_type;
+
+    // Concurrency policy types
+    typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
+    typedef typename concurrency_type::mutex_type mutex_type;
+
+    typedef lib::shared_ptr<timer> timer_ptr;
+
+    explicit connection(bool is_server, alog_type & alog, elog_type & elog)
+      : m_socket(-1)
+      , m_fixed_buffer_index(-1)
+      , m_is_server(is_server)
+      , m_alog(alog)
+      , m_elog(elog)
+    {
+        m_alog.write(log::alevel::devel,"uring con transport constructor");
+    }
+
+    ~connection() {
+        if (m_socket != -1) {
+            ::close(m_socket);
+        }
+    }
+
+    /// Get a shared pointer to this component
+    ptr get_shared() {
+        return type::shared_from_this();
+    }
+
+    /// Tests whether or not the underlying transport is secure
+    /**
+     * The uring transport is never secure.
+     *
+     * @return Whether or not the underlying transport is secure
+     */
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Buffered-amount hint from the core write path
+    /**
+     * Send-buffer autotuning is not yet wired for the io_uring
+     * transport; the hint is accepted and ignored.
+     */
+    void hint_buffered_amount(size_t) {}
+
+    /// Grouped timer cancellation hook from core terminate
+    /**
+     * This transport schedules no grouped timers; the call is a no-op.
+     */
+    void cancel_timers() {}
+
+    /// Connect budget hook; this transport has no budgeted connect
+    long remaining_connect_budget() const {
+        return 0;
+    }
+
+    /// Affine dispatch; this transport's dispatch already runs inline
+    lib::error_code dispatch_affine(dispatch_handler handler) {
+        return dispatch(handler);
+    }
+
+    /// Get the remote endpoint address
+    /**
+     * @return A string identifying the address of the remote endpoint
+     */
+    std::string get_remote_endpoint() const {
+        sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        if (m_socket == -1 ||
+            getpeername(m_socket,reinterpret_cast<sockaddr *>(&addr),&len) != 0)
+        {
+            return "Unknown";
+        }
+
+        char buf[INET6_ADDRSTRLEN];
+        std::stringstream s;
+        if (addr.ss_family == AF_INET) {
+            sockaddr_in * a = reinterpret_cast<sockaddr_in *>(&addr);
+            inet_ntop(AF_INET,&a->sin_addr,buf,sizeof(buf));
+            s << buf << ":" << ntohs(a->sin_port);
+        } else if (addr.ss_family == AF_INET6) {
+            sockaddr_in6 * a = reinterpret_cast<sockaddr_in6 *>(&addr);
+            inet_ntop(AF_INET6,&a->sin6_addr,buf,sizeof(buf));
+            s << "[" << buf << "]:" << ntohs(a->sin6_port);
+        } else {
+            return "Unknown";
+        }
+        return s.str();
+    }
+
+    /// Get the connection handle
+    connection_hdl get_handle() const {
+        return m_connection_hdl;
+    }
+
+    /// Call back a function after a period of time
+    /**
+     * Sets a timer that calls back a function after the given period of time
+     * (in milliseconds). The timer is implemented as an io_uring timeout
+     * operation and fires on the io thread. The handler is called with
+     * operation_aborted if the timer is canceled, and with no error if it
+     * expired normally.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timer has expired
+     * @return A handle that can be used to cancel the timer
+     */
+    timer_ptr set_timer(long duration, timer_handler callback) {
+        // The timespec must outlive the submission; it is owned by the
+        // operation's closure via the shared pointer below.
+        lib::shared_ptr<__kernel_timespec> ts(new __kernel_timespec());
+        ts->tv_sec = duration / 1000;
+        ts->tv_nsec = (duration % 1000) * 1000000;
+
+        operation * op = new operation(lib::bind(
+            &type::handle_timer,
+            get_shared(),
+            callback,
+            ts,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+
+        std::lock_guard<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            return timer_ptr();
+        }
+        io_uring_prep_timeout(sqe,ts.get(),0,0);
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+
+        return timer_ptr(new timer(m_ring,op));
+    }
+
+    /// Assign a fixed buffer registered with the endpoint's ring
+    /**
+     * When a fixed buffer is assigned, reads are submitted as read_fixed
+     * operations into the registered buffer and copied out to the caller's
+     * buffer on completion. This trades one copy for the elimination of per
+     * operation page pinning. Called by the endpoint; -1 disables.
+     */
+    void set_fixed_buffer(int index, void * base, size_t len) {
+        m_fixed_buffer_index = index;
+        m_fixed_buffer_base = base;
+        m_fixed_buffer_len = len;
+    }
+
+protected:
+    /// Initialize the connection transport
+    /**
+     * Called by the core connection. The socket is already connected by the
+     * time the accept/connect completion hands it to the core, so there is
+     * no asynchronous work left to do here.
+     *
+     * @param handler The `init_handler` to call when initialization is done
+     */
+    void init(init_handler handler) {
+        m_alog.write(log::alevel::devel,"uring con init");
+        handler(lib::error_code());
+    }
+
+    /// Initiate an async_read for at least num_bytes bytes into buf
+    /**
+     * Identical semantics to the asio policy: read at least num_bytes and at
+     * most len bytes into buf, then call handler. Short reads re-arm a recv
+     * until the minimum is satisfied; res of zero reports eof.
+     *
+     * @param num_bytes Don't call back until at least this many bytes are read
+     * @param buf The buffer to read bytes into
+     * @param len The size of buf. At maximum, this many bytes will be read
+     * @param handler The callback to invoke when the operation is complete or
+     * ends in an error
+     */
+    void async_read_at_least(size_t num_bytes, char * buf, size_t len,
+        read_handler handler)
+    {
+        if (num_bytes > len) {
+            handler(make_error_code(error::invalid_num_bytes),0);
+            return;
+        }
+
+        m_read_buf = buf;
+        m_read_len = len;
+        m_read_min = num_bytes;
+        m_read_cursor = 0;
+        m_read_handler = handler;
+
+        submit_read();
+    }
+
+    /// Asyncronously write the specified buffer
+    /**
+     * @param buf The buffer to write
+     * @param len Number of bytes in buf to write
+     * @param handler Callback to invoke when the operation completes
+     */
+    void async_write(char const * buf, size_t len, write_handler handler) {
+        m_write_iovecs.resize(1);
+        m_write_iovecs[0].iov_base = const_cast<char *>(buf);
+        m_write_iovecs[0].iov_len = len;
+        m_write_handler = handler;
+        submit_write();
+    }
+
+    /// Asyncronously write the given list of buffers as a gather write
+    /**
+     * The buffer list is translated directly into an iovec array for a
+     * single writev submission; no coalescing copy is performed.
+     *
+     * @param bufs vector of buffers to write
+     * @param handler Callback to invoke when the operation completes
+     */
+    void async_write(std::vector<buffer> const & bufs, write_handler handler) {
+        m_write_iovecs.resize(bufs.size());
+        for (size_t i = 0; i < bufs.size(); i++) {
+            m_write_iovecs[i].iov_base = const_cast<char *>(bufs[i].buf);
+            m_write_iovecs[i].iov_len = bufs[i].len;
+        }
+        m_write_handler = handler;
+        submit_write();
+    }
+
+    /// Set Connection Handle
+    void set_handle(connection_hdl hdl) {
+        m_connection_hdl = hdl;
+    }
+
+    /// Call given handler back within the transport's event system
+    /**
+     * Submits a no-op operation whose completion runs the handler on the io
+     * thread. Safe to call from any thread.
+     *
+     * @param handler The callback to invoke
+     */
+    lib::error_code dispatch(dispatch_handler handler) {
+        return submit_nop(handler);
+    }
+
+    /// Signal that the connection has an outstanding interrupt
+    lib::error_code interrupt(interrupt_handler handler) {
+        return submit_nop(handler);
+    }
+
+    /// Perform cleanup on socket shutdown
+    /**
+     * Issues a shutdown operation for the write side of the socket and calls
+     * the handler once it completes. The file descriptor itself is closed
+     * when the transport component is destroyed.
+     *
+     * @param h The `shutdown_handler` to call back when complete
+     */
+    void async_shutdown(shutdown_handler h) {
+        operation * op = new operation(lib::bind(
+            &type::handle_shutdown,
+            get_shared(),
+            h,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+
+        std::unique_lock<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            lock.unlock();
+            h(make_error_code(error::submission_queue_full));
+            return;
+        }
+        io_uring_prep_shutdown(sqe,m_socket,SHUT_WR);
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+    }
+
+public:
+    /// Bind this transport component to the endpoint's ring
+    /**
+     * Called by the endpoint when the connection is created. Not part of the
+     * transport concept interface.
+     */
+    void init_uring(ring_handle_ptr ring) {
+        m_ring = ring;
+    }
+
+    /// Adopt a connected socket file descriptor
+    /**
+     * Called by the endpoint when an accept or connect operation completes.
+     * Not part of the transport concept interface.
+     */
+    void set_socket(int socket) {
+        m_socket = socket;
+    }
+
+    /// Return the transport component to a reusable state
+    /**
+     * Part of the connection pooling protocol.
+     */
+    void reset_for_reuse() {
+        if (m_socket != -1) {
+            ::close(m_socket);
+            m_socket = -1;
+        }
+        m_write_iovecs.clear();
+        m_read_handler = read_handler();
+        m_write_handler = write_handler();
+        m_fixed_buffer_index = -1;
+    }
+
+    /// Get the native socket file descriptor (-1 when unconnected)
+    int get_socket() const {
+        return m_socket;
+    }
+
+private:
+    /// Submit (or re-submit) the pending recv operation
+    void submit_read() {
+        operation * op = new operation(lib::bind(
+            &type::handle_read,
+            get_shared(),
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+
+        std::unique_lock<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            // release the submission lock before calling back; the handler
+            // is free to submit new operations
+            lock.unlock();
+            complete_read(make_error_code(error::submission_queue_full));
+            return;
+        }
+
+        size_t want = m_read_len - m_read_cursor;
+        if (m_fixed_buffer_index >= 0) {
+            if (want > m_fixed_buffer_len) {
+                want = m_fixed_buffer_len;
+            }
+            io_uring_prep_read_fixed(sqe,m_socket,m_fixed_buffer_base,
+                want,0,m_fixed_buffer_index);
+        } else {
+            io_uring_prep_recv(sqe,m_socket,m_read_buf+m_read_cursor,want,0);
+        }
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+    }
+
+    /// Process a recv completion
+    void handle_read(int res, uint32_t) {
+        if (res == 0) {
+            complete_read(make_error_code(error::eof));
+            return;
+        }
+        if (res < 0) {
+            if (res == -ECANCELED) {
+                complete_read(make_error_code(error::operation_aborted));
+            } else {
+                complete_read(make_error_code(error::socket_error));
+            }
+            return;
+        }
+
+        if (m_fixed_buffer_index >= 0) {
+            std::memcpy(m_read_buf+m_read_cursor,m_fixed_buffer_base,res);
+        }
+        m_read_cursor += res;
+
+        if (m_read_cursor >= m_read_min) {
+            complete_read(lib::error_code());
+        } else {
+            submit_read();
+        }
+    }
+
+    void complete_read(lib::error_code const & ec) {
+        read_handler handler = m_read_handler;
+        m_read_handler = read_handler();
+        if (handler) {
+            handler(ec,m_read_cursor);
+        }
+    }
+
+    /// Submit (or re-submit after a partial write) the pending writev
+    void submit_write() {
+        operation * op = new operation(lib::bind(
+            &type::handle_write,
+            get_shared(),
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+
+        std::unique_lock<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            lock.unlock();
+            complete_write(make_error_code(error::submission_queue_full));
+            return;
+        }
+        io_uring_prep_writev(sqe,m_socket,&m_write_iovecs[0],
+            m_write_iovecs.size(),0);
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+    }
+
+    /// Process a writev completion, re-arming on partial writes
+    void handle_write(int res, uint32_t) {
+        if (res < 0) {
+            if (res == -ECANCELED) {
+                complete_write(make_error_code(error::operation_aborted));
+            } else {
+                complete_write(make_error_code(error::socket_error));
+            }
+            return;
+        }
+
+        // consume res bytes from the front of the iovec list
+        size_t remaining = static_cast<size_t>(res);
+        size_t i = 0;
+        while (i < m_write_iovecs.size() &&
+               remaining >= m_write_iovecs[i].iov_len)
+        {
+            remaining -= m_write_iovecs[i].iov_len;
+            i++;
+        }
+        if (i == m_write_iovecs.size()) {
+            complete_write(lib::error_code());
+            return;
+        }
+        m_write_iovecs.erase(m_write_iovecs.begin(),
+            m_write_iovecs.begin()+i);
+        m_write_iovecs[0].iov_base =
+            static_cast<char *>(m_write_iovecs[0].iov_base)+remaining;
+        m_write_iovecs[0].iov_len -= remaining;
+        submit_write();
+    }
+
+    void complete_write(lib::error_code const & ec) {
+        write_handler handler = m_write_handler;
+        m_write_handler = write_handler();
+        if (handler) {
+            handler(ec);
+        }
+    }
+
+    /// Submit a no-op whose completion invokes the given handler
+    lib::error_code submit_nop(dispatch_handler handler) {
+        operation * op = new operation(lib::bind(
+            &type::handle_nop,
+            get_shared(),
+            handler,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+
+        std::lock_guard<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            return make_error_code(error::submission_queue_full);
+        }
+        io_uring_prep_nop(sqe);
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+        return lib::error_code();
+    }
+
+    void handle_nop(dispatch_handler handler, int, uint32_t) {
+        handler();
+    }
+
+    void handle_timer(timer_handler callback,
+        lib::shared_ptr<__kernel_timespec>, int res, uint32_t)
+    {
+        if (res == -ECANCELED) {
+            callback(make_error_code(error::operation_aborted));
+        } else {
+            // -ETIME is the normal expiration result for a timeout op
+            callback(lib::error_code());
+        }
+    }
+
+    void handle_shutdown(shutdown_handler h, int res, uint32_t) {
+        if (res < 0) {
+            h(make_error_code(error::socket_error));
+        } else {
+            h(lib::error_code());
+        }
+    }
+
+    // read state
+    char * m_read_buf;
+    size_t m_read_len;
+    size_t m_read_min;
+    size_t m_read_cursor;
+    read_handler m_read_handler;
+
+    // write state
+    std::vector<iovec> m_write_iovecs;
+    write_handler m_write_handler;
+
+    ring_handle_ptr m_ring;
+    int m_socket;
+
+    // registered buffer state
+    int m_fixed_buffer_index;
+    void * m_fixed_buffer_base;
+    size_t m_fixed_buffer_len;
+
+    bool const m_is_server;
+
+    connection_hdl m_connection_hdl;
+
+    alog_type & m_alog;
+    elog_type & m_elog;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_CON_HPP
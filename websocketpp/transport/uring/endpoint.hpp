@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_HPP
+
+#include <websocketpp/transport/uring/base.hpp>
+#include <websocketpp/transport/uring/connection.hpp>
+
+#include <websocketpp/transport/base/endpoint.hpp>
+
+#include <websocketpp/uri.hpp>
+#include <websocketpp/logger/levels.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+/// uring transport endpoint
+/**
+ * Owns the io_uring instance shared by all connections created from this
+ * endpoint. The thread that calls run (or poll) is the io thread; all
+ * completion handlers, and therefore all core library handlers, are invoked
+ * on it. Producers on other threads interact with the ring only through
+ * locked sqe submission (see ring_handle).
+ */
+template <typename config>
+class endpoint {
+public:
+    /// Warm-start hook (endpoint::reserve); nothing lazy to build here
+    void prewarm() {}
+
+    /// Type of this endpoint transport component
+    typedef endpoint type;
+    /// Type of a pointer to this endpoint transport component
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of this endpoint's concurrency policy
+    typedef typename config::concurrency_type concurrency_type;
+    /// Type of this endpoint's error logging policy
+    typedef typename config::elog_type elog_type;
+    /// Type of this endpoint's access logging policy
+    typedef typename config::alog_type alog_type;
+
+    /// Type of this endpoint transport component's associated connection
+    /// transport component
+    typedef uring::connection<config> transport_con_type;
+    /// Type of a shared pointer to this endpoint transport component's
+    /// associated connection transport component
+    typedef typename transport_con_type::ptr transport_con_ptr;
+
+    endpoint()
+      : m_ring(new ring_handle())
+      , m_listen_fd(-1)
+      , m_accept_armed(false)
+      , m_use_multishot(true)
+      , m_running(false)
+      , m_alog(NULL)
+      , m_elog(NULL)
+    {}
+
+    ~endpoint() {
+        if (m_listen_fd != -1) {
+            ::close(m_listen_fd);
+        }
+        if (m_ring->initialized) {
+            io_uring_queue_exit(&m_ring->ring);
+        }
+    }
+
+    /// Initialize the io_uring instance
+    /**
+     * Must be called exactly once before any other use of the endpoint.
+     *
+     * @param queue_depth Number of sqes to size the ring for
+     */
+    lib::error_code init_uring(unsigned queue_depth = 1024) {
+        if (m_ring->initialized) {
+            return make_error_code(error::general);
+        }
+        if (io_uring_queue_init(queue_depth,&m_ring->ring,0) < 0) {
+            return make_error_code(error::ring_init_failed);
+        }
+        m_ring->initialized = true;
+        return lib::error_code();
+    }
+
+    /// Register a pool of fixed read buffers with the kernel
+    /**
+     * Registers count buffers of size bytes each via
+     * io_uring_register_buffers. Connections that are assigned a buffer (see
+     * assign_fixed_buffer) submit their reads as read_fixed operations,
+     * avoiding per operation page pinning. Optional; reads fall back to
+     * plain recv when no buffer is assigned.
+     */
+    lib::error_code register_read_buffers(size_t count, size_t size) {
+        m_buffer_storage.resize(count*size);
+        m_buffer_iovecs.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            m_buffer_iovecs[i].iov_base = &m_buffer_storage[i*size];
+            m_buffer_iovecs[i].iov_len = size;
+            m_free_buffers.push(static_cast<int>(i));
+        }
+        if (io_uring_register_buffers(&m_ring->ring,&m_buffer_iovecs[0],
+            m_buffer_iovecs.size()) < 0)
+        {
+            m_buffer_storage.clear();
+            m_buffer_iovecs.clear();
+            return make_error_code(error::general);
+        }
+        return lib::error_code();
+    }
+
+    /// Assign a registered read buffer to the given connection, if available
+    /**
+     * @return true if a buffer was assigned
+     */
+    bool assign_fixed_buffer(transport_con_ptr tcon) {
+        if (m_free_buffers.empty()) {
+            return false;
+        }
+        int index = m_free_buffers.front();
+        m_free_buffers.pop();
+        tcon->set_fixed_buffer(index,m_buffer_iovecs[index].iov_base,
+            m_buffer_iovecs[index].iov_len);
+        return true;
+    }
+
+    /// Return a previously assigned buffer index to the pool
+    void release_fixed_buffer(int index) {
+        if (index >= 0) {
+            m_free_buffers.push(index);
+        }
+    }
+
+    /// Check if the endpoint is listening
+    bool is_listening() const {
+        return m_listen_fd != -1;
+    }
+
+    /// Tests whether or not the underlying transport is secure
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Set up the endpoint for listening on a port
+    /**
+     * Binds an IPv4 listening socket to the given port and arms the kernel
+     * side accept machinery (multishot where supported; the first -EINVAL
+     * completion downgrades to re-armed single shot accept).
+     *
+     * @param port The port to listen on
+     * @param ec An error code to fill in case of failure
+     */
+    void listen(uint16_t port, lib::error_code & ec) {
+        if (!m_ring->initialized) {
+            ec = init_uring();
+            if (ec) { return; }
+        }
+
+        int fd = ::socket(AF_INET,SOCK_STREAM,0);
+        if (fd < 0) {
+            ec = make_error_code(error::socket_error);
+            return;
+        }
+
+        int one = 1;
+        setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+
+        sockaddr_in addr;
+        std::memset(&addr,0,sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+
+        if (::bind(fd,reinterpret_cast<sockaddr *>(&addr),sizeof(addr)) < 0 ||
+            ::listen(fd,SOMAXCONN) < 0)
+        {
+            ::close(fd);
+            ec = make_error_code(error::socket_error);
+            return;
+        }
+
+        m_listen_fd = fd;
+        arm_accept();
+        ec = lib::error_code();
+    }
+
+    /// Accept the next connection attempt and assign it to con
+    /**
+     * Mirrors asio::endpoint::async_accept. Accepted sockets that arrive
+     * from the kernel before an async_accept is pending are held in a
+     * backlog and matched in order.
+     *
+     * @param tcon The transport connection component of the connection to
+     * assign the next accepted socket to
+     * @param callback The function to call back when the operation is done
+     */
+    void async_accept(transport_con_ptr tcon, accept_handler callback) {
+        if (m_listen_fd == -1) {
+            callback(tcon->get_handle(),make_error_code(error::not_listening));
+            return;
+        }
+
+        if (!m_accepted_backlog.empty()) {
+            int fd = m_accepted_backlog.front();
+            m_accepted_backlog.pop();
+            complete_accept(tcon,callback,fd);
+            return;
+        }
+
+        m_pending_accepts.push(std::make_pair(tcon,callback));
+    }
+
+    /// Initiate a client connection to the authority in the given uri
+    /**
+     * Name resolution is currently performed synchronously with getaddrinfo
+     * before the connect operation is submitted to the ring.
+     *
+     * @param tcon The transport connection to connect
+     * @param u The uri to connect to
+     * @param cb The function to call back with the results when complete
+     */
+    void async_connect(transport_con_ptr tcon, uri_ptr u, connect_handler cb) {
+        if (!m_ring->initialized) {
+            lib::error_code ec = init_uring();
+            if (ec) {
+                cb(tcon->get_handle(),ec);
+                return;
+            }
+            tcon->init_uring(m_ring);
+        }
+
+        addrinfo hints;
+        std::memset(&hints,0,sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        std::stringstream port;
+        port << u->get_port();
+
+        addrinfo * res = NULL;
+        if (getaddrinfo(u->get_host().c_str(),port.str().c_str(),&hints,
+            &res) != 0 || !res)
+        {
+            cb(tcon->get_handle(),make_error_code(error::socket_error));
+            return;
+        }
+
+        int fd = ::socket(res->ai_family,res->ai_socktype,res->ai_protocol);
+        if (fd < 0) {
+            freeaddrinfo(res);
+            cb(tcon->get_handle(),make_error_code(error::socket_error));
+            return;
+        }
+
+        // the sockaddr must outlive the submission; own it in the closure
+        lib::shared_ptr<sockaddr_storage> sa(new sockaddr_storage());
+        std::memcpy(sa.get(),res->ai_addr,res->ai_addrlen);
+        socklen_t sa_len = res->ai_addrlen;
+        freeaddrinfo(res);
+
+        operation * op = new operation(lib::bind(
+            &type::handle_connect,
+            this,
+            tcon,
+            cb,
+            fd,
+            sa,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ));
+
+        std::lock_guard<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            ::close(fd);
+            cb(tcon->get_handle(),
+                make_error_code(error::submission_queue_full));
+            return;
+        }
+        io_uring_prep_connect(sqe,fd,
+            reinterpret_cast<sockaddr *>(sa.get()),sa_len);
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+    }
+
+    /// Process completions until stop is called
+    std::size_t run() {
+        m_running = true;
+        std::size_t handled = 0;
+        while (m_running) {
+            io_uring_submit_and_wait(&m_ring->ring,1);
+            handled += reap();
+        }
+        return handled;
+    }
+
+    /// Process any completions that are ready without blocking
+    std::size_t poll() {
+        return reap();
+    }
+
+    /// Break out of the run loop
+    void stop() {
+        m_running = false;
+        // wake the io thread with a no-op
+        std::lock_guard<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (sqe) {
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe,NULL);
+            io_uring_submit(&m_ring->ring);
+        }
+    }
+
+protected:
+    /// Initialize logging
+    void init_logging(alog_type * a, elog_type * e) {
+        m_alog = a;
+        m_elog = e;
+    }
+
+    /// Initialize a connection transport component
+    /**
+     * Called by the core endpoint whenever a new connection is created.
+     * Hands the connection a reference to the shared ring.
+     *
+     * @param tcon Pointer to the transport component being initialized
+     */
+    lib::error_code init(transport_con_ptr tcon) {
+        if (!m_ring->initialized) {
+            lib::error_code ec = init_uring();
+            if (ec) { return ec; }
+        }
+        tcon->init_uring(m_ring);
+        return lib::error_code();
+    }
+
+private:
+    /// Arm (or re-arm) the kernel accept operation
+    void arm_accept() {
+        operation * op = new operation(lib::bind(
+            &type::handle_accept_cqe,
+            this,
+            lib::placeholders::_1,
+            lib::placeholders::_2
+        ),m_use_multishot);
+
+        std::lock_guard<std::mutex> lock(m_ring->sq_lock);
+        io_uring_sqe * sqe = m_ring->get_sqe();
+        if (!sqe) {
+            delete op;
+            return;
+        }
+        if (m_use_multishot) {
+            io_uring_prep_multishot_accept(sqe,m_listen_fd,NULL,NULL,0);
+        } else {
+            io_uring_prep_accept(sqe,m_listen_fd,NULL,NULL,0);
+        }
+        io_uring_sqe_set_data(sqe,op);
+        io_uring_submit(&m_ring->ring);
+        m_accept_armed = true;
+    }
+
+    /// Process an accept completion
+    void handle_accept_cqe(int res, uint32_t flags) {
+        if (res == -EINVAL && m_use_multishot) {
+            // kernel too old for multishot accept; downgrade
+            m_use_multishot = false;
+            m_accept_armed = false;
+            arm_accept();
+            return;
+        }
+
+        if (res >= 0) {
+            if (!m_pending_accepts.empty()) {
+                transport_con_ptr tcon = m_pending_accepts.front().first;
+                accept_handler cb = m_pending_accepts.front().second;
+                m_pending_accepts.pop();
+                complete_accept(tcon,cb,res);
+            } else {
+                m_accepted_backlog.push(res);
+            }
+        } else if (m_elog && res != -ECANCELED) {
+            m_elog->write(log::elevel::rerror,"uring accept failed");
+        }
+
+        // single shot, or retired multishot: arm again
+        if (!m_use_multishot || !(flags & IORING_CQE_F_MORE)) {
+            m_accept_armed = false;
+            if (m_listen_fd != -1 && res != -ECANCELED) {
+                arm_accept();
+            }
+        }
+    }
+
+    /// Hand an accepted socket to a waiting connection
+    void complete_accept(transport_con_ptr tcon, accept_handler callback,
+        int fd)
+    {
+        tcon->set_socket(fd);
+        // Fixed buffers are not auto-assigned: the pool has no visibility
+        // into connection teardown, so assignment (and release) is left to
+        // the application via assign_fixed_buffer/release_fixed_buffer.
+        callback(tcon->get_handle(),lib::error_code());
+    }
+
+    void handle_connect(transport_con_ptr tcon, connect_handler cb, int fd,
+        lib::shared_ptr<sockaddr_storage>, int res, uint32_t)
+    {
+        if (res < 0) {
+            ::close(fd);
+            cb(tcon->get_handle(),make_error_code(error::socket_error));
+            return;
+        }
+        tcon->set_socket(fd);
+        cb(tcon->get_handle(),lib::error_code());
+    }
+
+    /// Drain the completion queue, invoking operation records
+    std::size_t reap() {
+        io_uring_cqe * cqe;
+        std::size_t handled = 0;
+        while (io_uring_peek_cqe(&m_ring->ring,&cqe) == 0) {
+            operation * op =
+                static_cast<operation *>(io_uring_cqe_get_data(cqe));
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            io_uring_cqe_seen(&m_ring->ring,cqe);
+
+            if (op) {
+                op->handler(res,flags);
+                if (!op->persistent || !(flags & IORING_CQE_F_MORE)) {
+                    delete op;
+                }
+            }
+            handled++;
+        }
+        return handled;
+    }
+
+    ring_handle_ptr m_ring;
+
+    int m_listen_fd;
+    bool m_accept_armed;
+    bool m_use_multishot;
+    bool m_running;
+
+    std::queue<std::pair<transport_con_ptr,accept_handler> >
+        m_pending_accepts;
+    std::queue<int> m_accepted_backlog;
+
+    // registered buffer pool
+    std::vector<char> m_buffer_storage;
+    std::vector<iovec> m_buffer_iovecs;
+    std::queue<int> m_free_buffers;
+
+    alog_type * m_alog;
+    elog_type * m_elog;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_HPP
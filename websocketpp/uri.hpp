@@ -45,120 +45,149 @@ static uint16_t const uri_default_port = 80;
 /// Default port for wss:// 
 static uint16_t const uri_default_secure_port = 443;
 
-class uri {
-public:
-    explicit uri(std::string const & uri) : m_valid(false) {
-        std::string::const_iterator it;
-        std::string::const_iterator temp;
-        
-        int state = 0;
+namespace detail {
 
-        it = uri.begin();
-        
-        if (std::equal(it,it+6,"wss://")) {
-            m_secure = true;
-            m_scheme = "wss";
-            it += 6;
-        } else if (std::equal(it,it+5,"ws://")) {
-            m_secure = false;
-            m_scheme = "ws";
-            it += 5;
-        } else if (std::equal(it,it+7,"http://")) {
-            m_secure = false;
-            m_scheme = "http";
-            it += 7;
-        } else if (std::equal(it,it+8,"https://")) {
-            m_secure = true;
-            m_scheme = "https";
-            it += 8;
+/// Offsets of each component within one uri string
+/**
+ * Produced by parse_uri_components in a single pass with no
+ * allocation; both the owning uri class and the view based uri_view
+ * materialize their components from these.
+ */
+struct uri_parts {
+    uri_parts() : scheme_len(0), host_off(0), host_len(0), port_off(0),
+        port_len(0), resource_off(0), secure(false), port(0) {}
+
+    size_t scheme_len;
+    size_t host_off;
+    size_t host_len;
+    size_t port_off;
+    size_t port_len;
+    size_t resource_off;  // std::string::npos when the uri has no path
+    bool   secure;
+    uint16_t port;        // resolved: explicit value or scheme default
+};
+
+/// Single pass component scan of a ws/wss/http/https uri
+/**
+ * @param u The uri string to scan
+ * @param out Component offsets, valid only when true is returned
+ * @return Whether the uri parsed successfully
+ */
+inline bool parse_uri_components(std::string const & u, uri_parts & out) {
+    size_t i = 0;
+
+    if (u.compare(0,6,"wss://") == 0) {
+        out.secure = true;
+        out.scheme_len = 3;
+        i = 6;
+    } else if (u.compare(0,5,"ws://") == 0) {
+        out.secure = false;
+        out.scheme_len = 2;
+        i = 5;
+    } else if (u.compare(0,7,"http://") == 0) {
+        out.secure = false;
+        out.scheme_len = 4;
+        i = 7;
+    } else if (u.compare(0,8,"https://") == 0) {
+        out.secure = true;
+        out.scheme_len = 5;
+        i = 8;
+    } else {
+        return false;
+    }
+
+    bool have_port = false;
+
+    if (i < u.size() && u[i] == '[') {
+        // IPv6 literal: host is the bracket interior
+        size_t close = u.find(']',++i);
+        if (close == std::string::npos) {
+            return false;
+        }
+        out.host_off = i;
+        out.host_len = close-i;
+        i = close+1;
+        if (i == u.size()) {
+            out.resource_off = std::string::npos;
+        } else if (u[i] == '/') {
+            out.resource_off = i;
+        } else if (u[i] == ':') {
+            have_port = true;
+            ++i;
         } else {
-            return;
+            return false;
         }
-        
-        // extract host.
-        // either a host string
-        // an IPv4 address
-        // or an IPv6 address
-        if (*it == '[') {
-            ++it;
-            // IPv6 literal
-            // extract IPv6 digits until ]
-            
-            // TODO: this doesn't work on g++... not sure why
-            //temp = std::find(it,it2,']');
-            
-            temp = it;
-            while (temp != uri.end()) {
-                if (*temp == ']') {
-                    break;
-                }
-                ++temp;
-            }
-
-            if (temp == uri.end()) {
-                return;
-            } else {
-                // validate IPv6 literal parts
-                // can contain numbers, a-f and A-F
-                m_host.append(it,temp);
-            }
-            it = temp+1;
-            if (it == uri.end()) {
-                state = 2;
-            } else if (*it == '/') {
-                state = 2;
-                ++it;
-            } else if (*it == ':') {
-                state = 1;
-                ++it;
-            } else {
-                // problem
-                return;
-            }
+    } else {
+        out.host_off = i;
+        while (i < u.size() && u[i] != '/' && u[i] != ':') {
+            ++i;
+        }
+        out.host_len = i-out.host_off;
+        if (i == u.size()) {
+            out.resource_off = std::string::npos;
+        } else if (u[i] == '/') {
+            out.resource_off = i;
         } else {
-            // IPv4 or hostname
-            // extract until : or /
-            while (state == 0) {
-                if (it == uri.end()) {
-                    state = 2;
-                    break;
-                } else if (*it == '/') {
-                    state = 2;
-                } else if (*it == ':') {
-                    // end hostname start port
-                    state = 1;
-                } else {
-                    m_host += *it;
-                }
-                ++it;
-            }
+            have_port = true;
+            ++i;
+        }
+    }
+
+    if (have_port) {
+        out.port_off = i;
+        while (i < u.size() && u[i] != '/') {
+            ++i;
         }
+        out.port_len = i-out.port_off;
+        out.resource_off = (i == u.size() ? std::string::npos : i);
 
-        // parse port
-        std::string port = "";
-        while (state == 1) {
-            if (it == uri.end()) {
-                state = 3;
-                break;
-            } else if (*it == '/') {
-                state = 3;
-            } else {
-                port += *it;
+        if (out.port_len == 0) {
+            // "ws://host:" and "ws://host:/x" carry an empty port, which
+            // the grammar allows; resolve to the scheme default
+            out.port = (out.secure ? uri_default_secure_port
+                                   : uri_default_port);
+            return true;
+        }
+        unsigned int p = 0;
+        if (out.port_len > 5) {
+            return false;
+        }
+        for (size_t j = out.port_off; j < out.port_off+out.port_len; j++) {
+            if (u[j] < '0' || u[j] > '9') {
+                return false;
             }
-            ++it;
+            p = p*10 + static_cast<unsigned int>(u[j]-'0');
         }
+        if (p == 0 || p > 65535) {
+            return false;
+        }
+        out.port = static_cast<uint16_t>(p);
+    } else {
+        out.port = (out.secure ? uri_default_secure_port : uri_default_port);
+    }
 
-        lib::error_code ec;
-        m_port = get_port_from_string(port, ec);
+    return true;
+}
+
+} // namespace detail
 
-        if (ec) {
+class uri {
+public:
+    explicit uri(std::string const & uri) : m_valid(false) {
+        detail::uri_parts parts;
+        if (!detail::parse_uri_components(uri,parts)) {
             return;
         }
 
-        m_resource = "/";
-        m_resource.append(it,uri.end());
-
-
+        m_secure = parts.secure;
+        m_scheme.assign(uri,0,parts.scheme_len);
+        m_host.assign(uri,parts.host_off,parts.host_len);
+        if (parts.resource_off == std::string::npos) {
+            m_resource = "/";
+        } else {
+            m_resource.assign(uri,parts.resource_off,std::string::npos);
+        }
+        m_port = parts.port;
         m_valid = true;
     }
     
@@ -328,6 +357,115 @@ private:
     bool        m_valid;
 };
 
+/// Non-owning view of one component of a uri_view's backing string
+struct uri_component {
+    uri_component() : data(0), len(0) {}
+    uri_component(char const * d, size_t l) : data(d), len(l) {}
+
+    /// Materialize the component as an owned string
+    std::string str() const {
+        return std::string(data,len);
+    }
+    bool empty() const {
+        return len == 0;
+    }
+    bool operator==(char const * rhs) const {
+        size_t i = 0;
+        for (; i < len; i++) {
+            if (rhs[i] == '\0' || rhs[i] != data[i]) {
+                return false;
+            }
+        }
+        return rhs[i] == '\0';
+    }
+    bool operator==(std::string const & rhs) const {
+        return rhs.size() == len
+            && rhs.compare(0,len,data,len) == 0;
+    }
+
+    char const * data;
+    size_t len;
+};
+
+/// View based uri: one backing string, components parsed lazily
+/**
+ * Keeps the original uri string as its only allocation and exposes
+ * scheme/host/port/resource as views into it, deferring the component
+ * scan until the first accessor call and caching the port as an
+ * integer. Client reconnect loops and handshake validation, which
+ * construct and immediately query a uri per attempt, shed the four
+ * per-component string allocations the owning uri class pays.
+ *
+ * Views are invalidated by destroying (or moving from, where enabled)
+ * the uri_view; the accessors' uri_component results must not outlive
+ * it. Use the owning uri class when components need to be retained.
+ */
+class uri_view {
+public:
+    /// Construct from a uri string; parsing happens on first access
+    explicit uri_view(std::string const & uri)
+      : m_uri(uri), m_parsed(false), m_valid(false) {}
+
+    /// Whether the uri parses successfully
+    bool get_valid() const {
+        ensure_parsed();
+        return m_valid;
+    }
+
+    /// Whether the scheme is wss or https
+    bool get_secure() const {
+        ensure_parsed();
+        return m_parts.secure;
+    }
+
+    /// The scheme component ("ws", "wss", "http", "https")
+    uri_component get_scheme() const {
+        ensure_parsed();
+        return uri_component(m_uri.data(),m_parts.scheme_len);
+    }
+
+    /// The host component (IPv6 literals without brackets)
+    uri_component get_host() const {
+        ensure_parsed();
+        return uri_component(m_uri.data()+m_parts.host_off,
+            m_parts.host_len);
+    }
+
+    /// The resource component, "/" when the uri carries no path
+    uri_component get_resource() const {
+        ensure_parsed();
+        if (m_parts.resource_off == std::string::npos) {
+            return uri_component("/",1);
+        }
+        return uri_component(m_uri.data()+m_parts.resource_off,
+            m_uri.size()-m_parts.resource_off);
+    }
+
+    /// The port, cached as an integer (scheme default when implicit)
+    uint16_t get_port() const {
+        ensure_parsed();
+        return m_parts.port;
+    }
+
+    /// The original uri string, unmodified
+    std::string const & str() const {
+        return m_uri;
+    }
+
+private:
+    void ensure_parsed() const {
+        if (!m_parsed) {
+            m_valid = detail::parse_uri_components(m_uri,m_parts);
+            m_parsed = true;
+        }
+    }
+
+    std::string m_uri;
+    mutable detail::uri_parts m_parts;
+    mutable bool m_parsed;
+    mutable bool m_valid;
+};
+
 typedef lib::shared_ptr<uri> uri_ptr;
 
 } // namespace websocketpp
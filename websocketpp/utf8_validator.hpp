@@ -6,6 +6,21 @@
 
 #include <websocketpp/common/stdint.hpp>
 
+#include <cstring>
+#include <string>
+
+// Vectorized validation kernel detection. The SIMD path implements the
+// shuffle-table UTF-8 validation algorithm of Keiser & Lemire ("Validating
+// UTF-8 In Less Than One Instruction Per Byte") as used by simdjson, with a
+// cpuid check at runtime; the DFA below remains the fallback and handles
+// partial-codepoint carry across calls.
+#ifndef WEBSOCKETPP_DISABLE_SIMD_UTF8
+    #if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+        #define WEBSOCKETPP_SIMD_UTF8
+        #include <tmmintrin.h>
+    #endif
+#endif
+
 namespace websocketpp {
 namespace utf8_validator {
 
@@ -41,6 +56,194 @@ decode(uint32_t* state, uint32_t* codep, uint8_t byte) {
   return *state;
 }
 
+#ifdef WEBSOCKETPP_SIMD_UTF8
+namespace simd {
+
+// Error flag constants for the shuffle tables (Keiser & Lemire). Each bit
+// names a way a two-byte window can be malformed; a byte pair is an error
+// when all three table lookups agree on a bit.
+static uint8_t const TOO_SHORT      = 1<<0;
+static uint8_t const TOO_LONG       = 1<<1;
+static uint8_t const OVERLONG_3     = 1<<2;
+static uint8_t const TOO_LARGE      = 1<<3;
+static uint8_t const SURROGATE      = 1<<4;
+static uint8_t const OVERLONG_2     = 1<<5;
+static uint8_t const TOO_LARGE_1000 = 1<<6;
+static uint8_t const OVERLONG_4     = 1<<6;
+static uint8_t const TWO_CONTS      = 1<<7;
+static uint8_t const CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+/// Validate a byte range that starts and ends on codepoint boundaries
+/**
+ * Core SSSE3 kernel. The caller guarantees that data begins at a codepoint
+ * boundary and that the final codepoint is complete within the range (the
+ * streaming wrapper trims the tail accordingly); the trailing partial block
+ * is processed zero padded, which is safe because NUL is valid ASCII.
+ *
+ * @param data Bytes to validate
+ * @param len Number of bytes
+ * @return true if the range is valid UTF-8
+ */
+__attribute__((target("ssse3")))
+inline bool validate_range_ssse3(uint8_t const * data, size_t len) {
+    __m128i const byte_1_high = _mm_setr_epi8(
+        // 0_______ (ASCII lead)
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        // 10______ (continuation lead)
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        // 1100____ / 1101____ (two byte lead)
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        // 1110____ (three byte lead)
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        // 1111____ (four byte lead)
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+    );
+    __m128i const byte_1_low = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+    );
+    __m128i const byte_2_high = _mm_setr_epi8(
+        // 0_______
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        // 1000____ .. 1011____ (continuations)
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+            OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        // 11______ (leads)
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+    );
+    __m128i const low_nibble_mask = _mm_set1_epi8(0x0F);
+
+    __m128i prev = _mm_setzero_si128();
+    __m128i error = _mm_setzero_si128();
+
+    size_t i = 0;
+    while (i < len) {
+        __m128i cur;
+        if (len - i >= 16) {
+            cur = _mm_loadu_si128(
+                reinterpret_cast<__m128i const *>(data+i));
+        } else {
+            uint8_t padded[16];
+            std::memset(padded,0,sizeof(padded));
+            std::memcpy(padded,data+i,len-i);
+            cur = _mm_loadu_si128(reinterpret_cast<__m128i const *>(padded));
+        }
+
+        // ASCII blocks need no table work, but a multibyte sequence must
+        // not be left dangling by the previous block
+        if (_mm_movemask_epi8(cur) == 0) {
+            // previous block may not end with an incomplete sequence
+            __m128i const max_value = _mm_setr_epi8(
+                -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                0xF0u-1,0xE0u-1,0xC0u-1);
+            error = _mm_or_si128(error,
+                _mm_subs_epu8(prev,max_value));
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(cur,prev,15);
+            __m128i sc = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(byte_1_high,
+                        _mm_and_si128(_mm_srli_epi16(prev1,4),
+                            low_nibble_mask)),
+                    _mm_shuffle_epi8(byte_1_low,
+                        _mm_and_si128(prev1,low_nibble_mask))),
+                _mm_shuffle_epi8(byte_2_high,
+                    _mm_and_si128(_mm_srli_epi16(cur,4),low_nibble_mask)));
+
+            __m128i prev2 = _mm_alignr_epi8(cur,prev,14);
+            __m128i prev3 = _mm_alignr_epi8(cur,prev,13);
+            __m128i is_third_byte = _mm_subs_epu8(prev2,
+                _mm_set1_epi8(0xE0u-1));
+            __m128i is_fourth_byte = _mm_subs_epu8(prev3,
+                _mm_set1_epi8(0xF0u-1));
+            __m128i must23 = _mm_or_si128(
+                _mm_cmpgt_epi8(is_third_byte,_mm_setzero_si128()),
+                _mm_cmpgt_epi8(is_fourth_byte,_mm_setzero_si128()));
+            __m128i must23_80 = _mm_and_si128(must23,_mm_set1_epi8(0x80u));
+
+            error = _mm_or_si128(error,_mm_xor_si128(must23_80,sc));
+        }
+
+        prev = cur;
+        i += 16;
+    }
+
+    // the caller guarantees the range ends at a codepoint boundary, so any
+    // trailing incomplete sequence in the final block is an error
+    __m128i const max_value = _mm_setr_epi8(
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        0xF0u-1,0xE0u-1,0xC0u-1);
+    error = _mm_or_si128(error,_mm_subs_epu8(prev,max_value));
+
+    return _mm_movemask_epi8(
+        _mm_cmpeq_epi8(error,_mm_setzero_si128())) == 0xFFFF;
+}
+
+/// Whether the running processor supports the SSSE3 kernel
+inline bool kernel_usable() {
+    static bool const usable = __builtin_cpu_supports("ssse3");
+    return usable;
+}
+
+/// Number of trailing bytes that may belong to an unfinished codepoint
+/**
+ * Walks back at most three bytes from the end of the range and returns how
+ * many trailing bytes should be excluded so that the remaining prefix ends
+ * on a codepoint boundary. Malformed tails return 0; the kernel or DFA will
+ * reject them.
+ */
+inline size_t incomplete_suffix_length(uint8_t const * data, size_t len) {
+    size_t back = 0;
+    while (back < 3 && back < len &&
+           (data[len-1-back] & 0xC0) == 0x80)
+    {
+        back++;
+    }
+    if (back == len || back >= 3) {
+        return 0;
+    }
+    uint8_t lead = data[len-1-back];
+    size_t expected;
+    if (lead < 0x80) {
+        expected = 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        expected = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        expected = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        expected = 4;
+    } else {
+        return 0;
+    }
+    if (back+1 < expected) {
+        return back+1;
+    }
+    return 0;
+}
+
+} // namespace simd
+#endif // WEBSOCKETPP_SIMD_UTF8
+
 /// Provides streaming UTF8 validation functionality
 class validator {
 public:
@@ -62,6 +265,57 @@ public:
         }
         return true;
     }
+
+    /// Contiguous buffer overloads that use the vectorized kernel
+    /**
+     * For contiguous input the bulk of the range is checked with the SIMD
+     * kernel when the processor supports it; the DFA finishes any pending
+     * codepoint from a previous call first and consumes the (possibly
+     * incomplete) trailing codepoint afterwards so that cross-call carry
+     * behaves exactly as with the plain DFA.
+     */
+    bool decode (uint8_t const * b, uint8_t const * e) {
+#ifdef WEBSOCKETPP_SIMD_UTF8
+        if (static_cast<size_t>(e-b) >= 32 && simd::kernel_usable()) {
+            // finish a codepoint carried in from the previous call
+            while (b != e && m_state != UTF8_ACCEPT) {
+                if (utf8_validator::decode(&m_state,&m_codepoint,*b)
+                    == UTF8_REJECT)
+                {
+                    return false;
+                }
+                ++b;
+            }
+
+            size_t remaining = static_cast<size_t>(e-b);
+            if (remaining >= 32) {
+                size_t tail = simd::incomplete_suffix_length(b,remaining);
+                size_t body = remaining-tail;
+                if (!simd::validate_range_ssse3(b,body)) {
+                    m_state = UTF8_REJECT;
+                    return false;
+                }
+                b += body;
+            }
+        }
+#endif
+        return decode<uint8_t const *>(b,e);
+    }
+
+    bool decode (uint8_t * b, uint8_t * e) {
+        return decode(static_cast<uint8_t const *>(b),
+            static_cast<uint8_t const *>(e));
+    }
+
+    bool decode (char const * b, char const * e) {
+        return decode(reinterpret_cast<uint8_t const *>(b),
+            reinterpret_cast<uint8_t const *>(e));
+    }
+
+    bool decode (char * b, char * e) {
+        return decode(reinterpret_cast<uint8_t const *>(b),
+            reinterpret_cast<uint8_t const *>(e));
+    }
     
     bool complete() {
         return m_state == UTF8_ACCEPT;
@@ -81,11 +335,21 @@ private:
 // TODO: should this be inline?
 inline bool validate(const std::string& s) {
     validator v;
-    if (!v.decode(s.begin(),s.end())) {
+    if (!v.decode(s.data(),s.data()+s.size())) {
         return false;
     }
     return v.complete();
 }
+
+/// Whether a string is a valid UTF-8 prefix (may end mid code point)
+/**
+ * For validating the leading fragment of a text message, which is
+ * allowed to split a multi byte sequence at the fragment boundary.
+ */
+inline bool validate_prefix(const std::string & s) {
+    validator v;
+    return v.decode(s.data(),s.data()+s.size());
+}
     
 } // namespace utf8_validator
 } // namespace websocketpp
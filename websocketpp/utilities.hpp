@@ -31,6 +31,8 @@
 #include <websocketpp/common/stdint.hpp>
 
 #include <algorithm>
+#include <cctype>
+#include <cstddef>
 #include <string>
 
 namespace websocketpp {
@@ -88,6 +90,75 @@ struct ci_less : std::binary_function<std::string, std::string, bool> {
     }
 };
 
+/// A non-owning reference to a range of characters
+/**
+ * Minimal string_view analog for pre-C++17 code paths that need to expose
+ * slices of an existing buffer without copying. The referenced storage must
+ * outlive the ref.
+ */
+struct string_ref {
+    string_ref() : data(NULL), len(0) {}
+    string_ref(char const * d, size_t l) : data(d), len(l) {}
+    explicit string_ref(std::string const & s) : data(s.data()), len(s.size()) {}
+
+    bool empty() const {
+        return len == 0;
+    }
+
+    /// Materialize the referenced characters as a std::string
+    std::string str() const {
+        return std::string(data,len);
+    }
+
+    char const * data;
+    size_t len;
+};
+
+/// Case insensitive equality of two character ranges
+inline bool ci_equal(string_ref const & a, string_ref const & b) {
+    if (a.len != b.len) {
+        return false;
+    }
+    for (size_t i = 0; i < a.len; i++) {
+        if (std::tolower(static_cast<unsigned char>(a.data[i])) !=
+            std::tolower(static_cast<unsigned char>(b.data[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Case insensitive substring containment test over character ranges
+inline bool ci_contains(string_ref const & haystack, string_ref const & needle)
+{
+    if (needle.len == 0) {
+        return true;
+    }
+    if (haystack.len < needle.len) {
+        return false;
+    }
+    for (size_t i = 0; i + needle.len <= haystack.len; i++) {
+        if (ci_equal(string_ref(haystack.data+i,needle.len),needle)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Case insensitive less-than of two character ranges
+inline bool ci_less_ref(string_ref const & a, string_ref const & b) {
+    size_t n = (a.len < b.len ? a.len : b.len);
+    for (size_t i = 0; i < n; i++) {
+        int ca = std::tolower(static_cast<unsigned char>(a.data[i]));
+        int cb = std::tolower(static_cast<unsigned char>(b.data[i]));
+        if (ca != cb) {
+            return ca < cb;
+        }
+    }
+    return a.len < b.len;
+}
+
 /// Find substring (case insensitive)
 /**
  * @param [in] haystack The string to search in